@@ -45,6 +45,7 @@ App::~App()
 
 	CommandContext::DestroyAllContexts();
 	g_CommandManager.Shutdown();
+	BindlessHeap::Destroy();
 	DescriptorAllocator::DestroyAll();
 }
 
@@ -167,6 +168,9 @@ bool App::InitDirect3D()
 
 	g_Device = m_d3dDevice.Get();
 	g_CommandManager.Create(g_Device);
+	// before any context, their dynamic descriptors go to its pages
+	if (m_bindless)
+		BindlessHeap::Create();
 
 	D3D12_FEATURE_DATA_MULTISAMPLE_QUALITY_LEVELS msQualityLevels;
 	msQualityLevels.Format = m_backBufferFormat;
@@ -624,6 +628,10 @@ void App::SwapBackBuffer()
 	m_swapChain->Present(0, 0); // Present without vsync
 	m_currBackBuffer = (m_currBackBuffer + 1) % c_swapChainBufferCount;
 	g_CommandManager.IdleGPU();
+	LinearAllocator::EndFrame();
+	DynamicAllocator::EndFrame();
+	DynamicDescriptorHeap::EndFrame();
+	BindlessHeap::EndFrame();
 	++m_frameIndex;
 }
 
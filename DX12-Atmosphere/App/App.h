@@ -29,6 +29,9 @@ public:
 	int GetHeight() const { return m_clientHeight; }
 	void SetWidth(int width) { m_clientWidth = width; }
 	void SetHeight(int height) { m_clientHeight = height; }
+	// Before Initialize, the dynamic descriptors go to the pages of a BindlessHeap and the
+	// bindless passes can be turned on. Off by default.
+	void SetBindless(bool bindless) { m_bindless = bindless; }
 
 	bool Get4xMSAAState() const;
 	void Set4xMSAAState(bool v);
@@ -91,6 +94,7 @@ protected:
 	bool m_fullScreenState = false;
 
 	bool m_4xMSAAState = false;
+	bool m_bindless = false;
 	UINT m_4xMSAAQuality = 0;
 
 	Timer m_timer;
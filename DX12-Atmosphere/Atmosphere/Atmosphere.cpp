@@ -5,6 +5,8 @@
 #include "D3D12/RootSignature.h"
 #include "D3D12/PipelineState.h"
 #include "D3D12/CommandContext.h"
+#include "D3D12/FrameGraphExecutor.h"
+#include "D3D12/TransientHeapPlanner.h"
 #include "Utils/Camera.h"
 
 #include "CompiledShaders/ComputeTransmittance_CS.h"
@@ -44,6 +46,8 @@ namespace Atmosphere
 	std::shared_ptr<VolumeColorBuffer> InterRayleighScattering;
 	std::shared_ptr<VolumeColorBuffer> InterMieScattering;
 	std::shared_ptr<VolumeColorBuffer> InterScatteringDensity;
+	// the intermediates while precomputing, placed by a TransientHeapPlanner
+	Microsoft::WRL::ComPtr<ID3D12Heap> IntermediateHeap;
 
 	RootSignature PrecomputeRS;
 	RootSignature ComputeSkyRS;
@@ -56,6 +60,10 @@ namespace Atmosphere
 	ComputePSO IndirectIrradiancePSO;
 	ComputePSO ComputeSkyPSO;
 
+	// the graph and intermediate placement of the last precompute, for the UI
+	FrameGraph PrecomputeGraph;
+	std::string IntermediatePlan;
+
 	AtmosphereCB AtmospherePhysicalCB;
 	RenderCB PassCB;
 
@@ -130,10 +138,21 @@ namespace Atmosphere
 	}
 
 	void InitTextures();
-	void InitIntermediateTextures();
 	void InitPSO();
 
-	void Precompute(ComputeContext& context, const Vector3& lambdas, uint32_t numScatteringOrders);
+	enum IntermediateTexture
+	{
+		kInterIrradiance,
+		kInterRayleighScattering,
+		kInterMieScattering,
+		kInterScatteringDensity,
+		kNumIntermediateTextures
+	};
+
+	void DeclarePrecompute(FrameGraphExecutor& graph, uint32_t numScatteringOrders, FrameGraph::Handle intermediates[kNumIntermediateTextures]);
+	void CreateIntermediateTextures(FrameGraphExecutor& graph, const FrameGraph::Handle intermediates[kNumIntermediateTextures]);
+	void ReleaseIntermediateTextures();
+	void Precompute(ComputeContext& context, FrameGraphExecutor& graph, const Vector3& lambdas);
 
 	void UpdateLambdaDependsCB(const Vector3& lambdas);
 	void UpdatePhysicalCB(const Vector3& lambdas);
@@ -145,8 +164,6 @@ namespace Atmosphere
 		InitPSO();
 		InitModel();
 		InitTextures();
-		// TODO: do in precompute and release after precompute complete.
-		InitIntermediateTextures();
 	}
 
 	void SetCamera(Camera* camera)
@@ -353,29 +370,105 @@ namespace Atmosphere
 		Irradiance->Create(L"Irradiance", IRRADIANCE_TEXTURE_WIDTH, IRRADIANCE_TEXTURE_HEIGHT, 1, DXGI_FORMAT_R32G32B32A32_FLOAT);
 	}
 
-	void InitIntermediateTextures()
+	// Only while precomputing: in one heap, sharing memory where the passes of graph let them,
+	// each transient in graph over the ones whose memory it takes
+	void CreateIntermediateTextures(FrameGraphExecutor& graph, const FrameGraph::Handle intermediates[kNumIntermediateTextures])
 	{
-		ReleaseOrNewTexture(InterIrradiance);
-		InterIrradiance->Create(L"Intermediate Irradiance", IRRADIANCE_TEXTURE_WIDTH, IRRADIANCE_TEXTURE_HEIGHT, 1, DXGI_FORMAT_R32G32B32A32_FLOAT);
-
-		ReleaseOrNewTexture(InterRayleighScattering);
-		InterRayleighScattering->Create(L"Intermediate Rayleigh Scattering", SCATTERING_TEXTURE_WIDTH, SCATTERING_TEXTURE_HEIGHT, SCATTERING_TEXTURE_DEPTH, 1, UseHalfPrecision ? DXGI_FORMAT_R16G16B16A16_FLOAT : DXGI_FORMAT_R32G32B32A32_FLOAT);
-
-		ReleaseOrNewTexture(InterMieScattering);
-		InterMieScattering->Create(L"Intermediate Mie Scattering", SCATTERING_TEXTURE_WIDTH, SCATTERING_TEXTURE_HEIGHT, SCATTERING_TEXTURE_DEPTH, 1, UseHalfPrecision ? DXGI_FORMAT_R16G16B16A16_FLOAT : DXGI_FORMAT_R32G32B32A32_FLOAT);
+		const DXGI_FORMAT scattering_format = UseHalfPrecision ? DXGI_FORMAT_R16G16B16A16_FLOAT : DXGI_FORMAT_R32G32B32A32_FLOAT;
+		D3D12_RESOURCE_ALLOCATION_INFO infos[kNumIntermediateTextures] =
+		{
+			InterIrradiance->GetAllocationInfo(IRRADIANCE_TEXTURE_WIDTH, IRRADIANCE_TEXTURE_HEIGHT, 1, DXGI_FORMAT_R32G32B32A32_FLOAT),
+			InterRayleighScattering->GetAllocationInfo(SCATTERING_TEXTURE_WIDTH, SCATTERING_TEXTURE_HEIGHT, SCATTERING_TEXTURE_DEPTH, 1, scattering_format),
+			InterMieScattering->GetAllocationInfo(SCATTERING_TEXTURE_WIDTH, SCATTERING_TEXTURE_HEIGHT, SCATTERING_TEXTURE_DEPTH, 1, scattering_format),
+			InterScatteringDensity->GetAllocationInfo(SCATTERING_TEXTURE_WIDTH, SCATTERING_TEXTURE_HEIGHT, SCATTERING_TEXTURE_DEPTH, 1, scattering_format)
+		};
+
+		// one that no pass uses isn't created
+		TransientHeapPlanner planner;
+		TransientHeapPlanner::Handle placed[kNumIntermediateTextures];
+		bool used[kNumIntermediateTextures];
+		for (uint32_t i = 0; i < kNumIntermediateTextures; ++i)
+			used[i] = planner.AddResource(graph.GetGraph(), intermediates[i], infos[i].SizeInBytes, infos[i].Alignment, placed[i]);
+		planner.Plan();
+		for (uint32_t i = 0; i < kNumIntermediateTextures; ++i)
+		{
+			if (!used[i])
+				continue;
+			std::vector<FrameGraph::Handle> aliases;
+			for (TransientHeapPlanner::Handle alias : planner.GetAliases(placed[i]))
+			{
+				for (uint32_t j = 0; j < kNumIntermediateTextures; ++j)
+				{
+					if (used[j] && placed[j] == alias)
+						aliases.push_back(intermediates[j]);
+				}
+			}
+			graph.SetTransient(intermediates[i], aliases);
+		}
+		IntermediatePlan = planner.DumpPlan();
+		// Scattering Density 2 writes InterScatteringDensity reading the other three, all four
+		// are live there and no split of their lifetimes per order changes that peak. Only one
+		// heap, freed at once after precomputing.
+		TransientHeapPlanner::Stats plan_stats = planner.GetStats();
+		if (plan_stats.resources > 1 && plan_stats.heapBytes >= plan_stats.summedBytes)
+			IntermediatePlan += "no savings, every intermediate is live at once\n";
+		if (planner.GetNumHeaps() == 0)
+			return;
+		assert(planner.GetNumHeaps() == 1);
+
+		// the intermediates allow render targets, a tier 1 heap only holds those
+		D3D12_HEAP_DESC heap_desc = {};
+		heap_desc.SizeInBytes = planner.GetHeapSize(0);
+		heap_desc.Properties.Type = D3D12_HEAP_TYPE_DEFAULT;
+		heap_desc.Alignment = std::max<uint64_t>(planner.GetHeapAlignment(0), D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT);
+		heap_desc.Flags = D3D12_HEAP_FLAG_ALLOW_ONLY_RT_DS_TEXTURES;
+		ThrowIfFailed(g_Device->CreateHeap(&heap_desc, IID_PPV_ARGS(&IntermediateHeap)));
+		IntermediateHeap->SetName(L"Intermediate Heap");
+
+		ID3D12Heap* heap = IntermediateHeap.Get();
+		if (used[kInterIrradiance])
+			InterIrradiance->CreatePlaced(L"Intermediate Irradiance", heap, planner.GetPlacement(placed[kInterIrradiance]).offset,
+				IRRADIANCE_TEXTURE_WIDTH, IRRADIANCE_TEXTURE_HEIGHT, 1, DXGI_FORMAT_R32G32B32A32_FLOAT);
+		if (used[kInterRayleighScattering])
+			InterRayleighScattering->CreatePlaced(L"Intermediate Rayleigh Scattering", heap, planner.GetPlacement(placed[kInterRayleighScattering]).offset,
+				SCATTERING_TEXTURE_WIDTH, SCATTERING_TEXTURE_HEIGHT, SCATTERING_TEXTURE_DEPTH, 1, scattering_format);
+		if (used[kInterMieScattering])
+			InterMieScattering->CreatePlaced(L"Intermediate Mie Scattering", heap, planner.GetPlacement(placed[kInterMieScattering]).offset,
+				SCATTERING_TEXTURE_WIDTH, SCATTERING_TEXTURE_HEIGHT, SCATTERING_TEXTURE_DEPTH, 1, scattering_format);
+		if (used[kInterScatteringDensity])
+			InterScatteringDensity->CreatePlaced(L"Intermediate Scattering Density", heap, planner.GetPlacement(placed[kInterScatteringDensity]).offset,
+				SCATTERING_TEXTURE_WIDTH, SCATTERING_TEXTURE_HEIGHT, SCATTERING_TEXTURE_DEPTH, 1, scattering_format);
+	}
 
-		ReleaseOrNewTexture(InterScatteringDensity);
-		InterScatteringDensity->Create(L"Intermediate Scattering Density", SCATTERING_TEXTURE_WIDTH, SCATTERING_TEXTURE_HEIGHT, SCATTERING_TEXTURE_DEPTH, 1, UseHalfPrecision ? DXGI_FORMAT_R16G16B16A16_FLOAT : DXGI_FORMAT_R32G32B32A32_FLOAT);
+	// the GPU must be done with them
+	void ReleaseIntermediateTextures()
+	{
+		InterIrradiance = nullptr;
+		InterRayleighScattering = nullptr;
+		InterMieScattering = nullptr;
+		InterScatteringDensity = nullptr;
+		IntermediateHeap = nullptr;
 	}
 
 	void Precompute(uint32_t numScatteringOrders)
 	{
+		// Compiled in declaration order, so that every wavelength runs the schedule the
+		// intermediates were placed for
+		FrameGraphExecutor graph;
+		FrameGraph::Handle intermediates[kNumIntermediateTextures];
+		DeclarePrecompute(graph, numScatteringOrders, intermediates);
+		graph.Compile();
+		CreateIntermediateTextures(graph, intermediates);
+		// again with the aliasing barriers of the placement
+		graph.Compile();
+		PrecomputeGraph = graph.GetGraph();
+
 		ComputeContext& context = ComputeContext::Begin();
 		if (NumPrecomputedWavelengths <= 3)
 		{
 			Vector3 lambda_rgb(kLambdaR, kLambdaG, kLambdaB);
 			XMStoreFloat4x4(&LuminanceFromRadiance, Matrix4(kIdentity));
-			Precompute(context, lambda_rgb, numScatteringOrders);
+			Precompute(context, graph, lambda_rgb);
 		}
 		else
 		{
@@ -394,94 +487,153 @@ namespace Atmosphere
 					Vector4(0.0f, 0.0f, 0.0f, 0.0f)
 				);
 				XMStoreFloat4x4(&LuminanceFromRadiance, luminance_from_radiance);
-				Precompute(context, Vector3((float)lambda_r, (float)lambda_g, (float)lambda_b), numScatteringOrders);
+				Precompute(context, graph, Vector3((float)lambda_r, (float)lambda_g, (float)lambda_b));
 			}
 		}
-		context.Finish();
+		context.Finish(true);
+		ReleaseIntermediateTextures();
 	}
 
-	void Precompute(ComputeContext& context, const Vector3& lambdas, uint32_t numScatteringOrders)
+	void DeclarePrecompute(FrameGraphExecutor& graph, uint32_t numScatteringOrders, FrameGraph::Handle intermediates[kNumIntermediateTextures])
 	{
+		// The stages only bind and dispatch, the barriers between them come from what each
+		// one reads and writes. The intermediates are no result and transient, the first
+		// stage using each writes all of it.
+		const D3D12_RESOURCE_STATES uav = D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+		const D3D12_RESOURCE_STATES srv = D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
+		const D3D12_RESOURCE_STATES final_state = D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE;
+		InterIrradiance = std::make_shared<ColorBuffer>();
+		InterRayleighScattering = std::make_shared<VolumeColorBuffer>();
+		InterMieScattering = std::make_shared<VolumeColorBuffer>();
+		InterScatteringDensity = std::make_shared<VolumeColorBuffer>();
+		FrameGraph::Handle transmittance = graph.Import(*Transmittance, "Transmittance", final_state);
+		FrameGraph::Handle irradiance = graph.Import(*Irradiance, "Irradiance", final_state);
+		FrameGraph::Handle scattering = graph.Import(*Scattering, "Scattering", final_state);
+		FrameGraph::Handle single_mie = 0;
+		if (!UseCombinedTextures)
+			single_mie = graph.Import(*OptionalSingleMieScattering, "Single Mie Scattering", final_state);
+		FrameGraph::Handle inter_irradiance = graph.Import(*InterIrradiance, "Inter Irradiance", FrameGraph::kKeepState, false);
+		FrameGraph::Handle inter_rayleigh = graph.Import(*InterRayleighScattering, "Inter Rayleigh Scattering", FrameGraph::kKeepState, false);
+		FrameGraph::Handle inter_mie = graph.Import(*InterMieScattering, "Inter Mie Scattering", FrameGraph::kKeepState, false);
+		FrameGraph::Handle inter_density = graph.Import(*InterScatteringDensity, "Inter Scattering Density", FrameGraph::kKeepState, false);
+		intermediates[kInterIrradiance] = inter_irradiance;
+		intermediates[kInterRayleighScattering] = inter_rayleigh;
+		intermediates[kInterMieScattering] = inter_mie;
+		intermediates[kInterScatteringDensity] = inter_density;
+		for (uint32_t i = 0; i < kNumIntermediateTextures; ++i)
+			graph.SetTransient(intermediates[i]);
+
 		// Precompute transmittance
-		context.TransitionResource(*Transmittance, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-		context.SetRootSignature(PrecomputeRS);
-		context.SetPipelineState(TransmittancePSO);
-		context.SetDynamicDescriptor(1, 0, Transmittance->GetUAV());
-		context.SetDynamicConstantBufferView(3, sizeof(AtmospherePhysicalCB), &AtmospherePhysicalCB);
-		context.Dispatch2D(Transmittance->GetWidth(), Transmittance->GetHeight());
+		FrameGraph::Handle pass = graph.AddPass("Transmittance", [](CommandContext& commandContext)
+		{
+			ComputeContext& context = commandContext.GetComputeContext();
+			context.SetPipelineState(TransmittancePSO);
+			context.SetDynamicDescriptor(1, 0, Transmittance->GetUAV());
+			context.Dispatch2D(Transmittance->GetWidth(), Transmittance->GetHeight());
+		});
+		graph.Write(pass, transmittance, uav);
 
 		// Precompute direct ground irradiance
-		context.TransitionResource(*InterIrradiance, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-		context.TransitionResource(*Irradiance, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-		context.SetPipelineState(DirectIrradiancePSO);
-		context.SetDynamicDescriptor(1, 0, InterIrradiance->GetUAV());
-		context.SetDynamicDescriptor(1, 1, Irradiance->GetUAV());
-		context.SetDynamicDescriptor(2, 0, Transmittance->GetSRV());
-		context.Dispatch2D(IRRADIANCE_TEXTURE_WIDTH, IRRADIANCE_TEXTURE_HEIGHT);
-		
-		// Precompute single rayleigh and single mie
-		context.TransitionResource(*Transmittance, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-		context.TransitionResource(*InterRayleighScattering, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-		context.TransitionResource(*InterMieScattering, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-		context.TransitionResource(*Scattering, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-		if (!UseCombinedTextures)
-			context.TransitionResource(*OptionalSingleMieScattering, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-		context.SetPipelineState(SingleScatteringPSO);
-		context.SetDynamicConstantBufferView(4, sizeof(LuminanceFromRadiance), &LuminanceFromRadiance);
-		context.SetDynamicDescriptor(1, 0, InterRayleighScattering->GetUAV());
-		context.SetDynamicDescriptor(1, 1, InterMieScattering->GetUAV());
-		context.SetDynamicDescriptor(1, 2, Scattering->GetUAV());
-		if (!UseCombinedTextures)
-			context.SetDynamicDescriptor(1, 3, OptionalSingleMieScattering->GetUAV());
-		context.SetDynamicDescriptor(2, 0, Transmittance->GetSRV());
-		context.Dispatch3D(SCATTERING_TEXTURE_WIDTH, SCATTERING_TEXTURE_HEIGHT, SCATTERING_TEXTURE_DEPTH, 8, 8, 8);
-
-		// Compute 2nd, 3rd, 4th... scattering
-		context.TransitionResource(*InterMieScattering, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-		//context.TransitionResource(*Irradiance, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-		for (uint32_t scattering_order = 2; scattering_order <= numScatteringOrders; ++scattering_order)
+		pass = graph.AddPass("Direct Irradiance", [](CommandContext& commandContext)
 		{
-			// Compute scattering density, store the value in InterScatteringDensity texture
-			context.TransitionResource(*InterScatteringDensity, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-			context.TransitionResource(*InterRayleighScattering, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-			context.TransitionResource(*InterIrradiance, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-			context.SetPipelineState(ScatteringDensityPSO);
-			context.SetDynamicConstantBufferView(0, sizeof(scattering_order), &scattering_order);
-			context.SetDynamicDescriptor(1, 0, InterScatteringDensity->GetUAV());
-			context.SetDynamicDescriptor(2, 0, Transmittance->GetSRV());
-			context.SetDynamicDescriptor(2, 1, InterRayleighScattering->GetSRV());
-			context.SetDynamicDescriptor(2, 2, InterMieScattering->GetSRV());
-			context.SetDynamicDescriptor(2, 3, InterRayleighScattering->GetSRV());
-			context.SetDynamicDescriptor(2, 4, InterIrradiance->GetSRV());
-			context.Dispatch3D(SCATTERING_TEXTURE_WIDTH, SCATTERING_TEXTURE_HEIGHT, SCATTERING_TEXTURE_DEPTH);
-
-			// Compute indirect ground irradiance
-			context.TransitionResource(*InterIrradiance, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-			context.SetPipelineState(IndirectIrradiancePSO);
+			ComputeContext& context = commandContext.GetComputeContext();
+			context.SetPipelineState(DirectIrradiancePSO);
 			context.SetDynamicDescriptor(1, 0, InterIrradiance->GetUAV());
 			context.SetDynamicDescriptor(1, 1, Irradiance->GetUAV());
-			context.SetDynamicDescriptor(2, 0, InterRayleighScattering->GetSRV());
-			context.SetDynamicDescriptor(2, 1, InterMieScattering->GetSRV());
-			context.SetDynamicDescriptor(2, 2, InterRayleighScattering->GetSRV());
+			context.SetDynamicDescriptor(2, 0, Transmittance->GetSRV());
 			context.Dispatch2D(IRRADIANCE_TEXTURE_WIDTH, IRRADIANCE_TEXTURE_HEIGHT);
+		});
+		graph.Read(pass, transmittance, srv);
+		graph.Write(pass, inter_irradiance, uav);
+		graph.Write(pass, irradiance, uav);
 
-			// Compute multiple scattering, store in inter
-			context.TransitionResource(*InterRayleighScattering, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-			context.TransitionResource(*Scattering, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-			context.TransitionResource(*InterScatteringDensity, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-			context.SetPipelineState(MultipleScatteringPSO);
+		// Precompute single rayleigh and single mie
+		pass = graph.AddPass("Single Scattering", [](CommandContext& commandContext)
+		{
+			ComputeContext& context = commandContext.GetComputeContext();
+			context.SetPipelineState(SingleScatteringPSO);
 			context.SetDynamicDescriptor(1, 0, InterRayleighScattering->GetUAV());
-			context.SetDynamicDescriptor(1, 1, Scattering->GetUAV());
+			context.SetDynamicDescriptor(1, 1, InterMieScattering->GetUAV());
+			context.SetDynamicDescriptor(1, 2, Scattering->GetUAV());
+			if (!UseCombinedTextures)
+				context.SetDynamicDescriptor(1, 3, OptionalSingleMieScattering->GetUAV());
 			context.SetDynamicDescriptor(2, 0, Transmittance->GetSRV());
-			context.SetDynamicDescriptor(2, 1, InterScatteringDensity->GetSRV());
-			context.Dispatch3D(SCATTERING_TEXTURE_WIDTH, SCATTERING_TEXTURE_HEIGHT, SCATTERING_TEXTURE_DEPTH);
-		}	
+			context.Dispatch3D(SCATTERING_TEXTURE_WIDTH, SCATTERING_TEXTURE_HEIGHT, SCATTERING_TEXTURE_DEPTH, 8, 8, 8);
+		});
+		graph.Read(pass, transmittance, srv);
+		graph.Write(pass, inter_rayleigh, uav);
+		graph.Write(pass, inter_mie, uav);
+		graph.Write(pass, scattering, uav);
+		if (!UseCombinedTextures)
+			graph.Write(pass, single_mie, uav);
 
-		context.TransitionResource(*Transmittance, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
-		context.TransitionResource(*Scattering, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
-		context.TransitionResource(*OptionalSingleMieScattering, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
-		context.TransitionResource(*Irradiance, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+		// Compute 2nd, 3rd, 4th... scattering
+		for (uint32_t scattering_order = 2; scattering_order <= numScatteringOrders; ++scattering_order)
+		{
+			// Compute scattering density, store the value in InterScatteringDensity texture
+			pass = graph.AddPass("Scattering Density " + std::to_string(scattering_order), [scattering_order](CommandContext& commandContext)
+			{
+				ComputeContext& context = commandContext.GetComputeContext();
+				context.SetPipelineState(ScatteringDensityPSO);
+				context.SetDynamicConstantBufferView(0, sizeof(scattering_order), &scattering_order);
+				context.SetDynamicDescriptor(1, 0, InterScatteringDensity->GetUAV());
+				context.SetDynamicDescriptor(2, 0, Transmittance->GetSRV());
+				context.SetDynamicDescriptor(2, 1, InterRayleighScattering->GetSRV());
+				context.SetDynamicDescriptor(2, 2, InterMieScattering->GetSRV());
+				context.SetDynamicDescriptor(2, 3, InterRayleighScattering->GetSRV());
+				context.SetDynamicDescriptor(2, 4, InterIrradiance->GetSRV());
+				context.Dispatch3D(SCATTERING_TEXTURE_WIDTH, SCATTERING_TEXTURE_HEIGHT, SCATTERING_TEXTURE_DEPTH);
+			});
+			graph.Read(pass, transmittance, srv);
+			graph.Read(pass, inter_rayleigh, srv);
+			graph.Read(pass, inter_mie, srv);
+			graph.Read(pass, inter_irradiance, srv);
+			graph.Write(pass, inter_density, uav);
+
+			// Compute indirect ground irradiance, accumulated into Irradiance
+			pass = graph.AddPass("Indirect Irradiance " + std::to_string(scattering_order), [scattering_order](CommandContext& commandContext)
+			{
+				ComputeContext& context = commandContext.GetComputeContext();
+				context.SetPipelineState(IndirectIrradiancePSO);
+				context.SetDynamicConstantBufferView(0, sizeof(scattering_order), &scattering_order);
+				context.SetDynamicDescriptor(1, 0, InterIrradiance->GetUAV());
+				context.SetDynamicDescriptor(1, 1, Irradiance->GetUAV());
+				context.SetDynamicDescriptor(2, 0, InterRayleighScattering->GetSRV());
+				context.SetDynamicDescriptor(2, 1, InterMieScattering->GetSRV());
+				context.SetDynamicDescriptor(2, 2, InterRayleighScattering->GetSRV());
+				context.Dispatch2D(IRRADIANCE_TEXTURE_WIDTH, IRRADIANCE_TEXTURE_HEIGHT);
+			});
+			graph.Read(pass, inter_rayleigh, srv);
+			graph.Read(pass, inter_mie, srv);
+			graph.Write(pass, inter_irradiance, uav);
+			graph.Write(pass, irradiance, uav);
+
+			// Compute multiple scattering, store in inter, accumulated into Scattering
+			pass = graph.AddPass("Multiple Scattering " + std::to_string(scattering_order), [scattering_order](CommandContext& commandContext)
+			{
+				ComputeContext& context = commandContext.GetComputeContext();
+				context.SetPipelineState(MultipleScatteringPSO);
+				context.SetDynamicConstantBufferView(0, sizeof(scattering_order), &scattering_order);
+				context.SetDynamicDescriptor(1, 0, InterRayleighScattering->GetUAV());
+				context.SetDynamicDescriptor(1, 1, Scattering->GetUAV());
+				context.SetDynamicDescriptor(2, 0, Transmittance->GetSRV());
+				context.SetDynamicDescriptor(2, 1, InterScatteringDensity->GetSRV());
+				context.Dispatch3D(SCATTERING_TEXTURE_WIDTH, SCATTERING_TEXTURE_HEIGHT, SCATTERING_TEXTURE_DEPTH);
+			});
+			graph.Read(pass, transmittance, srv);
+			graph.Read(pass, inter_density, srv);
+			graph.Write(pass, inter_rayleigh, uav);
+			graph.Write(pass, scattering, uav);
+		}
+	}
 
+	void Precompute(ComputeContext& context, FrameGraphExecutor& graph, const Vector3& lambdas)
+	{
+		// every stage shares the root signature and the constants of these wavelengths
+		context.SetRootSignature(PrecomputeRS);
+		context.SetDynamicConstantBufferView(3, sizeof(AtmospherePhysicalCB), &AtmospherePhysicalCB);
+		context.SetDynamicConstantBufferView(4, sizeof(LuminanceFromRadiance), &LuminanceFromRadiance);
+		graph.Execute(context);
 	}
 
 	float InterpolateByLambda(const std::vector<double>& wavelengthFunction, double wavelength)
@@ -611,6 +763,16 @@ namespace Atmosphere
 				Precompute(4);
 				++i;
 			}
+			if (PrecomputeGraph.GetNumPasses() > 0 && ImGui::TreeNode("Precompute Barriers"))
+			{
+				ImGui::TextUnformatted(PrecomputeGraph.DumpSchedule().c_str());
+				ImGui::TreePop();
+			}
+			if (!IntermediatePlan.empty() && ImGui::TreeNode("Precompute Memory"))
+			{
+				ImGui::TextUnformatted(IntermediatePlan.c_str());
+				ImGui::TreePop();
+			}
 			ImGui::End();
 		}
 	}
@@ -0,0 +1,181 @@
+#include "stdafx.h"
+#include "AllocatorBenchmark.h"
+#include "PageCache.h"
+#include "PageMemory.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+	const size_t kPageSize = 0x200000;
+
+	struct FakePage
+	{
+		FakePage(bool largePages)
+		{
+			ptr = (uint8_t*)PageMemory::Allocate(kPageSize, largePages, kind);
+		}
+
+		~FakePage()
+		{
+			PageMemory::Free(ptr, kPageSize, kind);
+		}
+
+		uint8_t* ptr;
+		PageMemory::Kind kind;
+		// the fence it was last retired with
+		uint64_t fenceValue = 0;
+	};
+
+	AllocatorBenchmark::Result RunAllocator(const AllocatorBenchmark::Desc& desc, uint32_t refillCount)
+	{
+		PageCache<FakePage> cache(refillCount);
+		std::mutex page_mutex;
+		std::vector<std::unique_ptr<FakePage>> pages;
+		PageMemory::Stats memory_before = PageMemory::GetStats();
+
+		const uint32_t num_threads = std::max(desc.numThreads, 1u);
+		const size_t allocation_size = std::min(std::max<size_t>(desc.allocationSize, 1), kPageSize);
+		std::vector<std::atomic<uint64_t>> progress(num_threads);
+		for (auto& p : progress)
+			p.store(0);
+		std::atomic<uint64_t> completed(0);
+		std::atomic<uint32_t> running(num_threads);
+		std::atomic<uint64_t> early_reuses(0);
+		std::vector<double> request_seconds(num_threads, 0.0);
+
+		auto is_complete = [&completed](uint64_t fenceValue) { return fenceValue <= completed.load(std::memory_order_acquire); };
+
+		// the GPU finishes a frame once every thread recorded framesInFlight frames past it
+		std::thread gpu([&]()
+		{
+			while (running.load(std::memory_order_acquire) > 0)
+			{
+				uint64_t slowest = UINT64_MAX;
+				for (auto& p : progress)
+					slowest = std::min(slowest, p.load(std::memory_order_acquire));
+				if (slowest > desc.framesInFlight)
+					completed.store(slowest - desc.framesInFlight, std::memory_order_release);
+				std::this_thread::yield();
+			}
+		});
+
+		auto start = std::chrono::high_resolution_clock::now();
+		std::vector<std::thread> threads;
+		for (uint32_t t = 0; t < num_threads; ++t)
+		{
+			threads.emplace_back([&, t]()
+			{
+				std::vector<FakePage*> used_pages;
+				for (uint64_t frame = 1; frame <= desc.framesPerThread; ++frame)
+				{
+					// a CPU too far ahead waits for the GPU like Present would
+					while (frame > completed.load(std::memory_order_acquire) + 2 * (uint64_t)desc.framesInFlight + 1)
+						std::this_thread::yield();
+
+					// DynamicAllocator::Allocate, a page per command list and a new one when it is full
+					FakePage* page = nullptr;
+					size_t offset = kPageSize;
+					for (uint32_t i = 0; i < desc.allocationsPerFrame; ++i)
+					{
+						if (offset + allocation_size > kPageSize)
+						{
+							auto t0 = std::chrono::high_resolution_clock::now();
+							page = cache.Request(is_complete, [&]()
+							{
+								FakePage* created = new FakePage(desc.largePages);
+								std::lock_guard<std::mutex> lockGuard(page_mutex);
+								pages.emplace_back(created);
+								return created;
+							});
+							request_seconds[t] += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - t0).count();
+							if (page->fenceValue > completed.load(std::memory_order_acquire))
+								early_reuses.fetch_add(1, std::memory_order_relaxed);
+							used_pages.push_back(page);
+							offset = 0;
+						}
+						memset(page->ptr + offset, (int)i, allocation_size);
+						offset += allocation_size;
+					}
+					for (FakePage* used : used_pages)
+						used->fenceValue = frame;
+					cache.Retire(frame, used_pages);
+					cache.AddBytes((uint64_t)desc.allocationsPerFrame * allocation_size);
+					used_pages.clear();
+					progress[t].store(frame, std::memory_order_release);
+				}
+				running.fetch_sub(1, std::memory_order_release);
+			});
+		}
+		for (auto& thread : threads)
+			thread.join();
+		double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+		gpu.join();
+		cache.EndFrame();
+
+		AllocatorBenchmark::Result result = {};
+		const double allocations = (double)num_threads * desc.framesPerThread * desc.allocationsPerFrame;
+		double request_total = 0.0;
+		for (double s : request_seconds)
+			request_total += s;
+		PageCache<FakePage>::Stats stats = cache.GetStats();
+		result.seconds = seconds;
+		result.allocationsPerSecond = allocations / std::max(seconds, 1e-9);
+		result.requestNanoseconds = request_total * 1e9 / std::max(allocations, 1.0);
+		result.requests = stats.requests;
+		result.cacheHits = stats.cacheHits;
+		result.refills = stats.refills;
+		result.created = stats.created;
+		result.pagesInFlight = stats.pagesInFlight;
+		// every thread records every frame
+		result.bytesPerFrame = stats.bytesAllocated / std::max(desc.framesPerThread, 1u);
+		for (auto& page : pages)
+		{
+			result.largePages += page->kind == PageMemory::kLarge;
+			result.transparentPages += page->kind == PageMemory::kTransparent;
+		}
+		result.largePageFallbacks = PageMemory::GetStats().largePageFallbacks - memory_before.largePageFallbacks;
+		result.violations.Add("early reuses", early_reuses.load());
+		return result;
+	}
+}
+
+AllocatorBenchmark::Desc AllocatorBenchmark::DefaultDesc()
+{
+	Desc desc;
+	desc.numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+	desc.framesPerThread = 500;
+	// 64 KB uploads, 4 pages a frame per thread
+	desc.allocationsPerFrame = 128;
+	desc.allocationSize = 0x10000;
+	desc.framesInFlight = 2;
+	desc.refillCount = 4;
+	desc.largePages = true;
+	return desc;
+}
+
+AllocatorBenchmark::Report AllocatorBenchmark::Run(const Desc& desc)
+{
+	Report report;
+	report.desc = desc;
+	report.threadCache = RunAllocator(desc, std::max(desc.refillCount, 1u));
+	report.sharedOnly = RunAllocator(desc, 1);
+	report.violations.Merge(report.threadCache.violations, "thread cache ");
+	report.violations.Merge(report.sharedOnly.violations, "shared only ");
+	return report;
+}
+
+std::string AllocatorBenchmark::Summarize(const Report& report)
+{
+	char line[256];
+	snprintf(line, sizeof(line), "%u threads, %.1f M allocations / s against %.1f M without thread caches, %llu pages created, %llu large",
+		report.desc.numThreads, report.threadCache.allocationsPerSecond * 1e-6, report.sharedOnly.allocationsPerSecond * 1e-6,
+		(unsigned long long)report.threadCache.created, (unsigned long long)report.threadCache.largePages);
+	return line;
+}
\ No newline at end of file
@@ -0,0 +1,61 @@
+#pragma once
+#include "Utils/SelfTest.h"
+#include <cstdint>
+#include <string>
+
+// Many recording threads bump allocating from 2 MB pages the way DynamicAllocator does, with
+// the pages from a PageCache over PageMemory and a fake fence. Every thread records frames
+// of allocationsPerFrame allocations, touches each one, and retires its pages with the fence
+// value of the frame. A fake GPU thread completes a frame once every thread recorded
+// framesInFlight frames past it. Runs the same schedule with the thread caches and without
+// them (a refill count of 1, one trip to the recycler per page), and checks that no page
+// comes back before its fence completed.
+class AllocatorBenchmark
+{
+public:
+	struct Desc
+	{
+		uint32_t numThreads;
+		uint32_t framesPerThread;
+		uint32_t allocationsPerFrame;
+		uint32_t allocationSize;
+		uint32_t framesInFlight;
+		// pages a thread takes from the recycler at once
+		uint32_t refillCount;
+		bool largePages;
+	};
+
+	struct Result
+	{
+		double seconds;
+		double allocationsPerSecond;
+		// the part of an allocation spent getting a page
+		double requestNanoseconds;
+		uint64_t requests;
+		uint64_t cacheHits;
+		uint64_t refills;
+		// pages made because none was free
+		uint64_t created;
+		uint64_t pagesInFlight;
+		uint64_t bytesPerFrame;
+		// how the created pages were mapped
+		uint64_t largePages;
+		uint64_t transparentPages;
+		uint64_t largePageFallbacks;
+		// "early reuses", pages handed out again before their fence completed
+		SelfTest::Violations violations;
+	};
+
+	struct Report
+	{
+		Desc desc;
+		Result threadCache;
+		Result sharedOnly;
+		// of both
+		SelfTest::Violations violations;
+	};
+
+	static Desc DefaultDesc();
+	static Report Run(const Desc& desc);
+	static std::string Summarize(const Report& report);
+};
\ No newline at end of file
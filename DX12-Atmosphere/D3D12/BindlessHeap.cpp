@@ -0,0 +1,233 @@
+#include "stdafx.h"
+#include "BindlessHeap.h"
+#include "CommandListManager.h"
+#include "DescriptorFreeList.h"
+#include "FenceRecycler.h"
+#include <deque>
+#include <unordered_map>
+
+namespace BindlessHeap
+{
+	Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> Heap;
+	// the heaps it grew out of, a context Reset binds the heaps of its last command list
+	// again before it sets new ones
+	std::vector<Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>> OldHeaps;
+	DescriptorHandle HeapStart;
+	uint32_t DescriptorSize = 0;
+
+	// Indices, Registered and the counters
+	std::mutex Mutex;
+	// one block, the persistent part of the heap
+	DescriptorFreeList Indices(kNumPersistent);
+	// a registered SRV by the ptr of its CPU handle
+	std::unordered_map<SIZE_T, DescriptorFreeList::Handle> Registered;
+	uint64_t RegistrationCopies = 0;
+	uint64_t RegistrationCopiesLastFrame = 0;
+	uint64_t FrameStartCopies = 0;
+
+	// a deque keeps the pages where they are as it grows, RetiredPages points at them
+	std::deque<Page> Pages;
+	FenceRecycler<Page> RetiredPages;
+	std::atomic<uint32_t> PagesInUse(0);
+	// the most in use at once since the last EndFrame
+	std::atomic<uint32_t> PeakPagesInUse(0);
+	std::atomic<uint32_t> Fallbacks(0);
+	uint32_t FallbacksLastFrame = 0;
+
+	void CreateHeap(uint32_t numPages);
+	void CopyToNewIndex(D3D12_CPU_DESCRIPTOR_HANDLE handle, DescriptorFreeList::Handle& index);
+	void FreeIndex(const DescriptorFreeList::Handle& index);
+}
+
+void BindlessHeap::CreateHeap(uint32_t numPages)
+{
+	D3D12_DESCRIPTOR_HEAP_DESC desc = {};
+	desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
+	desc.NumDescriptors = kNumPersistent + numPages * kPageSize;
+	desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
+	desc.NodeMask = 1;
+	if (Heap != nullptr)
+		OldHeaps.push_back(Heap);
+	ThrowIfFailed(g_Device->CreateDescriptorHeap(&desc, IID_PPV_ARGS(&Heap)));
+	Heap->SetName(L"BindlessHeap");
+	HeapStart = DescriptorHandle(Heap->GetCPUDescriptorHandleForHeapStart(), Heap->GetGPUDescriptorHandleForHeapStart());
+
+	// the persistent part of a bigger heap starts out empty
+	for (const auto& registered : Registered)
+	{
+		D3D12_CPU_DESCRIPTOR_HANDLE handle = { registered.first };
+		g_Device->CopyDescriptorsSimple(1, (HeapStart + registered.second.index * DescriptorSize).GetCpuHandle(), handle, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+		++RegistrationCopies;
+	}
+
+	// the pages there were keep their offsets, the new ones start out free, fence 0 is
+	// always complete
+	std::vector<Page*> pages;
+	for (uint32_t i = (uint32_t)Pages.size(); i < numPages; ++i)
+	{
+		Pages.push_back({ kNumPersistent + i * kPageSize });
+		pages.push_back(&Pages.back());
+	}
+	RetiredPages.Retire(0, pages);
+}
+
+// the copy may be read by lists of any queue, bindless compute passes included
+void BindlessHeap::FreeIndex(const DescriptorFreeList::Handle& index)
+{
+	uint64_t fence_values[DescriptorFreeList::kMaxFences];
+	g_CommandManager.GetRetireFenceValues(fence_values);
+	Indices.Free(index, fence_values);
+}
+
+bool BindlessHeap::Create()
+{
+	assert(!IsCreated());
+	D3D12_FEATURE_DATA_D3D12_OPTIONS options = {};
+	if (FAILED(g_Device->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS, &options, sizeof(options))) ||
+		options.ResourceBindingTier < D3D12_RESOURCE_BINDING_TIER_2)
+		return false;
+
+	DescriptorSize = g_Device->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+	std::lock_guard<std::mutex> lockGuard(Mutex);
+	CreateHeap(kInitialPages);
+	return true;
+}
+
+void BindlessHeap::Destroy()
+{
+	std::lock_guard<std::mutex> lockGuard(Mutex);
+	Registered.clear();
+	Indices.Reset();
+	Heap = nullptr;
+	OldHeaps.clear();
+}
+
+bool BindlessHeap::IsCreated()
+{
+	return Heap != nullptr;
+}
+
+ID3D12DescriptorHeap* BindlessHeap::GetHeap()
+{
+	return Heap.Get();
+}
+
+D3D12_GPU_DESCRIPTOR_HANDLE BindlessHeap::GetTableStart()
+{
+	return HeapStart.GetGpuHandle();
+}
+
+void BindlessHeap::CopyToNewIndex(D3D12_CPU_DESCRIPTOR_HANDLE handle, DescriptorFreeList::Handle& index)
+{
+	Indices.Reclaim([](uint64_t fenceValue) { return g_CommandManager.IsFenceComplete(fenceValue); });
+	bool new_block = false;
+	index = Indices.Allocate(1, new_block);
+	// a second block would have no descriptors behind it
+	if (Indices.GetNumBlocks() > 1)
+	{
+		assert(false && "bindless heap full");
+		ThrowIfFailed(E_OUTOFMEMORY);
+	}
+	g_Device->CopyDescriptorsSimple(1, (HeapStart + index.index * DescriptorSize).GetCpuHandle(), handle, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+	++RegistrationCopies;
+}
+
+uint32_t BindlessHeap::Register(D3D12_CPU_DESCRIPTOR_HANDLE handle)
+{
+	assert(IsCreated() && handle.ptr != D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN);
+	std::lock_guard<std::mutex> lockGuard(Mutex);
+	auto it = Registered.find(handle.ptr);
+	if (it != Registered.end())
+		return it->second.index;
+
+	DescriptorFreeList::Handle index;
+	CopyToNewIndex(handle, index);
+	Registered.emplace(handle.ptr, index);
+	return index.index;
+}
+
+void BindlessHeap::Refresh(D3D12_CPU_DESCRIPTOR_HANDLE handle)
+{
+	if (!IsCreated())
+		return;
+	std::lock_guard<std::mutex> lockGuard(Mutex);
+	auto it = Registered.find(handle.ptr);
+	if (it == Registered.end())
+		return;
+	FreeIndex(it->second);
+	CopyToNewIndex(handle, it->second);
+}
+
+void BindlessHeap::Unregister(D3D12_CPU_DESCRIPTOR_HANDLE handle)
+{
+	if (!IsCreated())
+		return;
+	std::lock_guard<std::mutex> lockGuard(Mutex);
+	auto it = Registered.find(handle.ptr);
+	if (it == Registered.end())
+		return;
+	FreeIndex(it->second);
+	Registered.erase(it);
+}
+
+BindlessHeap::Page* BindlessHeap::RequestPage()
+{
+	auto is_complete = [](uint64_t fenceValue) { return g_CommandManager.IsFenceComplete(fenceValue); };
+	Page* page = RetiredPages.Acquire(is_complete);
+	if (page == nullptr)
+	{
+		// the rest is in frames in flight, or in contexts still recording. Those can't
+		// move to a bigger heap halfway, EndFrame grows it before the next frame.
+		++Fallbacks;
+		return nullptr;
+	}
+	uint32_t in_use = ++PagesInUse;
+	uint32_t peak = PeakPagesInUse.load(std::memory_order_relaxed);
+	while (in_use > peak && !PeakPagesInUse.compare_exchange_weak(peak, in_use, std::memory_order_relaxed))
+	{
+	}
+	return page;
+}
+
+void BindlessHeap::DiscardPages(uint64_t fenceValue, const std::vector<Page*>& pages)
+{
+	PagesInUse -= (uint32_t)pages.size();
+	RetiredPages.Retire(fenceValue, pages);
+}
+
+DescriptorHandle BindlessHeap::GetPageStart(const Page* page)
+{
+	return HeapStart + page->offset * DescriptorSize;
+}
+
+void BindlessHeap::EndFrame()
+{
+	std::lock_guard<std::mutex> lockGuard(Mutex);
+	uint32_t num_pages = (uint32_t)Pages.size();
+	FallbacksLastFrame = Fallbacks.exchange(0);
+	if (IsCreated() && (PeakPagesInUse.load() * 2 > num_pages || FallbacksLastFrame > 0) && num_pages < kMaxPages)
+	{
+		// the tables contexts keep across frames are in the old heap, the epoch drops them
+		g_CommandManager.IdleGPU();
+		CreateHeap(std::min(num_pages * 2, kMaxPages));
+		DescriptorAllocator::ViewsChanged();
+	}
+	PeakPagesInUse = PagesInUse.load();
+	RegistrationCopiesLastFrame = RegistrationCopies - FrameStartCopies;
+	FrameStartCopies = RegistrationCopies;
+}
+
+BindlessHeap::Stats BindlessHeap::GetStats()
+{
+	std::lock_guard<std::mutex> lockGuard(Mutex);
+	Stats stats;
+	stats.registered = (uint32_t)Registered.size();
+	stats.capacity = kNumPersistent;
+	stats.pending = Indices.GetStats().pending;
+	stats.pagesInUse = PagesInUse.load();
+	stats.pages = (uint32_t)Pages.size();
+	stats.registrationCopies = RegistrationCopies;
+	stats.registrationCopiesLastFrame = RegistrationCopiesLastFrame;
+	stats.fallbacksLastFrame = FallbacksLastFrame;
+	return stats;
+}
\ No newline at end of file
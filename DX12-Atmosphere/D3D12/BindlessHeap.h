@@ -0,0 +1,74 @@
+#pragma once
+#include "stdafx.h"
+#include "DescriptorHeap.h"
+
+// One shader visible CBV_SRV_UAV heap for the whole frame. The front holds a copy of every
+// SRV a pass asked an index for, made once at Register and kept until its descriptor is
+// freed, so a bindless pass binds the heap start as an unbounded table and reads its
+// textures by index from root constants. The back is cut into pages of 1024 that the
+// DynamicDescriptorHeap of each context fills instead of heaps of its own, the tables
+// still copied per draw live in the same heap and nothing switches heaps in between.
+// A frame that used more than half of the pages, or ran out of them, doubles them at
+// EndFrame: a new heap with the same layout in front and the registered SRVs copied again,
+// the old one is kept until Destroy. Until then a context that finds no free page copies
+// its tables to heaps of its own for the rest of its command list. The persistent indices come from a DescriptorFreeList, a freed index is
+// reused once the frames that may still read it completed on every queue.
+// Needs resource binding tier 2 for a table over the whole heap, Create returns false
+// below it and everything stays on the dynamic tables. Opt in, see App::SetBindless.
+namespace BindlessHeap
+{
+	const uint32_t kNumPersistent = 16384;
+	const uint32_t kPageSize = 1024;
+	const uint32_t kInitialPages = 128;
+	// the 1000000 descriptors of a shader visible heap at binding tier 2
+	const uint32_t kMaxPages = (1000000 - kNumPersistent) / kPageSize;
+
+	struct Page
+	{
+		// in descriptors from the heap start
+		uint32_t offset;
+	};
+
+	struct Stats
+	{
+		uint32_t registered;
+		uint32_t capacity;
+		// indices freed and waiting for their fence
+		uint64_t pending;
+		uint32_t pagesInUse;
+		uint32_t pages;
+		// descriptors copied into the persistent part, by Register and Refresh
+		uint64_t registrationCopies;
+		uint64_t registrationCopiesLastFrame;
+		// pages asked for when none was free, the context fell back to a heap of its own
+		uint32_t fallbacksLastFrame;
+	};
+
+	// Once, after the device
+	bool Create();
+	void Destroy();
+	bool IsCreated();
+
+	ID3D12DescriptorHeap* GetHeap();
+	// The first descriptor of the heap, the base of every bindless table
+	D3D12_GPU_DESCRIPTOR_HANDLE GetTableStart();
+
+	// The index of the shader visible copy of an SRV, copied on the first call only
+	uint32_t Register(D3D12_CPU_DESCRIPTOR_HANDLE handle);
+	// After a view was written again into a registered handle: the copy moves to a new
+	// index, the old one may still be read by the frames in flight
+	void Refresh(D3D12_CPU_DESCRIPTOR_HANDLE handle);
+	// From DescriptorAllocator::Free, the index is reused after the lists being recorded
+	void Unregister(D3D12_CPU_DESCRIPTOR_HANDLE handle);
+
+	// A page whose last use completed, for DynamicDescriptorHeap. The pages only grow
+	// between frames, nullptr when all of them are in use.
+	Page* RequestPage();
+	void DiscardPages(uint64_t fenceValue, const std::vector<Page*>& pages);
+	DescriptorHandle GetPageStart(const Page* page);
+
+	// After the GPU went idle and between command lists, the only pages held then are the
+	// cached tables of DynamicDescriptorHeap, which a new heap drops through the view epoch
+	void EndFrame();
+	Stats GetStats();
+}
\ No newline at end of file
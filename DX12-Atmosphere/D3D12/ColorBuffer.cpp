@@ -5,15 +5,25 @@
 #include "PipelineState.h"
 #include "GraphicsGlobal.h"
 
+ColorBuffer::~ColorBuffer()
+{
+	FreeDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_RTV, m_rtvHandle);
+	FreeDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, m_srvHandle);
+	for (auto& uav : m_uavHandle)
+		FreeDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, uav);
+}
+
 void ColorBuffer::CreateFromSwapChain(const std::wstring& name, ID3D12Resource* baseResource)
 {
 	AssociateWithResource(g_Device, name, baseResource, D3D12_RESOURCE_STATE_PRESENT);
 
-	m_rtvHandle = AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
-	g_Device->CreateRenderTargetView(m_pResource.Get(), nullptr, m_rtvHandle);
+	// OnResize comes back here with the same buffers
+	if (m_rtvHandle.IsNull())
+		m_rtvHandle = AllocateDescriptorHandle(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
+	g_Device->CreateRenderTargetView(m_pResource.Get(), nullptr, GetRTV());
 }
 
-void ColorBuffer::Create(const std::wstring& name, uint32_t width, uint32_t height, uint32_t numMips, DXGI_FORMAT format, D3D12_GPU_VIRTUAL_ADDRESS vidMemPtr /* = D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN */)
+D3D12_RESOURCE_DESC ColorBuffer::Describe(uint32_t width, uint32_t height, uint32_t& numMips, DXGI_FORMAT format, D3D12_CLEAR_VALUE& clearValue)
 {
 	numMips = (numMips == 0 ? ComputeNumMips(width, height) : numMips);
 	D3D12_RESOURCE_FLAGS flags = CombineResourceFlags();
@@ -22,17 +32,38 @@ void ColorBuffer::Create(const std::wstring& name, uint32_t width, uint32_t heig
 	resourceDesc.SampleDesc.Count = m_fragmentCount;
 	resourceDesc.SampleDesc.Quality = 0;
 
-	D3D12_CLEAR_VALUE clearValue = {};
+	clearValue = {};
 	clearValue.Format = format;
 	clearValue.Color[0] = m_clearColor.R();
 	clearValue.Color[1] = m_clearColor.G();
 	clearValue.Color[2] = m_clearColor.B();
 	clearValue.Color[3] = m_clearColor.A();
+	return resourceDesc;
+}
 
+void ColorBuffer::Create(const std::wstring& name, uint32_t width, uint32_t height, uint32_t numMips, DXGI_FORMAT format, D3D12_GPU_VIRTUAL_ADDRESS vidMemPtr /* = D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN */)
+{
+	D3D12_CLEAR_VALUE clearValue;
+	D3D12_RESOURCE_DESC resourceDesc = Describe(width, height, numMips, format, clearValue);
 	CreateTextureResource(g_Device, name, resourceDesc, clearValue, vidMemPtr);
 	CreateDerivedViews(g_Device, format, 1, numMips);
 }
 
+void ColorBuffer::CreatePlaced(const std::wstring& name, ID3D12Heap* heap, uint64_t heapOffset, uint32_t width, uint32_t height, uint32_t numMips, DXGI_FORMAT format)
+{
+	D3D12_CLEAR_VALUE clearValue;
+	D3D12_RESOURCE_DESC resourceDesc = Describe(width, height, numMips, format, clearValue);
+	CreatePlacedTextureResource(g_Device, name, resourceDesc, clearValue, heap, heapOffset);
+	CreateDerivedViews(g_Device, format, 1, numMips);
+}
+
+D3D12_RESOURCE_ALLOCATION_INFO ColorBuffer::GetAllocationInfo(uint32_t width, uint32_t height, uint32_t numMips, DXGI_FORMAT format)
+{
+	D3D12_CLEAR_VALUE clearValue;
+	D3D12_RESOURCE_DESC resourceDesc = Describe(width, height, numMips, format, clearValue);
+	return g_Device->GetResourceAllocationInfo(0, 1, &resourceDesc);
+}
+
 void ColorBuffer::CreateArray(const std::wstring& name, uint32_t width, uint32_t height, uint32_t arrayCount, DXGI_FORMAT format, D3D12_GPU_VIRTUAL_ADDRESS vidMemPtr /* = D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN */)
 {
 	D3D12_RESOURCE_FLAGS flags = CombineResourceFlags();
@@ -49,6 +80,20 @@ void ColorBuffer::CreateArray(const std::wstring& name, uint32_t width, uint32_t
 	CreateDerivedViews(g_Device, format, arrayCount, 1);
 }
 
+void ColorBuffer::CreateCube(const std::wstring& name, uint32_t size, DXGI_FORMAT format, D3D12_GPU_VIRTUAL_ADDRESS vidMemPtr /* = D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN */)
+{
+	CreateArray(name, size, size, 6, format, vidMemPtr);
+
+	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = format;
+	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+	srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURECUBE;
+	srvDesc.TextureCube.MipLevels = 1;
+	srvDesc.TextureCube.MostDetailedMip = 0;
+	g_Device->CreateShaderResourceView(m_pResource.Get(), &srvDesc, GetSRV());
+	RefreshDescriptor(GetSRV());
+}
+
 void ColorBuffer::GenerateMipMaps(CommandContext& baseContext)
 {
 	if (m_numMipMaps == 0)
@@ -58,7 +103,7 @@ void ColorBuffer::GenerateMipMaps(CommandContext& baseContext)
 
 	context.SetRootSignature(Global::GenerateMipsRS);
 	context.TransitionResource(*this, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-	context.SetDynamicDescriptor(1, 0, m_srvHandle);
+	context.SetDynamicDescriptor(1, 0, GetSRV());
 
 	for (uint32_t topMip = 0; topMip < m_numMipMaps; )
 	{
@@ -87,7 +132,10 @@ void ColorBuffer::GenerateMipMaps(CommandContext& baseContext)
 		context.SetConstants(0, topMip, numMips, 1.0f / dstWidth, 1.0f / dstHeight);
 		context.SetConstant(0, 1.0f / dstWidth, 4);
 		context.SetConstant(0, 1.0f / dstHeight, 5);
-		context.SetDynamicDescriptors(2, 0, numMips, m_uavHandle + topMip + 1);
+		D3D12_CPU_DESCRIPTOR_HANDLE uavs[4];
+		for (uint32_t i = 0; i < numMips; ++i)
+			uavs[i] = GetDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, m_uavHandle[topMip + 1 + i]);
+		context.SetDynamicDescriptors(2, 0, numMips, uavs);
 		context.Dispatch2D(dstWidth, dstHeight);
 
 		context.InsertUAVBarrier(*this);
@@ -147,31 +195,42 @@ void ColorBuffer::CreateDerivedViews(ID3D12Device* device, DXGI_FORMAT format, u
 		srvDesc.Texture2D.MostDetailedMip = 0;
 	}
 
-	if (m_srvHandle.ptr == D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN)
+	if (m_srvHandle.IsNull())
 	{
-		m_rtvHandle = AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
-		m_srvHandle = AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+		m_rtvHandle = AllocateDescriptorHandle(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
+		m_srvHandle = AllocateDescriptorHandle(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 	}
 
 	ID3D12Resource* resource = m_pResource.Get();
-	device->CreateRenderTargetView(resource, &rtvDesc, m_rtvHandle);
-	device->CreateShaderResourceView(resource, &srvDesc, m_srvHandle);
+	device->CreateRenderTargetView(resource, &rtvDesc, GetRTV());
+	device->CreateShaderResourceView(resource, &srvDesc, GetSRV());
+	RefreshDescriptor(GetSRV());
 
 	if (m_fragmentCount > 1)
 		return;
 
 	for (uint32_t i = 0; i < numMips; ++i)
 	{
-		if (m_uavHandle[i].ptr == D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN)
-			m_uavHandle[i] = AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+		if (m_uavHandle[i].IsNull())
+			m_uavHandle[i] = AllocateDescriptorHandle(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 
-		device->CreateUnorderedAccessView(resource, nullptr, &uavDesc, m_uavHandle[i]);
+		D3D12_CPU_DESCRIPTOR_HANDLE uav = GetDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, m_uavHandle[i]);
+		device->CreateUnorderedAccessView(resource, nullptr, &uavDesc, uav);
+		RefreshDescriptor(uav);
 
 		uavDesc.Texture2D.MipSlice++;
 	}
 }
 
-void VolumeColorBuffer::Create(const std::wstring& name, uint32_t width, uint32_t height, uint32_t depth, uint32_t numMips, DXGI_FORMAT format, D3D12_GPU_VIRTUAL_ADDRESS vidMemPtr /* = D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN */)
+VolumeColorBuffer::~VolumeColorBuffer()
+{
+	FreeDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_RTV, m_rtvHandle);
+	FreeDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, m_srvHandle);
+	for (auto& uav : m_uavHandle)
+		FreeDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, uav);
+}
+
+D3D12_RESOURCE_DESC VolumeColorBuffer::Describe(uint32_t width, uint32_t height, uint32_t depth, uint32_t& numMips, DXGI_FORMAT format, D3D12_CLEAR_VALUE& clearValue)
 {
 	numMips = (numMips == 0 ? ComputeNumMips(width, height, depth) : numMips);
 	D3D12_RESOURCE_FLAGS flags = CombineResourceFlags();
@@ -180,17 +239,38 @@ void VolumeColorBuffer::Create(const std::wstring& name, uint32_t width, uint32_
 	resourceDesc.SampleDesc.Count = m_fragmentCount;
 	resourceDesc.SampleDesc.Quality = 0;
 
-	D3D12_CLEAR_VALUE clearValue = {};
+	clearValue = {};
 	clearValue.Format = format;
 	clearValue.Color[0] = m_clearColor.R();
 	clearValue.Color[1] = m_clearColor.G();
 	clearValue.Color[2] = m_clearColor.B();
 	clearValue.Color[3] = m_clearColor.A();
+	return resourceDesc;
+}
 
+void VolumeColorBuffer::Create(const std::wstring& name, uint32_t width, uint32_t height, uint32_t depth, uint32_t numMips, DXGI_FORMAT format, D3D12_GPU_VIRTUAL_ADDRESS vidMemPtr /* = D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN */)
+{
+	D3D12_CLEAR_VALUE clearValue;
+	D3D12_RESOURCE_DESC resourceDesc = Describe(width, height, depth, numMips, format, clearValue);
 	CreateTextureResource(g_Device, name, resourceDesc, clearValue, vidMemPtr);
 	CreateDerivedViews(g_Device, format, numMips);
 }
 
+void VolumeColorBuffer::CreatePlaced(const std::wstring& name, ID3D12Heap* heap, uint64_t heapOffset, uint32_t width, uint32_t height, uint32_t depth, uint32_t numMips, DXGI_FORMAT format)
+{
+	D3D12_CLEAR_VALUE clearValue;
+	D3D12_RESOURCE_DESC resourceDesc = Describe(width, height, depth, numMips, format, clearValue);
+	CreatePlacedTextureResource(g_Device, name, resourceDesc, clearValue, heap, heapOffset);
+	CreateDerivedViews(g_Device, format, numMips);
+}
+
+D3D12_RESOURCE_ALLOCATION_INFO VolumeColorBuffer::GetAllocationInfo(uint32_t width, uint32_t height, uint32_t depth, uint32_t numMips, DXGI_FORMAT format)
+{
+	D3D12_CLEAR_VALUE clearValue;
+	D3D12_RESOURCE_DESC resourceDesc = Describe(width, height, depth, numMips, format, clearValue);
+	return g_Device->GetResourceAllocationInfo(0, 1, &resourceDesc);
+}
+
 void VolumeColorBuffer::CreateFromTexture2D(const std::wstring& name, const Texture2D* tex, uint32_t numSliceX, uint32_t numSliceY, uint32_t numMips, DXGI_FORMAT format, D3D12_GPU_VIRTUAL_ADDRESS vidMemPtr /* = D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN */)
 {
 	uint32_t width = tex->GetWidth() / numSliceX;
@@ -218,7 +298,7 @@ void VolumeColorBuffer::GenerateMipMaps(CommandContext& baseContext)
 
 	context.SetRootSignature(Global::GenerateMipsRS);
 	context.TransitionResource(*this, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-	context.SetDynamicDescriptor(1, 0, m_srvHandle);
+	context.SetDynamicDescriptor(1, 0, GetSRV());
 
 	for (uint32_t topMip = 0; topMip < m_numMipMaps;)
 	{
@@ -252,7 +332,10 @@ void VolumeColorBuffer::GenerateMipMaps(CommandContext& baseContext)
 		context.SetConstant(0, 1.0f / dstWidth, 4);
 		context.SetConstant(0, 1.0f / dstHeight, 5);
 		context.SetConstant(0, 1.0f / dstDepth, 6);
-		context.SetDynamicDescriptors(2, 0, numMips, m_uavHandle + topMip + 1);
+		D3D12_CPU_DESCRIPTOR_HANDLE uavs[4];
+		for (uint32_t i = 0; i < numMips; ++i)
+			uavs[i] = GetDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, m_uavHandle[topMip + 1 + i]);
+		context.SetDynamicDescriptors(2, 0, numMips, uavs);
 		context.Dispatch3D(dstWidth, dstHeight, dstDepth, 4, 4, 4);
 
 		context.InsertUAVBarrier(*this);
@@ -290,25 +373,28 @@ void VolumeColorBuffer::CreateDerivedViews(ID3D12Device* device, DXGI_FORMAT for
 	srvDesc.Texture3D.MostDetailedMip = 0;
 
 
-	if (m_srvHandle.ptr == D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN)
+	if (m_srvHandle.IsNull())
 	{
-		m_rtvHandle = AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
-		m_srvHandle = AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+		m_rtvHandle = AllocateDescriptorHandle(D3D12_DESCRIPTOR_HEAP_TYPE_RTV);
+		m_srvHandle = AllocateDescriptorHandle(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 	}
 
 	ID3D12Resource* resource = m_pResource.Get();
-	device->CreateRenderTargetView(resource, &rtvDesc, m_rtvHandle);
-	device->CreateShaderResourceView(resource, &srvDesc, m_srvHandle);
+	device->CreateRenderTargetView(resource, &rtvDesc, GetRTV());
+	device->CreateShaderResourceView(resource, &srvDesc, GetSRV());
+	RefreshDescriptor(GetSRV());
 
 	if (m_fragmentCount > 1)
 		return;
 
 	for (uint32_t i = 0; i < numMips; ++i)
 	{
-		if (m_uavHandle[i].ptr == D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN)
-			m_uavHandle[i] = AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+		if (m_uavHandle[i].IsNull())
+			m_uavHandle[i] = AllocateDescriptorHandle(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 
-		device->CreateUnorderedAccessView(resource, nullptr, &uavDesc, m_uavHandle[i]);
+		D3D12_CPU_DESCRIPTOR_HANDLE uav = GetDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, m_uavHandle[i]);
+		device->CreateUnorderedAccessView(resource, nullptr, &uavDesc, uav);
+		RefreshDescriptor(uav);
 
 		uavDesc.Texture3D.MipSlice++;
 		uavDesc.Texture3D.WSize = m_depth >> (i + 1);
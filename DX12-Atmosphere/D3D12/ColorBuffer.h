@@ -2,6 +2,7 @@
 #include "stdafx.h"
 #include "PixelBuffer.h"
 #include "Color.h"
+#include "BindlessHeap.h"
 
 class Texture2D;
 
@@ -9,26 +10,36 @@ class ColorBuffer : public PixelBuffer
 {
 public:
 	ColorBuffer(Color clearColor = Color(0.0f, 0.0f, 0.0f, 0.0f))
-		: m_clearColor(clearColor), m_numMipMaps(0), m_fragmentCount(1), m_sampleCount(1)
+		: m_clearColor(clearColor), m_srvHandle(), m_rtvHandle(), m_uavHandle(), m_numMipMaps(0), m_fragmentCount(1), m_sampleCount(1)
 	{
-		m_srvHandle.ptr = D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN;
-		m_rtvHandle.ptr = D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN;
-		std::memset(m_uavHandle, 0xFF, sizeof(m_uavHandle));
 	}
 
+	~ColorBuffer();
+
 	void CreateFromSwapChain(const std::wstring& name, ID3D12Resource* baseResource);
 
 	void Create(const std::wstring& name, uint32_t width, uint32_t height, uint32_t numMips,
 		DXGI_FORMAT format, D3D12_GPU_VIRTUAL_ADDRESS vidMemPtr = D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN);
 
+	// Like Create at heapOffset in heap, which has GetAllocationInfo of the same arguments free there
+	void CreatePlaced(const std::wstring& name, ID3D12Heap* heap, uint64_t heapOffset, uint32_t width, uint32_t height,
+		uint32_t numMips, DXGI_FORMAT format);
+	D3D12_RESOURCE_ALLOCATION_INFO GetAllocationInfo(uint32_t width, uint32_t height, uint32_t numMips, DXGI_FORMAT format);
+
 	void CreateArray(const std::wstring& name, uint32_t width, uint32_t height, uint32_t arrayCount,
 		DXGI_FORMAT format, D3D12_GPU_VIRTUAL_ADDRESS vidMemPtr = D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN);
 
+	// Six slices, the SRV is a cube and the UAV the 2D array
+	void CreateCube(const std::wstring& name, uint32_t size,
+		DXGI_FORMAT format, D3D12_GPU_VIRTUAL_ADDRESS vidMemPtr = D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN);
+
 	void CreateDerivedViews(ID3D12Device* device, DXGI_FORMAT format, uint32_t arraySize, uint32_t numMips);
 
-	const D3D12_CPU_DESCRIPTOR_HANDLE& GetSRV() const { return m_srvHandle; }
-	const D3D12_CPU_DESCRIPTOR_HANDLE& GetRTV() const { return m_rtvHandle; }
-	const D3D12_CPU_DESCRIPTOR_HANDLE& GetUAV() const { return m_uavHandle[0]; }
+	D3D12_CPU_DESCRIPTOR_HANDLE GetSRV() const { return GetDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, m_srvHandle); }
+	// The slot of the SRV in the BindlessHeap, the same until the view is created again
+	uint32_t GetBindlessSRV() const { return BindlessHeap::Register(GetSRV()); }
+	D3D12_CPU_DESCRIPTOR_HANDLE GetRTV() const { return GetDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_RTV, m_rtvHandle); }
+	D3D12_CPU_DESCRIPTOR_HANDLE GetUAV() const { return GetDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, m_uavHandle[0]); }
 
 	void SetClearColor(const Color& clearColor) { m_clearColor = clearColor; }
 
@@ -44,6 +55,8 @@ public:
 	void GenerateMipMaps(CommandContext& context);
 
 protected:
+	// numMips 0 becomes the full chain
+	D3D12_RESOURCE_DESC Describe(uint32_t width, uint32_t height, uint32_t& numMips, DXGI_FORMAT format, D3D12_CLEAR_VALUE& clearValue);
 
 	D3D12_RESOURCE_FLAGS CombineResourceFlags() const
 	{
@@ -63,9 +76,9 @@ protected:
 	}
 
 	Color m_clearColor;
-	D3D12_CPU_DESCRIPTOR_HANDLE m_srvHandle;
-	D3D12_CPU_DESCRIPTOR_HANDLE m_rtvHandle;
-	D3D12_CPU_DESCRIPTOR_HANDLE m_uavHandle[12];  // use for each mip level
+	DescriptorFreeList::Handle m_srvHandle;
+	DescriptorFreeList::Handle m_rtvHandle;
+	DescriptorFreeList::Handle m_uavHandle[12];  // use for each mip level
 	uint32_t m_numMipMaps;
 	uint32_t m_fragmentCount;
 	uint32_t m_sampleCount;
@@ -75,21 +88,28 @@ class VolumeColorBuffer : public PixelBuffer
 {
 public:
 	VolumeColorBuffer(Color clearColor = Color(0.0f, 0.0f, 0.0f, 0.0f))
-		: m_clearColor(clearColor), m_numMipMaps(0), m_fragmentCount(1), m_sampleCount(1)
+		: m_clearColor(clearColor), m_srvHandle(), m_rtvHandle(), m_uavHandle(), m_numMipMaps(0), m_fragmentCount(1), m_sampleCount(1)
 	{
-		m_srvHandle.ptr = D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN;
-		std::memset(m_uavHandle, 0xFF, sizeof(m_uavHandle));
 	}
 
+	~VolumeColorBuffer();
+
 	void Create(const std::wstring& name, uint32_t width, uint32_t height, uint32_t depth, uint32_t numMips,
 		DXGI_FORMAT format, D3D12_GPU_VIRTUAL_ADDRESS vidMemPtr = D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN);
 
+	// Like Create at heapOffset in heap, which has GetAllocationInfo of the same arguments free there
+	void CreatePlaced(const std::wstring& name, ID3D12Heap* heap, uint64_t heapOffset, uint32_t width, uint32_t height,
+		uint32_t depth, uint32_t numMips, DXGI_FORMAT format);
+	D3D12_RESOURCE_ALLOCATION_INFO GetAllocationInfo(uint32_t width, uint32_t height, uint32_t depth, uint32_t numMips, DXGI_FORMAT format);
+
 	void CreateFromTexture2D(const std::wstring& name, const Texture2D* tex, uint32_t numSliceX, uint32_t numSliceY, uint32_t numMips, DXGI_FORMAT format, D3D12_GPU_VIRTUAL_ADDRESS vidMemPtr = D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN);
 
 	void CreateDerivedViews(ID3D12Device* device, DXGI_FORMAT format, uint32_t numMips);
 
-	const D3D12_CPU_DESCRIPTOR_HANDLE& GetSRV() const { return m_srvHandle; }
-	const D3D12_CPU_DESCRIPTOR_HANDLE& GetUAV() const { return m_uavHandle[0]; }
+	D3D12_CPU_DESCRIPTOR_HANDLE GetSRV() const { return GetDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, m_srvHandle); }
+	// The slot of the SRV in the BindlessHeap, the same until the view is created again
+	uint32_t GetBindlessSRV() const { return BindlessHeap::Register(GetSRV()); }
+	D3D12_CPU_DESCRIPTOR_HANDLE GetUAV() const { return GetDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, m_uavHandle[0]); }
 
 	void SetClearColor(Color clearColor) { m_clearColor = clearColor; }
 
@@ -106,6 +126,9 @@ public:
 	void GenerateMipMaps(CommandContext& context);
 
 protected:
+	// numMips 0 becomes the full chain
+	D3D12_RESOURCE_DESC Describe(uint32_t width, uint32_t height, uint32_t depth, uint32_t& numMips, DXGI_FORMAT format, D3D12_CLEAR_VALUE& clearValue);
+
 	D3D12_RESOURCE_FLAGS CombineResourceFlags() const
 	{
 		D3D12_RESOURCE_FLAGS flags = D3D12_RESOURCE_FLAG_NONE;
@@ -124,9 +147,9 @@ protected:
 	}
 
 	Color m_clearColor;
-	D3D12_CPU_DESCRIPTOR_HANDLE m_srvHandle;
-	D3D12_CPU_DESCRIPTOR_HANDLE m_rtvHandle;
-	D3D12_CPU_DESCRIPTOR_HANDLE m_uavHandle[12];
+	DescriptorFreeList::Handle m_srvHandle;
+	DescriptorFreeList::Handle m_rtvHandle;
+	DescriptorFreeList::Handle m_uavHandle[12];
 	uint32_t m_numMipMaps;
 	uint32_t m_fragmentCount;
 	uint32_t m_sampleCount;
@@ -28,23 +28,15 @@ void CommandAllocatorPool::Shutdown()
 
 ID3D12CommandAllocator* CommandAllocatorPool::RequestAllocator(uint64_t completedFenceValue)
 {
-	std::lock_guard<std::mutex> lockGuard(m_allocatorMutex);
+	ID3D12CommandAllocator* pAllocator = m_readyAllocators.Acquire([completedFenceValue](uint64_t fenceValue) { return fenceValue <= completedFenceValue; });
 
-	ID3D12CommandAllocator* pAllocator = nullptr;
-
-	if (!m_readyAllocators.empty())
+	if (pAllocator != nullptr)
 	{
-		auto& allocatorPair = m_readyAllocators.front();
-		if (allocatorPair.first <= completedFenceValue)
-		{
-			pAllocator = allocatorPair.second;
-			ThrowIfFailed(pAllocator->Reset());
-			m_readyAllocators.pop();
-		}
+		ThrowIfFailed(pAllocator->Reset());
 	}
-
-	if (pAllocator == nullptr)
+	else
 	{
+		std::lock_guard<std::mutex> lockGuard(m_allocatorMutex);
 		ThrowIfFailed(m_device->CreateCommandAllocator(m_type, IID_PPV_ARGS(&pAllocator)));
 		std::wstringstream allocatorName;
 		allocatorName << "CommandAllocator " << m_allocatorPool.size();
@@ -57,6 +49,5 @@ ID3D12CommandAllocator* CommandAllocatorPool::RequestAllocator(uint64_t complete
 
 void CommandAllocatorPool::DiscardAllocator(uint64_t fenceValue, ID3D12CommandAllocator* allocator)
 {
-	std::lock_guard<std::mutex> lockGuard(m_allocatorMutex);
-	m_readyAllocators.push({ fenceValue, allocator });
+	m_readyAllocators.Retire(fenceValue, allocator);
 }
\ No newline at end of file
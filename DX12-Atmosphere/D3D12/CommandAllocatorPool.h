@@ -1,5 +1,6 @@
 #pragma once
 #include "stdafx.h"
+#include "FenceRecycler.h"
 
 class CommandAllocatorPool
 {
@@ -19,6 +20,7 @@ private:
 	const D3D12_COMMAND_LIST_TYPE m_type;
 	ID3D12Device* m_device;
 	std::vector<ID3D12CommandAllocator*> m_allocatorPool;
-	std::queue<std::pair<uint64_t, ID3D12CommandAllocator*>> m_readyAllocators;
+	FenceRecycler<ID3D12CommandAllocator> m_readyAllocators;
+	// creation only, discards don't take it
 	std::mutex m_allocatorMutex;
 };
\ No newline at end of file
@@ -33,6 +33,7 @@ CommandContext* ContextManager::AllocateContext(D3D12_COMMAND_LIST_TYPE Type)
 	assert(ret != nullptr);
 
 	assert(ret->m_type == Type);
+	g_CommandManager.GetQueue(Type).m_openContexts.fetch_add(1, std::memory_order_acq_rel);
 
 	return ret;
 }
@@ -40,6 +41,7 @@ CommandContext* ContextManager::AllocateContext(D3D12_COMMAND_LIST_TYPE Type)
 void ContextManager::FreeContext(CommandContext* usedContext)
 {
 	assert(usedContext != nullptr);
+	g_CommandManager.GetQueue(usedContext->m_type).m_openContexts.fetch_sub(1, std::memory_order_acq_rel);
 	std::lock_guard<std::mutex> LockGuard(sm_contextAllocationMutex);
 	sm_availableContexts[usedContext->m_type].push(usedContext);
 }
@@ -220,6 +222,72 @@ void CommandContext::CopySubresource(GpuResource& dest, uint32_t destSubIndex, G
 	m_commandList->CopyTextureRegion(&destLocation, 0, 0, 0, &srcLocation, nullptr);
 }
 
+uint32_t CommandContext::ReadbackTexture(ReadbackBuffer& dstBuffer, GpuResource& srcBuffer)
+{
+	uint64_t copySize = 0;
+	D3D12_PLACED_SUBRESOURCE_FOOTPRINT placedFootprint;
+	D3D12_RESOURCE_DESC resourceDesc = srcBuffer.GetResource()->GetDesc();
+	g_Device->GetCopyableFootprints(&resourceDesc, 0, 1, 0, &placedFootprint, nullptr, nullptr, &copySize);
+
+	dstBuffer.Create(L"ReadbackBuffer", (uint32_t)copySize, 1);
+
+	TransitionResource(srcBuffer, D3D12_RESOURCE_STATE_COPY_SOURCE, true);
+
+	CD3DX12_TEXTURE_COPY_LOCATION destLocation(dstBuffer.GetResource(), placedFootprint);
+	CD3DX12_TEXTURE_COPY_LOCATION srcLocation(srcBuffer.GetResource(), 0);
+	m_commandList->CopyTextureRegion(&destLocation, 0, 0, 0, &srcLocation, nullptr);
+
+	return placedFootprint.Footprint.RowPitch;
+}
+
+void CommandContext::UploadTexture(GpuResource& dest, const void* data, size_t rowPitch)
+{
+	uint64_t copySize = 0;
+	uint32_t numRows = 0;
+	D3D12_PLACED_SUBRESOURCE_FOOTPRINT placedFootprint;
+	D3D12_RESOURCE_DESC resourceDesc = dest.GetResource()->GetDesc();
+	g_Device->GetCopyableFootprints(&resourceDesc, 0, 1, 0, &placedFootprint, &numRows, nullptr, &copySize);
+
+	// numRows is per slice, a 3D texture has Footprint.Depth of them
+	DynAlloc mem = m_cpuLinearAllocator.Allocate((size_t)copySize, L"", D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+	const uint32_t numSliceRows = numRows * placedFootprint.Footprint.Depth;
+	for (uint32_t row = 0; row < numSliceRows; ++row)
+		memcpy((uint8_t*)mem.dataPtr + (size_t)row * placedFootprint.Footprint.RowPitch, (const uint8_t*)data + row * rowPitch, rowPitch);
+
+	TransitionResource(dest, D3D12_RESOURCE_STATE_COPY_DEST, true);
+
+	placedFootprint.Offset = mem.offset;
+	CD3DX12_TEXTURE_COPY_LOCATION destLocation(dest.GetResource(), 0);
+	CD3DX12_TEXTURE_COPY_LOCATION srcLocation(mem.buffer.GetResource(), placedFootprint);
+	m_commandList->CopyTextureRegion(&destLocation, 0, 0, 0, &srcLocation, nullptr);
+}
+
+void CommandContext::UploadTextureRegion(GpuResource& dest, uint32_t x, uint32_t y, uint32_t width, uint32_t height, const void* data, size_t rowPitch)
+{
+	// the footprint of a texture the size of the region
+	uint64_t copySize = 0;
+	uint32_t numRows = 0;
+	uint64_t rowBytes = 0;
+	D3D12_PLACED_SUBRESOURCE_FOOTPRINT placedFootprint;
+	D3D12_RESOURCE_DESC resourceDesc = dest.GetResource()->GetDesc();
+	resourceDesc.Width = width;
+	resourceDesc.Height = height;
+	resourceDesc.DepthOrArraySize = 1;
+	resourceDesc.MipLevels = 1;
+	g_Device->GetCopyableFootprints(&resourceDesc, 0, 1, 0, &placedFootprint, &numRows, &rowBytes, &copySize);
+
+	DynAlloc mem = m_cpuLinearAllocator.Allocate((size_t)copySize, L"", D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+	for (uint32_t row = 0; row < numRows; ++row)
+		memcpy((uint8_t*)mem.dataPtr + (size_t)row * placedFootprint.Footprint.RowPitch, (const uint8_t*)data + row * rowPitch, (size_t)rowBytes);
+
+	TransitionResource(dest, D3D12_RESOURCE_STATE_COPY_DEST, true);
+
+	placedFootprint.Offset = mem.offset;
+	CD3DX12_TEXTURE_COPY_LOCATION destLocation(dest.GetResource(), 0);
+	CD3DX12_TEXTURE_COPY_LOCATION srcLocation(mem.buffer.GetResource(), placedFootprint);
+	m_commandList->CopyTextureRegion(&destLocation, x, y, 0, &srcLocation, nullptr);
+}
+
 void CommandContext::TransitionResource(GpuResource& resource, D3D12_RESOURCE_STATES newState, bool flushImmediate /* = false */)
 {
 	D3D12_RESOURCE_STATES oldState = resource.m_usageState;
@@ -259,6 +327,33 @@ void CommandContext::TransitionResource(GpuResource& resource, D3D12_RESOURCE_ST
 		FlushResourceBarriers();
 }
 
+void CommandContext::BeginResourceTransition(GpuResource& resource, D3D12_RESOURCE_STATES newState, bool flushImmediate /* = false */)
+{
+	// finish a transition already begun first
+	if (resource.m_transitioningState != (D3D12_RESOURCE_STATES)-1)
+		TransitionResource(resource, resource.m_transitioningState);
+
+	D3D12_RESOURCE_STATES oldState = resource.m_usageState;
+
+	if (oldState != newState)
+	{
+		assert(m_numBarriersToFlush < 16);
+		auto& barrierDesc = m_resourceBarrierBuffer[m_numBarriersToFlush++];
+
+		barrierDesc.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+		barrierDesc.Transition.pResource = resource.GetResource();
+		barrierDesc.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+		barrierDesc.Transition.StateBefore = oldState;
+		barrierDesc.Transition.StateAfter = newState;
+		barrierDesc.Flags = D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY;
+
+		resource.m_transitioningState = newState;
+	}
+
+	if (flushImmediate || m_numBarriersToFlush == 16)
+		FlushResourceBarriers();
+}
+
 void CommandContext::InsertUAVBarrier(GpuResource& resource, bool flushImmediate /* = false */)
 {
 	assert(m_numBarriersToFlush < 16);
@@ -270,6 +365,24 @@ void CommandContext::InsertUAVBarrier(GpuResource& resource, bool flushImmediate
 		FlushResourceBarriers();
 }
 
+void CommandContext::InsertAliasBarrier(GpuResource* before, GpuResource& after, bool flushImmediate /* = false */)
+{
+	assert(m_numBarriersToFlush < 16);
+	auto& barrierDesc = m_resourceBarrierBuffer[m_numBarriersToFlush++];
+
+	barrierDesc = CD3DX12_RESOURCE_BARRIER::Aliasing(before == nullptr ? nullptr : before->GetResource(), after.GetResource());
+
+	if (flushImmediate)
+		FlushResourceBarriers();
+}
+
+void CommandContext::DiscardResource(GpuResource& resource)
+{
+	assert(resource.m_usageState == D3D12_RESOURCE_STATE_RENDER_TARGET || resource.m_usageState == D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+	FlushResourceBarriers();
+	m_commandList->DiscardResource(resource.GetResource(), nullptr);
+}
+
 void CommandContext::FlushResourceBarriers()
 {
 	if (m_numBarriersToFlush)
@@ -466,6 +579,12 @@ void GraphicsContext::SetDescriptorTable(uint32_t rootIndex, D3D12_GPU_DESCRIPTO
 	m_commandList->SetGraphicsRootDescriptorTable(rootIndex, firstHandle);
 }
 
+void GraphicsContext::SetBindlessTable(uint32_t rootIndex)
+{
+	SetDescriptorHeap(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, BindlessHeap::GetHeap());
+	m_commandList->SetGraphicsRootDescriptorTable(rootIndex, BindlessHeap::GetTableStart());
+}
+
 D3D12_GPU_DESCRIPTOR_HANDLE CommandContext::SetDynamicDescriptorDirect(D3D12_CPU_DESCRIPTOR_HANDLE handle)
 {
 	return m_dynamicViewDescriptorHeap.UploadDirect(handle);
@@ -112,20 +112,37 @@ public:
 	void CopyBufferRegion(GpuResource& dest, size_t destOffset, GpuResource& src, size_t srcOffset, size_t numBytes);
 	void CopySubresource(GpuResource& dest, uint32_t destSubIndex, GpuResource& src, uint32_t srcSubIndex);
 
+	// Copies mip 0 of srcBuffer into dstBuffer, returns the row pitch of the copy
+	uint32_t ReadbackTexture(ReadbackBuffer& dstBuffer, GpuResource& srcBuffer);
+	// Copies tightly packed rows of rowPitch bytes into mip 0 of dest, leaves it in COPY_DEST
+	void UploadTexture(GpuResource& dest, const void* data, size_t rowPitch);
+	// Same for the width x height texels of mip 0 at (x, y), data points at the first of them
+	void UploadTextureRegion(GpuResource& dest, uint32_t x, uint32_t y, uint32_t width, uint32_t height, const void* data, size_t rowPitch);
+
 	static void InitializeBuffer(GpuResource& dest, const void* bufferData, size_t numBytes, size_t offset = 0, const std::wstring& name = L"");
 	static void InitializeTexture(GpuResource& dest, uint32_t numSubresources, D3D12_SUBRESOURCE_DATA subData[]);
 
 	void WriteBuffer(GpuResource& dest, size_t destOffset, const void* data, size_t numBytes);
 
 	void TransitionResource(GpuResource& resource, D3D12_RESOURCE_STATES newState, bool flushImmediate = false);
+	// The first half of a split barrier, TransitionResource to the same state ends it
+	void BeginResourceTransition(GpuResource& resource, D3D12_RESOURCE_STATES newState, bool flushImmediate = false);
 	void InsertUAVBarrier(GpuResource& resource, bool flushImmediate = false);
+	// after starts using memory of a placed resource before it, null for any of them
+	void InsertAliasBarrier(GpuResource* before, GpuResource& after, bool flushImmediate = false);
 	void FlushResourceBarriers();
+	// Its contents are undefined from here, initializes a placed render target or UAV texture
+	// taking over aliased memory. It must be in RENDER_TARGET or UNORDERED_ACCESS.
+	void DiscardResource(GpuResource& resource);
 
 	void SetPipelineState(const PipelineState& pso);
 	void SetDescriptorHeap(D3D12_DESCRIPTOR_HEAP_TYPE type, ID3D12DescriptorHeap* heapPtr);
 	void SetDescriptorHeaps(uint32_t heapCount, D3D12_DESCRIPTOR_HEAP_TYPE type[], ID3D12DescriptorHeap* heapPtrs[]);
 
 	D3D12_GPU_DESCRIPTOR_HANDLE SetDynamicDescriptorDirect(D3D12_CPU_DESCRIPTOR_HANDLE handle);
+	// Before the bindless tables of passes whose dynamic descriptors fit in count, false
+	// when they can't be bound on this command list and the passes take the dynamic tables
+	bool ReserveBindless(uint32_t count) { return m_dynamicViewDescriptorHeap.ReserveBindless(count); }
 protected:
 	void BindDescriptorHeaps();
 
@@ -197,6 +214,8 @@ public:
 	void SetBufferSRV(uint32_t rootIndex, const GpuBuffer& SRV, UINT64 offset = 0);
 	void SetBufferUAV(uint32_t rootIndex, const GpuBuffer& UAV, UINT64 offset = 0);
 	void SetDescriptorTable(uint32_t rootIndex, D3D12_GPU_DESCRIPTOR_HANDLE firstHandle);
+	// A table from InitAsBindlessTable, after ReserveBindless returned true
+	void SetBindlessTable(uint32_t rootIndex);
 
 	void SetDynamicDescriptor(uint32_t rootIndex, uint32_t offset, D3D12_CPU_DESCRIPTOR_HANDLE handle);
 	void SetDynamicDescriptors(uint32_t rootIndex, uint32_t offset, uint32_t count, const D3D12_CPU_DESCRIPTOR_HANDLE handles[]);
@@ -241,6 +260,8 @@ public:
 	void SetBufferSRV(uint32_t rootIndex, const GpuBuffer& srv, uint64_t offset = 0);
 	void SetBufferUAV(uint32_t rootIndex, const GpuBuffer& uav, uint64_t offset = 0);
 	void SetDescriptorTable(uint32_t rootIndex, D3D12_GPU_DESCRIPTOR_HANDLE firstHandle);
+	// A table from InitAsBindlessTable, after ReserveBindless returned true
+	void SetBindlessTable(uint32_t rootIndex);
 
 	void SetDynamicDescriptor(uint32_t rootIndex, uint32_t offset, D3D12_CPU_DESCRIPTOR_HANDLE handle);
 	void SetDynamicDescriptors(uint32_t rootIndex, uint32_t offset, uint32_t count, const D3D12_CPU_DESCRIPTOR_HANDLE handles[]);
@@ -356,6 +377,12 @@ inline void ComputeContext::SetDescriptorTable(uint32_t rootIndex, D3D12_GPU_DES
 	m_commandList->SetComputeRootDescriptorTable(rootIndex, firstHandle);
 }
 
+inline void ComputeContext::SetBindlessTable(uint32_t rootIndex)
+{
+	SetDescriptorHeap(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, BindlessHeap::GetHeap());
+	m_commandList->SetComputeRootDescriptorTable(rootIndex, BindlessHeap::GetTableStart());
+}
+
 inline void ComputeContext::SetDynamicDescriptor(uint32_t rootIndex, uint32_t offset, D3D12_CPU_DESCRIPTOR_HANDLE handle)
 {
 	SetDynamicDescriptors(rootIndex, offset, 1, &handle);
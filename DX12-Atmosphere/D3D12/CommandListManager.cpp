@@ -7,6 +7,7 @@ CommandQueue::CommandQueue(D3D12_COMMAND_LIST_TYPE type) :
 	m_pFence(nullptr),
 	m_nextFenceValue((uint64_t)type << 56 | 1),
 	m_lastCompletedFenceValue((uint64_t)type << 56),
+	m_openContexts(0),
 	m_allocatorPool(type)
 {
 
@@ -1,11 +1,13 @@
 #pragma once
 #include "stdafx.h"
 #include "CommandAllocatorPool.h"
+#include <atomic>
 
 class CommandQueue
 {
 	friend class CommandListManager;
 	friend class CommandContext;
+	friend class ContextManager;
 
 public:
 	CommandQueue(D3D12_COMMAND_LIST_TYPE type);
@@ -29,6 +31,14 @@ public:
 	ID3D12CommandQueue* GetCommandQueue() { return m_commandQueue; }
 
 	uint64_t GetNextFenceValue() { return m_nextFenceValue; }
+	// After which the queue no longer reads what the CPU lets go of now: the list being
+	// recorded while a context for the queue is open, the last one submitted otherwise
+	uint64_t GetRetireFenceValue()
+	{
+		if (m_openContexts.load(std::memory_order_acquire) > 0)
+			return m_nextFenceValue;
+		return m_nextFenceValue - 1;
+	}
 
 private:
 	uint64_t ExecuteCommandList(ID3D12CommandList* list);
@@ -46,6 +56,8 @@ private:
 	uint64_t m_nextFenceValue;
 	uint64_t m_lastCompletedFenceValue;
 	HANDLE m_fenceEventHandle;
+	// from AllocateContext to FreeContext
+	std::atomic<uint32_t> m_openContexts;
 };
 
 class CommandListManager
@@ -91,6 +103,14 @@ public:
 
 	void WaitForFence(uint64_t fenceValue);
 
+	// A retire fence value per queue, for what the lists of any of them may read
+	void GetRetireFenceValues(uint64_t (&fenceValues)[3])
+	{
+		fenceValues[0] = m_graphicsQueue.GetRetireFenceValue();
+		fenceValues[1] = m_computeQueue.GetRetireFenceValue();
+		fenceValues[2] = m_copyQueue.GetRetireFenceValue();
+	}
+
 	void IdleGPU()
 	{
 		m_graphicsQueue.WaitForIdle();
@@ -1,6 +1,14 @@
 #include "stdafx.h"
 #include "DepthBuffer.h"
 
+DepthBuffer::~DepthBuffer()
+{
+	for (auto& dsv : m_DSV)
+		FreeDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_DSV, dsv);
+	FreeDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, m_depthSRV);
+	FreeDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, m_stencilSRV);
+}
+
 void DepthBuffer::Create(const std::wstring& name, uint32_t width, uint32_t height, DXGI_FORMAT format, D3D12_GPU_VIRTUAL_ADDRESS vidMemPtr /* = D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN */)
 {
 	D3D12_RESOURCE_DESC resDesc = DescribeTex2D(width, height, 1, 1, format, D3D12_RESOURCE_FLAG_ALLOW_DEPTH_STENCIL);
@@ -38,42 +46,44 @@ void DepthBuffer::CreateDerivedViews(ID3D12Device* device, DXGI_FORMAT format)
 		dsvDesc.ViewDimension = D3D12_DSV_DIMENSION_TEXTURE2DMS;
 	}
 
-	if (m_DSV[0].ptr == D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN)
+	if (m_DSV[0].IsNull())
 	{
-		m_DSV[0] = AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_DSV);
-		m_DSV[1] = AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_DSV);
+		m_DSV[0] = AllocateDescriptorHandle(D3D12_DESCRIPTOR_HEAP_TYPE_DSV);
+		m_DSV[1] = AllocateDescriptorHandle(D3D12_DESCRIPTOR_HEAP_TYPE_DSV);
 	}
 
 	dsvDesc.Flags = D3D12_DSV_FLAG_NONE;
-	device->CreateDepthStencilView(resource, &dsvDesc, m_DSV[0]);
+	device->CreateDepthStencilView(resource, &dsvDesc, GetDSV(0));
 	
 	dsvDesc.Flags = D3D12_DSV_FLAG_READ_ONLY_DEPTH;
-	device->CreateDepthStencilView(resource, &dsvDesc, m_DSV[1]);
+	device->CreateDepthStencilView(resource, &dsvDesc, GetDSV(1));
 
 	DXGI_FORMAT stencilReadFormat = GetStencilFormat(format);
 	if (stencilReadFormat != DXGI_FORMAT_UNKNOWN)
 	{
-		if (m_DSV[2].ptr == D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN)
+		if (m_DSV[2].IsNull())
 		{
-			m_DSV[2] = AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_DSV);
-			m_DSV[3] = AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_DSV);
+			m_DSV[2] = AllocateDescriptorHandle(D3D12_DESCRIPTOR_HEAP_TYPE_DSV);
+			m_DSV[3] = AllocateDescriptorHandle(D3D12_DESCRIPTOR_HEAP_TYPE_DSV);
 		}
 
 		dsvDesc.Flags = D3D12_DSV_FLAG_READ_ONLY_STENCIL;
-		device->CreateDepthStencilView(resource, &dsvDesc, m_DSV[2]);
+		device->CreateDepthStencilView(resource, &dsvDesc, GetDSV(2));
 
 		dsvDesc.Flags = D3D12_DSV_FLAG_READ_ONLY_STENCIL | D3D12_DSV_FLAG_READ_ONLY_DEPTH;
-		device->CreateDepthStencilView(resource, &dsvDesc, m_DSV[3]);
+		device->CreateDepthStencilView(resource, &dsvDesc, GetDSV(3));
 	}
 	else
 	{
-		m_DSV[2] = m_DSV[0];
-		m_DSV[3] = m_DSV[1];
+		// a format with stencil before
+		FreeDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_DSV, m_DSV[2]);
+		FreeDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_DSV, m_DSV[3]);
+		FreeDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, m_stencilSRV);
 	}
 
-	if (m_depthSRV.ptr == D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN)
+	if (m_depthSRV.IsNull())
 	{
-		m_depthSRV = AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+		m_depthSRV = AllocateDescriptorHandle(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 	}
 
 	D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
@@ -88,14 +98,16 @@ void DepthBuffer::CreateDerivedViews(ID3D12Device* device, DXGI_FORMAT format)
 		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2DMS;
 	}
 	srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-	device->CreateShaderResourceView(resource, &srvDesc, m_depthSRV);
+	device->CreateShaderResourceView(resource, &srvDesc, GetDepthSRV());
+	RefreshDescriptor(GetDepthSRV());
 
 	if (stencilReadFormat != DXGI_FORMAT_UNKNOWN)
 	{
-		if (m_stencilSRV.ptr == D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN)
-			m_stencilSRV = AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+		if (m_stencilSRV.IsNull())
+			m_stencilSRV = AllocateDescriptorHandle(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 
 		srvDesc.Format = stencilReadFormat;
-		device->CreateShaderResourceView(resource, &srvDesc, m_stencilSRV);
+		device->CreateShaderResourceView(resource, &srvDesc, GetStencilSRV());
+		RefreshDescriptor(GetStencilSRV());
 	}
 }
\ No newline at end of file
@@ -0,0 +1,121 @@
+#include "stdafx.h"
+#include "DescriptorAllocatorBenchmark.h"
+#include "DescriptorFreeList.h"
+#include "Math/Random.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+using Math::RandomNumberGenerator;
+
+DescriptorAllocatorBenchmark::Desc DescriptorAllocatorBenchmark::DefaultDesc()
+{
+	Desc desc;
+	desc.liveResources = 400;
+	desc.replaceCount = 16;
+	desc.numFrames = 20000;
+	// SRV, RTV slot and 12 mip UAVs of a ColorBuffer
+	desc.maxViews = 14;
+	desc.framesInFlight = 2;
+	desc.blockSize = 256;
+	desc.seed = 1;
+	return desc;
+}
+
+DescriptorAllocatorBenchmark::Result DescriptorAllocatorBenchmark::Run(const Desc& desc)
+{
+	DescriptorFreeList freeList(desc.blockSize);
+	RandomNumberGenerator rng(desc.seed);
+	const uint32_t max_views = std::min(std::max(desc.maxViews, 1u), desc.blockSize);
+	// most resources have one view, a few carry a mip chain
+	auto view_count = [&rng, max_views]()
+	{
+		uint32_t r = rng.NextUInt() % 8;
+		return r < 5 ? 1u : 1u + rng.NextUInt() % max_views;
+	};
+
+	Result result = {};
+	std::vector<uint32_t> mock_heap;
+	uint32_t next_owner = 1;
+	uint32_t linear_remaining = 0;
+	auto allocate = [&](DescriptorFreeList::Handle& handle)
+	{
+		uint32_t count = view_count();
+		bool new_block = false;
+		handle = freeList.Allocate(count, new_block);
+		if (new_block)
+			mock_heap.resize(mock_heap.size() + desc.blockSize, 0);
+		uint32_t owner = next_owner++;
+		for (uint32_t i = handle.index; i < handle.index + count; ++i)
+		{
+			result.violations.Add("overlaps", mock_heap[i] != 0);
+			mock_heap[i] = owner;
+		}
+		// DescriptorAllocator before the free lists, a new heap when the current one is short
+		if (linear_remaining < count)
+		{
+			++result.linearBlocks;
+			linear_remaining = desc.blockSize;
+		}
+		linear_remaining -= count;
+		++result.allocations;
+	};
+	auto release = [&](const DescriptorFreeList::Handle& handle, uint64_t fenceValue)
+	{
+		for (uint32_t i = handle.index; i < handle.index + handle.count; ++i)
+			mock_heap[i] = 0;
+		freeList.Free(handle, fenceValue);
+		result.violations.Add("stale handles live", freeList.IsLive(handle));
+		++result.frees;
+	};
+
+	std::vector<DescriptorFreeList::Handle> live(desc.liveResources);
+	for (auto& handle : live)
+		allocate(handle);
+
+	double fragmentation_sum = 0.0;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (uint64_t frame = 1; frame <= desc.numFrames; ++frame)
+	{
+		uint64_t completed = frame > desc.framesInFlight ? frame - desc.framesInFlight : 0;
+		freeList.Reclaim([completed](uint64_t fenceValue) { return fenceValue <= completed; });
+		for (uint32_t i = 0; i < desc.replaceCount && !live.empty(); ++i)
+		{
+			DescriptorFreeList::Handle& handle = live[rng.NextUInt() % live.size()];
+			release(handle, frame);
+			allocate(handle);
+		}
+		DescriptorFreeList::Stats stats = freeList.GetStats();
+		result.peakReserved = std::max(result.peakReserved, stats.reserved);
+		fragmentation_sum += stats.fragmentation;
+		result.maxFragmentation = std::max(result.maxFragmentation, stats.fragmentation);
+	}
+	result.seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+	// the graphics and the compute fence, the copy queue has nothing to wait for
+	{
+		DescriptorFreeList two_queues(desc.blockSize);
+		bool new_block = false;
+		DescriptorFreeList::Handle handle = two_queues.Allocate(1, new_block);
+		const uint64_t fence_values[DescriptorFreeList::kMaxFences] = { 5, 7, 0 };
+		two_queues.Free(handle, fence_values);
+		result.violations.Add("reclaimed early", two_queues.Reclaim([](uint64_t fenceValue) { return fenceValue <= 5; }));
+		result.violations.Add("not reclaimed", two_queues.Reclaim([](uint64_t fenceValue) { return fenceValue <= 7; }) != 1);
+	}
+
+	DescriptorFreeList::Stats stats = freeList.GetStats();
+	const double operations = 2.0 * desc.replaceCount * desc.numFrames;
+	result.operationsPerSecond = operations / std::max(result.seconds, 1e-9);
+	result.blocks = stats.blocks;
+	result.meanFragmentation = fragmentation_sum / std::max(desc.numFrames, 1u);
+	return result;
+}
+
+std::string DescriptorAllocatorBenchmark::Summarize(const Result& result)
+{
+	char line[256];
+	snprintf(line, sizeof(line), "%.1f M ops / s, %u heaps against %u linear, fragmentation %.2f mean %.2f max",
+		result.operationsPerSecond * 1e-6, result.blocks, result.linearBlocks, result.meanFragmentation, result.maxFragmentation);
+	return line;
+}
\ No newline at end of file
@@ -0,0 +1,48 @@
+#pragma once
+#include "Utils/SelfTest.h"
+#include <cstdint>
+#include <string>
+
+// DescriptorFreeList against a mock heap, a slot owner per descriptor, with the churn of
+// resources being recreated: liveResources resources each hold a range of 1 to maxViews
+// descriptors (an SRV plus a UAV per mip), and every frame replaceCount of them are freed
+// with the frame's fence and created again. A frame completes framesInFlight frames later.
+// Counts the heaps the free list needs against the heaps the old linear allocator would
+// have created for the same allocations, checks that no two live ranges share a slot,
+// that no freed handle still passes IsLive and that a range freed with the fences of two
+// queues waits for both.
+class DescriptorAllocatorBenchmark
+{
+public:
+	struct Desc
+	{
+		uint32_t liveResources;
+		uint32_t replaceCount;
+		uint32_t numFrames;
+		uint32_t maxViews;
+		uint32_t framesInFlight;
+		uint32_t blockSize;
+		uint32_t seed;
+	};
+
+	struct Result
+	{
+		double seconds;
+		// allocations plus frees
+		double operationsPerSecond;
+		uint64_t allocations;
+		uint64_t frees;
+		uint32_t blocks;
+		uint32_t linearBlocks;
+		uint64_t peakReserved;
+		double meanFragmentation;
+		double maxFragmentation;
+		// "overlaps" of two live ranges, "stale handles live" after their Free, ranges
+		// "reclaimed early" before their last fence or "not reclaimed" after it
+		SelfTest::Violations violations;
+	};
+
+	static Desc DefaultDesc();
+	static Result Run(const Desc& desc);
+	static std::string Summarize(const Result& result);
+};
\ No newline at end of file
@@ -0,0 +1,184 @@
+#include "stdafx.h"
+#include "DescriptorFreeList.h"
+#include <algorithm>
+#include <cassert>
+
+DescriptorFreeList::DescriptorFreeList(uint32_t blockSize /* = 256 */)
+	: m_blockSize(blockSize), m_maxOrder(OrderOf(blockSize)), m_stats()
+{
+	assert(blockSize > 0 && (blockSize & (blockSize - 1)) == 0);
+	m_freeHeads.assign(m_maxOrder + 1, -1);
+}
+
+uint8_t DescriptorFreeList::OrderOf(uint32_t count)
+{
+	uint8_t order = 0;
+	while ((1u << order) < count)
+		++order;
+	return order;
+}
+
+void DescriptorFreeList::PushFree(uint32_t index, uint8_t order)
+{
+	Slot& slot = m_slots[index];
+	slot.free = true;
+	slot.order = order;
+	slot.prev = -1;
+	slot.next = m_freeHeads[order];
+	if (slot.next >= 0)
+		m_slots[slot.next].prev = (int32_t)index;
+	m_freeHeads[order] = (int32_t)index;
+	m_stats.free += 1ull << order;
+}
+
+void DescriptorFreeList::RemoveFree(uint32_t index)
+{
+	Slot& slot = m_slots[index];
+	if (slot.prev >= 0)
+		m_slots[slot.prev].next = slot.next;
+	else
+		m_freeHeads[slot.order] = slot.next;
+	if (slot.next >= 0)
+		m_slots[slot.next].prev = slot.prev;
+	slot.free = false;
+	m_stats.free -= 1ull << slot.order;
+}
+
+void DescriptorFreeList::AddBlock()
+{
+	uint32_t base = (uint32_t)m_slots.size();
+	m_slots.resize(m_slots.size() + m_blockSize, Slot{ -1, -1, 0, 0, 0, false });
+	PushFree(base, m_maxOrder);
+	++m_stats.blocks;
+	m_stats.capacity += m_blockSize;
+}
+
+void DescriptorFreeList::Release(uint32_t index, uint8_t order)
+{
+	uint32_t base = index - index % m_blockSize;
+	while (order < m_maxOrder)
+	{
+		uint32_t buddy = base + ((index - base) ^ (1u << order));
+		const Slot& buddy_slot = m_slots[buddy];
+		if (!buddy_slot.free || buddy_slot.order != order)
+			break;
+		RemoveFree(buddy);
+		index = index < buddy ? index : buddy;
+		++order;
+	}
+	PushFree(index, order);
+}
+
+DescriptorFreeList::Handle DescriptorFreeList::Allocate(uint32_t count, bool& newBlock)
+{
+	assert(count > 0 && count <= m_blockSize);
+	std::lock_guard<std::mutex> lockGuard(m_mutex);
+	newBlock = false;
+
+	uint8_t order = OrderOf(count);
+	uint8_t found = order;
+	while (found <= m_maxOrder && m_freeHeads[found] < 0)
+		++found;
+	if (found > m_maxOrder)
+	{
+		AddBlock();
+		newBlock = true;
+		found = m_maxOrder;
+	}
+
+	uint32_t index = (uint32_t)m_freeHeads[found];
+	RemoveFree(index);
+	// split down to the size class, the upper halves stay free
+	while (found > order)
+	{
+		--found;
+		PushFree(index + (1u << found), found);
+	}
+
+	Slot& slot = m_slots[index];
+	slot.order = order;
+	slot.count = count;
+	m_stats.allocated += count;
+	m_stats.reserved += 1ull << order;
+	++m_stats.allocations;
+
+	Handle handle;
+	handle.index = index;
+	handle.count = count;
+	handle.generation = slot.generation;
+	return handle;
+}
+
+void DescriptorFreeList::Free(const Handle& handle, const uint64_t (&fenceValues)[kMaxFences])
+{
+	std::lock_guard<std::mutex> lockGuard(m_mutex);
+	assert(handle.index < m_slots.size() && m_slots[handle.index].count == handle.count &&
+		m_slots[handle.index].generation == handle.generation && "descriptor freed twice or never allocated");
+
+	Slot& slot = m_slots[handle.index];
+	++slot.generation;
+	slot.count = 0;
+	m_stats.allocated -= handle.count;
+	m_stats.reserved -= 1ull << slot.order;
+	m_stats.pending += 1ull << slot.order;
+	++m_stats.frees;
+	Pending pending;
+	std::copy(fenceValues, fenceValues + kMaxFences, pending.fenceValues);
+	pending.index = handle.index;
+	pending.order = slot.order;
+	m_pending.push_back(pending);
+}
+
+bool DescriptorFreeList::IsLive(const Handle& handle) const
+{
+	std::lock_guard<std::mutex> lockGuard(m_mutex);
+	if (handle.IsNull() || handle.index >= m_slots.size())
+		return false;
+	const Slot& slot = m_slots[handle.index];
+	return slot.count == handle.count && slot.generation == handle.generation;
+}
+
+DescriptorFreeList::Handle DescriptorFreeList::Find(uint32_t index) const
+{
+	std::lock_guard<std::mutex> lockGuard(m_mutex);
+	Handle handle = {};
+	if (index < m_slots.size() && m_slots[index].count > 0)
+	{
+		handle.index = index;
+		handle.count = m_slots[index].count;
+		handle.generation = m_slots[index].generation;
+	}
+	return handle;
+}
+
+uint32_t DescriptorFreeList::GetNumBlocks() const
+{
+	std::lock_guard<std::mutex> lockGuard(m_mutex);
+	return m_stats.blocks;
+}
+
+DescriptorFreeList::Stats DescriptorFreeList::GetStats() const
+{
+	std::lock_guard<std::mutex> lockGuard(m_mutex);
+	Stats stats = m_stats;
+	stats.largestFree = 0;
+	for (int order = m_maxOrder; order >= 0; --order)
+	{
+		if (m_freeHeads[order] >= 0)
+		{
+			stats.largestFree = 1u << order;
+			break;
+		}
+	}
+	stats.fragmentation = stats.free > 0 ? 1.0 - (double)stats.largestFree / (double)stats.free : 0.0;
+	return stats;
+}
+
+void DescriptorFreeList::Reset()
+{
+	std::lock_guard<std::mutex> lockGuard(m_mutex);
+	m_slots.clear();
+	m_freeHeads.assign(m_maxOrder + 1, -1);
+	m_pending.clear();
+	m_stats = Stats();
+}
\ No newline at end of file
@@ -0,0 +1,147 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+// The bookkeeping of DescriptorAllocator without the heaps, so it runs headless against a
+// mock heap. Descriptors are indices into blocks of blockSize slots, one block per
+// ID3D12DescriptorHeap, a new block when nothing fits. Each block is a buddy allocator:
+// a range of count descriptors takes the next power of two, free lists per size class,
+// and a freed range merges with its free buddy. Frees wait for a fence like the pages of
+// the linear allocators, one per queue that may read the range, Reclaim returns them once
+// all of them completed. A handle carries the
+// generation of its first slot, Free bumps it, so a handle kept after Free no longer
+// passes IsLive even when its slots went to someone else.
+class DescriptorFreeList
+{
+public:
+	struct Handle
+	{
+		uint32_t index;
+		uint32_t count;
+		uint32_t generation;
+
+		bool IsNull() const { return count == 0; }
+	};
+
+	struct Stats
+	{
+		uint32_t blocks;
+		uint64_t capacity;
+		// descriptors asked for, and taken after rounding up to a power of two
+		uint64_t allocated;
+		uint64_t reserved;
+		// freed and waiting for their fence
+		uint64_t pending;
+		uint64_t free;
+		uint32_t largestFree;
+		// 1 - largestFree / free, 0 when all free descriptors are one range
+		double fragmentation;
+		uint64_t allocations;
+		uint64_t frees;
+		uint64_t reclaimed;
+		uint64_t fenceQueries;
+	};
+
+	// a fence value per queue, 0 where there is nothing to wait for
+	static const uint32_t kMaxFences = 3;
+
+	// blockSize is a power of two
+	explicit DescriptorFreeList(uint32_t blockSize = 256);
+
+	// count <= blockSize. newBlock is set when the range needed a new block, whose index
+	// is GetNumBlocks() - 1, the caller creates its heap.
+	Handle Allocate(uint32_t count, bool& newBlock);
+
+	// Returns the slots once every fence value completed
+	void Free(const Handle& handle, const uint64_t (&fenceValues)[kMaxFences]);
+	void Free(const Handle& handle, uint64_t fenceValue)
+	{
+		const uint64_t fence_values[kMaxFences] = { fenceValue };
+		Free(handle, fence_values);
+	}
+
+	// The ranges whose fences completed go back to the free lists, queried once per fence value
+	template <class FenceQuery>
+	size_t Reclaim(const FenceQuery& isFenceComplete)
+	{
+		std::lock_guard<std::mutex> lockGuard(m_mutex);
+		size_t count = 0;
+		uint64_t values[kMaxFences] = {};
+		bool complete[kMaxFences] = {};
+		while (!m_pending.empty())
+		{
+			const Pending& pending = m_pending.front();
+			bool all_complete = true;
+			for (uint32_t f = 0; f < kMaxFences && all_complete; ++f)
+			{
+				uint64_t value = pending.fenceValues[f];
+				if (value == 0)
+					continue;
+				if (value != values[f])
+				{
+					values[f] = value;
+					complete[f] = isFenceComplete(value);
+					++m_stats.fenceQueries;
+				}
+				all_complete = complete[f];
+			}
+			// fence values are retired in order on each queue, the rest is newer
+			if (!all_complete)
+				break;
+			Release(pending.index, pending.order);
+			m_stats.pending -= 1ull << pending.order;
+			m_pending.pop_front();
+			++count;
+		}
+		m_stats.reclaimed += count;
+		return count;
+	}
+
+	bool IsLive(const Handle& handle) const;
+	// The live range starting at index, a null handle if there is none
+	Handle Find(uint32_t index) const;
+
+	uint32_t GetBlockSize() const { return m_blockSize; }
+	uint32_t GetNumBlocks() const;
+	Stats GetStats() const;
+
+	// Forgets every block and range, for DescriptorAllocator::DestroyAll
+	void Reset();
+
+private:
+	struct Slot
+	{
+		// the free list of its size class while it heads a free range
+		int32_t next;
+		int32_t prev;
+		uint32_t generation;
+		// the count asked for while it heads a live range, otherwise 0
+		uint32_t count;
+		uint8_t order;
+		bool free;
+	};
+
+	struct Pending
+	{
+		uint64_t fenceValues[kMaxFences];
+		uint32_t index;
+		uint8_t order;
+	};
+
+	static uint8_t OrderOf(uint32_t count);
+
+	void PushFree(uint32_t index, uint8_t order);
+	void RemoveFree(uint32_t index);
+	void AddBlock();
+	void Release(uint32_t index, uint8_t order);
+
+	mutable std::mutex m_mutex;
+	uint32_t m_blockSize;
+	uint8_t m_maxOrder;
+	std::vector<Slot> m_slots;
+	std::vector<int32_t> m_freeHeads;
+	std::deque<Pending> m_pending;
+	Stats m_stats;
+};
\ No newline at end of file
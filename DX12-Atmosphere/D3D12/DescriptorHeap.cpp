@@ -1,27 +1,91 @@
 #include "stdafx.h"
 #include "DescriptorHeap.h"
+#include "CommandListManager.h"
+#include "BindlessHeap.h"
 
 std::mutex DescriptorAllocator::s_allocationMutex;
 std::vector<Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>> DescriptorAllocator::s_descriptorHeapPool;
+bool DescriptorAllocator::s_destroyed = false;
+std::atomic<uint64_t> DescriptorAllocator::s_viewEpoch(0);
 
 D3D12_CPU_DESCRIPTOR_HANDLE DescriptorAllocator::Allocate(uint32_t count)
 {
-	if (m_curHeap == nullptr || m_remainingFreeHandles < count)
-	{
-		m_curHeap = RequestNewHeap(m_type);
-		m_curHandle = m_curHeap->GetCPUDescriptorHandleForHeapStart();
-		m_remainingFreeHandles = s_numDescriptorsPerHeap;
+	return GetCpuHandle(AllocateHandle(count));
+}
+
+DescriptorFreeList::Handle DescriptorAllocator::AllocateHandle(uint32_t count)
+{
+	std::lock_guard<std::mutex> blockGuard(m_blockMutex);
+	m_freeList.Reclaim([](uint64_t fenceValue) { return g_CommandManager.IsFenceComplete(fenceValue); });
 
+	bool new_block = false;
+	DescriptorFreeList::Handle handle = m_freeList.Allocate(count, new_block);
+	if (new_block)
+	{
+		ID3D12DescriptorHeap* heap = RequestNewHeap(m_type);
+		std::lock_guard<std::mutex> lockGuard(s_allocationMutex);
 		if (m_descriptorSize == 0)
 			m_descriptorSize = g_Device->GetDescriptorHandleIncrementSize(m_type);
+		m_heapStarts.push_back(heap->GetCPUDescriptorHandleForHeapStart().ptr);
 	}
+	return handle;
+}
 
-	D3D12_CPU_DESCRIPTOR_HANDLE ret = m_curHandle;
-	m_curHandle.ptr += count * m_descriptorSize;
-	m_remainingFreeHandles -= count;
+void DescriptorAllocator::Free(D3D12_CPU_DESCRIPTOR_HANDLE handle, uint32_t count)
+{
+	if (s_destroyed || handle.ptr == D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN || handle.ptr == 0)
+		return;
+	uint32_t index = IndexOf(handle);
+	assert(index != UINT32_MAX && "descriptor from another allocator");
+	DescriptorFreeList::Handle range = m_freeList.Find(index);
+	assert(!range.IsNull() && "descriptor freed twice");
+	// a stale handle whose slots went to a range of another size
+	assert((range.IsNull() || range.count == count) && "descriptor freed with another count, freed twice and allocated again");
+	if (!range.IsNull() && range.count == count)
+		Free(range);
+}
+
+void DescriptorAllocator::Free(const DescriptorFreeList::Handle& handle)
+{
+	if (s_destroyed || handle.IsNull())
+		return;
+	if (m_type == D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV && BindlessHeap::IsCreated())
+	{
+		D3D12_CPU_DESCRIPTOR_HANDLE cpu_handle = GetCpuHandle(handle);
+		for (uint32_t i = 0; i < handle.count; ++i, cpu_handle.ptr += m_descriptorSize)
+			BindlessHeap::Unregister(cpu_handle);
+	}
+	// Descriptors are copied to the shader visible heaps and read for render targets
+	// while recording, on whichever queue the context records for
+	uint64_t fence_values[DescriptorFreeList::kMaxFences];
+	g_CommandManager.GetRetireFenceValues(fence_values);
+	m_freeList.Free(handle, fence_values);
+}
+
+D3D12_CPU_DESCRIPTOR_HANDLE DescriptorAllocator::GetCpuHandle(const DescriptorFreeList::Handle& handle) const
+{
+#ifdef _DEBUG
+	assert(m_freeList.IsLive(handle) && "descriptor used after Free");
+#endif
+	std::lock_guard<std::mutex> lockGuard(s_allocationMutex);
+	uint32_t block = handle.index / s_numDescriptorsPerHeap;
+	D3D12_CPU_DESCRIPTOR_HANDLE ret;
+	ret.ptr = m_heapStarts[block] + (SIZE_T)(handle.index % s_numDescriptorsPerHeap) * m_descriptorSize;
 	return ret;
 }
 
+uint32_t DescriptorAllocator::IndexOf(D3D12_CPU_DESCRIPTOR_HANDLE handle) const
+{
+	std::lock_guard<std::mutex> lockGuard(s_allocationMutex);
+	const SIZE_T heap_size = (SIZE_T)s_numDescriptorsPerHeap * m_descriptorSize;
+	for (size_t i = 0; i < m_heapStarts.size(); ++i)
+	{
+		if (handle.ptr >= m_heapStarts[i] && handle.ptr < m_heapStarts[i] + heap_size)
+			return (uint32_t)(i * s_numDescriptorsPerHeap + (handle.ptr - m_heapStarts[i]) / m_descriptorSize);
+	}
+	return UINT32_MAX;
+}
+
 ID3D12DescriptorHeap* DescriptorAllocator::RequestNewHeap(D3D12_DESCRIPTOR_HEAP_TYPE type)
 {
 	std::lock_guard<std::mutex> lockGuard(s_allocationMutex);
@@ -40,5 +104,13 @@ ID3D12DescriptorHeap* DescriptorAllocator::RequestNewHeap(D3D12_DESCRIPTOR_HEAP_
 
 void DescriptorAllocator::DestroyAll()
 {
+	std::lock_guard<std::mutex> lockGuard(s_allocationMutex);
+	for (uint32_t i = 0; i < D3D12_DESCRIPTOR_HEAP_TYPE_NUM_TYPES; ++i)
+	{
+		g_DescriptorAllocator[i].m_freeList.Reset();
+		g_DescriptorAllocator[i].m_heapStarts.clear();
+	}
 	s_descriptorHeapPool.clear();
+	// resources released later keep their handles, their frees are dropped
+	s_destroyed = true;
 }
\ No newline at end of file
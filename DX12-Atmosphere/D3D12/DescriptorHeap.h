@@ -1,11 +1,16 @@
 #pragma once
 #include "stdafx.h"
+#include "DescriptorFreeList.h"
 
+// CPU only descriptors in heaps of 256, ranges freed with Free come back once the work
+// submitted before the free completed. The resources keep the generation checked handles
+// of AllocateHandle and resolve them with GetCpuHandle, which catches use after free in
+// debug builds. Allocate and Free of plain CPU handles are for the views nothing owns.
 class DescriptorAllocator
 {
 public:
 	DescriptorAllocator(D3D12_DESCRIPTOR_HEAP_TYPE type) :
-		m_type(type)
+		m_type(type), m_descriptorSize(0), m_freeList(s_numDescriptorsPerHeap)
 	{
 
 	}
@@ -13,20 +18,43 @@ public:
 	~DescriptorAllocator() {}
 
 	D3D12_CPU_DESCRIPTOR_HANDLE Allocate(uint32_t count);
+	DescriptorFreeList::Handle AllocateHandle(uint32_t count);
+
+	// A handle from Allocate and the count it was allocated with, nothing is freed unless
+	// the range starting there has that count. Ignored after DestroyAll.
+	void Free(D3D12_CPU_DESCRIPTOR_HANDLE handle, uint32_t count);
+	void Free(const DescriptorFreeList::Handle& handle);
+
+	D3D12_CPU_DESCRIPTOR_HANDLE GetCpuHandle(const DescriptorFreeList::Handle& handle) const;
+	bool IsLive(const DescriptorFreeList::Handle& handle) const { return m_freeList.IsLive(handle); }
+	DescriptorFreeList::Stats GetStats() const { return m_freeList.GetStats(); }
 
 	static void DestroyAll();
 
+	// Changes whenever a view was written into a slot that may have held another, see
+	// RefreshDescriptor. A cache of descriptors copied by CPU handle drops everything when
+	// it moved, a free alone leaves the slot as it was until the next view goes there.
+	static uint64_t GetViewEpoch() { return s_viewEpoch.load(std::memory_order_acquire); }
+	static void ViewsChanged() { s_viewEpoch.fetch_add(1, std::memory_order_acq_rel); }
+
 private:
 	static const uint32_t s_numDescriptorsPerHeap = 256;
 	static std::mutex s_allocationMutex;
 	static std::vector<Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>> s_descriptorHeapPool;
+	static bool s_destroyed;
+	static std::atomic<uint64_t> s_viewEpoch;
 	static ID3D12DescriptorHeap* RequestNewHeap(D3D12_DESCRIPTOR_HEAP_TYPE type);
 
+	// The slot of a handle, UINT32_MAX if it is in none of the heaps
+	uint32_t IndexOf(D3D12_CPU_DESCRIPTOR_HANDLE handle) const;
+
 	D3D12_DESCRIPTOR_HEAP_TYPE m_type;
-	ID3D12DescriptorHeap* m_curHeap;
-	D3D12_CPU_DESCRIPTOR_HANDLE m_curHandle;
 	uint32_t m_descriptorSize;
-	uint32_t m_remainingFreeHandles;
+	DescriptorFreeList m_freeList;
+	// a new block and its heap together
+	std::mutex m_blockMutex;
+	// the heap of each block of m_freeList, under s_allocationMutex
+	std::vector<SIZE_T> m_heapStarts;
 };
 
 class DescriptorHandle
@@ -0,0 +1,101 @@
+#include "stdafx.h"
+#include "DescriptorRangeCache.h"
+#include <cstring>
+
+DescriptorRangeCache::DescriptorRangeCache(uint32_t maxEntries /* = 4096 */, uint32_t hashBits /* = 64 */)
+	: m_maxEntries(maxEntries > 0 ? maxEntries : 1),
+	m_hashMask(hashBits >= 64 ? ~0ull : (1ull << hashBits) - 1),
+	m_epoch(0), m_stats()
+{
+	m_lookup.reserve(maxEntries);
+}
+
+uint64_t DescriptorRangeCache::Hash(const uint64_t* handles, uint32_t count)
+{
+	// handles are descriptor sized steps apart, mixed well enough by a splitmix round each
+	uint64_t hash = 0x9e3779b97f4a7c15ull ^ count;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		uint64_t x = hash ^ handles[i];
+		x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+		x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+		hash = x ^ (x >> 31);
+	}
+	return hash;
+}
+
+bool DescriptorRangeCache::Matches(const Entry& entry, const uint64_t* handles, uint32_t count) const
+{
+	return entry.count == count && std::memcmp(&m_keys[entry.keyOffset], handles, count * sizeof(uint64_t)) == 0;
+}
+
+bool DescriptorRangeCache::Find(const uint64_t* handles, uint32_t count, uint64_t& location)
+{
+	++m_stats.lookups;
+	if (m_entries.empty())
+		return false;
+	auto range = m_lookup.equal_range(Key(handles, count));
+	for (auto it = range.first; it != range.second; ++it)
+	{
+		const Entry& entry = m_entries[it->second];
+		if (Matches(entry, handles, count))
+		{
+			location = entry.location;
+			++m_stats.hits;
+			m_stats.descriptorsSaved += count;
+			return true;
+		}
+	}
+	return false;
+}
+
+void DescriptorRangeCache::Insert(const uint64_t* handles, uint32_t count, uint64_t location)
+{
+	if (count == 0)
+		return;
+	uint64_t hash = Key(handles, count);
+	// the same contents copied twice, the first copy stays
+	auto range = m_lookup.equal_range(hash);
+	for (auto it = range.first; it != range.second; ++it)
+	{
+		if (Matches(m_entries[it->second], handles, count))
+			return;
+	}
+	if (IsFull())
+	{
+		Clear();
+		++m_stats.evictions;
+	}
+	Entry entry = { (uint32_t)m_keys.size(), count, location };
+	m_keys.insert(m_keys.end(), handles, handles + count);
+	m_lookup.emplace(hash, (uint32_t)m_entries.size());
+	m_entries.push_back(entry);
+	++m_stats.insertions;
+}
+
+void DescriptorRangeCache::Clear()
+{
+	if (m_entries.empty())
+		return;
+	m_lookup.clear();
+	m_entries.clear();
+	m_keys.clear();
+	++m_stats.clears;
+}
+
+bool DescriptorRangeCache::Validate(uint64_t epoch)
+{
+	if (epoch == m_epoch)
+		return false;
+	m_epoch = epoch;
+	bool had_entries = !m_entries.empty();
+	Clear();
+	return had_entries;
+}
+
+DescriptorRangeCache::Stats DescriptorRangeCache::GetStats() const
+{
+	Stats stats = m_stats;
+	stats.entries = (uint32_t)m_entries.size();
+	return stats;
+}
\ No newline at end of file
@@ -0,0 +1,66 @@
+#pragma once
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// The descriptor tables a DynamicDescriptorHeap already copied, by content. A key is the
+// ptrs of the CPU handles staged for one table, 0 for a slot nothing was staged in, and
+// the value the location of the copy, the GPU handle where the table starts. Entries are
+// found by the hash of the key and the whole key is compared, a collision is only a miss.
+// A view written again, or into slots freed by another, leaves the same CPU handle with
+// other contents, Validate drops everything when the view epoch moved. A full cache starts
+// over, the tables still in use are inserted again as they miss. Not thread safe, one per
+// DynamicDescriptorHeap like the heap space the locations point into.
+class DescriptorRangeCache
+{
+public:
+	struct Stats
+	{
+		uint64_t lookups;
+		uint64_t hits;
+		uint64_t insertions;
+		uint64_t clears;
+		// the clears of a full cache
+		uint64_t evictions;
+		// descriptors of the tables found, the copies saved
+		uint64_t descriptorsSaved;
+		uint32_t entries;
+	};
+
+	// hashBits below 64 keep that many bits of Hash, for the check on collisions
+	explicit DescriptorRangeCache(uint32_t maxEntries = 4096, uint32_t hashBits = 64);
+
+	static uint64_t Hash(const uint64_t* handles, uint32_t count);
+
+	bool Find(const uint64_t* handles, uint32_t count, uint64_t& location);
+	// Evicts every entry when full
+	void Insert(const uint64_t* handles, uint32_t count, uint64_t location);
+	void Clear();
+	// Clears when epoch is not the one of the last call, true if that dropped entries
+	bool Validate(uint64_t epoch);
+
+	bool IsEmpty() const { return m_entries.empty(); }
+	bool IsFull() const { return m_entries.size() >= m_maxEntries; }
+	Stats GetStats() const;
+
+private:
+	struct Entry
+	{
+		// into m_keys
+		uint32_t keyOffset;
+		uint32_t count;
+		uint64_t location;
+	};
+
+	bool Matches(const Entry& entry, const uint64_t* handles, uint32_t count) const;
+
+	uint64_t Key(const uint64_t* handles, uint32_t count) const { return Hash(handles, count) & m_hashMask; }
+
+	uint32_t m_maxEntries;
+	uint64_t m_hashMask;
+	uint64_t m_epoch;
+	std::unordered_multimap<uint64_t, uint32_t> m_lookup;
+	std::vector<Entry> m_entries;
+	std::vector<uint64_t> m_keys;
+	Stats m_stats;
+};
\ No newline at end of file
@@ -0,0 +1,152 @@
+#include "stdafx.h"
+#include "DescriptorRangeCacheBenchmark.h"
+#include "DescriptorRangeCache.h"
+#include "Math/Random.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+using Math::RandomNumberGenerator;
+
+namespace
+{
+	typedef std::vector<uint64_t> TableKey;
+
+	DescriptorRangeCacheBenchmark::Pass RunPass(const DescriptorRangeCacheBenchmark::Desc& desc, const std::vector<TableKey>& tables,
+		uint32_t hashBits, SelfTest::Violations& violations)
+	{
+		DescriptorRangeCache cache(desc.maxEntries, hashBits);
+		const uint64_t mask = hashBits >= 64 ? ~0ull : (1ull << hashBits) - 1;
+		RandomNumberGenerator rng(desc.seed, 1);
+
+		// what the cache should hold, and how many of those tables each bucket holds
+		std::map<TableKey, uint64_t> expected;
+		std::unordered_map<uint64_t, uint32_t> buckets;
+		auto bucket = [mask](const TableKey& key) { return DescriptorRangeCache::Hash(key.data(), (uint32_t)key.size()) & mask; };
+
+		DescriptorRangeCacheBenchmark::Pass pass = {};
+		uint64_t epoch = 0;
+		uint64_t next_location = 0x10000;
+		for (uint32_t i = 1; i <= desc.numLookups; ++i)
+		{
+			if (desc.validateInterval > 0 && i % desc.validateInterval == 0)
+			{
+				// a view written again, or not
+				bool moves = rng.NextUInt() % 2 != 0;
+				epoch += moves;
+				bool dropped = cache.Validate(epoch);
+				violations.Add("validate", dropped != (moves && !expected.empty()));
+				if (moves)
+				{
+					pass.epochClears += dropped;
+					expected.clear();
+					buckets.clear();
+				}
+				violations.Add("validate", moves && !cache.IsEmpty());
+			}
+
+			// the low indices more often, the passes every frame against the rare ones
+			uint32_t a = rng.NextUInt() % (uint32_t)tables.size();
+			uint32_t b = rng.NextUInt() % (uint32_t)tables.size();
+			const TableKey& key = tables[std::min(a, b)];
+			uint32_t count = (uint32_t)key.size();
+
+			++pass.lookups;
+			uint64_t location = 0;
+			bool found = cache.Find(key.data(), count, location);
+			auto it = expected.find(key);
+			if (it != expected.end())
+			{
+				violations.Add("misses", !found);
+				violations.Add("wrong location", found && location != it->second);
+				pass.hits += found;
+				continue;
+			}
+			violations.Add("false hits", found);
+			auto other = buckets.find(bucket(key));
+			pass.collisions += other != buckets.end() && other->second > 0;
+
+			// the copy, at a location no other table had
+			if (expected.size() >= desc.maxEntries)
+			{
+				expected.clear();
+				buckets.clear();
+				++pass.evictions;
+			}
+			location = next_location;
+			next_location += 32 * count;
+			cache.Insert(key.data(), count, location);
+			expected.emplace(key, location);
+			++buckets[bucket(key)];
+			violations.Add("over capacity", cache.GetStats().entries > desc.maxEntries);
+		}
+
+		DescriptorRangeCache::Stats stats = cache.GetStats();
+		violations.Add("evictions", stats.evictions != pass.evictions);
+		violations.Add("stats", stats.lookups != pass.lookups || stats.hits != pass.hits || stats.entries != expected.size());
+		return pass;
+	}
+}
+
+DescriptorRangeCacheBenchmark::Desc DescriptorRangeCacheBenchmark::DefaultDesc()
+{
+	Desc desc;
+	desc.numTables = 3000;
+	// the cloud passes bind up to 8 SRVs in one table
+	desc.maxTableSize = 8;
+	desc.numHandles = 64;
+	desc.numLookups = 200000;
+	desc.maxEntries = 1024;
+	desc.validateInterval = 5000;
+	desc.collisionBits = 6;
+	desc.seed = 1;
+	return desc;
+}
+
+DescriptorRangeCacheBenchmark::Result DescriptorRangeCacheBenchmark::Run(const Desc& desc)
+{
+	Result result = {};
+	RandomNumberGenerator rng(desc.seed);
+	const uint32_t max_size = std::max(desc.maxTableSize, 1u);
+	const uint32_t num_handles = std::max(desc.numHandles, 1u);
+
+	// distinct tables, CPU handles a descriptor apart, 0 for a slot nothing was staged in
+	std::vector<TableKey> tables;
+	{
+		std::map<TableKey, uint32_t> seen;
+		while (tables.size() < std::max(desc.numTables, 1u))
+		{
+			TableKey key(1 + rng.NextUInt() % max_size);
+			for (uint64_t& handle : key)
+				handle = rng.NextUInt() % 8 == 0 ? 0 : 0x100000 + 32ull * (rng.NextUInt() % num_handles);
+			if (seen.emplace(key, (uint32_t)tables.size()).second)
+				tables.push_back(key);
+		}
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+	SelfTest::Violations hashed;
+	result.hashed = RunPass(desc, tables, 64, hashed);
+	result.seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	SelfTest::Violations colliding;
+	result.colliding = RunPass(desc, tables, desc.collisionBits, colliding);
+	colliding.Add("no collisions", result.colliding.collisions == 0);
+
+	result.violations.Merge(hashed, "hashed ");
+	result.violations.Merge(colliding, "colliding ");
+	result.lookupsPerSecond = result.hashed.lookups / std::max(result.seconds, 1e-9);
+	return result;
+}
+
+std::string DescriptorRangeCacheBenchmark::Summarize(const Result& result)
+{
+	char line[256];
+	snprintf(line, sizeof(line), "%.1f M lookups / s, %.1f%% hits, %llu evictions, %llu epoch clears, %llu colliding misses at %.1f%% hits",
+		result.lookupsPerSecond * 1e-6, 100.0 * result.hashed.hits / std::max<uint64_t>(result.hashed.lookups, 1),
+		(unsigned long long)result.hashed.evictions, (unsigned long long)result.hashed.epochClears,
+		(unsigned long long)result.colliding.collisions, 100.0 * result.colliding.hits / std::max<uint64_t>(result.colliding.lookups, 1));
+	return line;
+}
\ No newline at end of file
@@ -0,0 +1,57 @@
+#pragma once
+#include "Utils/SelfTest.h"
+#include <cstdint>
+#include <string>
+
+// DescriptorRangeCache on the CPU, against a map of the tables it should hold. numTables
+// tables of 1 to maxTableSize handles, picked from numHandles descriptor slots with a few
+// left unset, are looked up numLookups times, the low indices more often, and a miss is
+// inserted at a new location like a copy. Every validateInterval lookups the view epoch
+// moves, or stays on every other call. The cache holds maxEntries, fewer than numTables, so
+// it fills and evicts. The run is repeated with collisionBits bits of the hash, where tables
+// with other handles share buckets. Checks that a lookup hits exactly when the map holds the
+// table, at the location it was inserted with, that Validate drops everything and only when
+// the epoch moved, and that the cache evicts when the map does and never holds more than
+// maxEntries.
+class DescriptorRangeCacheBenchmark
+{
+public:
+	struct Desc
+	{
+		uint32_t numTables;
+		uint32_t maxTableSize;
+		uint32_t numHandles;
+		uint32_t numLookups;
+		uint32_t maxEntries;
+		uint32_t validateInterval;
+		uint32_t collisionBits;
+		uint32_t seed;
+	};
+
+	struct Pass
+	{
+		uint64_t lookups;
+		uint64_t hits;
+		// misses on a bucket that held other tables
+		uint64_t collisions;
+		uint64_t evictions;
+		uint64_t epochClears;
+	};
+
+	struct Result
+	{
+		double seconds;
+		double lookupsPerSecond;
+		Pass hashed;
+		Pass colliding;
+		// "false hits" on a table the map does not hold, "wrong location", "misses" of a
+		// table it holds, "validate" results that disagree, "evictions" at another time,
+		// "over capacity", "stats" that disagree with the counts here, "no collisions" in
+		// the colliding run, under "hashed " and "colliding "
+		SelfTest::Violations violations;
+	};
+
+	static Desc DefaultDesc();
+	static Result Run(const Desc& desc);
+	static std::string Summarize(const Result& result);
+};
\ No newline at end of file
@@ -0,0 +1,215 @@
+#include "stdafx.h"
+#include "DescriptorTableCacheBenchmark.h"
+#include "CommandContext.h"
+#include "DynamicDescriptorHeap.h"
+#include "GpuBuffer.h"
+#include "GraphicsCore.h"
+#include "PipelineState.h"
+#include "RootSignature.h"
+#include "CompiledShaders/DescriptorTableCheck_CS.h"
+#include "Math/Random.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+using Math::RandomNumberGenerator;
+
+namespace
+{
+	// TABLE_SIZE of DescriptorTableCheck_CS
+	const uint32_t kTableSize = 10;
+	// elements per view, the versions it goes through before one repeats
+	const uint32_t kMaxVersions = 256;
+
+	struct Pass
+	{
+		std::vector<uint32_t> views;
+		// the second view of the history slot
+		uint32_t historyView;
+		bool varying;
+	};
+
+	// what a view of the buffer of indices reads, the element view * kMaxVersions + version
+	uint32_t ElementOf(uint32_t view, uint32_t version)
+	{
+		return view * kMaxVersions + version % kMaxVersions;
+	}
+
+	void WriteView(StructuredBuffer& elements, D3D12_CPU_DESCRIPTOR_HANDLE handle, uint32_t element)
+	{
+		D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
+		srvDesc.Format = DXGI_FORMAT_UNKNOWN;
+		srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+		srvDesc.Buffer.FirstElement = element;
+		srvDesc.Buffer.NumElements = 1;
+		srvDesc.Buffer.StructureByteStride = sizeof(uint32_t);
+		srvDesc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_NONE;
+		g_Device->CreateShaderResourceView(elements.GetResource(), &srvDesc, handle);
+	}
+
+	DescriptorTableCacheBenchmark::ModeResult RunMode(const DescriptorTableCacheBenchmark::Desc& desc, DynamicDescriptorHeap::TableCacheMode mode)
+	{
+		DescriptorTableCacheBenchmark::ModeResult result = {};
+		RandomNumberGenerator rng(desc.seed);
+		const uint32_t num_views = std::max(desc.numViews, kTableSize + 2);
+		const uint32_t dispatches = std::max(desc.dispatchesPerPass, 1u);
+		const uint32_t lists = std::max(desc.listsPerFrame, 1u);
+		const uint32_t dispatches_per_frame = desc.numPasses * dispatches;
+
+		// the shared views, then the ones the varying slot steps through
+		const uint32_t total_views = num_views + dispatches;
+		std::vector<uint32_t> indices(total_views * kMaxVersions);
+		for (uint32_t i = 0; i < (uint32_t)indices.size(); ++i)
+			indices[i] = i;
+		StructuredBuffer elements;
+		elements.Create(L"Descriptor Table Elements", (uint32_t)indices.size(), sizeof(uint32_t), indices.data());
+		StructuredBuffer output;
+		output.Create(L"Descriptor Table Output", std::max(dispatches_per_frame, 1u) * kTableSize, sizeof(uint32_t));
+		ReadbackBuffer readback;
+		readback.Create(L"Descriptor Table Readback", std::max(dispatches_per_frame, 1u) * kTableSize, sizeof(uint32_t));
+
+		RootSignature rs;
+		rs.Reset(3);
+		rs[0].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 0, kTableSize);
+		rs[1].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 0, 1);
+		rs[2].InitAsConstants(1, 0);
+		rs.Finalize(L"Descriptor Table Check");
+		ComputePSO pso;
+		pso.SetRootSignature(rs);
+		pso.SetComputeShader(g_pDescriptorTableCheck_CS, sizeof(g_pDescriptorTableCheck_CS));
+		pso.Finalize();
+
+		std::vector<D3D12_CPU_DESCRIPTOR_HANDLE> handles(total_views);
+		std::vector<uint32_t> versions(total_views, 0);
+		for (uint32_t v = 0; v < total_views; ++v)
+		{
+			handles[v] = AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+			WriteView(elements, handles[v], ElementOf(v, 0));
+		}
+
+		std::vector<Pass> passes(desc.numPasses);
+		for (uint32_t p = 0; p < desc.numPasses; ++p)
+		{
+			Pass& pass = passes[p];
+			for (uint32_t i = 0; i < kTableSize; ++i)
+				pass.views.push_back(rng.NextUInt() % num_views);
+			pass.historyView = rng.NextUInt() % num_views;
+			pass.varying = desc.varyingPass > 0 && p % desc.varyingPass == 0;
+		}
+
+		DynamicDescriptorHeap::TableCacheMode saved_mode = DynamicDescriptorHeap::GetTableCacheMode();
+		DynamicDescriptorHeap::SetTableCacheMode(mode);
+		// the counts from here on are this run's
+		DynamicDescriptorHeap::EndFrame();
+
+		std::vector<uint32_t> expected(dispatches_per_frame * kTableSize);
+		uint32_t key[kTableSize];
+		D3D12_CPU_DESCRIPTOR_HANDLE table[kTableSize];
+		auto start = std::chrono::high_resolution_clock::now();
+		for (uint32_t frame = 1; frame <= desc.numFrames; ++frame)
+		{
+			if (desc.recreateInterval > 0 && frame % desc.recreateInterval == 0)
+			{
+				uint32_t view = rng.NextUInt() % num_views;
+				WriteView(elements, handles[view], ElementOf(view, ++versions[view]));
+				RefreshDescriptor(handles[view]);
+			}
+
+			uint32_t dispatch = 0;
+			for (uint32_t list = 0; list < lists; ++list)
+			{
+				ComputeContext& context = ComputeContext::Begin(L"Descriptor Table Check");
+				context.SetRootSignature(rs);
+				context.SetPipelineState(pso);
+				context.TransitionResource(output, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, true);
+				context.SetDynamicDescriptor(1, 0, output.GetUAV());
+				result.copiedUncached += 1;
+				for (uint32_t p = list; p < desc.numPasses; p += lists)
+				{
+					const Pass& pass = passes[p];
+					for (uint32_t d = 0; d < dispatches; ++d, ++dispatch)
+					{
+						std::copy(pass.views.begin(), pass.views.end(), key);
+						if (frame & 1)
+							key[0] = pass.historyView;
+						if (pass.varying)
+							key[1] = num_views + d;
+						for (uint32_t i = 0; i < kTableSize; ++i)
+						{
+							table[i] = handles[key[i]];
+							expected[dispatch * kTableSize + i] = ElementOf(key[i], versions[key[i]]);
+						}
+						context.SetDynamicDescriptors(0, 0, kTableSize, table);
+						context.SetConstants(2, dispatch * kTableSize);
+						context.Dispatch(1, 1, 1);
+						result.copiedUncached += kTableSize;
+					}
+				}
+				if (list + 1 == lists)
+					context.CopyBuffer(readback, output);
+				context.Finish(list + 1 == lists);
+			}
+
+			const uint32_t* values = (const uint32_t*)readback.Map();
+			for (uint32_t i = 0; i < dispatch * kTableSize; ++i)
+				result.violations.Add("wrong contents", values[i] != expected[i]);
+			readback.Unmap();
+		}
+		result.seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+		DynamicDescriptorHeap::EndFrame();
+		result.copied = DynamicDescriptorHeap::GetCopiedLastFrame();
+		result.lookups = DynamicDescriptorHeap::GetTableLookupsLastFrame();
+		result.hits = DynamicDescriptorHeap::GetTableHitsLastFrame();
+		result.hitRate = result.lookups > 0 ? (double)result.hits / result.lookups : 0.0;
+		result.violations.Add("no hits", mode != DynamicDescriptorHeap::kTableCacheOff && desc.numFrames > 1 && result.hits == 0);
+		result.violations.Add("hits while off", mode == DynamicDescriptorHeap::kTableCacheOff ? result.hits : 0);
+		DynamicDescriptorHeap::SetTableCacheMode(saved_mode);
+
+		for (D3D12_CPU_DESCRIPTOR_HANDLE& handle : handles)
+			FreeDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, handle);
+		return result;
+	}
+}
+
+DescriptorTableCacheBenchmark::Desc DescriptorTableCacheBenchmark::DefaultDesc()
+{
+	Desc desc;
+	desc.numViews = 64;
+	// the cloud passes, shadow, low resolution, temporal and upsample
+	desc.numPasses = 6;
+	desc.dispatchesPerPass = 4;
+	desc.varyingPass = 3;
+	desc.listsPerFrame = 2;
+	desc.recreateInterval = 10;
+	desc.numFrames = 200;
+	desc.seed = 1;
+	return desc;
+}
+
+DescriptorTableCacheBenchmark::Result DescriptorTableCacheBenchmark::Run(const Desc& desc)
+{
+	static const char* mode_names[] = { "off ", "per command list ", "cross frame " };
+	Result result;
+	for (uint32_t mode = DynamicDescriptorHeap::kTableCacheOff; mode <= DynamicDescriptorHeap::kTableCacheCrossFrame; ++mode)
+	{
+		result.modes[mode] = RunMode(desc, (DynamicDescriptorHeap::TableCacheMode)mode);
+		result.violations.Merge(result.modes[mode].violations, mode_names[mode]);
+	}
+	return result;
+}
+
+std::string DescriptorTableCacheBenchmark::Summarize(const Result& result)
+{
+	char line[256];
+	snprintf(line, sizeof(line), "descriptors copied: %llu of %llu off, %llu per command list (%.0f%% hits), %llu cross frame (%.0f%% hits)",
+		(unsigned long long)result.modes[DynamicDescriptorHeap::kTableCacheOff].copied,
+		(unsigned long long)result.modes[DynamicDescriptorHeap::kTableCacheOff].copiedUncached,
+		(unsigned long long)result.modes[DynamicDescriptorHeap::kTableCachePerCommandList].copied,
+		result.modes[DynamicDescriptorHeap::kTableCachePerCommandList].hitRate * 100.0,
+		(unsigned long long)result.modes[DynamicDescriptorHeap::kTableCacheCrossFrame].copied,
+		result.modes[DynamicDescriptorHeap::kTableCacheCrossFrame].hitRate * 100.0);
+	return line;
+}
\ No newline at end of file
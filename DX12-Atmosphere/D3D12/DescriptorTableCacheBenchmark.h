@@ -0,0 +1,56 @@
+#pragma once
+#include "Utils/SelfTest.h"
+#include <cstdint>
+#include <string>
+
+// The table copies of DynamicDescriptorHeap on the device, in each TableCacheMode. Every
+// frame numPasses passes run dispatchesPerPass dispatches of DescriptorTableCheck_CS, spread
+// over listsPerFrame ComputeContexts. A pass binds one table of views, the same ones every
+// frame except for a history slot that alternates between two views like a temporal pass,
+// and in every varyingPass-th pass a slot that changes per dispatch like a mip chain. A view
+// is one element of a buffer whose elements hold their index, so a dispatch writes the
+// elements its table points at. Every recreateInterval frames a view is written again at the
+// same CPU handle, with another element, and refreshed like a resized buffer. The counts are
+// the ones DynamicDescriptorHeap::EndFrame reads, and the output of every dispatch is read
+// back and compared with the current elements of the views it bound.
+class DescriptorTableCacheBenchmark
+{
+public:
+	struct Desc
+	{
+		uint32_t numViews;
+		uint32_t numPasses;
+		uint32_t dispatchesPerPass;
+		uint32_t varyingPass;
+		uint32_t listsPerFrame;
+		uint32_t recreateInterval;
+		uint32_t numFrames;
+		uint32_t seed;
+	};
+
+	struct ModeResult
+	{
+		double seconds;
+		uint64_t lookups;
+		uint64_t hits;
+		double hitRate;
+		// descriptors copied, and what every table copied would have been
+		uint64_t copied;
+		uint64_t copiedUncached;
+		// "wrong contents", views a dispatch read that are not the current ones of its table,
+		// "no hits" when a caching mode found nothing and "hits while off"
+		SelfTest::Violations violations;
+	};
+
+	struct Result
+	{
+		// by DynamicDescriptorHeap::TableCacheMode
+		ModeResult modes[3];
+		// of all three
+		SelfTest::Violations violations;
+	};
+
+	static Desc DefaultDesc();
+	static Result Run(const Desc& desc);
+	static std::string Summarize(const Result& result);
+};
\ No newline at end of file
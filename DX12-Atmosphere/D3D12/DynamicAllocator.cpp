@@ -4,59 +4,35 @@
 
 DynamicAllocationPage* DynamicAllocatorManager::RequestPage()
 {
-	std::lock_guard<std::mutex> lockGuard(m_mutex);
-
-	while (!m_retiredPages.empty() && g_CommandManager.IsFenceComplete(m_retiredPages.front().first))
-	{
-		m_availablePages.push(m_retiredPages.front().second);
-		m_retiredPages.pop();
-	}
-
-	DynamicAllocationPage* pagePtr = nullptr;
-
-	if (!m_availablePages.empty())
-	{
-		pagePtr = m_availablePages.front();
-		m_availablePages.pop();
-	}
-	else
-	{
-		pagePtr = CreateNewPage(0);
-		m_pagePool.emplace_back(pagePtr);
-	}
-	return pagePtr;
+	return m_retiredPages.Request([](uint64_t fenceValue) { return g_CommandManager.IsFenceComplete(fenceValue); },
+		[this]()
+		{
+			DynamicAllocationPage* pagePtr = CreateNewPage(0);
+			std::lock_guard<std::mutex> lockGuard(m_mutex);
+			m_pagePool.emplace_back(pagePtr);
+			return pagePtr;
+		});
 }
 
 DynamicAllocationPage* DynamicAllocatorManager::CreateNewPage(size_t pageSize /* = 0 */)
 {
 	pageSize = pageSize == 0 ? 0x200000 : pageSize;
-	void* pagePtr = (void*)new uint8_t[pageSize];
-	return new DynamicAllocationPage(pagePtr);
+	PageMemory::Kind kind;
+	void* pagePtr = PageMemory::Allocate(pageSize, true, kind);
+	return new DynamicAllocationPage(pagePtr, pageSize, kind);
 }
 
 void DynamicAllocatorManager::DiscardPages(uint64_t fenceID, const std::vector<DynamicAllocationPage *>& usedPage)
 {
-	std::lock_guard<std::mutex> lockGuard(m_mutex);
-	for (auto iter = usedPage.begin(); iter != usedPage.end(); ++iter)
-	{
-		m_retiredPages.push({ fenceID, *iter });
-	}
+	m_retiredPages.Retire(fenceID, usedPage);
 }
 
 void DynamicAllocatorManager::FreeLargePages(uint64_t fenceID, const std::vector<DynamicAllocationPage *>& pages)
 {
-	std::lock_guard<std::mutex> lockGuard(m_mutex);
-	
-	while (!m_deletionQueue.empty() && g_CommandManager.IsFenceComplete(m_deletionQueue.front().first))
-	{
-		delete m_deletionQueue.front().second;
-		m_deletionQueue.pop();
-	}
+	m_deletionQueue.Reclaim([](uint64_t fenceValue) { return g_CommandManager.IsFenceComplete(fenceValue); },
+		[](DynamicAllocationPage* page) { delete page; });
 
-	for (auto iter = pages.begin(); iter != pages.end(); ++iter)
-	{
-		m_deletionQueue.push({ fenceID, *iter });
-	}
+	m_deletionQueue.Retire(fenceID, pages);
 }
 
 DynamicAllocatorManager DynamicAllocator::s_pageManager;
@@ -72,6 +48,8 @@ void DynamicAllocator::CleanupUsedPages(uint64_t fenceID)
 
 	s_pageManager.DiscardPages(fenceID, m_retiredPages);
 	m_retiredPages.clear();
+	s_pageManager.AddBytes(m_bytesAllocated);
+	m_bytesAllocated = 0;
 
 	s_pageManager.FreeLargePages(fenceID, m_largePageList);
 	m_largePageList.clear();
@@ -81,6 +59,7 @@ DynMem DynamicAllocator::AllocateLargePage(size_t sizeInBytes)
 {
 	DynamicAllocationPage* oneOff = s_pageManager.CreateNewPage(sizeInBytes);
 	m_largePageList.push_back(oneOff);
+	m_bytesAllocated += sizeInBytes;
 
 	DynMem ret;
 	ret.offset = 0;
@@ -119,6 +98,7 @@ DynMem DynamicAllocator::Allocate(size_t sizeInBytes, size_t alignment /* = 64 *
 	ret.size = alignedSize;
 
 	m_currOffset += alignedSize;
+	m_bytesAllocated += alignedSize;
 	
 	return ret;
 }
\ No newline at end of file
@@ -1,5 +1,8 @@
 #pragma once
 #include "stdafx.h"
+#include "FenceRecycler.h"
+#include "PageCache.h"
+#include "PageMemory.h"
 
 struct DynMem
 {
@@ -12,17 +15,19 @@ class DynamicAllocationPage
 {
 	friend class DynamicAllocator;
 public:
-	DynamicAllocationPage(void* ptr)
+	DynamicAllocationPage(void* ptr, size_t size, PageMemory::Kind kind)
+		: m_pagePtr(ptr), m_size(size), m_kind(kind)
 	{
-		m_pagePtr = ptr;
 	}
 
 	~DynamicAllocationPage()
 	{
-		delete[] m_pagePtr;
+		PageMemory::Free(m_pagePtr, m_size, m_kind);
 	}
 private:
 	void* m_pagePtr;
+	size_t m_size;
+	PageMemory::Kind m_kind;
 };
 
 class DynamicAllocatorManager
@@ -36,19 +41,27 @@ public:
 
 	void FreeLargePages(uint64_t fenceID, const std::vector<DynamicAllocationPage*>& pages);
 
-	void Destroy() { m_pagePool.clear(); }
+	void AddBytes(uint64_t bytes) { m_retiredPages.AddBytes(bytes); }
+	void EndFrame() { m_retiredPages.EndFrame(); }
+	PageCache<DynamicAllocationPage>::Stats GetStats() const { return m_retiredPages.GetStats(); }
+
+	void Destroy()
+	{
+		m_retiredPages.Reset();
+		m_pagePool.clear();
+	}
 private:
 	std::vector<std::unique_ptr<DynamicAllocationPage>> m_pagePool;
-	std::queue<std::pair<uint64_t, DynamicAllocationPage*>> m_retiredPages;
-	std::queue<std::pair<uint64_t, DynamicAllocationPage*>> m_deletionQueue;
-	std::queue<DynamicAllocationPage*> m_availablePages;
+	PageCache<DynamicAllocationPage> m_retiredPages;
+	FenceRecycler<DynamicAllocationPage> m_deletionQueue;
+	// m_pagePool only
 	std::mutex m_mutex;
 };
 
 class DynamicAllocator
 {
 public:
-	DynamicAllocator() : m_pageSize(0x200000), m_currOffset(0), m_currPage(nullptr)
+	DynamicAllocator() : m_pageSize(0x200000), m_currOffset(0), m_currPage(nullptr), m_bytesAllocated(0)
 	{
 
 	}
@@ -61,6 +74,10 @@ public:
 	{
 		s_pageManager.Destroy();
 	}
+
+	// Once a frame, for the bytes of the last frame in the stats
+	static void EndFrame() { s_pageManager.EndFrame(); }
+	static PageCache<DynamicAllocationPage>::Stats GetStats() { return s_pageManager.GetStats(); }
 private:
 	DynMem AllocateLargePage(size_t sizeInBytes);
 
@@ -69,6 +86,8 @@ private:
 	size_t m_pageSize;
 	size_t m_currOffset;
 	DynamicAllocationPage* m_currPage;
+	// since the last CleanupUsedPages, added to the manager's stats there
+	size_t m_bytesAllocated;
 	std::vector<DynamicAllocationPage*> m_retiredPages;
 	std::vector<DynamicAllocationPage*> m_largePageList;
 };
\ No newline at end of file
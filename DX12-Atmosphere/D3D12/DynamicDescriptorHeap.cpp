@@ -5,26 +5,23 @@
 
 std::mutex DynamicDescriptorHeap::s_mutex;
 std::vector<Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>> DynamicDescriptorHeap::s_descriptorHeapPool[2];
-std::queue<std::pair<uint64_t, ID3D12DescriptorHeap*>> DynamicDescriptorHeap::s_retiredDescriptorHeaps[2];
-std::queue<ID3D12DescriptorHeap*> DynamicDescriptorHeap::s_availableDescriptorHeaps[2];
+FenceRecycler<ID3D12DescriptorHeap> DynamicDescriptorHeap::s_retiredDescriptorHeaps[2];
+std::atomic<uint64_t> DynamicDescriptorHeap::s_copiedDescriptors(0);
+uint64_t DynamicDescriptorHeap::s_copiedLastFrame = 0;
+std::atomic<DynamicDescriptorHeap::TableCacheMode> DynamicDescriptorHeap::s_tableCacheMode(DynamicDescriptorHeap::kTableCacheOff);
+std::atomic<uint64_t> DynamicDescriptorHeap::s_tableLookups(0);
+std::atomic<uint64_t> DynamicDescriptorHeap::s_tableHits(0);
+uint64_t DynamicDescriptorHeap::s_tableLookupsLastFrame = 0;
+uint64_t DynamicDescriptorHeap::s_tableHitsLastFrame = 0;
 
 ID3D12DescriptorHeap* DynamicDescriptorHeap::RequestDescriptorHeap(D3D12_DESCRIPTOR_HEAP_TYPE heapType)
 {
-	std::lock_guard<std::mutex> lockGuard(s_mutex);
+	uint32_t idx = heapType == D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER ? 1 : 0;
 
-	uint32_t idx = heapType == D3D12_DESCRIPTOR_RANGE_TYPE_SAMPLER ? 1 : 0;
-
-	while (!s_retiredDescriptorHeaps[idx].empty() && g_CommandManager.IsFenceComplete(s_retiredDescriptorHeaps[idx].front().first))
+	ID3D12DescriptorHeap* readyHeap = s_retiredDescriptorHeaps[idx].Acquire([](uint64_t fenceValue) { return g_CommandManager.IsFenceComplete(fenceValue); });
+	if (readyHeap != nullptr)
 	{
-		s_availableDescriptorHeaps[idx].push(s_retiredDescriptorHeaps[idx].front().second);
-		s_retiredDescriptorHeaps[idx].pop();
-	}
-
-	if (!s_availableDescriptorHeaps[idx].empty())
-	{
-		ID3D12DescriptorHeap* heapPtr = s_availableDescriptorHeaps[idx].front();
-		s_availableDescriptorHeaps[idx].pop();
-		return heapPtr;
+		return readyHeap;
 	}
 	else
 	{
@@ -35,6 +32,7 @@ ID3D12DescriptorHeap* DynamicDescriptorHeap::RequestDescriptorHeap(D3D12_DESCRIP
 		heapDesc.NodeMask = 1;
 		Microsoft::WRL::ComPtr<ID3D12DescriptorHeap> heapPtr;
 		ThrowIfFailed(g_Device->CreateDescriptorHeap(&heapDesc, IID_PPV_ARGS(&heapPtr)));
+		std::lock_guard<std::mutex> lockGuard(s_mutex);
 		s_descriptorHeapPool[idx].emplace_back(heapPtr);
 		return heapPtr.Get();
 	}
@@ -42,18 +40,20 @@ ID3D12DescriptorHeap* DynamicDescriptorHeap::RequestDescriptorHeap(D3D12_DESCRIP
 
 void DynamicDescriptorHeap::DiscardDescriptorHeaps(D3D12_DESCRIPTOR_HEAP_TYPE heapType, uint64_t fenceValueForReset, const std::vector<ID3D12DescriptorHeap *>& usedHeaps)
 {
-	uint32_t idx = heapType == D3D12_DESCRIPTOR_RANGE_TYPE_SAMPLER ? 1 : 0;
-	std::lock_guard<std::mutex> lockGuard(s_mutex);
-	for (auto iter = usedHeaps.begin(); iter != usedHeaps.end(); ++iter)
-		s_retiredDescriptorHeaps[idx].push({fenceValueForReset, *iter});
+	uint32_t idx = heapType == D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER ? 1 : 0;
+	s_retiredDescriptorHeaps[idx].Retire(fenceValueForReset, usedHeaps);
 }
 
 DynamicDescriptorHeap::DynamicDescriptorHeap(CommandContext& owningContext, D3D12_DESCRIPTOR_HEAP_TYPE heapType)
 	: m_owningContext(owningContext), m_descriptorType(heapType)
 {
 	m_curHeapPtr = nullptr;
+	m_curPage = nullptr;
+	m_bindlessFallback = false;
 	m_curOffset = 0;
 	m_descriptorSize = g_Device->GetDescriptorHandleIncrementSize(heapType);
+	m_tableCacheMode = kTableCacheOff;
+	m_cacheOffset = 0;
 }
 
 DynamicDescriptorHeap::~DynamicDescriptorHeap()
@@ -66,8 +66,22 @@ inline ID3D12DescriptorHeap* DynamicDescriptorHeap::GetHeapPointer()
 	if (m_curHeapPtr == nullptr)
 	{
 		assert(m_curOffset == 0);
-		m_curHeapPtr = RequestDescriptorHeap(m_descriptorType);
-		m_firstDescriptor = DescriptorHandle(m_curHeapPtr->GetCPUDescriptorHandleForHeapStart(), m_curHeapPtr->GetGPUDescriptorHandleForHeapStart());
+		if (m_descriptorType == D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV && BindlessHeap::IsCreated() && !m_bindlessFallback)
+		{
+			m_curPage = BindlessHeap::RequestPage();
+			if (m_curPage == nullptr)
+				FallBack();
+		}
+		if (m_curPage != nullptr)
+		{
+			m_curHeapPtr = BindlessHeap::GetHeap();
+			m_firstDescriptor = BindlessHeap::GetPageStart(m_curPage);
+		}
+		else
+		{
+			m_curHeapPtr = RequestDescriptorHeap(m_descriptorType);
+			m_firstDescriptor = DescriptorHandle(m_curHeapPtr->GetCPUDescriptorHandleForHeapStart(), m_curHeapPtr->GetGPUDescriptorHandleForHeapStart());
+		}
 	}
 	return m_curHeapPtr;
 }
@@ -80,8 +94,18 @@ void DynamicDescriptorHeap::RetireCurrentHeap()
 		return;
 	}
 	assert(m_curHeapPtr != nullptr);
-	m_retiredHeaps.push_back(m_curHeapPtr);
+	if (m_curPage != nullptr)
+	{
+		m_retiredPages.push_back(m_curPage);
+	}
+	else
+	{
+		// the next heap replaces this one on the command list, its tables can't be bound
+		m_retiredHeaps.push_back(m_curHeapPtr);
+		m_tableCache.Clear();
+	}
 	m_curHeapPtr = nullptr;
+	m_curPage = nullptr;
 	m_curOffset = 0;
 }
 
@@ -95,28 +119,144 @@ void DynamicDescriptorHeap::RetireUsedHeaps(uint64_t fenceValue)
 {
 	DiscardDescriptorHeaps(m_descriptorType, fenceValue, m_retiredHeaps);
 	m_retiredHeaps.clear();
+	if (!m_retiredPages.empty())
+	{
+		BindlessHeap::DiscardPages(fenceValue, m_retiredPages);
+		m_retiredPages.clear();
+	}
 }
 
 void DynamicDescriptorHeap::CleanupUsedHeaps(uint64_t fenceValue)
 {
 	RetireCurrentHeap();
 	RetireUsedHeaps(fenceValue);
+	m_bindlessFallback = false;
+	// the pages were retired with the command list, only cache pages outlive it
+	if (m_tableCacheMode != kTableCacheCrossFrame)
+		m_tableCache.Clear();
 	m_graphicsHandleCache.ClearCache();
 	m_computeHandleCache.ClearCache();
 }
 
-void DynamicDescriptorHeap::CopyAndBindStagedTables(DescriptorHandleCache& handleCache, ID3D12GraphicsCommandList* cmdList, void (ID3D12GraphicsCommandList::*SetFunc)(uint32_t, D3D12_GPU_DESCRIPTOR_HANDLE))
+DynamicDescriptorHeap::TableCacheMode DynamicDescriptorHeap::UpdateTableCacheMode()
 {
-	uint32_t neededSize = handleCache.ComputeStagedSize();
-	if (!HasSpace(neededSize))
+	TableCacheMode mode = s_tableCacheMode.load();
+	// a cached table is bound from wherever it was copied to, across command lists that is
+	// only the same heap when all of them share the BindlessHeap
+	if (mode == kTableCacheCrossFrame && (m_descriptorType != D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV || !BindlessHeap::IsCreated() || m_bindlessFallback))
+		mode = kTableCachePerCommandList;
+	if (mode != m_tableCacheMode)
+	{
+		DropTableCache();
+		m_tableCacheMode = mode;
+	}
+	if (m_tableCache.Validate(DescriptorAllocator::GetViewEpoch()))
+		DropTableCache();
+	return mode;
+}
+
+void DynamicDescriptorHeap::DropTableCache()
+{
+	m_tableCache.Clear();
+	// tables bound on this command list may still be in them, they go with its fence
+	m_retiredPages.insert(m_retiredPages.end(), m_cachePages.begin(), m_cachePages.end());
+	m_cachePages.clear();
+	m_cacheOffset = 0;
+}
+
+void DynamicDescriptorHeap::FallBack()
+{
+	m_bindlessFallback = true;
+	// what was bound and cached so far is in the BindlessHeap, which the next heap replaces
+	m_tableCache.Clear();
+	UnbindAllValid();
+}
+
+bool DynamicDescriptorHeap::ReserveCached(uint32_t count)
+{
+	if (!m_cachePages.empty() && m_cacheOffset + count <= kNumDescriptorsPerHeap)
+		return true;
+	if (m_cachePages.size() == kMaxCachePages)
+		DropTableCache();
+	BindlessHeap::Page* page = BindlessHeap::RequestPage();
+	if (page == nullptr)
+	{
+		FallBack();
+		return false;
+	}
+	m_cachePages.push_back(page);
+	m_cacheOffset = 0;
+	return true;
+}
+
+bool DynamicDescriptorHeap::ReserveBindless(uint32_t count)
+{
+	assert(m_descriptorType == D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+	if (!BindlessHeap::IsCreated() || m_bindlessFallback)
+		return false;
+	if (UpdateTableCacheMode() == kTableCacheCrossFrame && !ReserveCached(count))
+		return false;
+	// UploadDirect takes the current page in every mode
+	if (!HasSpace(count))
 	{
 		RetireCurrentHeap();
 		UnbindAllValid();
-		neededSize = handleCache.ComputeStagedSize();
+		GetHeapPointer();
+	}
+	return !m_bindlessFallback;
+}
+
+DescriptorHandle DynamicDescriptorHeap::AllocateCached(uint32_t count)
+{
+	if (!ReserveCached(count))
+		return DescriptorHandle();
+	DescriptorHandle ret = BindlessHeap::GetPageStart(m_cachePages.back()) + m_cacheOffset * m_descriptorSize;
+	m_cacheOffset += count;
+	return ret;
+}
+
+void DynamicDescriptorHeap::CopyAndBindStagedTables(DescriptorHandleCache& handleCache, ID3D12GraphicsCommandList* cmdList, void (ID3D12GraphicsCommandList::*SetFunc)(uint32_t, D3D12_GPU_DESCRIPTOR_HANDLE))
+{
+	TableCacheMode mode = UpdateTableCacheMode();
+	uint32_t lookups = 0, hits = 0;
+	DescriptorHandle destHandleStart;
+	if (mode == kTableCacheCrossFrame)
+	{
+		// every table is copied to the cache pages, the heap stays the BindlessHeap
+		m_owningContext.SetDescriptorHeap(m_descriptorType, BindlessHeap::GetHeap());
+		handleCache.BindCachedTables(m_tableCache, cmdList, SetFunc, lookups, hits);
+		if (handleCache.m_staleRootParamsBitMap != 0)
+		{
+			destHandleStart = AllocateCached(handleCache.ComputeStagedSize());
+			// no page was free, the fallback unbound the tables and they go below
+			if (destHandleStart.IsNull())
+				mode = UpdateTableCacheMode();
+		}
 	}
+	DescriptorRangeCache* rangeCache = mode == kTableCacheOff ? nullptr : &m_tableCache;
+	if (mode != kTableCacheCrossFrame)
+	{
+		if (!HasSpace(handleCache.ComputeStagedSize()))
+		{
+			RetireCurrentHeap();
+			UnbindAllValid();
+		}
 
-	m_owningContext.SetDescriptorHeap(m_descriptorType, GetHeapPointer());
-	handleCache.CopyAndBindStaleTables(m_descriptorType, m_descriptorSize, Allocate(neededSize), cmdList, SetFunc);
+		// a fallback to a heap of its own unbinds the tables as well
+		m_owningContext.SetDescriptorHeap(m_descriptorType, GetHeapPointer());
+		if (rangeCache != nullptr)
+			handleCache.BindCachedTables(m_tableCache, cmdList, SetFunc, lookups, hits);
+		uint32_t neededSize = handleCache.ComputeStagedSize();
+		if (neededSize > 0)
+			destHandleStart = Allocate(neededSize);
+	}
+	s_tableLookups.fetch_add(lookups, std::memory_order_relaxed);
+	s_tableHits.fetch_add(hits, std::memory_order_relaxed);
+	if (handleCache.m_staleRootParamsBitMap == 0)
+		return;
+
+	uint32_t copied = handleCache.CopyAndBindStaleTables(m_descriptorType, m_descriptorSize, destHandleStart, cmdList, SetFunc, rangeCache);
+	s_copiedDescriptors.fetch_add(copied, std::memory_order_relaxed);
 }
 
 D3D12_GPU_DESCRIPTOR_HANDLE DynamicDescriptorHeap::UploadDirect(D3D12_CPU_DESCRIPTOR_HANDLE handles)
@@ -133,6 +273,7 @@ D3D12_GPU_DESCRIPTOR_HANDLE DynamicDescriptorHeap::UploadDirect(D3D12_CPU_DESCRI
 	m_curOffset += 1;
 
 	g_Device->CopyDescriptorsSimple(1, destHandle.GetCpuHandle(), handles, m_descriptorType);
+	s_copiedDescriptors.fetch_add(1, std::memory_order_relaxed);
 
 	return destHandle.GetGpuHandle();
 }
@@ -195,13 +336,48 @@ uint32_t DynamicDescriptorHeap::DescriptorHandleCache::ComputeStagedSize()
 		staleParams ^= (1 << rootIndex);
 		uint32_t maxSetHandle = 0;
 		// return true if any bit set to 1, and the highest bit which is non-zero decides the max space requires
-		assert(TRUE == _BitScanReverse((unsigned long*)&maxSetHandle, m_rootDescriptorTable[rootIndex].assignedHandlesBitMap));
+		// outside the assert, release builds need the scan too
+		BOOLEAN anySet = _BitScanReverse((unsigned long*)&maxSetHandle, m_rootDescriptorTable[rootIndex].assignedHandlesBitMap);
+		assert(anySet == TRUE);
 		neededSpace += maxSetHandle + 1;
 	}
 	// return the max needed handle space of the whole root signature
 	return neededSpace;
 }
 
+uint32_t DynamicDescriptorHeap::DescriptorHandleCache::GetTableKey(uint32_t rootIndex, uint64_t key[]) const
+{
+	const DescriptorTableCache& table = m_rootDescriptorTable[rootIndex];
+	unsigned long maxSetHandle = 0;
+	_BitScanReverse(&maxSetHandle, table.assignedHandlesBitMap);
+	for (uint32_t i = 0; i <= maxSetHandle; ++i)
+		key[i] = (table.assignedHandlesBitMap >> i) & 1 ? (uint64_t)table.tableStart[i].ptr : 0;
+	return maxSetHandle + 1;
+}
+
+void DynamicDescriptorHeap::DescriptorHandleCache::BindCachedTables(DescriptorRangeCache& rangeCache, ID3D12GraphicsCommandList* cmdList,
+	void (ID3D12GraphicsCommandList::*SetFunc)(uint32_t, D3D12_GPU_DESCRIPTOR_HANDLE), uint32_t& lookups, uint32_t& hits)
+{
+	uint64_t key[kMaxTableKey];
+	uint32_t rootIndex;
+	uint32_t staleParams = m_staleRootParamsBitMap;
+	while (_BitScanForward((unsigned long*)&rootIndex, staleParams))
+	{
+		staleParams ^= (1 << rootIndex);
+		uint32_t count = GetTableKey(rootIndex, key);
+		uint64_t location = 0;
+		++lookups;
+		if (rangeCache.Find(key, count, location))
+		{
+			D3D12_GPU_DESCRIPTOR_HANDLE gpuHandle;
+			gpuHandle.ptr = location;
+			(cmdList->*SetFunc)(rootIndex, gpuHandle);
+			m_staleRootParamsBitMap ^= (1 << rootIndex);
+			++hits;
+		}
+	}
+}
+
 void DynamicDescriptorHeap::DescriptorHandleCache::UnbindAllValid()
 {
 	// if any handles already copy to m_handleCache, set m_staleRootParamsBitMap to match the whole root signature
@@ -217,10 +393,10 @@ void DynamicDescriptorHeap::DescriptorHandleCache::UnbindAllValid()
 	}
 }
 
-void DynamicDescriptorHeap::DescriptorHandleCache::CopyAndBindStaleTables(
+uint32_t DynamicDescriptorHeap::DescriptorHandleCache::CopyAndBindStaleTables(
 	D3D12_DESCRIPTOR_HEAP_TYPE type, uint32_t descriptorSize, 
 	DescriptorHandle destHandleStart, ID3D12GraphicsCommandList* cmdList, 
-	void (ID3D12GraphicsCommandList::*SetFunc)(uint32_t, D3D12_GPU_DESCRIPTOR_HANDLE))
+	void (ID3D12GraphicsCommandList::*SetFunc)(uint32_t, D3D12_GPU_DESCRIPTOR_HANDLE), DescriptorRangeCache* rangeCache)
 {
 	uint32_t staleParamCount = 0;
 	uint32_t tableSize[kMaxNumDescriptorTables];
@@ -237,7 +413,8 @@ void DynamicDescriptorHeap::DescriptorHandleCache::CopyAndBindStaleTables(
 		staleParams ^= (1 << rootIndex);
 
 		uint32_t maxSetHandle = 0;
-		assert(TRUE == _BitScanReverse((unsigned long*)&maxSetHandle, m_rootDescriptorTable[rootIndex].assignedHandlesBitMap));
+		BOOLEAN anySet = _BitScanReverse((unsigned long*)&maxSetHandle, m_rootDescriptorTable[rootIndex].assignedHandlesBitMap);
+		assert(anySet == TRUE);
 
 		// record the max needed space of the descriptor table
 		neededSpace += maxSetHandle + 1;
@@ -256,6 +433,7 @@ void DynamicDescriptorHeap::DescriptorHandleCache::CopyAndBindStaleTables(
 	uint32_t pDestDescriptorRangeSizes[kMaxDescriptorPerCopy];
 
 	uint32_t numSrcDescriptorRanges = 0;
+	uint32_t copied = 0;
 	D3D12_CPU_DESCRIPTOR_HANDLE pSrcDescriptorRangeStarts[kMaxDescriptorPerCopy];
 	uint32_t pSrcDescriptorRangeSizes[kMaxDescriptorPerCopy];
 
@@ -266,6 +444,14 @@ void DynamicDescriptorHeap::DescriptorHandleCache::CopyAndBindStaleTables(
 		rootIndex = rootIndices[i];
 		(cmdList->*SetFunc)(rootIndex, destHandleStart.GetGpuHandle());
 
+		// later tables with the same handles bind this copy
+		if (rangeCache != nullptr)
+		{
+			uint64_t key[kMaxTableKey];
+			uint32_t count = GetTableKey(rootIndex, key);
+			rangeCache->Insert(key, count, destHandleStart.GetGpuHandle().ptr);
+		}
+
 		DescriptorTableCache& rootDescTable = m_rootDescriptorTable[rootIndex];
 
 		D3D12_CPU_DESCRIPTOR_HANDLE* srcHandles = rootDescTable.tableStart;
@@ -302,6 +488,8 @@ void DynamicDescriptorHeap::DescriptorHandleCache::CopyAndBindStaleTables(
 			pDestDescriptorRangeSizes[numDestDescriptorRanges] = descriptorCount;
 			++numDestDescriptorRanges;
 
+			copied += descriptorCount;
+
 			// Setup source ranges (one descriptor each because we don't assume they are contiguous)
 			for (uint32_t j = 0; j < descriptorCount; ++j)
 			{
@@ -320,4 +508,5 @@ void DynamicDescriptorHeap::DescriptorHandleCache::CopyAndBindStaleTables(
 		numDestDescriptorRanges, pDestDescriptorRangeStarts, pDestDescriptorRangeSizes,
 		numSrcDescriptorRanges, pSrcDescriptorRangeStarts, pSrcDescriptorRangeSizes,
 		type);
+	return copied;
 }
\ No newline at end of file
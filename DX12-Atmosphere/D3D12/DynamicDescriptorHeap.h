@@ -2,6 +2,9 @@
 #include "stdafx.h"
 #include "DescriptorHeap.h"
 #include "RootSignature.h"
+#include "FenceRecycler.h"
+#include "BindlessHeap.h"
+#include "DescriptorRangeCache.h"
 
 class CommandContext;
 
@@ -57,12 +60,55 @@ public:
 	// Bypass the cache and upload directly to the shader-visible heap
 	D3D12_GPU_DESCRIPTOR_HANDLE UploadDirect(D3D12_CPU_DESCRIPTOR_HANDLE handles);
 
+	// Before a table of the BindlessHeap is bound: room for the next count descriptors in
+	// its pages, so the tables copied after it stay in the same heap. False when there is
+	// no BindlessHeap or the command list already fell back to heaps of its own.
+	bool ReserveBindless(uint32_t count);
+
+	// How stale tables whose handles were copied before are reused, see DescriptorRangeCache
+	enum TableCacheMode
+	{
+		// every stale table is copied
+		kTableCacheOff,
+		// found in the space the command list being recorded copied to
+		kTableCachePerCommandList,
+		// copied to pages the context keeps across command lists, needs a BindlessHeap,
+		// per command list without one
+		kTableCacheCrossFrame
+	};
+
+	// off until turned on, every context reads it when it copies stale tables
+	static void SetTableCacheMode(TableCacheMode mode) { s_tableCacheMode.store(mode); }
+	static TableCacheMode GetTableCacheMode() { return s_tableCacheMode.load(); }
+
+	// Descriptors copied into shader visible heaps and tables looked up in the caches by
+	// every context, per frame
+	static void EndFrame()
+	{
+		s_copiedLastFrame = s_copiedDescriptors.exchange(0);
+		s_tableLookupsLastFrame = s_tableLookups.exchange(0);
+		s_tableHitsLastFrame = s_tableHits.exchange(0);
+	}
+	static uint64_t GetCopiedLastFrame() { return s_copiedLastFrame; }
+	static uint64_t GetTableLookupsLastFrame() { return s_tableLookupsLastFrame; }
+	static uint64_t GetTableHitsLastFrame() { return s_tableHitsLastFrame; }
+
 private:
 	static const uint32_t kNumDescriptorsPerHeap = 1024;
+	static_assert(kNumDescriptorsPerHeap == BindlessHeap::kPageSize, "a bindless page stands in for a heap");
+	// s_descriptorHeapPool only
 	static std::mutex s_mutex;
 	static std::vector<Microsoft::WRL::ComPtr<ID3D12DescriptorHeap>> s_descriptorHeapPool[2];
-	static std::queue<std::pair<uint64_t, ID3D12DescriptorHeap*>> s_retiredDescriptorHeaps[2];
-	static std::queue<ID3D12DescriptorHeap*> s_availableDescriptorHeaps[2];
+	static FenceRecycler<ID3D12DescriptorHeap> s_retiredDescriptorHeaps[2];
+	static std::atomic<uint64_t> s_copiedDescriptors;
+	static uint64_t s_copiedLastFrame;
+	static std::atomic<TableCacheMode> s_tableCacheMode;
+	static std::atomic<uint64_t> s_tableLookups;
+	static std::atomic<uint64_t> s_tableHits;
+	static uint64_t s_tableLookupsLastFrame;
+	static uint64_t s_tableHitsLastFrame;
+	// pages of cached tables a context keeps before it starts over
+	static const uint32_t kMaxCachePages = 4;
 
 	static ID3D12DescriptorHeap* RequestDescriptorHeap(D3D12_DESCRIPTOR_HEAP_TYPE heapType);
 	static void DiscardDescriptorHeaps(D3D12_DESCRIPTOR_HEAP_TYPE heapType, uint64_t fenceValueForReset,
@@ -75,6 +121,16 @@ private:
 	uint32_t m_curOffset;
 	DescriptorHandle m_firstDescriptor;
 	std::vector<ID3D12DescriptorHeap*> m_retiredHeaps;
+	// with a BindlessHeap the views go to its pages, tables and bindless reads share one heap
+	BindlessHeap::Page* m_curPage;
+	bool m_bindlessFallback;
+	std::vector<BindlessHeap::Page*> m_retiredPages;
+	// the locations are GPU handles into the current heap, the retired pages or m_cachePages
+	DescriptorRangeCache m_tableCache;
+	TableCacheMode m_tableCacheMode;
+	// cross frame only, the last one is being filled
+	std::vector<BindlessHeap::Page*> m_cachePages;
+	uint32_t m_cacheOffset;
 
 	struct DescriptorTableCache
 	{
@@ -101,14 +157,23 @@ private:
 		void StageDescriptorHandles(uint32_t rootIndex, uint32_t offset, uint32_t numHandles, const D3D12_CPU_DESCRIPTOR_HANDLE handles[]);
 
 		uint32_t ComputeStagedSize();
-		void CopyAndBindStaleTables(D3D12_DESCRIPTOR_HEAP_TYPE type, uint32_t descriptorSize, DescriptorHandle destHandleStart, ID3D12GraphicsCommandList* cmdList,
-			void (ID3D12GraphicsCommandList::*SetFunc)(uint32_t, D3D12_GPU_DESCRIPTOR_HANDLE));
+		// The ptrs of the handles staged for a table up to the last one set, 0 where none is,
+		// returns the count
+		uint32_t GetTableKey(uint32_t rootIndex, uint64_t key[]) const;
+		// Binds the stale tables found in rangeCache, they are no longer stale
+		void BindCachedTables(DescriptorRangeCache& rangeCache, ID3D12GraphicsCommandList* cmdList,
+			void (ID3D12GraphicsCommandList::*SetFunc)(uint32_t, D3D12_GPU_DESCRIPTOR_HANDLE), uint32_t& lookups, uint32_t& hits);
+		// returns the number of descriptors copied, the tables go to rangeCache unless it is null
+		uint32_t CopyAndBindStaleTables(D3D12_DESCRIPTOR_HEAP_TYPE type, uint32_t descriptorSize, DescriptorHandle destHandleStart, ID3D12GraphicsCommandList* cmdList,
+			void (ID3D12GraphicsCommandList::*SetFunc)(uint32_t, D3D12_GPU_DESCRIPTOR_HANDLE), DescriptorRangeCache* rangeCache);
 
 		void UnbindAllValid();
 
 		// static member
 		static const uint32_t kMaxNumDescriptors = 256;
 		static const uint32_t kMaxNumDescriptorTables = 16;
+		// a table has a 32 bit assignedHandlesBitMap
+		static const uint32_t kMaxTableKey = 32;
 
 		DescriptorTableCache m_rootDescriptorTable[kMaxNumDescriptorTables];
 		D3D12_CPU_DESCRIPTOR_HANDLE m_handleCache[kMaxNumDescriptors];
@@ -137,6 +202,15 @@ private:
 		return ret;
 	}
 
+	// The mode this heap can use, the cached tables go when it or the view epoch changed
+	TableCacheMode UpdateTableCacheMode();
+	// No page was free, the rest of the command list copies to heaps of its own
+	void FallBack();
+	// a cache page with room for count, false after a fallback
+	bool ReserveCached(uint32_t count);
+	void DropTableCache();
+	DescriptorHandle AllocateCached(uint32_t count);
+
 	void CopyAndBindStagedTables(DescriptorHandleCache& handleCache, ID3D12GraphicsCommandList* cmdList,
 		void (ID3D12GraphicsCommandList::*SetFunc)(uint32_t, D3D12_GPU_DESCRIPTOR_HANDLE));
 
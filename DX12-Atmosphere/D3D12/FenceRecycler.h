@@ -0,0 +1,296 @@
+#pragma once
+// No stdafx.h, the recycler knows nothing of D3D12 and builds anywhere with a fake fence.
+// The same goes for the other headers here that include no stdafx.h, the bookkeeping split
+// out of the D3D12 classes and the benchmarks over it: their .cpp files only need an empty
+// stdafx.h off Windows, the benchmarks also Math/Random.h for their Philox streams.
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Objects the GPU may still be using, each tagged with the fence value after which it is
+// free again: command allocators, upload pages, descriptor heaps. Any thread retires them
+// without a lock, a push of a chain of nodes onto a stack. Acquire and Reclaim take the
+// whole stack in one exchange, ask the fence once per run of equal fence values and keep
+// what is still in flight for the next call, so the fence is queried when something is
+// needed, not per retire. The fence query is a callable bool(uint64_t) passed to those
+// two, g_CommandManager.IsFenceComplete in the engine, a counter in a test.
+// The recycler never owns the objects, only its nodes.
+template <class T>
+class FenceRecycler
+{
+public:
+	struct Stats
+	{
+		// objects taken off the retire stack so far, and back out through Acquire or Reclaim
+		uint64_t retired;
+		uint64_t reclaimed;
+		uint64_t fenceQueries;
+		// failed compare exchanges of the lock free stacks, the contention of the retire path
+		uint64_t retireRetries;
+		uint64_t nodeRetries;
+		// nodes ever allocated, the most objects in flight at once
+		uint64_t nodes;
+	};
+
+	FenceRecycler()
+		: m_retired(nullptr), m_freeNodes(0), m_pending(nullptr), m_pendingTail(nullptr),
+		m_retireRetries(0), m_nodeRetries(0), m_numNodes(0), m_numRetired(0), m_numReclaimed(0), m_numQueries(0)
+	{
+	}
+
+	~FenceRecycler()
+	{
+		std::lock_guard<std::mutex> lockGuard(m_nodeMutex);
+		for (Node* node : m_allNodes)
+			delete node;
+	}
+
+	FenceRecycler(const FenceRecycler&) = delete;
+	FenceRecycler& operator=(const FenceRecycler&) = delete;
+
+	void Retire(uint64_t fenceValue, T* object)
+	{
+		Node* node = AllocateNode();
+		node->fenceValue = fenceValue;
+		node->object = object;
+		PushRetired(node, node);
+	}
+
+	// One push for all of them, a context retires its pages together
+	void Retire(uint64_t fenceValue, const std::vector<T*>& objects)
+	{
+		if (objects.empty())
+			return;
+		Node* first = nullptr;
+		Node* last = nullptr;
+		for (T* object : objects)
+		{
+			Node* node = AllocateNode();
+			node->fenceValue = fenceValue;
+			node->object = object;
+			node->next = first;
+			first = node;
+			last = last ? last : node;
+		}
+		PushRetired(first, last);
+	}
+
+	// An object whose fence completed, the longest retired first, nullptr if none has
+	template <class FenceQuery>
+	T* Acquire(const FenceQuery& isFenceComplete)
+	{
+		std::lock_guard<std::mutex> lockGuard(m_reclaimMutex);
+		if (m_ready.empty())
+			Collect(isFenceComplete);
+		if (m_ready.empty())
+			return nullptr;
+		T* object = m_ready[m_readyStart++];
+		if (m_readyStart == m_ready.size())
+		{
+			m_ready.clear();
+			m_readyStart = 0;
+		}
+		++m_numReclaimed;
+		return object;
+	}
+
+	// Up to maxCount objects whose fence completed appended to out, for a cache in front of
+	// the recycler. Returns how many there were.
+	template <class FenceQuery>
+	size_t AcquireBatch(const FenceQuery& isFenceComplete, std::vector<T*>& out, size_t maxCount)
+	{
+		std::lock_guard<std::mutex> lockGuard(m_reclaimMutex);
+		if (m_ready.size() - m_readyStart < maxCount)
+			Collect(isFenceComplete);
+		size_t count = std::min(m_ready.size() - m_readyStart, maxCount);
+		out.insert(out.end(), m_ready.begin() + m_readyStart, m_ready.begin() + m_readyStart + count);
+		m_readyStart += count;
+		if (m_readyStart == m_ready.size())
+		{
+			m_ready.clear();
+			m_readyStart = 0;
+		}
+		m_numReclaimed += count;
+		return count;
+	}
+
+	// Hands every object whose fence completed to onReclaim(T*), for deletion queues.
+	// Returns how many there were.
+	template <class FenceQuery, class OnReclaim>
+	size_t Reclaim(const FenceQuery& isFenceComplete, const OnReclaim& onReclaim)
+	{
+		std::lock_guard<std::mutex> lockGuard(m_reclaimMutex);
+		Collect(isFenceComplete);
+		size_t count = m_ready.size() - m_readyStart;
+		for (size_t i = m_readyStart; i < m_ready.size(); ++i)
+			onReclaim(m_ready[i]);
+		m_ready.clear();
+		m_readyStart = 0;
+		m_numReclaimed += count;
+		return count;
+	}
+
+	Stats GetStats() const
+	{
+		std::lock_guard<std::mutex> lockGuard(m_reclaimMutex);
+		Stats stats;
+		stats.retired = m_numRetired;
+		stats.reclaimed = m_numReclaimed;
+		stats.fenceQueries = m_numQueries;
+		stats.retireRetries = m_retireRetries.load(std::memory_order_relaxed);
+		stats.nodeRetries = m_nodeRetries.load(std::memory_order_relaxed);
+		stats.nodes = m_numNodes.load(std::memory_order_relaxed);
+		return stats;
+	}
+
+private:
+	struct Node
+	{
+		uint64_t fenceValue;
+		T* object;
+		Node* next;
+		// the free list, read by threads racing for the node
+		std::atomic<Node*> nextFree;
+	};
+
+	// The free list pops from many threads, its head carries a tag against ABA in the
+	// bits above the 48 of a user space address
+	static const uint32_t kTagShift = 48;
+	static const uint64_t kPointerMask = (1ull << kTagShift) - 1;
+	static_assert(sizeof(void*) == 8, "the tagged free list packs a pointer in 48 bits");
+
+	static Node* Untag(uint64_t head) { return (Node*)(uintptr_t)(head & kPointerMask); }
+	static uint64_t Tag(Node* node, uint64_t previous) { return (uint64_t)(uintptr_t)node | (((previous >> kTagShift) + 1) << kTagShift); }
+
+	Node* AllocateNode()
+	{
+		uint64_t head = m_freeNodes.load(std::memory_order_acquire);
+		uint64_t retries = 0;
+		while (Untag(head) != nullptr)
+		{
+			// nodes are never freed before the recycler, reading next of a node another
+			// thread just took is safe, the tag makes its CAS fail
+			Node* node = Untag(head);
+			if (m_freeNodes.compare_exchange_weak(head, Tag(node->nextFree.load(std::memory_order_relaxed), head), std::memory_order_acquire, std::memory_order_acquire))
+			{
+				if (retries)
+					m_nodeRetries.fetch_add(retries, std::memory_order_relaxed);
+				return node;
+			}
+			++retries;
+		}
+		if (retries)
+			m_nodeRetries.fetch_add(retries, std::memory_order_relaxed);
+
+		Node* node = new Node;
+		std::lock_guard<std::mutex> lockGuard(m_nodeMutex);
+		m_allNodes.push_back(node);
+		m_numNodes.fetch_add(1, std::memory_order_relaxed);
+		return node;
+	}
+
+	void FreeNodes(Node* first, Node* last)
+	{
+		for (Node* node = first; node != last; node = node->next)
+			node->nextFree.store(node->next, std::memory_order_relaxed);
+		uint64_t head = m_freeNodes.load(std::memory_order_relaxed);
+		do
+		{
+			last->nextFree.store(Untag(head), std::memory_order_relaxed);
+		} while (!m_freeNodes.compare_exchange_weak(head, Tag(first, head), std::memory_order_release, std::memory_order_relaxed));
+	}
+
+	void PushRetired(Node* first, Node* last)
+	{
+		Node* head = m_retired.load(std::memory_order_relaxed);
+		uint64_t retries = 0;
+		last->next = head;
+		while (!m_retired.compare_exchange_weak(head, first, std::memory_order_release, std::memory_order_relaxed))
+		{
+			last->next = head;
+			++retries;
+		}
+		if (retries)
+			m_retireRetries.fetch_add(retries, std::memory_order_relaxed);
+	}
+
+	// Under m_reclaimMutex: appends the retired stack to the pending list in retire order,
+	// then moves every node whose fence completed to m_ready
+	template <class FenceQuery>
+	void Collect(const FenceQuery& isFenceComplete)
+	{
+		Node* stack = m_retired.exchange(nullptr, std::memory_order_acquire);
+		Node* chain = nullptr;
+		Node* chain_tail = stack;
+		while (stack)
+		{
+			Node* next = stack->next;
+			stack->next = chain;
+			chain = stack;
+			stack = next;
+			++m_numRetired;
+		}
+		if (chain)
+		{
+			if (m_pendingTail)
+				m_pendingTail->next = chain;
+			else
+				m_pending = chain;
+			m_pendingTail = chain_tail;
+		}
+
+		Node* freed_first = nullptr;
+		Node* freed_last = nullptr;
+		Node** link = &m_pending;
+		Node* prev = nullptr;
+		bool have_value = false, complete = false;
+		uint64_t value = 0;
+		while (Node* node = *link)
+		{
+			if (!have_value || node->fenceValue != value)
+			{
+				value = node->fenceValue;
+				complete = isFenceComplete(value);
+				have_value = true;
+				++m_numQueries;
+			}
+			if (!complete)
+			{
+				prev = node;
+				link = &node->next;
+				continue;
+			}
+			*link = node->next;
+			m_ready.push_back(node->object);
+			node->next = freed_first;
+			freed_first = node;
+			freed_last = freed_last ? freed_last : node;
+		}
+		m_pendingTail = prev;
+		if (freed_first)
+			FreeNodes(freed_first, freed_last);
+	}
+
+	std::atomic<Node*> m_retired;
+	std::atomic<uint64_t> m_freeNodes;
+
+	// consumers only
+	mutable std::mutex m_reclaimMutex;
+	Node* m_pending;
+	Node* m_pendingTail;
+	std::vector<T*> m_ready;
+	size_t m_readyStart = 0;
+
+	std::mutex m_nodeMutex;
+	std::vector<Node*> m_allNodes;
+
+	std::atomic<uint64_t> m_retireRetries;
+	std::atomic<uint64_t> m_nodeRetries;
+	std::atomic<uint64_t> m_numNodes;
+	uint64_t m_numRetired;
+	uint64_t m_numReclaimed;
+	uint64_t m_numQueries;
+};
\ No newline at end of file
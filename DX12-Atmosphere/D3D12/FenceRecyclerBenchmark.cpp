@@ -0,0 +1,209 @@
+#include "stdafx.h"
+#include "FenceRecyclerBenchmark.h"
+#include "FenceRecycler.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+
+namespace
+{
+	struct FakeObject
+	{
+		// the fence it was last retired with
+		uint64_t fenceValue;
+	};
+
+	// What LinearAllocatorPageManager and the others did before FenceRecycler
+	class MutexQueueRecycler
+	{
+	public:
+		void Retire(uint64_t fenceValue, FakeObject* object)
+		{
+			std::lock_guard<std::mutex> lockGuard(m_mutex);
+			m_retired.push({ fenceValue, object });
+		}
+
+		void Retire(uint64_t fenceValue, const std::vector<FakeObject*>& objects)
+		{
+			std::lock_guard<std::mutex> lockGuard(m_mutex);
+			for (FakeObject* object : objects)
+				m_retired.push({ fenceValue, object });
+		}
+
+		template <class FenceQuery>
+		FakeObject* Acquire(const FenceQuery& isFenceComplete)
+		{
+			std::lock_guard<std::mutex> lockGuard(m_mutex);
+			while (!m_retired.empty())
+			{
+				++m_queries;
+				if (!isFenceComplete(m_retired.front().first))
+					break;
+				m_available.push(m_retired.front().second);
+				m_retired.pop();
+			}
+			if (m_available.empty())
+				return nullptr;
+			FakeObject* object = m_available.front();
+			m_available.pop();
+			return object;
+		}
+
+		FenceRecycler<FakeObject>::Stats GetStats() const
+		{
+			FenceRecycler<FakeObject>::Stats stats = {};
+			stats.fenceQueries = m_queries;
+			return stats;
+		}
+
+	private:
+		mutable std::mutex m_mutex;
+		std::queue<std::pair<uint64_t, FakeObject*>> m_retired;
+		std::queue<FakeObject*> m_available;
+		uint64_t m_queries = 0;
+	};
+
+	template <class Recycler>
+	FenceRecyclerBenchmark::Result RunRecycler(const FenceRecyclerBenchmark::Desc& desc)
+	{
+		Recycler recycler;
+		std::mutex object_mutex;
+		std::vector<std::unique_ptr<FakeObject>> objects;
+
+		const uint32_t num_threads = std::max(desc.numThreads, 1u);
+		std::vector<std::atomic<uint64_t>> progress(num_threads);
+		for (auto& p : progress)
+			p.store(0);
+		std::atomic<uint64_t> completed(0);
+		std::atomic<uint32_t> running(num_threads);
+		std::atomic<uint64_t> early_reuses(0);
+		std::vector<double> retire_seconds(num_threads, 0.0), acquire_seconds(num_threads, 0.0);
+
+		auto is_complete = [&completed](uint64_t fenceValue) { return fenceValue <= completed.load(std::memory_order_acquire); };
+
+		// the GPU finishes a frame once every thread recorded framesInFlight frames past it
+		std::thread gpu([&]()
+		{
+			while (running.load(std::memory_order_acquire) > 0)
+			{
+				uint64_t slowest = UINT64_MAX;
+				for (auto& p : progress)
+					slowest = std::min(slowest, p.load(std::memory_order_acquire));
+				if (slowest > desc.framesInFlight)
+					completed.store(slowest - desc.framesInFlight, std::memory_order_release);
+				std::this_thread::yield();
+			}
+		});
+
+		auto start = std::chrono::high_resolution_clock::now();
+		std::vector<std::thread> threads;
+		for (uint32_t t = 0; t < num_threads; ++t)
+		{
+			threads.emplace_back([&, t]()
+			{
+				std::vector<FakeObject*> frame_objects;
+				for (uint64_t frame = 1; frame <= desc.framesPerThread; ++frame)
+				{
+					// a CPU too far ahead waits for the GPU like Present would
+					while (frame > completed.load(std::memory_order_acquire) + 2 * (uint64_t)desc.framesInFlight + 1)
+						std::this_thread::yield();
+
+					auto t0 = std::chrono::high_resolution_clock::now();
+					frame_objects.clear();
+					for (uint32_t i = 0; i < desc.objectsPerFrame; ++i)
+					{
+						FakeObject* object = recycler.Acquire(is_complete);
+						if (object == nullptr)
+						{
+							object = new FakeObject;
+							std::lock_guard<std::mutex> lockGuard(object_mutex);
+							objects.emplace_back(object);
+						}
+						else if (object->fenceValue > completed.load(std::memory_order_acquire))
+						{
+							early_reuses.fetch_add(1, std::memory_order_relaxed);
+						}
+						frame_objects.push_back(object);
+					}
+					auto t1 = std::chrono::high_resolution_clock::now();
+					for (FakeObject* object : frame_objects)
+						object->fenceValue = frame;
+					if (desc.retireSingly)
+					{
+						for (FakeObject* object : frame_objects)
+							recycler.Retire(frame, object);
+					}
+					else
+					{
+						recycler.Retire(frame, frame_objects);
+					}
+					auto t2 = std::chrono::high_resolution_clock::now();
+					acquire_seconds[t] += std::chrono::duration<double>(t1 - t0).count();
+					retire_seconds[t] += std::chrono::duration<double>(t2 - t1).count();
+					progress[t].store(frame, std::memory_order_release);
+				}
+				running.fetch_sub(1, std::memory_order_release);
+			});
+		}
+		for (auto& thread : threads)
+			thread.join();
+		double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+		gpu.join();
+
+		FenceRecyclerBenchmark::Result result = {};
+		const double operations = 2.0 * num_threads * desc.framesPerThread * desc.objectsPerFrame;
+		double retire_total = 0.0, acquire_total = 0.0;
+		for (uint32_t t = 0; t < num_threads; ++t)
+		{
+			retire_total += retire_seconds[t];
+			acquire_total += acquire_seconds[t];
+		}
+		auto stats = recycler.GetStats();
+		result.seconds = seconds;
+		result.operationsPerSecond = operations / std::max(seconds, 1e-9);
+		result.retireNanoseconds = retire_total * 2e9 / std::max(operations, 1.0);
+		result.acquireNanoseconds = acquire_total * 2e9 / std::max(operations, 1.0);
+		result.created = objects.size();
+		result.fenceQueries = stats.fenceQueries;
+		result.retireRetries = stats.retireRetries;
+		result.nodeRetries = stats.nodeRetries;
+		result.violations.Add("early reuses", early_reuses.load());
+		return result;
+	}
+}
+
+FenceRecyclerBenchmark::Desc FenceRecyclerBenchmark::DefaultDesc()
+{
+	Desc desc;
+	desc.numThreads = std::max(std::thread::hardware_concurrency(), 1u);
+	desc.framesPerThread = 20000;
+	desc.objectsPerFrame = 4;
+	desc.framesInFlight = 2;
+	desc.retireSingly = false;
+	return desc;
+}
+
+FenceRecyclerBenchmark::Report FenceRecyclerBenchmark::Run(const Desc& desc)
+{
+	Report report;
+	report.desc = desc;
+	report.recycler = RunRecycler<FenceRecycler<FakeObject>>(desc);
+	report.mutexQueue = RunRecycler<MutexQueueRecycler>(desc);
+	report.violations.Merge(report.recycler.violations, "recycler ");
+	report.violations.Merge(report.mutexQueue.violations, "mutex queue ");
+	return report;
+}
+
+std::string FenceRecyclerBenchmark::Summarize(const Report& report)
+{
+	char line[256];
+	snprintf(line, sizeof(line), "%u threads, %.1f M ops / s against %.1f M with a mutex, %llu objects created",
+		report.desc.numThreads, report.recycler.operationsPerSecond * 1e-6, report.mutexQueue.operationsPerSecond * 1e-6,
+		(unsigned long long)report.recycler.created);
+	return line;
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+#pragma once
+#include "Utils/SelfTest.h"
+#include <cstdint>
+#include <string>
+
+// Many recording threads against one recycler with a fake fence, the way contexts on
+// worker threads retire pages and heaps at the end of their command lists. Every thread
+// records frames: it acquires objectsPerFrame objects, making new ones when none is free,
+// and retires them with the fence value of the frame. A fake GPU thread completes a frame
+// once every thread recorded framesInFlight frames past it. Runs FenceRecycler and the
+// mutex and std::queue it replaced on the same schedule, and checks that no object comes
+// back before its fence completed.
+class FenceRecyclerBenchmark
+{
+public:
+	struct Desc
+	{
+		uint32_t numThreads;
+		uint32_t framesPerThread;
+		uint32_t objectsPerFrame;
+		uint32_t framesInFlight;
+		// one Retire per object instead of one per frame
+		bool retireSingly;
+	};
+
+	struct Result
+	{
+		double seconds;
+		// retires plus acquires
+		double operationsPerSecond;
+		double retireNanoseconds;
+		double acquireNanoseconds;
+		// objects made because none was free, a working recycler stays near the objects in flight
+		uint64_t created;
+		uint64_t fenceQueries;
+		uint64_t retireRetries;
+		uint64_t nodeRetries;
+		// "early reuses", objects handed out again before their fence completed
+		SelfTest::Violations violations;
+	};
+
+	struct Report
+	{
+		Desc desc;
+		Result recycler;
+		Result mutexQueue;
+		// of both
+		SelfTest::Violations violations;
+	};
+
+	static Desc DefaultDesc();
+	static Report Run(const Desc& desc);
+	static std::string Summarize(const Report& report);
+};
\ No newline at end of file
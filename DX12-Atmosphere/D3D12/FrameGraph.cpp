@@ -0,0 +1,540 @@
+#include "stdafx.h"
+#include "FrameGraph.h"
+#include <algorithm>
+#include <cassert>
+#include <sstream>
+
+const uint32_t FrameGraph::kKeepState;
+const FrameGraph::Handle FrameGraph::kNoResource;
+
+FrameGraph::FrameGraph() : m_stats()
+{
+}
+
+FrameGraph::Handle FrameGraph::AddResource(const std::string& name, uint32_t initialState, uint32_t finalState /* = kKeepState */, bool exported /* = true */)
+{
+	m_resources.push_back({ name, initialState, finalState, exported, false, {} });
+	return (Handle)m_resources.size() - 1;
+}
+
+void FrameGraph::SetInitialState(Handle resource, uint32_t state)
+{
+	m_resources[resource].initialState = state;
+}
+
+void FrameGraph::SetTransient(Handle resource, const std::vector<Handle>& aliases /* = std::vector<Handle>() */)
+{
+	m_resources[resource].transient = true;
+	m_resources[resource].aliases = aliases;
+}
+
+FrameGraph::Handle FrameGraph::AddPass(const std::string& name)
+{
+	m_passes.push_back({ name, {} });
+	return (Handle)m_passes.size() - 1;
+}
+
+void FrameGraph::Read(Handle pass, Handle resource, uint32_t state)
+{
+	assert(IsReadState(state) && state != kCommon);
+	AddAccess(pass, resource, state, false);
+}
+
+void FrameGraph::Write(Handle pass, Handle resource, uint32_t state)
+{
+	// exactly one write state
+	assert((state & kWriteStates) == state && (state & (state - 1)) == 0);
+	AddAccess(pass, resource, state, true);
+}
+
+void FrameGraph::AddAccess(Handle pass, Handle resource, uint32_t state, bool write)
+{
+	assert(pass < m_passes.size() && resource < m_resources.size());
+	std::vector<Access>& accesses = m_passes[pass].accesses;
+	for (Access& access : accesses)
+	{
+		if (access.resource != resource)
+			continue;
+		// reads merge into one combined read state, a write only goes with itself
+		if (!access.write && !write)
+			access.state |= state;
+		else if (access.write != write || access.state != state)
+			m_error = m_passes[pass].name + ": " + m_resources[resource].name + " both " + StateName(access.state) + " and " + StateName(state);
+		return;
+	}
+	accesses.push_back({ resource, state, write });
+}
+
+bool FrameGraph::Covers(uint32_t state, uint32_t use, bool write)
+{
+	if (write)
+		return state == use && use != kUnorderedAccess;
+	return IsReadState(state) && (state & use) == use;
+}
+
+void FrameGraph::Cull(std::vector<bool>& needed, std::vector<std::vector<Handle>>& predecessors) const
+{
+	const uint32_t num_passes = (uint32_t)m_passes.size();
+	std::vector<int32_t> last_writer(m_resources.size(), -1);
+	std::vector<std::vector<Handle>> readers(m_resources.size());
+	// what a pass needs run before it: the writers it reads (or overwrites), which keep it
+	// alive, and the readers of what it overwrites, which only order
+	std::vector<std::vector<Handle>> producers(num_passes);
+	for (Handle p = 0; p < num_passes; ++p)
+	{
+		for (const Access& access : m_passes[p].accesses)
+		{
+			Handle r = access.resource;
+			if (last_writer[r] >= 0)
+			{
+				producers[p].push_back((Handle)last_writer[r]);
+				predecessors[p].push_back((Handle)last_writer[r]);
+			}
+			if (access.write)
+			{
+				for (Handle reader : readers[r])
+				{
+					if (reader != p)
+						predecessors[p].push_back(reader);
+				}
+				readers[r].clear();
+				last_writer[r] = (int32_t)p;
+			}
+			else
+			{
+				readers[r].push_back(p);
+			}
+		}
+	}
+
+	// every dependency points back in declaration order, one pass from the end is enough.
+	// A write counts as a read of the last write, so partial updates keep what they update.
+	for (Handle p = num_passes; p-- > 0;)
+	{
+		for (const Access& access : m_passes[p].accesses)
+			needed[p] = needed[p] || (access.write && m_resources[access.resource].exported);
+		if (!needed[p])
+			continue;
+		for (Handle producer : producers[p])
+			needed[producer] = true;
+	}
+}
+
+void FrameGraph::Order(const std::vector<bool>& needed, const std::vector<std::vector<Handle>>& predecessors, bool reorder)
+{
+	const uint32_t num_passes = (uint32_t)m_passes.size();
+	m_order.clear();
+	if (!reorder)
+	{
+		for (Handle p = 0; p < num_passes; ++p)
+		{
+			if (needed[p])
+				m_order.push_back(p);
+		}
+		return;
+	}
+
+	std::vector<uint32_t> waiting(num_passes, 0);
+	std::vector<std::vector<Handle>> successors(num_passes);
+	for (Handle p = 0; p < num_passes; ++p)
+	{
+		if (!needed[p])
+			continue;
+		for (Handle q : predecessors[p])
+		{
+			if (!needed[q])
+				continue;
+			++waiting[p];
+			successors[q].push_back(p);
+		}
+	}
+	std::vector<Handle> ready;
+	for (Handle p = 0; p < num_passes; ++p)
+	{
+		if (needed[p] && waiting[p] == 0)
+			ready.push_back(p);
+	}
+
+	// the state each resource will be in and the position of its last use so far
+	std::vector<uint32_t> state(m_resources.size());
+	std::vector<int32_t> last_use(m_resources.size(), -1);
+	for (size_t r = 0; r < m_resources.size(); ++r)
+		state[r] = m_resources[r].initialState;
+
+	while (!ready.empty())
+	{
+		const int32_t position = (int32_t)m_order.size();
+		// the pass whose closest barrier is furthest from the last use of its resource, room
+		// for a split barrier, the first declared of equals
+		size_t best = 0;
+		int32_t best_distance = -1;
+		for (size_t i = 0; i < ready.size(); ++i)
+		{
+			int32_t distance = INT32_MAX;
+			for (const Access& access : m_passes[ready[i]].accesses)
+			{
+				if (!Covers(state[access.resource], access.state, access.write))
+					distance = std::min(distance, position - last_use[access.resource]);
+			}
+			if (distance > best_distance || (distance == best_distance && ready[i] < ready[best]))
+			{
+				best = i;
+				best_distance = distance;
+			}
+		}
+		Handle p = ready[best];
+		ready.erase(ready.begin() + best);
+		m_order.push_back(p);
+
+		for (const Access& access : m_passes[p].accesses)
+		{
+			uint32_t& s = state[access.resource];
+			s = !access.write && Covers(s, access.state, false) ? s : access.state;
+			last_use[access.resource] = position;
+		}
+		for (Handle q : successors[p])
+		{
+			if (--waiting[q] == 0)
+				ready.push_back(q);
+		}
+	}
+	assert(m_order.size() == (size_t)std::count(needed.begin(), needed.end(), true));
+}
+
+void FrameGraph::AddTransition(Handle resource, uint32_t before, uint32_t after, int32_t lastPosition, uint32_t position)
+{
+	if ((int32_t)position - lastPosition >= 2)
+	{
+		m_barriers[lastPosition + 1].push_back({ kBeginSplit, resource, before, after, kNoResource });
+		m_barriers[position].push_back({ kEndSplit, resource, before, after, kNoResource });
+		++m_stats.splitTransitions;
+	}
+	else
+	{
+		m_barriers[position].push_back({ kTransition, resource, before, after, kNoResource });
+		++m_stats.transitions;
+	}
+}
+
+void FrameGraph::PlaceBarriers()
+{
+	const uint32_t num_scheduled = (uint32_t)m_order.size();
+	m_barriers.assign(num_scheduled + 1, std::vector<Barrier>());
+	m_firstUse.assign(m_resources.size(), -1);
+	m_lastUse.assign(m_resources.size(), -1);
+
+	struct Use
+	{
+		uint32_t position;
+		uint32_t state;
+		bool write;
+	};
+	std::vector<std::vector<Use>> uses(m_resources.size());
+	for (uint32_t position = 0; position < num_scheduled; ++position)
+	{
+		for (const Access& access : m_passes[m_order[position]].accesses)
+			uses[access.resource].push_back({ position, access.state, access.write });
+	}
+
+	for (Handle r = 0; r < m_resources.size(); ++r)
+	{
+		const std::vector<Use>& list = uses[r];
+		uint32_t state = m_resources[r].initialState;
+		// a transient one is only transitioned right before its first use, or at the end
+		int32_t last_position = -1;
+		if (m_resources[r].transient)
+			last_position = list.empty() ? (int32_t)num_scheduled - 1 : (int32_t)list.front().position - 1;
+		if (m_resources[r].transient && !list.empty())
+		{
+			// the contents are undefined after, its first pass writes all of it
+			const std::vector<Handle>& aliases = m_resources[r].aliases;
+			for (size_t a = 0; a < std::max(aliases.size(), (size_t)1); ++a)
+				m_barriers[list.front().position].push_back({ kAliasing, r, state, state, aliases.empty() ? kNoResource : aliases[a] });
+			m_stats.aliasingBarriers += (uint32_t)std::max(aliases.size(), (size_t)1);
+		}
+		uint32_t naive_state = state;
+		// what wrote it before the graph in another state is done with it after the transition,
+		// in UNORDERED_ACCESS nothing waits for it but a UAV barrier. A transient's contents
+		// are undefined after its aliasing barrier.
+		bool written = state == kUnorderedAccess && !m_resources[r].transient;
+		size_t i = 0;
+		while (i < list.size())
+		{
+			if (list[i].write)
+			{
+				if (state != list[i].state)
+				{
+					AddTransition(r, state, list[i].state, last_position, list[i].position);
+					state = list[i].state;
+				}
+				else if (state == kUnorderedAccess && written)
+				{
+					m_barriers[list[i].position].push_back({ kUAVBarrier, r, state, state, kNoResource });
+					++m_stats.uavBarriers;
+				}
+				written = true;
+				last_position = (int32_t)list[i].position;
+				++i;
+				continue;
+			}
+
+			// a run of reads, one transition into all of their states
+			size_t end = i;
+			uint32_t read_state = 0;
+			for (; end < list.size() && !list[end].write; ++end)
+				read_state |= list[end].state;
+			if (!Covers(state, read_state, false))
+			{
+				AddTransition(r, state, read_state, last_position, list[i].position);
+				state = read_state;
+			}
+			last_position = (int32_t)list[end - 1].position;
+			i = end;
+		}
+		// TransitionResource for each use, to the exact state asked for
+		for (const Use& use : list)
+		{
+			if (naive_state != use.state)
+				++m_stats.naiveBarriers;
+			else if (use.state == kUnorderedAccess)
+				++m_stats.naiveBarriers;
+			naive_state = use.state;
+		}
+
+		uint32_t final_state = m_resources[r].finalState;
+		if (final_state != kKeepState && state != final_state)
+			AddTransition(r, state, final_state, last_position, num_scheduled);
+		if (final_state != kKeepState && naive_state != final_state)
+			++m_stats.naiveBarriers;
+		if (!list.empty())
+		{
+			m_firstUse[r] = (int32_t)list.front().position;
+			m_lastUse[r] = (int32_t)list.back().position;
+		}
+	}
+
+	for (std::vector<Barrier>& batch : m_barriers)
+	{
+		// aliasing barriers before the transitions of the resources they activate, ends next,
+		// the pass after them needs them, begins last
+		std::stable_sort(batch.begin(), batch.end(), [](const Barrier& a, const Barrier& b)
+		{
+			auto rank = [](BarrierType type) { return type == kAliasing ? 0 : type == kEndSplit ? 1 : type == kBeginSplit ? 3 : 2; };
+			return rank(a.type) < rank(b.type);
+		});
+		m_stats.batches += batch.empty() ? 0 : 1;
+	}
+	m_stats.naiveBatches = num_scheduled + 1;
+}
+
+bool FrameGraph::Compile(bool reorder /* = false */)
+{
+	m_stats = Stats();
+	m_order.clear();
+	m_barriers.clear();
+	if (!m_error.empty())
+	{
+		assert(false && "conflicting accesses in the frame graph");
+		return false;
+	}
+
+	const uint32_t num_passes = (uint32_t)m_passes.size();
+	std::vector<bool> needed(num_passes, false);
+	std::vector<std::vector<Handle>> predecessors(num_passes);
+	Cull(needed, predecessors);
+	Order(needed, predecessors, reorder);
+	PlaceBarriers();
+
+	m_stats.passes = (uint32_t)m_order.size();
+	m_stats.culledPasses = num_passes - m_stats.passes;
+	uint32_t declared_position = 0;
+	for (Handle p = 0; p < num_passes; ++p)
+	{
+		if (needed[p])
+			m_stats.movedPasses += m_order[declared_position++] != p;
+	}
+	return true;
+}
+
+FrameGraph::Violations FrameGraph::Verify() const
+{
+	Violations violations = {};
+	const uint32_t num_resources = (uint32_t)m_resources.size();
+	std::vector<int32_t> position(m_passes.size(), -1);
+	for (uint32_t i = 0; i < m_order.size(); ++i)
+		position[m_order[i]] = (int32_t)i;
+
+	std::vector<uint32_t> state(num_resources);
+	std::vector<uint32_t> pending(num_resources, kKeepState);
+	std::vector<bool> uav_written(num_resources, false);
+	for (Handle r = 0; r < num_resources; ++r)
+	{
+		state[r] = m_resources[r].initialState;
+		uav_written[r] = state[r] == kUnorderedAccess && !m_resources[r].transient;
+	}
+	std::vector<bool> used(num_resources, false);
+	std::vector<uint32_t> aliasing(num_resources, 0);
+	for (uint32_t i = 0; i < m_barriers.size(); ++i)
+	{
+		for (const Barrier& barrier : m_barriers[i])
+		{
+			Handle r = barrier.resource;
+			violations.state += state[r] != barrier.before;
+			switch (barrier.type)
+			{
+			case kTransition:
+				violations.state += pending[r] != kKeepState;
+				state[r] = barrier.after;
+				uav_written[r] = false;
+				break;
+			case kBeginSplit:
+				violations.state += pending[r] != kKeepState;
+				violations.transient += m_resources[r].transient && !used[r];
+				pending[r] = barrier.after;
+				break;
+			case kEndSplit:
+				violations.state += pending[r] != barrier.after;
+				pending[r] = kKeepState;
+				state[r] = barrier.after;
+				uav_written[r] = false;
+				break;
+			case kUAVBarrier:
+				violations.state += state[r] != kUnorderedAccess;
+				violations.uav += !uav_written[r];
+				uav_written[r] = false;
+				break;
+			case kAliasing:
+			{
+				const std::vector<Handle>& aliases = m_resources[r].aliases;
+				violations.alias += !m_resources[r].transient || used[r] || barrier.after != barrier.before;
+				if (barrier.aliased == kNoResource)
+					violations.alias += !aliases.empty();
+				else
+					violations.alias += std::find(aliases.begin(), aliases.end(), barrier.aliased) == aliases.end() || barrier.aliased >= num_resources ||
+						m_lastUse[barrier.aliased] >= (int32_t)i;
+				++aliasing[r];
+				uav_written[r] = false;
+				break;
+			}
+			}
+		}
+		if (i == m_order.size())
+			break;
+		for (const Access& access : m_passes[m_order[i]].accesses)
+		{
+			Handle r = access.resource;
+			bool in_state = access.write ? state[r] == access.state : IsReadState(state[r]) && (state[r] & access.state) == access.state;
+			violations.state += !in_state || pending[r] != kKeepState;
+			if (m_resources[r].transient && !used[r])
+				violations.alias += aliasing[r] != std::max(m_resources[r].aliases.size(), (size_t)1);
+			used[r] = true;
+			if (access.write && access.state == kUnorderedAccess)
+			{
+				violations.uav += uav_written[r];
+				uav_written[r] = true;
+			}
+		}
+	}
+	for (Handle r = 0; r < num_resources; ++r)
+	{
+		if (m_resources[r].finalState != kKeepState)
+			violations.finalState += state[r] != m_resources[r].finalState || pending[r] != kKeepState;
+	}
+
+	for (Handle p = 0; p < m_passes.size(); ++p)
+	{
+		for (const Access& first : m_passes[p].accesses)
+		{
+			if (position[p] < 0)
+			{
+				violations.order += first.write && m_resources[first.resource].exported;
+				continue;
+			}
+			for (Handle q = p + 1; q < m_passes.size(); ++q)
+			{
+				for (const Access& second : m_passes[q].accesses)
+				{
+					if (second.resource != first.resource || position[q] < 0 || !(first.write || second.write))
+						continue;
+					violations.order += position[p] > position[q];
+				}
+			}
+		}
+	}
+	return violations;
+}
+
+bool FrameGraph::GetLifetime(Handle resource, uint32_t& first, uint32_t& last) const
+{
+	if (resource >= m_firstUse.size() || m_firstUse[resource] < 0)
+		return false;
+	first = (uint32_t)m_firstUse[resource];
+	last = (uint32_t)m_lastUse[resource];
+	return true;
+}
+
+std::string FrameGraph::StateName(uint32_t state)
+{
+	static const char* names[] =
+	{
+		"VERTEX_AND_CONSTANT_BUFFER", "INDEX_BUFFER", "RENDER_TARGET", "UNORDERED_ACCESS", "DEPTH_WRITE", "DEPTH_READ",
+		"NON_PIXEL_SHADER_RESOURCE", "PIXEL_SHADER_RESOURCE", "STREAM_OUT", "INDIRECT_ARGUMENT", "COPY_DEST", "COPY_SOURCE",
+		"RESOLVE_DEST", "RESOLVE_SOURCE"
+	};
+	if (state == kCommon)
+		return "COMMON";
+	if (state == kKeepState)
+		return "KEEP";
+	std::string name;
+	for (uint32_t bit = 0; bit < 32; ++bit)
+	{
+		if ((state & (1u << bit)) == 0)
+			continue;
+		if (!name.empty())
+			name += "|";
+		name += bit < sizeof(names) / sizeof(names[0]) ? names[bit] : "0x" + std::to_string(1u << bit);
+	}
+	return name;
+}
+
+std::string FrameGraph::DumpSchedule() const
+{
+	static const char* barrier_names[] = { "transition", "begin", "end", "uav", "alias" };
+	std::ostringstream out;
+	out << "frame graph: " << m_stats.passes << " passes, " << m_stats.culledPasses << " culled, " << m_stats.movedPasses << " moved\n";
+	auto dump_batch = [&](const std::vector<Barrier>& batch)
+	{
+		for (const Barrier& barrier : batch)
+		{
+			out << "    " << barrier_names[barrier.type] << " " << m_resources[barrier.resource].name;
+			if (barrier.type == kAliasing)
+				out << " over " << (barrier.aliased == kNoResource ? "any" : m_resources[barrier.aliased].name);
+			else if (barrier.type != kUAVBarrier)
+				out << " " << StateName(barrier.before) << " -> " << StateName(barrier.after);
+			out << "\n";
+		}
+	};
+	for (size_t position = 0; position < m_order.size(); ++position)
+	{
+		dump_batch(m_barriers[position]);
+		out << "  " << position << " " << m_passes[m_order[position]].name << "\n";
+	}
+	if (!m_barriers.empty())
+		dump_batch(m_barriers.back());
+	out << m_stats.transitions << " transitions, " << m_stats.splitTransitions << " split, " << m_stats.uavBarriers << " uav barriers, "
+		<< m_stats.aliasingBarriers << " aliasing in " << m_stats.batches << " batches, by hand " << m_stats.naiveBarriers << " barriers in "
+		<< m_stats.naiveBatches << " batches\n";
+	return out.str();
+}
+
+void FrameGraph::Reset()
+{
+	m_passes.clear();
+	m_resources.clear();
+	m_order.clear();
+	m_barriers.clear();
+	m_firstUse.clear();
+	m_lastUse.clear();
+	m_stats = Stats();
+	m_error.clear();
+}
\ No newline at end of file
@@ -0,0 +1,196 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// The passes of a frame and the resources they read and write, compiled into the barriers
+// between them. Passes are declared in the order they would be recorded by hand, which is
+// what a read or write refers to: a read sees the last write declared before it. Compile
+// culls the passes that contribute to no exported resource, orders the rest (in declaration
+// order, or when asked moving a pass ahead when the barriers it waits for would get further
+// from their last use, never across a dependency), and places the barriers:
+// - consecutive reads of a resource share one transition into all their read states
+// - a transition with passes in between that don't touch the resource is split, begun
+//   after its last use and ended before the next
+// - a UAV written again in the same state gets a UAV barrier, so does the first write of a
+//   resource that comes in UNORDERED_ACCESS, what recorded before the graph may have written it
+// - a transient resource gets an aliasing barrier before its first pass, see SetTransient
+// - everything before a pass is one batch
+// States are the D3D12_RESOURCE_STATES values, nothing here needs D3D12, see
+// FrameGraphExecutor for running a compiled graph on a CommandContext.
+class FrameGraph
+{
+public:
+	typedef uint32_t Handle;
+	// no transition after the last pass
+	static const uint32_t kKeepState = 0xffffffff;
+	static const Handle kNoResource = 0xffffffff;
+
+	enum State : uint32_t
+	{
+		kCommon = 0,
+		kVertexAndConstantBuffer = 0x1,
+		kIndexBuffer = 0x2,
+		kRenderTarget = 0x4,
+		kUnorderedAccess = 0x8,
+		kDepthWrite = 0x10,
+		kDepthRead = 0x20,
+		kNonPixelShaderResource = 0x40,
+		kPixelShaderResource = 0x80,
+		kStreamOut = 0x100,
+		kIndirectArgument = 0x200,
+		kCopyDest = 0x400,
+		kCopySource = 0x800,
+		kResolveDest = 0x1000,
+		kResolveSource = 0x2000,
+		kWriteStates = kRenderTarget | kUnorderedAccess | kDepthWrite | kStreamOut | kCopyDest | kResolveDest
+	};
+
+	enum BarrierType
+	{
+		kTransition,
+		kBeginSplit,
+		kEndSplit,
+		kUAVBarrier,
+		kAliasing
+	};
+
+	struct Barrier
+	{
+		BarrierType type;
+		Handle resource;
+		uint32_t before;
+		uint32_t after;
+		// of kAliasing, the resource whose memory this one takes over, kNoResource for any
+		Handle aliased;
+	};
+
+	struct Stats
+	{
+		uint32_t passes;
+		uint32_t culledPasses;
+		// scheduled at another position than in declaration order
+		uint32_t movedPasses;
+		uint32_t transitions;
+		// begin and end pairs
+		uint32_t splitTransitions;
+		uint32_t uavBarriers;
+		uint32_t aliasingBarriers;
+		uint32_t batches;
+		// what a TransitionResource per access in the same order would have emitted,
+		// transitions and UAV barriers, and the flushes for them, one per pass
+		uint32_t naiveBarriers;
+		uint32_t naiveBatches;
+	};
+
+	// What Verify found replaying the compiled schedule against the declarations
+	struct Violations
+	{
+		// a pass not finding a resource in the state it declared, or with a split open on it
+		uint32_t state;
+		// a UAV written twice without a UAV barrier between, the first write of one that
+		// came in UNORDERED_ACCESS counts, or a UAV barrier with no write before it
+		uint32_t uav;
+		// a pass that writes and one that reads or writes the same resource out of declaration
+		// order, or a pass writing an exported resource culled
+		uint32_t order;
+		// a resource not left in its final state
+		uint32_t finalState;
+		// a transition of a transient resource begun before its first pass
+		uint32_t transient;
+		// a transient used without an aliasing barrier from each resource it takes over, or
+		// an aliasing barrier after its first pass, on a resource that isn't transient, or
+		// from a resource still used at or after it
+		uint32_t alias;
+
+		uint32_t Total() const { return state + uav + order + finalState + transient + alias; }
+	};
+
+	FrameGraph();
+
+	// initialState is the state the resource is in before the first pass. An exported
+	// resource is a result of the graph, a pass writing it is never culled.
+	Handle AddResource(const std::string& name, uint32_t initialState, uint32_t finalState = kKeepState, bool exported = true);
+	void SetInitialState(Handle resource, uint32_t state);
+	// The resource shares memory with others, which may still use it before its first pass:
+	// its first transition isn't split. aliases are the resources of this graph whose memory
+	// it takes over, see TransientHeapPlanner::GetAliases, an aliasing barrier from each of
+	// them, or one from any resource without, comes before its first pass.
+	void SetTransient(Handle resource, const std::vector<Handle>& aliases = std::vector<Handle>());
+	Handle AddPass(const std::string& name);
+	// state is a read only state, or several of them
+	void Read(Handle pass, Handle resource, uint32_t state);
+	// state is one of kWriteStates, a UAV written with atomics or accumulated is a write
+	void Write(Handle pass, Handle resource, uint32_t state);
+
+	// false if a pass declared a resource in conflicting states, see GetError
+	bool Compile(bool reorder = false);
+	const std::string& GetError() const { return m_error; }
+	// Replays the compiled schedule, none of the counts is 0 unless the barriers are wrong
+	Violations Verify() const;
+
+	// Pass handles in the compiled order
+	const std::vector<Handle>& GetOrder() const { return m_order; }
+	// The batch before the pass at position, position GetOrder().size() for the one after
+	// the last pass. Aliasing barriers come first, then split ends, split begins last.
+	const std::vector<Barrier>& GetBarriers(uint32_t position) const { return m_barriers[position]; }
+	// The first and last position of a pass using the resource, false if none does
+	bool GetLifetime(Handle resource, uint32_t& first, uint32_t& last) const;
+
+	uint32_t GetNumPasses() const { return (uint32_t)m_passes.size(); }
+	uint32_t GetNumResources() const { return (uint32_t)m_resources.size(); }
+	const std::string& GetPassName(Handle pass) const { return m_passes[pass].name; }
+	const std::string& GetResourceName(Handle resource) const { return m_resources[resource].name; }
+	uint32_t GetInitialState(Handle resource) const { return m_resources[resource].initialState; }
+	Stats GetStats() const { return m_stats; }
+
+	// The compiled order and the barriers of each batch, one line each
+	std::string DumpSchedule() const;
+	static std::string StateName(uint32_t state);
+
+	// Forgets every pass and resource
+	void Reset();
+
+private:
+	struct Access
+	{
+		Handle resource;
+		uint32_t state;
+		bool write;
+	};
+
+	struct Pass
+	{
+		std::string name;
+		std::vector<Access> accesses;
+	};
+
+	struct Resource
+	{
+		std::string name;
+		uint32_t initialState;
+		uint32_t finalState;
+		bool exported;
+		bool transient;
+		std::vector<Handle> aliases;
+	};
+
+	static bool IsReadState(uint32_t state) { return (state & kWriteStates) == 0; }
+	// no barrier when a resource in state is used in use, or used again by a read
+	static bool Covers(uint32_t state, uint32_t use, bool write);
+
+	void AddAccess(Handle pass, Handle resource, uint32_t state, bool write);
+	void Cull(std::vector<bool>& needed, std::vector<std::vector<Handle>>& predecessors) const;
+	void Order(const std::vector<bool>& needed, const std::vector<std::vector<Handle>>& predecessors, bool reorder);
+	void PlaceBarriers();
+	void AddTransition(Handle resource, uint32_t before, uint32_t after, int32_t lastPosition, uint32_t position);
+
+	std::vector<Pass> m_passes;
+	std::vector<Resource> m_resources;
+	std::vector<Handle> m_order;
+	std::vector<std::vector<Barrier>> m_barriers;
+	std::vector<int32_t> m_firstUse;
+	std::vector<int32_t> m_lastUse;
+	Stats m_stats;
+	std::string m_error;
+};
\ No newline at end of file
@@ -0,0 +1,116 @@
+#include "stdafx.h"
+#include "FrameGraphBenchmark.h"
+#include "FrameGraph.h"
+#include "Math/Random.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+using Math::RandomNumberGenerator;
+
+FrameGraphBenchmark::Desc FrameGraphBenchmark::DefaultDesc()
+{
+	Desc desc;
+	desc.numGraphs = 2000;
+	desc.numResources = 24;
+	desc.numPasses = 40;
+	desc.accessesPerPass = 4;
+	desc.writePercent = 35;
+	desc.exportPercent = 40;
+	desc.seed = 1;
+	return desc;
+}
+
+FrameGraphBenchmark::Result FrameGraphBenchmark::Run(const Desc& desc)
+{
+	static const uint32_t read_states[] =
+	{
+		FrameGraph::kNonPixelShaderResource, FrameGraph::kPixelShaderResource, FrameGraph::kCopySource, FrameGraph::kIndirectArgument
+	};
+	static const uint32_t write_states[] =
+	{
+		FrameGraph::kUnorderedAccess, FrameGraph::kUnorderedAccess, FrameGraph::kRenderTarget, FrameGraph::kCopyDest
+	};
+
+	Result result = {};
+	RandomNumberGenerator rng(desc.seed);
+	FrameGraph graph;
+	std::vector<FrameGraph::Handle> pass_resources;
+	double seconds = 0.0;
+	uint64_t compiles = 0;
+	for (uint32_t g = 0; g < desc.numGraphs; ++g)
+	{
+		graph.Reset();
+		const uint32_t num_resources = std::max(desc.numResources, 1u);
+		for (uint32_t r = 0; r < num_resources; ++r)
+		{
+			uint32_t initial_state = rng.NextUInt() % 3 == 0 ? (uint32_t)FrameGraph::kCommon : rng.NextUInt() % 2 ? read_states[rng.NextUInt() % 4] : write_states[rng.NextUInt() % 4];
+			uint32_t final_state = rng.NextUInt() % 4 == 0 ? read_states[rng.NextUInt() % 2] : FrameGraph::kKeepState;
+			bool exported = rng.NextUInt() % 100 < desc.exportPercent;
+			graph.AddResource("r" + std::to_string(r), initial_state, final_state, exported);
+			if (rng.NextUInt() % 4 == 0)
+				graph.SetTransient(r);
+		}
+		for (uint32_t p = 0; p < desc.numPasses; ++p)
+		{
+			FrameGraph::Handle pass = graph.AddPass("p" + std::to_string(p));
+			pass_resources.clear();
+			for (uint32_t a = 0; a < desc.accessesPerPass; ++a)
+			{
+				FrameGraph::Handle r = rng.NextUInt() % num_resources;
+				bool write = rng.NextUInt() % 100 < desc.writePercent;
+				// one access per resource and pass, so none conflicts
+				if (std::find(pass_resources.begin(), pass_resources.end(), r) != pass_resources.end())
+					continue;
+				uint32_t state = write ? write_states[rng.NextUInt() % 4] : read_states[rng.NextUInt() % 4];
+				if (write)
+					graph.Write(pass, r, state);
+				else
+					graph.Read(pass, r, state);
+				pass_resources.push_back(r);
+			}
+		}
+
+		for (int reorder = 0; reorder < 2; ++reorder)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			graph.Compile(reorder != 0);
+			seconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+			++compiles;
+
+			FrameGraph::Stats stats = graph.GetStats();
+			result.passes += stats.passes;
+			result.culledPasses += stats.culledPasses;
+			result.movedPasses += stats.movedPasses;
+			result.barriers += stats.transitions + stats.splitTransitions + stats.uavBarriers;
+			result.splitTransitions += stats.splitTransitions;
+			result.batches += stats.batches;
+			result.naiveBarriers += stats.naiveBarriers;
+			result.naiveBatches += stats.naiveBatches;
+			AddViolations(graph.Verify(), result.violations);
+		}
+	}
+	result.seconds = seconds;
+	result.compilesPerSecond = compiles / std::max(seconds, 1e-9);
+	return result;
+}
+
+void FrameGraphBenchmark::AddViolations(const FrameGraph::Violations& found, SelfTest::Violations& violations)
+{
+	violations.Add("state", found.state);
+	violations.Add("uav", found.uav);
+	violations.Add("order", found.order);
+	violations.Add("final state", found.finalState);
+	violations.Add("transient", found.transient);
+	violations.Add("aliasing", found.alias);
+}
+
+std::string FrameGraphBenchmark::Summarize(const Result& result)
+{
+	char line[256];
+	snprintf(line, sizeof(line), "%.0f compiles / s, %llu barriers in %llu batches against %llu in %llu, %llu split",
+		result.compilesPerSecond, (unsigned long long)result.barriers, (unsigned long long)result.batches,
+		(unsigned long long)result.naiveBarriers, (unsigned long long)result.naiveBatches, (unsigned long long)result.splitTransitions);
+	return line;
+}
\ No newline at end of file
@@ -0,0 +1,55 @@
+#pragma once
+#include "Utils/SelfTest.h"
+#include "FrameGraph.h"
+#include <cstdint>
+#include <string>
+
+// FrameGraph on random graphs: numResources resources, numPasses passes declaring
+// accessesPerPass accesses each, a write with writePercent percent chance, to shader,
+// copy and render target states. A resource is exported with exportPercent percent chance
+// and a few get a final state or are transient. Each graph is compiled with and without reordering, and
+// FrameGraph::Verify replays the schedule against the declarations:
+// - every pass finds what it declared in the state it declared, no split is open on it
+// - a UAV written after a UAV write, or first written in the UNORDERED_ACCESS it came in,
+//   had a UAV barrier in between, and no UAV barrier comes before a first write otherwise
+// - a pass that writes and one that reads or writes the same resource keep their
+//   declared order, every pass writing an exported resource is scheduled
+// - every resource ends in its final state
+// - no transition of a transient resource begins before its first pass, and an aliasing
+//   barrier comes before that pass
+class FrameGraphBenchmark
+{
+public:
+	struct Desc
+	{
+		uint32_t numGraphs;
+		uint32_t numResources;
+		uint32_t numPasses;
+		uint32_t accessesPerPass;
+		uint32_t writePercent;
+		uint32_t exportPercent;
+		uint32_t seed;
+	};
+
+	struct Result
+	{
+		double seconds;
+		double compilesPerSecond;
+		uint64_t passes;
+		uint64_t culledPasses;
+		uint64_t movedPasses;
+		uint64_t barriers;
+		uint64_t splitTransitions;
+		uint64_t batches;
+		uint64_t naiveBarriers;
+		uint64_t naiveBatches;
+		// "state", "uav", "order", "final state", "transient" and "aliasing", by the checks above
+		SelfTest::Violations violations;
+	};
+
+	static Desc DefaultDesc();
+	static Result Run(const Desc& desc);
+	static std::string Summarize(const Result& result);
+	// the counts of FrameGraph::Verify under the names above, for the checks of other graphs
+	static void AddViolations(const FrameGraph::Violations& found, SelfTest::Violations& violations);
+};
\ No newline at end of file
@@ -0,0 +1,92 @@
+#include "stdafx.h"
+#include "FrameGraphExecutor.h"
+#include "CommandContext.h"
+#include <algorithm>
+
+FrameGraph::Handle FrameGraphExecutor::Import(GpuResource& resource, const std::string& name,
+	uint32_t finalState /* = FrameGraph::kKeepState */, bool exported /* = true */)
+{
+	m_resources.push_back(&resource);
+	m_compiled = false;
+	return m_graph.AddResource(name, resource.GetUsageState(), finalState, exported);
+}
+
+FrameGraph::Handle FrameGraphExecutor::AddPass(const std::string& name, const PassFunc& func)
+{
+	m_passes.push_back(func);
+	m_compiled = false;
+	return m_graph.AddPass(name);
+}
+
+void FrameGraphExecutor::SetTransient(FrameGraph::Handle resource, const std::vector<FrameGraph::Handle>& aliases /* = std::vector<FrameGraph::Handle>() */)
+{
+	m_graph.SetTransient(resource, aliases);
+	m_compiled = false;
+}
+
+bool FrameGraphExecutor::Compile(bool reorder /* = false */)
+{
+	for (FrameGraph::Handle r = 0; r < m_resources.size(); ++r)
+		m_graph.SetInitialState(r, m_resources[r]->GetUsageState());
+	m_reorder = reorder;
+	m_compiled = m_graph.Compile(reorder);
+	assert(!m_compiled || m_graph.Verify().Total() == 0);
+	return m_compiled;
+}
+
+bool FrameGraphExecutor::Execute(CommandContext& context)
+{
+	bool states_changed = false;
+	for (FrameGraph::Handle r = 0; r < m_resources.size() && !states_changed; ++r)
+		states_changed = m_resources[r]->GetUsageState() != (D3D12_RESOURCE_STATES)m_graph.GetInitialState(r);
+	if ((!m_compiled || states_changed) && !Compile(m_reorder))
+		return false;
+
+	const std::vector<FrameGraph::Handle>& order = m_graph.GetOrder();
+	// the transients the aliasing barriers of a batch activated
+	std::vector<GpuResource*> activated;
+	for (uint32_t position = 0; position <= order.size(); ++position)
+	{
+		activated.clear();
+		for (const FrameGraph::Barrier& barrier : m_graph.GetBarriers(position))
+		{
+			GpuResource& resource = *m_resources[barrier.resource];
+			// a pass transitioned something it declared on its own
+			assert(resource.GetUsageState() == (D3D12_RESOURCE_STATES)barrier.before);
+			switch (barrier.type)
+			{
+			case FrameGraph::kTransition:
+			case FrameGraph::kEndSplit:
+				context.TransitionResource(resource, (D3D12_RESOURCE_STATES)barrier.after);
+				break;
+			case FrameGraph::kBeginSplit:
+				context.BeginResourceTransition(resource, (D3D12_RESOURCE_STATES)barrier.after);
+				break;
+			case FrameGraph::kUAVBarrier:
+				context.InsertUAVBarrier(resource);
+				break;
+			case FrameGraph::kAliasing:
+				context.InsertAliasBarrier(barrier.aliased == FrameGraph::kNoResource ? nullptr : m_resources[barrier.aliased], resource);
+				if (std::find(activated.begin(), activated.end(), &resource) == activated.end())
+					activated.push_back(&resource);
+				break;
+			}
+		}
+		context.FlushResourceBarriers();
+		if (position < order.size())
+		{
+			for (GpuResource* resource : activated)
+				context.DiscardResource(*resource);
+			m_passes[order[position]](context);
+		}
+	}
+	return true;
+}
+
+void FrameGraphExecutor::Reset()
+{
+	m_graph.Reset();
+	m_resources.clear();
+	m_passes.clear();
+	m_compiled = false;
+}
\ No newline at end of file
@@ -0,0 +1,57 @@
+#pragma once
+#include "stdafx.h"
+#include "FrameGraph.h"
+#include <functional>
+
+class CommandContext;
+class GpuResource;
+
+// A FrameGraph over GpuResources whose passes record on a CommandContext, compiled for the
+// states the resources start in and kept while they do. Execute records each barrier batch
+// through TransitionResource, BeginResourceTransition and InsertUAVBarrier before its pass,
+// so the states the resources track are right for whatever records after the graph. A pass
+// only binds and dispatches, the barriers of what it declared are placed for it.
+class FrameGraphExecutor
+{
+public:
+	typedef std::function<void(CommandContext&)> PassFunc;
+
+	FrameGraph::Handle Import(GpuResource& resource, const std::string& name,
+		uint32_t finalState = FrameGraph::kKeepState, bool exported = true);
+	FrameGraph::Handle AddPass(const std::string& name, const PassFunc& func);
+	void Read(FrameGraph::Handle pass, FrameGraph::Handle resource, D3D12_RESOURCE_STATES state)
+	{
+		m_graph.Read(pass, resource, state);
+		m_compiled = false;
+	}
+	void Write(FrameGraph::Handle pass, FrameGraph::Handle resource, D3D12_RESOURCE_STATES state)
+	{
+		m_graph.Write(pass, resource, state);
+		m_compiled = false;
+	}
+	// A placed resource over memory others use, see TransientHeapPlanner. Before its first
+	// pass it gets an aliasing barrier from each of aliases, the resources of this graph
+	// whose memory it takes over, and is discarded once in the state that pass declared,
+	// RENDER_TARGET or UNORDERED_ACCESS, and that pass must write all of it.
+	void SetTransient(FrameGraph::Handle resource, const std::vector<FrameGraph::Handle>& aliases = std::vector<FrameGraph::Handle>());
+
+	// Compiles with the states the resources are in now, for the lifetimes before Execute.
+	// Declaring anything after makes the next Execute compile again.
+	bool Compile(bool reorder = false);
+	bool IsCompiled() const { return m_compiled; }
+	// Records the graph, compiled again first if it isn't, or if what recorded since left a
+	// resource in another state than the one the graph was compiled with. Nothing if the
+	// graph doesn't compile.
+	bool Execute(CommandContext& context);
+
+	const FrameGraph& GetGraph() const { return m_graph; }
+	// For building the graph again when the passes change
+	void Reset();
+
+private:
+	FrameGraph m_graph;
+	std::vector<GpuResource*> m_resources;
+	std::vector<PassFunc> m_passes;
+	bool m_compiled = false;
+	bool m_reorder = false;
+};
\ No newline at end of file
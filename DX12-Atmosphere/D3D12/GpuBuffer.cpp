@@ -79,6 +79,7 @@ D3D12_CPU_DESCRIPTOR_HANDLE GpuBuffer::CreateConstantBufferView(uint32_t offset,
 
 	D3D12_CPU_DESCRIPTOR_HANDLE cbvHandle = AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 	g_Device->CreateConstantBufferView(&cbvDesc, cbvHandle);
+	RefreshDescriptor(cbvHandle);
 	return cbvHandle;
 }
 
@@ -100,9 +101,10 @@ void ByteAddressBuffer::CreateDerivedViews()
 	srvDesc.Buffer.NumElements = (UINT)m_bufferSize / 4;
 	srvDesc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_RAW;
 
-	if (m_SRV.ptr == D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN)
-		m_SRV = AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-	g_Device->CreateShaderResourceView(m_pResource.Get(), &srvDesc, m_SRV);
+	if (m_SRV.IsNull())
+		m_SRV = AllocateDescriptorHandle(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+	g_Device->CreateShaderResourceView(m_pResource.Get(), &srvDesc, GetSRV());
+	RefreshDescriptor(GetSRV());
 
 	D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
 	uavDesc.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
@@ -110,9 +112,10 @@ void ByteAddressBuffer::CreateDerivedViews()
 	uavDesc.Buffer.NumElements = (UINT)m_bufferSize / 4;
 	uavDesc.Buffer.Flags = D3D12_BUFFER_UAV_FLAG_RAW;
 
-	if (m_UAV.ptr == D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN)
-		m_UAV = AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-	g_Device->CreateUnorderedAccessView(m_pResource.Get(), nullptr, &uavDesc, m_UAV);
+	if (m_UAV.IsNull())
+		m_UAV = AllocateDescriptorHandle(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+	g_Device->CreateUnorderedAccessView(m_pResource.Get(), nullptr, &uavDesc, GetUAV());
+	RefreshDescriptor(GetUAV());
 }
 
 void StructuredBuffer::CreateDerivedViews()
@@ -125,9 +128,10 @@ void StructuredBuffer::CreateDerivedViews()
 	srvDesc.Buffer.StructureByteStride = m_elementSize;
 	srvDesc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_NONE;
 
-	if (m_SRV.ptr == D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN)
-		m_SRV = AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-	g_Device->CreateShaderResourceView(m_pResource.Get(), &srvDesc, m_SRV);
+	if (m_SRV.IsNull())
+		m_SRV = AllocateDescriptorHandle(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+	g_Device->CreateShaderResourceView(m_pResource.Get(), &srvDesc, GetSRV());
+	RefreshDescriptor(GetSRV());
 
 	D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
 	uavDesc.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
@@ -139,19 +143,61 @@ void StructuredBuffer::CreateDerivedViews()
 
 	m_counterBuffer.Create(L"StructuredBuffer::Counter", 1, 4);
 
-	if (m_UAV.ptr == D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN)
-		m_UAV = AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-	g_Device->CreateUnorderedAccessView(m_pResource.Get(), m_counterBuffer.GetResource(), &uavDesc, m_UAV);
+	if (m_UAV.IsNull())
+		m_UAV = AllocateDescriptorHandle(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+	g_Device->CreateUnorderedAccessView(m_pResource.Get(), m_counterBuffer.GetResource(), &uavDesc, GetUAV());
+	RefreshDescriptor(GetUAV());
 }
 
-const D3D12_CPU_DESCRIPTOR_HANDLE& StructuredBuffer::GetCounterSRV(CommandContext& Context)
+D3D12_CPU_DESCRIPTOR_HANDLE StructuredBuffer::GetCounterSRV(CommandContext& Context)
 {
 	Context.TransitionResource(m_counterBuffer, D3D12_RESOURCE_STATE_GENERIC_READ);
 	return m_counterBuffer.GetSRV();
 }
 
-const D3D12_CPU_DESCRIPTOR_HANDLE& StructuredBuffer::GetCounterUAV(CommandContext& Context)
+D3D12_CPU_DESCRIPTOR_HANDLE StructuredBuffer::GetCounterUAV(CommandContext& Context)
 {
 	Context.TransitionResource(m_counterBuffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
 	return m_counterBuffer.GetUAV();
+}
+
+void ReadbackBuffer::Create(const std::wstring& name, uint32_t numElements, uint32_t elementSize)
+{
+	Destroy();
+
+	m_elementCount = numElements;
+	m_elementSize = elementSize;
+	m_bufferSize = numElements * elementSize;
+	m_usageState = D3D12_RESOURCE_STATE_COPY_DEST;
+
+	// readback heaps can't have the unordered access flag
+	m_resourceFlags = D3D12_RESOURCE_FLAG_NONE;
+	D3D12_RESOURCE_DESC resourceDesc = DescribeBuffer();
+	D3D12_HEAP_PROPERTIES heapProps = CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK);
+
+	ThrowIfFailed(
+		g_Device->CreateCommittedResource(&heapProps, D3D12_HEAP_FLAG_NONE,
+			&resourceDesc, m_usageState, nullptr, IID_PPV_ARGS(&m_pResource)));
+
+	m_gpuVirtualAddress = m_pResource->GetGPUVirtualAddress();
+
+#ifdef RELEASE
+	(name);
+#else
+	m_pResource->SetName(name.c_str());
+#endif
+}
+
+void* ReadbackBuffer::Map()
+{
+	void* memory;
+	CD3DX12_RANGE readRange(0, m_bufferSize);
+	ThrowIfFailed(m_pResource->Map(0, &readRange, &memory));
+	return memory;
+}
+
+void ReadbackBuffer::Unmap()
+{
+	CD3DX12_RANGE writeRange(0, 0);
+	m_pResource->Unmap(0, &writeRange);
 }
\ No newline at end of file
@@ -5,15 +5,20 @@
 class GpuBuffer : public GpuResource
 {
 public:
-	~GpuBuffer() { Destroy(); }
+	~GpuBuffer()
+	{
+		Destroy();
+		FreeDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, m_SRV);
+		FreeDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, m_UAV);
+	}
 
 	void Create(const std::wstring& name, uint32_t numElements, uint32_t elementSize, const void* initialData = nullptr);
 
 	void CreatePlaced(const std::wstring& name, ID3D12Heap* pBackingHeap, uint32_t heapOffset, uint32_t numElements, uint32_t elementSize,
 		const void* initialData = nullptr);
 
-	const D3D12_CPU_DESCRIPTOR_HANDLE& GetSRV() const { return m_SRV; }
-	const D3D12_CPU_DESCRIPTOR_HANDLE& GetUAV() const { return m_UAV; }
+	D3D12_CPU_DESCRIPTOR_HANDLE GetSRV() const { return GetDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, m_SRV); }
+	D3D12_CPU_DESCRIPTOR_HANDLE GetUAV() const { return GetDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, m_UAV); }
 
 	D3D12_GPU_VIRTUAL_ADDRESS RootConstantBufferView() const { return m_gpuVirtualAddress; }
 
@@ -39,18 +44,16 @@ public:
 
 protected:
 
-	GpuBuffer() : m_bufferSize(0), m_elementCount(0), m_elementSize(0)
+	GpuBuffer() : m_UAV(), m_SRV(), m_bufferSize(0), m_elementCount(0), m_elementSize(0)
 	{
 		m_resourceFlags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
-		m_UAV.ptr = D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN;
-		m_SRV.ptr = D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN;
 	}
 
 	D3D12_RESOURCE_DESC DescribeBuffer();
 	virtual void CreateDerivedViews() = 0;
 
-	D3D12_CPU_DESCRIPTOR_HANDLE m_UAV;
-	D3D12_CPU_DESCRIPTOR_HANDLE m_SRV;
+	DescriptorFreeList::Handle m_UAV;
+	DescriptorFreeList::Handle m_SRV;
 
 	size_t m_bufferSize;
 	uint32_t m_elementCount;
@@ -95,9 +98,23 @@ public:
 
 	ByteAddressBuffer& GetCounterBuffer() { return m_counterBuffer; }
 
-	const D3D12_CPU_DESCRIPTOR_HANDLE& GetCounterSRV(CommandContext& context);
-	const D3D12_CPU_DESCRIPTOR_HANDLE& GetCounterUAV(CommandContext& context);
+	D3D12_CPU_DESCRIPTOR_HANDLE GetCounterSRV(CommandContext& context);
+	D3D12_CPU_DESCRIPTOR_HANDLE GetCounterUAV(CommandContext& context);
 
 private:
 	ByteAddressBuffer m_counterBuffer;
+};
+
+class ReadbackBuffer : public GpuBuffer
+{
+public:
+	virtual ~ReadbackBuffer() { Destroy(); }
+
+	void Create(const std::wstring& name, uint32_t numElements, uint32_t elementSize);
+
+	void* Map();
+	void Unmap();
+
+protected:
+	virtual void CreateDerivedViews() override {}
 };
\ No newline at end of file
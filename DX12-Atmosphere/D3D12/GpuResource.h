@@ -37,6 +37,7 @@ public:
 	const ID3D12Resource* GetResource() const { return m_pResource.Get(); }
 
 	D3D12_GPU_VIRTUAL_ADDRESS GetGpuVirtualAddress() const { return m_gpuVirtualAddress; }
+	D3D12_RESOURCE_STATES GetUsageState() const { return m_usageState; }
 
 protected:
 	Microsoft::WRL::ComPtr<ID3D12Resource> m_pResource;
@@ -2,6 +2,7 @@
 #include "CommandListManager.h"
 #include "CommandContext.h"
 #include "DescriptorHeap.h"
+#include "BindlessHeap.h"
 #include "Utils/CameraController.h"
 
 ID3D12Device* g_Device = nullptr;
@@ -15,4 +16,10 @@ DescriptorAllocator g_DescriptorAllocator[D3D12_DESCRIPTOR_HEAP_TYPE_NUM_TYPES]
 	D3D12_DESCRIPTOR_HEAP_TYPE_SAMPLER,
 	D3D12_DESCRIPTOR_HEAP_TYPE_RTV,
 	D3D12_DESCRIPTOR_HEAP_TYPE_DSV
-};
\ No newline at end of file
+};
+
+void RefreshDescriptor(D3D12_CPU_DESCRIPTOR_HANDLE handle)
+{
+	DescriptorAllocator::ViewsChanged();
+	BindlessHeap::Refresh(handle);
+}
\ No newline at end of file
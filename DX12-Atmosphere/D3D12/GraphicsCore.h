@@ -15,4 +15,40 @@ extern DescriptorAllocator g_DescriptorAllocator[];
 inline D3D12_CPU_DESCRIPTOR_HANDLE AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE type, uint32_t count = 1)
 {
 	return g_DescriptorAllocator[type].Allocate(count);
-}
\ No newline at end of file
+}
+
+// Resources free their views when they go, recreating them no longer leaks descriptors.
+// count is the one given to AllocateDescriptor. The handle is cleared, so its owner can't
+// free the slots again once they belong to someone else.
+inline void FreeDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE type, D3D12_CPU_DESCRIPTOR_HANDLE& handle, uint32_t count = 1)
+{
+	if (handle.ptr != D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN)
+		g_DescriptorAllocator[type].Free(handle, count);
+	handle.ptr = D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN;
+}
+
+// The generation checked form the resources keep their views in. GetDescriptor asserts in
+// debug builds that the view wasn't freed, a null handle gives D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN.
+inline DescriptorFreeList::Handle AllocateDescriptorHandle(D3D12_DESCRIPTOR_HEAP_TYPE type, uint32_t count = 1)
+{
+	return g_DescriptorAllocator[type].AllocateHandle(count);
+}
+
+inline D3D12_CPU_DESCRIPTOR_HANDLE GetDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE type, const DescriptorFreeList::Handle& handle)
+{
+	if (handle.IsNull())
+		return { D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN };
+	return g_DescriptorAllocator[type].GetCpuHandle(handle);
+}
+
+inline void FreeDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE type, DescriptorFreeList::Handle& handle)
+{
+	if (!handle.IsNull())
+		g_DescriptorAllocator[type].Free(handle);
+	handle = {};
+}
+
+// After a view was written into a handle that shader visible copies may be made of, again
+// or into slots freed by someone else: the bindless copy moves and tables cached by
+// content are dropped
+void RefreshDescriptor(D3D12_CPU_DESCRIPTOR_HANDLE handle);
\ No newline at end of file
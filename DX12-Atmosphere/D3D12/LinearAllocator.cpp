@@ -14,28 +14,14 @@ LinearAllocatorPageManager::LinearAllocatorPageManager()
 
 LinearAllocationPage* LinearAllocatorPageManager::RequestPage(const std::wstring& name /* = L"" */)
 {
-	std::lock_guard<std::mutex> lockGuard(m_mutex);
-
-	while (!m_retiredPages.empty() && g_CommandManager.IsFenceComplete(m_retiredPages.front().first))
-	{
-		m_availablePages.push(m_retiredPages.front().second);
-		m_retiredPages.pop();
-	}
-
-	LinearAllocationPage* pagePtr = nullptr;
-
-	if (!m_availablePages.empty())
-	{
-		pagePtr = m_availablePages.front();
-		m_availablePages.pop();
-	}
-	else
-	{
-		pagePtr = CreateNewPage(0, name);
-		m_pagePool.emplace_back(pagePtr);
-	}
-
-	return pagePtr;
+	return m_retiredPages.Request([](uint64_t fenceValue) { return g_CommandManager.IsFenceComplete(fenceValue); },
+		[this, &name]()
+		{
+			LinearAllocationPage* pagePtr = CreateNewPage(0, name);
+			std::lock_guard<std::mutex> lockGuard(m_mutex);
+			m_pagePool.emplace_back(pagePtr);
+			return pagePtr;
+		});
 }
 
 LinearAllocationPage* LinearAllocatorPageManager::CreateNewPage(size_t pageSize /* = 0 */, const std::wstring& name /* = L"" */)
@@ -77,26 +63,17 @@ LinearAllocationPage* LinearAllocatorPageManager::CreateNewPage(size_t pageSize
 
 void LinearAllocatorPageManager::DiscardPages(uint64_t fenceID, const std::vector<LinearAllocationPage *>& usedPages)
 {
-	std::lock_guard<std::mutex> lockGuard(m_mutex);
-	for (auto iter = usedPages.begin(); iter != usedPages.end(); ++iter)
-		m_retiredPages.push({ fenceID, *iter });
+	m_retiredPages.Retire(fenceID, usedPages);
 }
 
 void LinearAllocatorPageManager::FreeLargePages(uint64_t fenceID, const std::vector<LinearAllocationPage *>& pages)
 {
-	std::lock_guard<std::mutex> lockGuard(m_mutex);
-
-	while (!m_deletionQueue.empty() && g_CommandManager.IsFenceComplete(m_deletionQueue.front().first))
-	{
-		delete m_deletionQueue.front().second;
-		m_deletionQueue.pop();
-	}
+	m_deletionQueue.Reclaim([](uint64_t fenceValue) { return g_CommandManager.IsFenceComplete(fenceValue); },
+		[](LinearAllocationPage* page) { delete page; });
 
 	for (auto iter = pages.begin(); iter < pages.end(); ++iter)
-	{
 		(*iter)->Unmap();
-		m_deletionQueue.push({ fenceID, *iter });
-	}
+	m_deletionQueue.Retire(fenceID, pages);
 }
 
 LinearAllocatorPageManager LinearAllocator::s_pageManager[2];
@@ -112,6 +89,8 @@ void LinearAllocator::CleanupUsedPages(uint64_t fenceID)
 
 	s_pageManager[m_allocationType].DiscardPages(fenceID, m_retiredPages);
 	m_retiredPages.clear();
+	s_pageManager[m_allocationType].AddBytes(m_bytesAllocated);
+	m_bytesAllocated = 0;
 
 	s_pageManager[m_allocationType].FreeLargePages(fenceID, m_largePageList);
 	m_largePageList.clear();
@@ -121,6 +100,7 @@ DynAlloc LinearAllocator::AllocateLargePage(size_t sizeInBytes, const std::wstri
 {
 	LinearAllocationPage* oneOff = s_pageManager[m_allocationType].CreateNewPage(sizeInBytes, name);
 	m_largePageList.push_back(oneOff);
+	m_bytesAllocated += sizeInBytes;
 
 	DynAlloc ret(*oneOff, 0, sizeInBytes);
 	ret.dataPtr = oneOff->m_cpuVirtualAddress;
@@ -159,6 +139,7 @@ DynAlloc LinearAllocator::Allocate(size_t sizeInBytes, const std::wstring& name
 	ret.gpuAddress = m_currPage->m_gpuVirtualAddress + m_currOffset;
 	
 	m_currOffset += alignedSize;
+	m_bytesAllocated += alignedSize;
 
 	return ret;
 }
\ No newline at end of file
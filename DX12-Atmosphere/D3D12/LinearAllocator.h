@@ -1,6 +1,8 @@
 #pragma once
 #include "stdafx.h"
 #include "GpuResource.h"
+#include "FenceRecycler.h"
+#include "PageCache.h"
 
 #define DEFAULT_ALIGN 256
 
@@ -83,16 +85,24 @@ public:
 
 	void FreeLargePages(uint64_t fenceID, const std::vector<LinearAllocationPage*>& pages);
 
-	void Destroy() { m_pagePool.clear(); }
+	void AddBytes(uint64_t bytes) { m_retiredPages.AddBytes(bytes); }
+	void EndFrame() { m_retiredPages.EndFrame(); }
+	PageCache<LinearAllocationPage>::Stats GetStats() const { return m_retiredPages.GetStats(); }
+
+	void Destroy()
+	{
+		m_retiredPages.Reset();
+		m_pagePool.clear();
+	}
 
 private:
 	static LinearAllocatorType s_autoType;
 
 	LinearAllocatorType m_allocationType;
 	std::vector <std::unique_ptr<LinearAllocationPage>> m_pagePool;
-	std::queue<std::pair<uint64_t, LinearAllocationPage*>> m_retiredPages;
-	std::queue<std::pair<uint64_t, LinearAllocationPage*>> m_deletionQueue;
-	std::queue<LinearAllocationPage*> m_availablePages;
+	PageCache<LinearAllocationPage> m_retiredPages;
+	FenceRecycler<LinearAllocationPage> m_deletionQueue;
+	// m_pagePool only
 	std::mutex m_mutex;
 };
 
@@ -100,7 +110,7 @@ class LinearAllocator
 {
 public:
 	LinearAllocator(LinearAllocatorType type) 
-		: m_allocationType(type), m_pageSize(0), m_currOffset(~(size_t)0), m_currPage(nullptr)
+		: m_allocationType(type), m_pageSize(0), m_currOffset(~(size_t)0), m_currPage(nullptr), m_bytesAllocated(0)
 	{
 		assert(type > kInvalidAllocator && type < kNumAllocatorTypes);
 		m_pageSize = (type == kGpuExclusive ? kGpuAllocatorPageSize : kCpuAllocatorPageSize);
@@ -116,6 +126,14 @@ public:
 		s_pageManager[1].Destroy();
 	}
 
+	// Once a frame, for the bytes of the last frame in the stats
+	static void EndFrame()
+	{
+		s_pageManager[0].EndFrame();
+		s_pageManager[1].EndFrame();
+	}
+	static PageCache<LinearAllocationPage>::Stats GetStats(LinearAllocatorType type) { return s_pageManager[type].GetStats(); }
+
 private:
 	DynAlloc AllocateLargePage(size_t sizeInBytes, const std::wstring& name = L"");
 
@@ -125,6 +143,8 @@ private:
 	size_t m_pageSize;
 	size_t m_currOffset;
 	LinearAllocationPage* m_currPage;
+	// since the last CleanupUsedPages, added to the manager's stats there
+	size_t m_bytesAllocated;
 	std::vector<LinearAllocationPage*> m_retiredPages;
 	std::vector<LinearAllocationPage*> m_largePageList;
 };
\ No newline at end of file
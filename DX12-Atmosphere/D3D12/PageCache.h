@@ -0,0 +1,141 @@
+#pragma once
+#include "FenceRecycler.h"
+
+// The free pages of a page manager, a few per thread in front of a FenceRecycler, so
+// threads recording command lists don't meet in the manager for every page. A thread that
+// runs out takes up to refillCount completed pages in one AcquireBatch. Used pages go back
+// in one Retire per command list with its fence, as before. The pages a thread holds are
+// stranded when it exits, at most refillCount - 1 of them, the manager still owns them.
+// Reset forgets every thread's pages at once, the generation tells a thread its pages are gone.
+template <class Page>
+class PageCache
+{
+public:
+	struct Stats
+	{
+		uint64_t requests;
+		// served from the thread's own pages, and refills from the recycler
+		uint64_t cacheHits;
+		uint64_t refills;
+		uint64_t created;
+		// retired and not handed out again, most of them waiting for their fence
+		uint64_t pagesInFlight;
+		uint64_t bytesAllocated;
+		// between the last two EndFrame
+		uint64_t bytesLastFrame;
+		uint64_t frames;
+	};
+
+	explicit PageCache(uint32_t refillCount = 4)
+		: m_refillCount(refillCount), m_generation(NextGeneration()), m_requests(0), m_cacheHits(0), m_refills(0), m_created(0),
+		m_retired(0), m_bytes(0), m_frameStartBytes(0), m_bytesLastFrame(0), m_frames(0)
+	{
+	}
+
+	// 1 turns the thread caches off, every request goes to the recycler
+	void SetRefillCount(uint32_t refillCount) { m_refillCount = refillCount > 0 ? refillCount : 1; }
+
+	// createPage() when no completed page is left anywhere
+	template <class FenceQuery, class CreatePage>
+	Page* Request(const FenceQuery& isFenceComplete, const CreatePage& createPage)
+	{
+		m_requests.fetch_add(1, std::memory_order_relaxed);
+		std::vector<Page*>& local = GetLocalPages();
+		if (local.empty() && m_recycler.AcquireBatch(isFenceComplete, local, m_refillCount) > 0)
+			m_refills.fetch_add(1, std::memory_order_relaxed);
+		else if (!local.empty())
+			m_cacheHits.fetch_add(1, std::memory_order_relaxed);
+		if (!local.empty())
+		{
+			Page* page = local.back();
+			local.pop_back();
+			return page;
+		}
+		m_created.fetch_add(1, std::memory_order_relaxed);
+		return createPage();
+	}
+
+	void Retire(uint64_t fenceValue, const std::vector<Page*>& pages)
+	{
+		m_retired.fetch_add(pages.size(), std::memory_order_relaxed);
+		m_recycler.Retire(fenceValue, pages);
+	}
+	// Allocators add what they handed out when they retire their pages
+	void AddBytes(uint64_t bytes) { m_bytes.fetch_add(bytes, std::memory_order_relaxed); }
+
+	void EndFrame()
+	{
+		uint64_t bytes = m_bytes.load(std::memory_order_relaxed);
+		m_bytesLastFrame = bytes - m_frameStartBytes;
+		m_frameStartBytes = bytes;
+		++m_frames;
+	}
+
+	// Before the manager deletes its pages
+	void Reset() { m_generation.store(NextGeneration(), std::memory_order_release); }
+
+	Stats GetStats() const
+	{
+		typename FenceRecycler<Page>::Stats recycled = m_recycler.GetStats();
+		Stats stats;
+		stats.requests = m_requests.load(std::memory_order_relaxed);
+		stats.cacheHits = m_cacheHits.load(std::memory_order_relaxed);
+		stats.refills = m_refills.load(std::memory_order_relaxed);
+		stats.created = m_created.load(std::memory_order_relaxed);
+		// the recycler only counts retires it collected, so count them here
+		stats.pagesInFlight = m_retired.load(std::memory_order_relaxed) - recycled.reclaimed;
+		stats.bytesAllocated = m_bytes.load(std::memory_order_relaxed);
+		stats.bytesLastFrame = m_bytesLastFrame;
+		stats.frames = m_frames;
+		return stats;
+	}
+
+private:
+	struct LocalPages
+	{
+		const PageCache* owner;
+		uint64_t generation;
+		std::vector<Page*> pages;
+	};
+
+	static uint64_t NextGeneration()
+	{
+		static std::atomic<uint64_t> s_generation(0);
+		return s_generation.fetch_add(1, std::memory_order_relaxed) + 1;
+	}
+
+	std::vector<Page*>& GetLocalPages()
+	{
+		// a handful of managers per page type, a linear search is enough
+		static thread_local std::vector<LocalPages> t_local;
+		uint64_t generation = m_generation.load(std::memory_order_acquire);
+		for (LocalPages& local : t_local)
+		{
+			if (local.owner != this)
+				continue;
+			if (local.generation != generation)
+			{
+				local.pages.clear();
+				local.generation = generation;
+			}
+			return local.pages;
+		}
+		t_local.push_back({ this, generation, {} });
+		return t_local.back().pages;
+	}
+
+	FenceRecycler<Page> m_recycler;
+	uint32_t m_refillCount;
+	std::atomic<uint64_t> m_generation;
+
+	std::atomic<uint64_t> m_requests;
+	std::atomic<uint64_t> m_cacheHits;
+	std::atomic<uint64_t> m_refills;
+	std::atomic<uint64_t> m_created;
+	std::atomic<uint64_t> m_retired;
+	std::atomic<uint64_t> m_bytes;
+	// the thread calling EndFrame only
+	uint64_t m_frameStartBytes;
+	uint64_t m_bytesLastFrame;
+	uint64_t m_frames;
+};
\ No newline at end of file
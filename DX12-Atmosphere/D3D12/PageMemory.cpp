@@ -0,0 +1,139 @@
+#include "stdafx.h"
+#include "PageMemory.h"
+#include <atomic>
+#include <new>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+namespace PageMemory
+{
+	static std::atomic<uint64_t> s_counts[3];
+	static std::atomic<uint64_t> s_largePageFallbacks(0);
+	static std::atomic<uint64_t> s_bytes(0);
+
+#ifdef _WIN32
+	// MEM_LARGE_PAGES fails unless the process token holds SeLockMemoryPrivilege enabled,
+	// which the account must have been granted (Lock pages in memory in the security policy)
+	static bool EnableLockMemoryPrivilege()
+	{
+		HANDLE token;
+		if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+			return false;
+		TOKEN_PRIVILEGES privileges = {};
+		privileges.PrivilegeCount = 1;
+		privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+		bool enabled = LookupPrivilegeValue(nullptr, SE_LOCK_MEMORY_NAME, &privileges.Privileges[0].Luid) &&
+			AdjustTokenPrivileges(token, FALSE, &privileges, 0, nullptr, nullptr) && GetLastError() != ERROR_NOT_ALL_ASSIGNED;
+		CloseHandle(token);
+		if (!enabled)
+			OutputDebugStringA("PageMemory: SeLockMemoryPrivilege not held, allocator pages fall back to 4 KB pages\n");
+		return enabled;
+	}
+
+	static void* AllocateLarge(size_t size)
+	{
+		static const bool s_privilege = EnableLockMemoryPrivilege();
+		SIZE_T minimum = GetLargePageMinimum();
+		if (!s_privilege || minimum == 0 || size % minimum != 0)
+			return nullptr;
+		void* ptr = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+		if (ptr == nullptr && s_largePageFallbacks.load(std::memory_order_relaxed) == 0)
+			OutputDebugStringA("PageMemory: VirtualAlloc with MEM_LARGE_PAGES failed, allocator pages fall back to 4 KB pages\n");
+		return ptr;
+	}
+#else
+	static void* AllocateLarge(size_t size)
+	{
+#ifdef MAP_HUGETLB
+		void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		return ptr == MAP_FAILED ? nullptr : ptr;
+#else
+		return nullptr;
+#endif
+	}
+
+	// 2 MB aligned so the kernel can back it with huge pages, the slack is unmapped again
+	static void* AllocateTransparent(size_t size)
+	{
+#ifdef MADV_HUGEPAGE
+		size_t padded = size + kLargePageSize;
+		uint8_t* base = (uint8_t*)mmap(nullptr, padded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (base == (uint8_t*)MAP_FAILED)
+			return nullptr;
+		uint8_t* aligned = (uint8_t*)(((uintptr_t)base + kLargePageSize - 1) & ~(uintptr_t)(kLargePageSize - 1));
+		if (aligned > base)
+			munmap(base, aligned - base);
+		if (base + padded > aligned + size)
+			munmap(aligned + size, base + padded - (aligned + size));
+		if (madvise(aligned, size, MADV_HUGEPAGE) != 0)
+		{
+			munmap(aligned, size);
+			return nullptr;
+		}
+		return aligned;
+#else
+		return nullptr;
+#endif
+	}
+#endif
+
+	void* Allocate(size_t size, bool preferLargePages, Kind& kind)
+	{
+		void* ptr = nullptr;
+		bool large = preferLargePages && size % kLargePageSize == 0;
+		if (large)
+		{
+			ptr = AllocateLarge(size);
+			kind = kLarge;
+#ifndef _WIN32
+			if (ptr == nullptr)
+			{
+				ptr = AllocateTransparent(size);
+				kind = kTransparent;
+			}
+#endif
+		}
+		if (ptr == nullptr)
+		{
+			if (large)
+				s_largePageFallbacks.fetch_add(1, std::memory_order_relaxed);
+#ifdef _WIN32
+			ptr = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+			ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+			ptr = ptr == MAP_FAILED ? nullptr : ptr;
+#endif
+			kind = kDefault;
+		}
+		if (ptr == nullptr)
+			throw std::bad_alloc();
+		s_counts[kind].fetch_add(1, std::memory_order_relaxed);
+		s_bytes.fetch_add(size, std::memory_order_relaxed);
+		return ptr;
+	}
+
+	void Free(void* ptr, size_t size, Kind kind)
+	{
+		if (ptr == nullptr)
+			return;
+#ifdef _WIN32
+		VirtualFree(ptr, 0, MEM_RELEASE);
+#else
+		munmap(ptr, size);
+#endif
+		s_counts[kind].fetch_sub(1, std::memory_order_relaxed);
+		s_bytes.fetch_sub(size, std::memory_order_relaxed);
+	}
+
+	Stats GetStats()
+	{
+		Stats stats;
+		stats.defaultPages = s_counts[kDefault].load(std::memory_order_relaxed);
+		stats.largePages = s_counts[kLarge].load(std::memory_order_relaxed);
+		stats.transparentPages = s_counts[kTransparent].load(std::memory_order_relaxed);
+		stats.largePageFallbacks = s_largePageFallbacks.load(std::memory_order_relaxed);
+		stats.bytes = s_bytes.load(std::memory_order_relaxed);
+		return stats;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// CPU memory for allocator pages straight from the OS, in 2 MB pages where it can get them:
+// large pages on Windows (VirtualAlloc with MEM_LARGE_PAGES, after enabling the lock pages in
+// memory privilege, which the account must have been granted), hugetlbfs pages on Linux (mmap
+// with MAP_HUGETLB, which needs reserved huge pages) and otherwise transparent huge pages (a
+// 2 MB aligned mapping advised with MADV_HUGEPAGE). Anything else gets ordinary pages and
+// counts as a fallback, on Windows the first one is logged to the debugger.
+namespace PageMemory
+{
+	enum Kind
+	{
+		kDefault,
+		kLarge,
+		kTransparent
+	};
+
+	// pages and bytes mapped now, fallbacks so far
+	struct Stats
+	{
+		uint64_t defaultPages;
+		uint64_t largePages;
+		uint64_t transparentPages;
+		// requests for large pages that got something else
+		uint64_t largePageFallbacks;
+		uint64_t bytes;
+	};
+
+	const size_t kLargePageSize = 0x200000;
+
+	// Large pages are only tried for a multiple of kLargePageSize
+	void* Allocate(size_t size, bool preferLargePages, Kind& kind);
+	void Free(void* ptr, size_t size, Kind kind);
+	Stats GetStats();
+}
\ No newline at end of file
@@ -353,6 +353,22 @@ void PixelBuffer::CreateTextureResource(ID3D12Device* device, const std::wstring
 	m_usageState = D3D12_RESOURCE_STATE_COMMON;
 	m_gpuVirtualAddress = D3D12_GPU_VIRTUAL_ADDRESS_NULL;
 
+#ifndef RELEASE
+	m_pResource->SetName(name.c_str());
+#else
+	(Name);
+#endif
+}
+
+void PixelBuffer::CreatePlacedTextureResource(ID3D12Device* device, const std::wstring& name, const D3D12_RESOURCE_DESC& resourceDesc, D3D12_CLEAR_VALUE clearValue, ID3D12Heap* heap, uint64_t heapOffset)
+{
+	Destroy();
+
+	ThrowIfFailed(device->CreatePlacedResource(heap, heapOffset, &resourceDesc, D3D12_RESOURCE_STATE_COMMON, &clearValue, IID_PPV_ARGS(&m_pResource)));
+
+	m_usageState = D3D12_RESOURCE_STATE_COMMON;
+	m_gpuVirtualAddress = D3D12_GPU_VIRTUAL_ADDRESS_NULL;
+
 #ifndef RELEASE
 	m_pResource->SetName(name.c_str());
 #else
@@ -25,6 +25,9 @@ protected:
 
 	void CreateTextureResource(ID3D12Device* device, const std::wstring& name, const D3D12_RESOURCE_DESC& resourceDesc,
 		D3D12_CLEAR_VALUE clearValue, D3D12_GPU_VIRTUAL_ADDRESS vidMemPtr = D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN);
+	// At heapOffset in heap, in COMMON. Undefined until initialized, see CommandContext::DiscardResource
+	void CreatePlacedTextureResource(ID3D12Device* device, const std::wstring& name, const D3D12_RESOURCE_DESC& resourceDesc,
+		D3D12_CLEAR_VALUE clearValue, ID3D12Heap* heap, uint64_t heapOffset);
 
 	static DXGI_FORMAT GetBaseFormat(DXGI_FORMAT Format);
 	static DXGI_FORMAT GetUAVFormat(DXGI_FORMAT Format);
@@ -4,6 +4,7 @@
 #include "RootSignature.h"
 #include "PipelineState.h"
 #include "GpuBuffer.h"
+#include "FrameGraphExecutor.h"
 
 #include "CompiledShaders/ExtractLuma_CS.h"
 #include "CompiledShaders/GenerateHistogram_CS.h"
@@ -39,9 +40,9 @@ namespace PostProcess
 
 	ColorBuffer* SceneColorBuffer;
 
-	void UpdateExposure(ComputeContext&);
-	void ExtractLuma(ComputeContext&);
-	void ProcessHDR(ComputeContext&);
+	FrameGraphExecutor Graph;
+	// the settings and scene size Graph was built for, see Render
+	uint64_t GraphKey = ~0ull;
 }
 
 void PostProcess::Initialize(ColorBuffer* sceneBuffer)
@@ -104,96 +105,133 @@ void PostProcess::Shutdown()
 	HistogramBuffer.Destroy();
 	LumaLR.Destroy();
 	HistogramColorBuffer.Destroy();
+	Graph.Reset();
+	GraphKey = ~0ull;
 }
 
-void PostProcess::ExtractLuma(ComputeContext& context)
-{
-	context.TransitionResource(*SceneColorBuffer, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-	context.TransitionResource(LumaLR, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-	context.TransitionResource(ExposureBuffer, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-	context.SetConstants(0, 1.0f / LumaLR.GetWidth(), 1.0f / LumaLR.GetHeight());
-	context.SetDynamicDescriptor(1, 0, LumaLR.GetUAV());
-	context.SetDynamicDescriptor(2, 0, SceneColorBuffer->GetSRV());
-	context.SetDynamicDescriptor(2, 1, ExposureBuffer.GetSRV());
-	context.SetPipelineState(ExtractLumaPSO);
-	context.Dispatch2D(LumaLR.GetWidth(), LumaLR.GetHeight());
-}
-
-void PostProcess::UpdateExposure(ComputeContext& context)
+void PostProcess::Render()
 {
-	if (!EnableAdaptation)
+	// built and compiled once for the settings and the size of the scene
+	uint64_t key = (uint64_t)SceneColorBuffer->GetWidth() << 32 | (uint64_t)SceneColorBuffer->GetHeight() << 3 |
+		(EnableHDR ? 4 : 0) | (EnableAdaptation ? 2 : 0) | (DrawHistogram ? 1 : 0);
+	if (key != GraphKey)
 	{
-		float init_exposure[] =
-		{
-			Exposure, 1.0f / Exposure, Exposure, 0.0f,
-			kInitialMinLog, kInitialMaxLog, kInitialMaxLog - kInitialMinLog, 1.0f / (kInitialMaxLog - kInitialMinLog)
-		};
-		context.WriteBuffer(ExposureBuffer, 0, init_exposure, sizeof(init_exposure));
-		context.TransitionResource(ExposureBuffer, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-
-		return;
+		Graph.Reset();
+		DeclareGraph(Graph, EnableHDR, EnableAdaptation, DrawHistogram);
+		GraphKey = key;
 	}
 
-	context.TransitionResource(HistogramBuffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, true);
-	context.ClearUAV(HistogramBuffer);
-	context.TransitionResource(LumaLR, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-	context.SetDynamicDescriptor(1, 0, HistogramBuffer.GetUAV());
-	context.SetDynamicDescriptor(2, 0, LumaLR.GetSRV());
-	context.SetPipelineState(GenerateHistogramPSO);
-	context.Dispatch2D(LumaLR.GetWidth(), LumaLR.GetHeight(), 16, 384);
-
-	context.TransitionResource(HistogramBuffer, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-	context.TransitionResource(ExposureBuffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-	context.SetDynamicDescriptor(1, 0, ExposureBuffer.GetUAV());
-	context.SetDynamicDescriptor(2, 0, HistogramBuffer.GetSRV());
-	context.SetDynamicConstantBufferView(3, sizeof(ExposureCB), &ExposureCB);
-	context.SetPipelineState(AdaptExposurePSO);
-	context.Dispatch();
-	context.TransitionResource(ExposureBuffer, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+	ComputeContext& context = ComputeContext::Begin();
+	context.SetRootSignature(PostProcessRS);
+	Graph.Execute(context);
+	context.Finish();
 }
 
-void PostProcess::ProcessHDR(ComputeContext& context)
+void PostProcess::DeclareGraph(FrameGraphExecutor& graph, bool hdr, bool adaptation, bool drawHistogram)
 {
-	if (EnableAdaptation)
+	// The barriers come from what each pass declares, see FrameGraph
+	const D3D12_RESOURCE_STATES uav = D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+	const D3D12_RESOURCE_STATES srv = D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
+	FrameGraph::Handle scene_color = graph.Import(*SceneColorBuffer, "Scene Color");
+	FrameGraph::Handle exposure = graph.Import(ExposureBuffer, "Exposure", srv);
+	FrameGraph::Handle histogram = graph.Import(HistogramBuffer, "Histogram", FrameGraph::kKeepState, false);
+	FrameGraph::Handle luma = graph.Import(LumaLR, "Luma LR", FrameGraph::kKeepState, false);
+	FrameGraph::Handle histogram_color = graph.Import(HistogramColorBuffer, "Histogram Color", D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+	FrameGraph::Handle pass;
+
+	if (hdr)
 	{
-		ExtractLuma(context);
-	}
-
-	// assert uav load support R11G11B10_FLOAT
-	context.TransitionResource(*SceneColorBuffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-	//context.TransitionResource(LumaBuffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-	context.TransitionResource(ExposureBuffer, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-	context.SetPipelineState(ToneMapPSO);
-	context.SetConstants(0, 1.0f / SceneColorBuffer->GetWidth(), 1.0f / SceneColorBuffer->GetHeight());
-	context.SetDynamicDescriptor(1, 0, SceneColorBuffer->GetUAV());
-	context.SetDynamicDescriptor(2, 0, ExposureBuffer.GetSRV());
-	context.Dispatch2D(SceneColorBuffer->GetWidth(), SceneColorBuffer->GetHeight());
-
-	UpdateExposure(context);
-}
+		if (adaptation)
+		{
+			pass = graph.AddPass("Extract Luma", [](CommandContext& commandContext)
+			{
+				ComputeContext& context = commandContext.GetComputeContext();
+				context.SetConstants(0, 1.0f / LumaLR.GetWidth(), 1.0f / LumaLR.GetHeight());
+				context.SetDynamicDescriptor(1, 0, LumaLR.GetUAV());
+				context.SetDynamicDescriptor(2, 0, SceneColorBuffer->GetSRV());
+				context.SetDynamicDescriptor(2, 1, ExposureBuffer.GetSRV());
+				context.SetPipelineState(ExtractLumaPSO);
+				context.Dispatch2D(LumaLR.GetWidth(), LumaLR.GetHeight());
+			});
+			graph.Read(pass, scene_color, srv);
+			graph.Read(pass, exposure, srv);
+			graph.Write(pass, luma, uav);
+		}
 
-void PostProcess::Render()
-{
-	ComputeContext& context = ComputeContext::Begin();
+		// assert uav load support R11G11B10_FLOAT
+		pass = graph.AddPass("Tone Map", [](CommandContext& commandContext)
+		{
+			ComputeContext& context = commandContext.GetComputeContext();
+			context.SetPipelineState(ToneMapPSO);
+			context.SetConstants(0, 1.0f / SceneColorBuffer->GetWidth(), 1.0f / SceneColorBuffer->GetHeight());
+			context.SetDynamicDescriptor(1, 0, SceneColorBuffer->GetUAV());
+			context.SetDynamicDescriptor(2, 0, ExposureBuffer.GetSRV());
+			context.Dispatch2D(SceneColorBuffer->GetWidth(), SceneColorBuffer->GetHeight());
+		});
+		graph.Read(pass, exposure, srv);
+		graph.Write(pass, scene_color, uav);
+
+		if (!adaptation)
+		{
+			pass = graph.AddPass("Reset Exposure", [](CommandContext& context)
+			{
+				float init_exposure[] =
+				{
+					Exposure, 1.0f / Exposure, Exposure, 0.0f,
+					kInitialMinLog, kInitialMaxLog, kInitialMaxLog - kInitialMinLog, 1.0f / (kInitialMaxLog - kInitialMinLog)
+				};
+				context.WriteBuffer(ExposureBuffer, 0, init_exposure, sizeof(init_exposure));
+			});
+			graph.Write(pass, exposure, D3D12_RESOURCE_STATE_COPY_DEST);
+		}
+		else
+		{
+			pass = graph.AddPass("Clear Histogram", [](CommandContext& commandContext)
+			{
+				commandContext.GetComputeContext().ClearUAV(HistogramBuffer);
+			});
+			graph.Write(pass, histogram, uav);
 
-	context.SetRootSignature(PostProcessRS);
-	if (EnableHDR)
-		ProcessHDR(context);
+			pass = graph.AddPass("Generate Histogram", [](CommandContext& commandContext)
+			{
+				ComputeContext& context = commandContext.GetComputeContext();
+				context.SetDynamicDescriptor(1, 0, HistogramBuffer.GetUAV());
+				context.SetDynamicDescriptor(2, 0, LumaLR.GetSRV());
+				context.SetPipelineState(GenerateHistogramPSO);
+				context.Dispatch2D(LumaLR.GetWidth(), LumaLR.GetHeight(), 16, 384);
+			});
+			graph.Read(pass, luma, srv);
+			graph.Write(pass, histogram, uav);
+
+			pass = graph.AddPass("Adapt Exposure", [](CommandContext& commandContext)
+			{
+				ComputeContext& context = commandContext.GetComputeContext();
+				context.SetDynamicDescriptor(1, 0, ExposureBuffer.GetUAV());
+				context.SetDynamicDescriptor(2, 0, HistogramBuffer.GetSRV());
+				context.SetDynamicConstantBufferView(3, sizeof(ExposureCB), &ExposureCB);
+				context.SetPipelineState(AdaptExposurePSO);
+				context.Dispatch();
+			});
+			graph.Read(pass, histogram, srv);
+			graph.Write(pass, exposure, uav);
+		}
+	}
 
-	if (DrawHistogram)
+	if (drawHistogram)
 	{
-		context.SetPipelineState(DrawHistogramPSO);
-		context.TransitionResource(HistogramColorBuffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-		context.TransitionResource(HistogramBuffer, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-		context.TransitionResource(ExposureBuffer, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-		context.SetDynamicDescriptor(1, 0, HistogramColorBuffer.GetUAV());
-		context.SetDynamicDescriptor(2, 0, HistogramBuffer.GetSRV());
-		context.SetDynamicDescriptor(2, 1, ExposureBuffer.GetSRV());
-		context.Dispatch(1, 32);
-		context.TransitionResource(HistogramColorBuffer, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+		pass = graph.AddPass("Draw Histogram", [](CommandContext& commandContext)
+		{
+			ComputeContext& context = commandContext.GetComputeContext();
+			context.SetPipelineState(DrawHistogramPSO);
+			context.SetDynamicDescriptor(1, 0, HistogramColorBuffer.GetUAV());
+			context.SetDynamicDescriptor(2, 0, HistogramBuffer.GetSRV());
+			context.SetDynamicDescriptor(2, 1, ExposureBuffer.GetSRV());
+			context.Dispatch(1, 32);
+		});
+		graph.Read(pass, histogram, srv);
+		graph.Read(pass, exposure, srv);
+		graph.Write(pass, histogram_color, uav);
 	}
-
-	context.Finish();
 }
 
 void PostProcess::UpdateUI(bool* showUI)
@@ -225,6 +263,11 @@ void PostProcess::UpdateUI(bool* showUI)
 			}
 
 		}
+		if (ImGui::TreeNode("Post Process Barriers"))
+		{
+			ImGui::TextUnformatted(Graph.GetGraph().DumpSchedule().c_str());
+			ImGui::TreePop();
+		}
 		ImGui::End();
 	}
 }
\ No newline at end of file
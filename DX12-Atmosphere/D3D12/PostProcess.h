@@ -2,6 +2,7 @@
 #include "stdafx.h"
 
 class ColorBuffer;
+class FrameGraphExecutor;
 
 namespace PostProcess
 {
@@ -26,7 +27,10 @@ namespace PostProcess
 	extern ColorBuffer HistogramColorBuffer;
 
 	void Initialize(ColorBuffer* sceneBuffer);
+	// Records the passes of the settings, declared again only when they or the scene size change
 	void Render();
+	// The passes Render records for these settings
+	void DeclareGraph(FrameGraphExecutor& graph, bool hdr, bool adaptation, bool drawHistogram);
 	void UpdateUI(bool* showUI);
 	void Shutdown();
 }
\ No newline at end of file
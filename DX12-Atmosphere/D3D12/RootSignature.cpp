@@ -76,6 +76,10 @@ void RootSignature::Finalize(const std::wstring& name, D3D12_ROOT_SIGNATURE_FLAG
 		{
 			assert(rootParam.DescriptorTable.pDescriptorRanges != nullptr);
 
+			// unbounded ranges are bindless tables, the context binds the heap start itself
+			if (rootParam.DescriptorTable.pDescriptorRanges->NumDescriptors == UINT_MAX)
+				continue;
+
 			if (rootParam.DescriptorTable.pDescriptorRanges->RangeType == D3D12_DESCRIPTOR_RANGE_TYPE_SAMPLER)
 				m_samplerTableBitMap |= (1 << param);
 			else
@@ -46,6 +46,21 @@ public:
 		range->RegisterSpace = space;
 		range->OffsetInDescriptorsFromTableStart = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND;
 	}
+
+	// A table over the whole BindlessHeap, bound with SetBindlessTable instead of the dynamic
+	// descriptors. Each range views every descriptor from the heap start, one register space
+	// per texture type the shader declares an unbounded array of.
+	void InitAsBindlessTable(UINT numDescriptorRanges, D3D12_SHADER_VISIBILITY visibility = D3D12_SHADER_VISIBILITY_ALL)
+	{
+		InitAsDescriptorTable(numDescriptorRanges, visibility);
+	}
+
+	void SetBindlessRange(UINT rangeIndex, UINT space)
+	{
+		SetTableRange(rangeIndex, D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 0, UINT_MAX, space);
+		D3D12_DESCRIPTOR_RANGE* range = const_cast<D3D12_DESCRIPTOR_RANGE*>(DescriptorTable.pDescriptorRanges + rangeIndex);
+		range->OffsetInDescriptorsFromTableStart = 0;
+	}
 };
 
 class RootSignature
@@ -105,7 +120,7 @@ private:
 	uint32_t m_numParameters;
 	uint32_t m_numSamplers;
 	uint32_t m_numInitializedStaticSamplers;
-	// One bit is set for root parameters that are non-sampler descriptor tables
+	// One bit is set for root parameters that are non-sampler descriptor tables, bindless tables excluded
 	uint32_t m_descriptorTableBitMap;
 	// One bit is set for root parameters that are sampler descriptor tables
 	uint32_t m_samplerTableBitMap;
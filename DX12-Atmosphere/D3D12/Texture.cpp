@@ -31,9 +31,10 @@ void Texture2D::Create(size_t pitch, size_t width, size_t height, DXGI_FORMAT fo
 
 	CommandContext::InitializeTexture(*this, 1, &texResource);
 
-	if (m_cpuHandle.ptr == D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN)
-		m_cpuHandle = AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-	g_Device->CreateShaderResourceView(m_pResource.Get(), nullptr, m_cpuHandle);
+	if (!*this)
+		m_cpuHandle = AllocateDescriptorHandle(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+	g_Device->CreateShaderResourceView(m_pResource.Get(), nullptr, GetSRV());
+	RefreshDescriptor(GetSRV());
 }
 
 void Texture2D::CreateTGAFromMemory(const void* _filePtr, size_t fileSize, bool sRGB)
@@ -88,16 +89,19 @@ void Texture2D::CreateTGAFromMemory(const void* _filePtr, size_t fileSize, bool
 
 bool Texture2D::CreateDDSFromMemory(const void* filePtr, size_t fileSize, bool sRGB)
 {
-	if (m_cpuHandle.ptr == D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN)
-		m_cpuHandle = AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+	if (!*this)
+		m_cpuHandle = AllocateDescriptorHandle(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 	
 	auto header = reinterpret_cast<const DDS_HEADER*>((const uint8_t*)filePtr + sizeof(uint32_t));
 	m_height = header->height;
 	m_width = header->width;
 
-	HRESULT hr = CreateDDSTextureFromMemory(g_Device, (const uint8_t*)filePtr, fileSize, 0, sRGB, &m_pResource, m_cpuHandle);
+	HRESULT hr = CreateDDSTextureFromMemory(g_Device, (const uint8_t*)filePtr, fileSize, 0, sRGB, &m_pResource, GetSRV());
+	if (FAILED(hr))
+		return false;
+	RefreshDescriptor(GetSRV());
 
-	return SUCCEEDED(hr);
+	return true;
 }
 
 void Texture3D::Create(size_t pitch, size_t width, size_t height, size_t depth, DXGI_FORMAT format, const void* initData)
@@ -123,9 +127,10 @@ void Texture3D::Create(size_t pitch, size_t width, size_t height, size_t depth,
 
 	CommandContext::InitializeTexture(*this, 1, &texResource);
 	
-	if (m_cpuHandle.ptr == D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN)
-		m_cpuHandle = AllocateDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-	g_Device->CreateShaderResourceView(m_pResource.Get(), nullptr, m_cpuHandle);
+	if (!*this)
+		m_cpuHandle = AllocateDescriptorHandle(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+	g_Device->CreateShaderResourceView(m_pResource.Get(), nullptr, GetSRV());
+	RefreshDescriptor(GetSRV());
 }
 
 void Texture3D::CreateTGAFromMemory(const void* _filePtr, size_t fileSize, uint16_t numSliceX, uint16_t numSliceY, bool sRGB)
@@ -1,25 +1,40 @@
 #pragma once
 #include "stdafx.h"
 #include "GpuResource.h"
+#include "BindlessHeap.h"
 
 class Texture : public GpuResource
 {
 	//friend class TextureManager;
 public:
 	Texture(const std::wstring& name) 
-		: m_textureName(name), m_isValid(true), m_width(0), m_height(0), m_depth(1)
+		: m_textureName(name), m_isValid(true), m_width(0), m_height(0), m_depth(1), m_cpuHandle()
 	{ 
-		m_cpuHandle.ptr = D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN; 
+		m_externalHandle.ptr = D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN;
 	}
 
+	~Texture()
+	{
+		FreeDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, m_cpuHandle);
+	}
+
+	// The next Create allocates a new SRV
 	virtual void Destroy() override
 	{
 		GpuResource::Destroy();
-		m_cpuHandle.ptr = 0;
+		FreeDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, m_cpuHandle);
+		m_externalHandle.ptr = D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN;
 	}
 
-	const D3D12_CPU_DESCRIPTOR_HANDLE& GetSRV() const { return m_cpuHandle; }
-	bool operator!() { return m_cpuHandle.ptr == 0; }
+	D3D12_CPU_DESCRIPTOR_HANDLE GetSRV() const
+	{
+		if (m_externalHandle.ptr != D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN)
+			return m_externalHandle;
+		return GetDescriptor(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV, m_cpuHandle);
+	}
+	// The slot of the SRV in the BindlessHeap, the same until the view is created again
+	uint32_t GetBindlessSRV() const { return BindlessHeap::Register(GetSRV()); }
+	bool operator!() { return GetSRV().ptr == D3D12_GPU_VIRTUAL_ADDRESS_UNKNOWN; }
 	bool isValid() const { return m_isValid; }
 
 protected:
@@ -28,7 +43,9 @@ protected:
 	uint32_t m_depth;
 	std::wstring m_textureName;
 	bool m_isValid;
-	D3D12_CPU_DESCRIPTOR_HANDLE m_cpuHandle;
+	// a view someone else allocated, not freed here
+	D3D12_CPU_DESCRIPTOR_HANDLE m_externalHandle;
+	DescriptorFreeList::Handle m_cpuHandle;
 };
 
 class Texture2D : public Texture
@@ -37,7 +54,7 @@ class Texture2D : public Texture
 	//friend class TextureManager;
 public:
 	Texture2D(const std::wstring& name) : Texture(name) { }
-	Texture2D(D3D12_CPU_DESCRIPTOR_HANDLE handle) : Texture(L"") { m_cpuHandle = handle; }
+	Texture2D(D3D12_CPU_DESCRIPTOR_HANDLE handle) : Texture(L"") { m_externalHandle = handle; }
 
 
 	uint32_t GetWidth() const { return m_width; }
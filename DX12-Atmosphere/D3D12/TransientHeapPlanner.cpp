@@ -0,0 +1,175 @@
+#include "stdafx.h"
+#include "TransientHeapPlanner.h"
+#include <algorithm>
+#include <cassert>
+#include <sstream>
+
+namespace
+{
+	uint64_t AlignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+}
+
+TransientHeapPlanner::TransientHeapPlanner(uint64_t maxHeapSize /* = 0 */) : m_maxHeapSize(maxHeapSize), m_stats()
+{
+}
+
+TransientHeapPlanner::Handle TransientHeapPlanner::AddResource(const std::string& name, uint64_t size, uint64_t alignment, uint32_t first, uint32_t last)
+{
+	assert(alignment != 0 && (alignment & (alignment - 1)) == 0 && first <= last);
+	m_resources.push_back({ name, size, alignment, first, last });
+	return (Handle)m_resources.size() - 1;
+}
+
+bool TransientHeapPlanner::AddResource(const FrameGraph& graph, FrameGraph::Handle resource, uint64_t size, uint64_t alignment, Handle& handle)
+{
+	uint32_t first, last;
+	if (!graph.GetLifetime(resource, first, last))
+		return false;
+	handle = AddResource(graph.GetResourceName(resource), size, alignment, first, last);
+	return true;
+}
+
+uint64_t TransientHeapPlanner::FindOffset(const Heap& heap, Handle resource) const
+{
+	// what is alive at the same time, by offset
+	std::vector<Handle> blocks;
+	for (Handle placed : heap.resources)
+	{
+		if (LifetimesOverlap(placed, resource))
+			blocks.push_back(placed);
+	}
+	std::sort(blocks.begin(), blocks.end(), [this](Handle a, Handle b) { return m_placements[a].offset < m_placements[b].offset; });
+
+	const Resource& r = m_resources[resource];
+	uint64_t offset = 0;
+	for (Handle block : blocks)
+	{
+		if (AlignUp(offset, r.alignment) + r.size <= m_placements[block].offset)
+			break;
+		offset = std::max(offset, m_placements[block].offset + m_resources[block].size);
+	}
+	offset = AlignUp(offset, r.alignment);
+	if (m_maxHeapSize != 0 && offset + r.size > m_maxHeapSize)
+		return ~0ull;
+	return offset;
+}
+
+void TransientHeapPlanner::Plan()
+{
+	const uint32_t num_resources = (uint32_t)m_resources.size();
+	m_placements.assign(num_resources, Placement());
+	m_aliases.assign(num_resources, std::vector<Handle>());
+	m_heaps.clear();
+	m_stats = Stats();
+
+	std::vector<Handle> order(num_resources);
+	for (Handle r = 0; r < num_resources; ++r)
+		order[r] = r;
+	// the large ones first, they leave gaps the small ones fill
+	std::sort(order.begin(), order.end(), [this](Handle a, Handle b)
+	{
+		const Resource& ra = m_resources[a];
+		const Resource& rb = m_resources[b];
+		if (ra.size != rb.size)
+			return ra.size > rb.size;
+		if (ra.first != rb.first)
+			return ra.first < rb.first;
+		return a < b;
+	});
+
+	for (Handle r : order)
+	{
+		uint32_t heap = 0;
+		uint64_t offset = ~0ull;
+		for (; heap < m_heaps.size(); ++heap)
+		{
+			offset = FindOffset(m_heaps[heap], r);
+			if (offset != ~0ull)
+				break;
+		}
+		if (heap == m_heaps.size())
+		{
+			m_heaps.push_back({ 0, 1, {} });
+			offset = 0;
+		}
+		m_placements[r] = { heap, offset };
+		Heap& h = m_heaps[heap];
+		h.resources.push_back(r);
+		h.size = std::max(h.size, offset + m_resources[r].size);
+		h.alignment = std::max(h.alignment, m_resources[r].alignment);
+	}
+
+	for (Handle r = 0; r < num_resources; ++r)
+	{
+		const Placement& p = m_placements[r];
+		for (Handle q : m_heaps[p.heap].resources)
+		{
+			const Placement& other = m_placements[q];
+			bool memory_overlaps = p.offset < other.offset + m_resources[q].size && other.offset < p.offset + m_resources[r].size;
+			if (q != r && memory_overlaps && m_resources[q].last < m_resources[r].first)
+				m_aliases[r].push_back(q);
+		}
+		std::sort(m_aliases[r].begin(), m_aliases[r].end(), [this](Handle a, Handle b) { return m_resources[a].last < m_resources[b].last; });
+		m_stats.aliased += m_aliases[r].empty() ? 0 : 1;
+		m_stats.summedBytes += m_resources[r].size;
+	}
+	for (const Heap& heap : m_heaps)
+		m_stats.heapBytes += heap.size;
+	m_stats.resources = num_resources;
+	m_stats.heaps = (uint32_t)m_heaps.size();
+	m_stats.peakBytes = ComputePeakBytes();
+}
+
+uint64_t TransientHeapPlanner::ComputePeakBytes() const
+{
+	// +size at the first use, -size after the last, the ends of a position before its starts
+	std::vector<std::pair<uint64_t, int64_t>> events;
+	for (const Resource& r : m_resources)
+	{
+		events.push_back({ (uint64_t)r.first * 2 + 1, (int64_t)r.size });
+		events.push_back({ ((uint64_t)r.last + 1) * 2, -(int64_t)r.size });
+	}
+	std::sort(events.begin(), events.end());
+	int64_t alive = 0, peak = 0;
+	for (const auto& e : events)
+	{
+		alive += e.second;
+		peak = std::max(peak, alive);
+	}
+	return (uint64_t)peak;
+}
+
+std::string TransientHeapPlanner::DumpPlan() const
+{
+	std::ostringstream out;
+	for (uint32_t h = 0; h < m_heaps.size(); ++h)
+	{
+		out << "heap " << h << ": " << m_heaps[h].size << " bytes\n";
+		std::vector<Handle> resources(m_heaps[h].resources);
+		std::sort(resources.begin(), resources.end(), [this](Handle a, Handle b) { return m_placements[a].offset < m_placements[b].offset; });
+		for (Handle r : resources)
+		{
+			const Resource& resource = m_resources[r];
+			out << "  " << resource.name << " at " << m_placements[r].offset << ", " << resource.size << " bytes, passes "
+				<< resource.first << " to " << resource.last;
+			if (!m_aliases[r].empty())
+				out << ", aliases " << m_resources[m_aliases[r].back()].name;
+			out << "\n";
+		}
+	}
+	out << m_stats.resources << " resources in " << m_stats.heaps << " heaps: " << m_stats.heapBytes << " bytes, peak "
+		<< m_stats.peakBytes << ", summed " << m_stats.summedBytes << "\n";
+	return out.str();
+}
+
+void TransientHeapPlanner::Reset()
+{
+	m_resources.clear();
+	m_placements.clear();
+	m_aliases.clear();
+	m_heaps.clear();
+	m_stats = Stats();
+}
\ No newline at end of file
@@ -0,0 +1,97 @@
+#pragma once
+#include "FrameGraph.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Places resources that only live for part of a pass list in shared heaps. Two resources
+// can share memory when their lifetimes, the first and last position a pass uses them at,
+// don't overlap. Plan takes the resources largest first and puts each at the lowest aligned
+// offset of the first heap where it overlaps nothing alive at the same time, in a new heap
+// when none has room: first fit colouring of the interval graph, with offsets for colours.
+// A resource placed over memory an earlier one used starts out undefined, see GetAliases.
+class TransientHeapPlanner
+{
+public:
+	typedef uint32_t Handle;
+
+	struct Placement
+	{
+		uint32_t heap;
+		uint64_t offset;
+	};
+
+	struct Stats
+	{
+		uint32_t resources;
+		uint32_t heaps;
+		// each in its own allocation
+		uint64_t summedBytes;
+		// the most bytes alive at one position, no placement takes less
+		uint64_t peakBytes;
+		// the heaps together
+		uint64_t heapBytes;
+		// placed over memory an earlier resource used
+		uint32_t aliased;
+	};
+
+	// 0 puts everything in one heap, a resource larger than maxHeapSize gets a heap its size
+	explicit TransientHeapPlanner(uint64_t maxHeapSize = 0);
+
+	// Used by the passes at positions first to last, alignment a power of 2
+	Handle AddResource(const std::string& name, uint64_t size, uint64_t alignment, uint32_t first, uint32_t last);
+	// The lifetime from a compiled graph, false and nothing added if no scheduled pass uses it
+	bool AddResource(const FrameGraph& graph, FrameGraph::Handle resource, uint64_t size, uint64_t alignment, Handle& handle);
+
+	void Plan();
+
+	const Placement& GetPlacement(Handle resource) const { return m_placements[resource]; }
+	uint32_t GetNumHeaps() const { return (uint32_t)m_heaps.size(); }
+	uint64_t GetHeapSize(uint32_t heap) const { return m_heaps[heap].size; }
+	// the largest alignment of what is placed in it
+	uint64_t GetHeapAlignment(uint32_t heap) const { return m_heaps[heap].alignment; }
+	// The resources whose memory this one overlaps, all done before it is first used, by
+	// their last use. It needs an aliasing barrier before its first use, which must write all
+	// of it or discard it.
+	const std::vector<Handle>& GetAliases(Handle resource) const { return m_aliases[resource]; }
+	const std::string& GetResourceName(Handle resource) const { return m_resources[resource].name; }
+	Stats GetStats() const { return m_stats; }
+
+	// The heaps and what is placed in each, one line each
+	std::string DumpPlan() const;
+
+	// Forgets every resource, keeps maxHeapSize
+	void Reset();
+
+private:
+	struct Resource
+	{
+		std::string name;
+		uint64_t size;
+		uint64_t alignment;
+		uint32_t first;
+		uint32_t last;
+	};
+
+	struct Heap
+	{
+		uint64_t size;
+		uint64_t alignment;
+		std::vector<Handle> resources;
+	};
+
+	bool LifetimesOverlap(Handle a, Handle b) const
+	{
+		return m_resources[a].first <= m_resources[b].last && m_resources[b].first <= m_resources[a].last;
+	}
+	// the lowest offset in heap free for resource, or ~0ull if it doesn't fit
+	uint64_t FindOffset(const Heap& heap, Handle resource) const;
+	uint64_t ComputePeakBytes() const;
+
+	uint64_t m_maxHeapSize;
+	std::vector<Resource> m_resources;
+	std::vector<Placement> m_placements;
+	std::vector<std::vector<Handle>> m_aliases;
+	std::vector<Heap> m_heaps;
+	Stats m_stats;
+};
\ No newline at end of file
@@ -0,0 +1,181 @@
+#include "stdafx.h"
+#include "TransientHeapPlannerBenchmark.h"
+#include "TransientHeapPlanner.h"
+#include "FrameGraphBenchmark.h"
+#include "Math/Random.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+using Math::RandomNumberGenerator;
+
+namespace
+{
+	struct Declared
+	{
+		uint64_t size;
+		uint64_t alignment;
+		uint32_t first;
+		uint32_t last;
+	};
+
+	void Validate(const TransientHeapPlanner& planner, const std::vector<Declared>& declared, uint64_t maxHeapSize,
+		TransientHeapPlannerBenchmark::Result& result)
+	{
+		const uint32_t num_resources = (uint32_t)declared.size();
+		std::vector<uint32_t> per_heap(planner.GetNumHeaps(), 0);
+		for (uint32_t a = 0; a < num_resources; ++a)
+		{
+			const TransientHeapPlanner::Placement& pa = planner.GetPlacement(a);
+			const Declared& da = declared[a];
+			++per_heap[pa.heap];
+			result.violations.Add("placement", pa.offset % da.alignment != 0 || pa.offset + da.size > planner.GetHeapSize(pa.heap) ||
+				planner.GetHeapAlignment(pa.heap) % da.alignment != 0);
+
+			std::vector<TransientHeapPlanner::Handle> aliases;
+			for (uint32_t b = 0; b < num_resources; ++b)
+			{
+				const TransientHeapPlanner::Placement& pb = planner.GetPlacement(b);
+				const Declared& db = declared[b];
+				bool memory_overlaps = b != a && pa.heap == pb.heap && pa.offset < pb.offset + db.size && pb.offset < pa.offset + da.size;
+				if (!memory_overlaps)
+					continue;
+				result.violations.Add("overlap", da.first <= db.last && db.first <= da.last);
+				if (db.last < da.first)
+					aliases.push_back(b);
+			}
+			std::vector<TransientHeapPlanner::Handle> planned(planner.GetAliases(a));
+			std::sort(planned.begin(), planned.end());
+			result.violations.Add("alias", aliases != planned);
+		}
+		for (uint32_t h = 0; h < planner.GetNumHeaps(); ++h)
+			result.violations.Add("placement", maxHeapSize != 0 && planner.GetHeapSize(h) > maxHeapSize && per_heap[h] != 1);
+
+		TransientHeapPlanner::Stats stats = planner.GetStats();
+		result.violations.Add("bound", stats.heapBytes < stats.peakBytes || stats.heapBytes > stats.summedBytes + (uint64_t)num_resources * (4 << 20));
+	}
+
+	// The plan run as transients of graph, resource r its resource r: each gets an aliasing
+	// barrier from each of its aliases before its first pass, or one from any resource
+	void ValidateAliasing(FrameGraph& graph, const TransientHeapPlanner& planner, uint32_t numResources,
+		TransientHeapPlannerBenchmark::Result& result)
+	{
+		for (FrameGraph::Handle r = 0; r < numResources; ++r)
+			graph.SetTransient(r, planner.GetAliases(r));
+		graph.Compile();
+		FrameGraphBenchmark::AddViolations(graph.Verify(), result.violations);
+		result.aliasingBarriers += graph.GetStats().aliasingBarriers;
+
+		for (FrameGraph::Handle r = 0; r < numResources; ++r)
+		{
+			uint32_t first, last;
+			if (!graph.GetLifetime(r, first, last))
+			{
+				result.violations.Add("aliasing", 1);
+				continue;
+			}
+			std::vector<FrameGraph::Handle> expected(planner.GetAliases(r));
+			if (expected.empty())
+				expected.push_back(FrameGraph::kNoResource);
+			std::vector<FrameGraph::Handle> emitted;
+			for (const FrameGraph::Barrier& barrier : graph.GetBarriers(first))
+			{
+				if (barrier.type == FrameGraph::kAliasing && barrier.resource == r)
+					emitted.push_back(barrier.aliased);
+			}
+			std::sort(expected.begin(), expected.end());
+			std::sort(emitted.begin(), emitted.end());
+			result.violations.Add("aliasing", expected != emitted);
+		}
+	}
+}
+
+TransientHeapPlannerBenchmark::Desc TransientHeapPlannerBenchmark::DefaultDesc()
+{
+	Desc desc;
+	desc.numPlans = 2000;
+	desc.numResources = 32;
+	desc.numPositions = 40;
+	desc.maxLifetime = 12;
+	desc.maxSize = 64 << 20;
+	desc.maxHeapSize = 256 << 20;
+	desc.seed = 1;
+	return desc;
+}
+
+TransientHeapPlannerBenchmark::Result TransientHeapPlannerBenchmark::Run(const Desc& desc)
+{
+	const uint64_t kPageSize = 64 << 10;
+	Result result = {};
+	RandomNumberGenerator rng(desc.seed);
+	TransientHeapPlanner planner(desc.maxHeapSize);
+	FrameGraph graph;
+	std::vector<Declared> declared;
+	double seconds = 0.0;
+	for (uint32_t n = 0; n < desc.numPlans; ++n)
+	{
+		planner.Reset();
+		graph.Reset();
+		declared.clear();
+		const uint32_t num_positions = std::max(desc.numPositions, 1u);
+		const uint64_t max_pages = std::max(desc.maxSize / kPageSize, (uint64_t)1);
+		for (uint32_t r = 0; r < desc.numResources; ++r)
+		{
+			Declared d;
+			d.size = (1 + rng.NextUInt() % max_pages) * kPageSize;
+			d.alignment = rng.NextUInt() % 8 == 0 ? 4 << 20 : kPageSize;
+			d.first = rng.NextUInt() % num_positions;
+			d.last = std::min(d.first + (uint32_t)(rng.NextUInt() % std::max(desc.maxLifetime, 1u)), num_positions - 1);
+			graph.AddResource("r" + std::to_string(r), FrameGraph::kCommon, FrameGraph::kKeepState, false);
+			declared.push_back(d);
+		}
+		// a pass at each position writes the resources that start there and reads the ones
+		// alive, and a result of its own so that none is culled
+		for (uint32_t position = 0; position < num_positions; ++position)
+		{
+			FrameGraph::Handle pass = graph.AddPass("p" + std::to_string(position));
+			graph.Write(pass, graph.AddResource("out" + std::to_string(position), FrameGraph::kCommon), FrameGraph::kUnorderedAccess);
+			for (uint32_t r = 0; r < desc.numResources; ++r)
+			{
+				if (declared[r].first == position)
+					graph.Write(pass, r, rng.NextUInt() % 2 ? FrameGraph::kUnorderedAccess : FrameGraph::kRenderTarget);
+				else if (declared[r].first < position && position <= declared[r].last)
+					graph.Read(pass, r, FrameGraph::kNonPixelShaderResource);
+			}
+		}
+		graph.Compile();
+		for (uint32_t r = 0; r < desc.numResources; ++r)
+		{
+			TransientHeapPlanner::Handle handle;
+			bool added = planner.AddResource(graph, r, declared[r].size, declared[r].alignment, handle);
+			result.violations.Add("aliasing", !added || handle != r);
+		}
+
+		auto start = std::chrono::high_resolution_clock::now();
+		planner.Plan();
+		seconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+		TransientHeapPlanner::Stats stats = planner.GetStats();
+		result.summedBytes += stats.summedBytes;
+		result.peakBytes += stats.peakBytes;
+		result.heapBytes += stats.heapBytes;
+		result.heaps += stats.heaps;
+		result.aliased += stats.aliased;
+		Validate(planner, declared, desc.maxHeapSize, result);
+		ValidateAliasing(graph, planner, desc.numResources, result);
+	}
+	result.seconds = seconds;
+	result.plansPerSecond = desc.numPlans / std::max(seconds, 1e-9);
+	return result;
+}
+
+std::string TransientHeapPlannerBenchmark::Summarize(const Result& result)
+{
+	char line[256];
+	snprintf(line, sizeof(line), "%.0f plans / s, heaps %.2f of the peak and %.2f of the summed bytes, %llu aliased, %llu aliasing barriers",
+		result.plansPerSecond, (double)result.heapBytes / std::max(result.peakBytes, (uint64_t)1),
+		(double)result.heapBytes / std::max(result.summedBytes, (uint64_t)1), (unsigned long long)result.aliased,
+		(unsigned long long)result.aliasingBarriers);
+	return line;
+}
\ No newline at end of file
@@ -0,0 +1,51 @@
+#pragma once
+#include "Utils/SelfTest.h"
+#include <cstdint>
+#include <string>
+
+// TransientHeapPlanner on random pass lists: numResources resources over numPositions
+// passes, each alive for 1 to maxLifetime passes, sized a 64KB multiple up to maxSize and
+// aligned to 64KB or 4MB like D3D12 textures. Every plan is checked:
+// - no two resources alive at the same time share a byte of a heap
+// - every offset is aligned, every resource inside its heap, no heap over maxHeapSize
+//   unless it holds a single larger resource
+// - the aliases of a resource are exactly the ones before it in the memory it takes
+// - the heaps take at least the peak, at most the summed bytes
+// The lifetimes come from a FrameGraph with a pass at each position, the resources
+// transient with the aliases of the plan, and its compiled schedule is checked too:
+// - before its first pass a resource gets an aliasing barrier from each of its aliases, or
+//   one from any resource if it has none, see FrameGraph::Verify for the rest
+class TransientHeapPlannerBenchmark
+{
+public:
+	struct Desc
+	{
+		uint32_t numPlans;
+		uint32_t numResources;
+		uint32_t numPositions;
+		uint32_t maxLifetime;
+		uint64_t maxSize;
+		// 0 for one heap
+		uint64_t maxHeapSize;
+		uint32_t seed;
+	};
+
+	struct Result
+	{
+		double seconds;
+		double plansPerSecond;
+		uint64_t summedBytes;
+		uint64_t peakBytes;
+		uint64_t heapBytes;
+		uint64_t heaps;
+		uint64_t aliased;
+		uint64_t aliasingBarriers;
+		// "overlap", "placement", "alias", "bound" and "aliasing" by the checks above, and
+		// the counts of FrameGraph::Verify, see FrameGraphBenchmark
+		SelfTest::Violations violations;
+	};
+
+	static Desc DefaultDesc();
+	static Result Run(const Desc& desc);
+	static std::string Summarize(const Result& result);
+};
\ No newline at end of file
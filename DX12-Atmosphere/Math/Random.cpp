@@ -14,7 +14,136 @@
 #include "stdafx.h"
 #include "Random.h"
 
+static const uint32_t kPhiloxM0 = 0xD2511F53;
+static const uint32_t kPhiloxM1 = 0xCD9E8D57;
+static const uint32_t kPhiloxW0 = 0x9E3779B9;
+static const uint32_t kPhiloxW1 = 0xBB67AE85;
+
+// High and low 32 bits of the 32x32 products of all four lanes
+static __forceinline void MulHiLo( __m128i a, __m128i b, __m128i& hi, __m128i& lo )
+{
+    const __m128i MaskEven = _mm_set_epi32(0, -1, 0, -1);
+    __m128i Even = _mm_mul_epu32(a, b);
+    __m128i Odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), b);
+    lo = _mm_or_si128(_mm_and_si128(Even, MaskEven), _mm_slli_epi64(Odd, 32));
+    hi = _mm_or_si128(_mm_srli_epi64(Even, 32), _mm_andnot_si128(MaskEven, Odd));
+}
+
+// Philox4x32-10 on four consecutive blocks, lane i of c[j] is word j of block i
+static void Philox4x32x4( __m128i c[4], uint32_t Key0, uint32_t Key1 )
+{
+    const __m128i M0 = _mm_set1_epi32((int)kPhiloxM0);
+    const __m128i M1 = _mm_set1_epi32((int)kPhiloxM1);
+    for (int Round = 0; Round < 10; ++Round)
+    {
+        __m128i Hi0, Lo0, Hi1, Lo1;
+        MulHiLo(c[0], M0, Hi0, Lo0);
+        MulHiLo(c[2], M1, Hi1, Lo1);
+        __m128i k0 = _mm_set1_epi32((int)Key0);
+        __m128i k1 = _mm_set1_epi32((int)Key1);
+        c[0] = _mm_xor_si128(_mm_xor_si128(Hi1, c[1]), k0);
+        c[1] = Lo1;
+        c[2] = _mm_xor_si128(_mm_xor_si128(Hi0, c[3]), k1);
+        c[3] = Lo0;
+        Key0 += kPhiloxW0;
+        Key1 += kPhiloxW1;
+    }
+    // Transpose so each register holds one block in output order
+    __m128 r0 = _mm_castsi128_ps(c[0]), r1 = _mm_castsi128_ps(c[1]), r2 = _mm_castsi128_ps(c[2]), r3 = _mm_castsi128_ps(c[3]);
+    _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+    c[0] = _mm_castps_si128(r0);
+    c[1] = _mm_castps_si128(r1);
+    c[2] = _mm_castps_si128(r2);
+    c[3] = _mm_castps_si128(r3);
+}
+
+static __forceinline void LoadCounters( __m128i c[4], uint64_t BlockIndex, uint64_t Stream )
+{
+    // 64 bit block index may carry into the high word between lanes
+    uint32_t Lo[4], Hi[4];
+    for (int i = 0; i < 4; ++i)
+    {
+        Lo[i] = (uint32_t)(BlockIndex + i);
+        Hi[i] = (uint32_t)((BlockIndex + i) >> 32);
+    }
+    c[0] = _mm_loadu_si128((const __m128i*)Lo);
+    c[1] = _mm_loadu_si128((const __m128i*)Hi);
+    c[2] = _mm_set1_epi32((int)(uint32_t)Stream);
+    c[3] = _mm_set1_epi32((int)(uint32_t)(Stream >> 32));
+}
+
 namespace Math
 {
-    RandomNumberGenerator g_RNG;
+    void RandomNumberGenerator::Generate( uint64_t BlockIndex, uint32_t Out[4] ) const
+    {
+        uint32_t c0 = (uint32_t)BlockIndex, c1 = (uint32_t)(BlockIndex >> 32);
+        uint32_t c2 = (uint32_t)m_Stream, c3 = (uint32_t)(m_Stream >> 32);
+        uint32_t k0 = m_Key[0], k1 = m_Key[1];
+        for (int Round = 0; Round < 10; ++Round)
+        {
+            uint64_t p0 = (uint64_t)kPhiloxM0 * c0;
+            uint64_t p1 = (uint64_t)kPhiloxM1 * c2;
+            c0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+            c1 = (uint32_t)p1;
+            c2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+            c3 = (uint32_t)p0;
+            k0 += kPhiloxW0;
+            k1 += kPhiloxW1;
+        }
+        Out[0] = c0;
+        Out[1] = c1;
+        Out[2] = c2;
+        Out[3] = c3;
+    }
+
+    void RandomNumberGenerator::FillUInts( uint32_t* Dest, size_t Count )
+    {
+        // drain the buffered block first to stay on the scalar sequence
+        while (Count > 0 && m_BufferIndex < 4)
+        {
+            *Dest++ = m_Buffer[m_BufferIndex++];
+            --Count;
+        }
+
+        __m128i c[4];
+        for (; Count >= 16; Count -= 16, Dest += 16)
+        {
+            LoadCounters(c, m_Counter, m_Stream);
+            Philox4x32x4(c, m_Key[0], m_Key[1]);
+            for (int i = 0; i < 4; ++i)
+                _mm_storeu_si128((__m128i*)(Dest + 4 * i), c[i]);
+            m_Counter += 4;
+        }
+
+        while (Count-- > 0)
+            *Dest++ = NextUInt();
+    }
+
+    void RandomNumberGenerator::FillFloats( float* Dest, size_t Count, float MinVal, float MaxVal )
+    {
+        float Scale = (MaxVal - MinVal) * (1.0f / 16777216.0f);
+        while (Count > 0 && m_BufferIndex < 4)
+        {
+            *Dest++ = MinVal + (float)(m_Buffer[m_BufferIndex++] >> 8) * Scale;
+            --Count;
+        }
+
+        const __m128 vScale = _mm_set1_ps(Scale);
+        const __m128 vMin = _mm_set1_ps(MinVal);
+        __m128i c[4];
+        for (; Count >= 16; Count -= 16, Dest += 16)
+        {
+            LoadCounters(c, m_Counter, m_Stream);
+            Philox4x32x4(c, m_Key[0], m_Key[1]);
+            for (int i = 0; i < 4; ++i)
+            {
+                __m128 f = _mm_cvtepi32_ps(_mm_srli_epi32(c[i], 8));
+                _mm_storeu_ps(Dest + 4 * i, _mm_add_ps(vMin, _mm_mul_ps(f, vScale)));
+            }
+            m_Counter += 4;
+        }
+
+        while (Count-- > 0)
+            *Dest++ = MinVal + (float)(NextUInt() >> 8) * Scale;
+    }
 }
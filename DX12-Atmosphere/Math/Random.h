@@ -14,54 +14,127 @@
 #pragma once
 
 #include "Common.h"
-#include <random>
 
 namespace Math
 {
+    // Counter based Philox4x32-10 generator (Salmon et al., "Parallel Random Numbers: As Easy as 1, 2, 3").
+    // Every 128 bit output block is a pure function of (seed, stream, block index), so results are
+    // identical across runs and independent of how the work is split across threads.  Give each
+    // thread or job its own stream with Fork() instead of sharing one generator.
     class RandomNumberGenerator
     {
     public:
-        RandomNumberGenerator() : m_gen(m_rd())
+        RandomNumberGenerator( uint64_t Seed = 0, uint64_t Stream = 0 )
         {
+            SetSeed(Seed, Stream);
         }
 
         // Default int range is [MIN_INT, MAX_INT].  Max value is included.
         int32_t NextInt( void )
         {
-            return std::uniform_int_distribution<int32_t>(0x80000000, 0x7FFFFFFF)(m_gen);
+            return (int32_t)NextUInt();
         }
 
         int32_t NextInt( int32_t MaxVal )
         {
-            return std::uniform_int_distribution<int32_t>(0, MaxVal)(m_gen);
+            return NextInt(0, MaxVal);
         }
 
         int32_t NextInt( int32_t MinVal, int32_t MaxVal )
         {
-            return std::uniform_int_distribution<int32_t>(MinVal, MaxVal)(m_gen);
+            assert(MinVal <= MaxVal);
+            uint64_t Range = (uint64_t)((int64_t)MaxVal - (int64_t)MinVal) + 1;
+            if (Range > 0xFFFFFFFFull)
+                return (int32_t)NextUInt();
+            return (int32_t)((int64_t)MinVal + (int64_t)NextBounded((uint32_t)Range));
         }
 
         // Default float range is [0.0f, 1.0f).  Max value is excluded.
         float NextFloat( float MaxVal = 1.0f )
         {
-            return std::uniform_real_distribution<float>(0.0f, MaxVal)(m_gen);
+            return ToUnitFloat(NextUInt()) * MaxVal;
         }
 
         float NextFloat( float MinVal, float MaxVal )
         {
-            return std::uniform_real_distribution<float>(MinVal, MaxVal)(m_gen);
+            return MinVal + ToUnitFloat(NextUInt()) * (MaxVal - MinVal);
+        }
+
+        uint32_t NextUInt( void )
+        {
+            if (m_BufferIndex == 4)
+            {
+                Generate(m_Counter++, m_Buffer);
+                m_BufferIndex = 0;
+            }
+            return m_Buffer[m_BufferIndex++];
         }
 
         void SetSeed( UINT s )
         {
-            m_gen.seed(s);
+            SetSeed((uint64_t)s, m_Stream);
+        }
+
+        void SetSeed( uint64_t Seed, uint64_t Stream )
+        {
+            m_Key[0] = (uint32_t)Seed;
+            m_Key[1] = (uint32_t)(Seed >> 32);
+            m_Stream = Stream;
+            m_Counter = 0;
+            m_BufferIndex = 4;
+        }
+
+        // Same seed, independent sequence
+        RandomNumberGenerator Fork( uint64_t Stream ) const
+        {
+            return RandomNumberGenerator(GetSeed(), Stream);
+        }
+
+        // Jumps to an absolute position of the sequence, one block is 4 values
+        void Seek( uint64_t BlockIndex )
+        {
+            m_Counter = BlockIndex;
+            m_BufferIndex = 4;
+        }
+
+        uint64_t GetSeed( void ) const { return (uint64_t)m_Key[0] | ((uint64_t)m_Key[1] << 32); }
+        uint64_t GetStream( void ) const { return m_Stream; }
+
+        // Batch fills continue the same sequence as NextUInt() / NextFloat(), four blocks per SSE2 iteration
+        void FillUInts( uint32_t* Dest, size_t Count );
+        void FillFloats( float* Dest, size_t Count, float MinVal = 0.0f, float MaxVal = 1.0f );
+
+        static float ToUnitFloat( uint32_t x )
+        {
+            // top 24 bits, exactly representable, never reaches 1.0f
+            return (float)(x >> 8) * (1.0f / 16777216.0f);
         }
 
     private:
 
-        std::random_device m_rd;
-        std::minstd_rand m_gen;
-    };
+        void Generate( uint64_t BlockIndex, uint32_t Out[4] ) const;
 
-    extern RandomNumberGenerator g_RNG;
+        // Lemire's multiply-shift with rejection, unbiased in [0, Range)
+        uint32_t NextBounded( uint32_t Range )
+        {
+            uint64_t m = (uint64_t)NextUInt() * Range;
+            uint32_t l = (uint32_t)m;
+            if (l < Range)
+            {
+                uint32_t t = (0u - Range) % Range;
+                while (l < t)
+                {
+                    m = (uint64_t)NextUInt() * Range;
+                    l = (uint32_t)m;
+                }
+            }
+            return (uint32_t)(m >> 32);
+        }
+
+        uint32_t m_Key[2];
+        uint64_t m_Stream;
+        uint64_t m_Counter;
+        uint32_t m_Buffer[4];
+        uint32_t m_BufferIndex;
+    };
 };
@@ -0,0 +1,205 @@
+#include "stdafx.h"
+#include "RandomBenchmark.h"
+#include "Random.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+using Math::RandomNumberGenerator;
+
+namespace
+{
+	struct KnownAnswer
+	{
+		uint64_t seed;
+		uint64_t stream;
+		uint64_t block;
+		uint32_t expected[4];
+	};
+
+	// Random123 kat_vectors for philox4x32_10, counter words (block, stream), key words seed
+	const KnownAnswer s_knownAnswers[] =
+	{
+		{ 0, 0, 0, { 0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8 } },
+		{ ~0ull, ~0ull, ~0ull, { 0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd } },
+		{ 0x299f31d0a4093822ull, 0x0370734413198a2eull, 0x85a308d3243f6a88ull, { 0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1 } },
+	};
+
+	// keeps the timed loops from being thrown away
+	volatile uint32_t s_sink;
+
+	template <class Body>
+	double ValuesPerSecond(uint32_t numValues, const Body& body)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		body();
+		double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+		return numValues / std::max(seconds, 1e-9);
+	}
+
+	// streams [0, numStreams) one after another on numThreads threads, whole streams or slices
+	std::vector<uint32_t> Generate(const RandomNumberGenerator& root, uint32_t numStreams, uint32_t valuesPerStream, uint32_t numThreads, bool slices)
+	{
+		std::vector<uint32_t> values((size_t)numStreams * valuesPerStream);
+		std::vector<std::thread> threads;
+		for (uint32_t t = 0; t < numThreads; ++t)
+		{
+			threads.emplace_back([&, t]()
+			{
+				for (uint32_t s = 0; s < numStreams; ++s)
+				{
+					uint32_t* out = values.data() + (size_t)s * valuesPerStream;
+					RandomNumberGenerator rng = root.Fork(s);
+					if (!slices)
+					{
+						if (s % numThreads == t)
+							rng.FillUInts(out, valuesPerStream);
+						continue;
+					}
+					// blocks of 4 values, a thread takes every numThreads-th run of 64 blocks
+					const uint32_t run = 256;
+					for (uint32_t first = t * run; first < valuesPerStream; first += numThreads * run)
+					{
+						rng.Seek(first / 4);
+						uint32_t count = std::min(run, valuesPerStream - first);
+						for (uint32_t i = 0; i < count; ++i)
+							out[first + i] = rng.NextUInt();
+					}
+				}
+			});
+		}
+		for (auto& thread : threads)
+			thread.join();
+		return values;
+	}
+}
+
+RandomBenchmark::Desc RandomBenchmark::DefaultDesc()
+{
+	Desc desc;
+	desc.numValues = 1 << 24;
+	desc.numStreams = 64;
+	desc.valuesPerStream = 1 << 14;
+	desc.maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+	desc.seed = 0x5eed;
+	return desc;
+}
+
+RandomBenchmark::Result RandomBenchmark::Run(const Desc& desc)
+{
+	Result result = {};
+
+	for (const KnownAnswer& answer : s_knownAnswers)
+	{
+		RandomNumberGenerator rng(answer.seed, answer.stream);
+		rng.Seek(answer.block);
+		for (uint32_t i = 0; i < 4; ++i)
+			result.violations.Add("known answer", rng.NextUInt() != answer.expected[i]);
+	}
+
+	// the batch fills from every offset into a block, and across the end of a fill
+	{
+		const uint32_t count = 1000;
+		RandomNumberGenerator scalar(desc.seed, 7);
+		std::vector<uint32_t> expected(count * 2);
+		for (uint32_t& value : expected)
+			value = scalar.NextUInt();
+		std::vector<uint32_t> uints(count);
+		std::vector<float> floats(count);
+		for (uint32_t offset = 0; offset < 8; ++offset)
+		{
+			RandomNumberGenerator rng(desc.seed, 7);
+			for (uint32_t i = 0; i < offset; ++i)
+				rng.NextUInt();
+			rng.FillUInts(uints.data(), count - offset);
+			for (uint32_t i = 0; i < count - offset; ++i)
+				result.violations.Add("batch", uints[i] != expected[offset + i]);
+			result.violations.Add("batch", rng.NextUInt() != expected[count]);
+
+			rng.Seek(0);
+			for (uint32_t i = 0; i < offset; ++i)
+				rng.NextUInt();
+			rng.FillFloats(floats.data(), count - offset, -2.0f, 2.0f);
+			for (uint32_t i = 0; i < count - offset; ++i)
+				result.violations.Add("batch", floats[i] != -2.0f + (float)(expected[offset + i] >> 8) * (4.0f / 16777216.0f));
+		}
+	}
+
+	RandomNumberGenerator root(desc.seed, 0);
+	std::vector<uint32_t> reference = Generate(root, desc.numStreams, desc.valuesPerStream, 1, false);
+	for (uint32_t threads = 1; threads <= std::max(desc.maxThreads, 1u); threads *= 2)
+	{
+		for (int slices = 0; slices < 2; ++slices)
+		{
+			std::vector<uint32_t> values = Generate(root, desc.numStreams, desc.valuesPerStream, threads, slices != 0);
+			for (size_t i = 0; i < values.size(); ++i)
+				result.violations.Add("threads", values[i] != reference[i]);
+		}
+		++result.threadCounts;
+	}
+
+	// throughput, the old generator first
+	const uint32_t n = desc.numValues;
+	result.minstdPerSecond = ValuesPerSecond(n, [n]()
+	{
+		std::minstd_rand engine(1);
+		uint32_t sum = 0;
+		for (uint32_t i = 0; i < n; ++i)
+			sum += (uint32_t)std::uniform_int_distribution<int32_t>(0, 1 << 30)(engine);
+		s_sink = sum;
+	});
+	result.nextUIntPerSecond = ValuesPerSecond(n, [n, &desc]()
+	{
+		RandomNumberGenerator rng(desc.seed);
+		uint32_t sum = 0;
+		for (uint32_t i = 0; i < n; ++i)
+			sum += rng.NextUInt();
+		s_sink = sum;
+	});
+	result.nextFloatPerSecond = ValuesPerSecond(n, [n, &desc]()
+	{
+		RandomNumberGenerator rng(desc.seed);
+		float sum = 0.0f;
+		for (uint32_t i = 0; i < n; ++i)
+			sum += rng.NextFloat();
+		s_sink = (uint32_t)sum;
+	});
+	std::vector<uint32_t> uints(4096);
+	std::vector<float> floats(4096);
+	result.fillUIntsPerSecond = ValuesPerSecond(n, [n, &desc, &uints]()
+	{
+		RandomNumberGenerator rng(desc.seed);
+		uint32_t sum = 0;
+		for (uint32_t i = 0; i < n; i += (uint32_t)uints.size())
+		{
+			rng.FillUInts(uints.data(), uints.size());
+			sum += uints[i & 4095];
+		}
+		s_sink = sum;
+	});
+	result.fillFloatsPerSecond = ValuesPerSecond(n, [n, &desc, &floats]()
+	{
+		RandomNumberGenerator rng(desc.seed);
+		float sum = 0.0f;
+		for (uint32_t i = 0; i < n; i += (uint32_t)floats.size())
+		{
+			rng.FillFloats(floats.data(), floats.size());
+			sum += floats[i & 4095];
+		}
+		s_sink = (uint32_t)sum;
+	});
+	return result;
+}
+
+std::string RandomBenchmark::Summarize(const Result& result)
+{
+	char line[256];
+	snprintf(line, sizeof(line), "M values / s: minstd %.0f, NextUInt %.0f, NextFloat %.0f, FillUInts %.0f, FillFloats %.0f, same on %u thread counts",
+		result.minstdPerSecond * 1e-6, result.nextUIntPerSecond * 1e-6, result.nextFloatPerSecond * 1e-6, result.fillUIntsPerSecond * 1e-6,
+		result.fillFloatsPerSecond * 1e-6, result.threadCounts);
+	return line;
+}
\ No newline at end of file
@@ -0,0 +1,42 @@
+#pragma once
+#include "Utils/SelfTest.h"
+#include <cstdint>
+#include <string>
+
+// Math::RandomNumberGenerator against the std::minstd_rand with a distribution per call it
+// replaced: values per second of the scalar calls and the batch fills. Then the checks that
+// make it a replacement for seeding noise and jitter from worker threads:
+// - the first block of a few seeds, streams and counters is the published Philox4x32-10 answer
+// - FillUInts and FillFloats continue the scalar sequence from any position
+// - numStreams streams of valuesPerStream values come out the same from 1, 2, 4 ... maxThreads
+//   threads, each thread taking whole streams through Fork, or slices of one stream through Seek
+class RandomBenchmark
+{
+public:
+	struct Desc
+	{
+		uint32_t numValues;
+		uint32_t numStreams;
+		uint32_t valuesPerStream;
+		uint32_t maxThreads;
+		uint64_t seed;
+	};
+
+	struct Result
+	{
+		// values per second
+		double minstdPerSecond;
+		double nextUIntPerSecond;
+		double nextFloatPerSecond;
+		double fillUIntsPerSecond;
+		double fillFloatsPerSecond;
+		// thread counts the sequences were compared on
+		uint32_t threadCounts;
+		// "known answer", "batch" and "threads", values that differ from what they must be
+		SelfTest::Violations violations;
+	};
+
+	static Desc DefaultDesc();
+	static Result Run(const Desc& desc);
+	static std::string Summarize(const Result& result);
+};
\ No newline at end of file
@@ -0,0 +1,371 @@
+#include "stdafx.h"
+#include "BlueNoiseGenerator.h"
+#include "Math/Random.h"
+#include "D3D12/Texture.h"
+#include <ppl.h>
+#include <chrono>
+#include <complex>
+#include <fstream>
+
+struct BlueNoiseFileHeader
+{
+	static const uint32_t kMagic = 0x45534E42; // "BNSE"
+
+	uint32_t magic;
+	uint32_t size;
+	uint32_t numSlices;
+	uint32_t reserved;
+	uint64_t seed;
+};
+
+// Arg max (or min) of the energy over the texels in the given state. Chunks are reduced in order and
+// keep the lowest index on ties, so the result doesn't depend on how the chunks were scheduled.
+static uint32_t FindExtremum(const std::vector<float>& energy, const std::vector<uint8_t>& pattern, uint8_t state, bool largest)
+{
+	const uint32_t count = (uint32_t)energy.size();
+	const uint32_t chunk_size = 4096;
+	const uint32_t num_chunks = (count + chunk_size - 1) / chunk_size;
+	std::vector<uint32_t> chunk_best(num_chunks, UINT32_MAX);
+
+	concurrency::parallel_for(0u, num_chunks, [&](uint32_t chunk)
+	{
+		uint32_t best = UINT32_MAX;
+		float best_energy = largest ? -FLT_MAX : FLT_MAX;
+		uint32_t end = std::min(count, (chunk + 1) * chunk_size);
+		for (uint32_t i = chunk * chunk_size; i < end; ++i)
+		{
+			if (pattern[i] != state)
+				continue;
+			float e = energy[i];
+			if (largest ? e > best_energy : e < best_energy)
+			{
+				best_energy = e;
+				best = i;
+			}
+		}
+		chunk_best[chunk] = best;
+	});
+
+	uint32_t best = UINT32_MAX;
+	for (uint32_t b : chunk_best)
+	{
+		if (b == UINT32_MAX)
+			continue;
+		if (best == UINT32_MAX || (largest ? energy[b] > energy[best] : energy[b] < energy[best]))
+			best = b;
+	}
+	assert(best != UINT32_MAX);
+	return best;
+}
+
+BlueNoiseGenerator::BlueNoiseGenerator()
+	: m_size(0),
+	m_numSlices(0),
+	m_seed(0),
+	m_sigma(1.5f),
+	m_temporalSigma(1.0f)
+{
+	ZeroMemory(&m_stats, sizeof(Stats));
+}
+
+void BlueNoiseGenerator::BuildKernel()
+{
+	// the kernel must not wrap onto itself, otherwise a texel would see its own splat twice
+	int radius = std::min((int)std::ceil(3.0f * m_sigma), ((int)m_size - 1) / 2);
+	int radius_z = m_temporalSigma > 0.0f ? std::min((int)std::ceil(3.0f * m_temporalSigma), ((int)m_numSlices - 1) / 2) : 0;
+	float inv_2s2 = 1.0f / (2.0f * m_sigma * m_sigma);
+	float inv_2t2 = m_temporalSigma > 0.0f ? 1.0f / (2.0f * m_temporalSigma * m_temporalSigma) : 0.0f;
+
+	m_kernel.clear();
+	for (int dz = -radius_z; dz <= radius_z; ++dz)
+	{
+		for (int dy = -radius; dy <= radius; ++dy)
+		{
+			for (int dx = -radius; dx <= radius; ++dx)
+			{
+				// spatial Gaussian inside the slice plus a temporal Gaussian along the pixel, a full 3D
+				// Gaussian would trade the spatial spectrum for the temporal one
+				if (dz != 0 && (dx != 0 || dy != 0))
+					continue;
+				float w = dz == 0 ? std::exp(-(float)(dx * dx + dy * dy) * inv_2s2) : std::exp(-(float)(dz * dz) * inv_2t2);
+				m_kernel.push_back({ dx, dy, dz, w });
+			}
+		}
+	}
+}
+
+void BlueNoiseGenerator::Splat(uint32_t index, float sign)
+{
+	int x = (int)(index % m_size);
+	int y = (int)((index / m_size) % m_size);
+	int z = (int)(index / (m_size * m_size));
+	int size = (int)m_size;
+	int slices = (int)m_numSlices;
+	for (const KernelTap& tap : m_kernel)
+	{
+		int tx = (x + tap.dx + size) % size;
+		int ty = (y + tap.dy + size) % size;
+		int tz = (z + tap.dz + slices) % slices;
+		m_energy[((size_t)tz * size + ty) * size + tx] += sign * tap.weight;
+	}
+}
+
+uint32_t BlueNoiseGenerator::FindTightestCluster() const
+{
+	return FindExtremum(m_energy, m_pattern, 1, true);
+}
+
+uint32_t BlueNoiseGenerator::FindLargestVoid() const
+{
+	return FindExtremum(m_energy, m_pattern, 0, false);
+}
+
+void BlueNoiseGenerator::Generate(uint32_t size, uint32_t numSlices, uint64_t seed)
+{
+	assert(size >= 4 && numSlices >= 1);
+	auto start = std::chrono::high_resolution_clock::now();
+
+	m_size = size;
+	m_numSlices = numSlices;
+	m_seed = seed;
+	BuildKernel();
+
+	const uint32_t count = size * size * numSlices;
+	m_energy.assign(count, 0.0f);
+	m_pattern.assign(count, 0);
+
+	// initial binary pattern, 10% minority texels at random
+	RandomNumberGenerator rng(seed);
+	const uint32_t num_ones = std::max(1u, count / 10);
+	for (uint32_t placed = 0; placed < num_ones;)
+	{
+		uint32_t i = (uint32_t)rng.NextInt(0, (int32_t)count - 1);
+		if (m_pattern[i])
+			continue;
+		m_pattern[i] = 1;
+		Splat(i, 1.0f);
+		++placed;
+	}
+
+	// move the tightest cluster into the largest void until it lands where it came from
+	for (uint32_t iter = 0; iter < count; ++iter)
+	{
+		uint32_t cluster = FindTightestCluster();
+		m_pattern[cluster] = 0;
+		Splat(cluster, -1.0f);
+		uint32_t void_index = FindLargestVoid();
+		m_pattern[void_index] = 1;
+		Splat(void_index, 1.0f);
+		if (void_index == cluster)
+			break;
+	}
+
+	std::vector<uint32_t> ranks(count);
+	const std::vector<float> initial_energy = m_energy;
+	const std::vector<uint8_t> initial_pattern = m_pattern;
+
+	// phase 1: remove clusters from the initial pattern, ranks num_ones - 1 down to 0
+	for (uint32_t rank = num_ones; rank-- > 0;)
+	{
+		uint32_t cluster = FindTightestCluster();
+		m_pattern[cluster] = 0;
+		Splat(cluster, -1.0f);
+		ranks[cluster] = rank;
+	}
+
+	// phase 2 and 3: fill voids until every texel has a rank. With a Gaussian energy the tightest
+	// cluster of zeros is the largest void of ones, so the second half needs no separate pass.
+	m_energy = initial_energy;
+	m_pattern = initial_pattern;
+	for (uint32_t rank = num_ones; rank < count; ++rank)
+	{
+		uint32_t void_index = FindLargestVoid();
+		m_pattern[void_index] = 1;
+		Splat(void_index, 1.0f);
+		ranks[void_index] = rank;
+	}
+
+	// rank again inside every slice, so each slice on its own has an exactly uniform histogram
+	const uint32_t slice_count = size * size;
+	m_values.resize(count);
+	concurrency::parallel_for(0u, numSlices, [&](uint32_t z)
+	{
+		std::vector<uint32_t> order(slice_count);
+		for (uint32_t i = 0; i < slice_count; ++i)
+			order[i] = z * slice_count + i;
+		std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return ranks[a] < ranks[b]; });
+		for (uint32_t i = 0; i < slice_count; ++i)
+			m_values[order[i]] = (uint16_t)(((uint64_t)i * 65535 + (slice_count - 1) / 2) / (slice_count - 1));
+	});
+
+	m_energy.clear();
+	m_energy.shrink_to_fit();
+	m_pattern.clear();
+	m_pattern.shrink_to_fit();
+
+	auto end = std::chrono::high_resolution_clock::now();
+	m_stats.seconds = std::chrono::duration<double>(end - start).count();
+	m_stats.numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+	ComputeSpectrum();
+}
+
+void BlueNoiseGenerator::ComputeSpectrum()
+{
+	const uint32_t size = m_size;
+	const uint32_t slice_count = size * size;
+	const float pi = 3.14159265358979f;
+
+	std::vector<std::complex<float>> twiddle(size);
+	for (uint32_t k = 0; k < size; ++k)
+		twiddle[k] = std::polar(1.0f, -2.0f * pi * k / size);
+
+	// spatial: 2D DFT of every slice, radially averaged
+	const uint32_t num_bins = size / 2;
+	std::vector<double> bin_power(num_bins, 0.0);
+	std::vector<uint32_t> bin_count(num_bins, 0);
+	double low_power = 0.0, all_power = 0.0;
+	uint32_t low_count = 0, all_count = 0;
+	std::vector<float> slice_power((size_t)m_numSlices * slice_count);
+
+	concurrency::parallel_for(0u, m_numSlices, [&](uint32_t z)
+	{
+		const uint16_t* slice = m_values.data() + (size_t)z * slice_count;
+		std::vector<std::complex<float>> rows(slice_count);
+		for (uint32_t y = 0; y < size; ++y)
+		{
+			for (uint32_t k = 0; k < size; ++k)
+			{
+				std::complex<float> sum = 0.0f;
+				for (uint32_t x = 0; x < size; ++x)
+					sum += (slice[y * size + x] / 65535.0f - 0.5f) * twiddle[(k * x) % size];
+				rows[y * size + k] = sum;
+			}
+		}
+		float* power = slice_power.data() + (size_t)z * slice_count;
+		for (uint32_t kx = 0; kx < size; ++kx)
+		{
+			for (uint32_t ky = 0; ky < size; ++ky)
+			{
+				std::complex<float> sum = 0.0f;
+				for (uint32_t y = 0; y < size; ++y)
+					sum += rows[y * size + kx] * twiddle[(ky * y) % size];
+				power[ky * size + kx] = std::norm(sum) / slice_count;
+			}
+		}
+	});
+
+	for (uint32_t ky = 0; ky < size; ++ky)
+	{
+		for (uint32_t kx = 0; kx < size; ++kx)
+		{
+			int fx = kx < size / 2 ? (int)kx : (int)kx - (int)size;
+			int fy = ky < size / 2 ? (int)ky : (int)ky - (int)size;
+			float r = std::sqrt((float)(fx * fx + fy * fy));
+			uint32_t bin = (uint32_t)(r + 0.5f);
+			if (bin >= num_bins)
+				continue;
+			bin_count[bin]++;
+			for (uint32_t z = 0; z < m_numSlices; ++z)
+			{
+				double p = slice_power[(size_t)z * slice_count + ky * size + kx];
+				bin_power[bin] += p;
+				if (bin == 0)
+					continue;
+				all_power += p;
+				all_count++;
+				if (r < size / 8.0f)
+				{
+					low_power += p;
+					low_count++;
+				}
+			}
+		}
+	}
+
+	m_spectrum.assign(num_bins, 0.0f);
+	for (uint32_t bin = 0; bin < num_bins; ++bin)
+	{
+		m_spectrum[bin] = bin_count[bin] > 0 ? (float)(bin_power[bin] / ((double)bin_count[bin] * m_numSlices)) : 0.0f;
+	}
+	m_stats.lowFrequencyRatio = (low_count > 0 && all_power > 0.0) ? (float)((low_power / low_count) / (all_power / all_count)) : 0.0f;
+
+	// temporal: DFT along the slices for every pixel
+	const uint32_t num_temporal_bins = m_numSlices / 2 + 1;
+	std::vector<double> row_power((size_t)size * num_temporal_bins, 0.0);
+	concurrency::parallel_for(0u, size, [&](uint32_t y)
+	{
+		double* power = row_power.data() + (size_t)y * num_temporal_bins;
+		for (uint32_t x = 0; x < size; ++x)
+		{
+			for (uint32_t k = 0; k < num_temporal_bins; ++k)
+			{
+				std::complex<float> sum = 0.0f;
+				for (uint32_t z = 0; z < m_numSlices; ++z)
+				{
+					float v = m_values[((size_t)z * size + y) * size + x] / 65535.0f - 0.5f;
+					sum += v * std::polar(1.0f, -2.0f * pi * ((k * z) % m_numSlices) / m_numSlices);
+				}
+				power[k] += std::norm(sum) / m_numSlices;
+			}
+		}
+	});
+
+	m_temporalSpectrum.assign(num_temporal_bins, 0.0f);
+	for (uint32_t k = 0; k < num_temporal_bins; ++k)
+	{
+		double sum = 0.0;
+		for (uint32_t y = 0; y < size; ++y)
+			sum += row_power[(size_t)y * num_temporal_bins + k];
+		m_temporalSpectrum[k] = (float)(sum / slice_count);
+	}
+}
+
+bool BlueNoiseGenerator::Load(const std::wstring& fileName, uint32_t size, uint32_t numSlices, uint64_t seed)
+{
+	std::ifstream file(fileName, std::ios::binary);
+	if (!file)
+		return false;
+
+	BlueNoiseFileHeader header;
+	file.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if (!file || header.magic != BlueNoiseFileHeader::kMagic || header.size != size || header.numSlices != numSlices || header.seed != seed)
+		return false;
+
+	std::vector<uint16_t> values((size_t)size * size * numSlices);
+	file.read(reinterpret_cast<char*>(values.data()), values.size() * sizeof(uint16_t));
+	if (!file)
+		return false;
+
+	m_size = size;
+	m_numSlices = numSlices;
+	m_seed = seed;
+	m_values = std::move(values);
+	m_stats.seconds = 0.0;
+	m_stats.numThreads = 0;
+	ComputeSpectrum();
+	return true;
+}
+
+void BlueNoiseGenerator::Save(const std::wstring& fileName) const
+{
+	assert(!m_values.empty());
+	std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+	if (!file)
+		return;
+
+	BlueNoiseFileHeader header;
+	header.magic = BlueNoiseFileHeader::kMagic;
+	header.size = m_size;
+	header.numSlices = m_numSlices;
+	header.reserved = 0;
+	header.seed = m_seed;
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(m_values.data()), m_values.size() * sizeof(uint16_t));
+}
+
+void BlueNoiseGenerator::CreateTexture(Texture3D& texture) const
+{
+	assert(!m_values.empty());
+	texture.Create(m_size, m_size, m_numSlices, DXGI_FORMAT_R16_UNORM, m_values.data());
+}
\ No newline at end of file
@@ -0,0 +1,73 @@
+#pragma once
+#include "stdafx.h"
+
+class Texture3D;
+
+// Tileable blue noise built with void-and-cluster on the CPU. Every texel of a
+// size x size x numSlices torus gets a unique rank, the energy kernel is a Gaussian
+// in xy inside a slice plus a Gaussian along the slice axis for the same pixel, so
+// each slice is a 2D blue noise mask and a fixed pixel is blue along the slices too
+// (spatiotemporal blue noise).
+// Shaders index the result by pixel % size and FrameIndex % numSlices.
+class BlueNoiseGenerator
+{
+public:
+	struct Stats
+	{
+		double seconds;
+		uint32_t numThreads;
+		// mean spatial power below size / 8 relative to the mean over all frequencies,
+		// about 1 for white noise, close to 0 for good blue noise
+		float lowFrequencyRatio;
+	};
+
+	BlueNoiseGenerator();
+
+	void SetSigma(float spatialSigma, float temporalSigma) { m_sigma = spatialSigma; m_temporalSigma = temporalSigma; }
+
+	void Generate(uint32_t size, uint32_t numSlices, uint64_t seed);
+	// Binary cache of the ranks, returns false if the file is missing or doesn't match size/numSlices/seed
+	bool Load(const std::wstring& fileName, uint32_t size, uint32_t numSlices, uint64_t seed);
+	void Save(const std::wstring& fileName) const;
+
+	// R16_UNORM texture, rank / (count - 1)
+	void CreateTexture(Texture3D& texture) const;
+
+	uint32_t GetSize() const { return m_size; }
+	uint32_t GetNumSlices() const { return m_numSlices; }
+	uint64_t GetSeed() const { return m_seed; }
+	const std::vector<uint16_t>& GetValues() const { return m_values; }
+	// Radially averaged power spectrum of the slices, size / 2 bins starting at DC
+	const std::vector<float>& GetSpectrum() const { return m_spectrum; }
+	// Power spectrum along the slice axis averaged over all pixels, numSlices / 2 + 1 bins
+	const std::vector<float>& GetTemporalSpectrum() const { return m_temporalSpectrum; }
+	const Stats& GetStats() const { return m_stats; }
+
+private:
+	struct KernelTap
+	{
+		int dx, dy, dz;
+		float weight;
+	};
+
+	void BuildKernel();
+	void Splat(uint32_t index, float sign);
+	uint32_t FindTightestCluster() const;
+	uint32_t FindLargestVoid() const;
+	void ComputeSpectrum();
+
+	uint32_t m_size;
+	uint32_t m_numSlices;
+	uint64_t m_seed;
+	float m_sigma;
+	float m_temporalSigma;
+
+	std::vector<KernelTap> m_kernel;
+	std::vector<float> m_energy;
+	std::vector<uint8_t> m_pattern;
+
+	std::vector<uint16_t> m_values;
+	std::vector<float> m_spectrum;
+	std::vector<float> m_temporalSpectrum;
+	Stats m_stats;
+};
\ No newline at end of file
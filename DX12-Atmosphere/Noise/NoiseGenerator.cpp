@@ -1,5 +1,6 @@
 #include "stdafx.h"
 #include "NoiseGenerator.h"
+#include "VolumeNoiseStreamer.h"
 #include "D3D12/GpuBuffer.h"
 #include "D3D12/ColorBuffer.h"
 #include "D3D12/CommandContext.h"
@@ -40,6 +41,7 @@ NoiseState::NoiseState()
 NoiseGenerator::NoiseGenerator()
 {
 	m_showNoiseWindow = true;
+	m_volumeStreamer = std::make_unique<VolumeNoiseStreamer>();
 }
 
 NoiseGenerator::~NoiseGenerator()
@@ -297,6 +299,24 @@ void NoiseGenerator::NoiseConfig(size_t i)
 			noise_state->invert_visualize_warp |= ((int)invert << 16);
 		}
 		dirty_flag |= ImGui::Checkbox("Remap Value Range", &remap_value_range);
+		if (is_volume_texture && !is_curl)
+		{
+			// bake a large volume to disk on the CPU, blocks until the file is written
+			ImGui::Text("Offline Export");
+			static int export_size[3] = { 512, 512, 512 };
+			ImGui::DragInt3("Export Size", export_size, 1.0f, 1, 4096);
+			if (ImGui::Button("Export Streamed"))
+			{
+				std::wstring file_name(name.begin(), name.end());
+				m_volumeStreamer->Generate(file_name + L".vnoise", export_size[0], export_size[1], export_size[2], *noise_state, remap_value_range);
+			}
+			const auto& stats = m_volumeStreamer->GetStats();
+			if (stats.fileBytes > 0)
+			{
+				ImGui::Text("Generate %.2fs, Remap %.2fs", stats.generateSeconds, stats.remapSeconds);
+				ImGui::Text("File %.1f MB, Peak Mapped %.1f MB", stats.fileBytes / 1048576.0, stats.peakMappedBytes / 1048576.0);
+			}
+		}
 		ImGui::PopItemWidth();
 	}
 	ImGui::EndGroup();
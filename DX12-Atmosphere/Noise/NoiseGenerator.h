@@ -8,6 +8,7 @@ class PixelBuffer;
 class ColorBuffer;
 class VolumeColorBuffer;
 class ComputeContext;
+class VolumeNoiseStreamer;
 
 enum NoiseType
 {
@@ -184,6 +185,7 @@ private:
 	ComputePSO m_mapVolumeNoiseColorRGBAPSO;
 	ComputePSO m_genCurlNoisePSO;
 	StructuredBuffer m_minMax;
+	std::unique_ptr<VolumeNoiseStreamer> m_volumeStreamer;
 
 	bool m_showNoiseWindow;
 };
\ No newline at end of file
@@ -0,0 +1,298 @@
+#include "stdafx.h"
+#include "NoisePacker.h"
+#include <ppl.h>
+
+struct SliceError
+{
+	double sumSq[4];
+	float maxError[4];
+};
+
+static void ResetErrors(std::vector<SliceError>& errors)
+{
+	for (auto& e : errors)
+	{
+		for (int c = 0; c < 4; ++c)
+		{
+			e.sumSq[c] = 0.0;
+			e.maxError[c] = 0.0f;
+		}
+	}
+}
+
+static void FillReport(NoisePacker::Report* report, const std::vector<SliceError>& errors, uint32_t numChannels, uint64_t numVoxels, uint64_t packedBytes)
+{
+	if (report == nullptr)
+		return;
+
+	ZeroMemory(report, sizeof(NoisePacker::Report));
+	report->numChannels = numChannels;
+	report->sourceBytes = numVoxels * numChannels * sizeof(float);
+	report->packedBytes = packedBytes;
+	for (uint32_t c = 0; c < numChannels; ++c)
+	{
+		double sum_sq = 0.0;
+		for (auto& e : errors)
+		{
+			sum_sq += e.sumSq[c];
+			report->maxError[c] = std::max(report->maxError[c], e.maxError[c]);
+		}
+		report->rmse[c] = (float)std::sqrt(sum_sq / (double)numVoxels);
+	}
+}
+
+static inline uint8_t ToUnorm8(float v)
+{
+	float q = std::floor(v * 255.0f + 0.5f);
+	return (uint8_t)(q < 0.0f ? 0.0f : (q > 255.0f ? 255.0f : q));
+}
+
+static void Quantize(const float* src, uint32_t numChannels, uint32_t width, uint32_t height, uint32_t depth,
+	bool dither, uint8_t* dst, uint32_t dstStride, NoisePacker::Report* report)
+{
+	assert(numChannels >= 1 && numChannels <= 4 && numChannels <= dstStride);
+
+	std::vector<SliceError> errors(depth);
+	ResetErrors(errors);
+
+	concurrency::parallel_for(0u, depth, [&](uint32_t z)
+	{
+		SliceError& slice_error = errors[z];
+		// two error rows with one texel of padding on each side
+		std::vector<float> cur_row(width + 2), next_row(width + 2);
+		const uint64_t slice_offset = (uint64_t)z * width * height;
+
+		for (uint32_t c = 0; c < dstStride; ++c)
+		{
+			if (c >= numChannels)
+			{
+				for (uint64_t i = 0; i < (uint64_t)width * height; ++i)
+					dst[(slice_offset + i) * dstStride + c] = 255;
+				continue;
+			}
+
+			std::fill(cur_row.begin(), cur_row.end(), 0.0f);
+			std::fill(next_row.begin(), next_row.end(), 0.0f);
+			for (uint32_t y = 0; y < height; ++y)
+			{
+				bool reverse = (y & 1) != 0;
+				int dir = reverse ? -1 : 1;
+				for (uint32_t i = 0; i < width; ++i)
+				{
+					uint32_t x = reverse ? width - 1 - i : i;
+					uint64_t idx = slice_offset + (uint64_t)y * width + x;
+					float original = src[idx * numChannels + c];
+					float val = dither ? original + cur_row[x + 1] : original;
+					uint8_t q = ToUnorm8(val);
+					dst[idx * dstStride + c] = q;
+
+					float decoded = q / 255.0f;
+					if (dither)
+					{
+						float err = val - decoded;
+						cur_row[x + 1 + dir] += err * (7.0f / 16.0f);
+						next_row[x + 1 - dir] += err * (3.0f / 16.0f);
+						next_row[x + 1] += err * (5.0f / 16.0f);
+						next_row[x + 1 + dir] += err * (1.0f / 16.0f);
+					}
+
+					float diff = std::abs(decoded - original);
+					slice_error.sumSq[c] += (double)diff * diff;
+					slice_error.maxError[c] = std::max(slice_error.maxError[c], diff);
+				}
+				std::swap(cur_row, next_row);
+				std::fill(next_row.begin(), next_row.end(), 0.0f);
+			}
+		}
+	});
+
+	FillReport(report, errors, numChannels, (uint64_t)width * height * depth, (uint64_t)width * height * depth * dstStride);
+}
+
+// Squared error of the best index for every texel of a block against a BC4 palette
+static float FitPalette(const float values[16], const float palette[8], uint8_t indices[16])
+{
+	float total = 0.0f;
+	for (int i = 0; i < 16; ++i)
+	{
+		float best = FLT_MAX;
+		for (uint8_t p = 0; p < 8; ++p)
+		{
+			float d = values[i] - palette[p];
+			d *= d;
+			if (d < best)
+			{
+				best = d;
+				indices[i] = p;
+			}
+		}
+		total += best;
+	}
+	return total;
+}
+
+static void BuildPalette(uint8_t r0, uint8_t r1, float palette[8])
+{
+	float f0 = r0 / 255.0f;
+	float f1 = r1 / 255.0f;
+	palette[0] = f0;
+	palette[1] = f1;
+	if (r0 > r1)
+	{
+		for (int i = 2; i < 8; ++i)
+			palette[i] = ((8 - i) * f0 + (i - 1) * f1) / 7.0f;
+	}
+	else
+	{
+		for (int i = 2; i < 6; ++i)
+			palette[i] = ((6 - i) * f0 + (i - 1) * f1) / 5.0f;
+		palette[6] = 0.0f;
+		palette[7] = 1.0f;
+	}
+}
+
+// Tries both BC4 modes and keeps the one with the lower error
+static void EncodeBC4Block(const float values[16], uint8_t block[8], float decoded[16])
+{
+	float min_val = FLT_MAX, max_val = -FLT_MAX;
+	float inner_min = FLT_MAX, inner_max = -FLT_MAX;
+	for (int i = 0; i < 16; ++i)
+	{
+		min_val = std::min(min_val, values[i]);
+		max_val = std::max(max_val, values[i]);
+		// 0 and 1 are free in the 6 value mode, keep them out of the endpoints
+		if (values[i] > 0.5f / 255.0f && values[i] < 254.5f / 255.0f)
+		{
+			inner_min = std::min(inner_min, values[i]);
+			inner_max = std::max(inner_max, values[i]);
+		}
+	}
+
+	float palette8[8], palette6[8];
+	uint8_t indices8[16], indices6[16];
+
+	uint8_t a0 = ToUnorm8(max_val);
+	uint8_t a1 = ToUnorm8(min_val);
+	if (a0 == a1)
+	{
+		// solid block, every index 0 decodes to r0 in either mode
+		block[0] = a0;
+		block[1] = a1;
+		for (int i = 2; i < 8; ++i)
+			block[i] = 0;
+		for (int i = 0; i < 16; ++i)
+			decoded[i] = a0 / 255.0f;
+		return;
+	}
+	BuildPalette(a0, a1, palette8);
+	float error8 = FitPalette(values, palette8, indices8);
+
+	uint8_t b0 = inner_min <= inner_max ? ToUnorm8(inner_min) : 0;
+	uint8_t b1 = inner_min <= inner_max ? ToUnorm8(inner_max) : 0;
+	BuildPalette(b0, b1, palette6);
+	float error6 = FitPalette(values, palette6, indices6);
+
+	bool use8 = error8 <= error6;
+	const float* palette = use8 ? palette8 : palette6;
+	const uint8_t* indices = use8 ? indices8 : indices6;
+	block[0] = use8 ? a0 : b0;
+	block[1] = use8 ? a1 : b1;
+
+	uint64_t bits = 0;
+	for (int i = 0; i < 16; ++i)
+	{
+		bits |= (uint64_t)indices[i] << (3 * i);
+		decoded[i] = palette[indices[i]];
+	}
+	for (int i = 0; i < 6; ++i)
+		block[2 + i] = (uint8_t)(bits >> (8 * i));
+}
+
+static void EncodeBlocks(const float* src, uint32_t numChannels, const uint32_t* channels, uint32_t numEncoded,
+	uint32_t width, uint32_t height, uint32_t depth, uint8_t* dst, NoisePacker::Report* report)
+{
+	const uint32_t blocks_x = std::max(1u, (width + 3) / 4);
+	const uint32_t blocks_y = std::max(1u, (height + 3) / 4);
+	const uint32_t block_bytes = 8 * numEncoded;
+
+	std::vector<SliceError> errors(depth);
+	ResetErrors(errors);
+
+	concurrency::parallel_for(0u, depth, [&](uint32_t z)
+	{
+		SliceError& slice_error = errors[z];
+		uint8_t* slice_dst = dst + (uint64_t)z * blocks_x * blocks_y * block_bytes;
+		const uint64_t slice_offset = (uint64_t)z * width * height;
+
+		for (uint32_t by = 0; by < blocks_y; ++by)
+		{
+			for (uint32_t bx = 0; bx < blocks_x; ++bx)
+			{
+				uint8_t* block = slice_dst + ((uint64_t)by * blocks_x + bx) * block_bytes;
+				for (uint32_t e = 0; e < numEncoded; ++e)
+				{
+					float values[16], decoded[16];
+					for (uint32_t i = 0; i < 16; ++i)
+					{
+						// replicate the edge for partial blocks
+						uint32_t x = std::min(bx * 4 + (i & 3), width - 1);
+						uint32_t y = std::min(by * 4 + (i >> 2), height - 1);
+						values[i] = src[(slice_offset + (uint64_t)y * width + x) * numChannels + channels[e]];
+					}
+					EncodeBC4Block(values, block + 8 * e, decoded);
+
+					for (uint32_t i = 0; i < 16; ++i)
+					{
+						if (bx * 4 + (i & 3) >= width || by * 4 + (i >> 2) >= height)
+							continue;
+						float diff = std::abs(decoded[i] - values[i]);
+						slice_error.sumSq[e] += (double)diff * diff;
+						slice_error.maxError[e] = std::max(slice_error.maxError[e], diff);
+					}
+				}
+			}
+		}
+	});
+
+	FillReport(report, errors, numEncoded, (uint64_t)width * height * depth, (uint64_t)blocks_x * blocks_y * depth * block_bytes);
+}
+
+namespace NoisePacker
+{
+	void QuantizeUnorm8(const float* src, uint32_t numChannels, uint32_t width, uint32_t height, uint32_t depth,
+		bool dither, uint8_t* dst, Report* report)
+	{
+		Quantize(src, numChannels, width, height, depth, dither, dst, numChannels, report);
+	}
+
+	void QuantizeRGBA8(const float* src, uint32_t numChannels, uint32_t width, uint32_t height, uint32_t depth,
+		bool dither, uint8_t* dst, Report* report)
+	{
+		Quantize(src, numChannels, width, height, depth, dither, dst, 4, report);
+	}
+
+	size_t BC4Size(uint32_t width, uint32_t height, uint32_t depth)
+	{
+		return (size_t)std::max(1u, (width + 3) / 4) * std::max(1u, (height + 3) / 4) * depth * 8;
+	}
+
+	size_t BC5Size(uint32_t width, uint32_t height, uint32_t depth)
+	{
+		return BC4Size(width, height, depth) * 2;
+	}
+
+	void EncodeBC4(const float* src, uint32_t numChannels, uint32_t channel, uint32_t width, uint32_t height, uint32_t depth,
+		uint8_t* dst, Report* report)
+	{
+		assert(channel < numChannels);
+		EncodeBlocks(src, numChannels, &channel, 1, width, height, depth, dst, report);
+	}
+
+	void EncodeBC5(const float* src, uint32_t numChannels, uint32_t channel0, uint32_t channel1, uint32_t width, uint32_t height, uint32_t depth,
+		uint8_t* dst, Report* report)
+	{
+		assert(channel0 < numChannels && channel1 < numChannels);
+		uint32_t channels[2] = { channel0, channel1 };
+		EncodeBlocks(src, numChannels, channels, 2, width, height, depth, dst, report);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,40 @@
+#pragma once
+#include "stdafx.h"
+
+// CPU encoders that shrink normalized [0, 1] float noise volumes. Input volumes are
+// tightly packed, numChannels floats per voxel, x fastest, then y, then z.
+// Block compressed outputs are encoded slice by slice, so they can be uploaded as
+// BC4 / BC5 Texture3D data directly.
+namespace NoisePacker
+{
+	struct Report
+	{
+		uint32_t numChannels;
+		float rmse[4];
+		float maxError[4];
+		uint64_t sourceBytes;
+		uint64_t packedBytes;
+
+		float CompressionRatio() const { return packedBytes > 0 ? (float)sourceBytes / packedBytes : 0.0f; }
+	};
+
+	// 8 bit per channel, optionally with serpentine Floyd-Steinberg error diffusion inside every slice.
+	// dst receives numChannels bytes per voxel.
+	void QuantizeUnorm8(const float* src, uint32_t numChannels, uint32_t width, uint32_t height, uint32_t depth,
+		bool dither, uint8_t* dst, Report* report = nullptr);
+
+	// Same as QuantizeUnorm8 but writes 4 bytes per voxel (unused channels are 255) for R8G8B8A8_UNORM upload.
+	void QuantizeRGBA8(const float* src, uint32_t numChannels, uint32_t width, uint32_t height, uint32_t depth,
+		bool dither, uint8_t* dst, Report* report = nullptr);
+
+	size_t BC4Size(uint32_t width, uint32_t height, uint32_t depth);
+	size_t BC5Size(uint32_t width, uint32_t height, uint32_t depth);
+
+	// One channel of src to BC4_UNORM
+	void EncodeBC4(const float* src, uint32_t numChannels, uint32_t channel, uint32_t width, uint32_t height, uint32_t depth,
+		uint8_t* dst, Report* report = nullptr);
+
+	// Two channels of src to BC5_UNORM
+	void EncodeBC5(const float* src, uint32_t numChannels, uint32_t channel0, uint32_t channel1, uint32_t width, uint32_t height, uint32_t depth,
+		uint8_t* dst, Report* report = nullptr);
+}
\ No newline at end of file
@@ -0,0 +1,274 @@
+#include "stdafx.h"
+#include "VolumeNoiseStreamer.h"
+#include "FastNoiseLite.h"
+#include <chrono>
+
+static void ThrowLastError()
+{
+	ThrowIfFailed(HRESULT_FROM_WIN32(GetLastError()));
+}
+
+// Same state setup as GenerateVolumeNoise_CS
+static fnl_state CreateWarpState(const NoiseState& state)
+{
+	fnl_state warp_state = fnlCreateState(state.seed);
+	warp_state.domain_warp_type = state.domain_warp_type - 1;
+	warp_state.frequency = state.domain_warp_frequency;
+	warp_state.rotation_type_3d = state.domain_warp_rotation_type_3d;
+	warp_state.domain_warp_amp = state.domain_warp_amp;
+	warp_state.fractal_type = state.domain_warp_fractal_type == 0 ? 0 : state.domain_warp_fractal_type + 3;
+	warp_state.octaves = state.domain_warp_octaves;
+	warp_state.lacunarity = state.domain_warp_lacunarity;
+	warp_state.gain = state.domain_warp_gain;
+	return warp_state;
+}
+
+static fnl_state CreateNoiseState(const NoiseState& state)
+{
+	fnl_state noise_state = fnlCreateState(state.seed);
+	noise_state.frequency = state.frequency;
+	noise_state.noise_type = state.noise_type;
+	noise_state.rotation_type_3d = state.rotation_type_3d;
+	noise_state.fractal_type = state.fractal_type;
+	noise_state.octaves = state.octaves;
+	noise_state.lacunarity = state.lacunarity;
+	noise_state.gain = state.gain;
+	noise_state.weighted_strength = state.weighted_strength;
+	noise_state.ping_pong_strength = state.ping_pong_strength;
+	noise_state.cellular_distance_func = state.cellular_distance_func;
+	noise_state.cellular_return_type = state.cellular_return_type;
+	noise_state.cellular_jitter_mod = state.cellular_jitter_mod;
+	return noise_state;
+}
+
+VolumeNoiseStreamer::VolumeNoiseStreamer()
+	: m_file(INVALID_HANDLE_VALUE),
+	m_mapping(nullptr),
+	m_width(0),
+	m_height(0),
+	m_depth(0),
+	m_slabDepth(8),
+	m_numThreads(std::max(1u, std::thread::hardware_concurrency())),
+	m_mappedBytes(0),
+	m_peakMappedBytes(0)
+{
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	m_allocationGranularity = info.dwAllocationGranularity;
+	ZeroMemory(&m_stats, sizeof(Stats));
+}
+
+VolumeNoiseStreamer::~VolumeNoiseStreamer()
+{
+	Close();
+}
+
+void VolumeNoiseStreamer::Close()
+{
+	if (m_mapping != nullptr)
+	{
+		CloseHandle(m_mapping);
+		m_mapping = nullptr;
+	}
+	if (m_file != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_file);
+		m_file = INVALID_HANDLE_VALUE;
+	}
+}
+
+template <typename Func>
+void VolumeNoiseStreamer::ForEachSlab(Func func)
+{
+	uint32_t num_slabs = (m_depth + m_slabDepth - 1) / m_slabDepth;
+	std::atomic<uint32_t> next_slab(0);
+	std::exception_ptr error;
+	std::mutex error_mutex;
+
+	auto worker = [&](uint32_t threadIndex)
+	{
+		try
+		{
+			for (uint32_t slab = next_slab++; slab < num_slabs; slab = next_slab++)
+			{
+				uint32_t first_slice = slab * m_slabDepth;
+				uint32_t num_slices = std::min(m_slabDepth, m_depth - first_slice);
+				func(threadIndex, first_slice, num_slices);
+			}
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(error_mutex);
+			if (!error)
+				error = std::current_exception();
+			next_slab = num_slabs;
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (uint32_t i = 1; i < m_numThreads; ++i)
+		threads.emplace_back(worker, i);
+	worker(0);
+	for (auto& t : threads)
+		t.join();
+
+	if (error)
+		std::rethrow_exception(error);
+}
+
+void VolumeNoiseStreamer::Generate(const std::wstring& fileName, uint32_t width, uint32_t height, uint32_t depth, const NoiseState& state, bool remapValueRange)
+{
+	assert(width > 0 && height > 0 && depth > 0);
+	Close();
+
+	m_width = width;
+	m_height = height;
+	m_depth = depth;
+	m_mappedBytes = 0;
+	m_peakMappedBytes = 0;
+	ZeroMemory(&m_stats, sizeof(Stats));
+
+	uint64_t file_bytes = sizeof(VolumeNoiseFileHeader) + (uint64_t)width * height * depth * sizeof(float);
+	m_file = CreateFileW(fileName.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (m_file == INVALID_HANDLE_VALUE)
+		ThrowLastError();
+	m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READWRITE, (DWORD)(file_bytes >> 32), (DWORD)(file_bytes & 0xffffffff), nullptr);
+	if (m_mapping == nullptr)
+		ThrowLastError();
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	// Pass 1: evaluate noise, every worker keeps its own min/max
+	std::vector<float> thread_min(m_numThreads, FLT_MAX);
+	std::vector<float> thread_max(m_numThreads, -FLT_MAX);
+	ForEachSlab([&](uint32_t threadIndex, uint32_t firstSlice, uint32_t numSlices)
+	{
+		GenerateSlab(state, firstSlice, numSlices, thread_min[threadIndex], thread_max[threadIndex]);
+	});
+
+	float min_value = FLT_MAX;
+	float max_value = -FLT_MAX;
+	for (uint32_t i = 0; i < m_numThreads; ++i)
+	{
+		min_value = std::min(min_value, thread_min[i]);
+		max_value = std::max(max_value, thread_max[i]);
+	}
+
+	auto generated = std::chrono::high_resolution_clock::now();
+
+	// Pass 2: remap to [0, 1]
+	if (remapValueRange)
+	{
+		bool invert = state.GetInvert();
+		ForEachSlab([&](uint32_t, uint32_t firstSlice, uint32_t numSlices)
+		{
+			RemapSlab(firstSlice, numSlices, min_value, max_value, invert);
+		});
+	}
+
+	auto remapped = std::chrono::high_resolution_clock::now();
+
+	void* view = MapViewOfFile(m_mapping, FILE_MAP_WRITE, 0, 0, sizeof(VolumeNoiseFileHeader));
+	if (view == nullptr)
+		ThrowLastError();
+	VolumeNoiseFileHeader* header = reinterpret_cast<VolumeNoiseFileHeader*>(view);
+	header->magic = VolumeNoiseFileHeader::kMagic;
+	header->width = width;
+	header->height = height;
+	header->depth = depth;
+	header->minValue = min_value;
+	header->maxValue = max_value;
+	header->remapped = remapValueRange ? 1 : 0;
+	header->reserved = 0;
+	FlushViewOfFile(view, 0);
+	UnmapViewOfFile(view);
+
+	Close();
+
+	m_stats.generateSeconds = std::chrono::duration<double>(generated - start).count();
+	m_stats.remapSeconds = std::chrono::duration<double>(remapped - generated).count();
+	m_stats.fileBytes = file_bytes;
+	m_stats.peakMappedBytes = m_peakMappedBytes;
+	m_stats.minValue = min_value;
+	m_stats.maxValue = max_value;
+}
+
+float* VolumeNoiseStreamer::MapSlab(uint32_t firstSlice, uint32_t numSlices, void** viewBase, uint64_t* viewBytes)
+{
+	uint64_t slice_bytes = (uint64_t)m_width * m_height * sizeof(float);
+	uint64_t offset = sizeof(VolumeNoiseFileHeader) + firstSlice * slice_bytes;
+	// view offsets have to be a multiple of the allocation granularity
+	uint64_t aligned_offset = offset & ~(m_allocationGranularity - 1);
+	uint64_t bytes = offset - aligned_offset + numSlices * slice_bytes;
+
+	void* view = MapViewOfFile(m_mapping, FILE_MAP_WRITE, (DWORD)(aligned_offset >> 32), (DWORD)(aligned_offset & 0xffffffff), (SIZE_T)bytes);
+	if (view == nullptr)
+		ThrowLastError();
+
+	uint64_t mapped = (m_mappedBytes += bytes);
+	uint64_t peak = m_peakMappedBytes;
+	while (mapped > peak && !m_peakMappedBytes.compare_exchange_weak(peak, mapped));
+
+	*viewBase = view;
+	*viewBytes = bytes;
+	return reinterpret_cast<float*>(reinterpret_cast<uint8_t*>(view) + (offset - aligned_offset));
+}
+
+void VolumeNoiseStreamer::UnmapSlab(void* viewBase, uint64_t viewBytes)
+{
+	FlushViewOfFile(viewBase, 0);
+	UnmapViewOfFile(viewBase);
+	m_mappedBytes -= viewBytes;
+}
+
+void VolumeNoiseStreamer::GenerateSlab(const NoiseState& state, uint32_t firstSlice, uint32_t numSlices, float& minValue, float& maxValue)
+{
+	void* view;
+	uint64_t view_bytes;
+	float* data = MapSlab(firstSlice, numSlices, &view, &view_bytes);
+
+	bool domain_warp = state.domain_warp_type > 0;
+	fnl_state warp_state = CreateWarpState(state);
+	fnl_state noise_state = CreateNoiseState(state);
+
+	for (uint32_t z = 0; z < numSlices; ++z)
+	{
+		for (uint32_t y = 0; y < m_height; ++y)
+		{
+			float* row = data + ((uint64_t)z * m_height + y) * m_width;
+			for (uint32_t x = 0; x < m_width; ++x)
+			{
+				float px = (float)x;
+				float py = (float)y;
+				float pz = (float)(firstSlice + z);
+				if (domain_warp)
+					fnlDomainWarp3D(warp_state, px, py, pz);
+
+				float val = fnlGetNoise3D(noise_state, px, py, pz);
+				minValue = std::min(minValue, val);
+				maxValue = std::max(maxValue, val);
+				row[x] = val;
+			}
+		}
+	}
+
+	UnmapSlab(view, view_bytes);
+}
+
+void VolumeNoiseStreamer::RemapSlab(uint32_t firstSlice, uint32_t numSlices, float minValue, float maxValue, bool invert)
+{
+	void* view;
+	uint64_t view_bytes;
+	float* data = MapSlab(firstSlice, numSlices, &view, &view_bytes);
+
+	float range = maxValue - minValue;
+	float inv_range = range > 0.0f ? 1.0f / range : 0.0f;
+	uint64_t count = (uint64_t)numSlices * m_width * m_height;
+	for (uint64_t i = 0; i < count; ++i)
+	{
+		float val = (data[i] - minValue) * inv_range;
+		data[i] = invert ? 1.0f - val : val;
+	}
+
+	UnmapSlab(view, view_bytes);
+}
\ No newline at end of file
@@ -0,0 +1,77 @@
+#pragma once
+#include "stdafx.h"
+#include "NoiseGenerator.h"
+#include <atomic>
+
+// Generates volume noise on the CPU slab by slab and streams the result into a
+// memory mapped file, so volumes far larger than a VolumeColorBuffer (512^3 and up)
+// can be baked offline. Only the slabs currently being written are mapped, peak
+// memory is roughly NumThreads * SlabBytes regardless of the volume size.
+//
+// File layout: VolumeNoiseFileHeader followed by width * height * depth floats,
+// x fastest, then y, then z.
+struct VolumeNoiseFileHeader
+{
+	static const uint32_t kMagic = 0x46534E56; // "VNSF"
+
+	uint32_t magic;
+	uint32_t width;
+	uint32_t height;
+	uint32_t depth;
+	float minValue;
+	float maxValue;
+	uint32_t remapped;
+	uint32_t reserved;
+};
+
+class VolumeNoiseStreamer
+{
+public:
+	struct Stats
+	{
+		double generateSeconds;
+		double remapSeconds;
+		uint64_t fileBytes;
+		uint64_t peakMappedBytes;
+		float minValue;
+		float maxValue;
+	};
+
+	VolumeNoiseStreamer();
+	~VolumeNoiseStreamer();
+
+	VolumeNoiseStreamer(const VolumeNoiseStreamer&) = delete;
+	VolumeNoiseStreamer& operator=(const VolumeNoiseStreamer&) = delete;
+
+	void SetSlabDepth(uint32_t depth) { m_slabDepth = depth > 0 ? depth : 1; }
+	void SetNumThreads(uint32_t numThreads) { m_numThreads = numThreads > 0 ? numThreads : 1; }
+
+	// First pass evaluates the noise and reduces min/max, second pass remaps every slab
+	// to [0, 1] (and inverts if requested) exactly like MapVolumeNoiseColor_CS.
+	void Generate(const std::wstring& fileName, uint32_t width, uint32_t height, uint32_t depth, const NoiseState& state, bool remapValueRange);
+
+	const Stats& GetStats() const { return m_stats; }
+
+private:
+	float* MapSlab(uint32_t firstSlice, uint32_t numSlices, void** viewBase, uint64_t* viewBytes);
+	void UnmapSlab(void* viewBase, uint64_t viewBytes);
+	void GenerateSlab(const NoiseState& state, uint32_t firstSlice, uint32_t numSlices, float& minValue, float& maxValue);
+	void RemapSlab(uint32_t firstSlice, uint32_t numSlices, float minValue, float maxValue, bool invert);
+	template <typename Func>
+	void ForEachSlab(Func func);
+	void Close();
+
+private:
+	HANDLE m_file;
+	HANDLE m_mapping;
+	uint32_t m_width;
+	uint32_t m_height;
+	uint32_t m_depth;
+	uint32_t m_slabDepth;
+	uint32_t m_numThreads;
+	uint64_t m_allocationGranularity;
+
+	std::atomic<uint64_t> m_mappedBytes;
+	std::atomic<uint64_t> m_peakMappedBytes;
+	Stats m_stats;
+};
\ No newline at end of file
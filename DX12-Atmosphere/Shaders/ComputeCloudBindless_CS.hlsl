@@ -0,0 +1,2 @@
+#define BINDLESS
+#include "ComputeCloud_CS.hlsl"
\ No newline at end of file
@@ -0,0 +1,2 @@
+#define BINDLESS
+#include "ComputeCloudCubemap_CS.hlsl"
\ No newline at end of file
@@ -0,0 +1,58 @@
+#define RADIANCE_API_ENABLED
+#include "VolumetricCloudCommon.hlsli"
+
+// The sky probe, six faces in D3D cube order: sky, ground and clouds seen from the camera.
+// A dispatch covers one tile of CubeFace from CubeTileOrigin, see CloudCubemapScheduler.
+RWTexture2DArray<float4> SkyCube : register(u1);
+
+float3 CubeTexelToDir(uint face, float2 uv)
+{
+	// uv in [-1, 1], +y down the face
+	float3 dir;
+	switch (face)
+	{
+	case 0: dir = float3(1.0, -uv.y, -uv.x); break;
+	case 1: dir = float3(-1.0, -uv.y, uv.x); break;
+	case 2: dir = float3(uv.x, 1.0, uv.y); break;
+	case 3: dir = float3(uv.x, -1.0, -uv.y); break;
+	case 4: dir = float3(uv.x, -uv.y, 1.0); break;
+	default: dir = float3(-uv.x, -uv.y, -1.0); break;
+	}
+	return normalize(dir);
+}
+
+[numthreads(8, 8, 1)]
+void main(uint3 globalID : SV_DispatchThreadID)
+{
+	uint width, height, faces;
+	SkyCube.GetDimensions(width, height, faces);
+	uint2 texel = CubeTileOrigin + globalID.xy;
+	if (any(texel >= uint2(width, height)))
+		return;
+
+	float2 uv = (float2(texel) + 0.5) / float2(width, height) * 2.0 - 1.0;
+	float3 world_dir = CubeTexelToDir(CubeFace, uv);
+
+	float4 bg = ComputeBackground(world_dir);
+	if (bg.a > 0.0)
+	{
+		SkyCube[uint3(texel, CubeFace)] = float4(bg.rgb, 1.0);
+		return;
+	}
+
+	float3 start_pos, end_pos;
+	// assert camera near ground
+	RaySphereIntersection(CameraPosition, world_dir, INNER_RADIUS, start_pos);
+	RaySphereIntersection(CameraPosition, world_dir, OUTER_RADIUS, end_pos);
+
+	// the blue noise jitter per texel of the face, the faces share it
+	float4 cloud_distance;
+	float4 v = RaymarchCloud(texel, start_pos, end_pos, bg.rgb, cloud_distance);
+	float3 cloud_pos = v.a > 0.0 ? cloud_distance.xyz : end_pos;
+
+	// same as the screen passes
+	float3 transmittance = GetTransmittanceToPoint(CameraPosition * 0.001 - float3(0.0, -EarthRadius, 0.0), cloud_pos * 0.00001 - float3(0.0, -EarthRadius, 0.0), LightDir);
+	v.rgb = (v.rgb * 1.8 - 0.1) * transmittance;
+
+	SkyCube[uint3(texel, CubeFace)] = float4(bg.rgb * (1.0 - v.a) + v.rgb, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,19 @@
+// DescriptorTableCacheBenchmark: a dispatch writes what every view of its table points at,
+// a view is one element of a buffer that holds its own index
+#define TABLE_SIZE 10
+
+StructuredBuffer<uint> Views[TABLE_SIZE] : register(t0);
+RWStructuredBuffer<uint> Output : register(u0);
+
+cbuffer CheckConstants : register(b0)
+{
+	uint OutputOffset;
+};
+
+[numthreads(1, 1, 1)]
+void main()
+{
+	[unroll]
+	for (uint i = 0; i < TABLE_SIZE; ++i)
+		Output[OutputOffset + i] = Views[i][0];
+}
\ No newline at end of file
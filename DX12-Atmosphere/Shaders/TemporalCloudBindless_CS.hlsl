@@ -0,0 +1,2 @@
+#define BINDLESS
+#include "TemporalCloud_CS.hlsl"
\ No newline at end of file
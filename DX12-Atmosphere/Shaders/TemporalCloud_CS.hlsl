@@ -3,6 +3,24 @@
 #define RADIANCE_API_ENABLED
 #include "VolumetricCloudCommon.hlsli"
 
+// rank of each pixel in a ScheduleSize x ScheduleSize tile, see CloudUpdateScheduler
+#ifdef BINDLESS
+#define UpdateSchedule Bindless2DUint[BindlessSlot(10)]
+#else
+Texture2D<uint> UpdateSchedule : register(t10);
+#endif
+
+// pixels raymarched off the schedule, read back for CloudUpdateScheduler::EndFrame
+RWByteAddressBuffer ForcedRays : register(u1);
+groupshared uint s_forcedRays;
+
+bool IsScheduledForUpdate(uint2 pixel)
+{
+	uint period = ScheduleSize * ScheduleSize;
+	uint rank = UpdateSchedule[pixel % ScheduleSize];
+	return (rank + period - ScheduleWindowStart) % period < ScheduleWindowCount;
+}
+
 float HPDot(float3 FloorV0, float3 FractV0, float3 FloorV1, float3 FractV1, out float fractR)
 {
 	float inter0 = dot(FloorV0, FractV1);
@@ -31,62 +49,37 @@ float HP2(float fl, float fr, out float frR)
 }
 
 [numthreads(8, 8, 1)]
-void main(uint3 globalID : SV_DispatchThreadID, uint3 groupThreadID : SV_GroupThreadID)
+void main(uint3 globalID : SV_DispatchThreadID, uint groupIndex : SV_GroupIndex)
 {
 	float4 frag_color, bloom, alphaness, cloud_distance;
 	float2 pixel_coord = float2(globalID.xy) + 0.5f;
 	float3 world_dir = ComputeWorldViewDir(pixel_coord);
 	float2 uv = WorldViewDirToUV(world_dir, PrevViewProj);
 
-	float3 EarthCenter = float3(CameraPosition.x, -EarthRadius, CameraPosition.z);
-	float3 camera = CameraPosition;
-	camera.y *= 0.001f;
-	float3 p = camera - EarthCenter;
-
-	float p_dot_v = dot(p, world_dir);
-	float p_dot_p = dot(p, p);
-	float ray_earth_center_squared_distance = p_dot_p - p_dot_v * p_dot_v;
-	float distance_to_intersection = -p_dot_v - sqrt(EarthCenter.y * EarthCenter.y - ray_earth_center_squared_distance);
-	
-	/*float3 floor_p = floor(p);
-	float3 fract_p = frac(p);
-	float fract_p_dot_v;
-	float floor_p_dot_v = HPDot(floor_p, fract_p, world_dir, fract_p_dot_v);
-	float fract_p_dot_p;
-	float floor_p_dot_p = HPDot(floor_p, fract_p, floor_p, fract_p, fract_p_dot_p);
-	float fl_r = floor_p_dot_p - floor_p_dot_v * floor_p_dot_v;
-	float fr_r = fract_p_dot_p - fract_p_dot_v * fract_p_dot_v;
-	float distance_to_intersection = -(floor_p_dot_v + fract_p_dot_v) - sqrt(EarthCenter.y * EarthCenter.y - fl_r + fr_r);*/
-
-	float ground_alpha = 0.0;
-	float3 ground_radiance;
-	if (distance_to_intersection > 0.0)
-	{
-		float3 intersection_point = camera + distance_to_intersection * world_dir;
-		float3 normal = normalize(intersection_point - EarthCenter);
-		float3 sky_irradiance;
-		float3 sun_irradiance = GetSunAndSkyIrradiance(intersection_point - EarthCenter, normal, LightDir, sky_irradiance);
-		ground_radiance = GroundAlbedo * (1.0 / PI) * (sun_irradiance + sky_irradiance);
-		float3 transmittance;
-		float3 in_scatter = GetSkyRadianceToPoint(camera - EarthCenter, intersection_point - EarthCenter, 0, LightDir, transmittance);
-		ground_radiance = ground_radiance * transmittance + in_scatter;
-		ground_alpha = 1.0;
-	}
-	float3 transmittance;
-	float3 radiance = GetSkyRadiance(camera - EarthCenter, world_dir, 0, LightDir, transmittance);
-	if (dot(world_dir, LightDir) > SunSize)
-	{
-		radiance += transmittance * GetSolarRadiance();
-	}
-	radiance = lerp(radiance, ground_radiance, ground_alpha);
-	frag_color.rgb = pow(1.0 - exp(-radiance / WhitePoint * Exposure), 1.0 / 2.2);
-	frag_color.a = 1.0;
-
-	if (distance_to_intersection > 0.0)
+	if (groupIndex == 0)
+		s_forcedRays = 0;
+	GroupMemoryBarrierWithGroupSync();
+
+	// no history off screen, and a fast moving pixel smears what it reprojects
+	bool force_update = any(uv < 0.0) || any(uv > 1.0);
+	float2 motion = (uv - pixel_coord * Resolution.zw) * Resolution.xy;
+	force_update = force_update || (ForceUpdateMotion > 0.0 && dot(motion, motion) > ForceUpdateMotion * ForceUpdateMotion);
+	bool scheduled = IsScheduledForUpdate(globalID.xy);
+
+	// one global atomic per group, before any thread returns
+	frag_color = ComputeBackground(world_dir);
+	if (frag_color.a <= 0.0 && force_update && !scheduled && all(pixel_coord < Resolution.xy))
+		InterlockedAdd(s_forcedRays, 1);
+	GroupMemoryBarrierWithGroupSync();
+	if (groupIndex == 0 && s_forcedRays > 0)
+		ForcedRays.InterlockedAdd(0, s_forcedRays);
+
+	if (frag_color.a > 0.0)
 	{
 		CloudColor[globalID.xy] = frag_color;
 		return;
 	}
+	frag_color.a = 1.0;
 
 	//float3 ground_pos;
 	////bool ground = RaySphereIntersection(CameraPosition, world_dir, EarthRadius * 10.0, ground_pos);
@@ -97,14 +90,11 @@ void main(uint3 globalID : SV_DispatchThreadID, uint3 groupThreadID : SV_GroupTh
 	//	return;
 	//}
 
-	uint frame_index = FrameIndex % 16;
-	uint2 quarter_group_id = groupThreadID.xy % uint2(4, 4);
-	uint quarter_group_index = quarter_group_id.y * 4 + quarter_group_id.x;
-
 	// do raymarch
-	if (frame_index == quarter_group_index || (any(uv < 0.0) || any(uv > 1.0)))
+	if (scheduled || force_update)
 	{
 		float3 start_pos, end_pos;
+		float3 transmittance;
 		float4 v = 0.0f;
 
 		float4 bg = frag_color;
@@ -137,7 +127,6 @@ void main(uint3 globalID : SV_DispatchThreadID, uint3 groupThreadID : SV_GroupTh
 	else
 	{
 		uint2 tex_coord = uint2(uv * Resolution.xy);
-		//uv = (float2(tex_coord) + HaltonSequence[( quarter_group_index) % 16]) * Resolution.zw;
 		//CloudColor[globalID.xy] = PreCloudColor[tex_coord];
 		//CloudColor[globalID.xy] = PreCloudColor.SampleLevel(LinearRepeatSampler, uv, 0);
 		CloudColor[globalID.xy] = PreCloudColor.SampleLevel(LinearClampSampler, uv, 0);
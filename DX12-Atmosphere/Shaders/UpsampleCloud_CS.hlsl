@@ -0,0 +1,95 @@
+#define RADIANCE_API_ENABLED
+#include "VolumetricCloudCommon.hlsli"
+
+// output of ComputeQuarterCloud_CS, PreCloudColor (t3) is last frame's full res result
+#ifdef BINDLESS
+#define LowResCloud Bindless2D[BindlessSlot(10)]
+#define LowResCloudDepth Bindless2DFloat2[BindlessSlot(11)]
+#else
+Texture2D<float4> LowResCloud : register(t10);
+Texture2D<float2> LowResCloudDepth : register(t11);
+#endif
+
+// Joint bilateral upsample, the CPU version is CloudUpsampleFilter
+[numthreads(8, 8, 1)]
+void main(uint3 globalID : SV_DispatchThreadID)
+{
+	float2 pixel_coord = float2(globalID.xy) + 0.5f;
+	float3 world_dir = ComputeWorldViewDir(pixel_coord);
+
+	float4 bg = ComputeBackground(world_dir);
+	if (bg.a > 0.0)
+	{
+		CloudColor[globalID.xy] = float4(bg.rgb, 1.0);
+		return;
+	}
+
+	// distance to the bottom of the layer, the low res texels carry the same for their own ray
+	float3 start_pos;
+	RaySphereIntersection(CameraPosition, world_dir, INNER_RADIUS, start_pos);
+	float guide = distance(CameraPosition, start_pos);
+
+	uint2 size;
+	LowResCloud.GetDimensions(size.x, size.y);
+	float2 p = (pixel_coord - LowResJitter) / Downscale;
+	float2 base = floor(p);
+	float2 f = p - base;
+
+	float4 layer = 0.0, bilinear_layer = 0.0;
+	float cloud_depth = 0.0, bilinear_depth = 0.0, weight_sum = 0.0;
+	float3 color_min = 1e20, color_max = -1e20;
+	[unroll]
+	for (uint i = 0; i < 4; ++i)
+	{
+		int2 offset = int2(i & 1, i >> 1);
+		int2 tap = clamp(int2(base) + offset, 0, int2(size) - 1);
+		float4 tap_layer = LowResCloud[tap];
+		float2 tap_depth = LowResCloudDepth[tap];
+
+		float w_b = (offset.x ? f.x : 1.0 - f.x) * (offset.y ? f.y : 1.0 - f.y);
+		float w_d = 1.0;
+		if (UpsampleDepthSigma > 0.0)
+			w_d = tap_depth.y > 0.0 ? exp(-abs(tap_depth.y - guide) / (guide * UpsampleDepthSigma)) : 0.0;
+		float w = w_b * w_d;
+
+		layer += tap_layer * w;
+		cloud_depth += tap_depth.x * w;
+		weight_sum += w;
+		bilinear_layer += tap_layer * w_b;
+		bilinear_depth += tap_depth.x * w_b;
+
+		// the history may only take colors the usable taps agree with
+		if (w_d > 0.01)
+		{
+			float3 tap_color = bg.rgb * tap_layer.a + tap_layer.rgb;
+			color_min = min(color_min, tap_color);
+			color_max = max(color_max, tap_color);
+		}
+	}
+
+	// every tap disagrees with the guide, nothing better than bilinear
+	if (weight_sum > 1e-4)
+	{
+		layer /= weight_sum;
+		cloud_depth /= weight_sum;
+	}
+	else
+	{
+		layer = bilinear_layer;
+		cloud_depth = bilinear_depth;
+	}
+
+	float4 color = float4(bg.rgb * layer.a + layer.rgb, Threshold(1.0 - layer.a, 0.2));
+	if (UpsampleHistoryWeight > 0.0 && color_min.x <= color_max.x)
+	{
+		// clouds are not at infinity once the camera moves, reproject the cloud position
+		bool in_front;
+		float2 uv = WorldPositionToUV(CameraPosition + world_dir * cloud_depth, PrevViewProj, in_front);
+		if (in_front && all(uv >= 0.0) && all(uv <= 1.0))
+		{
+			float4 history = PreCloudColor.SampleLevel(LinearClampSampler, uv, 0);
+			color.rgb = lerp(color.rgb, clamp(history.rgb, color_min, color_max), UpsampleHistoryWeight);
+		}
+	}
+	CloudColor[globalID.xy] = color;
+}
\ No newline at end of file
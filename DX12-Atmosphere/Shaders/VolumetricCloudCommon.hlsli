@@ -1,3 +1,37 @@
+#ifdef BINDLESS
+// The whole BindlessHeap as one array per texture type, BindlessSlot(n) is the heap index of
+// what the table version reads from tn, set from root constants
+Texture2D<float4> Bindless2D[] : register(t0, space1);
+Texture3D<float4> Bindless3D[] : register(t0, space2);
+Texture2D<float> Bindless2DFloat[] : register(t0, space3);
+Texture3D<float> Bindless3DFloat[] : register(t0, space4);
+Texture2D<uint4> Bindless2DUint4[] : register(t0, space5);
+Texture2D<uint> Bindless2DUint[] : register(t0, space6);
+Texture2D<float2> Bindless2DFloat2[] : register(t0, space7);
+
+cbuffer BindlessSlots : register(b3)
+{
+	uint4 TextureSlots[5];
+}
+
+#define BindlessSlot(n) TextureSlots[(n) / 4][(n) % 4]
+
+#define CloudShapeTexture Bindless3D[BindlessSlot(0)]
+#define ErosionTexture Bindless3D[BindlessSlot(1)]
+#define WeatherTexture Bindless2D[BindlessSlot(2)]
+#define PreCloudColor Bindless2D[BindlessSlot(3)]
+#define CurlNoise Bindless2D[BindlessSlot(4)]
+#define Transmittance Bindless2D[BindlessSlot(5)]
+#define Scattering Bindless3D[BindlessSlot(6)]
+#define Irradiance_Texture Bindless2D[BindlessSlot(7)]
+#define SingleMieScattering Bindless3D[BindlessSlot(8)]
+#define BlueNoise Bindless3DFloat[BindlessSlot(9)]
+#define CloudShadowMap Bindless2DFloat[BindlessSlot(12)]
+#define WeatherIndirection Bindless2DUint4[BindlessSlot(13)]
+#define HeightDensityLut Bindless2DFloat[BindlessSlot(14)]
+#define MiePhaseLut Bindless2D[BindlessSlot(15)]
+#define ShadowVolumeTexture Bindless3DFloat[BindlessSlot(16)]
+#else
 Texture3D<float4> CloudShapeTexture : register(t0);
 Texture3D<float4> ErosionTexture : register(t1);
 Texture2D<float4> WeatherTexture : register(t2);
@@ -7,6 +41,13 @@ Texture2D<float4> Transmittance : register(t5);
 Texture3D<float4> Scattering : register(t6);
 Texture2D<float4> Irradiance_Texture : register(t7);
 Texture3D<float4> SingleMieScattering : register(t8);
+Texture3D<float> BlueNoise : register(t9);
+Texture2D<float> CloudShadowMap : register(t12);
+Texture2D<uint4> WeatherIndirection : register(t13);
+Texture2D<float> HeightDensityLut : register(t14);
+Texture2D<float4> MiePhaseLut : register(t15);
+Texture3D<float> ShadowVolumeTexture : register(t16);
+#endif
 
 RWTexture2D<float4> CloudColor : register(u0);
 
@@ -72,11 +113,75 @@ cbuffer CloudParameterCB : register(b2)
 	float4 CloudScatter;
 	float3 ABC;
 	float HGWeight;
+
+	int UseBlueNoise;
+	uint ScheduleSize;
+	uint ScheduleWindowStart;
+	uint ScheduleWindowCount;
+
+	float ForceUpdateMotion;
+	uint Downscale;
+	float2 LowResJitter;
+
+	float UpsampleDepthSigma;
+	float UpsampleHistoryWeight;
+	int AdaptiveMarch;
+	float CoarseStepScale;
+
+	float LodNearDistance;
+	float LodFarDistance;
+	float LodMipBias;
+	float MinTransmittance;
+
+	int FineZeroSamples;
+	int EnableCloudShadow;
+	float CloudShadowStrength;
+	float CloudShadowAerial;
+
+	float2 CloudShadowOrigin;
+	float CloudShadowExtent;
+	int VirtualWeather;
+
+	float2 VirtualWeatherOrigin;
+	uint2 VirtualWeatherTiles;
+
+	float VirtualWeatherTileSize;
+	float VirtualWeatherTileTexels;
+	float VirtualWeatherAtlasTexelSize;
+	int HeightLut;
+
+	float CloudType;
+	int CloudTypeFromWeather;
+	float2 HeightLutScale;
+
+	float2 HeightLutBias;
+	int MieLut;
+	float MieLutScale;
+
+	float MieLutBias;
+	int LightingModel;
+	int MsOctaves;
+	float MsAttenuation;
+
+	float MsContribution;
+	float MsEccentricity;
+	float MsSunScale;
+	float MsAmbient;
+
+	float MsPhaseScale;
+	// face and top left texel of the sky probe tile, see ComputeCloudCubemap_CS
+	int CubeFace;
+	uint2 CubeTileOrigin;
+
+	// CloudShadowVolume for RaymarchLight, 1 the stretch of the cone, 2 up to the top of the layer
+	int ShadowVolume;
+	float3 ShadowVolumeOrigin;
+	float3 ShadowVolumeInvSize;
+	float ShadowVolumeTop;
 }
 
 #define INNER_RADIUS (EarthRadius * 100 + CloudBottomRadius)
 #define OUTER_RADIUS (EarthRadius * 100 + CloudTopRadius)
-#define CLOUDS_MIN_TRANSMITTANCE 1e-1
 //#define LIGHT_DIR float3(-0.40825, 0.40825, 0.8165)
 #define LIGHT_DIR LightDir
 #define SUN_COLOR LightColor * float3(1.1, 1.1, 0.95)
@@ -113,6 +218,16 @@ float n1rand(float2 n)
 	return nrnd0;
 }
 
+// Spatiotemporal blue noise, one slice per frame so the temporal filter sees blue error over time too
+float BlueNoiseJitter(uint2 pixelCoord)
+{
+	if (UseBlueNoise == 0)
+		return n1rand(float2(pixelCoord));
+	uint3 size;
+	BlueNoise.GetDimensions(size.x, size.y, size.z);
+	return BlueNoise.Load(int4(pixelCoord % size.xy, FrameIndex % size.z, 0));
+}
+
 float3 ScreenToClip(float2 screenPos)
 {
 	float2 xy = screenPos * float2(2.0f, -2.0f) + float2(-1.0f, 1.0f);
@@ -137,6 +252,73 @@ float2 WorldViewDirToUV(float3 worldDir, float4x4 ViewProj)
 	return ndc.xy * float2(0.5, -0.5) + 0.5;
 }
 
+float2 WorldPositionToUV(float3 worldPos, float4x4 ViewProj, out bool inFront)
+{
+	float4 ndc = mul(ViewProj, float4(worldPos, 1.0));
+	inFront = ndc.w > 0.0;
+	ndc /= ndc.w;
+	return ndc.xy * float2(0.5, -0.5) + 0.5;
+}
+
+// Sun transmittance through the clouds above pos, pos slides along the sun onto the bottom
+// of the layer where the CloudShadowMap was built. 1 off the map and for a grazing sun.
+float SampleCloudShadow(float3 pos)
+{
+	if (EnableCloudShadow == 0 || LightDir.y < 1e-2)
+		return 1.0;
+	float layer_bottom = INNER_RADIUS - EarthRadius * 100;
+	float3 q = pos + LightDir * (max(layer_bottom - pos.y, 0.0) / LightDir.y);
+	float2 uv = (q.xz - CloudShadowOrigin) / CloudShadowExtent;
+	if (any(uv < 0.0) || any(uv > 1.0))
+		return 1.0;
+	return exp(-CloudShadowMap.SampleLevel(LinearClampSampler, uv, 0.0));
+}
+
+#ifdef RADIANCE_API_ENABLED
+// Sky, sun disk and ground behind the clouds, tone mapped. w is 1 where the ray hits the ground.
+float4 ComputeBackground(float3 worldDir)
+{
+	float3 EarthCenter = float3(CameraPosition.x, -EarthRadius, CameraPosition.z);
+	float3 camera = CameraPosition;
+	camera.y *= 0.001f;
+	float3 p = camera - EarthCenter;
+
+	float p_dot_v = dot(p, worldDir);
+	float p_dot_p = dot(p, p);
+	float ray_earth_center_squared_distance = p_dot_p - p_dot_v * p_dot_v;
+	float distance_to_intersection = -p_dot_v - sqrt(EarthCenter.y * EarthCenter.y - ray_earth_center_squared_distance);
+
+	float ground_alpha = 0.0;
+	float3 ground_radiance;
+	if (distance_to_intersection > 0.0)
+	{
+		float3 intersection_point = camera + distance_to_intersection * worldDir;
+		float3 normal = normalize(intersection_point - EarthCenter);
+		float3 sky_irradiance;
+		float3 sun_irradiance = GetSunAndSkyIrradiance(intersection_point - EarthCenter, normal, LightDir, sky_irradiance);
+		// the atmosphere is in km, the clouds in m on a flat ground
+		float ground_shadow = SampleCloudShadow(CameraPosition + worldDir * (distance_to_intersection * 1000.0));
+		float camera_shadow = SampleCloudShadow(CameraPosition);
+		sun_irradiance *= lerp(1.0, ground_shadow, CloudShadowStrength);
+		ground_radiance = GroundAlbedo * (1.0 / PI) * (sun_irradiance + sky_irradiance);
+		float3 transmittance;
+		float3 in_scatter = GetSkyRadianceToPoint(camera - EarthCenter, intersection_point - EarthCenter, 0, LightDir, transmittance);
+		// the air between the camera and the ground is lit about as much as its two ends
+		in_scatter *= lerp(1.0, 0.5 * (camera_shadow + ground_shadow), CloudShadowAerial);
+		ground_radiance = ground_radiance * transmittance + in_scatter;
+		ground_alpha = 1.0;
+	}
+	float3 transmittance;
+	float3 radiance = GetSkyRadiance(camera - EarthCenter, worldDir, 0, LightDir, transmittance);
+	if (dot(worldDir, LightDir) > SunSize)
+	{
+		radiance += transmittance * GetSolarRadiance();
+	}
+	radiance = lerp(radiance, ground_radiance, ground_alpha);
+	return float4(pow(1.0 - exp(-radiance / WhitePoint * Exposure), 1.0 / 2.2), ground_alpha);
+}
+#endif
+
 bool RaySphereIntersection(float3 ro, float3 rd, float radius, out float3 startPos)
 {
 	float t;
@@ -187,6 +369,28 @@ float2 WorldPosToUV(float3 pos)
 	return pos.xz / OUTER_RADIUS + 0.5;
 }
 
+// Weather at pos: the repeating WeatherTexture, or with VirtualWeather the tile of the
+// CloudVirtualWeather atlas the indirection table points to. No clouds over a tile
+// that isn't resident yet or off the world.
+float3 SampleWeather(float3 pos)
+{
+	if (VirtualWeather == 0)
+		return WeatherTexture.SampleLevel(LinearRepeatSampler, WorldPosToUV(pos), 0.0).rgb;
+
+	float2 tile_pos = (pos.xz - VirtualWeatherOrigin) / VirtualWeatherTileSize;
+	int2 tile = int2(floor(tile_pos));
+	if (any(tile < 0) || any(tile >= int2(VirtualWeatherTiles)))
+		return 0.0;
+	uint4 entry = WeatherIndirection.Load(int3(tile, 0));
+	if (entry.a == 0)
+		return 0.0;
+
+	// inside the border of the slot, texel 1 is the first one of the tile
+	float2 local = 1.0 + frac(tile_pos) * (VirtualWeatherTileTexels - 2.0);
+	float2 uv = (entry.xy * VirtualWeatherTileTexels + local) * VirtualWeatherAtlasTexelSize;
+	return WeatherTexture.SampleLevel(LinearClampSampler, uv, 0.0).rgb;
+}
+
 float Remap(float originalValue, float originalMin, float originalMax, float newMin, float newMax)
 {
 	return newMin + (((originalValue - originalMin) / (originalMax - originalMin)) * (newMax - newMin));
@@ -221,6 +425,16 @@ float numericalMieFit(float costh)
 	return dot(expValues, expValWeight);
 }
 
+// Phase of the droplet distribution from row 0 of the CloudMiePhase table, the mean of
+// its three wavelengths baked at the scale of numericalMieFit, or numericalMieFit without it
+float MiePhase(float costh)
+{
+	if (MieLut == 0)
+		return numericalMieFit(costh);
+	float u = acos(clamp(costh, -1.0, 1.0)) * MieLutScale + MieLutBias;
+	return MiePhaseLut.SampleLevel(LinearClampSampler, float2(u, 1.0 / 6.0), 0.0).a;
+}
+
 float Beer(float d)
 {
 	return exp(-d * RainAbsorption);
@@ -251,6 +465,15 @@ float GetHeightDensityForCloud(float heightFraction, float cloudType)
 	return smoothstep(base_gradient.x, base_gradient.y, heightFraction) - smoothstep(base_gradient.z, base_gradient.w, heightFraction);
 }
 
+// GetHeightDensityForCloud / heightFraction, from the CloudHeightLut table when HeightLut is set.
+// Texel (i, j) of the table is at type i / (width - 1) and height j / (height - 1).
+float GetNormalizedHeightDensity(float heightFraction, float cloudType)
+{
+	if (HeightLut == 0)
+		return GetHeightDensityForCloud(heightFraction, cloudType) / heightFraction;
+	return HeightDensityLut.SampleLevel(LinearClampSampler, float2(cloudType, heightFraction) * HeightLutScale + HeightLutBias, 0.0);
+}
+
 //static float3 WindDirection = normalize(float3(0.5, 0.0, 0.1));
 static float3 WindDirection = normalize(float3(1.0, 0.0, 0.0));
 #define CLOUD_TOP_OFFSET 750.0
@@ -270,10 +493,10 @@ float SampleCloudDensity(float3 p, bool expensive, uint lod)
 	float low_freq_FBM = dot(low_frequency_noise.gba, float3(0.625, 0.25, 0.125));
 	float base_cloud = Remap(low_frequency_noise.r, -(1.0 - low_freq_FBM), 1.0, 0.0, 1.0);
 
-	float density = GetHeightDensityForCloud(height_fraction, 1.0);
-	base_cloud *= (density / height_fraction);
+	float3 weather_data = SampleWeather(p + animation);
+	float cloud_type = CloudTypeFromWeather != 0 ? weather_data.g : CloudType;
+	base_cloud *= GetNormalizedHeightDensity(height_fraction, cloud_type);
 
-	float3 weather_data = WeatherTexture.SampleLevel(LinearRepeatSampler, moving_uv, 0.0).rgb;
 	float cloud_coverage = weather_data.r * CloudCoverage;
 	float base_cloud_with_coverage = Remap(base_cloud, cloud_coverage, 1.0, 0.0, 1.0);
 	base_cloud_with_coverage *= cloud_coverage;
@@ -297,8 +520,45 @@ float SampleCloudDensity(float3 p, bool expensive, uint lod)
 	return max(0.0, base_cloud_with_coverage);
 }
 
+// Optical depth toward the sun from the CloudShadowVolume, false outside its box. Nothing lies
+// above the layer.
+bool SampleShadowVolume(float3 pos, out float depth)
+{
+	float3 uvw = (pos - ShadowVolumeOrigin) * ShadowVolumeInvSize;
+	depth = 0.0;
+	if (any(uvw.xz < 0.0) || any(uvw.xz > 1.0))
+		return false;
+	if (pos.y < ShadowVolumeTop)
+		depth = ShadowVolumeTexture.SampleLevel(LinearClampSampler, uvw, 0.0);
+	return true;
+}
+
+// What RaymarchLight returns, out of the volume: one fetch for the depth to the sun, or two
+// for the stretch the six cone steps cover, as CloudReferenceRenderer::GetShadowVolumeDepth
+bool ShadowVolumeLightDensity(float3 o, float stepSize, float3 lightDir, out float lightDensity)
+{
+	float depth, far_depth = 0.0;
+	lightDensity = 0.0;
+	if (!SampleShadowVolume(o, depth))
+		return false;
+	if (ShadowVolume == 1)
+	{
+		if (!SampleShadowVolume(o + lightDir * (6.0 * stepSize), far_depth))
+			return false;
+	}
+	lightDensity = max(depth - far_depth, 0.0) * Absorption;
+	return true;
+}
+
 float RaymarchLight(float3 o, float stepSize, float3 lightDir, float originalDensity, float lightDotEye, uint mipLevel)
 {
+	if (ShadowVolume != 0)
+	{
+		float light_density;
+		if (ShadowVolumeLightDensity(o, stepSize, lightDir, light_density))
+			return light_density;
+	}
+
 	float3 start_pos = o;
 	float ds = stepSize;
 	float3 ray_step = lightDir * ds;
@@ -349,6 +609,130 @@ float GetLightEnergy(float3 p, float heightFraction, float dl, float dsLoded, fl
 	return light_energy;
 }
 
+// Multiple scattering as octaves of single scattering (Wrenninge et al., "Oz: The Great and
+// Volumetric"): octave i sees MsAttenuation^i of the optical depth to the sun, carries
+// MsContribution^i of the light and a phase MsEccentricity^i of the way from isotropic to
+// phase, which integrates to 1. Light per unit sun irradiance, CloudPathTracer fits the constants.
+float MultipleScatteringOctaves(float lightDensity, float phase)
+{
+	float a = 1.0, b = 1.0, c = 1.0;
+	float energy = 0.0;
+	for (int i = 0; i < MsOctaves; ++i)
+	{
+		energy += b * lerp(0.079577471, phase, c) * exp(-lightDensity * a);
+		a *= MsAttenuation;
+		b *= MsContribution;
+		c *= MsEccentricity;
+	}
+	return energy;
+}
+
+// In-scattered light over one step of length ds through densitySample, not yet weighted by the transmittance in front of it
+float3 IntegrateCloudStep(float3 pos, float densitySample, float ds, uint mipLevel, float lightDotEye, float3 scattering, float3 bg)
+{
+	float height = GetHeightFraction(pos);
+	float sigma_ds = -ds * DensityFactor;
+
+	float light_density = RaymarchLight(pos, ds * 0.6, LIGHT_DIR, densitySample, lightDotEye, mipLevel);
+	float dTrans = exp(densitySample * sigma_ds);
+
+	//Sun and sky irradiance
+	float3 sky_irradiance;
+	float3 sun_irradiance = GetSunAndSkyIrradianceAtPoint((pos + ds * LightDir * 3.6) * 0.00001  - float3(0.0, -EarthRadius, 0.0), LightDir, sky_irradiance) * CloudScatter.xyz * CloudScatter.w;
+	float3 ambient_light = ((0.5 + 0.6*height)*CloudBottomColor*6.5 + float3(0.8, 0.8, 0.8) * max(0.0, 1.0 - 2.0*height)) * length(sun_irradiance) * 0.02;
+
+	if (LightingModel != 0)
+	{
+		float3 ambient_term = lerp(ambient_light * 1.8, bg, 0.2) * MsAmbient;
+		return (sun_irradiance * MsSunScale * MultipleScatteringOctaves(light_density, MiePhase(lightDotEye) * MsPhaseScale) + ambient_term) * (1.0 - dTrans);
+	}
+
+	//// light model
+	float powder_term = EnablePowder ? Powder(light_density) : 1.0f;
+	float beer_term = EnableBeer ? 2.0f * Beer(light_density) : 1.0f;
+	//float3 S = 0.6 * (lerp(lerp(ambient_light * 1.8, bg, 0.2), scattering * SUN_COLOR, beer_term * powder_term * exp(-light_density))) * density_sample;
+	float3 S = 0.6 * (lerp(lerp(ambient_light * 1.8, bg, 0.2), scattering.x * sun_irradiance, beer_term * powder_term * exp(-light_density))) * densitySample;
+	float3 S_1 = 0.6 * (lerp(lerp(ambient_light * 1.8, bg, 0.2), scattering.y * sun_irradiance, beer_term * powder_term * exp(-light_density))) * densitySample * ABC.y;
+	float3 S_2 = 0.6 * (lerp(lerp(ambient_light * 1.8, bg, 0.2), scattering.z * sun_irradiance, beer_term * powder_term * exp(-light_density))) * densitySample * ABC.y * ABC.y;
+	return (S - S * dTrans) * (1.0 / densitySample) + S_1 * (1.0 - exp(densitySample * sigma_ds * ABC.x)) / (densitySample * ABC.x) + S_2 * (1.0 - exp(densitySample * sigma_ds * ABC.x * ABC.x)) / (densitySample * ABC.x * ABC.x);
+}
+
+// Coarse steps of CoarseStepScale * ds test the cheap density. The first nonzero test backs up to
+// just past the previous empty test and fine steps of ds take over, until FineZeroSamples empty
+// samples in a row past the hit hand back to coarse steps. Far from the camera the mip level goes
+// up by LodMipBias and the erosion is skipped behind LodFarDistance.
+float4 RaymarchCloudAdaptive(uint2 pixelCoord, float3 startPos, float3 dir, float len, float ds, float3 scattering, float3 bg, out float4 cloudPos)
+{
+	float start_distance = length(startPos - CameraPosition);
+	float coarse_ds = ds * max(CoarseStepScale, 1.0);
+	float lod_range = max(LodFarDistance - LodNearDistance, 1.0);
+	float light_dot_eye = dot(normalize(LIGHT_DIR), dir);
+	float sigma_ds = -ds * DensityFactor;
+
+	float3 color = 0.0;
+	float T = 1.0;
+	bool entered = false;
+	bool fine = false;
+	int zero_density_sample_count = 0;
+	float t = ds * BlueNoiseJitter(pixelCoord);
+	// where fine steps restart after a hit, right past the last empty coarse test
+	float resume_t = t;
+	float hit_t = t;
+
+	// a refinement repeats at most CoarseStepScale fine steps, bounded by twice the uniform count
+	const uint max_iterations = uint(len / ds) * 2 + 2;
+	for (uint i = 0; i < max_iterations && t < len; ++i)
+	{
+		float3 pos = startPos + dir * t;
+		float view_distance = start_distance + t;
+		uint mip_level = uint(t / ds * 0.0625 + saturate((view_distance - LodNearDistance) / lod_range) * LodMipBias);
+
+		if (!fine)
+		{
+			if (SampleCloudDensity(pos, false, mip_level) > 0.0)
+			{
+				fine = true;
+				zero_density_sample_count = 0;
+				hit_t = t;
+				t = resume_t;
+			}
+			else
+			{
+				resume_t = t + ds;
+				t += coarse_ds;
+			}
+			continue;
+		}
+
+		float density_sample = SampleCloudDensity(pos, view_distance < LodFarDistance, mip_level);
+		if (density_sample > 0.0)
+		{
+			if (!entered)
+			{
+				cloudPos = float4(pos, 1.0);
+				entered = true;
+			}
+			zero_density_sample_count = 0;
+			color += T * IntegrateCloudStep(pos, density_sample, ds, mip_level, light_dot_eye, scattering, bg);
+			T *= exp(density_sample * sigma_ds);
+			if (T < MinTransmittance)
+				break;
+		}
+		else
+		{
+			zero_density_sample_count++;
+		}
+		t += ds;
+
+		if (zero_density_sample_count >= FineZeroSamples && t > hit_t)
+		{
+			fine = false;
+			resume_t = t;
+		}
+	}
+	return float4(color, 1.0 - T);
+}
+
 float4 RaymarchCloud(uint2 pixelCoord, float3 startPos, float3 endPos, float3 bg, out float4 cloudPos)
 {
 	float3 path = endPos - startPos;
@@ -358,78 +742,30 @@ float4 RaymarchCloud(uint2 pixelCoord, float3 startPos, float3 endPos, float3 bg
 	const int nSteps = lerp(SampleCountMin, SampleCountMax, dir.y);
 
 	float ds = len / nSteps;
+	float light_dot_eye = dot(normalize(LIGHT_DIR), dir);
+
+	float3 scattering;
+	scattering.x = max(MiePhase(light_dot_eye), 1.0);
+	scattering.y = max(MiePhase(light_dot_eye * ABC.z), 1.0);
+	scattering.z = max(MiePhase(light_dot_eye * ABC.z * ABC.z), 1.0);
+
+	//float scattering = lerp(HG(light_dot_eye, HG0), HG(light_dot_eye, HG1), saturate(light_dot_eye * 0.5 + 0.5));
+	//scattering = max(scattering, 1.0);
+
+	if (AdaptiveMarch != 0)
+		return RaymarchCloudAdaptive(pixelCoord, startPos, dir, len, ds, scattering, bg, cloudPos);
+
 	//float3 dir = path / len;
 	dir *= ds;
 	float4 color = 0.0;
-	uint a = pixelCoord.x % 4;
-	uint b = pixelCoord.y % 4;
-	//startPos += dir * BayerFilter[a * 4 + b];
-	startPos += dir * n1rand(float2(pixelCoord));
+	//startPos += dir * BayerFilter[(pixelCoord.x % 4) * 4 + pixelCoord.y % 4];
+	startPos += dir * BlueNoiseJitter(pixelCoord);
 	float3 pos = startPos;
 
-	float density = 0.0;
-	float light_dot_eye = dot(normalize(LIGHT_DIR), normalize(dir));
 	float T = 1.0;
 	float sigma_ds = -ds * DensityFactor;
-	bool expensive = true;
 	bool entered = false;
 
-	float cloud_test = 0.0;
-	float previous_density_sample = -1.0;
-	int zero_density_sample_count = 0;
-
-	/*int low_lod_steps = nSteps / 8;
-	float big_step = len / low_lod_steps;
-	float3 low_lod_pos = pos;
-	float ds_lodded = 0.0;
-	float3 big_step_dir = normalize(path) * big_step;*/
-	//for (uint ii = 0; ii < low_lod_steps; ++ii)
-	//{
-	//	uint mip = ii * 0.25;
-	//	mip += 4;
-	//	float density = SampleCloudDensity(low_lod_pos, false, mip);
-	//	ds_lodded += density * big_step;
-	//	low_lod_pos += big_step_dir;
-	//}
-
-	//for (uint ii = 0; ii < nSteps; ++ii)
-	//{
-	//	uint mip = ii * 0.0625;
-	//	float density = SampleCloudDensity(low_lod_pos, true, mip);
-	//	ds_lodded += density * -sigma_ds;
-	//	low_lod_pos += dir;
-	//}
-	
-	float scattering = numericalMieFit(light_dot_eye);
-	scattering = max(scattering, 1.0);
-	float scattering_1 = numericalMieFit(light_dot_eye * ABC.z);
-	scattering_1 = max(scattering_1, 1.0);
-	float scattering_2 = numericalMieFit(light_dot_eye * ABC.z * ABC.z);
-	scattering_2 = max(scattering_2, 1.0);
-
-	//float scattering = 1.0;
-	//float scattering_1 = ABC.z;
-	//float scattering_2 = ABC.z * ABC.z;
-
-
-	//float scattering = lerp(HG(light_dot_eye, HG0), HG(light_dot_eye, HG1), saturate(light_dot_eye * 0.5 + 0.5));
-	//scattering = max(scattering, 1.0);
-	//float scattering_1 = lerp(HG(light_dot_eye, HG0 * ABC.z), HG(light_dot_eye, HG1 * ABC.z), saturate(light_dot_eye * 0.5 + 0.5));
-	//scattering_1 = max(scattering_1, 1.0);
-	//float scattering_2 = lerp(HG(light_dot_eye, HG0 * ABC.z * ABC.z), HG(light_dot_eye, HG1 * ABC.z * ABC.z), saturate(light_dot_eye * 0.5 + 0.5));
-	//scattering_2 = max(scattering_2, 1.0);
-
-	//float phase_probability = max(HG(light_dot_eye, Eccentricity), SliverIntensity * HG(light_dot_eye, 0.99 - SliverSpread));
-
-	//float3 sky_irradiance;
-	//float3 sun_irradiance = GetSunAndSkyIrradianceAtPoint(float3(endPos.x, endPos.y, endPos.z) * 0.001 - float3(0.0, -EarthRadius, 0.0), LightDir, sky_irradiance);
-	//float3 total_irradiance = sun_irradiance + sky_irradiance;
-
-	//float phase = lerp(HG(light_dot_eye, HG0), HG(light_dot_eye, HG1), HGWeight);
-	//float phase = numericalMieFit(light_dot_eye);
-
-	//float scatter_amount = lerp(0.008, 1.0, smoothstep(0.96, 0.0, light_dot_eye));
-
 	for (uint i = 0; i < nSteps; ++i)
 	{
 		uint mip_level = i * 0.0625;
@@ -442,106 +778,13 @@ float4 RaymarchCloud(uint2 pixelCoord, float3 startPos, float3 endPos, float3 bg
 				cloudPos = float4(pos, 1.0);
 				entered = true;
 			}
-			float height = GetHeightFraction(pos);
-
-			float light_density = RaymarchLight(pos, ds * 0.6, LIGHT_DIR, density_sample, light_dot_eye, mip_level);
-			float dTrans = exp(density_sample * sigma_ds);
-
-			//Sun and sky irradiance
-			float3 sky_irradiance;
-			float3 sun_irradiance = GetSunAndSkyIrradianceAtPoint((pos + ds * LightDir * 3.6) * 0.00001  - float3(0.0, -EarthRadius, 0.0), LightDir, sky_irradiance) * CloudScatter.xyz * CloudScatter.w;
-			float3 ambient_light = ((0.5 + 0.6*height)*CloudBottomColor*6.5 + float3(0.8, 0.8, 0.8) * max(0.0, 1.0 - 2.0*height)) * length(sun_irradiance) * 0.02;
-			//float3 ambient_light = CloudBottomColor * length(sun_irradiance) * 0.2;
-			float3 total_irradiance = sun_irradiance + ambient_light;
-
-			//// light model
-			float powder_term = EnablePowder ? Powder(light_density) : 1.0f;
-			float beer_term = EnableBeer ? 2.0f * Beer(light_density) : 1.0f;
-			//float3 S = 0.6 * (lerp(lerp(ambient_light * 1.8, bg, 0.2), scattering * SUN_COLOR, beer_term * powder_term * exp(-light_density))) * density_sample;
-			float3 S = 0.6 * (lerp(lerp(ambient_light * 1.8, bg, 0.2), scattering * sun_irradiance, beer_term * powder_term * exp(-light_density))) * density_sample;
-			float3 S_1 = 0.6 * (lerp(lerp(ambient_light * 1.8, bg, 0.2), scattering_1 * sun_irradiance, beer_term * powder_term * exp(-light_density))) * density_sample * ABC.y;
-			float3 S_2 = 0.6 * (lerp(lerp(ambient_light * 1.8, bg, 0.2), scattering_2 * sun_irradiance, beer_term * powder_term * exp(-light_density))) * density_sample * ABC.y * ABC.y;
-			//float3 S = 0.6 * scattering * total_irradiance * beer_term * powder_term * exp(-light_density) * density_sample;
-			float3 Sint = (S - S * dTrans) * (1.0 / density_sample) + S_1 * (1.0 - exp(density_sample * sigma_ds * ABC.x)) / (density_sample * ABC.x) + S_2 * (1.0 - exp(density_sample * sigma_ds * ABC.x * ABC.x)) / (density_sample * ABC.x * ABC.x);
-			color.rgb += T * Sint;
-
-			// light model - 2
-			/*float3 light_scattering_0 = CloudScatter.xyz * CloudScatter.w * exp(-light_density) * beer_term * powder_term * density_sample;
-			float3 light_scattering_1 = light_scattering_0 * ABC.x;
-			float3 light_scattering_2 = light_scattering_0 * ABC.x * ABC.x;
-			light_scattering_0 *= phase;
-			float phase_1 = lerp(HG(light_dot_eye, HG0 * ABC.z), HG(light_dot_eye * ABC.z, HG1 * ABC.z), HGWeight);
-			float phase_2 = lerp(HG(light_dot_eye, HG0 * ABC.z * ABC.z), HG(light_dot_eye, HG1 * ABC.z * ABC.z), HGWeight);
-			light_scattering_1 *= phase_1;
-			light_scattering_2 *= phase_2;
-			float dTrans_1 = exp(density_sample * sigma_ds * ABC.y);
-			float dTrans_2 = exp(density_sample * sigma_ds * ABC.y * ABC.y);
-
-			float3 light_scattering = light_scattering_0 * (1.0 - dTrans) / (density_sample) + 
-									  light_scattering_1 * (1.0 - dTrans_1) / (density_sample * ABC.y) + 
-									  light_scattering_2 * (1.0 - dTrans_2) / (density_sample * ABC.y * ABC.y);
-			color.rgb += T * (light_scattering * sun_irradiance + ambient_light);*/
-
-			//// light model - 3
-			//float beers_law = exp(-light_density) + 0.5 * scatter_amount * exp(-light_density * 0.1) + 0.4 * scatter_amount * exp(-light_density * 0.02);
-			//float intensity = beers_law * phase * lerp(0.05 + 1.5 * pow(min(1.0, density_sample * 8.5), 0.3 + 5.5 * height), 1.0, saturate(light_density* 0.4));
-			//float radiance = ambient_light * 0.8 + sun_irradiance * intensity;
-			//color.rgb += T * radiance * (1.0 - dTrans);// / density_sample;
-
-
-			//float light_energy = GetLightEnergy(pos, height, light_density, ds_lodded, phase_probability, light_dot_eye, ds, Brightness);
-			//color.rgb += light_energy * SUN_COLOR * T;
-
-			T *= dTrans;
+			color.rgb += T * IntegrateCloudStep(pos, density_sample, ds, mip_level, light_dot_eye, scattering, bg);
+			T *= exp(density_sample * sigma_ds);
 		}
 		pos += dir;
 
-		//if (cloud_test > 0.0)
-		//{
-		//	float density_sample = SampleCloudDensity(pos, true, 0.0);
-		//	if (density_sample > 0.0)
-		//	{
-		//		if (!entered)
-		//		{
-		//			cloudPos = float4(pos, 1.0);
-		//			entered = true;
-		//		}
-
-		//		float height = GetHeightFraction(pos);
-		//		float3 ambient_light = CloudBottomColor;
-		//		float light_density = RaymarchLight(pos, ds * 0.1, LIGHT_DIR, density_sample, light_dot_eye);
-		//		float scattering = lerp(HG(light_dot_eye, HG0), HG(light_dot_eye, HG1), saturate(light_dot_eye * 0.5 + 0.5));
-		//		scattering = max(scattering, 1.0);
-		//		float powder_term = EnablePowder ? Powder(light_density) : 1.0f;
-		//		float beer_term = EnableBeer ? 2.0f * Beer(light_density) : 1.0f;
-
-		//		float3 S = 0.6 * (lerp(lerp(ambient_light * 1.8, bg, 0.2), scattering * SUN_COLOR, beer_term * powder_term * exp(-light_density))) * density_sample;
-		//		float dTrans = exp(density_sample * sigma_ds);
-		//		float3 Sint = (S - S * dTrans) * (1.0 / density_sample);
-		//		color.rgb += T * Sint;
-		//		T *= dTrans;
-
-		//	}
-		//	pos += dir;
-		//}
-		//else
-		//{
-		//	cloud_test = SampleCloudDensity(pos, false, 0.0);
-		//	if (cloud_test == 0.0)
-		//	{
-		//		pos += dir * 2;
-		//		i++;
-		//	}
-		//	else
-		//	{
-		//		pos -= dir;
-		//		//i--;
-		//	}
-		//}
-
-		if (T < CLOUDS_MIN_TRANSMITTANCE)
+		if (T < MinTransmittance)
 			break;
-
 	}
 	color.a = 1.0 - T;
 	return color;
@@ -0,0 +1,88 @@
+#include "stdafx.h"
+#include "SelfTest.h"
+#include "Math/RandomBenchmark.h"
+#include "D3D12/FenceRecyclerBenchmark.h"
+#include "D3D12/AllocatorBenchmark.h"
+#include "D3D12/DescriptorAllocatorBenchmark.h"
+#include "D3D12/DescriptorRangeCacheBenchmark.h"
+#include "D3D12/DescriptorTableCacheBenchmark.h"
+#include "D3D12/FrameGraphBenchmark.h"
+#include "D3D12/TransientHeapPlannerBenchmark.h"
+#include "Volumetric/CloudMiePhaseBenchmark.h"
+#include <cstdio>
+#include <sstream>
+
+namespace
+{
+	struct Check
+	{
+		const char* name;
+		SelfTest::Result (*run)(const char* name);
+	};
+
+	const Check s_checks[] =
+	{
+		{ "Random", &SelfTest::Run<RandomBenchmark> },
+		{ "FenceRecycler", &SelfTest::Run<FenceRecyclerBenchmark> },
+		{ "Allocator", &SelfTest::Run<AllocatorBenchmark> },
+		{ "DescriptorAllocator", &SelfTest::Run<DescriptorAllocatorBenchmark> },
+		{ "DescriptorRangeCache", &SelfTest::Run<DescriptorRangeCacheBenchmark> },
+		{ "DescriptorTableCache", &SelfTest::Run<DescriptorTableCacheBenchmark> },
+		{ "FrameGraph", &SelfTest::Run<FrameGraphBenchmark> },
+		{ "TransientHeapPlanner", &SelfTest::Run<TransientHeapPlannerBenchmark> },
+		{ "CloudMiePhase", &SelfTest::Run<CloudMiePhaseBenchmark> },
+	};
+
+	std::vector<std::pair<std::string, std::function<SelfTest::Result(const char* name)>>>& AddedChecks()
+	{
+		static std::vector<std::pair<std::string, std::function<SelfTest::Result(const char* name)>>> s_added;
+		return s_added;
+	}
+}
+
+std::string SelfTest::Violations::Dump() const
+{
+	std::ostringstream out;
+	for (size_t i = 0; i < m_counts.size(); ++i)
+		out << (i > 0 ? ", " : "") << m_counts[i].first << " " << m_counts[i].second;
+	return out.str();
+}
+
+void SelfTest::AddCheck(const char* name, const std::function<Result(const char* name)>& run)
+{
+	AddedChecks().emplace_back(name, run);
+}
+
+std::vector<SelfTest::Result> SelfTest::RunAll()
+{
+	std::vector<Result> results;
+	for (const Check& check : s_checks)
+		results.push_back(check.run(check.name));
+	for (const auto& check : AddedChecks())
+		results.push_back(check.second(check.first.c_str()));
+	return results;
+}
+
+uint32_t SelfTest::CountFailed(const std::vector<Result>& results)
+{
+	uint32_t failed = 0;
+	for (const Result& result : results)
+		failed += result.Passed() ? 0 : 1;
+	return failed;
+}
+
+std::string SelfTest::Dump(const std::vector<Result>& results)
+{
+	std::ostringstream out;
+	for (const Result& result : results)
+	{
+		char time[32];
+		snprintf(time, sizeof(time), "%.2f s", result.seconds);
+		out << (result.Passed() ? "PASS " : "FAIL ") << result.name << ", " << time << ": " << result.summary;
+		if (!result.Passed())
+			out << " [" << result.violations.Dump() << "]";
+		out << "\n";
+	}
+	out << results.size() - CountFailed(results) << " of " << results.size() << " passed\n";
+	return out.str();
+}
\ No newline at end of file
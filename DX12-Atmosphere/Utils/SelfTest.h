@@ -0,0 +1,115 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Checks that run a seeded workload against a component, measure it, and count violations,
+// results that break what the component promises. A check passes when every count is 0.
+// RunAll runs the list in SelfTest.cpp and the checks the app added, from the Self Tests tab
+// or with -selftest on the command line, which exits with the number of checks that failed.
+namespace SelfTest
+{
+	// What must not happen, counted by name. Adding 0 is a branch, validation loops add
+	// the result of every comparison.
+	class Violations
+	{
+	public:
+		void Add(const char* what, uint64_t count = 1)
+		{
+			if (count == 0)
+				return;
+			for (auto& entry : m_counts)
+			{
+				if (entry.first == what)
+				{
+					entry.second += count;
+					return;
+				}
+			}
+			m_counts.emplace_back(what, count);
+		}
+
+		// the counts of another run, the two sides of a comparison, under prefix
+		void Merge(const Violations& other, const std::string& prefix)
+		{
+			for (const auto& entry : other.m_counts)
+				m_counts.emplace_back(prefix + entry.first, entry.second);
+		}
+
+		uint64_t Get(const std::string& what) const
+		{
+			for (const auto& entry : m_counts)
+			{
+				if (entry.first == what)
+					return entry.second;
+			}
+			return 0;
+		}
+
+		uint64_t Total() const
+		{
+			uint64_t total = 0;
+			for (const auto& entry : m_counts)
+				total += entry.second;
+			return total;
+		}
+
+		// "what count, ..."
+		std::string Dump() const;
+
+	private:
+		std::vector<std::pair<std::string, uint64_t>> m_counts;
+	};
+
+	struct Result
+	{
+		std::string name;
+		double seconds;
+		Violations violations;
+		// the figures worth a look, one line
+		std::string summary;
+
+		bool Passed() const { return violations.Total() == 0; }
+	};
+
+	// A benchmark class with a Desc, DefaultDesc, Run returning a report with a violations
+	// member, and Summarize of that report
+	template <class Benchmark>
+	Result Run(const char* name)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		auto report = Benchmark::Run(Benchmark::DefaultDesc());
+		Result result;
+		result.name = name;
+		result.seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+		result.violations = report.violations;
+		result.summary = Benchmark::Summarize(report);
+		return result;
+	}
+
+	// Run over 1, 2, 4 ... maxThreads threads, for the benchmarks with a numThreads
+	template <class Benchmark>
+	auto Scale(const typename Benchmark::Desc& desc, uint32_t maxThreads) -> std::vector<decltype(Benchmark::Run(desc))>
+	{
+		std::vector<decltype(Benchmark::Run(desc))> reports;
+		for (uint32_t threads = 1; threads <= std::max(maxThreads, 1u); threads *= 2)
+		{
+			typename Benchmark::Desc d = desc;
+			d.numThreads = threads;
+			reports.push_back(Benchmark::Run(d));
+		}
+		return reports;
+	}
+
+	// A check on what only the app builds, run after the list in SelfTest.cpp
+	void AddCheck(const char* name, const std::function<Result(const char* name)>& run);
+	// Every check in order, the ones on the D3D12 objects need the device created
+	std::vector<Result> RunAll();
+	uint32_t CountFailed(const std::vector<Result>& results);
+	// A line per check, PASS or FAIL, its time, summary and what it violated
+	std::string Dump(const std::vector<Result>& results);
+}
\ No newline at end of file
@@ -0,0 +1,172 @@
+#include "stdafx.h"
+#include "CloudCubemapScheduler.h"
+#include <chrono>
+
+// Bayer rank of a cell in an n x n grid, n a power of two, see CloudUpdateScheduler::BuildBayer
+static uint32_t BayerRank(uint32_t x, uint32_t y, uint32_t n)
+{
+	uint32_t bits = 0;
+	while ((1u << bits) < n)
+		++bits;
+	uint32_t rank = 0;
+	for (uint32_t b = 0; b < bits; ++b)
+	{
+		uint32_t xb = (x >> b) & 1, yb = (y >> b) & 1;
+		rank |= (((xb ^ yb) << 1) | yb) << (2 * (bits - 1 - b));
+	}
+	return rank;
+}
+
+CloudCubemapScheduler::CloudCubemapScheduler()
+	: m_size(0),
+	m_tilesPerFace(0),
+	m_budget(1),
+	m_cursor(0),
+	m_refreshAll(false)
+{
+}
+
+void CloudCubemapScheduler::Create(uint32_t size, uint32_t tilesPerFace)
+{
+	assert(tilesPerFace > 0 && size % tilesPerFace == 0);
+	m_size = size;
+	m_tilesPerFace = tilesPerFace;
+
+	// tiles of a face by their rank on the enclosing power of two grid
+	uint32_t grid = 1;
+	while (grid < tilesPerFace)
+		grid <<= 1;
+	std::vector<std::pair<uint32_t, uint32_t>> ranked;
+	for (uint32_t y = 0; y < tilesPerFace; ++y)
+		for (uint32_t x = 0; x < tilesPerFace; ++x)
+			ranked.emplace_back(BayerRank(x, y, grid), y * tilesPerFace + x);
+	std::sort(ranked.begin(), ranked.end());
+
+	// the same rank on all six faces, then the next
+	const uint32_t tile_size = size / tilesPerFace;
+	m_order.clear();
+	m_order.reserve(ranked.size() * 6);
+	for (const auto& r : ranked)
+	{
+		for (uint32_t face = 0; face < 6; ++face)
+		{
+			Tile tile;
+			tile.face = face;
+			tile.x = (r.second % tilesPerFace) * tile_size;
+			tile.y = (r.second / tilesPerFace) * tile_size;
+			m_order.push_back(tile);
+		}
+	}
+	SetBudget(m_budget);
+	Reset();
+}
+
+void CloudCubemapScheduler::SetBudget(uint32_t tilesPerFrame)
+{
+	m_budget = std::max(tilesPerFrame, 1u);
+	if (!m_order.empty())
+		m_budget = std::min(m_budget, (uint32_t)m_order.size());
+}
+
+void CloudCubemapScheduler::Reset()
+{
+	m_cursor = 0;
+	m_refreshAll = false;
+}
+
+uint32_t CloudCubemapScheduler::GetPeriod() const
+{
+	return ((uint32_t)m_order.size() + m_budget - 1) / m_budget;
+}
+
+const std::vector<CloudCubemapScheduler::Tile>& CloudCubemapScheduler::BeginFrame()
+{
+	if (m_refreshAll)
+	{
+		// the round robin goes on where it was, the tiles all start from this frame anyway
+		m_frameTiles = m_order;
+		m_refreshAll = false;
+		return m_frameTiles;
+	}
+
+	const uint32_t num_tiles = (uint32_t)m_order.size();
+	m_frameTiles.clear();
+	for (uint32_t i = 0; i < m_budget && i < num_tiles; ++i)
+	{
+		m_frameTiles.push_back(m_order[m_cursor]);
+		m_cursor = (m_cursor + 1) % num_tiles;
+	}
+	return m_frameTiles;
+}
+
+CloudCubemapScheduler::Report CloudCubemapScheduler::Verify(uint32_t size, uint32_t tilesPerFace, uint32_t tilesPerFrame, uint32_t maxFrames, uint32_t numFrames)
+{
+	Report report;
+	ZeroMemory(&report, sizeof(report));
+
+	CloudCubemapScheduler scheduler;
+	scheduler.Create(size, tilesPerFace);
+	scheduler.SetBudget(tilesPerFrame);
+
+	report.size = size;
+	report.tilesPerFace = tilesPerFace;
+	report.tilesPerFrame = scheduler.GetBudget();
+	report.period = scheduler.GetPeriod();
+	report.frames = numFrames;
+
+	// frame of the last refresh of every texel, -1 is the probe that was whole before frame 0
+	const uint32_t tile_size = scheduler.GetTileSize();
+	const size_t face_texels = (size_t)size * size;
+	std::vector<int64_t> last(face_texels * 6, -1);
+	std::vector<uint8_t> written(last.size(), 0), stale(last.size(), 0);
+	uint64_t age_sum = 0, age_count = 0, texels = 0;
+	double begin_seconds = 0.0;
+
+	for (uint32_t f = 0; f < numFrames; ++f)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		const std::vector<Tile>& tiles = scheduler.BeginFrame();
+		begin_seconds += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+		for (const Tile& tile : tiles)
+		{
+			for (uint32_t y = tile.y; y < tile.y + tile_size; ++y)
+			{
+				for (uint32_t x = tile.x; x < tile.x + tile_size; ++x)
+				{
+					size_t i = tile.face * face_texels + (size_t)y * size + x;
+					uint32_t age = (uint32_t)(f - last[i]);
+					if (written[i])
+					{
+						age_sum += age;
+						++age_count;
+					}
+					report.maxAge = std::max(report.maxAge, age);
+					if (age > maxFrames)
+						stale[i] = 1;
+					last[i] = f;
+					written[i] = 1;
+					++texels;
+				}
+			}
+		}
+	}
+
+	for (size_t i = 0; i < last.size(); ++i)
+	{
+		// as if the probe was whole again right after the last frame
+		uint32_t age = (uint32_t)(numFrames - last[i]);
+		report.maxAge = std::max(report.maxAge, age);
+		if (age > maxFrames)
+			stale[i] = 1;
+		report.missedTexels += written[i] ? 0 : 1;
+		report.staleTexels += stale[i];
+	}
+
+	report.meanAge = age_count ? (float)((double)age_sum / age_count) : 0.0f;
+	report.passed = report.missedTexels == 0 && report.staleTexels == 0;
+	report.texelsPerFrame = numFrames ? (float)((double)texels / numFrames) : 0.0f;
+	report.rayFraction = report.texelsPerFrame / (float)(face_texels * 6);
+	report.beginFrameNanoseconds = numFrames ? begin_seconds * 1e9 / numFrames : 0.0;
+	return report;
+}
\ No newline at end of file
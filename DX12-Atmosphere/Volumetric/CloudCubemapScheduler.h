@@ -0,0 +1,76 @@
+#pragma once
+#include "stdafx.h"
+
+// Decides which parts of the sky probe, a small cubemap of the sky and the clouds seen
+// from the camera, are raymarched in a frame. Every face is cut into tilesPerFace x
+// tilesPerFace tiles and a frame takes the next tilesPerFrame of them in a fixed order,
+// so every texel is refreshed once per GetPeriod() frames. Consecutive tiles sit on
+// different faces and far apart on a face, a partly refreshed probe changes evenly.
+// RefreshAll hands out every tile with the next frame, for a new probe or a jump of the
+// camera or the sun the round robin would take a whole period to catch up with.
+class CloudCubemapScheduler
+{
+public:
+	struct Tile
+	{
+		uint32_t face;
+		// texel of the top left corner on the face
+		uint32_t x;
+		uint32_t y;
+	};
+
+	struct Report
+	{
+		uint32_t size;
+		uint32_t tilesPerFace;
+		uint32_t tilesPerFrame;
+		uint32_t period;
+		uint32_t frames;
+		// frames between two refreshes of a texel, counted from a probe that was whole before
+		// frame 0 up to one that would be after the last frame
+		uint32_t maxAge;
+		float meanAge;
+		// texels never written, and texels older than maxFrames at some frame
+		uint32_t missedTexels;
+		uint32_t staleTexels;
+		bool passed;
+		// raymarched texels per frame, and as a fraction of all six faces
+		float texelsPerFrame;
+		float rayFraction;
+		double beginFrameNanoseconds;
+	};
+
+	CloudCubemapScheduler();
+
+	// size is divisible by tilesPerFace, the shader writes whole 8 x 8 groups so the
+	// tiles should be a multiple of 8 texels
+	void Create(uint32_t size, uint32_t tilesPerFace);
+	// Tiles per frame, at least one and at most all of them
+	void SetBudget(uint32_t tilesPerFrame);
+	void Reset();
+	void RefreshAll() { m_refreshAll = true; }
+
+	// The tiles to raymarch this frame
+	const std::vector<Tile>& BeginFrame();
+
+	uint32_t GetSize() const { return m_size; }
+	uint32_t GetTilesPerFace() const { return m_tilesPerFace; }
+	uint32_t GetTileSize() const { return m_tilesPerFace ? m_size / m_tilesPerFace : 0; }
+	uint32_t GetNumTiles() const { return (uint32_t)m_order.size(); }
+	uint32_t GetBudget() const { return m_budget; }
+	// frames for every tile to come around once
+	uint32_t GetPeriod() const;
+
+	// Runs a scheduler of the given layout for numFrames and checks that every texel is
+	// refreshed within maxFrames frames of its last refresh
+	static Report Verify(uint32_t size, uint32_t tilesPerFace, uint32_t tilesPerFrame, uint32_t maxFrames, uint32_t numFrames);
+
+private:
+	uint32_t m_size;
+	uint32_t m_tilesPerFace;
+	uint32_t m_budget;
+	uint32_t m_cursor;
+	bool m_refreshAll;
+	std::vector<Tile> m_order;
+	std::vector<Tile> m_frameTiles;
+};
\ No newline at end of file
@@ -0,0 +1,337 @@
+#include "stdafx.h"
+#include "CloudDensityQuery.h"
+#include "CloudReferenceRenderer.h"
+#include "CloudVirtualWeather.h"
+#include "CloudHeightLut.h"
+#include "Math/Random.h"
+#include <atomic>
+#include <chrono>
+
+// VolumetricCloudCommon.hlsli, WindDirection is (1, 0, 0) there
+static const float kCloudTopOffset = 750.0f;
+// cloud types GetHeightDensityBound tries on the analytic gradients, the table has its columns
+static const uint32_t kBoundCloudTypes = 33;
+// height fractions GetDensityBounds scans
+static const uint32_t kBoundHeights = 1024;
+
+static inline float Saturate(float x)
+{
+	return x < 0.0f ? 0.0f : (x > 1.0f ? 1.0f : x);
+}
+
+static inline float Remap(float originalValue, float originalMin, float originalMax, float newMin, float newMax)
+{
+	return newMin + (((originalValue - originalMin) / (originalMax - originalMin)) * (newMax - newMin));
+}
+
+// Remap(v, lo, hi, 0, 1)
+static inline XMVECTOR XM_CALLCONV RemapUnit4(FXMVECTOR v, FXMVECTOR lo, FXMVECTOR hi)
+{
+	return XMVectorDivide(XMVectorSubtract(v, lo), XMVectorSubtract(hi, lo));
+}
+
+CloudDensityQuery::CloudDensityQuery()
+	: m_cloudShape(nullptr),
+	m_erosion(nullptr),
+	m_weather(nullptr),
+	m_virtualWeather(nullptr),
+	m_heightLut(nullptr),
+	m_centerY(0.0f),
+	m_innerRadius(0.0f),
+	m_outerRadius(1.0f),
+	m_windOffset(0.0f)
+{
+	SetParameters(m_params, 0.0f);
+}
+
+void CloudDensityQuery::SetTextures(const CloudReferenceTexture* cloudShape, const CloudReferenceTexture* erosion, const CloudReferenceTexture* weather)
+{
+	m_cloudShape = cloudShape;
+	m_erosion = erosion;
+	m_weather = weather;
+}
+
+void CloudDensityQuery::SetParameters(const CloudParameterCB& cloudCB, float time)
+{
+	m_params = cloudCB;
+	// INNER_RADIUS / OUTER_RADIUS, the earth centre sits below the camera in xz which GetHeightFraction ignores
+	m_centerY = -cloudCB.earthRadius * 100.0f;
+	m_innerRadius = cloudCB.earthRadius * 100.0f + cloudCB.cloudBottomRadius;
+	m_outerRadius = cloudCB.earthRadius * 100.0f + cloudCB.cloudTopRadius;
+	m_windOffset = time * cloudCB.cloudSpeed;
+}
+
+float CloudDensityQuery::SampleDensity(const XMFLOAT3& p, bool expensive, uint32_t lod) const
+{
+	assert(IsValid());
+	float height_fraction = (std::abs(p.y - m_centerY) - m_innerRadius) / (m_outerRadius - m_innerRadius);
+	if (height_fraction < 0.0f || height_fraction > 1.0f)
+		return 0.0f;
+
+	float offset = height_fraction * kCloudTopOffset + m_windOffset;
+	float uv[2] = { p.x / m_outerRadius + 0.5f, p.z / m_outerRadius + 0.5f };
+	float moving_uv[2] = { (p.x + offset) / m_outerRadius + 0.5f, p.z / m_outerRadius + 0.5f };
+
+	Vector4 low_frequency_noise = m_cloudShape->SampleLevel(uv[0] * m_params.crispiness, height_fraction, uv[1] * m_params.crispiness, lod, CloudReferenceTexture::kWrap);
+	float low_freq_FBM = (float)low_frequency_noise.GetY() * 0.625f + (float)low_frequency_noise.GetZ() * 0.25f + (float)low_frequency_noise.GetW() * 0.125f;
+	float base_cloud = Remap(low_frequency_noise.GetX(), -(1.0f - low_freq_FBM), 1.0f, 0.0f, 1.0f);
+
+	Vector4 weather_data = Vector4(SampleWeather(p.x + offset, p.z, moving_uv[0], moving_uv[1]));
+	float cloud_type = m_params.cloudTypeFromWeather != 0 ? (float)weather_data.GetY() : m_params.cloudType;
+	base_cloud *= GetHeightDensity(height_fraction, cloud_type);
+
+	float cloud_coverage = (float)weather_data.GetX() * m_params.cloudCoverage;
+	float base_cloud_with_coverage = Remap(base_cloud, cloud_coverage, 1.0f, 0.0f, 1.0f);
+	base_cloud_with_coverage *= cloud_coverage;
+
+	if (expensive)
+	{
+		Vector4 erode_cloud_noise = m_erosion->SampleLevel(moving_uv[0] * m_params.crispiness * m_params.curliness, height_fraction * m_params.curliness,
+			moving_uv[1] * m_params.crispiness * m_params.curliness, lod, CloudReferenceTexture::kWrap);
+		float high_freq_FBM = (float)erode_cloud_noise.GetX() * 0.625f + (float)erode_cloud_noise.GetY() * 0.25f + (float)erode_cloud_noise.GetZ() * 0.125f;
+		float t = Saturate(height_fraction * 10.0f);
+		float high_freq_noise_modifier = high_freq_FBM + (1.0f - 2.0f * high_freq_FBM) * t;
+
+		base_cloud_with_coverage = base_cloud_with_coverage - high_freq_noise_modifier * (1.0f - base_cloud_with_coverage);
+		base_cloud_with_coverage = Remap(base_cloud_with_coverage * 2.0f, high_freq_noise_modifier * 0.2f, 1.0f, 0.0f, 1.0f);
+	}
+
+	// written so a NaN from the analytic density / height_fraction ends up 0 like max() on the GPU
+	return base_cloud_with_coverage > 0.0f ? base_cloud_with_coverage : 0.0f;
+}
+
+XMVECTOR XM_CALLCONV CloudDensityQuery::SampleDensity4(FXMVECTOR x, FXMVECTOR y, FXMVECTOR z, bool expensive, uint32_t lod) const
+{
+	const XMVECTOR zero = XMVectorZero();
+	const XMVECTOR one = XMVectorSplatOne();
+	const XMVECTOR half = XMVectorReplicate(0.5f);
+	const XMVECTOR outer_radius = XMVectorReplicate(m_outerRadius);
+
+	XMVECTOR height_fraction = XMVectorDivide(XMVectorSubtract(XMVectorAbs(XMVectorSubtract(y, XMVectorReplicate(m_centerY))), XMVectorReplicate(m_innerRadius)),
+		XMVectorReplicate(m_outerRadius - m_innerRadius));
+	XMVECTOR in_layer = XMVectorAndInt(XMVectorGreaterOrEqual(height_fraction, zero), XMVectorLessOrEqual(height_fraction, one));
+	if (XMVector4EqualInt(in_layer, XMVectorFalseInt()))
+		return zero;
+
+	XMVECTOR offset = XMVectorAdd(XMVectorMultiply(height_fraction, XMVectorReplicate(kCloudTopOffset)), XMVectorReplicate(m_windOffset));
+	XMVECTOR crispiness = XMVectorReplicate(m_params.crispiness);
+	XMVECTOR v = XMVectorAdd(XMVectorDivide(z, outer_radius), half);
+	XMFLOAT4A uv_x, uv_z, moving_uv_x, h, moving_x, world_z;
+	XMStoreFloat4A(&uv_x, XMVectorMultiply(XMVectorAdd(XMVectorDivide(x, outer_radius), half), crispiness));
+	XMStoreFloat4A(&moving_x, XMVectorAdd(x, offset));
+	XMStoreFloat4A(&world_z, z);
+	XMStoreFloat4A(&uv_z, XMVectorMultiply(v, crispiness));
+	XMStoreFloat4A(&moving_uv_x, XMVectorAdd(XMVectorDivide(XMVectorAdd(x, offset), outer_radius), half));
+	XMStoreFloat4A(&h, height_fraction);
+	XMFLOAT4A moving_uv_z, height_density;
+	XMStoreFloat4A(&moving_uv_z, v);
+
+	// the fetches and the height table are the only per lane part, the texels are transposed
+	// into one register per channel
+	XMMATRIX shape, weather;
+	for (uint32_t i = 0; i < 4; ++i)
+	{
+		bool inside = (&h.x)[i] >= 0.0f && (&h.x)[i] <= 1.0f;
+		shape.r[i] = inside ? (XMVECTOR)m_cloudShape->SampleLevel((&uv_x.x)[i], (&h.x)[i], (&uv_z.x)[i], lod, CloudReferenceTexture::kWrap) : zero;
+		weather.r[i] = inside ? SampleWeather((&moving_x.x)[i], (&world_z.x)[i], (&moving_uv_x.x)[i], (&moving_uv_z.x)[i]) : zero;
+		float cloud_type = m_params.cloudTypeFromWeather != 0 ? XMVectorGetY(weather.r[i]) : m_params.cloudType;
+		(&height_density.x)[i] = inside ? GetHeightDensity((&h.x)[i], cloud_type) : 0.0f;
+	}
+	shape = XMMatrixTranspose(shape);
+	weather = XMMatrixTranspose(weather);
+
+	XMVECTOR low_freq_FBM = XMVectorMultiplyAdd(shape.r[1], XMVectorReplicate(0.625f),
+		XMVectorMultiplyAdd(shape.r[2], XMVectorReplicate(0.25f), XMVectorMultiply(shape.r[3], XMVectorReplicate(0.125f))));
+	XMVECTOR base_cloud = RemapUnit4(shape.r[0], XMVectorNegate(XMVectorSubtract(one, low_freq_FBM)), one);
+
+	base_cloud = XMVectorMultiply(base_cloud, XMLoadFloat4A(&height_density));
+
+	XMVECTOR cloud_coverage = XMVectorMultiply(weather.r[0], XMVectorReplicate(m_params.cloudCoverage));
+	XMVECTOR base_cloud_with_coverage = XMVectorMultiply(RemapUnit4(base_cloud, cloud_coverage, one), cloud_coverage);
+
+	if (expensive)
+	{
+		XMMATRIX erosion;
+		for (uint32_t i = 0; i < 4; ++i)
+		{
+			bool inside = (&h.x)[i] >= 0.0f && (&h.x)[i] <= 1.0f;
+			erosion.r[i] = inside ? (XMVECTOR)m_erosion->SampleLevel((&moving_uv_x.x)[i] * m_params.crispiness * m_params.curliness,
+				(&h.x)[i] * m_params.curliness, (&moving_uv_z.x)[i] * m_params.crispiness * m_params.curliness, lod, CloudReferenceTexture::kWrap) : zero;
+		}
+		erosion = XMMatrixTranspose(erosion);
+
+		XMVECTOR high_freq_FBM = XMVectorMultiplyAdd(erosion.r[0], XMVectorReplicate(0.625f),
+			XMVectorMultiplyAdd(erosion.r[1], XMVectorReplicate(0.25f), XMVectorMultiply(erosion.r[2], XMVectorReplicate(0.125f))));
+		XMVECTOR t = XMVectorSaturate(XMVectorMultiply(height_fraction, XMVectorReplicate(10.0f)));
+		XMVECTOR high_freq_noise_modifier = XMVectorMultiplyAdd(XMVectorNegativeMultiplySubtract(high_freq_FBM, XMVectorReplicate(2.0f), one), t, high_freq_FBM);
+
+		base_cloud_with_coverage = XMVectorNegativeMultiplySubtract(high_freq_noise_modifier, XMVectorSubtract(one, base_cloud_with_coverage), base_cloud_with_coverage);
+		base_cloud_with_coverage = RemapUnit4(XMVectorAdd(base_cloud_with_coverage, base_cloud_with_coverage),
+			XMVectorMultiply(high_freq_noise_modifier, XMVectorReplicate(0.2f)), one);
+	}
+
+	// NaN compares false and ends up 0 like the scalar path
+	XMVECTOR positive = XMVectorAndInt(XMVectorGreater(base_cloud_with_coverage, zero), in_layer);
+	return XMVectorSelect(zero, base_cloud_with_coverage, positive);
+}
+
+XMVECTOR CloudDensityQuery::SampleWeather(float x, float z, float u, float v) const
+{
+	if (m_params.virtualWeather != 0 && m_virtualWeather != nullptr && m_virtualWeather->IsValid())
+	{
+		XMFLOAT4 weather = m_virtualWeather->Sample(x, z);
+		return XMLoadFloat4(&weather);
+	}
+	return m_weather->SampleLevel(u, v, 0.5f, 0, CloudReferenceTexture::kWrap);
+}
+
+float CloudDensityQuery::GetHeightDensity(float heightFraction, float cloudType) const
+{
+	if (m_params.heightLut != 0 && m_heightLut != nullptr && m_heightLut->IsValid())
+		return m_heightLut->Sample(heightFraction, cloudType);
+	return CloudHeightLut::Analytic(heightFraction, cloudType) / heightFraction;
+}
+
+float CloudDensityQuery::GetHeightDensityBound(float heightFraction) const
+{
+	if (m_params.cloudTypeFromWeather == 0)
+		return GetHeightDensity(heightFraction, m_params.cloudType);
+
+	// the table is linear between its columns, so they bound it exactly
+	bool table = m_params.heightLut != 0 && m_heightLut != nullptr && m_heightLut->IsValid();
+	uint32_t types = table ? m_heightLut->GetWidth() : kBoundCloudTypes;
+	float bound = 0.0f;
+	for (uint32_t i = 0; i < types; ++i)
+	{
+		float density = GetHeightDensity(heightFraction, (float)i / (types - 1));
+		bound = density > bound ? density : bound;
+	}
+	return bound;
+}
+
+void CloudDensityQuery::GetDensityBounds(float& bottom, float& top) const
+{
+	// padded by a scan step, a layer without any density collapses onto its bottom
+	const float step = 1.0f / kBoundHeights;
+	float low = 1.0f, high = 0.0f;
+	for (uint32_t k = 1; k <= kBoundHeights; ++k)
+	{
+		float h = k * step;
+		if (GetHeightDensityBound(h) > 0.0f)
+		{
+			low = std::min(low, h - step);
+			high = std::max(high, std::min(h + step, 1.0f));
+		}
+	}
+	if (high < low)
+		low = high = 0.0f;
+	bottom = m_centerY + m_innerRadius + low * (m_outerRadius - m_innerRadius);
+	top = m_centerY + m_innerRadius + high * (m_outerRadius - m_innerRadius);
+}
+
+void CloudDensityQuery::SampleDensity(const XMFLOAT3* points, uint32_t count, float* densities, bool expensive, uint32_t lod) const
+{
+	assert(IsValid());
+	uint32_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		// four xyz are three registers, shuffled into x, y and z of four points
+		const XMFLOAT3* p = points + i;
+		XMVECTOR x = XMVectorSet(p[0].x, p[1].x, p[2].x, p[3].x);
+		XMVECTOR y = XMVectorSet(p[0].y, p[1].y, p[2].y, p[3].y);
+		XMVECTOR z = XMVectorSet(p[0].z, p[1].z, p[2].z, p[3].z);
+		XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(densities + i), SampleDensity4(x, y, z, expensive, lod));
+	}
+	for (; i < count; ++i)
+		densities[i] = SampleDensity(points[i], expensive, lod);
+}
+
+void CloudDensityQuery::OpticalDepth(const Segment* segments, uint32_t count, uint32_t stepsPerSegment, float* opticalDepths, bool expensive) const
+{
+	assert(IsValid() && stepsPerSegment > 0);
+	const XMVECTOR lane = XMVectorSet(0.5f, 1.5f, 2.5f, 3.5f);
+	for (uint32_t s = 0; s < count; ++s)
+	{
+		XMVECTOR start = XMLoadFloat3(&segments[s].start);
+		XMVECTOR delta = XMVectorSubtract(XMLoadFloat3(&segments[s].end), start);
+		float length = XMVectorGetX(XMVector3Length(delta));
+		XMVECTOR step = XMVectorScale(delta, 1.0f / stepsPerSegment);
+
+		// four midpoints of the same segment per call, the lanes past the last step are masked off
+		XMVECTOR sum = XMVectorZero();
+		for (uint32_t k = 0; k < stepsPerSegment; k += 4)
+		{
+			XMVECTOR t = XMVectorAdd(lane, XMVectorReplicate((float)k));
+			XMVECTOR x = XMVectorMultiplyAdd(t, XMVectorSplatX(step), XMVectorSplatX(start));
+			XMVECTOR y = XMVectorMultiplyAdd(t, XMVectorSplatY(step), XMVectorSplatY(start));
+			XMVECTOR z = XMVectorMultiplyAdd(t, XMVectorSplatZ(step), XMVectorSplatZ(start));
+			XMVECTOR d = SampleDensity4(x, y, z, expensive, 0);
+			XMVECTOR valid = XMVectorLess(t, XMVectorReplicate((float)stepsPerSegment));
+			sum = XMVectorAdd(sum, XMVectorSelect(XMVectorZero(), d, valid));
+		}
+		XMFLOAT4 lanes;
+		XMStoreFloat4(&lanes, sum);
+		float density_sum = lanes.x + lanes.y + lanes.z + lanes.w;
+		opticalDepths[s] = density_sum * (length / stepsPerSegment) * m_params.densityFactor;
+	}
+}
+
+CloudDensityQuery::BenchmarkResult CloudDensityQuery::RunBenchmark(uint32_t numQueries, uint32_t stepsPerSegment, uint32_t numThreads,
+	float centerX, float centerZ, float halfExtent) const
+{
+	assert(IsValid() && numQueries > 0 && numThreads > 0);
+	BenchmarkResult result = {};
+	result.numThreads = numThreads;
+	result.stepsPerSegment = stepsPerSegment;
+
+	// points fill the layer, segments start in it and run up to a layer thickness in any direction
+	const float thickness = m_outerRadius - m_innerRadius;
+	const float bottom = m_centerY + m_innerRadius;
+	std::vector<XMFLOAT3> points(numQueries);
+	std::vector<Segment> segments(numQueries);
+	RandomNumberGenerator rng(1);
+	for (uint32_t i = 0; i < numQueries; ++i)
+	{
+		points[i] = XMFLOAT3(centerX + rng.NextFloat(-halfExtent, halfExtent), bottom + rng.NextFloat(thickness), centerZ + rng.NextFloat(-halfExtent, halfExtent));
+		XMVECTOR dir = XMVector3Normalize(XMVectorSet(rng.NextFloat(-1.0f, 1.0f), rng.NextFloat(-1.0f, 1.0f), rng.NextFloat(-1.0f, 1.0f), 0.0f));
+		segments[i].start = points[i];
+		XMStoreFloat3(&segments[i].end, XMVectorMultiplyAdd(dir, XMVectorReplicate(rng.NextFloat(thickness)), XMLoadFloat3(&points[i])));
+	}
+	std::vector<float> single(numQueries), batch(numQueries), depths(numQueries);
+
+	// every thread takes a contiguous range, the queries share this object
+	auto run = [&](auto&& job) -> double
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		std::vector<std::thread> threads;
+		uint32_t range = (numQueries + numThreads - 1) / numThreads;
+		for (uint32_t t = 0; t < numThreads; ++t)
+		{
+			uint32_t begin = std::min(t * range, numQueries);
+			uint32_t end = std::min(begin + range, numQueries);
+			threads.emplace_back([&job, begin, end]() { job(begin, end); });
+		}
+		for (auto& t : threads)
+			t.join();
+		auto end = std::chrono::high_resolution_clock::now();
+		return std::max(std::chrono::duration<double>(end - start).count(), 1e-9);
+	};
+
+	result.pointsPerSecond = numQueries / run([&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t i = begin; i < end; ++i)
+			single[i] = SampleDensity(points[i]);
+	});
+	result.batchPointsPerSecond = numQueries / run([&](uint32_t begin, uint32_t end)
+	{
+		SampleDensity(points.data() + begin, end - begin, batch.data() + begin);
+	});
+	result.segmentsPerSecond = numQueries / run([&](uint32_t begin, uint32_t end)
+	{
+		OpticalDepth(segments.data() + begin, end - begin, stepsPerSegment, depths.data() + begin);
+	});
+
+	for (uint32_t i = 0; i < numQueries; ++i)
+		result.maxBatchError = std::max(result.maxBatchError, std::abs(single[i] - batch[i]));
+	return result;
+}
\ No newline at end of file
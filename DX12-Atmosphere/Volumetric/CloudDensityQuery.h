@@ -0,0 +1,85 @@
+#pragma once
+#include "stdafx.h"
+#include "CloudParameters.h"
+
+class CloudReferenceTexture;
+class CloudVirtualWeather;
+class CloudHeightLut;
+
+// SampleCloudDensity of VolumetricCloudCommon.hlsli for gameplay code (turbulence, visibility,
+// weather sensors): the density at points and the optical depth along segments, from the same
+// textures and CloudParameterCB the clouds are rendered with. CloudReferenceRenderer samples
+// through it as well. Batches run four points at a time in SSE registers as structure of arrays,
+// only the texture fetches are per point. Queries are const and write into caller memory, any
+// number of threads can share one object without locks or allocations.
+class CloudDensityQuery
+{
+public:
+	struct Segment
+	{
+		XMFLOAT3 start;
+		XMFLOAT3 end;
+	};
+
+	struct BenchmarkResult
+	{
+		uint32_t numThreads;
+		uint32_t stepsPerSegment;
+		// single point calls, batched points, segments
+		double pointsPerSecond;
+		double batchPointsPerSecond;
+		double segmentsPerSecond;
+		// largest difference between the batched and the single point path
+		float maxBatchError;
+	};
+
+	CloudDensityQuery();
+
+	// t0, t1, t2 of VolumetricCloudCommon.hlsli
+	void SetTextures(const CloudReferenceTexture* cloudShape, const CloudReferenceTexture* erosion, const CloudReferenceTexture* weather);
+	// The atlas SampleWeather reads with VirtualWeather set, null keeps the repeating weather map
+	void SetVirtualWeather(const CloudVirtualWeather* virtualWeather) { m_virtualWeather = virtualWeather; }
+	// The table of the HeightLut path, null keeps GetHeightDensityForCloud
+	void SetHeightLut(const CloudHeightLut* heightLut) { m_heightLut = heightLut; }
+	// time is PassCB.Time. Not safe against queries running on other threads.
+	void SetParameters(const CloudParameterCB& cloudCB, float time);
+	bool IsValid() const { return m_cloudShape != nullptr && m_erosion != nullptr && m_weather != nullptr; }
+	const CloudParameterCB& GetParameters() const { return m_params; }
+
+	// lod is the mip of the shape and erosion noise, expensive adds the erosion like the shader
+	float SampleDensity(const XMFLOAT3& p, bool expensive = true, uint32_t lod = 0) const;
+	void SampleDensity(const XMFLOAT3* points, uint32_t count, float* densities, bool expensive = true, uint32_t lod = 0) const;
+	// Density times DensityFactor integrated over each segment with stepsPerSegment midpoint samples,
+	// exp(-opticalDepth) is the transmittance the raymarch sees through it
+	void OpticalDepth(const Segment* segments, uint32_t count, uint32_t stepsPerSegment, float* opticalDepths, bool expensive = true) const;
+
+	// GetNormalizedHeightDensity of the shader, the factor the height puts on the shape noise
+	float GetHeightDensity(float heightFraction, float cloudType) const;
+	// Largest GetHeightDensity at a height over the cloud types the parameters can pick:
+	// CloudType, or every type when it comes from the weather
+	float GetHeightDensityBound(float heightFraction) const;
+	// World space y below bottom and above top of which every density is 0
+	void GetDensityBounds(float& bottom, float& top) const;
+
+	// numQueries random points and segments through the layer within halfExtent of (centerX, centerZ)
+	BenchmarkResult RunBenchmark(uint32_t numQueries, uint32_t stepsPerSegment, uint32_t numThreads, float centerX, float centerZ, float halfExtent) const;
+
+private:
+	XMVECTOR XM_CALLCONV SampleDensity4(FXMVECTOR x, FXMVECTOR y, FXMVECTOR z, bool expensive, uint32_t lod) const;
+	// SampleWeather of the shader, world (x, z) moved by the wind and its moving_uv (u, v)
+	XMVECTOR SampleWeather(float x, float z, float u, float v) const;
+
+	const CloudReferenceTexture* m_cloudShape;
+	const CloudReferenceTexture* m_erosion;
+	const CloudReferenceTexture* m_weather;
+	const CloudVirtualWeather* m_virtualWeather;
+	const CloudHeightLut* m_heightLut;
+
+	CloudParameterCB m_params;
+	// world space y of the earth centre, radii of the layer
+	float m_centerY;
+	float m_innerRadius;
+	float m_outerRadius;
+	// Time * CloudSpeed
+	float m_windOffset;
+};
\ No newline at end of file
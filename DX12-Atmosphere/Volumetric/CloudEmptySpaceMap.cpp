@@ -0,0 +1,313 @@
+#include "stdafx.h"
+#include "CloudEmptySpaceMap.h"
+#include "CloudDensityQuery.h"
+#include <ppl.h>
+#include <chrono>
+
+static inline uint32_t Wrap(int i, uint32_t size)
+{
+	int r = i % (int)size;
+	return (uint32_t)(r < 0 ? r + (int)size : r);
+}
+
+CloudEmptySpaceMap::CloudEmptySpaceMap()
+	: m_width(0),
+	m_height(0),
+	m_coverageScale(1.0f)
+{
+	ZeroMemory(&m_stats, sizeof(Stats));
+	// a query without a table and at the default CloudType, the cumulus gradient
+	SetHeightProfile(CloudDensityQuery());
+}
+
+void CloudEmptySpaceMap::SetHeightProfile(const CloudDensityQuery& query)
+{
+	std::vector<float> bound(kBandScanSteps);
+	for (uint32_t k = 0; k < kBandScanSteps; ++k)
+		bound[k] = query.GetHeightDensityBound((float)(k + 1) / kBandScanSteps);
+	if (bound == m_heightBound)
+		return;
+	m_heightBound.swap(bound);
+	BuildBandTable();
+}
+
+void CloudEmptySpaceMap::BuildBandTable()
+{
+	// The band for coverage c is where the height density bound is > c. The cumulus bound rises,
+	// peaks around h = 0.12 and falls, an edited curve may not be one interval, the band covers
+	// all of them. Scan it and pad by a scan step on both sides.
+	const float step = 1.0f / kBandScanSteps;
+	for (uint32_t i = 0; i < kBandTableSize; ++i)
+	{
+		float c = (float)i / (kBandTableSize - 1);
+		float band_min = 1.0f, band_max = 0.0f;
+		for (uint32_t k = 1; k <= kBandScanSteps; ++k)
+		{
+			float h = k * step;
+			float bound = m_heightBound[k - 1];
+			if (bound > 0.0f && bound * 1.01f > c)
+			{
+				band_min = std::min(band_min, h - step);
+				band_max = std::max(band_max, h + step);
+			}
+		}
+		m_bandMin[i] = band_min;
+		m_bandMax[i] = band_max;
+	}
+}
+
+void CloudEmptySpaceMap::ComputeTexel(uint32_t x, uint32_t y)
+{
+	// a bilinear fetch inside texel (x, y) touches the 3x3 neighbourhood
+	float max_coverage = 0.0f;
+	float min_positive = FLT_MAX;
+	bool has_zero = false;
+	for (int j = -1; j <= 1; ++j)
+	{
+		for (int i = -1; i <= 1; ++i)
+		{
+			float c = m_coverage[Wrap((int)y + j, m_height) * m_width + Wrap((int)x + i, m_width)];
+			if (c > 0.0f)
+			{
+				max_coverage = std::max(max_coverage, c);
+				min_positive = std::min(min_positive, c);
+			}
+			else
+				has_zero = true;
+		}
+	}
+
+	uint32_t index = y * m_width + x;
+	m_levels[0].maxCoverage[index] = max_coverage;
+	// blending with a zero texel gives arbitrarily thin coverage
+	m_minPositive[index] = (has_zero || max_coverage == 0.0f) ? 0.0f : min_positive;
+}
+
+void CloudEmptySpaceMap::ComputeParent(uint32_t level, uint32_t x, uint32_t y)
+{
+	const Level& child = m_levels[level - 1];
+	Level& parent = m_levels[level];
+	float max_coverage = 0.0f;
+	for (uint32_t j = 0; j < 2; ++j)
+	{
+		for (uint32_t i = 0; i < 2; ++i)
+			max_coverage = std::max(max_coverage, child.maxCoverage[(y * 2 + j) * child.width + x * 2 + i]);
+	}
+	parent.maxCoverage[y * parent.width + x] = max_coverage;
+}
+
+void CloudEmptySpaceMap::Build(const float* coverage, uint32_t width, uint32_t height, uint32_t stride)
+{
+	assert(width > 0 && height > 0 && stride > 0);
+	auto start = std::chrono::high_resolution_clock::now();
+
+	m_width = width;
+	m_height = height;
+	m_coverage.resize((size_t)width * height);
+	for (size_t i = 0; i < m_coverage.size(); ++i)
+		m_coverage[i] = coverage[i * stride];
+	m_minPositive.resize(m_coverage.size());
+
+	// Coarser levels only while both sizes stay even, so a cell index wraps exactly like the texels
+	m_levels.clear();
+	Level level0;
+	level0.width = width;
+	level0.height = height;
+	level0.maxCoverage.resize(m_coverage.size());
+	m_levels.push_back(std::move(level0));
+	while (m_levels.back().width % 2 == 0 && m_levels.back().height % 2 == 0)
+	{
+		Level level;
+		level.width = m_levels.back().width / 2;
+		level.height = m_levels.back().height / 2;
+		level.maxCoverage.resize((size_t)level.width * level.height);
+		m_levels.push_back(std::move(level));
+	}
+
+	concurrency::parallel_for(0u, height, [&](uint32_t y)
+	{
+		for (uint32_t x = 0; x < width; ++x)
+			ComputeTexel(x, y);
+	});
+	for (uint32_t l = 1; l < (uint32_t)m_levels.size(); ++l)
+	{
+		for (uint32_t y = 0; y < m_levels[l].height; ++y)
+		{
+			for (uint32_t x = 0; x < m_levels[l].width; ++x)
+				ComputeParent(l, x, y);
+		}
+	}
+
+	uint32_t num_empty = 0;
+	for (float c : m_levels[0].maxCoverage)
+		num_empty += c == 0.0f ? 1 : 0;
+
+	auto end = std::chrono::high_resolution_clock::now();
+	m_stats.buildMilliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+	m_stats.updateMilliseconds = 0.0;
+	m_stats.updatedTexels = width * height;
+	m_stats.numLevels = (uint32_t)m_levels.size();
+	m_stats.emptyFraction = (float)num_empty / (width * height);
+}
+
+void CloudEmptySpaceMap::Update(const float* coverage, uint32_t width, uint32_t height, uint32_t stride)
+{
+	if (!IsValid() || width != m_width || height != m_height)
+	{
+		Build(coverage, width, height, stride);
+		return;
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	// texels whose 3x3 neighbourhood saw a change
+	std::vector<uint8_t> dirty((size_t)width * height, 0);
+	bool any_change = false;
+	for (uint32_t y = 0; y < height; ++y)
+	{
+		for (uint32_t x = 0; x < width; ++x)
+		{
+			size_t index = (size_t)y * width + x;
+			float c = coverage[index * stride];
+			if (c == m_coverage[index])
+				continue;
+			m_coverage[index] = c;
+			any_change = true;
+			for (int j = -1; j <= 1; ++j)
+			{
+				for (int i = -1; i <= 1; ++i)
+					dirty[Wrap((int)y + j, height) * width + Wrap((int)x + i, width)] = 1;
+			}
+		}
+	}
+
+	uint32_t updated = 0;
+	if (any_change)
+	{
+		int32_t num_empty = (int32_t)std::lround(m_stats.emptyFraction * width * height);
+		for (uint32_t y = 0; y < height; ++y)
+		{
+			for (uint32_t x = 0; x < width; ++x)
+			{
+				if (!dirty[y * width + x])
+					continue;
+				num_empty -= m_levels[0].maxCoverage[y * width + x] == 0.0f ? 1 : 0;
+				ComputeTexel(x, y);
+				num_empty += m_levels[0].maxCoverage[y * width + x] == 0.0f ? 1 : 0;
+				updated++;
+			}
+		}
+		m_stats.emptyFraction = (float)num_empty / (width * height);
+
+		// walk the dirty cells up the pyramid
+		for (uint32_t l = 1; l < (uint32_t)m_levels.size(); ++l)
+		{
+			const Level& child = m_levels[l - 1];
+			std::vector<uint8_t> parent_dirty((size_t)m_levels[l].width * m_levels[l].height, 0);
+			for (uint32_t y = 0; y < child.height; ++y)
+			{
+				for (uint32_t x = 0; x < child.width; ++x)
+				{
+					if (dirty[y * child.width + x])
+						parent_dirty[(y / 2) * m_levels[l].width + x / 2] = 1;
+				}
+			}
+			for (uint32_t y = 0; y < m_levels[l].height; ++y)
+			{
+				for (uint32_t x = 0; x < m_levels[l].width; ++x)
+				{
+					if (parent_dirty[y * m_levels[l].width + x])
+						ComputeParent(l, x, y);
+				}
+			}
+			dirty.swap(parent_dirty);
+		}
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+	m_stats.updateMilliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+	m_stats.updatedTexels = updated;
+}
+
+bool CloudEmptySpaceMap::IsEmpty(float u, float v, float heightFraction) const
+{
+	if (heightFraction < 0.0f || heightFraction > 1.0f || m_coverageScale <= 0.0f)
+		return true;
+
+	uint32_t index = Wrap((int)std::floor(v * m_height), m_height) * m_width + Wrap((int)std::floor(u * m_width), m_width);
+	float max_coverage = m_levels[0].maxCoverage[index] * m_coverageScale;
+	if (max_coverage <= 0.0f)
+		return true;
+	// Remap(base, coverage, 1, 0, 1) flips sign once coverage passes 1, the band doesn't hold there
+	if (max_coverage > 1.0f)
+		return false;
+
+	// rounding the coverage down picks a wider band
+	float c = m_minPositive[index] * m_coverageScale;
+	uint32_t band = std::min((uint32_t)(c * (kBandTableSize - 1)), kBandTableSize - 1);
+	return heightFraction < m_bandMin[band] || heightFraction > m_bandMax[band];
+}
+
+bool CloudEmptySpaceMap::IsRectEmpty(uint32_t level, int x0, int x1, int y0, int y1) const
+{
+	const Level& l = m_levels[level];
+	int count_x = std::min(x1 - x0 + 1, (int)l.width);
+	int count_y = std::min(y1 - y0 + 1, (int)l.height);
+	for (int j = 0; j < count_y; ++j)
+	{
+		const float* row = &l.maxCoverage[Wrap(y0 + j, l.height) * l.width];
+		for (int i = 0; i < count_x; ++i)
+		{
+			if (row[Wrap(x0 + i, l.width)] > 0.0f)
+				return false;
+		}
+	}
+	return true;
+}
+
+uint32_t CloudEmptySpaceMap::GetEmptySteps(float u, float v, float du, float dv, float spreadU, float spreadV, uint32_t maxSteps) const
+{
+	if (m_coverageScale <= 0.0f)
+		return maxSteps;
+
+	// footprint in texels, the wind spread turns the point into a segment
+	float x_min = (u + std::min(spreadU, 0.0f)) * m_width;
+	float x_max = (u + std::max(spreadU, 0.0f)) * m_width;
+	float y_min = (v + std::min(spreadV, 0.0f)) * m_height;
+	float y_max = (v + std::max(spreadV, 0.0f)) * m_height;
+
+	// climb while the cells around the footprint stay empty, the coarsest one gives the longest jump
+	int empty_level = -1;
+	for (uint32_t l = 0; l < (uint32_t)m_levels.size(); ++l)
+	{
+		float cell = (float)(1u << l);
+		if (!IsRectEmpty(l, (int)std::floor(x_min / cell), (int)std::floor(x_max / cell), (int)std::floor(y_min / cell), (int)std::floor(y_max / cell)))
+			break;
+		empty_level = (int)l;
+	}
+	if (empty_level < 0)
+		return 0;
+
+	float cell = (float)(1u << empty_level);
+	float rect_x0 = std::floor(x_min / cell) * cell;
+	float rect_x1 = (std::floor(x_max / cell) + 1.0f) * cell;
+	float rect_y0 = std::floor(y_min / cell) * cell;
+	float rect_y1 = (std::floor(y_max / cell) + 1.0f) * cell;
+
+	// steps n with the whole footprint still inside the empty rectangle
+	float dx = du * m_width;
+	float dy = dv * m_height;
+	float limit = (float)maxSteps;
+	if (dx > 0.0f)
+		limit = std::min(limit, (rect_x1 - x_max) / dx);
+	else if (dx < 0.0f)
+		limit = std::min(limit, (x_min - rect_x0) / -dx);
+	if (dy > 0.0f)
+		limit = std::min(limit, (rect_y1 - y_max) / dy);
+	else if (dy < 0.0f)
+		limit = std::min(limit, (y_min - rect_y0) / -dy);
+
+	float last_step = std::floor(limit - 1e-4f);
+	uint32_t steps = last_step < 0.0f ? 1 : (uint32_t)last_step + 1;
+	return std::min(steps, maxSteps);
+}
\ No newline at end of file
@@ -0,0 +1,80 @@
+#pragma once
+#include "stdafx.h"
+
+class CloudDensityQuery;
+
+// Conservative occupancy of the cloud layer for empty space skipping.
+// Level 0 stores, per weather texel, the max coverage and the smallest positive
+// coverage a bilinear fetch around that texel can return. Coarser levels are a
+// max pyramid of the coverage, so a zero cell at any level means no density at
+// any height in that area. The height profile adds a band per texel: density
+// needs GetHeightDensity(h) > coverage, so a dense coverage limits the cloud to a
+// range of height fractions.
+// Assumes the shape noise is in [0, 1], which holds for the generated volumes.
+class CloudEmptySpaceMap
+{
+public:
+	struct Stats
+	{
+		double buildMilliseconds;
+		double updateMilliseconds;
+		// level 0 texels recomputed by the last Update
+		uint32_t updatedTexels;
+		uint32_t numLevels;
+		// fraction of level 0 with zero coverage
+		float emptyFraction;
+	};
+
+	CloudEmptySpaceMap();
+
+	// coverage[(y * width + x) * stride] is the weather r channel
+	void Build(const float* coverage, uint32_t width, uint32_t height, uint32_t stride);
+	// Recomputes only the texels around changed weather values, falls back to Build on a size change
+	void Update(const float* coverage, uint32_t width, uint32_t height, uint32_t stride);
+	// CloudCoverage of CloudParameterCB. Applied at lookup, so changing it needs no rebuild.
+	void SetCoverageScale(float scale) { m_coverageScale = scale; }
+	// Bands from GetHeightDensityBound of the query, the height table and cloud types it is set
+	// up with. The cumulus gradient until the first call, the bands are only rebuilt on a change.
+	void SetHeightProfile(const CloudDensityQuery& query);
+
+	// uv as in SampleCloudDensity (moving_uv, wrapped), heightFraction of the sample point
+	bool IsEmpty(float u, float v, float heightFraction) const;
+	// Number of consecutive steps, starting with the current one, whose footprint is all zero
+	// coverage. (u, v) is moving_uv at height fraction 0, the wind moves it by up to
+	// (spreadU, spreadV) across the layer.
+	uint32_t GetEmptySteps(float u, float v, float du, float dv, float spreadU, float spreadV, uint32_t maxSteps) const;
+
+	bool IsValid() const { return !m_levels.empty(); }
+	const Stats& GetStats() const { return m_stats; }
+
+private:
+	struct Level
+	{
+		uint32_t width;
+		uint32_t height;
+		std::vector<float> maxCoverage;
+	};
+
+	static const uint32_t kBandTableSize = 256;
+	static const uint32_t kBandScanSteps = 4096;
+
+	void ComputeTexel(uint32_t x, uint32_t y);
+	void ComputeParent(uint32_t level, uint32_t x, uint32_t y);
+	void BuildBandTable();
+	bool IsRectEmpty(uint32_t level, int x0, int x1, int y0, int y1) const;
+
+	uint32_t m_width;
+	uint32_t m_height;
+	std::vector<float> m_coverage;
+	// smallest positive bilinear coverage around each texel, 0 if zero and non zero texels mix
+	std::vector<float> m_minPositive;
+	std::vector<Level> m_levels;
+
+	float m_coverageScale;
+	// the height density bound at (k + 1) / kBandScanSteps
+	std::vector<float> m_heightBound;
+	float m_bandMin[kBandTableSize];
+	float m_bandMax[kBandTableSize];
+
+	Stats m_stats;
+};
\ No newline at end of file
@@ -0,0 +1,219 @@
+#include "stdafx.h"
+#include "CloudHeightLut.h"
+#include <algorithm>
+#include <chrono>
+
+// Scalar ALU of GetHeightDensityForCloud(h, type) / h counted from the HLSL: 6 for the
+// three type factors, 12 for the float4 blend of the gradients, 7 per smoothstep, 1 for
+// the difference and 2 for the divide
+static const uint32_t kAnalyticAlu = 6 + 12 + 2 * 7 + 1 + 2;
+// with a constant type the blend folds into the edges, a smoothstep is a mad_sat and 3 more
+static const uint32_t kAnalyticConstantTypeAlu = 2 * 4 + 1 + 2;
+// one float2 mad for the uv of SampleHeightDensity
+static const uint32_t kLutAlu = 2;
+
+static inline float Saturate(float x)
+{
+	return std::min(std::max(x, 0.0f), 1.0f);
+}
+
+static inline float SmoothStep(float a, float b, float x)
+{
+	float t = Saturate((x - a) / (b - a));
+	return t * t * (3.0f - 2.0f * t);
+}
+
+static float EvaluateKeys(const CloudHeightLut::Key* keys, size_t numKeys, float h)
+{
+	if (numKeys == 0 || h < keys[0].height || h > keys[numKeys - 1].height)
+		return 0.0f;
+	size_t k = 0;
+	while (k + 2 < numKeys && h > keys[k + 1].height)
+		++k;
+	if (numKeys == 1)
+		return keys[0].density;
+	const CloudHeightLut::Key& a = keys[k];
+	const CloudHeightLut::Key& b = keys[k + 1];
+	if (b.height <= a.height)
+		return b.density;
+	float t = SmoothStep(a.height, b.height, h);
+	return a.density + (b.density - a.density) * t;
+}
+
+std::vector<CloudHeightLut::Curve> CloudHeightLut::DefaultCurves()
+{
+	// STRATUS_GRADIENT, STRATOCUMULUS_GRADIENT and CUMULUS_GRADIENT as keys
+	const float gradients[3][4] = {
+		{ 0.0f, 0.1f, 0.2f, 0.3f },
+		{ 0.02f, 0.2f, 0.48f, 0.625f },
+		{ 0.0f, 0.1625f, 0.88f, 0.98f } };
+	std::vector<Curve> curves(3);
+	for (uint32_t i = 0; i < 3; ++i)
+	{
+		const float* g = gradients[i];
+		curves[i].cloudType = 0.5f * i;
+		curves[i].keys = { { g[0], 0.0f }, { g[1], 1.0f }, { g[2], 1.0f }, { g[3], 0.0f } };
+	}
+	return curves;
+}
+
+float CloudHeightLut::Analytic(float heightFraction, float cloudType)
+{
+	float stratus_factor = 1.0f - Saturate(cloudType * 2.0f);
+	float strato_cumulus_factor = 1.0f - std::abs(cloudType - 0.5f) * 2.0f;
+	float cumulus_factor = Saturate(cloudType - 0.5f) * 2.0f;
+
+	const float stratus[4] = { 0.0f, 0.1f, 0.2f, 0.3f };
+	const float strato_cumulus[4] = { 0.02f, 0.2f, 0.48f, 0.625f };
+	const float cumulus[4] = { 0.0f, 0.1625f, 0.88f, 0.98f };
+	float g[4];
+	for (uint32_t i = 0; i < 4; ++i)
+		g[i] = stratus_factor * stratus[i] + strato_cumulus_factor * strato_cumulus[i] + cumulus_factor * cumulus[i];
+	return SmoothStep(g[0], g[1], heightFraction) - SmoothStep(g[2], g[3], heightFraction);
+}
+
+CloudHeightLut::CloudHeightLut()
+	: m_width(0),
+	m_height(0)
+{
+}
+
+void CloudHeightLut::Create(uint32_t width, uint32_t height)
+{
+	assert(width > 1 && height > 1);
+	m_width = width;
+	m_height = height;
+	m_table.assign((size_t)width * height, 0.0f);
+	Bake();
+}
+
+void CloudHeightLut::SetCurves(const std::vector<Curve>& curves)
+{
+	m_curves = curves;
+	for (Curve& curve : m_curves)
+	{
+		assert(curve.keys.size() <= kMaxKeys);
+		if (curve.keys.size() > kMaxKeys)
+			curve.keys.resize(kMaxKeys);
+		std::stable_sort(curve.keys.begin(), curve.keys.end(), [](const Key& a, const Key& b) { return a.height < b.height; });
+	}
+	std::stable_sort(m_curves.begin(), m_curves.end(), [](const Curve& a, const Curve& b) { return a.cloudType < b.cloudType; });
+	Bake();
+}
+
+float CloudHeightLut::Evaluate(float heightFraction, float cloudType) const
+{
+	if (m_curves.empty())
+		return 0.0f;
+	size_t c = 0;
+	while (c + 2 < m_curves.size() && cloudType > m_curves[c + 1].cloudType)
+		++c;
+	const Curve& a = m_curves[c];
+	if (m_curves.size() == 1 || cloudType <= a.cloudType)
+		return EvaluateKeys(a.keys.data(), a.keys.size(), heightFraction);
+	const Curve& b = m_curves[c + 1];
+	if (cloudType >= b.cloudType)
+		return EvaluateKeys(b.keys.data(), b.keys.size(), heightFraction);
+
+	float w = (cloudType - a.cloudType) / (b.cloudType - a.cloudType);
+	if (a.keys.size() != b.keys.size())
+	{
+		float da = EvaluateKeys(a.keys.data(), a.keys.size(), heightFraction);
+		float db = EvaluateKeys(b.keys.data(), b.keys.size(), heightFraction);
+		return da + (db - da) * w;
+	}
+	Key keys[kMaxKeys];
+	for (size_t k = 0; k < a.keys.size(); ++k)
+	{
+		keys[k].height = a.keys[k].height + (b.keys[k].height - a.keys[k].height) * w;
+		keys[k].density = a.keys[k].density + (b.keys[k].density - a.keys[k].density) * w;
+	}
+	return EvaluateKeys(keys, a.keys.size(), heightFraction);
+}
+
+void CloudHeightLut::Bake()
+{
+	if (m_table.empty())
+		return;
+	for (uint32_t j = 0; j < m_height; ++j)
+	{
+		// density / h goes to 0 with h for curves starting at 0, the shader's 0 / 0 ends up 0 as well
+		float h = (float)j / (m_height - 1);
+		for (uint32_t i = 0; i < m_width; ++i)
+		{
+			float type = (float)i / (m_width - 1);
+			m_table[(size_t)j * m_width + i] = j > 0 ? Evaluate(h, type) / h : 0.0f;
+		}
+	}
+}
+
+float CloudHeightLut::Sample(float heightFraction, float cloudType) const
+{
+	float fx = Saturate(cloudType) * (m_width - 1);
+	float fy = Saturate(heightFraction) * (m_height - 1);
+	uint32_t x0 = std::min((uint32_t)fx, m_width - 2);
+	uint32_t y0 = std::min((uint32_t)fy, m_height - 2);
+	float tx = fx - x0, ty = fy - y0;
+	const float* row0 = &m_table[(size_t)y0 * m_width];
+	const float* row1 = row0 + m_width;
+	float a = row0[x0] + (row0[x0 + 1] - row0[x0]) * tx;
+	float b = row1[x0] + (row1[x0 + 1] - row1[x0]) * tx;
+	return a + (b - a) * ty;
+}
+
+std::vector<CloudHeightLut::Report> CloudHeightLut::Measure(const std::vector<Curve>& curves, uint32_t width, const std::vector<uint32_t>& heights)
+{
+	const uint32_t num_types = 129, num_heights = 4097;
+	std::vector<Report> reports;
+	for (uint32_t height : heights)
+	{
+		CloudHeightLut lut;
+		lut.Create(width, height);
+		lut.SetCurves(curves);
+
+		Report report;
+		ZeroMemory(&report, sizeof(Report));
+		report.width = width;
+		report.height = height;
+		report.analyticAlu = kAnalyticAlu;
+		report.analyticConstantTypeAlu = kAnalyticConstantTypeAlu;
+		report.lutAlu = kLutAlu;
+		for (uint32_t i = 0; i < num_types; ++i)
+		{
+			float type = (float)i / (num_types - 1);
+			for (uint32_t j = 1; j < num_heights; ++j)
+			{
+				float h = (float)j / (num_heights - 1);
+				float sampled = lut.Sample(h, type);
+				float analytic = Analytic(h, type) / h;
+				report.maxDeviation = std::max(report.maxDeviation, std::abs(sampled - analytic));
+				report.maxDensityDeviation = std::max(report.maxDensityDeviation, std::abs(sampled - analytic) * h);
+				report.maxCurveDeviation = std::max(report.maxCurveDeviation, std::abs(sampled - lut.Evaluate(h, type) / h));
+			}
+		}
+
+		// the same pseudo random points for both, summed so nothing is optimized away
+		const uint32_t num_samples = 1 << 20;
+		float sum = 0.0f;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (uint32_t s = 0; s < num_samples; ++s)
+		{
+			float h = (float)((s * 2654435761u) >> 8) / (1 << 24) + 1e-4f;
+			sum += Analytic(h, (float)(s & 255) / 255.0f) / h;
+		}
+		auto middle = std::chrono::high_resolution_clock::now();
+		for (uint32_t s = 0; s < num_samples; ++s)
+		{
+			float h = (float)((s * 2654435761u) >> 8) / (1 << 24) + 1e-4f;
+			sum -= lut.Sample(h, (float)(s & 255) / 255.0f);
+		}
+		auto end = std::chrono::high_resolution_clock::now();
+		report.analyticNanoseconds = std::chrono::duration<double, std::nano>(middle - start).count() / num_samples;
+		report.lutNanoseconds = std::chrono::duration<double, std::nano>(end - middle).count() / num_samples;
+		// keeps sum alive, it is the total deviation and never this large
+		if (sum == FLT_MAX)
+			report.maxDeviation = sum;
+		reports.push_back(report);
+	}
+	return reports;
+}
\ No newline at end of file
@@ -0,0 +1,83 @@
+#pragma once
+#include "stdafx.h"
+
+// GetHeightDensityForCloud(h, type) / h of SampleCloudDensity baked into a 2D table,
+// x the cloud type and y the height fraction, from curves an artist can edit. A curve
+// is the density over the height fraction: keys joined by smoothstep, 0 below the
+// first key and above the last. Curves sit at cloud types. Between two curves with the
+// same number of keys the keys themselves are blended, which is what the shader does
+// with the gradient corners, otherwise the densities are. Texel (i, j) is at type
+// i / (width - 1) and height j / (height - 1), so the shader reads both ends exactly.
+// The default curves are the three gradients of the shader.
+class CloudHeightLut
+{
+public:
+	static const uint32_t kMaxKeys = 8;
+
+	struct Key
+	{
+		float height;
+		float density;
+	};
+
+	struct Curve
+	{
+		float cloudType;
+		// sorted by height, at most kMaxKeys
+		std::vector<Key> keys;
+	};
+
+	struct Report
+	{
+		uint32_t width;
+		uint32_t height;
+		// of the normalized value SampleCloudDensity multiplies with, and of the density itself
+		float maxDeviation;
+		float maxDensityDeviation;
+		// against the curves evaluated exactly, the error of the table alone
+		float maxCurveDeviation;
+		// scalar ALU per density sample counted from the HLSL, with the cloud type from the
+		// weather and with the constant type the compiler folds the blend for
+		uint32_t analyticAlu;
+		uint32_t analyticConstantTypeAlu;
+		// the uv, the table costs one fetch on top
+		uint32_t lutAlu;
+		// the same on the CPU, per sample
+		double analyticNanoseconds;
+		double lutNanoseconds;
+	};
+
+	// Stratus, stratocumulus and cumulus at cloud type 0, 0.5 and 1
+	static std::vector<Curve> DefaultCurves();
+	// GetHeightDensityForCloud of VolumetricCloudCommon.hlsli
+	static float Analytic(float heightFraction, float cloudType);
+
+	CloudHeightLut();
+
+	void Create(uint32_t width, uint32_t height);
+	// Sorts the curves by type and their keys by height, then bakes the table
+	void SetCurves(const std::vector<Curve>& curves);
+
+	// Density of the curves at (heightFraction, cloudType), no table
+	float Evaluate(float heightFraction, float cloudType) const;
+	// Density / heightFraction from the table, bilinear and clamped like the shader
+	float Sample(float heightFraction, float cloudType) const;
+
+	bool IsValid() const { return !m_table.empty(); }
+	uint32_t GetWidth() const { return m_width; }
+	uint32_t GetHeight() const { return m_height; }
+	const std::vector<Curve>& GetCurves() const { return m_curves; }
+	// width * height floats, row j is height fraction j / (height - 1)
+	const std::vector<float>& GetTable() const { return m_table; }
+
+	// One table per height against the analytic gradients, the curves alone and the CPU cost
+	static std::vector<Report> Measure(const std::vector<Curve>& curves, uint32_t width, const std::vector<uint32_t>& heights);
+
+private:
+	void Bake();
+
+	uint32_t m_width;
+	uint32_t m_height;
+	std::vector<Curve> m_curves;
+	std::vector<float> m_table;
+};
\ No newline at end of file
@@ -0,0 +1,359 @@
+#include "stdafx.h"
+#include "CloudMiePhase.h"
+#include <ppl.h>
+#include <atomic>
+#include <complex>
+#include <chrono>
+#include <thread>
+
+static const double kPi = 3.14159265358979323846;
+
+CloudMiePhase::Desc CloudMiePhase::DefaultDesc()
+{
+	// a fair weather cumulus, red, green and blue light
+	Desc desc;
+	desc.effectiveRadius = 10.0f;
+	desc.effectiveVariance = 0.1f;
+	desc.wavelengths[0] = 0.68f;
+	desc.wavelengths[1] = 0.55f;
+	desc.wavelengths[2] = 0.44f;
+	desc.refractiveIndex[0] = 1.331f;
+	desc.refractiveIndex[1] = 1.333f;
+	desc.refractiveIndex[2] = 1.337f;
+	desc.numRadii = 256;
+	desc.numAngles = 256;
+	desc.angleSubsamples = 2;
+	return desc;
+}
+
+CloudMiePhase::CloudMiePhase()
+{
+	ZeroMemory(&m_desc, sizeof(Desc));
+	ZeroMemory(&m_report, sizeof(Report));
+}
+
+double CloudMiePhase::Solve(double x, double m, const double* cosines, size_t numCosines, double* intensity, uint64_t& numTerms)
+{
+	// BHMIE of Bohren and Huffman: the logarithmic derivative by downward recurrence,
+	// the Riccati-Bessel functions and the angular functions pi and tau upward
+	typedef std::complex<double> Complex;
+	const double y = m * x;
+	const uint32_t num_terms = (uint32_t)(x + 4.0 * std::cbrt(x) + 2.0);
+	const uint32_t num_log_terms = (uint32_t)std::max((double)num_terms, std::abs(y)) + 15;
+
+	std::vector<double> log_derivative(num_log_terms + 1, 0.0);
+	for (uint32_t n = num_log_terms; n > 1; --n)
+		log_derivative[n - 1] = n / y - 1.0 / (log_derivative[n] + n / y);
+
+	std::vector<Complex> s1(numCosines, 0.0), s2(numCosines, 0.0);
+	std::vector<double> pi0(numCosines, 0.0), pi1(numCosines, 1.0);
+	double psi0 = std::cos(x), psi1 = std::sin(x);
+	double chi0 = -std::sin(x), chi1 = std::cos(x);
+	Complex xi1(psi1, -chi1);
+	double qsca = 0.0;
+	for (uint32_t n = 1; n <= num_terms; ++n)
+	{
+		double fn = (2.0 * n + 1.0) / (n * (n + 1.0));
+		double psi = (2.0 * n - 1.0) * psi1 / x - psi0;
+		double chi = (2.0 * n - 1.0) * chi1 / x - chi0;
+		Complex xi(psi, -chi);
+		double da = log_derivative[n] / m + n / x;
+		double db = log_derivative[n] * m + n / x;
+		Complex an = (da * psi - psi1) / (da * xi - xi1);
+		Complex bn = (db * psi - psi1) / (db * xi - xi1);
+		qsca += (2.0 * n + 1.0) * (std::norm(an) + std::norm(bn));
+
+		for (size_t j = 0; j < numCosines; ++j)
+		{
+			double mu = cosines[j];
+			double pi = pi1[j];
+			double tau = n * mu * pi - (n + 1.0) * pi0[j];
+			s1[j] += fn * (an * pi + bn * tau);
+			s2[j] += fn * (an * tau + bn * pi);
+			pi1[j] = ((2.0 * n + 1.0) * mu * pi - (n + 1.0) * pi0[j]) / n;
+			pi0[j] = pi;
+		}
+
+		psi0 = psi1;
+		psi1 = psi;
+		chi0 = chi1;
+		chi1 = chi;
+		xi1 = Complex(psi1, -chi1);
+	}
+	numTerms += (uint64_t)num_terms * numCosines;
+
+	for (size_t j = 0; j < numCosines; ++j)
+		intensity[j] = 0.5 * (std::norm(s1[j]) + std::norm(s2[j]));
+	// Qsca = 2 / x^2 * sum, times pi x^2
+	return 2.0 * kPi * qsca;
+}
+
+void CloudMiePhase::Bake(const Desc& desc)
+{
+	assert(desc.effectiveRadius > 0.0f && desc.effectiveVariance > 0.0f && desc.effectiveVariance < 1.0f / 3.0f);
+	assert(desc.numRadii > 1 && desc.numAngles > 1 && desc.angleSubsamples > 0);
+	m_desc = desc;
+	ZeroMemory(&m_report, sizeof(Report));
+	auto start = std::chrono::high_resolution_clock::now();
+
+	// the radii carrying the scattering, where r^2 n(r) is above 1e-6 of its peak,
+	// n(r) = r^((1 - 3b) / b) exp(-r / (a b)) for effective radius a and variance b
+	const double a = desc.effectiveRadius, b = desc.effectiveVariance;
+	auto log_weight = [a, b](double r) { return ((1.0 - 3.0 * b) / b + 2.0) * std::log(r) - r / (a * b); };
+	const double peak = log_weight(a * (1.0 - b));
+	double r_min = a, r_max = a;
+	for (uint32_t k = 1; k <= 4096; ++k)
+	{
+		double r = a * 8.0 * k / 4096;
+		if (log_weight(r) - peak > std::log(1e-6))
+		{
+			r_min = std::min(r_min, r);
+			r_max = std::max(r_max, r);
+		}
+	}
+
+	// the subsamples of every bin, then the bin edges to check the table against
+	const uint32_t num_angles = desc.numAngles, subsamples = desc.angleSubsamples;
+	const size_t num_sub = (size_t)num_angles * subsamples;
+	const double bin_angle = kPi / num_angles;
+	std::vector<double> cosines(num_sub + num_angles + 1);
+	for (uint32_t j = 0; j < num_angles; ++j)
+	{
+		for (uint32_t k = 0; k < subsamples; ++k)
+			cosines[(size_t)j * subsamples + k] = std::cos((j + (k + 0.5) / subsamples) * bin_angle);
+	}
+	for (uint32_t j = 0; j <= num_angles; ++j)
+		cosines[num_sub + j] = std::cos(j * bin_angle);
+
+	const uint32_t num_radii = desc.numRadii;
+	const double dr = (r_max - r_min) / (num_radii - 1);
+	std::vector<double> phase[3];
+	std::atomic<uint64_t> num_terms(0);
+	for (uint32_t c = 0; c < 3; ++c)
+	{
+		// dsigma / dOmega and sigma of every radius, weighted by the distribution, summed after
+		std::vector<double> intensity((size_t)num_radii * cosines.size());
+		std::vector<double> cross_section(num_radii);
+		const double k = 2.0 * kPi / desc.wavelengths[c];
+		concurrency::parallel_for(0u, num_radii, [&](uint32_t i)
+		{
+			double r = r_min + i * dr;
+			uint64_t terms = 0;
+			cross_section[i] = Solve(k * r, desc.refractiveIndex[c], cosines.data(), cosines.size(), &intensity[(size_t)i * cosines.size()], terms);
+			num_terms += terms;
+		});
+		m_report.maxSizeParameter = std::max(m_report.maxSizeParameter, (float)(k * r_max));
+
+		// n(r) dr, the k^2 of both sums cancels
+		phase[c].assign(cosines.size(), 0.0);
+		double sigma = 0.0;
+		for (uint32_t i = 0; i < num_radii; ++i)
+		{
+			double r = r_min + i * dr;
+			double w = std::exp(log_weight(r) - peak) / (r * r) * ((i == 0 || i == num_radii - 1) ? 0.5 : 1.0);
+			sigma += w * cross_section[i];
+			const double* row = &intensity[(size_t)i * cosines.size()];
+			for (size_t j = 0; j < cosines.size(); ++j)
+				phase[c][j] += w * row[j];
+		}
+		for (double& p : phase[c])
+			p /= sigma;
+	}
+	auto solved = std::chrono::high_resolution_clock::now();
+
+	// row 0, solid angle averages of the subsamples and their integral per bin
+	m_table.assign((size_t)num_angles * 3, XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f));
+	std::vector<double> bin_integral[4];
+	for (uint32_t c = 0; c < 4; ++c)
+	{
+		bin_integral[c].resize(num_angles);
+		double total = 0.0;
+		for (uint32_t j = 0; j < num_angles; ++j)
+		{
+			double value = 0.0;
+			if (c < 3)
+			{
+				double sum = 0.0, weight = 0.0;
+				for (uint32_t s = 0; s < subsamples; ++s)
+				{
+					double w = std::sin((j + (s + 0.5) / subsamples) * bin_angle);
+					sum += phase[c][(size_t)j * subsamples + s] * w;
+					weight += w;
+				}
+				value = sum / weight;
+			}
+			else
+				value = (m_table[j].x + m_table[j].y + m_table[j].z) / 3.0;
+			(&m_table[j].x)[c] = (float)value;
+			double solid_angle = 2.0 * kPi * (std::cos(j * bin_angle) - std::cos((j + 1) * bin_angle));
+			bin_integral[c][j] = value * solid_angle;
+			total += bin_integral[c][j];
+			// the mean cosine of a bin with a constant phase, times its integral
+			if (c < 3)
+				m_report.g[c] += (float)(value * kPi * (std::pow(std::cos(j * bin_angle), 2.0) - std::pow(std::cos((j + 1) * bin_angle), 2.0)));
+		}
+		if (c < 3)
+		{
+			m_report.normalization[c] = (float)total;
+			m_report.g[c] /= (float)total;
+		}
+		else
+		{
+			// an odd count splits the middle bin between the two
+			double forward = 0.0, backward = 0.0;
+			for (uint32_t j = 0; j < num_angles; ++j)
+			{
+				if (2 * j + 1 < num_angles)
+					forward += bin_integral[c][j];
+				else if (2 * j + 1 > num_angles)
+					backward += bin_integral[c][j];
+				else
+				{
+					forward += 0.5 * bin_integral[c][j];
+					backward += 0.5 * bin_integral[c][j];
+				}
+			}
+			m_report.forwardBackRatio = (float)(forward / backward);
+		}
+
+		// row 1 and row 2, the phase is constant in a bin so the CDF is linear in the cosine there
+		double cdf = 0.0;
+		uint32_t bin = 0;
+		std::vector<double> cdf_end(num_angles);
+		for (uint32_t j = 0; j < num_angles; ++j)
+		{
+			cdf += bin_integral[c][j] / total;
+			cdf_end[j] = cdf;
+			(&m_table[num_angles + j].x)[c] = (float)cdf;
+		}
+		for (uint32_t i = 0; i < num_angles; ++i)
+		{
+			double u = (i + 0.5) / num_angles;
+			while (bin + 1 < num_angles && cdf_end[bin] < u)
+				++bin;
+			double cdf_start = bin > 0 ? cdf_end[bin - 1] : 0.0;
+			double t = cdf_end[bin] > cdf_start ? (u - cdf_start) / (cdf_end[bin] - cdf_start) : 0.5;
+			double cos0 = std::cos(bin * bin_angle), cos1 = std::cos((bin + 1) * bin_angle);
+			double angle = std::acos(std::min(std::max(cos0 + (cos1 - cos0) * t, -1.0), 1.0));
+			(&m_table[2 * num_angles + i].x)[c] = (float)(angle / kPi);
+		}
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+
+	double solve_seconds = std::chrono::duration<double>(solved - start).count();
+	m_report.solveMilliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+	m_report.numThreads = std::max(1u, std::thread::hardware_concurrency());
+	m_report.sizesPerSecond = 3.0 * num_radii / std::max(solve_seconds, 1e-9);
+	m_report.termsPerSecond = num_terms / std::max(solve_seconds, 1e-9);
+
+	// the table between bin centres against the solver at the edges, the first and last edge sit on a clamp
+	double sum_squared = 0.0;
+	uint32_t num_checked = 0;
+	for (uint32_t c = 0; c < 3; ++c)
+	{
+		for (uint32_t j = 1; j < num_angles; ++j)
+		{
+			double exact = phase[c][num_sub + j];
+			double error = std::abs(Evaluate((float)cosines[num_sub + j], c) - exact) / exact;
+			m_report.maxRelativeError = std::max(m_report.maxRelativeError, (float)error);
+			sum_squared += error * error;
+			++num_checked;
+		}
+
+		// stratified samples through the inverse CDF
+		const uint32_t num_samples = 1 << 16;
+		double sum = 0.0;
+		for (uint32_t s = 0; s < num_samples; ++s)
+			sum += SampleCosTheta((s + 0.5f) / num_samples, c);
+		m_report.sampledG[c] = (float)(sum / num_samples);
+	}
+	m_report.rmsRelativeError = (float)std::sqrt(sum_squared / num_checked);
+
+	float fit_forward, fit_backward;
+	GetFitHemispheres(fit_forward, fit_backward);
+	m_report.fitForwardBackRatio = fit_forward / fit_backward;
+}
+
+std::vector<XMFLOAT4> CloudMiePhase::GetShaderTable() const
+{
+	std::vector<XMFLOAT4> table = m_table;
+	const float scale = GetFitIntegral();
+	for (uint32_t j = 0; j < m_desc.numAngles && j < table.size(); ++j)
+	{
+		table[j].x *= scale;
+		table[j].y *= scale;
+		table[j].z *= scale;
+		table[j].w *= scale;
+	}
+	return table;
+}
+
+float CloudMiePhase::NumericalMieFit(float cosTheta)
+{
+	// https://www.shadertoy.com/view/4sjBDG
+	const float best_params[10] =
+	{
+		9.805233e-06f, -6.500000e+01f, -5.500000e+01f, 8.194068e-01f, 1.388198e-01f,
+		-8.370334e+01f, 7.810083e+00f, 2.054747e-03f, 2.600563e-02f, -4.552125e-12f
+	};
+	float p1 = cosTheta + best_params[3];
+	return std::exp(best_params[1] * cosTheta + best_params[2]) * best_params[0] +
+		std::exp(best_params[5] * p1 * p1) * best_params[4] +
+		std::exp(best_params[6] * cosTheta) * best_params[7] +
+		std::exp(best_params[9] * cosTheta) * best_params[8];
+}
+
+float CloudMiePhase::MiePhase(const CloudMiePhase* table, float cosTheta)
+{
+	if (table == nullptr || !table->IsValid())
+		return NumericalMieFit(cosTheta);
+	return table->Evaluate(cosTheta, 3) * GetFitIntegral();
+}
+
+void CloudMiePhase::GetFitHemispheres(float& forward, float& backward)
+{
+	// midpoints of bins of equal angle, once
+	static const std::pair<float, float> s_hemispheres = []()
+	{
+		const uint32_t n = 1 << 16;
+		double sums[2] = { 0.0, 0.0 };
+		for (uint32_t j = 0; j < n; ++j)
+		{
+			double cos_begin = std::cos(j * kPi / n), cos_end = std::cos((j + 1) * kPi / n);
+			sums[2 * j < n ? 0 : 1] += NumericalMieFit((float)(0.5 * (cos_begin + cos_end))) * 2.0 * kPi * (cos_begin - cos_end);
+		}
+		return std::make_pair((float)sums[0], (float)sums[1]);
+	}();
+	forward = s_hemispheres.first;
+	backward = s_hemispheres.second;
+}
+
+float CloudMiePhase::GetFitIntegral()
+{
+	float forward, backward;
+	GetFitHemispheres(forward, backward);
+	return forward + backward;
+}
+
+float CloudMiePhase::Evaluate(float cosTheta, uint32_t channel) const
+{
+	// linear between bin centres like the shader's sampler, clamped at both ends
+	const uint32_t n = m_desc.numAngles;
+	float angle = std::acos(std::min(std::max(cosTheta, -1.0f), 1.0f)) / (float)kPi;
+	float f = std::min(std::max(angle * n - 0.5f, 0.0f), n - 1.0f);
+	uint32_t j = std::min((uint32_t)f, n - 2);
+	float t = f - j;
+	float a = (&m_table[j].x)[channel], b = (&m_table[j + 1].x)[channel];
+	return a + (b - a) * t;
+}
+
+float CloudMiePhase::SampleCosTheta(float u, uint32_t channel) const
+{
+	const uint32_t n = m_desc.numAngles;
+	const XMFLOAT4* row = &m_table[2 * n];
+	float f = std::min(std::max(u * n - 0.5f, 0.0f), n - 1.0f);
+	uint32_t i = std::min((uint32_t)f, n - 2);
+	float t = f - i;
+	float a = (&row[i].x)[channel], b = (&row[i + 1].x)[channel];
+	return std::cos((a + (b - a) * t) * (float)kPi);
+}
\ No newline at end of file
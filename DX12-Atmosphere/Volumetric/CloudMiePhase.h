@@ -0,0 +1,94 @@
+#pragma once
+#include "stdafx.h"
+
+// Phase function of a cloud's water droplets from Lorenz-Mie theory, in place of
+// numericalMieFit, which fits a single droplet size. The radii follow Hansen's gamma
+// distribution given by its effective radius and variance, and every radius with a
+// noticeable share of the scattering is solved at three wavelengths. The result is a
+// numAngles x 3 table of float4, r g b per wavelength and their mean in a:
+//   row 0  the phase over the scattering angle, bin j covers [j, j + 1] * pi / numAngles
+//          and holds the solid angle average of the phase over it, so the peaks stay
+//          finite and the table integrates to 1 over the sphere like the solver
+//   row 1  the CDF over the angle at the end of each bin
+//   row 2  the inverse CDF, angle / pi at u = (i + 0.5) / numAngles, for importance sampling
+// The shader gets row 0 at the scale of numericalMieFit, see GetShaderTable.
+class CloudMiePhase
+{
+public:
+	struct Desc
+	{
+		// micrometres
+		float effectiveRadius;
+		float effectiveVariance;
+		// micrometres, and the real refractive index of water at each
+		float wavelengths[3];
+		float refractiveIndex[3];
+		uint32_t numRadii;
+		uint32_t numAngles;
+		// phase evaluations averaged per bin
+		uint32_t angleSubsamples;
+	};
+
+	struct Report
+	{
+		double solveMilliseconds;
+		uint32_t numThreads;
+		// droplet sizes solved, and Mie series terms times angles summed, per second
+		double sizesPerSecond;
+		double termsPerSecond;
+		// largest size parameter, the shortest wavelength on the largest radius
+		float maxSizeParameter;
+		// asymmetry parameter of the table and of importance samples through the inverse CDF
+		float g[3];
+		float sampledG[3];
+		// integral of row 0 over the sphere
+		float normalization[3];
+		// linear interpolation of row 0 against the solver at the bin edges
+		float maxRelativeError;
+		float rmsRelativeError;
+		// the mean phase over the forward hemisphere over the backward one, of row 0 and of numericalMieFit
+		float forwardBackRatio;
+		float fitForwardBackRatio;
+	};
+
+	static Desc DefaultDesc();
+
+	CloudMiePhase();
+
+	// Solves the distribution and bakes the table, seconds for a large effective radius
+	void Bake(const Desc& desc);
+
+	// Phase at the cosine of the scattering angle from row 0, channel 3 is the mean
+	float Evaluate(float cosTheta, uint32_t channel) const;
+	// Cosine of a scattering angle distributed like the phase, from row 2
+	float SampleCosTheta(float u, uint32_t channel) const;
+
+	bool IsValid() const { return !m_table.empty(); }
+	const Desc& GetDesc() const { return m_desc; }
+	const Report& GetReport() const { return m_report; }
+	// numAngles x 3
+	const std::vector<XMFLOAT4>& GetTable() const { return m_table; }
+	// The table MiePhaseLut of the shader reads: row 0 times GetFitIntegral, so the LUT has the
+	// scale of numericalMieFit that the max(phase, 1) of RaymarchCloud and the lighting were tuned for
+	std::vector<XMFLOAT4> GetShaderTable() const;
+
+	// numericalMieFit of VolumetricCloudCommon.hlsli, a fit of a single droplet size
+	static float NumericalMieFit(float cosTheta);
+	// MiePhase of VolumetricCloudCommon.hlsli: the mean of the shader table with a baked table,
+	// numericalMieFit with nullptr
+	static float MiePhase(const CloudMiePhase* table, float cosTheta);
+	// NumericalMieFit over the sphere, about 4.6, and over the forward and the backward hemisphere
+	static float GetFitIntegral();
+	static void GetFitHemispheres(float& forward, float& backward);
+
+	// Lorenz-Mie series of one sphere with size parameter x and real refractive index m.
+	// Writes (|S1|^2 + |S2|^2) / 2 per cosine and returns pi x^2 Qsca, both in units of
+	// 1 / k^2, so their ratio is the phase normalized over the sphere. Adds the terms
+	// times cosines summed to numTerms.
+	static double Solve(double x, double m, const double* cosines, size_t numCosines, double* intensity, uint64_t& numTerms);
+
+private:
+	Desc m_desc;
+	Report m_report;
+	std::vector<XMFLOAT4> m_table;
+};
\ No newline at end of file
@@ -0,0 +1,51 @@
+#include "stdafx.h"
+#include "CloudMiePhaseBenchmark.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+static const double kPi = 3.14159265358979323846;
+
+CloudMiePhaseBenchmark::Desc CloudMiePhaseBenchmark::DefaultDesc()
+{
+	Desc desc;
+	desc.mie = CloudMiePhase::DefaultDesc();
+	desc.maxNormalizationError = 0.02f;
+	// about 26 for the default droplets against 12 of the fit
+	desc.maxRatioFactor = 4.0f;
+	return desc;
+}
+
+CloudMiePhaseBenchmark::Result CloudMiePhaseBenchmark::Run(const Desc& desc)
+{
+	Result result = {};
+	CloudMiePhase phase;
+	phase.Bake(desc.mie);
+	result.report = phase.GetReport();
+
+	for (uint32_t c = 0; c < 3; ++c)
+		result.violations.Add("normalization", std::abs(result.report.normalization[c] - 1.0f) > desc.maxNormalizationError);
+
+	// solid angle of every bin of row 0
+	const uint32_t n = desc.mie.numAngles;
+	const std::vector<XMFLOAT4> table = phase.GetShaderTable();
+	double integral = 0.0;
+	for (uint32_t j = 0; j < n; ++j)
+		integral += table[j].w * 2.0 * kPi * (std::cos(j * kPi / n) - std::cos((j + 1) * kPi / n));
+	result.shaderIntegral = (float)integral;
+	result.fitIntegral = CloudMiePhase::GetFitIntegral();
+	result.violations.Add("fit scale", std::abs(result.shaderIntegral / result.fitIntegral - 1.0f) > desc.maxNormalizationError);
+
+	float factor = result.report.forwardBackRatio / result.report.fitForwardBackRatio;
+	result.violations.Add("forward back ratio", !(factor <= desc.maxRatioFactor && factor >= 1.0f / desc.maxRatioFactor));
+	return result;
+}
+
+std::string CloudMiePhaseBenchmark::Summarize(const Result& result)
+{
+	char line[256];
+	snprintf(line, sizeof(line), "%.0f ms, g %.3f, integral %.3f against the fit's %.3f, forward / back %.1f against %.1f",
+		result.report.solveMilliseconds, result.report.g[1], result.shaderIntegral, result.fitIntegral, result.report.forwardBackRatio,
+		result.report.fitForwardBackRatio);
+	return line;
+}
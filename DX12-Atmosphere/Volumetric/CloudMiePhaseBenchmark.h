@@ -0,0 +1,36 @@
+#pragma once
+#include "Utils/SelfTest.h"
+#include "CloudMiePhase.h"
+#include <cstdint>
+#include <string>
+
+// CloudMiePhase baked for a droplet distribution, and the table the shader gets held
+// against numericalMieFit it replaces:
+// - row 0 of every wavelength integrates to 1 over the sphere within maxNormalizationError
+// - GetShaderTable integrates to GetFitIntegral within maxNormalizationError, so
+//   max(MiePhase, 1) in RaymarchCloud clamps the same share of the angles with either
+// - the forward over backward hemisphere ratio is within a factor maxRatioFactor of the fit's
+class CloudMiePhaseBenchmark
+{
+public:
+	struct Desc
+	{
+		CloudMiePhase::Desc mie;
+		float maxNormalizationError;
+		float maxRatioFactor;
+	};
+
+	struct Result
+	{
+		CloudMiePhase::Report report;
+		// of the mean phase in GetShaderTable, and of numericalMieFit
+		float shaderIntegral;
+		float fitIntegral;
+		// "normalization", "fit scale" and "forward back ratio", by the checks above
+		SelfTest::Violations violations;
+	};
+
+	static Desc DefaultDesc();
+	static Result Run(const Desc& desc);
+	static std::string Summarize(const Result& result);
+};
@@ -0,0 +1,127 @@
+#pragma once
+#include "stdafx.h"
+
+// CPU side of the constant buffers in VolumetricCloudCommon.hlsli, used by the GPU passes
+// and by CloudReferenceRenderer. Keep the layouts in sync with the shader.
+
+// PassCB (b0)
+struct CloudPassCB
+{
+	Matrix4 invView;
+	Matrix4 invProj;
+	Matrix4 prevViewProj;
+	XMFLOAT3 cameraPosition;
+	float time = 0.0f;
+	XMFLOAT3 lightDir;
+	uint32_t frameIndex = 0;
+	XMFLOAT4 resolution;
+	XMFLOAT3 groundAlbedo;
+	float exposure = 1.0f;
+	XMFLOAT3 whitePoint;
+	float sunSize = 0.999853f;
+};
+
+// CloudParameterCB (b2)
+struct CloudParameterCB
+{
+	float lightColor[3] = { 1.0f, 0.99995f, 0.90193f };
+	int sampleCountMin = 64;
+	int sampleCountMax = 128;
+	float cloudCoverage = 1.0f;
+	float Exposure = 1.0;
+	float GroundAlbedo = 1.0;
+	float cloudBottomColor[3] = {0.38235f, 0.41176f, 0.47059f};
+	float crispiness = 43.238f;
+	float curliness = 0.1f;
+	float earthRadius = 6360.0f;
+	float cloudBottomRadius = 5000.0f;
+	float cloudTopRadius = 17000.0f;
+	float cloudSpeed = 0.0f;
+	float densityFactor = 0.003f;
+	float absorption = 0.0037f;
+	float hg0 = -0.08f;
+	float hg1 = 0.08f;
+	int enablePowder = 1;
+	int enableBeer = 1;
+	float rainAbsorption = 1.0f;
+	float eccentricity = 0.6f;
+	float sliverIntensity = 1.0f;
+	float sliverSpread = 0.3f;
+	float brightness = 1.0f;
+	float cloudScattering[3] = { 1.0f , 0.878f, 0.745f};
+	float cloudScatteringWeight = 2.193f;
+	float ABC[3] = { 0.5f, 0.5f, 0.5f };
+	float HGWeight = 0.5;
+	int useBlueNoise = 1;
+	// temporal update window, see CloudUpdateScheduler
+	uint32_t scheduleSize = 4;
+	uint32_t scheduleWindowStart = 0;
+	uint32_t scheduleWindowCount = 1;
+	// pixels of reprojection motion that force a raymarch, 0 disables
+	float forceUpdateMotion = 0.0f;
+	// reduced resolution path, 2 or 4, and the full res position of the low res ray inside its block
+	uint32_t downscale = 4;
+	float lowResJitter[2] = { 2.0f, 2.0f };
+	// relative guide depth tolerance of the bilateral upsample, <= 0 is bilinear
+	float upsampleDepthSigma = 0.05f;
+	float upsampleHistoryWeight = 0.8f;
+	// adaptive raymarch: coarse steps of coarseStepScale * ds through empty space, fine steps
+	// from the first hit until fineZeroSamples empty samples in a row
+	int adaptiveMarch = 0;
+	float coarseStepScale = 4.0f;
+	// mip bias ramps up from lodNearDistance to lodFarDistance, no erosion beyond
+	float lodNearDistance = 30000.0f;
+	float lodFarDistance = 100000.0f;
+	float lodMipBias = 2.0f;
+	// the march stops once the transmittance falls below
+	float minTransmittance = 0.1f;
+	int fineZeroSamples = 6;
+	// CloudShadowMap: strength on the sun light of the ground, aerial on its in-scattering
+	int enableCloudShadow = 0;
+	float cloudShadowStrength = 1.0f;
+	float cloudShadowAerial = 0.5f;
+	// world xz of texel (0, 0) and the side length of the map, on the bottom of the layer
+	float cloudShadowOrigin[2] = { 0.0f, 0.0f };
+	float cloudShadowExtent = 1.0f;
+	// CloudVirtualWeather: weather from the atlas through the indirection table instead of the repeating map
+	int virtualWeather = 0;
+	// world xz where tile (0, 0) starts and the tiles in x and z
+	float virtualWeatherOrigin[2] = { 0.0f, 0.0f };
+	uint32_t virtualWeatherTiles[2] = { 1, 1 };
+	float virtualWeatherTileSize = 1.0f;
+	// texels per atlas slot side including the border, and 1 / atlas size
+	float virtualWeatherTileTexels = 3.0f;
+	float virtualWeatherAtlasTexelSize = 1.0f;
+	// CloudHeightLut instead of GetHeightDensityForCloud, at cloudType or the green of the weather
+	int heightLut = 1;
+	float cloudType = 1.0f;
+	int cloudTypeFromWeather = 0;
+	// (size - 1) / size and 0.5 / size of the table in type and height, its uv is one mad
+	float heightLutScale[2] = { 1.0f, 1.0f };
+	float heightLutBias[2] = { 0.0f, 0.0f };
+	// CloudMiePhase instead of numericalMieFit, the bin of an angle is angle * mieLutScale + mieLutBias
+	int mieLut = 0;
+	float mieLutScale = 1.0f;
+	float mieLutBias = 0.0f;
+	// 0 the ABC terms of IntegrateCloudStep, 1 multiple scattering octaves: octave i sees
+	// msAttenuation^i of the optical depth to the sun, carries msContribution^i of the light
+	// and a phase msEccentricity^i of the way from isotropic to MiePhase. CloudPathTracer
+	// fits the three against a path traced image, msSunScale is exposure and not part of it.
+	int lightingModel = 0;
+	int msOctaves = 3;
+	float msAttenuation = 0.25f;
+	float msContribution = 0.5f;
+	float msEccentricity = 0.5f;
+	float msSunScale = 8.0f;
+	float msAmbient = 1.0f;
+	// normalizes MiePhase over the sphere, see CloudPathTracer::GetPhaseScale
+	float msPhaseScale = 0.218f;
+	int cubeFace = 0;
+	uint32_t cubeTileOrigin[2] = { 0, 0 };
+	// CloudShadowVolume instead of the cone march in RaymarchLight, as CloudReferenceRenderer::LightMode:
+	// 1 the stretch the cone covers, 2 up to the top of the layer. Texel uvw is (pos - origin) * invSize.
+	int shadowVolume = 0;
+	float shadowVolumeOrigin[3] = { 0.0f, 0.0f, 0.0f };
+	float shadowVolumeInvSize[3] = { 1.0f, 1.0f, 1.0f };
+	float shadowVolumeTop = 0.0f;
+};
\ No newline at end of file
@@ -0,0 +1,587 @@
+#include "stdafx.h"
+#include "CloudPathTracer.h"
+#include "CloudDensityQuery.h"
+#include "CloudMiePhase.h"
+#include <algorithm>
+#include <chrono>
+
+// VolumetricCloudCommon.hlsli
+static const float kIsotropicPhase = 0.079577471f;
+static const float kNoiseKernel[6][3] =
+{
+	{ 0.38051305f,  0.92453449f, -0.02111345f },
+	{ -0.50625799f, -0.03590792f, -0.86163418f },
+	{ -0.32509218f, -0.94557439f,  0.01428793f },
+	{ 0.09026238f, -0.27376545f,  0.95755165f },
+	{ 0.28128598f,  0.42443639f, -0.86065785f },
+	{ -0.16852403f,  0.14748697f,  0.97460106f }
+};
+
+// bins of the scattering angle, fine enough for the forward peak of numericalMieFit
+static const uint32_t kPhaseBins = 4096;
+// a path running along the layer is cut here
+static const float kMaxDistance = 200000.0f;
+
+static bool RaySphereIntersection(Vector3 ro, Vector3 rd, Vector3 center, float radius, Vector3& startPos)
+{
+	Vector3 L = ro - center;
+	float a = Dot(rd, rd);
+	float b = 2.0f * Dot(rd, L);
+	float c = Dot(L, L) - radius * radius;
+	float discr = b * b - 4.0f * a * c;
+	if (discr < 0.0f)
+		return false;
+	float t = std::max(0.0f, (-b + std::sqrt(discr)) / 2.0f);
+	if (t == 0.0f)
+		return false;
+	startPos = ro + rd * t;
+	return true;
+}
+
+// count jobs handed out one at a time to numThreads threads, the calling thread is one of them
+template <class Job>
+static void RunParallel(uint32_t numThreads, uint32_t count, Job&& job)
+{
+	std::atomic<uint32_t> next(0);
+	auto worker = [&]()
+	{
+		for (uint32_t i = next++; i < count; i = next++)
+			job(i);
+	};
+	std::vector<std::thread> threads;
+	for (uint32_t i = 1; i < numThreads; ++i)
+		threads.emplace_back(worker);
+	worker();
+	for (auto& t : threads)
+		t.join();
+}
+
+CloudPathTracer::Settings CloudPathTracer::DefaultSettings()
+{
+	Settings settings;
+	settings.width = 64;
+	settings.height = 36;
+	settings.samplesPerPixel = 16;
+	settings.maxBounces = 1024;
+	settings.numThreads = std::max(1u, std::thread::hardware_concurrency());
+	settings.albedo = 1.0f;
+	settings.maxDensity = 0.0f;
+	settings.seed = 1;
+	return settings;
+}
+
+CloudPathTracer::SweepRange CloudPathTracer::DefaultSweepRange()
+{
+	SweepRange range;
+	range.minOctaves = 1;
+	range.maxOctaves = 4;
+	range.attenuation[0] = 0.05f;
+	range.attenuation[1] = 0.95f;
+	range.contribution[0] = 0.05f;
+	range.contribution[1] = 0.95f;
+	range.eccentricity[0] = 0.0f;
+	range.eccentricity[1] = 1.0f;
+	range.steps = 10;
+	return range;
+}
+
+CloudPathTracer::Octaves CloudPathTracer::GetOctaves(const CloudParameterCB& cloudCB)
+{
+	return { (uint32_t)std::max(cloudCB.msOctaves, 1), cloudCB.msAttenuation, cloudCB.msContribution, cloudCB.msEccentricity };
+}
+
+float CloudPathTracer::GetPhaseScale()
+{
+	// numericalMieFit integrates to about 4.6 over the sphere, the LUT is baked at its scale
+	return 1.0f / CloudMiePhase::GetFitIntegral();
+}
+
+float CloudPathTracer::EvaluateOctaves(const Octaves& octaves, float phase, float lightOpticalDepth)
+{
+	float a = 1.0f, b = 1.0f, c = 1.0f;
+	float energy = 0.0f;
+	for (uint32_t i = 0; i < octaves.count; ++i)
+	{
+		energy += b * (kIsotropicPhase + (phase - kIsotropicPhase) * c) * std::exp(-lightOpticalDepth * a);
+		a *= octaves.attenuation;
+		b *= octaves.contribution;
+		c *= octaves.eccentricity;
+	}
+	return energy;
+}
+
+CloudPathTracer::CloudPathTracer()
+	: m_query(nullptr),
+	m_phase(nullptr),
+	m_settings(DefaultSettings()),
+	m_width(0),
+	m_height(0),
+	m_pass(0),
+	m_phaseIntegral(1.0f),
+	m_maxDensity(1.0f),
+	m_sigmaMax(1.0f),
+	m_layerBottom(0.0f),
+	m_layerTop(1.0f),
+	m_lightDir{ 0.0f, 1.0f, 0.0f },
+	m_majorantViolations(0)
+{
+	ZeroMemory(&m_report, sizeof(Report));
+}
+
+void CloudPathTracer::BuildPhaseTable()
+{
+	const CloudParameterCB& cloud = m_query->GetParameters();
+	const CloudMiePhase* table = cloud.mieLut != 0 ? m_phase : nullptr;
+	m_phaseTable.resize(kPhaseBins);
+	m_phaseCdf.resize(kPhaseBins);
+	double integral = 0.0;
+	for (uint32_t j = 0; j < kPhaseBins; ++j)
+	{
+		// solid angle average over the bin from four cosines
+		double cos_begin = std::cos(j * XM_PI / kPhaseBins);
+		double cos_end = std::cos((j + 1) * XM_PI / kPhaseBins);
+		float phase = 0.0f;
+		for (uint32_t s = 0; s < 4; ++s)
+		{
+			float cos_theta = (float)(cos_begin + (cos_end - cos_begin) * (s + 0.5) / 4.0);
+			phase += 0.25f * CloudMiePhase::MiePhase(table, cos_theta);
+		}
+		m_phaseTable[j] = phase;
+		integral += phase * XM_2PI * (cos_begin - cos_end);
+		m_phaseCdf[j] = (float)integral;
+	}
+	// energy conserving like MiePhase * MsPhaseScale of the shader
+	m_phaseIntegral = (float)integral;
+	for (uint32_t j = 0; j < kPhaseBins; ++j)
+	{
+		m_phaseTable[j] /= m_phaseIntegral;
+		m_phaseCdf[j] /= m_phaseIntegral;
+	}
+	m_phaseCdf.back() = 1.0f;
+}
+
+float CloudPathTracer::EvaluatePhase(float cosTheta) const
+{
+	float theta = std::acos(std::min(std::max(cosTheta, -1.0f), 1.0f));
+	return m_phaseTable[std::min((uint32_t)(theta * (kPhaseBins / XM_PI)), kPhaseBins - 1)];
+}
+
+void CloudPathTracer::SamplePhase(const float dir[3], float u0, float u1, float out[3]) const
+{
+	// the bin by the CDF, then uniform over its solid angle, so the pdf is the table over its integral
+	uint32_t j = (uint32_t)(std::upper_bound(m_phaseCdf.begin(), m_phaseCdf.end(), u0) - m_phaseCdf.begin());
+	j = std::min(j, kPhaseBins - 1);
+	float cdf_begin = j > 0 ? m_phaseCdf[j - 1] : 0.0f;
+	float f = (u0 - cdf_begin) / std::max(m_phaseCdf[j] - cdf_begin, 1e-12f);
+	float cos_begin = std::cos(j * XM_PI / kPhaseBins);
+	float cos_end = std::cos((j + 1) * XM_PI / kPhaseBins);
+	float cos_theta = cos_begin + (cos_end - cos_begin) * std::min(std::max(f, 0.0f), 1.0f);
+	float sin_theta = std::sqrt(std::max(1.0f - cos_theta * cos_theta, 0.0f));
+	float phi = XM_2PI * u1;
+
+	// frame around dir, Duff et al. "Building an Orthonormal Basis, Revisited"
+	float sign = std::copysign(1.0f, dir[2]);
+	float a = -1.0f / (sign + dir[2]);
+	float b = dir[0] * dir[1] * a;
+	float t[3] = { 1.0f + sign * dir[0] * dir[0] * a, sign * b, -sign * dir[0] };
+	float s[3] = { b, sign + dir[1] * dir[1] * a, -dir[1] };
+	float x = sin_theta * std::cos(phi), y = sin_theta * std::sin(phi);
+	for (uint32_t i = 0; i < 3; ++i)
+		out[i] = t[i] * x + s[i] * y + dir[i] * cos_theta;
+}
+
+float CloudPathTracer::GetLayerDistance(const float p[3], const float dir[3]) const
+{
+	// SampleCloudDensity only looks at y, the layer is a slab
+	float t = kMaxDistance;
+	if (dir[1] > 1e-6f)
+		t = (m_layerTop - p[1]) / dir[1];
+	else if (dir[1] < -1e-6f)
+		t = (m_layerBottom - p[1]) / dir[1];
+	return std::min(std::max(t, 0.0f), kMaxDistance);
+}
+
+float CloudPathTracer::ScanMaxDensity(const CloudPassCB& passCB) const
+{
+	const uint32_t n = 48, layers = 16;
+	const float half_extent = 50000.0f;
+	float max_density = 0.0f;
+	for (uint32_t k = 0; k < layers; ++k)
+	{
+		float y = m_layerBottom + (m_layerTop - m_layerBottom) * (k + 0.5f) / layers;
+		for (uint32_t j = 0; j < n; ++j)
+		{
+			for (uint32_t i = 0; i < n; ++i)
+			{
+				XMFLOAT3 p(passCB.cameraPosition.x + half_extent * ((i + 0.5f) / n * 2.0f - 1.0f), y,
+					passCB.cameraPosition.z + half_extent * ((j + 0.5f) / n * 2.0f - 1.0f));
+				max_density = std::max(max_density, m_query->SampleDensity(p));
+			}
+		}
+	}
+	// the grid misses peaks between its points, violations are counted
+	return max_density > 0.0f ? max_density * 1.5f : 1.0f;
+}
+
+bool CloudPathTracer::GetProbeRay(const CloudPassCB& passCB, uint32_t x, uint32_t y, Ray& ray) const
+{
+	// ComputeWorldViewDir and the sphere intersections of RaymarchCloud
+	const CloudParameterCB& cloud = m_query->GetParameters();
+	float sx = (x + 0.5f) / m_width;
+	float sy = (y + 0.5f) / m_height;
+	Vector4 view_coord = passCB.invProj * Vector4(sx * 2.0f - 1.0f, 1.0f - sy * 2.0f, 1.0f, 1.0f);
+	view_coord = view_coord / view_coord.GetW();
+	Vector3 world_dir = Normalize(Vector3(passCB.invView * Vector4(Vector3(view_coord), 0.0f)));
+
+	Vector3 camera(passCB.cameraPosition);
+	Vector3 center(passCB.cameraPosition.x, -cloud.earthRadius * 100.0f, passCB.cameraPosition.z);
+	Vector3 start_pos = camera, end_pos = camera, ground_pos;
+	if (RaySphereIntersection(camera, world_dir, center, cloud.earthRadius, ground_pos))
+		return false;
+	RaySphereIntersection(camera, world_dir, center, cloud.earthRadius * 100.0f + cloud.cloudBottomRadius, start_pos);
+	RaySphereIntersection(camera, world_dir, center, cloud.earthRadius * 100.0f + cloud.cloudTopRadius, end_pos);
+
+	Vector3 path = end_pos - start_pos;
+	ray.length = Length(path);
+	if (ray.length <= 0.0f)
+		return false;
+	Vector3 dir = path / ray.length;
+	ray.start[0] = start_pos.GetX();
+	ray.start[1] = start_pos.GetY();
+	ray.start[2] = start_pos.GetZ();
+	ray.dir[0] = dir.GetX();
+	ray.dir[1] = dir.GetY();
+	ray.dir[2] = dir.GetZ();
+	return true;
+}
+
+float CloudPathTracer::LightDepth(const float p[3], float ds, uint32_t mipLevel) const
+{
+	// RaymarchLight
+	const CloudParameterCB& cloud = m_query->GetParameters();
+	float start_pos[3] = { p[0], p[1], p[2] };
+	float cone_radius = 1.0f;
+	float density = 0.0f;
+	for (uint32_t i = 0; i < 6; ++i)
+	{
+		XMFLOAT3 pos(start_pos[0] + kNoiseKernel[i][0] * cone_radius * i, start_pos[1] + kNoiseKernel[i][1] * cone_radius * i,
+			start_pos[2] + kNoiseKernel[i][2] * cone_radius * i);
+		if (pos.y >= m_layerBottom)
+			density += m_query->SampleDensity(pos, density > 0.3f, mipLevel + i / 2);
+		for (uint32_t k = 0; k < 3; ++k)
+			start_pos[k] += m_lightDir[k] * ds;
+		cone_radius += 1.0f / 6.0f;
+	}
+	return density * ds * cloud.absorption;
+}
+
+bool CloudPathTracer::SampleCollision(const float p[3], const float dir[3], float maxDistance, RandomNumberGenerator& rng, uint64_t& densitySamples, float& t) const
+{
+	// delta tracking, tentative collisions at the majorant are real with density / maxDensity
+	t = 0.0f;
+	for (;;)
+	{
+		t -= std::log(1.0f - rng.NextFloat()) / m_sigmaMax;
+		if (t >= maxDistance)
+			return false;
+		densitySamples++;
+		float density = m_query->SampleDensity(XMFLOAT3(p[0] + dir[0] * t, p[1] + dir[1] * t, p[2] + dir[2] * t));
+		if (density > m_maxDensity)
+			m_majorantViolations++;
+		if (rng.NextFloat() * m_maxDensity < density)
+			return true;
+	}
+}
+
+float CloudPathTracer::Transmittance(const float p[3], const float dir[3], float maxDistance, RandomNumberGenerator& rng, uint64_t& densitySamples) const
+{
+	// ratio tracking, Russian roulette once little is left
+	float T = 1.0f;
+	float t = 0.0f;
+	for (;;)
+	{
+		t -= std::log(1.0f - rng.NextFloat()) / m_sigmaMax;
+		if (t >= maxDistance)
+			return T;
+		densitySamples++;
+		float density = m_query->SampleDensity(XMFLOAT3(p[0] + dir[0] * t, p[1] + dir[1] * t, p[2] + dir[2] * t));
+		if (density > m_maxDensity)
+			m_majorantViolations++;
+		T *= 1.0f - std::min(density / m_maxDensity, 1.0f);
+		if (T < 0.1f)
+		{
+			if (rng.NextFloat() >= T)
+				return 0.0f;
+			T = 1.0f;
+		}
+	}
+}
+
+float CloudPathTracer::TracePath(const Ray& ray, RandomNumberGenerator& rng, uint64_t& densitySamples, uint32_t& events) const
+{
+	float p[3] = { ray.start[0], ray.start[1], ray.start[2] };
+	float dir[3] = { ray.dir[0], ray.dir[1], ray.dir[2] };
+	float max_distance = ray.length;
+	float radiance = 0.0f;
+	float throughput = 1.0f;
+	for (events = 0; events < m_settings.maxBounces; ++events)
+	{
+		float t;
+		if (!SampleCollision(p, dir, max_distance, rng, densitySamples, t))
+			return radiance;
+		for (uint32_t k = 0; k < 3; ++k)
+			p[k] += dir[k] * t;
+		throughput *= m_settings.albedo;
+
+		// next event toward the sun, the ground hides it below the horizon
+		if (m_lightDir[1] > 0.0f)
+		{
+			float cos_theta = dir[0] * m_lightDir[0] + dir[1] * m_lightDir[1] + dir[2] * m_lightDir[2];
+			radiance += throughput * EvaluatePhase(cos_theta) * Transmittance(p, m_lightDir, GetLayerDistance(p, m_lightDir), rng, densitySamples);
+		}
+
+		// the phase is the pdf, the throughput stays
+		float u0 = rng.NextFloat(), u1 = rng.NextFloat();
+		float scattered[3];
+		SamplePhase(dir, u0, u1, scattered);
+		float inv_length = 1.0f / std::sqrt(scattered[0] * scattered[0] + scattered[1] * scattered[1] + scattered[2] * scattered[2]);
+		for (uint32_t k = 0; k < 3; ++k)
+			dir[k] = scattered[k] * inv_length;
+		max_distance = GetLayerDistance(p, dir);
+	}
+	return radiance;
+}
+
+void CloudPathTracer::PrepareShaderSteps()
+{
+	// RaymarchCloud without jitter, the samples sit in the middle of their steps
+	const CloudParameterCB& cloud = m_query->GetParameters();
+	uint32_t count = m_width * m_height;
+	std::vector<std::vector<Step>> pixel_steps(count);
+	m_viewPhase.assign(count, 0.0f);
+	RunParallel(m_settings.numThreads, m_height, [&](uint32_t y)
+	{
+		for (uint32_t x = 0; x < m_width; ++x)
+		{
+			uint32_t i = y * m_width + x;
+			const Ray& ray = m_rays[i];
+			if (ray.length <= 0.0f)
+				continue;
+			int n_steps = std::max((int)(cloud.sampleCountMin + (cloud.sampleCountMax - cloud.sampleCountMin) * ray.dir[1]), 1);
+			float ds = ray.length / n_steps;
+			float sigma_ds = ds * cloud.densityFactor;
+			m_viewPhase[i] = EvaluatePhase(ray.dir[0] * m_lightDir[0] + ray.dir[1] * m_lightDir[1] + ray.dir[2] * m_lightDir[2]);
+
+			float T = 1.0f;
+			for (int s = 0; s < n_steps; ++s)
+			{
+				float t = ds * (s + 0.5f);
+				float pos[3] = { ray.start[0] + ray.dir[0] * t, ray.start[1] + ray.dir[1] * t, ray.start[2] + ray.dir[2] * t };
+				uint32_t mip_level = (uint32_t)(s * 0.0625f);
+				float density = m_query->SampleDensity(XMFLOAT3(pos[0], pos[1], pos[2]), true, mip_level);
+				if (density > 0.0f)
+				{
+					float d_trans = std::exp(-density * sigma_ds);
+					pixel_steps[i].push_back({ T * (1.0f - d_trans), LightDepth(pos, ds * 0.6f, mip_level) });
+					T *= d_trans;
+				}
+				if (T < cloud.minTransmittance)
+					break;
+			}
+		}
+	});
+
+	m_steps.clear();
+	m_stepOffsets.resize(count + 1);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		m_stepOffsets[i] = (uint32_t)m_steps.size();
+		m_steps.insert(m_steps.end(), pixel_steps[i].begin(), pixel_steps[i].end());
+	}
+	m_stepOffsets[count] = (uint32_t)m_steps.size();
+}
+
+void CloudPathTracer::Trace(const CloudPassCB& passCB, const Settings& settings, bool restart)
+{
+	assert(m_query != nullptr && m_query->IsValid());
+	const CloudParameterCB& cloud = m_query->GetParameters();
+	uint32_t count = settings.width * settings.height;
+	if (restart || settings.width != m_width || settings.height != m_height || m_sum.empty())
+	{
+		m_settings = settings;
+		m_width = settings.width;
+		m_height = settings.height;
+		m_pass = 0;
+		// INNER_RADIUS and OUTER_RADIUS above the earth centre at -EarthRadius * 100
+		m_layerBottom = cloud.cloudBottomRadius;
+		m_layerTop = cloud.cloudTopRadius;
+		Vector3 light_dir = Normalize(Vector3(passCB.lightDir));
+		m_lightDir[0] = light_dir.GetX();
+		m_lightDir[1] = light_dir.GetY();
+		m_lightDir[2] = light_dir.GetZ();
+		BuildPhaseTable();
+		m_maxDensity = settings.maxDensity > 0.0f ? settings.maxDensity : ScanMaxDensity(passCB);
+		m_sigmaMax = m_maxDensity * std::max(cloud.densityFactor, 1e-9f);
+		m_majorantViolations = 0;
+		m_sum.assign(count, 0.0);
+		m_sumSquared.assign(count, 0.0);
+		m_rays.resize(count);
+		for (uint32_t y = 0; y < m_height; ++y)
+		{
+			for (uint32_t x = 0; x < m_width; ++x)
+			{
+				Ray& ray = m_rays[y * m_width + x];
+				if (!GetProbeRay(passCB, x, y, ray))
+					ray.length = 0.0f;
+			}
+		}
+		PrepareShaderSteps();
+		ZeroMemory(&m_report, sizeof(Report));
+	}
+	m_settings.samplesPerPixel = std::max(settings.samplesPerPixel, 1u);
+	m_settings.numThreads = std::max(settings.numThreads, 1u);
+
+	auto start = std::chrono::high_resolution_clock::now();
+	std::atomic<uint64_t> total_samples(0), total_events(0), total_truncated(0), total_paths(0);
+	RunParallel(m_settings.numThreads, m_height, [&](uint32_t y)
+	{
+		uint64_t density_samples = 0, events = 0, truncated = 0, paths = 0;
+		for (uint32_t x = 0; x < m_width; ++x)
+		{
+			uint32_t i = y * m_width + x;
+			if (m_rays[i].length <= 0.0f)
+				continue;
+			// a stream per pixel and a seed per pass, the image does not depend on the thread count
+			RandomNumberGenerator rng(((uint64_t)m_pass << 32) | m_settings.seed, i);
+			for (uint32_t s = 0; s < m_settings.samplesPerPixel; ++s)
+			{
+				uint32_t path_events;
+				float radiance = TracePath(m_rays[i], rng, density_samples, path_events);
+				m_sum[i] += radiance;
+				m_sumSquared[i] += (double)radiance * radiance;
+				events += path_events;
+				truncated += path_events >= m_settings.maxBounces ? 1 : 0;
+				paths++;
+			}
+		}
+		total_samples += density_samples;
+		total_events += events;
+		total_truncated += truncated;
+		total_paths += paths;
+	});
+	auto end = std::chrono::high_resolution_clock::now();
+	m_pass++;
+
+	m_report.width = m_width;
+	m_report.height = m_height;
+	m_report.numThreads = m_settings.numThreads;
+	m_report.samplesPerPixel += m_settings.samplesPerPixel;
+	m_report.paths += total_paths;
+	m_report.seconds = std::max(std::chrono::duration<double>(end - start).count(), 1e-9);
+	m_report.pathsPerSecond = total_paths / m_report.seconds;
+	m_report.samplesPerSecond = total_samples / m_report.seconds;
+	m_report.scatteringEventsPerPath = (double)total_events / std::max<uint64_t>(total_paths, 1);
+	m_report.truncatedPaths += total_truncated;
+	m_report.majorant = m_maxDensity;
+	m_report.majorantViolations = m_majorantViolations;
+	m_report.phaseIntegral = m_phaseIntegral;
+
+	m_report.cloudPixels = 0;
+	double variance = 0.0, power = 0.0;
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		if (m_stepOffsets[i + 1] > m_stepOffsets[i])
+			m_report.cloudPixels++;
+		double mean = m_sum[i] / m_report.samplesPerPixel;
+		variance += std::max(m_sumSquared[i] / m_report.samplesPerPixel - mean * mean, 0.0) / m_report.samplesPerPixel;
+		power += mean * mean;
+	}
+	m_report.noise = power > 0.0 ? (float)std::sqrt(variance / power) : 0.0f;
+	m_report.octaveError = MeasureError(GetOctaves(cloud));
+	m_report.singleScatteringError = MeasureError({ 1, 1.0f, 1.0f, 1.0f });
+	m_report.legacyError = MeasureLegacyError();
+}
+
+template <class Model>
+float CloudPathTracer::MeasureModelError(Model&& model) const
+{
+	if (m_report.samplesPerPixel == 0)
+		return 0.0f;
+	double error = 0.0, power = 0.0;
+	for (uint32_t i = 0; i < m_width * m_height; ++i)
+	{
+		double mean = m_sum[i] / m_report.samplesPerPixel;
+		float estimate = 0.0f;
+		for (uint32_t s = m_stepOffsets[i]; s < m_stepOffsets[i + 1]; ++s)
+			estimate += model(m_viewPhase[i], m_steps[s]);
+		estimate *= m_settings.albedo;
+		error += (estimate - mean) * (estimate - mean);
+		power += mean * mean;
+	}
+	return power > 0.0 ? (float)std::sqrt(error / power) : 0.0f;
+}
+
+float CloudPathTracer::MeasureError(const Octaves& octaves) const
+{
+	return MeasureModelError([&octaves](float phase, const Step& step)
+	{
+		return step.weight * EvaluateOctaves(octaves, phase, step.lightDepth);
+	});
+}
+
+float CloudPathTracer::MeasureLegacyError() const
+{
+	return MeasureModelError([](float phase, const Step& step)
+	{
+		return step.weight * phase * std::max(std::exp(-step.lightDepth), 0.7f * std::exp(-step.lightDepth * 0.25f));
+	});
+}
+
+CloudPathTracer::SweepResult CloudPathTracer::Sweep(const SweepRange& range, uint32_t numThreads) const
+{
+	SweepResult result;
+	ZeroMemory(&result, sizeof(SweepResult));
+	uint32_t steps = std::max(range.steps, 1u);
+	uint32_t min_octaves = std::max(range.minOctaves, 1u);
+	uint32_t num_octaves = std::max(range.maxOctaves, min_octaves) - min_octaves + 1;
+	result.numCandidates = num_octaves * steps * steps * steps;
+
+	auto value = [steps](const float bounds[2], uint32_t k)
+	{
+		return steps > 1 ? bounds[0] + (bounds[1] - bounds[0]) * k / (steps - 1) : bounds[0];
+	};
+	auto candidate = [&](uint32_t index)
+	{
+		Octaves octaves;
+		octaves.eccentricity = value(range.eccentricity, index % steps);
+		index /= steps;
+		octaves.contribution = value(range.contribution, index % steps);
+		index /= steps;
+		octaves.attenuation = value(range.attenuation, index % steps);
+		octaves.count = min_octaves + index / steps;
+		return octaves;
+	};
+
+	auto start = std::chrono::high_resolution_clock::now();
+	std::vector<float> errors(result.numCandidates);
+	RunParallel(std::max(numThreads, 1u), result.numCandidates, [&](uint32_t i)
+	{
+		errors[i] = MeasureError(candidate(i));
+	});
+	auto end = std::chrono::high_resolution_clock::now();
+
+	uint32_t best = (uint32_t)(std::min_element(errors.begin(), errors.end()) - errors.begin());
+	result.best = candidate(best);
+	result.bestError = errors[best];
+	result.seconds = std::max(std::chrono::duration<double>(end - start).count(), 1e-9);
+	result.candidatesPerSecond = result.numCandidates / result.seconds;
+	return result;
+}
+
+std::vector<float> CloudPathTracer::GetImage() const
+{
+	std::vector<float> image(m_sum.size(), 0.0f);
+	for (size_t i = 0; i < image.size() && m_report.samplesPerPixel > 0; ++i)
+		image[i] = (float)(m_sum[i] / m_report.samplesPerPixel);
+	return image;
+}
\ No newline at end of file
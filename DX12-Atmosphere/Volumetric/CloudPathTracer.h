@@ -0,0 +1,189 @@
+#pragma once
+#include "stdafx.h"
+#include "CloudParameters.h"
+#include "Math/Random.h"
+#include <atomic>
+
+class CloudDensityQuery;
+class CloudMiePhase;
+
+// Ground truth for the octave multiple scattering of IntegrateCloudStep (LightingModel 1).
+// A Monte-Carlo path tracer over the density field of a CloudDensityQuery: delta tracking
+// with the extinction DensityFactor * density, the sun a directional light of unit
+// irradiance reached by next event estimation and ratio tracking, and the phase sampled
+// from a table of MiePhase. Paths that leave the layer are lost, there is no ground bounce
+// and the radiance is a single channel, the mean of the phase.
+// Traces accumulate into a small probe image, so it converges over as many calls as there
+// is time for. Every probe pixel also keeps what the shader sees of its ray, the weight and
+// the cone marched optical depth to the sun of each step, so the octave constants can be
+// swept against the accumulated image without marching again.
+class CloudPathTracer
+{
+public:
+	struct Settings
+	{
+		uint32_t width;
+		uint32_t height;
+		// added per Trace
+		uint32_t samplesPerPixel;
+		// scattering events per path, longer paths are cut and lose their remaining light
+		uint32_t maxBounces;
+		uint32_t numThreads;
+		// single scattering albedo, 1 for water droplets in the visible
+		float albedo;
+		// bound of the density for delta tracking, 0 scans the layer around the camera for it
+		float maxDensity;
+		uint32_t seed;
+	};
+
+	struct Octaves
+	{
+		uint32_t count;
+		float attenuation;
+		float contribution;
+		float eccentricity;
+	};
+
+	struct Report
+	{
+		uint32_t width;
+		uint32_t height;
+		uint32_t numThreads;
+		// accumulated over all Trace calls since the image restarted
+		uint32_t samplesPerPixel;
+		uint64_t paths;
+		// of the last Trace
+		double seconds;
+		double pathsPerSecond;
+		// density lookups of the trackers
+		double samplesPerSecond;
+		double scatteringEventsPerPath;
+		// paths cut at maxBounces
+		uint64_t truncatedPaths;
+		float majorant;
+		// density samples above the majorant, clamped, the image is biased if there are any
+		uint64_t majorantViolations;
+		// integral of MiePhase over the sphere before normalizing, about 4.6 with either phase
+		float phaseIntegral;
+		// probe pixels whose ray sees cloud
+		uint32_t cloudPixels;
+		// relative RMS error to the traced image: the octaves of the cloud CB, a single
+		// octave and the max(exp(-d), 0.7 exp(-d / 4)) attenuation of GetLightEnergy
+		float octaveError;
+		float singleScatteringError;
+		float legacyError;
+		// relative standard error of the traced image itself
+		float noise;
+	};
+
+	struct SweepRange
+	{
+		uint32_t minOctaves;
+		uint32_t maxOctaves;
+		float attenuation[2];
+		float contribution[2];
+		float eccentricity[2];
+		// values per constant
+		uint32_t steps;
+	};
+
+	struct SweepResult
+	{
+		Octaves best;
+		float bestError;
+		uint32_t numCandidates;
+		double seconds;
+		double candidatesPerSecond;
+	};
+
+	static Settings DefaultSettings();
+	static SweepRange DefaultSweepRange();
+	static Octaves GetOctaves(const CloudParameterCB& cloudCB);
+	// msPhaseScale, 1 / the integral of MiePhase over the sphere, numericalMieFit or the LUT at its scale
+	static float GetPhaseScale();
+	// MultipleScatteringOctaves of VolumetricCloudCommon.hlsli, the light of one step per unit irradiance
+	static float EvaluateOctaves(const Octaves& octaves, float phase, float lightOpticalDepth);
+
+	CloudPathTracer();
+
+	// SetParameters of the query decides the clouds and the lighting constants
+	void SetDensityQuery(const CloudDensityQuery* query) { m_query = query; }
+	// MiePhase while the cloud CB sets mieLut, numericalMieFit otherwise
+	void SetPhase(const CloudMiePhase* phase) { m_phase = phase; }
+
+	// Adds samplesPerPixel paths to every probe pixel. The image restarts when its size
+	// changed or restart is set, the camera and the clouds are up to the caller.
+	void Trace(const CloudPassCB& passCB, const Settings& settings, bool restart);
+	// Relative RMS error of every candidate against the traced image, on all threads
+	SweepResult Sweep(const SweepRange& range, uint32_t numThreads) const;
+
+	// Error of a candidate, against the image traced so far
+	float MeasureError(const Octaves& octaves) const;
+	float MeasureLegacyError() const;
+
+	const Report& GetReport() const { return m_report; }
+	uint32_t GetWidth() const { return m_width; }
+	uint32_t GetHeight() const { return m_height; }
+	// mean radiance per unit sun irradiance of each probe pixel
+	std::vector<float> GetImage() const;
+
+private:
+	struct Ray
+	{
+		// from the bottom to the top of the layer like RaymarchCloud, 0 length for the ground
+		float start[3];
+		float dir[3];
+		float length;
+	};
+
+	struct Step
+	{
+		// T (1 - exp(-sigma ds)) of the view ray, and the RaymarchLight optical depth
+		float weight;
+		float lightDepth;
+	};
+
+	void BuildPhaseTable();
+	float EvaluatePhase(float cosTheta) const;
+	void SamplePhase(const float dir[3], float u0, float u1, float out[3]) const;
+	float ScanMaxDensity(const CloudPassCB& passCB) const;
+	void PrepareShaderSteps();
+	bool GetProbeRay(const CloudPassCB& passCB, uint32_t x, uint32_t y, Ray& ray) const;
+	float LightDepth(const float p[3], float ds, uint32_t mipLevel) const;
+	float TracePath(const Ray& ray, RandomNumberGenerator& rng, uint64_t& densitySamples, uint32_t& events) const;
+	bool SampleCollision(const float p[3], const float dir[3], float maxDistance, RandomNumberGenerator& rng, uint64_t& densitySamples, float& t) const;
+	float Transmittance(const float p[3], const float dir[3], float maxDistance, RandomNumberGenerator& rng, uint64_t& densitySamples) const;
+	float GetLayerDistance(const float p[3], const float dir[3]) const;
+	template <class Model> float MeasureModelError(Model&& model) const;
+
+	const CloudDensityQuery* m_query;
+	const CloudMiePhase* m_phase;
+	Settings m_settings;
+	Report m_report;
+
+	uint32_t m_width;
+	uint32_t m_height;
+	uint32_t m_pass;
+	// per pixel sums of the radiance and its square, over m_report.samplesPerPixel paths
+	std::vector<double> m_sum;
+	std::vector<double> m_sumSquared;
+	std::vector<Ray> m_rays;
+	// the steps of pixel i are m_steps[m_stepOffsets[i], m_stepOffsets[i + 1])
+	std::vector<Step> m_steps;
+	std::vector<uint32_t> m_stepOffsets;
+	// MiePhase of the view ray of each pixel
+	std::vector<float> m_viewPhase;
+
+	// phase per bin of the scattering angle and its CDF, both normalized over the sphere
+	std::vector<float> m_phaseTable;
+	std::vector<float> m_phaseCdf;
+	float m_phaseIntegral;
+
+	// delta tracking bound, in density and times DensityFactor
+	float m_maxDensity;
+	float m_sigmaMax;
+	float m_layerBottom;
+	float m_layerTop;
+	float m_lightDir[3];
+	mutable std::atomic<uint64_t> m_majorantViolations;
+};
\ No newline at end of file
@@ -0,0 +1,1214 @@
+#include "stdafx.h"
+#include "CloudReferenceRenderer.h"
+#include "CloudUpsampleFilter.h"
+#include "CloudPathTracer.h"
+#include "CloudMiePhase.h"
+#include "CloudVirtualWeather.h"
+#include "D3D12/CommandContext.h"
+#include "D3D12/GpuBuffer.h"
+#include "Noise/BlueNoiseGenerator.h"
+#include <DirectXPackedVector.h>
+#include <ppl.h>
+#include <atomic>
+#include <cfloat>
+#include <chrono>
+#include <fstream>
+
+// Same sizes as AtmosphereCommon.hlsli
+static const uint32_t kTransmittanceWidth = 256;
+static const uint32_t kTransmittanceHeight = 64;
+
+// VolumetricCloudCommon.hlsli
+static const float kCloudTopOffset = 750.0f;
+
+static const float kNoiseKernel[6][3] =
+{
+	{ 0.38051305f,  0.92453449f, -0.02111345f },
+	{ -0.50625799f, -0.03590792f, -0.86163418f },
+	{ -0.32509218f, -0.94557439f,  0.01428793f },
+	{ 0.09026238f, -0.27376545f,  0.95755165f },
+	{ 0.28128598f,  0.42443639f, -0.86065785f },
+	{ -0.16852403f,  0.14748697f,  0.97460106f }
+};
+
+struct GoldenFileHeader
+{
+	static const uint32_t kMagic = 0x46455243; // "CREF"
+
+	uint32_t magic;
+	uint32_t width;
+	uint32_t height;
+	uint32_t reserved;
+};
+
+static inline float Saturate(float x)
+{
+	return x < 0.0f ? 0.0f : (x > 1.0f ? 1.0f : x);
+}
+
+static inline float Frac(float x)
+{
+	return x - std::floor(x);
+}
+
+static inline float SmoothStep(float a, float b, float x)
+{
+	float t = Saturate((x - a) / (b - a));
+	return t * t * (3.0f - 2.0f * t);
+}
+
+static inline Vector3 LerpVector(Vector3 a, Vector3 b, float t)
+{
+	return a + (b - a) * t;
+}
+
+static bool RaySphereIntersection(Vector3 ro, Vector3 rd, Vector3 center, float radius, Vector3& startPos)
+{
+	Vector3 L = ro - center;
+	float a = Dot(rd, rd);
+	float b = 2.0f * Dot(rd, L);
+	float c = Dot(L, L) - radius * radius;
+	float discr = b * b - 4.0f * a * c;
+	if (discr < 0.0f)
+		return false;
+	float t = std::max(0.0f, (-b + std::sqrt(discr)) / 2.0f);
+	if (t == 0.0f)
+		return false;
+	startPos = ro + rd * t;
+	return true;
+}
+
+// ****** Atmosphere, the subset of AtmosphereCommon.hlsli the clouds need ****** //
+
+static float DistanceToTopAtmosphereBoundary(const Atmosphere::AtmosphereParameters& atmosphere, float r, float mu)
+{
+	float discriminant = r * r * (mu * mu - 1.0f) + atmosphere.top_radius * atmosphere.top_radius;
+	return std::max(-r * mu + std::sqrt(std::max(discriminant, 0.0f)), 0.0f);
+}
+
+static float GetDensity(const Atmosphere::DensityProfileLayer profile[2], float altitude)
+{
+	const Atmosphere::DensityProfileLayer& layer = altitude < profile[0].width ? profile[0] : profile[1];
+	float density = layer.expTerm * std::exp(layer.expScale * altitude) + layer.linearTerm * altitude + layer.constantTerm;
+	return Saturate(density);
+}
+
+static float ComputeOpticalLengthToTopAtmosphereBoundary(const Atmosphere::AtmosphereParameters& atmosphere,
+	const Atmosphere::DensityProfileLayer profile[2], float r, float mu)
+{
+	const int sample_count = 500;
+	float dx = DistanceToTopAtmosphereBoundary(atmosphere, r, mu) / (float)sample_count;
+	float result = 0.0f;
+	for (int i = 0; i < sample_count; ++i)
+	{
+		float d_i = (float)i * dx;
+		float r_i = std::sqrt(d_i * d_i + 2.0f * r * mu * d_i + r * r);
+		float y_i = GetDensity(profile, r_i - atmosphere.bottom_radius);
+		float weight_i = i == 0 ? 0.5f : 1.0f;
+		result += y_i * weight_i * dx;
+	}
+	return result;
+}
+
+static float GetTextureCoordFromUnitRange(float x, uint32_t textureSize)
+{
+	return 0.5f / (float)textureSize + x * (1.0f - 1.0f / (float)textureSize);
+}
+
+static float GetUnitRangeFromTextureCoord(float u, uint32_t textureSize)
+{
+	return (u - 0.5f / (float)textureSize) / (1.0f - 1.0f / (float)textureSize);
+}
+
+// ****** CloudReferenceTexture ****** //
+
+void CloudReferenceTexture::Create(uint32_t width, uint32_t height, uint32_t depth, const float* rgba, uint32_t numMips)
+{
+	assert(width > 0 && height > 0 && depth > 0);
+	m_width = width;
+	m_height = height;
+	m_depth = depth;
+	m_mips.clear();
+
+	Mip top;
+	top.width = width;
+	top.height = height;
+	top.depth = depth;
+	top.texels.resize((size_t)width * height * depth);
+	memcpy(top.texels.data(), rgba, top.texels.size() * sizeof(XMFLOAT4));
+	m_mips.push_back(std::move(top));
+
+	// 2x2x2 box filter, same as GenerateMipMaps for power of two sizes
+	while (numMips == 0 || m_mips.size() < numMips)
+	{
+		const Mip& src = m_mips.back();
+		if (src.width == 1 && src.height == 1 && src.depth == 1)
+			break;
+
+		Mip dst;
+		dst.width = std::max(1u, src.width / 2);
+		dst.height = std::max(1u, src.height / 2);
+		dst.depth = std::max(1u, src.depth / 2);
+		dst.texels.resize((size_t)dst.width * dst.height * dst.depth);
+		concurrency::parallel_for(0u, dst.depth, [&](uint32_t z)
+		{
+			uint32_t z0 = std::min(z * 2, src.depth - 1), z1 = std::min(z * 2 + 1, src.depth - 1);
+			for (uint32_t y = 0; y < dst.height; ++y)
+			{
+				uint32_t y0 = std::min(y * 2, src.height - 1), y1 = std::min(y * 2 + 1, src.height - 1);
+				for (uint32_t x = 0; x < dst.width; ++x)
+				{
+					uint32_t x0 = std::min(x * 2, src.width - 1), x1 = std::min(x * 2 + 1, src.width - 1);
+					auto load = [&](uint32_t tx, uint32_t ty, uint32_t tz)
+					{
+						return XMLoadFloat4(&src.texels[((size_t)tz * src.height + ty) * src.width + tx]);
+					};
+					XMVECTOR sum = XMVectorAdd(XMVectorAdd(load(x0, y0, z0), load(x1, y0, z0)), XMVectorAdd(load(x0, y1, z0), load(x1, y1, z0)));
+					sum = XMVectorAdd(sum, XMVectorAdd(XMVectorAdd(load(x0, y0, z1), load(x1, y0, z1)), XMVectorAdd(load(x0, y1, z1), load(x1, y1, z1))));
+					XMStoreFloat4(&dst.texels[((size_t)z * dst.height + y) * dst.width + x], XMVectorScale(sum, 0.125f));
+				}
+			}
+		});
+		m_mips.push_back(std::move(dst));
+	}
+}
+
+bool CloudReferenceTexture::CreateFromGpu(GpuResource& resource, uint32_t numMips)
+{
+	D3D12_RESOURCE_DESC desc = resource.GetResource()->GetDesc();
+	uint32_t width = (uint32_t)desc.Width;
+	uint32_t height = desc.Height;
+	uint32_t depth = desc.Dimension == D3D12_RESOURCE_DIMENSION_TEXTURE3D ? desc.DepthOrArraySize : 1;
+
+	uint32_t texel_bytes;
+	switch (desc.Format)
+	{
+	case DXGI_FORMAT_R32G32B32A32_FLOAT: texel_bytes = 16; break;
+	case DXGI_FORMAT_R16G16B16A16_FLOAT: texel_bytes = 8; break;
+	case DXGI_FORMAT_R8G8B8A8_UNORM:
+	case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+	case DXGI_FORMAT_B8G8R8A8_UNORM:
+	case DXGI_FORMAT_R32_FLOAT: texel_bytes = 4; break;
+	case DXGI_FORMAT_R8_UNORM: texel_bytes = 1; break;
+	default:
+		assert(false && "Unsupported format for CPU readback");
+		// not what was read back before either
+		m_mips.clear();
+		m_width = m_height = m_depth = 0;
+		return false;
+	}
+
+	// put the texture back in the state the render passes expect
+	D3D12_RESOURCE_STATES old_state = resource.GetUsageState();
+	ReadbackBuffer readback;
+	CommandContext& context = CommandContext::Begin();
+	uint32_t row_pitch = context.ReadbackTexture(readback, resource);
+	context.TransitionResource(resource, old_state);
+	context.Finish(true);
+
+	std::vector<XMFLOAT4> texels((size_t)width * height * depth);
+	const uint8_t* mapped = reinterpret_cast<const uint8_t*>(readback.Map());
+	for (uint32_t z = 0; z < depth; ++z)
+	{
+		for (uint32_t y = 0; y < height; ++y)
+		{
+			const uint8_t* row = mapped + ((size_t)z * height + y) * row_pitch;
+			XMFLOAT4* dst = &texels[((size_t)z * height + y) * width];
+			for (uint32_t x = 0; x < width; ++x)
+			{
+				const uint8_t* src = row + (size_t)x * texel_bytes;
+				switch (desc.Format)
+				{
+				case DXGI_FORMAT_R32G32B32A32_FLOAT:
+					memcpy(&dst[x], src, sizeof(XMFLOAT4));
+					break;
+				case DXGI_FORMAT_R16G16B16A16_FLOAT:
+				{
+					const PackedVector::HALF* h = reinterpret_cast<const PackedVector::HALF*>(src);
+					dst[x] = XMFLOAT4(PackedVector::XMConvertHalfToFloat(h[0]), PackedVector::XMConvertHalfToFloat(h[1]),
+						PackedVector::XMConvertHalfToFloat(h[2]), PackedVector::XMConvertHalfToFloat(h[3]));
+					break;
+				}
+				case DXGI_FORMAT_R8G8B8A8_UNORM:
+				case DXGI_FORMAT_R8G8B8A8_UNORM_SRGB:
+					dst[x] = XMFLOAT4(src[0] / 255.0f, src[1] / 255.0f, src[2] / 255.0f, src[3] / 255.0f);
+					break;
+				case DXGI_FORMAT_B8G8R8A8_UNORM:
+					dst[x] = XMFLOAT4(src[2] / 255.0f, src[1] / 255.0f, src[0] / 255.0f, src[3] / 255.0f);
+					break;
+				case DXGI_FORMAT_R32_FLOAT:
+					dst[x] = XMFLOAT4(*reinterpret_cast<const float*>(src), 0.0f, 0.0f, 1.0f);
+					break;
+				case DXGI_FORMAT_R8_UNORM:
+					dst[x] = XMFLOAT4(src[0] / 255.0f, 0.0f, 0.0f, 1.0f);
+					break;
+				}
+			}
+		}
+	}
+	readback.Unmap();
+	readback.Destroy();
+
+	Create(width, height, depth, reinterpret_cast<const float*>(texels.data()), numMips);
+	return true;
+}
+
+Vector4 CloudReferenceTexture::SampleLevel(float u, float v, float w, uint32_t mip, AddressMode mode) const
+{
+	// nothing read back, no cloud
+	if (m_mips.empty())
+		return Vector4(kZero);
+	const Mip& m = m_mips[std::min(mip, (uint32_t)m_mips.size() - 1)];
+
+	auto address = [mode](int i, uint32_t size) -> uint32_t
+	{
+		if (mode == kWrap)
+			return (uint32_t)(((i % (int)size) + (int)size) % (int)size);
+		return (uint32_t)std::min(std::max(i, 0), (int)size - 1);
+	};
+
+	float fx = u * m.width - 0.5f;
+	float fy = v * m.height - 0.5f;
+	float fz = w * m.depth - 0.5f;
+	float x0f = std::floor(fx), y0f = std::floor(fy), z0f = std::floor(fz);
+	float tx = fx - x0f, ty = fy - y0f, tz = fz - z0f;
+	uint32_t x0 = address((int)x0f, m.width), x1 = address((int)x0f + 1, m.width);
+	uint32_t y0 = address((int)y0f, m.height), y1 = address((int)y0f + 1, m.height);
+	uint32_t z0 = address((int)z0f, m.depth), z1 = address((int)z0f + 1, m.depth);
+
+	// one texel is one SSE register, the whole filter runs on all four channels at once
+	auto load = [&m](uint32_t x, uint32_t y, uint32_t z)
+	{
+		return XMLoadFloat4(&m.texels[((size_t)z * m.height + y) * m.width + x]);
+	};
+	XMVECTOR c00 = XMVectorLerp(load(x0, y0, z0), load(x1, y0, z0), tx);
+	XMVECTOR c10 = XMVectorLerp(load(x0, y1, z0), load(x1, y1, z0), tx);
+	XMVECTOR c01 = XMVectorLerp(load(x0, y0, z1), load(x1, y0, z1), tx);
+	XMVECTOR c11 = XMVectorLerp(load(x0, y1, z1), load(x1, y1, z1), tx);
+	XMVECTOR c0 = XMVectorLerp(c00, c10, ty);
+	XMVECTOR c1 = XMVectorLerp(c01, c11, ty);
+	return Vector4(XMVectorLerp(c0, c1, tz));
+}
+
+// ****** CloudReferenceRenderer ****** //
+
+// Constants of one Render call, derived once from the two CBs
+struct CloudReferenceRenderer::Context
+{
+	const CloudPassCB* pass;
+	const CloudParameterCB* cloud;
+	// MiePhase reads it when the cloud CB sets mieLut
+	const CloudMiePhase* phase;
+	Vector3 cameraPosition;
+	Vector3 lightDir;
+	Vector3 sphereCenter;
+	Vector3 windDirection;
+	Vector3 cloudBottomColor;
+	Vector3 cloudScatter;
+	float resolutionInv[2];
+	float innerRadius;
+	float outerRadius;
+	// xz of the SampleCloudDensity animation: wind * (height_fraction * CLOUD_TOP_OFFSET + Time * CloudSpeed)
+	float windOffset;
+	float spreadU;
+	float spreadV;
+	// the empty space map covers the repeating weather map, not the virtual weather atlas
+	bool skipEmptySpace;
+};
+
+CloudReferenceRenderer::CloudReferenceRenderer()
+	: m_cloudShape(nullptr),
+	m_erosion(nullptr),
+	m_weather(nullptr),
+	m_virtualWeather(nullptr),
+	m_blueNoise(nullptr),
+	m_phase(nullptr),
+	m_tileSize(16),
+	m_numThreads(std::max(1u, std::thread::hardware_concurrency())),
+	m_width(0),
+	m_height(0),
+	m_useEmptySpaceSkipping(false),
+	m_lightMode(kLightConeMarch),
+	m_denseSubsteps(0),
+	m_shadowVolumeExtent(50000.0f)
+{
+	ZeroMemory(&m_atmosphere, sizeof(m_atmosphere));
+	ZeroMemory(&m_totals, sizeof(Totals));
+}
+
+void CloudReferenceRenderer::SetTextures(const CloudReferenceTexture* cloudShape, const CloudReferenceTexture* erosion, const CloudReferenceTexture* weather)
+{
+	m_cloudShape = cloudShape;
+	m_erosion = erosion;
+	m_weather = weather;
+	m_densityQuery.SetTextures(cloudShape, erosion, weather);
+}
+
+void CloudReferenceRenderer::SetVirtualWeather(const CloudVirtualWeather* virtualWeather)
+{
+	m_virtualWeather = virtualWeather;
+	m_densityQuery.SetVirtualWeather(virtualWeather);
+}
+
+void CloudReferenceRenderer::SetAtmosphere(const Atmosphere::AtmosphereParameters& atmosphere)
+{
+	m_atmosphere = atmosphere;
+
+	// ComputeTransmittanceToTopAtmosphereBoundaryTexture for every texel
+	std::vector<XMFLOAT4> texels(kTransmittanceWidth * kTransmittanceHeight);
+	concurrency::parallel_for(0u, kTransmittanceHeight, [&](uint32_t y)
+	{
+		for (uint32_t x = 0; x < kTransmittanceWidth; ++x)
+		{
+			float x_mu = GetUnitRangeFromTextureCoord((x + 0.5f) / kTransmittanceWidth, kTransmittanceWidth);
+			float x_r = GetUnitRangeFromTextureCoord((y + 0.5f) / kTransmittanceHeight, kTransmittanceHeight);
+			float H = std::sqrt(atmosphere.top_radius * atmosphere.top_radius - atmosphere.bottom_radius * atmosphere.bottom_radius);
+			float rho = H * x_r;
+			float r = std::sqrt(rho * rho + atmosphere.bottom_radius * atmosphere.bottom_radius);
+			float d_min = atmosphere.top_radius - r;
+			float d_max = rho + H;
+			float d = d_min + x_mu * (d_max - d_min);
+			float mu = d == 0.0f ? 1.0f : (H * H - rho * rho - d * d) / (2.0f * r * d);
+			mu = std::min(std::max(mu, -1.0f), 1.0f);
+
+			float rayleigh = ComputeOpticalLengthToTopAtmosphereBoundary(atmosphere, atmosphere.rayleigh_density, r, mu);
+			float mie = ComputeOpticalLengthToTopAtmosphereBoundary(atmosphere, atmosphere.mie_density, r, mu);
+			float absorption = ComputeOpticalLengthToTopAtmosphereBoundary(atmosphere, atmosphere.absorption_density, r, mu);
+			texels[y * kTransmittanceWidth + x] = XMFLOAT4(
+				std::exp(-(atmosphere.rayleigh_scattering.x * rayleigh + atmosphere.mie_extinction.x * mie + atmosphere.absorption_extinction.x * absorption)),
+				std::exp(-(atmosphere.rayleigh_scattering.y * rayleigh + atmosphere.mie_extinction.y * mie + atmosphere.absorption_extinction.y * absorption)),
+				std::exp(-(atmosphere.rayleigh_scattering.z * rayleigh + atmosphere.mie_extinction.z * mie + atmosphere.absorption_extinction.z * absorption)),
+				1.0f);
+		}
+	});
+	m_transmittance.Create(kTransmittanceWidth, kTransmittanceHeight, 1, reinterpret_cast<const float*>(texels.data()), 1);
+}
+
+Vector3 CloudReferenceRenderer::GetSunIrradianceAtPoint(Vector3 p, Vector3 sunDirection) const
+{
+	// GetSunAndSkyIrradianceAtPoint, the sky term is unused by RaymarchCloud
+	float r = Length(p);
+	float mu_s = Dot(p, sunDirection) / r;
+
+	// GetTransmittanceTextureUVFromRMu
+	float H = std::sqrt(m_atmosphere.top_radius * m_atmosphere.top_radius - m_atmosphere.bottom_radius * m_atmosphere.bottom_radius);
+	float rho = std::sqrt(std::max(r * r - m_atmosphere.bottom_radius * m_atmosphere.bottom_radius, 0.0f));
+	float d = DistanceToTopAtmosphereBoundary(m_atmosphere, r, mu_s);
+	float d_min = m_atmosphere.top_radius - r;
+	float d_max = rho + H;
+	float u = GetTextureCoordFromUnitRange((d - d_min) / (d_max - d_min), kTransmittanceWidth);
+	float v = GetTextureCoordFromUnitRange(rho / H, kTransmittanceHeight);
+	Vector3 transmittance = Vector3(m_transmittance.SampleLevel(u, v, 0.5f, 0, CloudReferenceTexture::kClamp));
+
+	// GetTransmittanceToSun
+	float sin_theta_h = m_atmosphere.bottom_radius / r;
+	float cos_theta_h = -std::sqrt(std::max(1.0f - sin_theta_h * sin_theta_h, 0.0f));
+	float sun_visibility = SmoothStep(-sin_theta_h * m_atmosphere.sun_angular_radius, sin_theta_h * m_atmosphere.sun_angular_radius, mu_s - cos_theta_h);
+	return Vector3(m_atmosphere.solar_irradiance) * transmittance * sun_visibility;
+}
+
+float CloudReferenceRenderer::GetJitter(const Context& ctx, uint32_t x, uint32_t y) const
+{
+	if (ctx.cloud->useBlueNoise != 0 && m_blueNoise != nullptr && !m_blueNoise->GetValues().empty())
+	{
+		uint32_t size = m_blueNoise->GetSize();
+		uint32_t slice = ctx.pass->frameIndex % m_blueNoise->GetNumSlices();
+		return m_blueNoise->GetValues()[((size_t)slice * size + y % size) * size + x % size] / 65535.0f;
+	}
+	// n1rand(float2(pixelCoord))
+	float t = Frac(235.45323f);
+	float nx = (float)x + 0.07f * t;
+	float ny = (float)y + 0.07f * t;
+	return Frac(std::sin(nx * 12.9898f + ny * 78.233f) * 43758.5453f);
+}
+
+float CloudReferenceRenderer::GetHeightFraction(const Context& ctx, Vector3 p) const
+{
+	return (std::abs((float)p.GetY() - (float)ctx.sphereCenter.GetY()) - ctx.innerRadius) / (ctx.outerRadius - ctx.innerRadius);
+}
+
+bool CloudReferenceRenderer::IsEmptySpace(const Context& ctx, Vector3 p, float heightFraction) const
+{
+	if (!ctx.skipEmptySpace)
+		return false;
+	float offset = heightFraction * kCloudTopOffset + ctx.windOffset;
+	Vector3 moving_p = p + ctx.windDirection * offset;
+	return m_emptySpaceMap.IsEmpty((float)moving_p.GetX() / ctx.outerRadius + 0.5f, (float)moving_p.GetZ() / ctx.outerRadius + 0.5f, heightFraction);
+}
+
+uint32_t CloudReferenceRenderer::GetEmptySteps(const Context& ctx, Vector3 p, Vector3 step, uint32_t maxSteps) const
+{
+	// footprint of the whole layer height, the step may cross it
+	Vector3 moving_p = p + ctx.windDirection * ctx.windOffset;
+	return m_emptySpaceMap.GetEmptySteps((float)moving_p.GetX() / ctx.outerRadius + 0.5f, (float)moving_p.GetZ() / ctx.outerRadius + 0.5f,
+		(float)step.GetX() / ctx.outerRadius, (float)step.GetZ() / ctx.outerRadius, ctx.spreadU, ctx.spreadV, maxSteps);
+}
+
+float CloudReferenceRenderer::SampleCloudDensity(const Context& ctx, Vector3 p, bool expensive, uint32_t lod, TileStats& stats) const
+{
+	stats.densitySamples++;
+	float height_fraction = GetHeightFraction(ctx, p);
+	if (expensive && height_fraction >= 0.0f && height_fraction <= 1.0f)
+		stats.expensiveSamples++;
+	return m_densityQuery.SampleDensity(XMFLOAT3(p.GetX(), p.GetY(), p.GetZ()), expensive, lod);
+}
+
+float CloudReferenceRenderer::RaymarchLight(const Context& ctx, Vector3 o, float stepSize, uint32_t mipLevel, TileStats& stats) const
+{
+	Vector3 start_pos = o;
+	float ds = stepSize;
+	Vector3 ray_step = ctx.lightDir * ds;
+	const float cone_step = 1.0f / 6.0f;
+	float cone_radius = 1.0f;
+	float density = 0.0f;
+	float sigma_ds = ds * ctx.cloud->absorption;
+	float T = 0.0f;
+
+	for (uint32_t i = 0; i < 6; ++i)
+	{
+		Vector3 pos = start_pos + Vector3(kNoiseKernel[i][0], kNoiseKernel[i][1], kNoiseKernel[i][2]) * (cone_radius * (float)i);
+		float height_fraction = GetHeightFraction(ctx, pos);
+		if (height_fraction >= 0.0f && !IsEmptySpace(ctx, pos, height_fraction))
+		{
+			uint32_t mip_offset = (uint32_t)(i * 0.5f);
+			stats.lightSamples++;
+			float cloud_density = SampleCloudDensity(ctx, pos, density > 0.3f, mipLevel + mip_offset, stats);
+			if (cloud_density > 0.0f)
+			{
+				T += cloud_density;
+				density += cloud_density;
+			}
+		}
+		start_pos += ray_step;
+		cone_radius += cone_step;
+	}
+	return T * sigma_ds;
+}
+
+Vector3 CloudReferenceRenderer::IntegrateStep(const Context& ctx, Vector3 pos, float densitySample, float ds, float lightDs, uint32_t mipLevel,
+	float lightDotEye, const float scattering[3], Vector3 bg, TileStats& stats) const
+{
+	const CloudParameterCB& cloud = *ctx.cloud;
+	const float abc_x = cloud.ABC[0], abc_y = cloud.ABC[1];
+	float sigma_ds = -ds * cloud.densityFactor;
+	float height = GetHeightFraction(ctx, pos);
+
+	float light_density;
+	if (m_lightMode == kLightConeMarch || !GetShadowVolumeDepth(ctx, pos, lightDs * 0.6f, light_density))
+		light_density = RaymarchLight(ctx, pos, lightDs * 0.6f, mipLevel, stats);
+	float d_trans = std::exp(densitySample * sigma_ds);
+
+	Vector3 earth_offset(0.0f, cloud.earthRadius, 0.0f);
+	Vector3 sun_irradiance = GetSunIrradianceAtPoint((pos + ctx.lightDir * (lightDs * 3.6f)) * 0.00001f + earth_offset, ctx.lightDir) *
+		ctx.cloudScatter * cloud.cloudScatteringWeight;
+	Vector3 ambient_light = (ctx.cloudBottomColor * ((0.5f + 0.6f * height) * 6.5f) + Vector3(0.8f, 0.8f, 0.8f) * std::max(0.0f, 1.0f - 2.0f * height)) *
+		((float)Length(sun_irradiance) * 0.02f);
+
+	if (cloud.lightingModel != 0)
+	{
+		Vector3 ambient_term = LerpVector(ambient_light * 1.8f, bg, 0.2f) * cloud.msAmbient;
+		float octaves = CloudPathTracer::EvaluateOctaves(CloudPathTracer::GetOctaves(cloud), CloudMiePhase::MiePhase(ctx.phase, lightDotEye) * cloud.msPhaseScale, light_density);
+		return (sun_irradiance * (cloud.msSunScale * octaves) + ambient_term) * (1.0f - d_trans);
+	}
+
+	float powder_term = cloud.enablePowder ? (1.0f - std::exp(-2.0f * light_density)) : 1.0f;
+	float beer_term = cloud.enableBeer ? 2.0f * std::exp(-light_density * cloud.rainAbsorption) : 1.0f;
+	float sun_weight = beer_term * powder_term * std::exp(-light_density);
+	Vector3 ambient_term = LerpVector(ambient_light * 1.8f, bg, 0.2f);
+	Vector3 S = LerpVector(ambient_term, sun_irradiance * scattering[0], sun_weight) * (0.6f * densitySample);
+	Vector3 S_1 = LerpVector(ambient_term, sun_irradiance * scattering[1], sun_weight) * (0.6f * densitySample * abc_y);
+	Vector3 S_2 = LerpVector(ambient_term, sun_irradiance * scattering[2], sun_weight) * (0.6f * densitySample * abc_y * abc_y);
+	return (S - S * d_trans) * (1.0f / densitySample) +
+		S_1 * ((1.0f - std::exp(densitySample * sigma_ds * abc_x)) / (densitySample * abc_x)) +
+		S_2 * ((1.0f - std::exp(densitySample * sigma_ds * abc_x * abc_x)) / (densitySample * abc_x * abc_x));
+}
+
+Vector4 CloudReferenceRenderer::RaymarchCloudAdaptive(const Context& ctx, uint32_t x, uint32_t y, Vector3 startPos, Vector3 dir, float len, float ds,
+	const float scattering[3], Vector3 bg, float& cloudDepth, TileStats& stats) const
+{
+	const CloudParameterCB& cloud = *ctx.cloud;
+	float start_distance = Length(startPos - ctx.cameraPosition);
+	float coarse_ds = ds * std::max(cloud.coarseStepScale, 1.0f);
+	float lod_range = std::max(cloud.lodFarDistance - cloud.lodNearDistance, 1.0f);
+	float light_dot_eye = Dot(Normalize(ctx.lightDir), dir);
+	float sigma_ds = -ds * cloud.densityFactor;
+
+	Vector3 color(kZero);
+	float T = 1.0f;
+	bool entered = false;
+	bool fine = false;
+	int zero_density_sample_count = 0;
+	float t = ds * GetJitter(ctx, x, y);
+	float resume_t = t;
+	float hit_t = t;
+
+	const uint32_t max_iterations = (uint32_t)(len / ds) * 2 + 2;
+	for (uint32_t i = 0; i < max_iterations && t < len; ++i)
+	{
+		Vector3 pos = startPos + dir * t;
+		float view_distance = start_distance + t;
+		uint32_t mip_level = (uint32_t)(t / ds * 0.0625f + Saturate((view_distance - cloud.lodNearDistance) / lod_range) * cloud.lodMipBias);
+
+		if (!fine)
+		{
+			stats.marchSteps++;
+			if (ctx.skipEmptySpace)
+			{
+				// whole coarse steps over an empty footprint, the fine restart point moves along
+				uint32_t max_skip = (uint32_t)((len - t) / coarse_ds) + 1;
+				uint32_t skip = GetEmptySteps(ctx, pos, dir * coarse_ds, max_skip);
+				if (skip > 0)
+				{
+					t += coarse_ds * skip;
+					resume_t = t;
+					stats.skippedSteps += skip;
+					stats.marchSteps += skip - 1;
+					continue;
+				}
+			}
+			if (SampleCloudDensity(ctx, pos, false, mip_level, stats) > 0.0f)
+			{
+				fine = true;
+				zero_density_sample_count = 0;
+				hit_t = t;
+				t = resume_t;
+				stats.refinements++;
+			}
+			else
+			{
+				resume_t = t + ds;
+				t += coarse_ds;
+			}
+			continue;
+		}
+
+		stats.marchSteps++;
+		float density_sample = SampleCloudDensity(ctx, pos, view_distance < cloud.lodFarDistance, mip_level, stats);
+		if (density_sample > 0.0f)
+		{
+			if (!entered)
+			{
+				cloudDepth = view_distance;
+				entered = true;
+			}
+			zero_density_sample_count = 0;
+			color += IntegrateStep(ctx, pos, density_sample, ds, ds, mip_level, light_dot_eye, scattering, bg, stats) * T;
+			T *= std::exp(density_sample * sigma_ds);
+			if (T < cloud.minTransmittance)
+				break;
+		}
+		else
+		{
+			zero_density_sample_count++;
+		}
+		t += ds;
+
+		if (zero_density_sample_count >= cloud.fineZeroSamples && t > hit_t)
+		{
+			fine = false;
+			resume_t = t;
+		}
+	}
+	return Vector4(color, 1.0f - T);
+}
+
+// Every fine step of the adaptive march split in m_denseSubsteps, all the way through the layer.
+// The mip level, the erosion cut off and the light march follow the adaptive step, so only the
+// quadrature along the view ray gets finer.
+Vector4 CloudReferenceRenderer::RaymarchCloudDense(const Context& ctx, uint32_t x, uint32_t y, Vector3 startPos, Vector3 dir, float len, float ds,
+	const float scattering[3], Vector3 bg, float& cloudDepth, TileStats& stats) const
+{
+	const CloudParameterCB& cloud = *ctx.cloud;
+	float start_distance = Length(startPos - ctx.cameraPosition);
+	float lod_range = std::max(cloud.lodFarDistance - cloud.lodNearDistance, 1.0f);
+	float light_dot_eye = Dot(Normalize(ctx.lightDir), dir);
+	float dense_ds = ds / m_denseSubsteps;
+	float sigma_ds = -dense_ds * cloud.densityFactor;
+
+	Vector3 color(kZero);
+	float T = 1.0f;
+	bool entered = false;
+	float start_t = dense_ds * GetJitter(ctx, x, y);
+	for (uint32_t i = 0; start_t + i * dense_ds < len; ++i)
+	{
+		float t = start_t + i * dense_ds;
+		Vector3 pos = startPos + dir * t;
+		float view_distance = start_distance + t;
+		uint32_t mip_level = (uint32_t)(t / ds * 0.0625f + Saturate((view_distance - cloud.lodNearDistance) / lod_range) * cloud.lodMipBias);
+
+		stats.marchSteps++;
+		float density_sample = SampleCloudDensity(ctx, pos, view_distance < cloud.lodFarDistance, mip_level, stats);
+		if (density_sample > 0.0f)
+		{
+			if (!entered)
+			{
+				cloudDepth = view_distance;
+				entered = true;
+			}
+			color += IntegrateStep(ctx, pos, density_sample, dense_ds, ds, mip_level, light_dot_eye, scattering, bg, stats) * T;
+			T *= std::exp(density_sample * sigma_ds);
+		}
+	}
+	return Vector4(color, 1.0f - T);
+}
+
+Vector4 CloudReferenceRenderer::RaymarchCloud(const Context& ctx, uint32_t x, uint32_t y, Vector3 startPos, Vector3 endPos, Vector3 bg, float& cloudDepth, TileStats& stats) const
+{
+	const CloudParameterCB& cloud = *ctx.cloud;
+	Vector3 path = endPos - startPos;
+	float len = Length(path);
+
+	Vector3 dir = Normalize(path);
+	const int n_steps = (int)(cloud.sampleCountMin + (cloud.sampleCountMax - cloud.sampleCountMin) * (float)dir.GetY());
+
+	float ds = len / n_steps;
+	float light_dot_eye = Dot(Normalize(ctx.lightDir), dir);
+	const float abc_z = cloud.ABC[2];
+	const float scattering[3] = {
+		std::max(CloudMiePhase::MiePhase(ctx.phase, light_dot_eye), 1.0f),
+		std::max(CloudMiePhase::MiePhase(ctx.phase, light_dot_eye * abc_z), 1.0f),
+		std::max(CloudMiePhase::MiePhase(ctx.phase, light_dot_eye * abc_z * abc_z), 1.0f) };
+
+	// the first sample with density, the end of the layer if there is none
+	cloudDepth = Length(endPos - ctx.cameraPosition);
+
+	if (m_denseSubsteps > 0)
+		return RaymarchCloudDense(ctx, x, y, startPos, dir, len, ds, scattering, bg, cloudDepth, stats);
+	if (cloud.adaptiveMarch != 0)
+		return RaymarchCloudAdaptive(ctx, x, y, startPos, dir, len, ds, scattering, bg, cloudDepth, stats);
+
+	dir = dir * ds;
+	Vector3 color(kZero);
+	startPos += dir * GetJitter(ctx, x, y);
+	Vector3 pos = startPos;
+
+	float T = 1.0f;
+	float sigma_ds = -ds * cloud.densityFactor;
+	bool entered = false;
+
+	for (int i = 0; i < n_steps; ++i)
+	{
+		if (ctx.skipEmptySpace)
+		{
+			// zero density steps only move the sample point, so skipping them keeps the image identical
+			uint32_t skip = GetEmptySteps(ctx, pos, dir, n_steps - i);
+			if (skip == 0 && IsEmptySpace(ctx, pos, GetHeightFraction(ctx, pos)))
+				skip = 1;
+			if (skip > 0)
+			{
+				for (uint32_t s = 0; s < skip; ++s)
+					pos += dir;
+				i += skip - 1;
+				stats.marchSteps += skip;
+				stats.skippedSteps += skip;
+				continue;
+			}
+		}
+
+		stats.marchSteps++;
+		uint32_t mip_level = (uint32_t)(i * 0.0625f);
+		float density_sample = SampleCloudDensity(ctx, pos, true, mip_level, stats);
+
+		if (density_sample > 0.0f)
+		{
+			if (!entered)
+			{
+				cloudDepth = Length(pos - ctx.cameraPosition);
+				entered = true;
+			}
+			color += IntegrateStep(ctx, pos, density_sample, ds, ds, mip_level, light_dot_eye, scattering, bg, stats) * T;
+			T *= std::exp(density_sample * sigma_ds);
+		}
+		pos += dir;
+
+		if (T < cloud.minTransmittance)
+			break;
+	}
+	return Vector4(color, 1.0f - T);
+}
+
+Vector4 CloudReferenceRenderer::RenderPixel(const Context& ctx, uint32_t x, uint32_t y, XMFLOAT4& layer, XMFLOAT2& depth, TileStats& stats) const
+{
+	// ComputeWorldViewDir
+	float sx = (x + 0.5f) * ctx.resolutionInv[0];
+	float sy = (y + 0.5f) * ctx.resolutionInv[1];
+	Vector4 view_coord = ctx.pass->invProj * Vector4(sx * 2.0f - 1.0f, 1.0f - sy * 2.0f, 1.0f, 1.0f);
+	view_coord = view_coord / view_coord.GetW();
+	Vector3 world_dir = Normalize(Vector3(ctx.pass->invView * Vector4(Vector3(view_coord), 0.0f)));
+
+	Vector3 bg(0.4851f, 0.5986f, 0.7534f);
+	Vector3 start_pos = ctx.cameraPosition, end_pos = ctx.cameraPosition;
+	RaySphereIntersection(ctx.cameraPosition, world_dir, ctx.sphereCenter, ctx.innerRadius, start_pos);
+	RaySphereIntersection(ctx.cameraPosition, world_dir, ctx.sphereCenter, ctx.outerRadius, end_pos);
+
+	Vector3 ground_pos;
+	if (RaySphereIntersection(ctx.cameraPosition, world_dir, ctx.sphereCenter, ctx.cloud->earthRadius, ground_pos))
+	{
+		layer = XMFLOAT4(0.0f, 0.0f, 0.0f, 1.0f);
+		depth = XMFLOAT2(0.0f, 0.0f);
+		return Vector4(0.0f, 0.2f, 0.87f, 1.0f);
+	}
+
+	stats.rays++;
+	float cloud_depth;
+	Vector4 v = RaymarchCloud(ctx, x, y, start_pos, end_pos, bg, cloud_depth, stats);
+
+	float alpha = v.GetW();
+	float cloud_alphaness = alpha > 0.2f ? alpha : 0.0f;
+	Vector3 rgb = Vector3(v) * 1.8f - Vector3(0.1f, 0.1f, 0.1f);
+	layer = XMFLOAT4(rgb.GetX(), rgb.GetY(), rgb.GetZ(), 1.0f - alpha);
+	depth = XMFLOAT2(cloud_depth, Length(start_pos - ctx.cameraPosition));
+	bg = bg * (1.0f - alpha) + rgb;
+	return Vector4(bg, cloud_alphaness);
+}
+
+void CloudReferenceRenderer::RenderTile(const Context& ctx, TileStats& stats)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	uint32_t x_end = std::min(stats.x + m_tileSize, m_width);
+	uint32_t y_end = std::min(stats.y + m_tileSize, m_height);
+	for (uint32_t y = stats.y; y < y_end; ++y)
+	{
+		for (uint32_t x = stats.x; x < x_end; ++x)
+		{
+			size_t index = (size_t)y * m_width + x;
+			XMStoreFloat4(&m_image[index], RenderPixel(ctx, x, y, m_layers[index], m_depth[index], stats));
+		}
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+	stats.milliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+void CloudReferenceRenderer::InitContext(Context& ctx, const CloudPassCB& passCB, const CloudParameterCB& cloudCB, uint32_t width, uint32_t height) const
+{
+	ctx.pass = &passCB;
+	ctx.cloud = &cloudCB;
+	ctx.phase = cloudCB.mieLut != 0 ? m_phase : nullptr;
+	ctx.cameraPosition = Vector3(passCB.cameraPosition);
+	ctx.lightDir = Vector3(passCB.lightDir);
+	ctx.sphereCenter = Vector3(passCB.cameraPosition.x, -cloudCB.earthRadius * 100.0f, passCB.cameraPosition.z);
+	ctx.windDirection = Vector3(1.0f, 0.0f, 0.0f);
+	ctx.cloudBottomColor = Vector3(cloudCB.cloudBottomColor[0], cloudCB.cloudBottomColor[1], cloudCB.cloudBottomColor[2]);
+	ctx.cloudScatter = Vector3(cloudCB.cloudScattering[0], cloudCB.cloudScattering[1], cloudCB.cloudScattering[2]);
+	ctx.resolutionInv[0] = 1.0f / width;
+	ctx.resolutionInv[1] = 1.0f / height;
+	ctx.innerRadius = cloudCB.earthRadius * 100.0f + cloudCB.cloudBottomRadius;
+	ctx.outerRadius = cloudCB.earthRadius * 100.0f + cloudCB.cloudTopRadius;
+	ctx.windOffset = passCB.time * cloudCB.cloudSpeed;
+	ctx.spreadU = (float)ctx.windDirection.GetX() * kCloudTopOffset / ctx.outerRadius;
+	ctx.spreadV = (float)ctx.windDirection.GetZ() * kCloudTopOffset / ctx.outerRadius;
+	ctx.skipEmptySpace = m_useEmptySpaceSkipping && !(cloudCB.virtualWeather != 0 && m_virtualWeather != nullptr && m_virtualWeather->IsValid());
+}
+
+CloudShadowVolume::BuildParams CloudReferenceRenderer::GetShadowBuildParams(const Context& ctx) const
+{
+	CloudShadowVolume::BuildParams params;
+	XMStoreFloat3(&params.lightDir, Normalize(ctx.lightDir));
+	params.cameraX = ctx.cameraPosition.GetX();
+	params.cameraZ = ctx.cameraPosition.GetZ();
+	params.windOffset = ctx.windOffset;
+	return params;
+}
+
+void CloudReferenceRenderer::UpdateShadowVolume(const CloudPassCB& passCB, const CloudParameterCB& cloudCB, uint32_t maxSlices)
+{
+	assert(m_cloudShape != nullptr && m_erosion != nullptr && m_weather != nullptr);
+
+	Context ctx;
+	InitContext(ctx, passCB, cloudCB, 1, 1);
+	m_densityQuery.SetParameters(cloudCB, passCB.time);
+
+	// the layer is flat in y for SampleCloudDensity, the height fraction only looks at y
+	CloudShadowVolume::Desc desc = { 128, 32, 128, m_shadowVolumeExtent,
+		(float)ctx.sphereCenter.GetY() + ctx.innerRadius, (float)ctx.sphereCenter.GetY() + ctx.outerRadius };
+	const CloudShadowVolume::Desc& current = m_shadowVolume.GetDesc();
+	if (current.width != desc.width || current.halfExtent != desc.halfExtent ||
+		current.layerBottom != desc.layerBottom || current.layerTop != desc.layerTop)
+		m_shadowVolume.Create(desc);
+
+	CloudShadowVolume::BuildParams params = GetShadowBuildParams(ctx);
+	if (!m_shadowVolume.IsBuilding() && m_shadowVolume.NeedsRebuild(params))
+		m_shadowVolume.BeginBuild(params);
+
+	// slices of a build spread over frames see the clouds of their own frame
+	m_shadowVolume.ContinueBuild([this, &ctx](float x, float y, float z)
+	{
+		TileStats stats = {};
+		return SampleCloudDensity(ctx, Vector3(x, y, z), true, 0, stats);
+	}, maxSlices);
+}
+
+bool CloudReferenceRenderer::GetShadowVolumeDepth(const Context& ctx, Vector3 p, float stepSize, float& lightDensity) const
+{
+	float depth;
+	if (!m_shadowVolume.SampleOpticalDepth(p.GetX(), p.GetY(), p.GetZ(), depth))
+		return false;
+
+	if (m_lightMode == kLightShadowVolume)
+	{
+		// only the stretch the six cone steps cover
+		Vector3 q = p + ctx.lightDir * (6.0f * stepSize);
+		float far_depth;
+		if (!m_shadowVolume.SampleOpticalDepth(q.GetX(), q.GetY(), q.GetZ(), far_depth))
+			return false;
+		depth = std::max(depth - far_depth, 0.0f);
+	}
+	lightDensity = depth * ctx.cloud->absorption;
+	return true;
+}
+
+void CloudReferenceRenderer::Render(const CloudPassCB& passCB, const CloudParameterCB& cloudCB, uint32_t width, uint32_t height)
+{
+	assert(m_cloudShape != nullptr && m_erosion != nullptr && m_weather != nullptr);
+	assert(m_transmittance.IsValid());
+	assert(width > 0 && height > 0);
+
+	auto start = std::chrono::high_resolution_clock::now();
+	m_width = width;
+	m_height = height;
+	m_image.assign((size_t)width * height, XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f));
+	m_layers.resize(m_image.size());
+	m_depth.resize(m_image.size());
+
+	Context ctx;
+	InitContext(ctx, passCB, cloudCB, width, height);
+	m_densityQuery.SetParameters(cloudCB, passCB.time);
+
+	if (m_lightMode != kLightConeMarch)
+	{
+		// a reference image wants the volume of exactly this frame
+		UpdateShadowVolume(passCB, cloudCB, UINT_MAX);
+		if (m_shadowVolume.NeedsRebuild(GetShadowBuildParams(ctx)))
+			UpdateShadowVolume(passCB, cloudCB, UINT_MAX);
+	}
+
+	if (ctx.skipEmptySpace)
+	{
+		// only the texels around changed weather values are rebuilt
+		m_emptySpaceMap.Update(&m_weather->GetData(0)->x, m_weather->GetWidth(), m_weather->GetHeight(), 4);
+		m_emptySpaceMap.SetCoverageScale(cloudCB.cloudCoverage);
+		m_emptySpaceMap.SetHeightProfile(m_densityQuery);
+	}
+
+	uint32_t tiles_x = (width + m_tileSize - 1) / m_tileSize;
+	uint32_t tiles_y = (height + m_tileSize - 1) / m_tileSize;
+	uint32_t num_tiles = tiles_x * tiles_y;
+	m_tileStats.resize(num_tiles);
+	for (uint32_t i = 0; i < num_tiles; ++i)
+	{
+		ZeroMemory(&m_tileStats[i], sizeof(TileStats));
+		m_tileStats[i].x = (i % tiles_x) * m_tileSize;
+		m_tileStats[i].y = (i / tiles_x) * m_tileSize;
+	}
+
+	// tiles are handed out one at a time, so expensive tiles (cloud layer near the horizon) balance out
+	std::atomic<uint32_t> next_tile(0);
+	auto worker = [&]()
+	{
+		for (uint32_t tile = next_tile++; tile < num_tiles; tile = next_tile++)
+			RenderTile(ctx, m_tileStats[tile]);
+	};
+	std::vector<std::thread> threads;
+	for (uint32_t i = 1; i < m_numThreads; ++i)
+		threads.emplace_back(worker);
+	worker();
+	for (auto& t : threads)
+		t.join();
+
+	auto end = std::chrono::high_resolution_clock::now();
+	ZeroMemory(&m_totals, sizeof(Totals));
+	m_totals.seconds = std::chrono::duration<double>(end - start).count();
+	m_totals.numThreads = m_numThreads;
+	for (const TileStats& tile : m_tileStats)
+	{
+		m_totals.rays += tile.rays;
+		m_totals.marchSteps += tile.marchSteps;
+		m_totals.densitySamples += tile.densitySamples;
+		m_totals.expensiveSamples += tile.expensiveSamples;
+		m_totals.lightSamples += tile.lightSamples;
+		m_totals.skippedSteps += tile.skippedSteps;
+		m_totals.refinements += tile.refinements;
+		m_totals.slowestTileMilliseconds = std::max(m_totals.slowestTileMilliseconds, tile.milliseconds);
+	}
+}
+
+CloudReferenceRenderer::SkippingReport CloudReferenceRenderer::CompareEmptySpaceSkipping(const CloudPassCB& passCB, const CloudParameterCB& cloudCB, uint32_t width, uint32_t height)
+{
+	SkippingReport report;
+	bool use_skipping = m_useEmptySpaceSkipping;
+	std::vector<XMFLOAT4> reference;
+	for (int i = 0; i < 2; ++i)
+	{
+		m_useEmptySpaceSkipping = i == 1;
+		Render(passCB, cloudCB, width, height);
+		double rays = (double)std::max<uint64_t>(m_totals.rays, 1);
+		report.densitySamplesPerRay[i] = m_totals.densitySamples / rays;
+		report.lightSamplesPerRay[i] = m_totals.lightSamples / rays;
+		report.seconds[i] = m_totals.seconds;
+		if (i == 0)
+			reference = m_image;
+	}
+	m_useEmptySpaceSkipping = use_skipping;
+
+	report.maxError = 0.0f;
+	for (size_t i = 0; i < m_image.size(); ++i)
+	{
+		report.maxError = std::max(report.maxError, std::abs(m_image[i].x - reference[i].x));
+		report.maxError = std::max(report.maxError, std::abs(m_image[i].y - reference[i].y));
+		report.maxError = std::max(report.maxError, std::abs(m_image[i].z - reference[i].z));
+		report.maxError = std::max(report.maxError, std::abs(m_image[i].w - reference[i].w));
+	}
+	return report;
+}
+
+CloudReferenceRenderer::LightingReport CloudReferenceRenderer::CompareShadowVolume(const CloudPassCB& passCB, const CloudParameterCB& cloudCB, uint32_t width, uint32_t height)
+{
+	LightingReport report;
+	LightMode light_mode = m_lightMode;
+
+	m_lightMode = kLightConeMarch;
+	Render(passCB, cloudCB, width, height);
+	std::vector<XMFLOAT4> reference = m_image;
+	report.seconds[0] = m_totals.seconds;
+	report.lightSamplesPerRay[0] = m_totals.lightSamples / (double)std::max<uint64_t>(m_totals.rays, 1);
+
+	// build outside of the timed render
+	m_lightMode = light_mode == kLightConeMarch ? kLightShadowVolume : light_mode;
+	uint32_t num_builds = m_shadowVolume.GetStats().numBuilds;
+	Context ctx;
+	InitContext(ctx, passCB, cloudCB, width, height);
+	while (!m_shadowVolume.IsValid() || m_shadowVolume.IsBuilding() || m_shadowVolume.NeedsRebuild(GetShadowBuildParams(ctx)))
+		UpdateShadowVolume(passCB, cloudCB, UINT_MAX);
+	report.buildMilliseconds = m_shadowVolume.GetStats().numBuilds != num_builds ? m_shadowVolume.GetStats().lastBuildMilliseconds : 0.0;
+
+	Render(passCB, cloudCB, width, height);
+	report.seconds[1] = m_totals.seconds;
+	report.lightSamplesPerRay[1] = m_totals.lightSamples / (double)std::max<uint64_t>(m_totals.rays, 1);
+	m_lightMode = light_mode;
+
+	double sum_sq = 0.0;
+	report.maxError = 0.0f;
+	for (size_t i = 0; i < m_image.size(); ++i)
+	{
+		const float* a = &m_image[i].x;
+		const float* b = &reference[i].x;
+		for (int c = 0; c < 3; ++c)
+		{
+			float diff = std::abs(a[c] - b[c]);
+			sum_sq += (double)diff * diff;
+			report.maxError = std::max(report.maxError, diff);
+		}
+	}
+	report.rmse = (float)std::sqrt(sum_sq / std::max<size_t>(m_image.size() * 3, 1));
+	return report;
+}
+
+CloudReferenceRenderer::UpsampleReport CloudReferenceRenderer::CompareUpsampling(const CloudPassCB& passCB, const CloudParameterCB& cloudCB, uint32_t width, uint32_t height,
+	uint32_t downscale, float depthSigma)
+{
+	assert(downscale > 0);
+	UpsampleReport report = {};
+	const uint32_t low_width = std::max(width / downscale, 1u), low_height = std::max(height / downscale, 1u);
+	width = low_width * downscale;
+	height = low_height * downscale;
+	report.width = width;
+	report.height = height;
+
+	Render(passCB, cloudCB, width, height);
+	report.seconds[0] = m_totals.seconds;
+	const std::vector<XMFLOAT4> reference = m_image;
+	std::vector<float> guide(m_depth.size());
+	std::vector<XMFLOAT4> background(m_depth.size());
+	for (size_t i = 0; i < m_depth.size(); ++i)
+	{
+		guide[i] = m_depth[i].y;
+		background[i] = m_depth[i].y > 0.0f ? XMFLOAT4(0.4851f, 0.5986f, 0.7534f, 0.0f) : reference[i];
+	}
+
+	// a low res pixel centre is the centre of its block at full res
+	Render(passCB, cloudCB, low_width, low_height);
+	report.seconds[1] = m_totals.seconds;
+	const std::vector<XMFLOAT4> low_layers = m_layers;
+	const std::vector<XMFLOAT2> low_depth = m_depth;
+
+	// pixels next to a different guide depth or alphaness
+	std::vector<uint8_t> edge(reference.size(), 0);
+	for (uint32_t y = 0; y < height; ++y)
+	{
+		for (uint32_t x = 0; x < width; ++x)
+		{
+			size_t index = (size_t)y * width + x;
+			const size_t neighbours[2] = { x + 1 < width ? index + 1 : index, y + 1 < height ? index + width : index };
+			for (size_t n : neighbours)
+			{
+				bool guide_edge = (guide[index] > 0.0f) != (guide[n] > 0.0f) ||
+					std::abs(guide[index] - guide[n]) > 0.01f * std::max(guide[index], guide[n]);
+				if (guide_edge || std::abs(reference[index].w - reference[n].w) > 0.5f)
+					edge[index] = edge[n] = 1;
+			}
+		}
+	}
+
+	CloudUpsampleFilter::Params params;
+	params.downscale = downscale;
+	params.jitterX = params.jitterY = 0.5f * downscale;
+	m_width = width;
+	m_height = height;
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		params.depthSigma = pass == 0 ? 0.0f : depthSigma;
+		CloudUpsampleFilter::Upsample(params, low_layers.data(), low_depth.data(), low_width, low_height,
+			guide.data(), background.data(), width, height, m_image.data());
+
+		double sum_sq = 0.0, edge_sum_sq = 0.0;
+		uint32_t num_edge = 0;
+		for (size_t i = 0; i < reference.size(); ++i)
+		{
+			double pixel_sq = 0.0;
+			for (int c = 0; c < 3; ++c)
+			{
+				double diff = (&m_image[i].x)[c] - (&reference[i].x)[c];
+				pixel_sq += diff * diff;
+			}
+			sum_sq += pixel_sq;
+			if (edge[i])
+			{
+				edge_sum_sq += pixel_sq;
+				num_edge++;
+			}
+		}
+		float rmse = (float)std::sqrt(sum_sq / (reference.size() * 3.0));
+		float edge_rmse = num_edge > 0 ? (float)std::sqrt(edge_sum_sq / (num_edge * 3.0)) : 0.0f;
+		if (pass == 0)
+		{
+			report.bilinearRmse = rmse;
+			report.bilinearEdgeRmse = edge_rmse;
+		}
+		else
+		{
+			report.rmse = rmse;
+			report.edgeRmse = edge_rmse;
+		}
+		report.numEdgePixels = num_edge;
+	}
+	return report;
+}
+
+CloudReferenceRenderer::SteppingReport CloudReferenceRenderer::CompareAdaptiveStepping(const CloudPassCB& passCB, const CloudParameterCB& cloudCB,
+	uint32_t width, uint32_t height, uint32_t maxSubsteps, float tolerance /* = 1e-3f */)
+{
+	SteppingReport report = {};
+	auto difference = [this](const std::vector<XMFLOAT4>& reference, float& maxError)
+	{
+		double sum_sq = 0.0;
+		maxError = 0.0f;
+		for (size_t i = 0; i < m_image.size(); ++i)
+		{
+			const float* a = &m_image[i].x;
+			const float* b = &reference[i].x;
+			for (int c = 0; c < 3; ++c)
+			{
+				float diff = std::abs(a[c] - b[c]);
+				sum_sq += (double)diff * diff;
+				maxError = std::max(maxError, diff);
+			}
+		}
+		return (float)std::sqrt(sum_sq / std::max<size_t>(m_image.size() * 3, 1));
+	};
+	auto record = [this, &report](int pass)
+	{
+		double rays = (double)std::max<uint64_t>(m_totals.rays, 1);
+		report.seconds[pass] = m_totals.seconds;
+		report.densitySamplesPerRay[pass] = m_totals.densitySamples / rays;
+		report.expensiveSamplesPerRay[pass] = m_totals.expensiveSamples / rays;
+		report.lightSamplesPerRay[pass] = m_totals.lightSamples / rays;
+	};
+
+	// doubling the substeps until the image stops moving
+	std::vector<XMFLOAT4> reference;
+	report.denseChange = FLT_MAX;
+	for (uint32_t substeps = 1; substeps <= std::max(maxSubsteps, 1u) && report.denseChange > tolerance; substeps *= 2)
+	{
+		m_denseSubsteps = substeps;
+		Render(passCB, cloudCB, width, height);
+		if (!reference.empty())
+		{
+			float max_error;
+			report.denseChange = difference(reference, max_error);
+		}
+		reference = m_image;
+		report.denseSubsteps = substeps;
+		record(0);
+	}
+	m_denseSubsteps = 0;
+
+	for (int pass = 1; pass < 3; ++pass)
+	{
+		CloudParameterCB cloud = cloudCB;
+		cloud.adaptiveMarch = pass == 2 ? 1 : 0;
+		Render(passCB, cloud, width, height);
+		record(pass);
+		if (pass == 2)
+			report.refinementsPerRay = m_totals.refinements / (double)std::max<uint64_t>(m_totals.rays, 1);
+		report.rmse[pass - 1] = difference(reference, report.maxError[pass - 1]);
+	}
+	return report;
+}
+
+bool CloudReferenceRenderer::SaveGolden(const std::wstring& fileName) const
+{
+	if (m_image.empty())
+		return false;
+	std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+	if (!file)
+		return false;
+
+	GoldenFileHeader header = { GoldenFileHeader::kMagic, m_width, m_height, 0 };
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(m_image.data()), m_image.size() * sizeof(XMFLOAT4));
+	return (bool)file;
+}
+
+bool CloudReferenceRenderer::CompareGolden(const std::wstring& fileName, float tolerance, CompareResult* result) const
+{
+	std::ifstream file(fileName, std::ios::binary);
+	if (!file)
+		return false;
+
+	GoldenFileHeader header;
+	file.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if (!file || header.magic != GoldenFileHeader::kMagic || header.width != m_width || header.height != m_height)
+		return false;
+
+	std::vector<XMFLOAT4> golden(m_image.size());
+	file.read(reinterpret_cast<char*>(golden.data()), golden.size() * sizeof(XMFLOAT4));
+	if (!file)
+		return false;
+
+	double sum_sq = 0.0;
+	float max_error = 0.0f;
+	uint32_t num_different = 0;
+	for (size_t i = 0; i < golden.size(); ++i)
+	{
+		const float* a = &m_image[i].x;
+		const float* b = &golden[i].x;
+		float pixel_error = 0.0f;
+		for (int c = 0; c < 4; ++c)
+		{
+			float diff = std::abs(a[c] - b[c]);
+			sum_sq += (double)diff * diff;
+			pixel_error = std::max(pixel_error, diff);
+		}
+		max_error = std::max(max_error, pixel_error);
+		if (pixel_error > tolerance)
+			num_different++;
+	}
+
+	if (result != nullptr)
+	{
+		result->rmse = (float)std::sqrt(sum_sq / (golden.size() * 4.0));
+		result->maxError = max_error;
+		result->numDifferent = num_different;
+	}
+	return num_different == 0;
+}
\ No newline at end of file
@@ -0,0 +1,281 @@
+#pragma once
+#include "stdafx.h"
+#include "CloudParameters.h"
+#include "CloudEmptySpaceMap.h"
+#include "CloudShadowVolume.h"
+#include "CloudDensityQuery.h"
+#include "Atmosphere/Atmosphere.h"
+
+class GpuResource;
+class BlueNoiseGenerator;
+class CloudMiePhase;
+class CloudVirtualWeather;
+class CloudHeightLut;
+
+// CPU copy of a 2D or 3D texture with a box filtered mip chain, sampled like a
+// MIN_MAG_MIP_LINEAR SamplerState at an integer mip level.
+class CloudReferenceTexture
+{
+public:
+	enum AddressMode
+	{
+		kWrap,
+		kClamp
+	};
+
+	CloudReferenceTexture() : m_width(0), m_height(0), m_depth(0) {}
+
+	// rgba is width * height * depth float4 texels, x fastest. numMips = 0 builds the full chain.
+	void Create(uint32_t width, uint32_t height, uint32_t depth, const float* rgba, uint32_t numMips = 0);
+	// Reads back mip 0 of a texture and rebuilds the mips on the CPU. Supports R32G32B32A32_FLOAT,
+	// R16G16B16A16_FLOAT, R8G8B8A8_UNORM(_SRGB), B8G8R8A8_UNORM, R32_FLOAT and R8_UNORM.
+	// False and empty for any other format.
+	bool CreateFromGpu(GpuResource& resource, uint32_t numMips = 0);
+
+	// 0 while empty
+	Vector4 SampleLevel(float u, float v, float w, uint32_t mip, AddressMode mode) const;
+
+	bool IsValid() const { return !m_mips.empty(); }
+	uint32_t GetWidth() const { return m_width; }
+	uint32_t GetHeight() const { return m_height; }
+	uint32_t GetDepth() const { return m_depth; }
+	uint32_t GetNumMips() const { return (uint32_t)m_mips.size(); }
+	const XMFLOAT4* GetData(uint32_t mip = 0) const { return m_mips[mip].texels.data(); }
+
+private:
+	struct Mip
+	{
+		uint32_t width;
+		uint32_t height;
+		uint32_t depth;
+		std::vector<XMFLOAT4> texels;
+	};
+
+	uint32_t m_width;
+	uint32_t m_height;
+	uint32_t m_depth;
+	std::vector<Mip> m_mips;
+};
+
+// Multithreaded CPU port of ComputeCloud_CS (RaymarchCloud, RaymarchLight, SampleCloudDensity).
+// Consumes the same CloudPassCB / CloudParameterCB as the GPU pass, renders 16x16 tiles on a
+// pool of worker threads and records per tile counters. Meant as the reference image for
+// regression checks and for judging raymarch optimizations without a GPU.
+class CloudReferenceRenderer
+{
+public:
+	struct TileStats
+	{
+		uint32_t x;
+		uint32_t y;
+		uint32_t rays;
+		// primary raymarch steps taken before the ray left the layer or got opaque
+		uint64_t marchSteps;
+		uint64_t densitySamples;
+		uint64_t expensiveSamples;
+		uint64_t lightSamples;
+		// steps jumped over by empty space skipping, included in marchSteps
+		uint64_t skippedSteps;
+		// adaptive march: coarse steps that hit density and backed up to fine steps
+		uint64_t refinements;
+		double milliseconds;
+	};
+
+	struct Totals
+	{
+		double seconds;
+		uint32_t numThreads;
+		uint64_t rays;
+		uint64_t marchSteps;
+		uint64_t densitySamples;
+		uint64_t expensiveSamples;
+		uint64_t lightSamples;
+		uint64_t skippedSteps;
+		uint64_t refinements;
+		double slowestTileMilliseconds;
+	};
+
+	struct CompareResult
+	{
+		float rmse;
+		float maxError;
+		uint32_t numDifferent;
+	};
+
+	enum LightMode
+	{
+		// RaymarchLight, six cone samples per step
+		kLightConeMarch,
+		// CloudShadowVolume over the length the cone covers, two fetches
+		kLightShadowVolume,
+		// CloudShadowVolume up to the top of the layer, one fetch
+		kLightShadowVolumeToSun
+	};
+
+	// [0] cone march, [1] shadow volume
+	struct LightingReport
+	{
+		double seconds[2];
+		double lightSamplesPerRay[2];
+		double buildMilliseconds;
+		// rgb difference to the cone march image
+		float rmse;
+		float maxError;
+	};
+
+	// [0] without, [1] with empty space skipping
+	struct SkippingReport
+	{
+		double densitySamplesPerRay[2];
+		double lightSamplesPerRay[2];
+		double seconds[2];
+		// skipping only drops zero density samples, so this should stay 0
+		float maxError;
+	};
+
+	// [0] full resolution, [1] reduced resolution
+	struct UpsampleReport
+	{
+		double seconds[2];
+		uint32_t width;
+		uint32_t height;
+		// rgb difference of the upsampled image to the full resolution one,
+		// all pixels and the pixels on a horizon or cloud silhouette
+		float rmse;
+		float edgeRmse;
+		// the same with CloudUpsampleFilter as a plain bilinear upsample
+		float bilinearRmse;
+		float bilinearEdgeRmse;
+		uint32_t numEdgePixels;
+	};
+
+	// [0] dense uniform steps, [1] uniform steps, [2] adaptive steps
+	struct SteppingReport
+	{
+		double seconds[3];
+		double densitySamplesPerRay[3];
+		double expensiveSamplesPerRay[3];
+		double lightSamplesPerRay[3];
+		double refinementsPerRay;
+		// rgb difference to the dense image, [0] uniform, [1] adaptive
+		float rmse[2];
+		float maxError[2];
+		// steps of the dense image per adaptive fine step, and its rgb rmse to the image with half of them
+		uint32_t denseSubsteps;
+		float denseChange;
+	};
+
+	CloudReferenceRenderer();
+
+	void SetTileSize(uint32_t size) { m_tileSize = size > 0 ? size : 1; }
+	void SetNumThreads(uint32_t numThreads) { m_numThreads = numThreads > 0 ? numThreads : 1; }
+
+	// t0, t1, t2 of VolumetricCloudCommon.hlsli
+	void SetTextures(const CloudReferenceTexture* cloudShape, const CloudReferenceTexture* erosion, const CloudReferenceTexture* weather);
+	// t13 and the atlas of the VirtualWeather path, nullptr keeps the repeating weather map
+	void SetVirtualWeather(const CloudVirtualWeather* virtualWeather);
+	// t14 of the HeightLut path, nullptr keeps GetHeightDensityForCloud
+	void SetHeightLut(const CloudHeightLut* heightLut) { m_densityQuery.SetHeightLut(heightLut); }
+	// t9, nullptr falls back to the n1rand hash like UseBlueNoise = 0
+	void SetBlueNoise(const BlueNoiseGenerator* blueNoise) { m_blueNoise = blueNoise; }
+	// t15, MiePhase while the cloud CB sets mieLut, numericalMieFit otherwise
+	void SetPhase(const CloudMiePhase* phase) { m_phase = phase; }
+	// Builds the transmittance LUT on the CPU exactly like ComputeTransmittance_CS
+	void SetAtmosphere(const Atmosphere::AtmosphereParameters& atmosphere);
+	// SampleCloudDensity of the renderer, holds the CBs of the last Render
+	const CloudDensityQuery& GetDensityQuery() const { return m_densityQuery; }
+	// Jumps over zero coverage areas of the weather map with CloudEmptySpaceMap, not with the virtual weather
+	void SetEmptySpaceSkipping(bool enable) { m_useEmptySpaceSkipping = enable; }
+	bool GetEmptySpaceSkipping() const { return m_useEmptySpaceSkipping; }
+	const CloudEmptySpaceMap& GetEmptySpaceMap() const { return m_emptySpaceMap; }
+	// Steps outside the shadow volume box fall back to the cone march
+	void SetLightMode(LightMode mode) { m_lightMode = mode; }
+	LightMode GetLightMode() const { return m_lightMode; }
+	void SetShadowVolumeExtent(float halfExtent) { m_shadowVolumeExtent = halfExtent; }
+	const CloudShadowVolume& GetShadowVolume() const { return m_shadowVolume; }
+	// Sweeps up to maxSlices slices of the shadow volume and starts a new build once the sun,
+	// wind or camera moved, so the volume can follow the scene a few slices per frame
+	void UpdateShadowVolume(const CloudPassCB& passCB, const CloudParameterCB& cloudCB, uint32_t maxSlices);
+
+	// resolution in passCB is replaced by width / height
+	void Render(const CloudPassCB& passCB, const CloudParameterCB& cloudCB, uint32_t width, uint32_t height);
+	// Renders without and with empty space skipping, the image of the second pass is kept
+	SkippingReport CompareEmptySpaceSkipping(const CloudPassCB& passCB, const CloudParameterCB& cloudCB, uint32_t width, uint32_t height);
+	// Renders with the cone march and with the shadow volume (kLightShadowVolume if the cone march is selected)
+	LightingReport CompareShadowVolume(const CloudPassCB& passCB, const CloudParameterCB& cloudCB, uint32_t width, uint32_t height);
+	// Renders at full resolution and at 1 / downscale, upsamples the second with CloudUpsampleFilter
+	// and keeps the upsampled image. The size is rounded down to a multiple of downscale.
+	UpsampleReport CompareUpsampling(const CloudPassCB& passCB, const CloudParameterCB& cloudCB, uint32_t width, uint32_t height,
+		uint32_t downscale, float depthSigma);
+	// Ground truth with the mip and light step of the adaptive march, every fine step split in 2, 4 ...
+	// up to maxSubsteps until the image changes by less than tolerance rmse, and no early exit. Then
+	// the uniform and the adaptive march with the settings of cloudCB. The image of the adaptive march is kept.
+	SteppingReport CompareAdaptiveStepping(const CloudPassCB& passCB, const CloudParameterCB& cloudCB, uint32_t width, uint32_t height,
+		uint32_t maxSubsteps, float tolerance = 1e-3f);
+
+	uint32_t GetWidth() const { return m_width; }
+	uint32_t GetHeight() const { return m_height; }
+	const std::vector<XMFLOAT4>& GetImage() const { return m_image; }
+	// rgb cloud radiance and transmittance before compositing, like the low res target of the GPU
+	const std::vector<XMFLOAT4>& GetLayers() const { return m_layers; }
+	// x representative cloud depth, y guide depth, see CloudUpsampleFilter
+	const std::vector<XMFLOAT2>& GetDepth() const { return m_depth; }
+	const std::vector<TileStats>& GetTileStats() const { return m_tileStats; }
+	const Totals& GetTotals() const { return m_totals; }
+
+	// Golden images are raw float4 with a small header, so comparisons are lossless
+	bool SaveGolden(const std::wstring& fileName) const;
+	bool CompareGolden(const std::wstring& fileName, float tolerance, CompareResult* result) const;
+
+private:
+	struct Context;
+
+	void InitContext(Context& ctx, const CloudPassCB& passCB, const CloudParameterCB& cloudCB, uint32_t width, uint32_t height) const;
+	CloudShadowVolume::BuildParams GetShadowBuildParams(const Context& ctx) const;
+	bool GetShadowVolumeDepth(const Context& ctx, Vector3 p, float stepSize, float& lightDensity) const;
+	void RenderTile(const Context& ctx, TileStats& stats);
+	Vector4 RenderPixel(const Context& ctx, uint32_t x, uint32_t y, XMFLOAT4& layer, XMFLOAT2& depth, TileStats& stats) const;
+	Vector4 RaymarchCloud(const Context& ctx, uint32_t x, uint32_t y, Vector3 startPos, Vector3 endPos, Vector3 bg, float& cloudDepth, TileStats& stats) const;
+	Vector4 RaymarchCloudAdaptive(const Context& ctx, uint32_t x, uint32_t y, Vector3 startPos, Vector3 dir, float len, float ds,
+		const float scattering[3], Vector3 bg, float& cloudDepth, TileStats& stats) const;
+	Vector4 RaymarchCloudDense(const Context& ctx, uint32_t x, uint32_t y, Vector3 startPos, Vector3 dir, float len, float ds,
+		const float scattering[3], Vector3 bg, float& cloudDepth, TileStats& stats) const;
+	// ds the length of the step, lightDs the one the light march and the sun lookup scale with
+	Vector3 IntegrateStep(const Context& ctx, Vector3 pos, float densitySample, float ds, float lightDs, uint32_t mipLevel,
+		float lightDotEye, const float scattering[3], Vector3 bg, TileStats& stats) const;
+	float RaymarchLight(const Context& ctx, Vector3 o, float stepSize, uint32_t mipLevel, TileStats& stats) const;
+	float SampleCloudDensity(const Context& ctx, Vector3 p, bool expensive, uint32_t lod, TileStats& stats) const;
+	Vector3 GetSunIrradianceAtPoint(Vector3 p, Vector3 sunDirection) const;
+	float GetJitter(const Context& ctx, uint32_t x, uint32_t y) const;
+	float GetHeightFraction(const Context& ctx, Vector3 p) const;
+	bool IsEmptySpace(const Context& ctx, Vector3 p, float heightFraction) const;
+	uint32_t GetEmptySteps(const Context& ctx, Vector3 p, Vector3 step, uint32_t maxSteps) const;
+
+	const CloudReferenceTexture* m_cloudShape;
+	const CloudReferenceTexture* m_erosion;
+	const CloudReferenceTexture* m_weather;
+	const CloudVirtualWeather* m_virtualWeather;
+	const BlueNoiseGenerator* m_blueNoise;
+	const CloudMiePhase* m_phase;
+
+	CloudDensityQuery m_densityQuery;
+	Atmosphere::AtmosphereParameters m_atmosphere;
+	CloudReferenceTexture m_transmittance;
+
+	uint32_t m_tileSize;
+	uint32_t m_numThreads;
+	uint32_t m_width;
+	uint32_t m_height;
+	bool m_useEmptySpaceSkipping;
+	CloudEmptySpaceMap m_emptySpaceMap;
+	LightMode m_lightMode;
+	// > 0 while CompareAdaptiveStepping renders its dense image, fine steps per adaptive step
+	uint32_t m_denseSubsteps;
+	float m_shadowVolumeExtent;
+	CloudShadowVolume m_shadowVolume;
+	std::vector<XMFLOAT4> m_image;
+	std::vector<XMFLOAT4> m_layers;
+	std::vector<XMFLOAT2> m_depth;
+	std::vector<TileStats> m_tileStats;
+	Totals m_totals;
+};
\ No newline at end of file
@@ -0,0 +1,156 @@
+#include "stdafx.h"
+#include "CloudShadowMap.h"
+#include "CloudDensityQuery.h"
+#include <ppl.h>
+#include <atomic>
+#include <chrono>
+
+// VolumetricCloudCommon.hlsli returns 1 below this, a grazing sun is cut off after the width of the map
+static const float kMinLightY = 1e-2f;
+
+CloudShadowMap::CloudShadowMap()
+	: m_texelSize(0.0f),
+	m_nextRow(0),
+	m_buildMilliseconds(0.0)
+{
+	ZeroMemory(&m_desc, sizeof(Desc));
+	ZeroMemory(&m_stats, sizeof(Stats));
+	m_front.valid = false;
+	m_back.valid = false;
+}
+
+void CloudShadowMap::Create(const Desc& desc)
+{
+	assert(desc.size > 1 && desc.halfExtent > 0.0f && desc.layerTop > desc.layerBottom && desc.stepsPerTexel > 0);
+	m_desc = desc;
+	m_texelSize = 2.0f * desc.halfExtent / desc.size;
+
+	size_t size = (size_t)desc.size * desc.size;
+	m_front.valid = false;
+	m_front.opticalDepth.assign(size, 0.0f);
+	m_back.valid = false;
+	m_back.opticalDepth.assign(size, 0.0f);
+	m_nextRow = desc.size;
+}
+
+bool CloudShadowMap::NeedsRebuild(const BuildParams& params) const
+{
+	const Map& current = IsBuilding() ? m_back : m_front;
+	if (!IsBuilding() && !m_front.valid)
+		return true;
+
+	const XMFLOAT3& a = current.params.lightDir;
+	const XMFLOAT3& b = params.lightDir;
+	// about a quarter of a degree
+	if (a.x * b.x + a.y * b.y + a.z * b.z < 0.99999f)
+		return true;
+	if (std::abs(current.params.windOffset - params.windOffset) > 0.5f * m_texelSize)
+		return true;
+	// the centre may wander an eighth of the map before the far side runs short
+	return std::abs(current.params.centerX - params.centerX) > 0.125f * m_desc.halfExtent ||
+		std::abs(current.params.centerZ - params.centerZ) > 0.125f * m_desc.halfExtent;
+}
+
+void CloudShadowMap::BeginBuild(const BuildParams& params)
+{
+	assert(!m_back.opticalDepth.empty());
+	m_back.params = params;
+	// snap to the texel grid, so a small camera move doesn't resample everything
+	m_back.originX = std::floor(params.centerX / m_texelSize) * m_texelSize - m_desc.halfExtent;
+	m_back.originZ = std::floor(params.centerZ / m_texelSize) * m_texelSize - m_desc.halfExtent;
+	m_back.valid = false;
+	m_nextRow = 0;
+	m_buildMilliseconds = 0.0;
+}
+
+bool CloudShadowMap::ContinueBuild(const CloudDensityQuery& query, uint32_t maxRows)
+{
+	if (!IsBuilding())
+		return false;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	const XMFLOAT3& l = m_back.params.lightDir;
+	// only through the heights the height profile puts density at, the rest of the layer adds 0
+	float bottom, top;
+	query.GetDensityBounds(bottom, top);
+	float t_begin = 0.0f, t_end = 2.0f * m_desc.halfExtent;
+	if (l.y > kMinLightY)
+	{
+		t_begin = std::min(std::max(bottom - m_desc.layerBottom, 0.0f) / l.y, t_end);
+		t_end = std::max(std::min(t_end, (std::min(top, m_desc.layerTop) - m_desc.layerBottom) / l.y), t_begin);
+	}
+	const uint32_t size = m_desc.size;
+	const uint32_t end_row = std::min(m_nextRow + maxRows, size);
+
+	concurrency::parallel_for(m_nextRow, end_row, [&](uint32_t zi)
+	{
+		// one segment per texel of the row, the query batches the samples along each
+		std::vector<CloudDensityQuery::Segment> segments(size);
+		float z = m_back.originZ + (zi + 0.5f) * m_texelSize;
+		for (uint32_t xi = 0; xi < size; ++xi)
+		{
+			float x = m_back.originX + (xi + 0.5f) * m_texelSize;
+			segments[xi].start = XMFLOAT3(x + l.x * t_begin, m_desc.layerBottom + l.y * t_begin, z + l.z * t_begin);
+			segments[xi].end = XMFLOAT3(x + l.x * t_end, m_desc.layerBottom + l.y * t_end, z + l.z * t_end);
+		}
+		// the erosion only chips at the edges, far below a texel
+		query.OpticalDepth(segments.data(), size, m_desc.stepsPerTexel, &m_back.opticalDepth[(size_t)zi * size], false);
+	});
+
+	m_stats.densitySamples += (uint64_t)(end_row - m_nextRow) * size * m_desc.stepsPerTexel;
+	m_nextRow = end_row;
+	auto end = std::chrono::high_resolution_clock::now();
+	m_buildMilliseconds += std::chrono::duration<double, std::milli>(end - start).count();
+
+	if (m_nextRow < size)
+		return false;
+
+	m_back.valid = true;
+	std::swap(m_front, m_back);
+	m_back.valid = false;
+	m_stats.lastBuildMilliseconds = m_buildMilliseconds;
+	m_stats.numBuilds++;
+	return true;
+}
+
+float CloudShadowMap::SampleTransmittance(float x, float y, float z) const
+{
+	const XMFLOAT3& l = m_front.params.lightDir;
+	if (!m_front.valid || l.y < kMinLightY)
+		return 1.0f;
+
+	// SampleCloudShadow of the shader, bilinear between texel centres
+	float t = std::max(m_desc.layerBottom - y, 0.0f) / l.y;
+	float fx = (x + l.x * t - m_front.originX) / m_texelSize - 0.5f;
+	float fz = (z + l.z * t - m_front.originZ) / m_texelSize - 0.5f;
+	const float last = (float)(m_desc.size - 1);
+	if (fx < -0.5f || fz < -0.5f || fx > last + 0.5f || fz > last + 0.5f)
+		return 1.0f;
+
+	fx = std::min(std::max(fx, 0.0f), last);
+	fz = std::min(std::max(fz, 0.0f), last);
+	uint32_t x0 = std::min((uint32_t)fx, m_desc.size - 2);
+	uint32_t z0 = std::min((uint32_t)fz, m_desc.size - 2);
+	float tx = fx - x0, tz = fz - z0;
+	const float* row0 = &m_front.opticalDepth[(size_t)z0 * m_desc.size];
+	const float* row1 = row0 + m_desc.size;
+	float a = row0[x0] + (row0[x0 + 1] - row0[x0]) * tx;
+	float b = row1[x0] + (row1[x0 + 1] - row1[x0]) * tx;
+	return std::exp(-(a + (b - a) * tz));
+}
+
+std::vector<CloudShadowMap::Stats> CloudShadowMap::MeasureBuild(const CloudDensityQuery& query, const Desc& desc, const BuildParams& params, const std::vector<uint32_t>& sizes)
+{
+	std::vector<Stats> stats;
+	for (uint32_t size : sizes)
+	{
+		Desc sized = desc;
+		sized.size = size;
+		CloudShadowMap map;
+		map.Create(sized);
+		map.BeginBuild(params);
+		map.ContinueBuild(query, size);
+		stats.push_back(map.GetStats());
+	}
+	return stats;
+}
\ No newline at end of file
@@ -0,0 +1,92 @@
+#pragma once
+#include "stdafx.h"
+
+class CloudDensityQuery;
+
+// Optical depth of the whole cloud layer toward the sun, seen from the ground.
+// Texel (i, j) covers a point on the bottom of the layer and stores the integral
+// of the density from there along the sun direction until the top, so anything
+// below the layer (the ground, the air in front of it) slides along the sun onto
+// the bottom plane and reads its shadow with one fetch. The map follows the
+// camera in steps of a texel and is rebuilt a few rows per frame into a back
+// buffer while the previous map stays live, like CloudShadowVolume.
+class CloudShadowMap
+{
+public:
+	struct Desc
+	{
+		uint32_t size;
+		float halfExtent;
+		// world space y of the cloud layer
+		float layerBottom;
+		float layerTop;
+		// midpoint samples through the layer per texel
+		uint32_t stepsPerTexel;
+	};
+
+	struct BuildParams
+	{
+		XMFLOAT3 lightDir;
+		// centre of the map on the bottom plane
+		float centerX;
+		float centerZ;
+		// Time * CloudSpeed, the weather moves with it
+		float windOffset;
+	};
+
+	struct Stats
+	{
+		double lastBuildMilliseconds;
+		uint32_t numBuilds;
+		uint64_t densitySamples;
+	};
+
+	CloudShadowMap();
+
+	void Create(const Desc& desc);
+
+	// True when the sun, the wind or the centre moved far enough from the map being built
+	// (or the live one) to need a new build
+	bool NeedsRebuild(const BuildParams& params) const;
+	void BeginBuild(const BuildParams& params);
+	// Integrates up to maxRows more rows, returns true when the build finished and went live
+	bool ContinueBuild(const CloudDensityQuery& query, uint32_t maxRows);
+	bool IsBuilding() const { return m_nextRow < m_desc.size; }
+
+	// Transmittance of the live map for a point below the layer, 1 off the map
+	float SampleTransmittance(float x, float y, float z) const;
+
+	bool IsValid() const { return m_front.valid; }
+	const Desc& GetDesc() const { return m_desc; }
+	const Stats& GetStats() const { return m_stats; }
+	// size * size optical depths of the live map, row major in z, DensityFactor included
+	const std::vector<float>& GetOpticalDepth() const { return m_front.opticalDepth; }
+	const BuildParams& GetBuildParams() const { return m_front.params; }
+	// world xz of the corner of texel (0, 0)
+	float GetOriginX() const { return m_front.originX; }
+	float GetOriginZ() const { return m_front.originZ; }
+	float GetExtent() const { return 2.0f * m_desc.halfExtent; }
+	float GetBuildProgress() const { return IsBuilding() ? (float)m_nextRow / m_desc.size : 1.0f; }
+
+	// One build at each size from scratch with every row in one go, lastBuildMilliseconds per size
+	static std::vector<Stats> MeasureBuild(const CloudDensityQuery& query, const Desc& desc, const BuildParams& params, const std::vector<uint32_t>& sizes);
+
+private:
+	struct Map
+	{
+		BuildParams params;
+		float originX;
+		float originZ;
+		bool valid;
+		std::vector<float> opticalDepth;
+	};
+
+	Desc m_desc;
+	float m_texelSize;
+	Map m_front;
+	Map m_back;
+	// next row of m_back to integrate, size when idle
+	uint32_t m_nextRow;
+	double m_buildMilliseconds;
+	Stats m_stats;
+};
\ No newline at end of file
@@ -0,0 +1,194 @@
+#include "stdafx.h"
+#include "CloudShadowVolume.h"
+#include <ppl.h>
+#include <atomic>
+#include <chrono>
+
+// below this the sun grazes the layer and the sweep can't step from slice to slice
+static const float kMinLightY = 1e-2f;
+
+CloudShadowVolume::CloudShadowVolume()
+	: m_nextSlice(-1),
+	m_buildMilliseconds(0.0)
+{
+	ZeroMemory(&m_desc, sizeof(Desc));
+	ZeroMemory(&m_stats, sizeof(Stats));
+	m_voxelSize[0] = m_voxelSize[1] = m_voxelSize[2] = 0.0f;
+	m_front.valid = false;
+	m_back.valid = false;
+}
+
+void CloudShadowVolume::Create(const Desc& desc)
+{
+	assert(desc.width > 1 && desc.height > 0 && desc.depth > 1);
+	assert(desc.halfExtent > 0.0f && desc.layerTop > desc.layerBottom);
+	m_desc = desc;
+	m_voxelSize[0] = 2.0f * desc.halfExtent / desc.width;
+	m_voxelSize[1] = (desc.layerTop - desc.layerBottom) / desc.height;
+	m_voxelSize[2] = 2.0f * desc.halfExtent / desc.depth;
+
+	size_t size = (size_t)desc.width * desc.height * desc.depth;
+	m_front.valid = false;
+	m_front.opticalDepth.assign(size, 0.0f);
+	m_back.valid = false;
+	m_back.opticalDepth.assign(size, 0.0f);
+	m_nextSlice = -1;
+}
+
+bool CloudShadowVolume::NeedsRebuild(const BuildParams& params) const
+{
+	const Volume& current = IsBuilding() ? m_back : m_front;
+	if (!IsBuilding() && !m_front.valid)
+		return true;
+
+	const XMFLOAT3& a = current.params.lightDir;
+	const XMFLOAT3& b = params.lightDir;
+	// about a quarter of a degree
+	if (a.x * b.x + a.y * b.y + a.z * b.z < 0.99999f)
+		return true;
+	if (std::abs(current.params.windOffset - params.windOffset) > 0.5f * m_voxelSize[0])
+		return true;
+	// the camera may wander an eighth of the box before the far side runs short
+	return std::abs(current.params.cameraX - params.cameraX) > 0.125f * m_desc.halfExtent ||
+		std::abs(current.params.cameraZ - params.cameraZ) > 0.125f * m_desc.halfExtent;
+}
+
+void CloudShadowVolume::BeginBuild(const BuildParams& params)
+{
+	assert(!m_back.opticalDepth.empty());
+	m_back.params = params;
+	// snap to the voxel grid, so a small camera move doesn't resample everything
+	m_back.originX = std::floor(params.cameraX / m_voxelSize[0]) * m_voxelSize[0] - m_desc.halfExtent;
+	m_back.originZ = std::floor(params.cameraZ / m_voxelSize[2]) * m_voxelSize[2] - m_desc.halfExtent;
+	m_back.valid = false;
+	m_nextSlice = (int)m_desc.height - 1;
+	m_buildMilliseconds = 0.0;
+}
+
+float CloudShadowVolume::IntegrateSegment(const DensityFunc& density, float x, float y, float z, float length, uint64_t& samples) const
+{
+	// midpoint rule, steps no longer than a voxel is tall
+	const XMFLOAT3& l = m_back.params.lightDir;
+	uint32_t n = std::max(1u, (uint32_t)std::ceil(length / m_voxelSize[1]));
+	float dt = length / n;
+	float sum = 0.0f;
+	for (uint32_t i = 0; i < n; ++i)
+	{
+		float t = (i + 0.5f) * dt;
+		sum += density(x + l.x * t, y + l.y * t, z + l.z * t);
+	}
+	samples += n;
+	return sum * dt;
+}
+
+float CloudShadowVolume::IntegrateToTop(const DensityFunc& density, float x, float y, float z, uint64_t& samples) const
+{
+	// a grazing sun is cut off after the width of the box
+	const XMFLOAT3& l = m_back.params.lightDir;
+	float length = 2.0f * m_desc.halfExtent;
+	if (l.y > 0.0f)
+		length = std::min(length, std::max(m_desc.layerTop - y, 0.0f) / l.y);
+	return IntegrateSegment(density, x, y, z, length, samples);
+}
+
+float CloudShadowVolume::SampleSlice(const Volume& volume, uint32_t slice, float x, float z, bool& inside) const
+{
+	// bilinear between voxel centres
+	float fx = (x - volume.originX) / m_voxelSize[0] - 0.5f;
+	float fz = (z - volume.originZ) / m_voxelSize[2] - 0.5f;
+	inside = fx >= 0.0f && fz >= 0.0f && fx <= (float)(m_desc.width - 1) && fz <= (float)(m_desc.depth - 1);
+	if (!inside)
+		return 0.0f;
+
+	uint32_t x0 = std::min((uint32_t)fx, m_desc.width - 2);
+	uint32_t z0 = std::min((uint32_t)fz, m_desc.depth - 2);
+	float tx = fx - x0, tz = fz - z0;
+	const float* row0 = &volume.opticalDepth[((size_t)z0 * m_desc.height + slice) * m_desc.width];
+	const float* row1 = &volume.opticalDepth[((size_t)(z0 + 1) * m_desc.height + slice) * m_desc.width];
+	float a = row0[x0] + (row0[x0 + 1] - row0[x0]) * tx;
+	float b = row1[x0] + (row1[x0 + 1] - row1[x0]) * tx;
+	return a + (b - a) * tz;
+}
+
+bool CloudShadowVolume::ContinueBuild(const DensityFunc& density, uint32_t maxSlices)
+{
+	if (!IsBuilding())
+		return false;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	const XMFLOAT3& l = m_back.params.lightDir;
+	std::atomic<uint64_t> total_samples(0);
+
+	for (uint32_t n = 0; n < maxSlices && m_nextSlice >= 0; ++n, --m_nextSlice)
+	{
+		const uint32_t slice = (uint32_t)m_nextSlice;
+		const float y = m_desc.layerBottom + (slice + 0.5f) * m_voxelSize[1];
+		const bool top_slice = slice == m_desc.height - 1;
+
+		concurrency::parallel_for(0u, m_desc.depth, [&](uint32_t zi)
+		{
+			uint64_t samples = 0;
+			float z = m_back.originZ + (zi + 0.5f) * m_voxelSize[2];
+			float* row = &m_back.opticalDepth[((size_t)zi * m_desc.height + slice) * m_desc.width];
+			for (uint32_t xi = 0; xi < m_desc.width; ++xi)
+			{
+				float x = m_back.originX + (xi + 0.5f) * m_voxelSize[0];
+				if (top_slice || l.y < kMinLightY)
+				{
+					row[xi] = IntegrateToTop(density, x, y, z, samples);
+					continue;
+				}
+
+				// integrate up to the plane of the slice above and reuse its depth from there
+				float length = m_voxelSize[1] / l.y;
+				float depth = IntegrateSegment(density, x, y, z, length, samples);
+				float ux = x + l.x * length, uz = z + l.z * length;
+				bool inside;
+				float above = SampleSlice(m_back, slice + 1, ux, uz, inside);
+				if (!inside)
+					above = IntegrateToTop(density, ux, y + m_voxelSize[1], uz, samples);
+				row[xi] = depth + above;
+			}
+			total_samples += samples;
+		});
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+	m_buildMilliseconds += std::chrono::duration<double, std::milli>(end - start).count();
+	m_stats.densitySamples += total_samples;
+
+	if (m_nextSlice >= 0)
+		return false;
+
+	m_back.valid = true;
+	std::swap(m_front, m_back);
+	m_back.valid = false;
+	m_stats.lastBuildMilliseconds = m_buildMilliseconds;
+	m_stats.numBuilds++;
+	return true;
+}
+
+bool CloudShadowVolume::SampleOpticalDepth(float x, float y, float z, float& opticalDepth) const
+{
+	if (!m_front.valid)
+		return false;
+	if (y >= m_desc.layerTop)
+	{
+		// nothing above the layer, as long as the point is over the box
+		opticalDepth = 0.0f;
+		return x >= m_front.originX && z >= m_front.originZ &&
+			x <= m_front.originX + 2.0f * m_desc.halfExtent && z <= m_front.originZ + 2.0f * m_desc.halfExtent;
+	}
+
+	float fy = (y - m_desc.layerBottom) / m_voxelSize[1] - 0.5f;
+	fy = std::min(std::max(fy, 0.0f), (float)(m_desc.height - 1));
+	uint32_t y0 = std::min((uint32_t)fy, m_desc.height - 1);
+	uint32_t y1 = std::min(y0 + 1, m_desc.height - 1);
+	bool inside;
+	float a = SampleSlice(m_front, y0, x, z, inside);
+	if (!inside)
+		return false;
+	float b = SampleSlice(m_front, y1, x, z, inside);
+	opticalDepth = a + (b - a) * (fy - y0);
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,94 @@
+#pragma once
+#include "stdafx.h"
+#include <functional>
+
+// Optical depth toward the sun over a camera centred box of the cloud layer.
+// Each voxel stores the integral of the cloud density from its centre along the
+// sun direction until the ray leaves the top of the layer, so a raymarch step
+// gets the sun visibility from one fetch and the depth over any segment
+// [p, p + d * L] from two. The volume is swept slice by slice from the top of
+// the layer down, every slice only integrates up to the slice above it, and a
+// build can be spread over several frames while the previous volume stays live.
+class CloudShadowVolume
+{
+public:
+	struct Desc
+	{
+		// x, y (slices through the layer height), z
+		uint32_t width;
+		uint32_t height;
+		uint32_t depth;
+		float halfExtent;
+		// world space y of the cloud layer, the density only depends on y there
+		float layerBottom;
+		float layerTop;
+	};
+
+	struct BuildParams
+	{
+		XMFLOAT3 lightDir;
+		float cameraX;
+		float cameraZ;
+		// Time * CloudSpeed, the weather and erosion move with it
+		float windOffset;
+	};
+
+	struct Stats
+	{
+		double lastBuildMilliseconds;
+		uint32_t numBuilds;
+		uint64_t densitySamples;
+	};
+
+	// density at a world position, must be thread safe
+	typedef std::function<float(float x, float y, float z)> DensityFunc;
+
+	CloudShadowVolume();
+
+	void Create(const Desc& desc);
+
+	// True when the sun, the wind or the camera moved far enough from the volume being built
+	// (or the live one) to need a new build
+	bool NeedsRebuild(const BuildParams& params) const;
+	void BeginBuild(const BuildParams& params);
+	// Sweeps up to maxSlices more slices, returns true when the build finished and went live
+	bool ContinueBuild(const DensityFunc& density, uint32_t maxSlices);
+	bool IsBuilding() const { return m_nextSlice >= 0; }
+
+	// Depth of the live volume, false outside its box. Above the layer the depth is 0.
+	bool SampleOpticalDepth(float x, float y, float z, float& opticalDepth) const;
+
+	bool IsValid() const { return m_front.valid; }
+	const Desc& GetDesc() const { return m_desc; }
+	const Stats& GetStats() const { return m_stats; }
+	// The live volume, x fastest, then the slices, then z, the layout of a Texture3D
+	const std::vector<float>& GetOpticalDepth() const { return m_front.opticalDepth; }
+	// world xz of the corner of the live box
+	float GetOriginX() const { return m_front.originX; }
+	float GetOriginZ() const { return m_front.originZ; }
+	// Fraction of the slices of the running build that are done
+	float GetBuildProgress() const { return IsBuilding() ? 1.0f - (float)(m_nextSlice + 1) / m_desc.height : 1.0f; }
+
+private:
+	struct Volume
+	{
+		BuildParams params;
+		float originX;
+		float originZ;
+		bool valid;
+		std::vector<float> opticalDepth;
+	};
+
+	float SampleSlice(const Volume& volume, uint32_t slice, float x, float z, bool& inside) const;
+	float IntegrateSegment(const DensityFunc& density, float x, float y, float z, float length, uint64_t& samples) const;
+	float IntegrateToTop(const DensityFunc& density, float x, float y, float z, uint64_t& samples) const;
+
+	Desc m_desc;
+	float m_voxelSize[3];
+	Volume m_front;
+	Volume m_back;
+	// next slice of m_back to sweep, -1 when idle
+	int m_nextSlice;
+	double m_buildMilliseconds;
+	Stats m_stats;
+};
\ No newline at end of file
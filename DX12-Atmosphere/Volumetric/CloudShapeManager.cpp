@@ -46,6 +46,7 @@ void CloudShapeManager::Initialize()
 	m_erosionPSO.Finalize();
 
 	m_showWindow = true;
+	m_ditherPacking = true;
 
 	m_basicShapeMin = 0.5f;
 	m_basicShapeMax = 2.0f;
@@ -186,6 +187,8 @@ void CloudShapeManager::GenerateBasicCloudShape()
 	ComputeContext& mipContext = ComputeContext::Begin();
 	m_basicShape->GenerateMipMaps(mipContext);
 	mipContext.Finish();
+
+	PackBasicCloudShape();
 }
 
 void CloudShapeManager::GenerateDensityHeightGradient()
@@ -219,6 +222,93 @@ void CloudShapeManager::GenerateErosion()
 	ComputeContext& mipContext = ComputeContext::Begin();
 	m_erosion->GenerateMipMaps(mipContext);
 	mipContext.Finish();
+
+	PackErosion();
+}
+
+void CloudShapeManager::PackBasicCloudShape()
+{
+	PackVolume(*m_basicShape, m_basicShapePacked, L"BasicShapePacked", m_basicShapePackInfo);
+}
+
+void CloudShapeManager::PackErosion()
+{
+	PackVolume(*m_erosion, m_erosionPacked, L"ErosionPacked", m_erosionPackInfo);
+}
+
+void CloudShapeManager::PackVolume(VolumeColorBuffer& src, std::shared_ptr<VolumeColorBuffer>& dst, const std::wstring& name, PackInfo& info)
+{
+	assert(src.GetFormat() == DXGI_FORMAT_R32G32B32A32_FLOAT);
+	uint32_t width = src.GetWidth();
+	uint32_t height = src.GetHeight();
+	uint32_t depth = src.GetDepth();
+
+	// Read back mip 0 and drop the row padding
+	ReadbackBuffer readback;
+	CommandContext& readbackContext = CommandContext::Begin();
+	uint32_t row_pitch = readbackContext.ReadbackTexture(readback, src);
+	readbackContext.Finish(true);
+
+	std::vector<float> voxels((size_t)width * height * depth * 4);
+	const uint8_t* mapped = reinterpret_cast<const uint8_t*>(readback.Map());
+	size_t row_bytes = (size_t)width * 4 * sizeof(float);
+	for (uint32_t z = 0; z < depth; ++z)
+	{
+		for (uint32_t y = 0; y < height; ++y)
+		{
+			const uint8_t* row = mapped + ((size_t)z * height + y) * row_pitch;
+			memcpy(&voxels[((size_t)z * height + y) * width * 4], row, row_bytes);
+		}
+	}
+	readback.Unmap();
+	readback.Destroy();
+
+	std::vector<uint8_t> packed((size_t)width * height * depth * 4);
+	NoisePacker::QuantizeRGBA8(voxels.data(), 4, width, height, depth, m_ditherPacking, packed.data(), &info.unorm8);
+
+	std::vector<uint8_t> blocks(NoisePacker::BC5Size(width, height, depth));
+	NoisePacker::EncodeBC4(voxels.data(), 4, 0, width, height, depth, blocks.data(), &info.bc4);
+	NoisePacker::EncodeBC5(voxels.data(), 4, 1, 2, width, height, depth, blocks.data(), &info.bc5);
+
+	if (dst == nullptr)
+	{
+		dst = std::make_shared<VolumeColorBuffer>();
+		dst->Create(name, width, height, depth, 0, DXGI_FORMAT_R8G8B8A8_UNORM);
+	}
+
+	CommandContext& transitionContext = CommandContext::Begin();
+	transitionContext.TransitionResource(*dst, D3D12_RESOURCE_STATE_COPY_DEST, true);
+	transitionContext.Finish();
+
+	D3D12_SUBRESOURCE_DATA sub_data;
+	sub_data.pData = packed.data();
+	sub_data.RowPitch = (LONG_PTR)width * 4;
+	sub_data.SlicePitch = sub_data.RowPitch * height;
+	CommandContext::InitializeTexture(*dst, 1, &sub_data);
+
+	CommandContext& mipContext = CommandContext::Begin();
+	dst->GenerateMipMaps(mipContext);
+	mipContext.Finish();
+}
+
+void CloudShapeManager::PackInfoUI(const char* label, const PackInfo& info)
+{
+	auto show_report = [](const char* format, const NoisePacker::Report& report)
+	{
+		float rmse = 0.0f, max_error = 0.0f;
+		for (uint32_t c = 0; c < report.numChannels; ++c)
+		{
+			rmse = std::max(rmse, report.rmse[c]);
+			max_error = std::max(max_error, report.maxError[c]);
+		}
+		ImGui::Text("%-6s RMSE %.5f  Max %.4f  %.2f MB -> %.2f MB (%.1fx)", format, rmse, max_error,
+			report.sourceBytes / 1048576.0, report.packedBytes / 1048576.0, report.CompressionRatio());
+	};
+
+	ImGui::Text(label);
+	show_report("RGBA8", info.unorm8);
+	show_report("BC4", info.bc4);
+	show_report("BC5", info.bc5);
 }
 
 void CloudShapeManager::Update()
@@ -306,6 +396,18 @@ void CloudShapeManager::UpdateUI()
 
 	ImGui::Separator();
 
+	// Packed volumes
+	ImGui::Text("Packed Volumes");
+	if (ImGui::Checkbox("Error Diffusion Dither", &m_ditherPacking))
+	{
+		PackBasicCloudShape();
+		PackErosion();
+	}
+	PackInfoUI("Basic Shape (BC4: R, BC5: GB)", m_basicShapePackInfo);
+	PackInfoUI("Erosion (BC4: R, BC5: GB)", m_erosionPackInfo);
+
+	ImGui::Separator();
+
 	// Cloud Density Gradient
 	ImGui::PushItemWidth(125.0f);
 	ImGui::Text("Cloud Density Gradient");
@@ -3,6 +3,7 @@
 #include "D3D12/RootSignature.h"
 #include "D3D12/PipelineState.h"
 #include "D3D12/GpuBuffer.h"
+#include "Noise/NoisePacker.h"
 
 class NoiseGenerator;
 class ColorBuffer;
@@ -21,6 +22,8 @@ public:
 	void GenerateBasicCloudShape();
 	void GenerateDensityHeightGradient();
 	void GenerateErosion();
+	void PackBasicCloudShape();
+	void PackErosion();
 
 	void SetShowWindow(bool val) { m_showWindow = val; }
 	void SetShowNoiseGeneratorWindow(bool val);
@@ -28,6 +31,8 @@ public:
 	VolumeColorBuffer* GetBasicCloudShape() const { return m_basicShape.get(); }
 	VolumeColorBuffer* GetPerlinNoise() const { return m_perlinNoise.get(); }
 	VolumeColorBuffer* GetErosion() const { return m_erosion.get(); }
+	VolumeColorBuffer* GetPackedBasicCloudShape() const { return m_basicShapePacked.get(); }
+	VolumeColorBuffer* GetPackedErosion() const { return m_erosionPacked.get(); }
 
 	float GetAltitudeMin() const { return m_cloudMin; }
 	float GetAltitudeMax() const { return m_cloudMax; }
@@ -35,6 +40,17 @@ public:
 
 	NoiseGenerator* GetNoiseGenerator() { return m_noiseGenerator.get(); }
 
+private:
+	struct PackInfo
+	{
+		NoisePacker::Report unorm8;
+		NoisePacker::Report bc4;
+		NoisePacker::Report bc5;
+	};
+
+	void PackVolume(VolumeColorBuffer& src, std::shared_ptr<VolumeColorBuffer>& dst, const std::wstring& name, PackInfo& info);
+	void PackInfoUI(const char* label, const PackInfo& info);
+
 private:
 	RootSignature m_basicShapeRS;
 	RootSignature m_gradientRS;
@@ -58,6 +74,13 @@ private:
 	std::shared_ptr<VolumeColorBuffer> m_worleyFBMHigh32;
 	std::shared_ptr<VolumeColorBuffer> m_erosion;
 
+	// 8 bit copies of the shape volumes, the BC reports are for comparison only
+	std::shared_ptr<VolumeColorBuffer> m_basicShapePacked;
+	std::shared_ptr<VolumeColorBuffer> m_erosionPacked;
+	PackInfo m_basicShapePackInfo;
+	PackInfo m_erosionPackInfo;
+	bool m_ditherPacking;
+
 	float m_cloudMin;
 	float m_cloudMax;
 	std::shared_ptr<ColorBuffer> m_densityHeightGradinet;
@@ -0,0 +1,141 @@
+#include "stdafx.h"
+#include "CloudUpdateScheduler.h"
+#include "Noise/BlueNoiseGenerator.h"
+#include "D3D12/Texture.h"
+#include <numeric>
+
+static float RadicalInverse(uint32_t i, uint32_t base)
+{
+	float inv_base = 1.0f / base;
+	float f = inv_base;
+	float r = 0.0f;
+	for (; i > 0; i /= base, f *= inv_base)
+		r += f * (i % base);
+	return r;
+}
+
+CloudUpdateScheduler::CloudUpdateScheduler()
+	: m_pattern(kPatternBayer),
+	m_size(0),
+	m_rayBudget(1.0f / 16.0f),
+	m_windowStart(0),
+	m_lastForcedRays(0)
+{
+}
+
+void CloudUpdateScheduler::Create(Pattern pattern, uint32_t size, uint64_t seed)
+{
+	assert(size >= 2 && size <= 16 && (size & (size - 1)) == 0);
+	m_pattern = pattern;
+	m_size = size;
+	m_ranks.assign(size * size, 0);
+	switch (pattern)
+	{
+	case kPatternHalton:
+		BuildHalton();
+		break;
+	case kPatternBlueNoise:
+		BuildBlueNoise(seed);
+		break;
+	default:
+		BuildBayer();
+		break;
+	}
+	Reset();
+}
+
+void CloudUpdateScheduler::Reset()
+{
+	m_windowStart = 0;
+	m_lastForcedRays = 0;
+}
+
+void CloudUpdateScheduler::BuildBayer()
+{
+	// the lowest bits of the position are the highest of the rank, consecutive ranks land far apart
+	uint32_t bits = 0;
+	while ((1u << bits) < m_size)
+		++bits;
+	for (uint32_t y = 0; y < m_size; ++y)
+	{
+		for (uint32_t x = 0; x < m_size; ++x)
+		{
+			uint32_t rank = 0;
+			for (uint32_t b = 0; b < bits; ++b)
+			{
+				uint32_t xb = (x >> b) & 1, yb = (y >> b) & 1;
+				rank |= (((xb ^ yb) << 1) | yb) << (2 * (bits - 1 - b));
+			}
+			m_ranks[y * m_size + x] = (uint16_t)rank;
+		}
+	}
+}
+
+void CloudUpdateScheduler::BuildHalton()
+{
+	// walk the (2, 3) sequence and rank the cells in the order it first visits them
+	const uint32_t count = m_size * m_size;
+	std::vector<uint8_t> taken(count, 0);
+	uint32_t rank = 0;
+	for (uint32_t i = 1; rank < count && i < count * 64; ++i)
+	{
+		uint32_t x = std::min((uint32_t)(RadicalInverse(i, 2) * m_size), m_size - 1);
+		uint32_t y = std::min((uint32_t)(RadicalInverse(i, 3) * m_size), m_size - 1);
+		if (taken[y * m_size + x])
+			continue;
+		taken[y * m_size + x] = 1;
+		m_ranks[y * m_size + x] = (uint16_t)rank++;
+	}
+	// the base 3 side doesn't line up with a power of two grid, a few cells may be left over
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		if (!taken[i])
+			m_ranks[i] = (uint16_t)rank++;
+	}
+}
+
+void CloudUpdateScheduler::BuildBlueNoise(uint64_t seed)
+{
+	// void-and-cluster needs a 4x4 torus, a 2x2 tile has a single blue noise order anyway
+	if (m_size < 4)
+	{
+		BuildBayer();
+		return;
+	}
+
+	BlueNoiseGenerator generator;
+	generator.Generate(m_size, 1, seed);
+	const auto& values = generator.GetValues();
+	std::vector<uint32_t> order(m_size * m_size);
+	std::iota(order.begin(), order.end(), 0);
+	std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return values[a] < values[b]; });
+	for (uint32_t i = 0; i < (uint32_t)order.size(); ++i)
+		m_ranks[order[i]] = (uint16_t)i;
+}
+
+CloudUpdateScheduler::Frame CloudUpdateScheduler::BeginFrame(uint32_t numPixels)
+{
+	assert(m_size > 0);
+	const uint32_t period = GetPeriod();
+	float rays_per_rank = std::max((float)numPixels / period, 1.0f);
+	float rays = m_rayBudget * numPixels - (float)m_lastForcedRays;
+	uint32_t count = (uint32_t)std::max(std::floor(rays / rays_per_rank + 0.5f), 1.0f);
+
+	Frame frame;
+	frame.windowStart = m_windowStart;
+	frame.windowCount = std::min(count, period);
+	m_windowStart = (m_windowStart + frame.windowCount) % period;
+	return frame;
+}
+
+bool CloudUpdateScheduler::IsScheduled(uint32_t x, uint32_t y, const Frame& frame) const
+{
+	const uint32_t period = GetPeriod();
+	return (GetRank(x, y) + period - frame.windowStart) % period < frame.windowCount;
+}
+
+void CloudUpdateScheduler::CreateTexture(Texture2D& texture) const
+{
+	assert(!m_ranks.empty());
+	texture.Create(m_size, m_size, DXGI_FORMAT_R16_UINT, m_ranks.data());
+}
\ No newline at end of file
@@ -0,0 +1,67 @@
+#pragma once
+#include "stdafx.h"
+
+class Texture2D;
+
+// Decides which pixels of the temporal cloud pass raymarch in a frame. Every
+// pixel gets the rank of its position in a size x size tile, the pattern picks
+// the order of the ranks. A frame updates the ranks in a window that slides
+// around the tile, the window length comes from the ray budget, so with a
+// budget of 1 / (size * size) every pixel is raymarched once per size * size
+// frames. Pixels the shader has to raymarch anyway (no usable history) are taken
+// off the budget of the next frame once they are reported back with EndFrame.
+class CloudUpdateScheduler
+{
+public:
+	enum Pattern
+	{
+		kPatternBayer,
+		kPatternHalton,
+		kPatternBlueNoise,
+		kNumPatterns
+	};
+
+	struct Frame
+	{
+		uint32_t windowStart;
+		uint32_t windowCount;
+	};
+
+	CloudUpdateScheduler();
+
+	// size is a power of two in [2, 16]
+	void Create(Pattern pattern, uint32_t size, uint64_t seed);
+	// Rays per frame as a fraction of the pixels, never less than one rank of the tile
+	void SetRayBudget(float fraction) { m_rayBudget = fraction; }
+	void Reset();
+
+	Frame BeginFrame(uint32_t numPixels);
+	// Pixels raymarched on top of the window in the last frame that finished, a GPU
+	// readback may report them a few frames late
+	void EndFrame(uint32_t forcedRays) { m_lastForcedRays = forcedRays; }
+
+	bool IsScheduled(uint32_t x, uint32_t y, const Frame& frame) const;
+	uint32_t GetRank(uint32_t x, uint32_t y) const { return m_ranks[(y % m_size) * m_size + x % m_size]; }
+
+	// R16_UINT size x size texture of the ranks
+	void CreateTexture(Texture2D& texture) const;
+
+	Pattern GetPattern() const { return m_pattern; }
+	uint32_t GetSize() const { return m_size; }
+	uint32_t GetPeriod() const { return m_size * m_size; }
+	float GetRayBudget() const { return m_rayBudget; }
+	const std::vector<uint16_t>& GetRanks() const { return m_ranks; }
+
+private:
+	void BuildBayer();
+	void BuildHalton();
+	void BuildBlueNoise(uint64_t seed);
+
+	Pattern m_pattern;
+	uint32_t m_size;
+	std::vector<uint16_t> m_ranks;
+
+	float m_rayBudget;
+	uint32_t m_windowStart;
+	uint32_t m_lastForcedRays;
+};
\ No newline at end of file
@@ -0,0 +1,203 @@
+#include "stdafx.h"
+#include "CloudUpdateSimulation.h"
+#include <ppl.h>
+#include <chrono>
+
+struct SimCamera
+{
+	float sinYaw, cosYaw;
+	float sinPitch, cosPitch;
+};
+
+static SimCamera MakeSimCamera(const CloudUpdateSimulation::CameraKey& key)
+{
+	SimCamera camera;
+	camera.sinYaw = std::sin(key.yaw);
+	camera.cosYaw = std::cos(key.yaw);
+	camera.sinPitch = std::sin(key.pitch);
+	camera.cosPitch = std::cos(key.pitch);
+	return camera;
+}
+
+// view space (+z forward, +y up) to world, pitch about x then yaw about y
+static void ViewToWorld(const SimCamera& c, const float v[3], float w[3])
+{
+	float y = v[1] * c.cosPitch + v[2] * c.sinPitch;
+	float z = -v[1] * c.sinPitch + v[2] * c.cosPitch;
+	w[0] = v[0] * c.cosYaw + z * c.sinYaw;
+	w[1] = y;
+	w[2] = -v[0] * c.sinYaw + z * c.cosYaw;
+}
+
+static void WorldToView(const SimCamera& c, const float w[3], float v[3])
+{
+	float x = w[0] * c.cosYaw - w[2] * c.sinYaw;
+	float z = w[0] * c.sinYaw + w[2] * c.cosYaw;
+	v[0] = x;
+	v[1] = w[1] * c.cosPitch - z * c.sinPitch;
+	v[2] = w[1] * c.sinPitch + z * c.cosPitch;
+}
+
+// Stand in for a raymarch: two octaves of clouds on a plane above the camera, drifting with the frame
+static float EvaluateSky(const float dir[3], uint32_t frame)
+{
+	const float horizon = 0.3f;
+	if (dir[1] <= 0.02f)
+		return horizon;
+	float u = dir[0] / dir[1] + 0.01f * frame;
+	float v = dir[2] / dir[1];
+	float cloud = 0.5f + 0.3f * std::sin(2.1f * u + 1.3f) * std::sin(1.7f * v) +
+		0.2f * std::sin(7.3f * u - 3.1f * v) * std::sin(5.9f * v + 0.7f * u);
+	float fade = std::min(dir[1] * 4.0f, 1.0f);
+	return horizon + (cloud - horizon) * fade;
+}
+
+std::vector<CloudUpdateSimulation::CameraKey> CloudUpdateSimulation::MakeCameraPath(uint32_t numFrames, float yawPerFrame, float pitchAmplitude)
+{
+	std::vector<CameraKey> path(numFrames);
+	float yaw = 0.0f;
+	for (uint32_t i = 0; i < numFrames; ++i)
+	{
+		bool whip = i >= numFrames / 3 && i < numFrames / 3 + numFrames / 3;
+		yaw += whip && i % 8 < 2 ? 10.0f * yawPerFrame : yawPerFrame;
+		path[i].yaw = yaw;
+		path[i].pitch = 0.35f + pitchAmplitude * std::sin(i * 0.05f);
+	}
+	return path;
+}
+
+CloudUpdateSimulation::Report CloudUpdateSimulation::Run(const Desc& desc, const CloudUpdateScheduler& scheduler, const std::vector<CameraKey>& path)
+{
+	assert(desc.width > 1 && desc.height > 1 && !path.empty());
+	auto start = std::chrono::high_resolution_clock::now();
+
+	CloudUpdateScheduler schedule = scheduler;
+	schedule.Reset();
+
+	const uint32_t width = desc.width, height = desc.height;
+	const float tan_half_y = std::tan(0.5f * desc.fovY);
+	const float tan_half_x = tan_half_y * width / height;
+	const size_t count = (size_t)width * height;
+	std::vector<float> value(count), lag(count), prev_value(count), prev_lag(count);
+
+	struct RowStats
+	{
+		uint32_t scheduled;
+		uint32_t forced;
+		double lagSum;
+		float lagMax;
+		double errorSum;
+	};
+	std::vector<RowStats> rows(height);
+
+	Report report = {};
+	for (uint32_t f = 0; f < (uint32_t)path.size(); ++f)
+	{
+		const SimCamera camera = MakeSimCamera(path[f]);
+		const SimCamera prev_camera = MakeSimCamera(path[f > 0 ? f - 1 : 0]);
+		const bool first = f == 0;
+		const CloudUpdateScheduler::Frame frame = schedule.BeginFrame((uint32_t)count);
+
+		concurrency::parallel_for(0u, height, [&](uint32_t y)
+		{
+			RowStats stats = {};
+			for (uint32_t x = 0; x < width; ++x)
+			{
+				// ComputeWorldViewDir of the shader, pixel centres
+				float su = (x + 0.5f) / width, sv = (y + 0.5f) / height;
+				float view[3] = { (su * 2.0f - 1.0f) * tan_half_x, (1.0f - sv * 2.0f) * tan_half_y, 1.0f };
+				float world[3];
+				ViewToWorld(camera, view, world);
+				float inv_length = 1.0f / std::sqrt(world[0] * world[0] + world[1] * world[1] + world[2] * world[2]);
+				world[0] *= inv_length; world[1] *= inv_length; world[2] *= inv_length;
+				const float truth = EvaluateSky(world, f);
+
+				// WorldViewDirToUV with PrevViewProj
+				float prev_view[3];
+				WorldToView(prev_camera, world, prev_view);
+				float pu = -1.0f, pv = -1.0f;
+				if (prev_view[2] > 1e-4f)
+				{
+					pu = prev_view[0] / (prev_view[2] * tan_half_x) * 0.5f + 0.5f;
+					pv = 0.5f - prev_view[1] / (prev_view[2] * tan_half_y) * 0.5f;
+				}
+				bool forced = pu < 0.0f || pu > 1.0f || pv < 0.0f || pv > 1.0f;
+				if (!forced && desc.forceUpdateMotion > 0.0f)
+				{
+					float mx = (pu - su) * width, my = (pv - sv) * height;
+					forced = mx * mx + my * my > desc.forceUpdateMotion * desc.forceUpdateMotion;
+				}
+				bool scheduled = schedule.IsScheduled(x, y, frame);
+
+				size_t index = (size_t)y * width + x;
+				if (first || scheduled || forced)
+				{
+					value[index] = truth;
+					lag[index] = 0.0f;
+					stats.scheduled += scheduled ? 1 : 0;
+					stats.forced += !scheduled ? 1 : 0;
+				}
+				else
+				{
+					// LinearClampSampler
+					float fx = std::min(std::max(pu * width - 0.5f, 0.0f), (float)(width - 1));
+					float fy = std::min(std::max(pv * height - 0.5f, 0.0f), (float)(height - 1));
+					uint32_t x0 = std::min((uint32_t)fx, width - 2), y0 = std::min((uint32_t)fy, height - 2);
+					float tx = fx - x0, ty = fy - y0;
+					size_t i00 = (size_t)y0 * width + x0, i10 = i00 + 1, i01 = i00 + width, i11 = i01 + 1;
+					float w00 = (1.0f - tx) * (1.0f - ty), w10 = tx * (1.0f - ty), w01 = (1.0f - tx) * ty, w11 = tx * ty;
+					value[index] = prev_value[i00] * w00 + prev_value[i10] * w10 + prev_value[i01] * w01 + prev_value[i11] * w11;
+					lag[index] = prev_lag[i00] * w00 + prev_lag[i10] * w10 + prev_lag[i01] * w01 + prev_lag[i11] * w11 + 1.0f;
+				}
+				float error = value[index] - truth;
+				stats.errorSum += error * error;
+				stats.lagSum += lag[index];
+				stats.lagMax = std::max(stats.lagMax, lag[index]);
+			}
+			rows[y] = stats;
+		});
+
+		FrameStats frame_stats = {};
+		double lag_sum = 0.0, error_sum = 0.0;
+		for (const RowStats& row : rows)
+		{
+			frame_stats.scheduledRays += row.scheduled;
+			frame_stats.forcedRays += row.forced;
+			frame_stats.maxLag = std::max(frame_stats.maxLag, row.lagMax);
+			lag_sum += row.lagSum;
+			error_sum += row.errorSum;
+		}
+		frame_stats.meanLag = (float)(lag_sum / count);
+		frame_stats.rmse = (float)std::sqrt(error_sum / count);
+		schedule.EndFrame(frame_stats.forcedRays);
+		value.swap(prev_value);
+		lag.swap(prev_lag);
+		if (!first)
+			report.frames.push_back(frame_stats);
+	}
+
+	if (!report.frames.empty())
+	{
+		double rays = 0.0, forced = 0.0, lag_sum = 0.0, error_sum = 0.0;
+		for (const FrameStats& frame : report.frames)
+		{
+			uint32_t frame_rays = frame.scheduledRays + frame.forcedRays;
+			rays += frame_rays;
+			forced += frame.forcedRays;
+			lag_sum += frame.meanLag;
+			error_sum += frame.rmse * frame.rmse;
+			report.maxRaysPerFrame = std::max(report.maxRaysPerFrame, (float)frame_rays);
+			report.maxLag = std::max(report.maxLag, frame.maxLag);
+			report.maxRmse = std::max(report.maxRmse, frame.rmse);
+		}
+		const double n = (double)report.frames.size();
+		report.raysPerFrame = (float)(rays / n);
+		report.forcedPerFrame = (float)(forced / n);
+		report.meanLag = (float)(lag_sum / n);
+		report.rmse = (float)std::sqrt(error_sum / n);
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+	report.seconds = std::chrono::duration<double>(end - start).count();
+	return report;
+}
\ No newline at end of file
@@ -0,0 +1,61 @@
+#pragma once
+#include "stdafx.h"
+#include "CloudUpdateScheduler.h"
+
+// Replays a camera path through the temporal cloud pass on the CPU. A pixel
+// either raymarches (here: evaluates an analytic sky with drifting clouds) or
+// takes the bilinear history at its reprojected position, exactly like
+// TemporalCloud_CS, so schedules can be compared without a GPU capture. The
+// camera only rotates, the sky is at infinity as in the shader.
+class CloudUpdateSimulation
+{
+public:
+	struct CameraKey
+	{
+		// radians
+		float yaw;
+		float pitch;
+	};
+
+	struct Desc
+	{
+		uint32_t width;
+		uint32_t height;
+		float fovY;
+		// ForceUpdateMotion of CloudParameterCB, pixels, 0 disables
+		float forceUpdateMotion;
+	};
+
+	struct FrameStats
+	{
+		uint32_t scheduledRays;
+		// off screen history or too much motion
+		uint32_t forcedRays;
+		// frames since the value of a pixel was raymarched, averaged through the bilinear history
+		float meanLag;
+		float maxLag;
+		// against the sky evaluated at every pixel
+		float rmse;
+	};
+
+	struct Report
+	{
+		// frame 0 raymarches everything and isn't part of the stats
+		std::vector<FrameStats> frames;
+		float raysPerFrame;
+		float maxRaysPerFrame;
+		float forcedPerFrame;
+		float meanLag;
+		float maxLag;
+		float rmse;
+		float maxRmse;
+		double seconds;
+	};
+
+	// Steady pan of yawPerFrame with a slow pitch swing, and a whip pan of
+	// ten times the speed through the middle third
+	static std::vector<CameraKey> MakeCameraPath(uint32_t numFrames, float yawPerFrame, float pitchAmplitude);
+
+	// The scheduler is copied, the live one keeps its state
+	static Report Run(const Desc& desc, const CloudUpdateScheduler& scheduler, const std::vector<CameraKey>& path);
+};
\ No newline at end of file
@@ -0,0 +1,73 @@
+#include "stdafx.h"
+#include "CloudUpsampleFilter.h"
+#include <ppl.h>
+
+XMFLOAT4 CloudUpsampleFilter::UpsamplePixel(const Params& params, const XMFLOAT4* lowLayers, const XMFLOAT2* lowDepth, uint32_t lowWidth, uint32_t lowHeight,
+	uint32_t x, uint32_t y, float guide, float& cloudDepth)
+{
+	// low res coordinate where texel k sits at k
+	float px = (x + 0.5f - params.jitterX) / params.downscale;
+	float py = (y + 0.5f - params.jitterY) / params.downscale;
+	float bx = std::floor(px), by = std::floor(py);
+	float fx = px - bx, fy = py - by;
+
+	float layer[4] = {}, bilinear_layer[4] = {};
+	float depth = 0.0f, bilinear_depth = 0.0f, weight_sum = 0.0f;
+	for (uint32_t i = 0; i < 4; ++i)
+	{
+		uint32_t ox = i & 1, oy = i >> 1;
+		int tx = std::min(std::max((int)bx + (int)ox, 0), (int)lowWidth - 1);
+		int ty = std::min(std::max((int)by + (int)oy, 0), (int)lowHeight - 1);
+		const XMFLOAT4& tap_layer = lowLayers[(size_t)ty * lowWidth + tx];
+		const XMFLOAT2& tap_depth = lowDepth[(size_t)ty * lowWidth + tx];
+
+		float w_b = (ox ? fx : 1.0f - fx) * (oy ? fy : 1.0f - fy);
+		float w_d = 1.0f;
+		if (params.depthSigma > 0.0f)
+			w_d = tap_depth.y > 0.0f ? std::exp(-std::abs(tap_depth.y - guide) / (guide * params.depthSigma)) : 0.0f;
+		float w = w_b * w_d;
+
+		const float values[4] = { tap_layer.x, tap_layer.y, tap_layer.z, tap_layer.w };
+		for (uint32_t c = 0; c < 4; ++c)
+		{
+			layer[c] += values[c] * w;
+			bilinear_layer[c] += values[c] * w_b;
+		}
+		depth += tap_depth.x * w;
+		bilinear_depth += tap_depth.x * w_b;
+		weight_sum += w;
+	}
+
+	// every tap disagrees with the guide, nothing better than bilinear
+	if (weight_sum > 1e-4f)
+	{
+		cloudDepth = depth / weight_sum;
+		return XMFLOAT4(layer[0] / weight_sum, layer[1] / weight_sum, layer[2] / weight_sum, layer[3] / weight_sum);
+	}
+	cloudDepth = bilinear_depth;
+	return XMFLOAT4(bilinear_layer[0], bilinear_layer[1], bilinear_layer[2], bilinear_layer[3]);
+}
+
+void CloudUpsampleFilter::Upsample(const Params& params, const XMFLOAT4* lowLayers, const XMFLOAT2* lowDepth, uint32_t lowWidth, uint32_t lowHeight,
+	const float* guide, const XMFLOAT4* background, uint32_t width, uint32_t height, XMFLOAT4* output)
+{
+	assert(params.downscale > 0 && lowWidth > 0 && lowHeight > 0);
+	concurrency::parallel_for(0u, height, [&](uint32_t y)
+	{
+		for (uint32_t x = 0; x < width; ++x)
+		{
+			size_t index = (size_t)y * width + x;
+			const XMFLOAT4& bg = background[index];
+			if (bg.w > 0.0f)
+			{
+				output[index] = XMFLOAT4(bg.x, bg.y, bg.z, 1.0f);
+				continue;
+			}
+
+			float cloud_depth;
+			XMFLOAT4 layer = UpsamplePixel(params, lowLayers, lowDepth, lowWidth, lowHeight, x, y, guide[index], cloud_depth);
+			float alpha = 1.0f - layer.w;
+			output[index] = XMFLOAT4(bg.x * layer.w + layer.x, bg.y * layer.w + layer.y, bg.z * layer.w + layer.z, alpha > 0.2f ? alpha : 0.0f);
+		}
+	});
+}
\ No newline at end of file
@@ -0,0 +1,34 @@
+#pragma once
+#include "stdafx.h"
+
+// CPU port of the spatial part of UpsampleCloud_CS. Low res texel (i, j) was
+// marched through full res pixel coordinate (i, j) * downscale + jitter. A full
+// res pixel blends the 2x2 low res texels around it with bilinear weights times
+// a depth weight: both sides carry a guide depth, the distance to the bottom of
+// the cloud layer along their own ray (0 where the ray hits the ground), and a
+// texel whose guide is off by more than depthSigma in relative terms fades out.
+// That keeps the horizon and the ground from bleeding into each other, the part
+// of the image a reduced resolution raymarch gets worst.
+class CloudUpsampleFilter
+{
+public:
+	struct Params
+	{
+		uint32_t downscale;
+		// full res pixel coordinate of the low res ray inside its block, downscale / 2 is the centre
+		float jitterX;
+		float jitterY;
+		// relative guide depth difference, <= 0 makes it a plain bilinear upsample
+		float depthSigma;
+	};
+
+	// lowLayers: rgb cloud radiance, a transmittance. lowDepth: x cloud depth, y guide depth.
+	// guide and background are full res, background.w = 1 marks opaque pixels that are copied as is.
+	// output.w is the cloud alphaness, Threshold(1 - transmittance, 0.2).
+	static void Upsample(const Params& params, const XMFLOAT4* lowLayers, const XMFLOAT2* lowDepth, uint32_t lowWidth, uint32_t lowHeight,
+		const float* guide, const XMFLOAT4* background, uint32_t width, uint32_t height, XMFLOAT4* output);
+
+	// Filtered layer of one full res pixel, cloudDepth is what the shader reprojects the history with
+	static XMFLOAT4 UpsamplePixel(const Params& params, const XMFLOAT4* lowLayers, const XMFLOAT2* lowDepth, uint32_t lowWidth, uint32_t lowHeight,
+		uint32_t x, uint32_t y, float guide, float& cloudDepth);
+};
\ No newline at end of file
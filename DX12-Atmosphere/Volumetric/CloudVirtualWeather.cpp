@@ -0,0 +1,300 @@
+#include "stdafx.h"
+#include "CloudVirtualWeather.h"
+#include <algorithm>
+#include <chrono>
+
+CloudVirtualWeather::CloudVirtualWeather()
+	: m_indirectionDirty(false),
+	m_frame(0)
+{
+	ZeroMemory(&m_desc, sizeof(Desc));
+	ZeroMemory(&m_stats, sizeof(Stats));
+}
+
+void CloudVirtualWeather::Create(const Desc& desc, const TileSource& source)
+{
+	assert(desc.tilesX > 0 && desc.tilesZ > 0 && desc.tileSize > 0.0f && desc.tileTexels > 2);
+	assert(desc.atlasSlots > 0 && desc.atlasSlots <= 256 && desc.maxLoadsPerUpdate > 0);
+	m_desc = desc;
+	m_source = source;
+
+	Slot free_slot = { -1, 0, false };
+	m_slots.assign((size_t)desc.atlasSlots * desc.atlasSlots, free_slot);
+	size_t num_tiles = (size_t)desc.tilesX * desc.tilesZ;
+	m_tileSlot.assign(num_tiles, -1);
+	m_requested.assign(num_tiles, 0);
+	m_indirection.assign(num_tiles, 0);
+	m_atlas.assign((size_t)GetAtlasSize() * GetAtlasSize(), 0);
+	m_tileTexels.resize((size_t)desc.tileTexels * desc.tileTexels);
+	m_dirtySlots.clear();
+	m_indirectionDirty = true;
+	m_frame = 0;
+	ResetStats();
+}
+
+void CloudVirtualWeather::ResetStats()
+{
+	ZeroMemory(&m_stats, sizeof(Stats));
+	for (const Slot& slot : m_slots)
+		m_stats.residentTiles += slot.tile >= 0 ? 1 : 0;
+}
+
+void CloudVirtualWeather::Collect(float x, float z, bool needed, std::vector<Request>& requests)
+{
+	// tile space, centres at k + 0.5
+	float tx = (x - m_desc.originX) / m_desc.tileSize;
+	float tz = (z - m_desc.originZ) / m_desc.tileSize;
+	float r = m_desc.residentRadius;
+	int x0 = std::max((int)std::floor(tx - r), 0), x1 = std::min((int)std::floor(tx + r), (int)m_desc.tilesX - 1);
+	int z0 = std::max((int)std::floor(tz - r), 0), z1 = std::min((int)std::floor(tz + r), (int)m_desc.tilesZ - 1);
+	for (int iz = z0; iz <= z1; ++iz)
+	{
+		for (int ix = x0; ix <= x1; ++ix)
+		{
+			float dx = ix + 0.5f - tx, dz = iz + 0.5f - tz;
+			float distance = std::sqrt(dx * dx + dz * dz);
+			if (distance > r)
+				continue;
+			uint32_t tile = (uint32_t)iz * m_desc.tilesX + ix;
+			if (m_requested[tile] == m_frame)
+				continue;
+			m_requested[tile] = m_frame;
+
+			int32_t slot = m_tileSlot[tile];
+			if (needed)
+			{
+				m_stats.requests++;
+				if (slot >= 0)
+				{
+					m_stats.hits++;
+					if (m_slots[slot].prefetched)
+						m_stats.prefetchHits++;
+					m_slots[slot].prefetched = false;
+				}
+			}
+			if (slot >= 0)
+			{
+				m_slots[slot].lastUsed = m_frame;
+				continue;
+			}
+			Request request = { distance, tile, needed };
+			requests.push_back(request);
+		}
+	}
+}
+
+int32_t CloudVirtualWeather::AcquireSlot()
+{
+	// a free slot, or the least recently used one nothing asked for in this update
+	int32_t victim = -1;
+	for (int32_t i = 0; i < (int32_t)m_slots.size(); ++i)
+	{
+		const Slot& slot = m_slots[i];
+		if (slot.tile < 0)
+			return i;
+		if (slot.lastUsed < m_frame && (victim < 0 || slot.lastUsed < m_slots[victim].lastUsed))
+			victim = i;
+	}
+	if (victim >= 0)
+	{
+		Slot& slot = m_slots[victim];
+		m_tileSlot[slot.tile] = -1;
+		m_indirection[slot.tile] = 0;
+		slot.tile = -1;
+		m_stats.tilesEvicted++;
+		m_stats.residentTiles--;
+	}
+	return victim;
+}
+
+void CloudVirtualWeather::LoadTile(uint32_t tile, int32_t slot, bool needed)
+{
+	const uint32_t texels = m_desc.tileTexels, atlas_size = GetAtlasSize();
+	m_source(tile % m_desc.tilesX, tile / m_desc.tilesX, m_tileTexels.data());
+
+	uint32_t slot_x = (uint32_t)slot % m_desc.atlasSlots, slot_y = (uint32_t)slot / m_desc.atlasSlots;
+	for (uint32_t j = 0; j < texels; ++j)
+	{
+		uint32_t* row = &m_atlas[((size_t)slot_y * texels + j) * atlas_size + (size_t)slot_x * texels];
+		memcpy(row, &m_tileTexels[(size_t)j * texels], texels * sizeof(uint32_t));
+	}
+
+	Slot& s = m_slots[slot];
+	s.tile = (int32_t)tile;
+	s.lastUsed = m_frame;
+	s.prefetched = !needed;
+	m_tileSlot[tile] = slot;
+	m_indirection[tile] = slot_x | (slot_y << 8) | (0xFFu << 24);
+	m_dirtySlots.push_back((uint32_t)slot);
+	m_indirectionDirty = true;
+
+	m_stats.tilesLoaded++;
+	m_stats.prefetchLoads += needed ? 0 : 1;
+	m_stats.bytesStreamed += (uint64_t)texels * texels * sizeof(uint32_t);
+	m_stats.residentTiles++;
+}
+
+void CloudVirtualWeather::Update(float x, float z, float velocityX, float velocityZ, float deltaTime)
+{
+	assert(IsValid());
+	auto start = std::chrono::high_resolution_clock::now();
+	++m_frame;
+	m_stats.seconds += deltaTime;
+
+	std::vector<Request> requests;
+	Collect(x, z, true, requests);
+	size_t num_needed = requests.size();
+	if (m_desc.prefetchSeconds > 0.0f && (velocityX != 0.0f || velocityZ != 0.0f))
+		Collect(x + velocityX * m_desc.prefetchSeconds, z + velocityZ * m_desc.prefetchSeconds, false, requests);
+
+	// what is needed now nearest first, then the prefetches nearest to where the camera goes
+	auto nearer = [](const Request& a, const Request& b) { return a.distance < b.distance; };
+	std::sort(requests.begin(), requests.begin() + num_needed, nearer);
+	std::sort(requests.begin() + num_needed, requests.end(), nearer);
+
+	uint32_t loads = 0, loaded_needed = 0;
+	for (const Request& request : requests)
+	{
+		if (loads == m_desc.maxLoadsPerUpdate)
+			break;
+		int32_t slot = AcquireSlot();
+		// every slot holds a tile of this update, the atlas is too small for the radius
+		if (slot < 0)
+			break;
+		LoadTile(request.tile, slot, request.needed);
+		loaded_needed += request.needed ? 1 : 0;
+		++loads;
+	}
+
+	m_stats.missingTiles = (uint32_t)num_needed - loaded_needed;
+	m_stats.maxMissingTiles = std::max(m_stats.maxMissingTiles, m_stats.missingTiles);
+	auto end = std::chrono::high_resolution_clock::now();
+	m_stats.loadMilliseconds += std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+std::vector<uint32_t> CloudVirtualWeather::TakeDirtySlots()
+{
+	// a slot can be loaded twice before an upload
+	std::sort(m_dirtySlots.begin(), m_dirtySlots.end());
+	m_dirtySlots.erase(std::unique(m_dirtySlots.begin(), m_dirtySlots.end()), m_dirtySlots.end());
+	std::vector<uint32_t> slots;
+	slots.swap(m_dirtySlots);
+	return slots;
+}
+
+bool CloudVirtualWeather::TakeIndirectionDirty()
+{
+	bool dirty = m_indirectionDirty;
+	m_indirectionDirty = false;
+	return dirty;
+}
+
+XMFLOAT4 CloudVirtualWeather::Sample(float x, float z) const
+{
+	float tile_x = (x - m_desc.originX) / m_desc.tileSize, tile_z = (z - m_desc.originZ) / m_desc.tileSize;
+	float floor_x = std::floor(tile_x), floor_z = std::floor(tile_z);
+	if (floor_x < 0.0f || floor_z < 0.0f || floor_x >= (float)m_desc.tilesX || floor_z >= (float)m_desc.tilesZ)
+		return XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+	int32_t slot = m_tileSlot[(size_t)floor_z * m_desc.tilesX + (uint32_t)floor_x];
+	if (slot < 0)
+		return XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+
+	// inside the border of the slot, bilinear between texel centres like LinearClampSampler
+	const uint32_t texels = m_desc.tileTexels, atlas_size = GetAtlasSize();
+	float fx = ((uint32_t)slot % m_desc.atlasSlots) * texels + 1.0f + (tile_x - floor_x) * (texels - 2.0f) - 0.5f;
+	float fz = ((uint32_t)slot / m_desc.atlasSlots) * texels + 1.0f + (tile_z - floor_z) * (texels - 2.0f) - 0.5f;
+	uint32_t x0 = (uint32_t)fx, z0 = (uint32_t)fz;
+	uint32_t x1 = std::min(x0 + 1, atlas_size - 1), z1 = std::min(z0 + 1, atlas_size - 1);
+	float tx = fx - x0, tz = fz - z0;
+	const uint32_t corners[4] =
+	{
+		m_atlas[(size_t)z0 * atlas_size + x0], m_atlas[(size_t)z0 * atlas_size + x1],
+		m_atlas[(size_t)z1 * atlas_size + x0], m_atlas[(size_t)z1 * atlas_size + x1]
+	};
+	const float weights[4] = { (1.0f - tx) * (1.0f - tz), tx * (1.0f - tz), (1.0f - tx) * tz, tx * tz };
+	float channels[4] = {};
+	for (uint32_t i = 0; i < 4; ++i)
+	{
+		for (uint32_t c = 0; c < 4; ++c)
+			channels[c] += ((corners[i] >> (c * 8)) & 0xFF) * weights[i];
+	}
+	const float scale = 1.0f / 255.0f;
+	return XMFLOAT4(channels[0] * scale, channels[1] * scale, channels[2] * scale, channels[3] * scale);
+}
+
+CloudVirtualWeather::Stats CloudVirtualWeather::Simulate(const Desc& desc, const TileSource& source, const std::vector<PathKey>& path, float deltaTime)
+{
+	CloudVirtualWeather weather;
+	weather.Create(desc, source);
+	for (size_t i = 0; i < path.size(); ++i)
+	{
+		const PathKey& prev = path[i > 0 ? i - 1 : 0];
+		float vx = (path[i].x - prev.x) / deltaTime, vz = (path[i].z - prev.z) / deltaTime;
+		weather.Update(path[i].x, path[i].z, vx, vz, deltaTime);
+	}
+	return weather.GetStats();
+}
+
+std::vector<CloudVirtualWeather::PathKey> CloudVirtualWeather::MakeFlightPath(uint32_t numKeys, float speed, float deltaTime, float startX, float startZ)
+{
+	// a new heading every 600 keys, turning over the first 120 of them
+	std::vector<PathKey> path(numKeys);
+	float x = startX, z = startZ, heading = 0.0f, target = 0.0f;
+	for (uint32_t i = 0; i < numKeys; ++i)
+	{
+		if (i % 600 == 0)
+			target += (i / 600) % 2 == 0 ? 1.2f : -0.7f;
+		heading += (target - heading) / 120.0f;
+		x += std::cos(heading) * speed * deltaTime;
+		z += std::sin(heading) * speed * deltaTime;
+		path[i].x = x;
+		path[i].z = z;
+	}
+	return path;
+}
+
+bool CloudWeatherTileFile::Write(const std::wstring& fileName, const CloudVirtualWeather::Desc& desc, const CloudVirtualWeather::TileSource& source)
+{
+	std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+	if (!file)
+		return false;
+
+	Header header = { Header::kMagic, desc.tilesX, desc.tilesZ, desc.tileTexels };
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	std::vector<uint32_t> texels((size_t)desc.tileTexels * desc.tileTexels);
+	for (uint32_t z = 0; z < desc.tilesZ && file; ++z)
+	{
+		for (uint32_t x = 0; x < desc.tilesX; ++x)
+		{
+			source(x, z, texels.data());
+			file.write(reinterpret_cast<const char*>(texels.data()), texels.size() * sizeof(uint32_t));
+		}
+	}
+	return (bool)file;
+}
+
+bool CloudWeatherTileFile::Open(const std::wstring& fileName)
+{
+	m_file.close();
+	m_file.clear();
+	m_file.open(fileName, std::ios::binary);
+	if (!m_file)
+		return false;
+	m_file.read(reinterpret_cast<char*>(&m_header), sizeof(m_header));
+	if (!m_file || m_header.magic != Header::kMagic)
+	{
+		m_file.close();
+		return false;
+	}
+	return true;
+}
+
+bool CloudWeatherTileFile::ReadTile(uint32_t x, uint32_t z, uint32_t* texels)
+{
+	assert(IsOpen() && x < m_header.tilesX && z < m_header.tilesZ);
+	uint64_t tile_bytes = (uint64_t)m_header.tileTexels * m_header.tileTexels * sizeof(uint32_t);
+	m_file.clear();
+	m_file.seekg((std::streamoff)(sizeof(Header) + ((uint64_t)z * m_header.tilesX + x) * tile_bytes));
+	m_file.read(reinterpret_cast<char*>(texels), (std::streamsize)tile_bytes);
+	return (bool)m_file;
+}
\ No newline at end of file
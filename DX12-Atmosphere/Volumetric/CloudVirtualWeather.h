@@ -0,0 +1,162 @@
+#pragma once
+#include "stdafx.h"
+#include <functional>
+#include <fstream>
+
+// Weather map for worlds far larger than one repeating texture. The world is a
+// grid of tiles, each tileSize world units wide, and only the tiles around the
+// camera live in a fixed atlas of atlasSlots x atlasSlots slots. The indirection
+// table has one RGBA8 texel per world tile: the slot it sits in, and alpha 255
+// while it is resident. Tiles come from a TileSource (a tile file or a generator),
+// are loaded nearest first with a budget per update, and a full atlas evicts the
+// least recently used tile no request touched this update. Tiles along the camera
+// velocity are requested ahead of time at a lower priority than the ones needed now.
+// Atlas slots carry a one texel border copied from the neighbouring world tiles,
+// so bilinear filtering inside a slot never reads the slot next to it.
+// No GPU state, the residency can run and be measured on its own.
+class CloudVirtualWeather
+{
+public:
+	struct Desc
+	{
+		// world tiles in x and z, tile (0, 0) starts at (originX, originZ)
+		uint32_t tilesX;
+		uint32_t tilesZ;
+		float originX;
+		float originZ;
+		float tileSize;
+		// texels per slot side including the border
+		uint32_t tileTexels;
+		uint32_t atlasSlots;
+		// tiles with their centre this many tiles from the camera are needed now
+		float residentRadius;
+		// the same radius around where the camera will be after this many seconds is prefetched
+		float prefetchSeconds;
+		uint32_t maxLoadsPerUpdate;
+	};
+
+	// Fills tileTexels * tileTexels RGBA8 texels of world tile (x, z). Texel (i, j) is centred
+	// at ((x + (i - 0.5) / (tileTexels - 2)) * tileSize, ...) past the origin.
+	typedef std::function<void(uint32_t x, uint32_t z, uint32_t* texels)> TileSource;
+
+	struct Stats
+	{
+		// requests are the tiles needed now, prefetches don't count
+		uint64_t requests;
+		uint64_t hits;
+		uint64_t tilesLoaded;
+		uint64_t prefetchLoads;
+		// needed tiles that were already there because of a prefetch
+		uint64_t prefetchHits;
+		uint64_t tilesEvicted;
+		uint64_t bytesStreamed;
+		double seconds;
+		double loadMilliseconds;
+		// needed tiles still missing after the last update, and the worst of any update
+		uint32_t missingTiles;
+		uint32_t maxMissingTiles;
+		uint32_t residentTiles;
+
+		double HitRate() const { return requests > 0 ? (double)hits / requests : 1.0; }
+		double BytesPerSecond() const { return seconds > 0.0 ? bytesStreamed / seconds : 0.0; }
+	};
+
+	struct PathKey
+	{
+		float x;
+		float z;
+	};
+
+	CloudVirtualWeather();
+
+	void Create(const Desc& desc, const TileSource& source);
+	bool IsValid() const { return !m_atlas.empty(); }
+
+	// Requests the tiles around (x, z) and ahead of it along the velocity (world units per second)
+	// and loads up to maxLoadsPerUpdate of the missing ones
+	void Update(float x, float z, float velocityX, float velocityZ, float deltaTime);
+	bool IsResident(uint32_t x, uint32_t z) const { return m_tileSlot[(size_t)z * m_desc.tilesX + x] >= 0; }
+	// SampleWeather of VolumetricCloudCommon.hlsli on the atlas, RGBA in [0, 1] at world (x, z),
+	// 0 off the world and over a tile that isn't resident
+	XMFLOAT4 Sample(float x, float z) const;
+
+	// Slots loaded since the last call, for the texture upload
+	std::vector<uint32_t> TakeDirtySlots();
+	bool TakeIndirectionDirty();
+
+	const Desc& GetDesc() const { return m_desc; }
+	const TileSource& GetSource() const { return m_source; }
+	const Stats& GetStats() const { return m_stats; }
+	void ResetStats();
+	uint32_t GetAtlasSize() const { return m_desc.atlasSlots * m_desc.tileTexels; }
+	// GetAtlasSize()^2 RGBA8
+	const uint32_t* GetAtlas() const { return m_atlas.data(); }
+	// tilesX * tilesZ RGBA8: slot x, slot y, 0, 255 when resident
+	const uint32_t* GetIndirection() const { return m_indirection.data(); }
+
+	// Flies a camera through the keys at deltaTime per key and returns the stats
+	static Stats Simulate(const Desc& desc, const TileSource& source, const std::vector<PathKey>& path, float deltaTime);
+	// Straight runs with turns in between at speed world units per second
+	static std::vector<PathKey> MakeFlightPath(uint32_t numKeys, float speed, float deltaTime, float startX, float startZ);
+
+private:
+	struct Slot
+	{
+		int32_t tile;
+		uint64_t lastUsed;
+		bool prefetched;
+	};
+
+	struct Request
+	{
+		float distance;
+		uint32_t tile;
+		bool needed;
+	};
+
+	void Collect(float x, float z, bool needed, std::vector<Request>& requests);
+	int32_t AcquireSlot();
+	void LoadTile(uint32_t tile, int32_t slot, bool needed);
+
+	Desc m_desc;
+	TileSource m_source;
+	std::vector<Slot> m_slots;
+	std::vector<int32_t> m_tileSlot;
+	// update the tile was last requested in, so a tile is only requested once per update
+	std::vector<uint64_t> m_requested;
+	std::vector<uint32_t> m_atlas;
+	std::vector<uint32_t> m_indirection;
+	std::vector<uint32_t> m_tileTexels;
+	std::vector<uint32_t> m_dirtySlots;
+	bool m_indirectionDirty;
+	uint64_t m_frame;
+	Stats m_stats;
+};
+
+// Tiles of a CloudVirtualWeather world baked into one file and read back one at a time:
+// the header, then every tile row major in z, tileTexels^2 RGBA8 each.
+class CloudWeatherTileFile
+{
+public:
+	struct Header
+	{
+		static const uint32_t kMagic = 0x54574356; // "VCWT"
+
+		uint32_t magic;
+		uint32_t tilesX;
+		uint32_t tilesZ;
+		uint32_t tileTexels;
+	};
+
+	static bool Write(const std::wstring& fileName, const CloudVirtualWeather::Desc& desc, const CloudVirtualWeather::TileSource& source);
+
+	bool Open(const std::wstring& fileName);
+	bool IsOpen() const { return m_file.is_open(); }
+	const Header& GetHeader() const { return m_header; }
+	// Not thread safe, CloudVirtualWeather loads on one thread
+	bool ReadTile(uint32_t x, uint32_t z, uint32_t* texels);
+
+private:
+	std::ifstream m_file;
+	Header m_header;
+};
\ No newline at end of file
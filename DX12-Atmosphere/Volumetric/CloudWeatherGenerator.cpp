@@ -0,0 +1,357 @@
+#include "stdafx.h"
+#include "CloudWeatherGenerator.h"
+#include <ppl.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+static const uint32_t kTurbulenceSize = 64;
+static const uint32_t kTypeSeed = 101;
+static const uint32_t kTurbulenceSeed = 211;
+
+static inline float Saturate(float x)
+{
+	return x < 0.0f ? 0.0f : (x > 1.0f ? 1.0f : x);
+}
+
+static inline int Wrap(int i, int period)
+{
+	int r = i % period;
+	return r < 0 ? r + period : r;
+}
+
+// integer lattice hash, murmur3 finalizer
+static inline uint32_t Hash(int x, int y, int z, uint32_t seed)
+{
+	uint32_t h = seed ^ ((uint32_t)x * 0x8da6b343u) ^ ((uint32_t)y * 0xd8163841u) ^ ((uint32_t)z * 0xcb1ab31fu);
+	h ^= h >> 16;
+	h *= 0x85ebca6bu;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35u;
+	h ^= h >> 16;
+	return h;
+}
+
+// one of the twelve cube edge gradients of improved Perlin noise
+static inline float Gradient(uint32_t h, float x, float y, float z)
+{
+	h &= 15;
+	float u = h < 8 ? x : y;
+	float v = h < 4 ? y : (h == 12 || h == 14 ? x : z);
+	return ((h & 1) ? -u : u) + ((h & 2) ? -v : v);
+}
+
+static inline float Fade(float t)
+{
+	return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+}
+
+static inline float Lerp(float a, float b, float t)
+{
+	return a + (b - a) * t;
+}
+
+static inline uint32_t PackColor(const XMFLOAT4& c)
+{
+	return (uint32_t)(Saturate(c.x) * 255.0f + 0.5f) | ((uint32_t)(Saturate(c.y) * 255.0f + 0.5f) << 8) |
+		((uint32_t)(Saturate(c.z) * 255.0f + 0.5f) << 16) | ((uint32_t)(Saturate(c.w) * 255.0f + 0.5f) << 24);
+}
+
+CloudWeatherGenerator::Params CloudWeatherGenerator::DefaultParams()
+{
+	Params params;
+	params.cells = 8;
+	params.octaves = 4;
+	params.coverage = 0.5f;
+	params.contrast = 2.0f;
+	params.evolution = 0.02f;
+	params.windX = 0.002f;
+	params.windY = 0.0f;
+	params.turbulence = 0.001f;
+	params.flowPeriod = 20.0f;
+	params.rainThreshold = 0.9f;
+	params.tolerance = 0.05f;
+	return params;
+}
+
+CloudWeatherGenerator::CloudWeatherGenerator()
+	: m_tilesPerRow(0),
+	m_turbulenceSize(kTurbulenceSize)
+{
+	ZeroMemory(&m_desc, sizeof(Desc));
+	ZeroMemory(&m_stats, sizeof(Stats));
+	m_params = DefaultParams();
+}
+
+void CloudWeatherGenerator::Create(const Desc& desc, const Params& params)
+{
+	assert(desc.size > 0 && desc.tileSize > 0 && desc.size % desc.tileSize == 0);
+	m_desc = desc;
+	m_tilesPerRow = desc.size / desc.tileSize;
+	m_tiles.assign((size_t)m_tilesPerRow * m_tilesPerRow, Tile());
+	m_pixels.assign((size_t)desc.size * desc.size, 0xFF000000u);
+	m_pendingTiles.clear();
+	ZeroMemory(&m_stats, sizeof(Stats));
+	SetParams(params);
+}
+
+void CloudWeatherGenerator::SetParams(const Params& params)
+{
+	assert(params.cells > 0 && params.octaves > 0);
+	m_params = params;
+	BuildTurbulence();
+
+	const float base_speed = std::sqrt(params.windX * params.windX + params.windY * params.windY);
+	const float tile_uv = (float)m_desc.tileSize / m_desc.size;
+	for (uint32_t i = 0; i < (uint32_t)m_tiles.size(); ++i)
+	{
+		// corners and centre, the turbulence grid is coarser than a tile at the usual sizes
+		float u0 = (i % m_tilesPerRow) * tile_uv, v0 = (i / m_tilesPerRow) * tile_uv;
+		float turbulence = 0.0f;
+		for (uint32_t k = 0; k < 5; ++k)
+		{
+			float u = k == 4 ? u0 + 0.5f * tile_uv : u0 + (k & 1) * tile_uv;
+			float v = k == 4 ? v0 + 0.5f * tile_uv : v0 + (k >> 1) * tile_uv;
+			float wx, wy;
+			SampleTurbulence(u, v, wx, wy);
+			turbulence = std::max(turbulence, std::sqrt(wx * wx + wy * wy));
+		}
+		Tile& tile = m_tiles[i];
+		tile.driftRate = (base_speed + turbulence) * params.cells + params.evolution;
+		tile.stale = true;
+	}
+}
+
+void CloudWeatherGenerator::MarkDirty(uint32_t x, uint32_t y, uint32_t width, uint32_t height)
+{
+	if (width == 0 || height == 0 || x >= m_desc.size || y >= m_desc.size)
+		return;
+	uint32_t x1 = std::min(x + width, m_desc.size) - 1, y1 = std::min(y + height, m_desc.size) - 1;
+	for (uint32_t ty = y / m_desc.tileSize; ty <= y1 / m_desc.tileSize; ++ty)
+		for (uint32_t tx = x / m_desc.tileSize; tx <= x1 / m_desc.tileSize; ++tx)
+			m_tiles[(size_t)ty * m_tilesPerRow + tx].stale = true;
+}
+
+float CloudWeatherGenerator::Noise(float x, float y, float z, int period, uint32_t seed) const
+{
+	// gradient noise that repeats every period lattice cells in x and y
+	float fx = std::floor(x), fy = std::floor(y), fz = std::floor(z);
+	int ix = (int)fx, iy = (int)fy, iz = (int)fz;
+	float tx = x - fx, ty = y - fy, tz = z - fz;
+	int x0 = Wrap(ix, period), x1 = Wrap(ix + 1, period);
+	int y0 = Wrap(iy, period), y1 = Wrap(iy + 1, period);
+
+	float n000 = Gradient(Hash(x0, y0, iz, seed), tx, ty, tz);
+	float n100 = Gradient(Hash(x1, y0, iz, seed), tx - 1.0f, ty, tz);
+	float n010 = Gradient(Hash(x0, y1, iz, seed), tx, ty - 1.0f, tz);
+	float n110 = Gradient(Hash(x1, y1, iz, seed), tx - 1.0f, ty - 1.0f, tz);
+	float n001 = Gradient(Hash(x0, y0, iz + 1, seed), tx, ty, tz - 1.0f);
+	float n101 = Gradient(Hash(x1, y0, iz + 1, seed), tx - 1.0f, ty, tz - 1.0f);
+	float n011 = Gradient(Hash(x0, y1, iz + 1, seed), tx, ty - 1.0f, tz - 1.0f);
+	float n111 = Gradient(Hash(x1, y1, iz + 1, seed), tx - 1.0f, ty - 1.0f, tz - 1.0f);
+
+	float u = Fade(tx), v = Fade(ty), w = Fade(tz);
+	float a = Lerp(Lerp(n000, n100, u), Lerp(n010, n110, u), v);
+	float b = Lerp(Lerp(n001, n101, u), Lerp(n011, n111, u), v);
+	return Lerp(a, b, w);
+}
+
+float CloudWeatherGenerator::Fbm(float x, float y, float z, uint32_t cells, uint32_t octaves, uint32_t seed) const
+{
+	// x, y in maps, every octave doubles the cells and still tiles
+	float sum = 0.0f, amplitude = 1.0f, total = 0.0f;
+	int period = (int)cells;
+	float frequency = (float)cells;
+	for (uint32_t o = 0; o < octaves; ++o)
+	{
+		sum += Noise(x * frequency, y * frequency, z * (float)(1u << o), period, seed + o) * amplitude;
+		total += amplitude;
+		amplitude *= 0.5f;
+		frequency *= 2.0f;
+		period *= 2;
+	}
+	return sum / total;
+}
+
+void CloudWeatherGenerator::BuildTurbulence()
+{
+	// curl of a two octave potential, divergence free and periodic over the map
+	const uint32_t n = m_turbulenceSize;
+	const uint32_t cells = std::max(1u, m_params.cells / 2);
+	std::vector<float> potential((size_t)n * n);
+	for (uint32_t y = 0; y < n; ++y)
+		for (uint32_t x = 0; x < n; ++x)
+			potential[(size_t)y * n + x] = Fbm((float)x / n, (float)y / n, 0.0f, cells, 2, m_desc.seed + kTurbulenceSeed);
+
+	m_turbulence.resize((size_t)n * n);
+	float max_speed = 0.0f;
+	for (uint32_t y = 0; y < n; ++y)
+	{
+		for (uint32_t x = 0; x < n; ++x)
+		{
+			float dx = potential[(size_t)y * n + (x + 1) % n] - potential[(size_t)y * n + (x + n - 1) % n];
+			float dy = potential[(size_t)((y + 1) % n) * n + x] - potential[(size_t)((y + n - 1) % n) * n + x];
+			m_turbulence[(size_t)y * n + x] = XMFLOAT2(dy, -dx);
+			max_speed = std::max(max_speed, std::sqrt(dx * dx + dy * dy));
+		}
+	}
+	float scale = max_speed > 0.0f ? m_params.turbulence / max_speed : 0.0f;
+	for (XMFLOAT2& w : m_turbulence)
+	{
+		w.x *= scale;
+		w.y *= scale;
+	}
+}
+
+void CloudWeatherGenerator::SampleTurbulence(float u, float v, float& wx, float& wy) const
+{
+	// bilinear, wrapping like the map
+	const uint32_t n = m_turbulenceSize;
+	float fx = u * n, fy = v * n;
+	float bx = std::floor(fx), by = std::floor(fy);
+	float tx = fx - bx, ty = fy - by;
+	int x0 = Wrap((int)bx, (int)n), y0 = Wrap((int)by, (int)n);
+	int x1 = (x0 + 1) % n, y1 = (y0 + 1) % n;
+	const XMFLOAT2& a = m_turbulence[(size_t)y0 * n + x0];
+	const XMFLOAT2& b = m_turbulence[(size_t)y0 * n + x1];
+	const XMFLOAT2& c = m_turbulence[(size_t)y1 * n + x0];
+	const XMFLOAT2& d = m_turbulence[(size_t)y1 * n + x1];
+	wx = Lerp(Lerp(a.x, b.x, tx), Lerp(c.x, d.x, tx), ty);
+	wy = Lerp(Lerp(a.y, b.y, tx), Lerp(c.y, d.y, tx), ty);
+}
+
+XMFLOAT4 CloudWeatherGenerator::Evaluate(float u, float v, float time) const
+{
+	const Params& p = m_params;
+	// the uniform wind translates the noise exactly
+	float bu = u - p.windX * time, bv = v - p.windY * time;
+	float z = time * p.evolution;
+
+	float coverage_noise;
+	if (p.turbulence > 0.0f && p.flowPeriod > 0.0f)
+	{
+		// two flow map phases half a period apart, each fades out before it restarts
+		float wx, wy;
+		SampleTurbulence(u, v, wx, wy);
+		float n[2], weight[2];
+		for (uint32_t phase = 0; phase < 2; ++phase)
+		{
+			float s = time / p.flowPeriod + 0.5f * phase;
+			s -= std::floor(s);
+			float t = s * p.flowPeriod;
+			// another slice of the noise per phase, so the two don't line up
+			n[phase] = Fbm(bu - wx * t + 0.37f * phase, bv - wy * t, z + 17.0f * phase, p.cells, p.octaves, m_desc.seed);
+			weight[phase] = 1.0f - std::abs(2.0f * s - 1.0f);
+		}
+		// keeps the variance of the blend, a plain lerp flattens the clouds mid way
+		coverage_noise = (n[0] * weight[0] + n[1] * weight[1]) / std::sqrt(weight[0] * weight[0] + weight[1] * weight[1]);
+	}
+	else
+	{
+		coverage_noise = Fbm(bu, bv, z, p.cells, p.octaves, m_desc.seed);
+	}
+	float coverage = Saturate(0.5f + (coverage_noise + p.coverage - 0.5f) * p.contrast);
+
+	// type varies slower than coverage, storm cells are tall and rain
+	float type_noise = Fbm(bu, bv, z * 0.5f, std::max(1u, p.cells / 2), 2, m_desc.seed + kTypeSeed);
+	float storm = Saturate((coverage - p.rainThreshold) / std::max(1.0f - p.rainThreshold, 1e-3f));
+	float type = std::max(Saturate(0.5f + 1.2f * type_noise), storm);
+	return XMFLOAT4(coverage, type, storm * type, 1.0f);
+}
+
+void CloudWeatherGenerator::EvaluateRegion(float u0, float v0, float du, float dv, uint32_t width, uint32_t height, float time, uint32_t* texels, size_t rowPitch) const
+{
+	for (uint32_t j = 0; j < height; ++j)
+	{
+		uint32_t* row = texels + j * rowPitch;
+		for (uint32_t i = 0; i < width; ++i)
+			row[i] = PackColor(Evaluate(u0 + (i + 0.5f) * du, v0 + (j + 0.5f) * dv, time));
+	}
+}
+
+void CloudWeatherGenerator::EvaluateTile(uint32_t tile, float time)
+{
+	const uint32_t size = m_desc.size, tile_size = m_desc.tileSize;
+	const uint32_t x0 = (tile % m_tilesPerRow) * tile_size, y0 = (tile / m_tilesPerRow) * tile_size;
+	const float inv_size = 1.0f / size;
+	EvaluateRegion(x0 * inv_size, y0 * inv_size, inv_size, inv_size, tile_size, tile_size, time, &m_pixels[(size_t)y0 * size + x0], size);
+}
+
+uint32_t CloudWeatherGenerator::Update(float time, uint32_t maxTiles)
+{
+	assert(IsValid());
+	auto start = std::chrono::high_resolution_clock::now();
+
+	// how many base cells each tile drifted since it was evaluated
+	std::vector<std::pair<float, uint32_t>> dirty;
+	for (uint32_t i = 0; i < (uint32_t)m_tiles.size(); ++i)
+	{
+		const Tile& tile = m_tiles[i];
+		float drift = tile.stale ? FLT_MAX : std::abs(time - tile.time) * tile.driftRate;
+		if (drift > m_params.tolerance)
+			dirty.push_back(std::make_pair(drift, i));
+	}
+	uint32_t count = std::min(maxTiles, (uint32_t)dirty.size());
+	std::partial_sort(dirty.begin(), dirty.begin() + count, dirty.end(),
+		[](const std::pair<float, uint32_t>& a, const std::pair<float, uint32_t>& b) { return a.first > b.first; });
+
+	concurrency::parallel_for(0u, count, [&](uint32_t i)
+	{
+		EvaluateTile(dirty[i].second, time);
+	});
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		Tile& tile = m_tiles[dirty[i].second];
+		tile.time = time;
+		tile.stale = false;
+		if (!tile.pending)
+			m_pendingTiles.push_back(dirty[i].second);
+		tile.pending = true;
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+	m_stats.dirtyTiles = (uint32_t)dirty.size();
+	m_stats.updatedTiles = count;
+	m_stats.lastUpdateMilliseconds = std::chrono::duration<double, std::milli>(end - start).count();
+	m_stats.totalUpdatedTiles += count;
+	return count;
+}
+
+std::vector<uint32_t> CloudWeatherGenerator::TakePendingTiles()
+{
+	for (uint32_t tile : m_pendingTiles)
+		m_tiles[tile].pending = false;
+	std::vector<uint32_t> tiles;
+	tiles.swap(m_pendingTiles);
+	return tiles;
+}
+
+std::vector<CloudWeatherGenerator::CostReport> CloudWeatherGenerator::MeasureCost(const Params& params, const std::vector<uint32_t>& sizes, uint32_t tileSize)
+{
+	std::vector<CostReport> reports;
+	for (uint32_t size : sizes)
+	{
+		CloudWeatherGenerator generator;
+		Desc desc = { size, tileSize, 0 };
+		generator.Create(desc, params);
+
+		CostReport report = {};
+		report.size = size;
+		report.numTiles = (uint32_t)generator.m_tiles.size();
+		report.numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+		// a few tiles on this thread, spread over the map
+		uint32_t samples = std::min(report.numTiles, 16u);
+		auto start = std::chrono::high_resolution_clock::now();
+		for (uint32_t i = 0; i < samples; ++i)
+			generator.EvaluateTile(i * report.numTiles / samples, 0.0f);
+		auto end = std::chrono::high_resolution_clock::now();
+		report.tileMicroseconds = std::chrono::duration<double, std::micro>(end - start).count() / samples;
+
+		generator.Update(0.0f, UINT_MAX);
+		report.mapMilliseconds = generator.GetStats().lastUpdateMilliseconds;
+		reports.push_back(report);
+	}
+	return reports;
+}
\ No newline at end of file
@@ -0,0 +1,122 @@
+#pragma once
+#include "stdafx.h"
+
+// Procedural replacement for Weather_Texture.dds: r coverage, g cloud type, b rain,
+// RGBA8 like the texture it stands in for. Coverage is fbm of a gradient noise that
+// tiles over the map and evolves along a third, time axis. The wind carries it:
+// a uniform part translates the noise exactly, a turbulent part (curl of another
+// tiling noise, so it neither piles up nor tears) advects it with two flow map
+// phases that restart half a period apart. The map is split into tiles, each
+// keeps the time it was evaluated at, and Update re-evaluates the tiles whose
+// content drifted furthest, so a still sky costs nothing and a windy one only
+// what the budget allows.
+class CloudWeatherGenerator
+{
+public:
+	struct Desc
+	{
+		uint32_t size;
+		uint32_t tileSize;
+		uint32_t seed;
+	};
+
+	struct Params
+	{
+		// base cells across the map, a whole number so the noise tiles
+		uint32_t cells;
+		uint32_t octaves;
+		// mean coverage and how sharp the cloud edges are
+		float coverage;
+		float contrast;
+		// noise time axis per second
+		float evolution;
+		// uniform wind in maps per second, turbulence in maps per second at its strongest
+		float windX;
+		float windY;
+		float turbulence;
+		// seconds before a flow map phase restarts
+		float flowPeriod;
+		// coverage where rain starts
+		float rainThreshold;
+		// base cells a tile may drift before it needs an update
+		float tolerance;
+	};
+
+	struct Stats
+	{
+		uint32_t dirtyTiles;
+		uint32_t updatedTiles;
+		double lastUpdateMilliseconds;
+		uint64_t totalUpdatedTiles;
+	};
+
+	struct CostReport
+	{
+		uint32_t size;
+		uint32_t numTiles;
+		uint32_t numThreads;
+		// one tile on one thread, every tile on every thread
+		double tileMicroseconds;
+		double mapMilliseconds;
+	};
+
+	static Params DefaultParams();
+
+	CloudWeatherGenerator();
+
+	void Create(const Desc& desc, const Params& params);
+	// Every tile goes stale
+	void SetParams(const Params& params);
+	// Tiles overlapping the texel rectangle go stale, e.g. after painting into the sky
+	void MarkDirty(uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+
+	// Re-evaluates at most maxTiles of the stale tiles at time, stalest first.
+	// Returns the number of tiles written.
+	uint32_t Update(float time, uint32_t maxTiles);
+	// Tiles written since the last call, for the texture upload
+	std::vector<uint32_t> TakePendingTiles();
+
+	// r, g, b, a of the map at uv and time, a is 1
+	XMFLOAT4 Evaluate(float u, float v, float time) const;
+	// width x height RGBA8 texels, texel (i, j) at uv (u0 + (i + 0.5) * du, v0 + (j + 0.5) * dv).
+	// Only needs SetParams, e.g. to fill the tiles of a CloudVirtualWeather world.
+	void EvaluateRegion(float u0, float v0, float du, float dv, uint32_t width, uint32_t height, float time, uint32_t* texels, size_t rowPitch) const;
+
+	bool IsValid() const { return !m_pixels.empty(); }
+	const Desc& GetDesc() const { return m_desc; }
+	const Params& GetParams() const { return m_params; }
+	const Stats& GetStats() const { return m_stats; }
+	uint32_t GetTilesPerRow() const { return m_tilesPerRow; }
+	// size * size RGBA8
+	const uint32_t* GetPixels() const { return m_pixels.data(); }
+
+	// Full updates from scratch at each size
+	static std::vector<CostReport> MeasureCost(const Params& params, const std::vector<uint32_t>& sizes, uint32_t tileSize);
+
+private:
+	struct Tile
+	{
+		float time;
+		// fastest drift over the tile in base cells per second
+		float driftRate;
+		bool stale;
+		bool pending;
+	};
+
+	float Noise(float x, float y, float z, int period, uint32_t seed) const;
+	float Fbm(float x, float y, float z, uint32_t cells, uint32_t octaves, uint32_t seed) const;
+	void SampleTurbulence(float u, float v, float& wx, float& wy) const;
+	void BuildTurbulence();
+	void EvaluateTile(uint32_t tile, float time);
+
+	Desc m_desc;
+	Params m_params;
+	uint32_t m_tilesPerRow;
+	std::vector<Tile> m_tiles;
+	std::vector<uint32_t> m_pixels;
+	std::vector<uint32_t> m_pendingTiles;
+	// turbulent wind on a coarse periodic grid, maps per second
+	uint32_t m_turbulenceSize;
+	std::vector<XMFLOAT2> m_turbulence;
+	Stats m_stats;
+};
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include "D3D12/TextureManager.h"
 #include "D3D12/ColorBuffer.h"
 #include "D3D12/PostProcess.h"
+#include "D3D12/FrameGraphBenchmark.h"
 #include "Utils/CameraController.h"
 #include "Utils/Camera.h"
 #include "Mesh/Mesh.h"
@@ -20,9 +21,27 @@
 #include "CompiledShaders/ComputeQuarterCloud_CS.h"
 #include "CompiledShaders/CombineSky_CS.h"
 #include "CompiledShaders/TemporalCloud_CS.h"
+#include "CompiledShaders/UpsampleCloud_CS.h"
+#include "CompiledShaders/ComputeCloudCubemap_CS.h"
+#include "CompiledShaders/ComputeCloudBindless_CS.h"
+#include "CompiledShaders/ComputeQuarterCloudBindless_CS.h"
+#include "CompiledShaders/UpsampleCloudBindless_CS.h"
+#include "CompiledShaders/TemporalCloudBindless_CS.h"
+#include "CompiledShaders/ComputeCloudCubemapBindless_CS.h"
+#include <chrono>
+#include <cstdio>
 
 using namespace Global;
 
+// Halton (2, 3), positions of the low res ray inside its block over 16 frames
+static const float kLowResJitter[16][2] =
+{
+	{ 0.5f, 0.333333f }, { 0.25f, 0.666667f }, { 0.75f, 0.111111f }, { 0.125f, 0.444444f },
+	{ 0.625f, 0.777778f }, { 0.375f, 0.222222f }, { 0.875f, 0.555556f }, { 0.0625f, 0.888889f },
+	{ 0.5625f, 0.037037f }, { 0.3125f, 0.37037f }, { 0.8125f, 0.703704f }, { 0.1875f, 0.148148f },
+	{ 0.6875f, 0.481481f }, { 0.4375f, 0.814815f }, { 0.9375f, 0.259259f }, { 0.03125f, 0.592593f }
+};
+
 VolumetricCloud::VolumetricCloud()
 {
 
@@ -51,15 +70,19 @@ bool VolumetricCloud::Initialize()
 	CreateMeshes();
 	CreateCamera();
 	CreateNoise();
+	SelfTest::AddCheck("RenderGraphs", [this](const char* name) { return CheckRenderGraphs(name); });
 
 	m_position = Vector3(0.0f, 0.0f, 0.0f);
 	m_rotation = Vector3(0.0f, 0.0f, 0.0f);
 	m_scale = Vector3(1.0f, 1.0f, 1.0f);
 
 	m_quarterBuffer = std::make_shared<ColorBuffer>();
-	m_quarterBuffer->Create(L"Quarter Buffer", m_clientWidth / 4, m_clientHeight / 4, 1, m_sceneBufferFormat);
+	m_quarterDepthBuffer = std::make_shared<ColorBuffer>();
+	CreateLowResBuffers();
 	m_cloudTempBuffer = std::make_shared<ColorBuffer>();
 	m_cloudTempBuffer->Create(L"Previous Cloud Buffer", m_clientWidth, m_clientHeight, 1, m_sceneBufferFormat);
+	m_skyCube = std::make_shared<ColorBuffer>();
+	CreateSkyCube();
 
 	m_mipmapTestBuffer = std::make_shared<ColorBuffer>();
 	m_mipmapTestBuffer->Create(L"Generate Mips Buffer", m_clientWidth, m_clientHeight, 0, m_sceneBufferFormat);
@@ -91,7 +114,8 @@ void VolumetricCloud::InitCloudParameters()
 	m_farDistance = 22000.0f;
 
 	//m_weatherTexture = TextureManager::LoadTGAFromFile("CloudWeatherTexture.TGA");
-	m_weatherTexture = TextureManager::LoadDDSFromFile("Weather_Texture.dds");
+	m_weatherFile = TextureManager::LoadDDSFromFile("Weather_Texture.dds");
+	m_weatherTexture = m_weatherFile;
 	//auto* curl_2d = TextureManager::LoadDDSFromFile("CurlNoise_Volume_16by8.DDS");
 	m_curlNoise2D = TextureManager::LoadDDSFromFile("CurlNoise_2D.dds");
 	//m_curlNoiseTexture = std::make_shared<VolumeColorBuffer>();
@@ -102,6 +126,390 @@ void VolumetricCloud::InitCloudParameters()
 	//m_erosionTexture = TextureManager::LoadTGAFromFile("volume_test.TGA", 8, 2);
 	//m_noiseShapeTexture = TextureManager::LoadTGAFromFile("CloudWeatherTexture.tga", 8, 8);
 
+	m_blueNoiseTexture = std::make_shared<Texture3D>(L"BlueNoise");
+	CreateBlueNoise(false);
+
+	m_updateScheduleTexture = std::make_shared<Texture2D>(L"UpdateSchedule");
+	CreateUpdateSchedule();
+	m_forcedRayCounter.Create(L"Forced Rays", 1, sizeof(uint32_t));
+	m_forcedRayReadback.Create(L"Forced Rays Readback", kForcedRaySlots, sizeof(uint32_t));
+
+	m_referenceImage = std::make_shared<Texture2D>(L"CloudReference");
+
+	m_cloudShadowTexture = std::make_shared<Texture2D>(L"CloudShadowMap");
+	CreateCloudShadowTexture();
+	m_shadowVolumeTexture = std::make_shared<Texture3D>(L"CloudShadowVolume");
+	CreateShadowVolumeTexture();
+
+	m_proceduralWeather = std::make_shared<Texture2D>(L"ProceduralWeather");
+
+	// bound even while the virtual weather is off
+	m_virtualWeatherAtlas = std::make_shared<Texture2D>(L"VirtualWeatherAtlas");
+	m_weatherIndirection = std::make_shared<Texture2D>(L"WeatherIndirection");
+	uint32_t no_tile = 0;
+	m_weatherIndirection->Create(1, 1, DXGI_FORMAT_R8G8B8A8_UINT, &no_tile);
+
+	m_heightLutTexture = std::make_shared<Texture2D>(L"HeightDensityLut");
+	CreateHeightLut();
+
+	m_mieLutTexture = std::make_shared<Texture2D>(L"MiePhaseLut");
+	XMFLOAT4 no_phase[6] = {};
+	m_mieLutTexture->Create(2, 3, DXGI_FORMAT_R32G32B32A32_FLOAT, no_phase);
+}
+
+void VolumetricCloud::CreateBlueNoise(bool regenerate)
+{
+	const uint32_t size = 64;
+	const uint32_t num_slices = 16;
+	std::wstring cache_file = L"BlueNoise_" + std::to_wstring(size) + L"x" + std::to_wstring(num_slices) + L"_" + std::to_wstring(m_blueNoiseSeed) + L".bin";
+	if (regenerate || !m_blueNoiseGenerator.Load(cache_file, size, num_slices, (uint64_t)m_blueNoiseSeed))
+	{
+		m_blueNoiseGenerator.Generate(size, num_slices, (uint64_t)m_blueNoiseSeed);
+		m_blueNoiseGenerator.Save(cache_file);
+	}
+
+	// the old texture may still be referenced by frames in flight
+	if (m_blueNoiseTexture->GetResource() != nullptr)
+		g_CommandManager.IdleGPU();
+	m_blueNoiseGenerator.CreateTexture(*m_blueNoiseTexture);
+}
+
+void VolumetricCloud::CreateUpdateSchedule()
+{
+	m_updateScheduler.Create((CloudUpdateScheduler::Pattern)m_updatePattern, (uint32_t)m_updatePatternSize, (uint64_t)m_blueNoiseSeed);
+	m_updateScheduler.SetRayBudget(m_rayBudget);
+	if (m_updateScheduleTexture->GetResource() != nullptr)
+		g_CommandManager.IdleGPU();
+	m_updateScheduler.CreateTexture(*m_updateScheduleTexture);
+	m_cloudParameterCB.scheduleSize = m_updateScheduler.GetSize();
+}
+
+void VolumetricCloud::SimulateUpdateSchedule()
+{
+	// quarter resolution keeps it interactive, the ratios don't depend on the size much
+	CloudUpdateSimulation::Desc desc;
+	desc.width = std::max(m_sceneColorBuffer->GetWidth() / 4, 2u);
+	desc.height = std::max(m_sceneColorBuffer->GetHeight() / 4, 2u);
+	desc.fovY = m_camera->GetFOV();
+	desc.forceUpdateMotion = m_cloudParameterCB.forceUpdateMotion / 4.0f;
+	auto path = CloudUpdateSimulation::MakeCameraPath(240, ToRadian(0.25f), 0.1f);
+	m_updateSimulation = CloudUpdateSimulation::Run(desc, m_updateScheduler, path);
+}
+
+void VolumetricCloud::CreateLowResBuffers()
+{
+	// rounded up, the last row and column of blocks may be partial
+	uint32_t downscale = m_cloudParameterCB.downscale;
+	uint32_t width = (m_clientWidth + downscale - 1) / downscale;
+	uint32_t height = (m_clientHeight + downscale - 1) / downscale;
+	if (m_quarterBuffer->GetResource() != nullptr)
+	{
+		g_CommandManager.IdleGPU();
+		m_quarterBuffer->Destroy();
+		m_quarterDepthBuffer->Destroy();
+	}
+	// the layer radiance goes negative where the cloud is thin, see RaymarchCloud
+	m_quarterBuffer->Create(L"Quarter Buffer", width, height, 1, DXGI_FORMAT_R16G16B16A16_FLOAT);
+	m_quarterDepthBuffer->Create(L"Quarter Depth Buffer", width, height, 1, DXGI_FORMAT_R32G32_FLOAT);
+}
+
+void VolumetricCloud::CreateSkyCube()
+{
+	if (m_skyCube->GetResource() != nullptr)
+	{
+		g_CommandManager.IdleGPU();
+		m_skyCube->Destroy();
+	}
+	m_skyCube->CreateCube(L"Sky Cube", (uint32_t)m_skyCubeSize, DXGI_FORMAT_R16G16B16A16_FLOAT);
+	m_skyCubeScheduler.Create((uint32_t)m_skyCubeSize, (uint32_t)m_skyCubeTiles);
+	m_skyCubeScheduler.SetBudget((uint32_t)m_skyCubeBudget);
+	// nothing to show until a whole period went by otherwise
+	m_skyCubeScheduler.RefreshAll();
+}
+
+bool VolumetricCloud::ReadBackReferenceTextures()
+{
+	bool read = m_referenceCloudShape.CreateFromGpu(*m_basicCloudShape);
+	read = m_referenceErosion.CreateFromGpu(*m_erosionTexture) && read;
+	// the repeating map, the virtual weather atlas is already on the CPU
+	const Texture2D* weather = m_useProceduralWeather ? m_proceduralWeather.get() : m_weatherFile;
+	read = m_referenceWeather.CreateFromGpu(const_cast<Texture2D&>(*weather), 1) && read;
+	m_referenceRenderer.SetTextures(&m_referenceCloudShape, &m_referenceErosion, &m_referenceWeather);
+	m_referenceRenderer.SetVirtualWeather(&m_virtualWeather);
+	m_referenceRenderer.SetHeightLut(&m_heightLut);
+	m_densityQuery.SetTextures(&m_referenceCloudShape, &m_referenceErosion, &m_referenceWeather);
+	m_densityQuery.SetVirtualWeather(&m_virtualWeather);
+	m_densityQuery.SetHeightLut(&m_heightLut);
+	return read;
+}
+
+void VolumetricCloud::RenderReference(ReferenceAction action)
+{
+	// read back every time, shape and erosion can be switched in the UI
+	if (!ReadBackReferenceTextures())
+		return;
+	m_referenceRenderer.SetAtmosphere(Atmosphere::GetAtmosphereCB()->atmosphere);
+	m_referenceRenderer.SetBlueNoise(&m_blueNoiseGenerator);
+	m_referenceRenderer.SetPhase(&m_miePhase);
+
+	if (action == kReferenceBenchmarkQueries)
+	{
+		m_densityQuery.SetParameters(m_cloudParameterCB, m_passCB.time);
+		m_queryBenchmark = m_densityQuery.RunBenchmark(1 << 18, 32, std::max(1u, std::thread::hardware_concurrency()),
+			m_passCB.cameraPosition.x, m_passCB.cameraPosition.z, 50000.0f);
+		return;
+	}
+	if (action == kReferenceMeasureShadowMap)
+	{
+		CloudShadowMap::Desc desc;
+		CloudShadowMap::BuildParams params;
+		GetCloudShadowBuild(desc, params);
+		m_densityQuery.SetParameters(m_cloudParameterCB, m_passCB.time);
+		m_cloudShadowCost = CloudShadowMap::MeasureBuild(m_densityQuery, desc, params, { 512, 1024 });
+		return;
+	}
+	if (action == kReferenceTracePaths || action == kReferenceContinuePaths)
+	{
+		bool restart = action == kReferenceTracePaths || m_pathTracer.GetWidth() == 0;
+		if (restart)
+		{
+			m_pathTracerQuery.SetTextures(&m_referenceCloudShape, &m_referenceErosion, &m_referenceWeather);
+			m_pathTracerQuery.SetVirtualWeather(&m_virtualWeather);
+			m_pathTracerQuery.SetHeightLut(&m_heightLut);
+			m_pathTracerQuery.SetParameters(m_cloudParameterCB, m_passCB.time);
+			m_pathTracerPass = m_passCB;
+		}
+		m_pathTracer.SetDensityQuery(&m_pathTracerQuery);
+		m_pathTracer.SetPhase(&m_miePhase);
+		m_pathTracer.Trace(m_pathTracerPass, m_pathTracerSettings, restart);
+		return;
+	}
+
+	uint32_t downscale = (uint32_t)std::max(1, m_referenceDownscale);
+	uint32_t width = std::max(1u, (uint32_t)m_clientWidth / downscale);
+	uint32_t height = std::max(1u, (uint32_t)m_clientHeight / downscale);
+	switch (action)
+	{
+	case kReferenceCompareSkipping:
+		m_skippingReport = m_referenceRenderer.CompareEmptySpaceSkipping(m_passCB, m_cloudParameterCB, width, height);
+		break;
+	case kReferenceCompareLighting:
+		m_lightingReport = m_referenceRenderer.CompareShadowVolume(m_passCB, m_cloudParameterCB, width, height);
+		break;
+	case kReferenceCompareUpsampling:
+		m_upsampleReport = m_referenceRenderer.CompareUpsampling(m_passCB, m_cloudParameterCB, width, height,
+			m_cloudParameterCB.downscale, m_cloudParameterCB.upsampleDepthSigma);
+		break;
+	case kReferenceCompareStepping:
+		m_steppingReport = m_referenceRenderer.CompareAdaptiveStepping(m_passCB, m_cloudParameterCB, width, height, (uint32_t)std::max(1, m_referenceDenseFactor));
+		break;
+	default:
+		m_referenceRenderer.Render(m_passCB, m_cloudParameterCB, width, height);
+		break;
+	}
+
+	if (m_referenceImage->GetResource() != nullptr)
+		g_CommandManager.IdleGPU();
+	m_referenceImage->Create(m_referenceRenderer.GetWidth(), m_referenceRenderer.GetHeight(), DXGI_FORMAT_R32G32B32A32_FLOAT, m_referenceRenderer.GetImage().data());
+}
+
+void VolumetricCloud::GetCloudShadowBuild(CloudShadowMap::Desc& desc, CloudShadowMap::BuildParams& params) const
+{
+	// INNER_RADIUS - EarthRadius * 100, the layer is flat in y
+	desc.size = (uint32_t)m_cloudShadowSize;
+	desc.halfExtent = 50000.0f;
+	desc.layerBottom = m_cloudParameterCB.cloudBottomRadius;
+	desc.layerTop = m_cloudParameterCB.cloudTopRadius;
+	desc.stepsPerTexel = 32;
+
+	// centred where the ground under the camera reads the map, a low sun pushes that away from the camera
+	const XMFLOAT3& l = m_passCB.lightDir;
+	const XMFLOAT3& camera = m_passCB.cameraPosition;
+	float t = std::min(std::max(desc.layerBottom - camera.y, 0.0f) / std::max(l.y, 1e-2f), desc.halfExtent);
+	params.lightDir = l;
+	params.centerX = camera.x + l.x * t;
+	params.centerZ = camera.z + l.z * t;
+	params.windOffset = m_passCB.time * m_cloudParameterCB.cloudSpeed;
+}
+
+void VolumetricCloud::UpdateCloudShadowMap()
+{
+	CloudShadowMap::Desc desc;
+	CloudShadowMap::BuildParams params;
+	GetCloudShadowBuild(desc, params);
+	const CloudShadowMap::Desc& current = m_cloudShadowMap.GetDesc();
+	if (current.size != desc.size || current.layerBottom != desc.layerBottom || current.layerTop != desc.layerTop)
+	{
+		m_cloudShadowMap.Create(desc);
+		CreateCloudShadowTexture();
+	}
+
+	if (!m_cloudShadowMap.IsBuilding() && m_cloudShadowMap.NeedsRebuild(params))
+		m_cloudShadowMap.BeginBuild(params);
+	// rows of a build spread over frames see the clouds of their own frame
+	m_densityQuery.SetParameters(m_cloudParameterCB, m_passCB.time);
+	if (m_cloudShadowMap.ContinueBuild(m_densityQuery, (uint32_t)std::max(1, m_cloudShadowRows)))
+		m_cloudShadowDirty = true;
+
+	if (m_cloudShadowMap.IsValid())
+	{
+		m_cloudParameterCB.cloudShadowOrigin[0] = m_cloudShadowMap.GetOriginX();
+		m_cloudParameterCB.cloudShadowOrigin[1] = m_cloudShadowMap.GetOriginZ();
+		m_cloudParameterCB.cloudShadowExtent = m_cloudShadowMap.GetExtent();
+	}
+}
+
+void VolumetricCloud::CreateCloudShadowTexture()
+{
+	// no shadow until the first build goes live
+	std::vector<float> clear((size_t)m_cloudShadowSize * m_cloudShadowSize, 0.0f);
+	if (m_cloudShadowTexture->GetResource() != nullptr)
+		g_CommandManager.IdleGPU();
+	m_cloudShadowTexture->Create(m_cloudShadowSize, m_cloudShadowSize, DXGI_FORMAT_R32_FLOAT, clear.data());
+	m_cloudShadowDirty = false;
+}
+
+void VolumetricCloud::UpdateShadowVolumeTexture()
+{
+	const CloudShadowVolume& volume = m_referenceRenderer.GetShadowVolume();
+	const CloudShadowVolume::Desc& desc = volume.GetDesc();
+	if (m_shadowVolumeTexture->GetWidth() != desc.width || m_shadowVolumeTexture->GetHeight() != desc.height ||
+		m_shadowVolumeTexture->GetDepth() != desc.depth)
+		CreateShadowVolumeTexture();
+
+	if (volume.GetStats().numBuilds != m_shadowVolumeBuilds)
+	{
+		m_shadowVolumeBuilds = volume.GetStats().numBuilds;
+		m_shadowVolumeDirty = volume.IsValid();
+	}
+
+	// the cone march until the first build is up
+	if (!volume.IsValid())
+		return;
+	float extent = 2.0f * desc.halfExtent;
+	m_cloudParameterCB.shadowVolumeOrigin[0] = volume.GetOriginX();
+	m_cloudParameterCB.shadowVolumeOrigin[1] = desc.layerBottom;
+	m_cloudParameterCB.shadowVolumeOrigin[2] = volume.GetOriginZ();
+	m_cloudParameterCB.shadowVolumeInvSize[0] = 1.0f / extent;
+	m_cloudParameterCB.shadowVolumeInvSize[1] = 1.0f / (desc.layerTop - desc.layerBottom);
+	m_cloudParameterCB.shadowVolumeInvSize[2] = 1.0f / extent;
+	m_cloudParameterCB.shadowVolumeTop = desc.layerTop;
+	m_cloudParameterCB.shadowVolume = m_shadowVolumeMode;
+}
+
+void VolumetricCloud::CreateShadowVolumeTexture()
+{
+	// a voxel bound in its place until the reference renderer creates the volume
+	const CloudShadowVolume::Desc& desc = m_referenceRenderer.GetShadowVolume().GetDesc();
+	uint32_t width = std::max(desc.width, 1u), height = std::max(desc.height, 1u), depth = std::max(desc.depth, 1u);
+	std::vector<float> clear((size_t)width * height * depth, 0.0f);
+	if (m_shadowVolumeTexture->GetResource() != nullptr)
+		g_CommandManager.IdleGPU();
+	m_shadowVolumeTexture->Create(width, height, depth, DXGI_FORMAT_R32_FLOAT, clear.data());
+	m_shadowVolumeBuilds = 0;
+	m_shadowVolumeDirty = false;
+}
+
+void VolumetricCloud::CreateProceduralWeather()
+{
+	// the whole map once, tiles follow as they drift
+	CloudWeatherGenerator::Desc desc = { (uint32_t)m_weatherSize, 64, 0 };
+	m_weatherGenerator.Create(desc, m_weatherParams);
+	m_weatherGenerator.Update(m_passCB.time, UINT_MAX);
+	m_weatherGenerator.TakePendingTiles();
+	if (m_proceduralWeather->GetResource() != nullptr)
+		g_CommandManager.IdleGPU();
+	m_proceduralWeather->Create(m_weatherSize, m_weatherSize, DXGI_FORMAT_R8G8B8A8_UNORM, m_weatherGenerator.GetPixels());
+}
+
+void VolumetricCloud::CreateVirtualWeather()
+{
+	// 128 x 128 tiles of 64 x 64 texels and a border, 32000 units each, around the origin. 500 units a
+	// texel, close to the 640 of the repeating map stretched over OUTER_RADIUS.
+	CloudVirtualWeather::Desc desc;
+	desc.tilesX = 128;
+	desc.tilesZ = 128;
+	desc.tileSize = 32000.0f;
+	desc.originX = -0.5f * desc.tilesX * desc.tileSize;
+	desc.originZ = -0.5f * desc.tilesZ * desc.tileSize;
+	desc.tileTexels = 66;
+	desc.atlasSlots = (uint32_t)m_virtualWeatherSlots;
+	desc.residentRadius = m_virtualWeatherRadius;
+	desc.prefetchSeconds = m_virtualWeatherPrefetch;
+	desc.maxLoadsPerUpdate = (uint32_t)std::max(1, m_virtualWeatherLoads);
+
+	// a still world, the wind moves the camera through it instead
+	CloudWeatherGenerator::Params params = m_weatherParams;
+	params.cells = 32;
+	params.evolution = 0.0f;
+	params.windX = 0.0f;
+	params.windY = 0.0f;
+	params.turbulence = 0.0f;
+	m_worldWeather.SetParams(params);
+	CloudVirtualWeather::TileSource source = [this, desc](uint32_t x, uint32_t z, uint32_t* texels)
+	{
+		// the border texels come from the neighbouring tiles
+		float du = 1.0f / ((desc.tileTexels - 2) * desc.tilesX), dv = 1.0f / ((desc.tileTexels - 2) * desc.tilesZ);
+		m_worldWeather.EvaluateRegion((float)x / desc.tilesX - du, (float)z / desc.tilesZ - dv, du, dv, desc.tileTexels, desc.tileTexels, 0.0f, texels, desc.tileTexels);
+	};
+
+	if (m_useWeatherTileFile)
+	{
+		const wchar_t* file_name = L"WeatherTiles.bin";
+		bool opened = m_weatherTileFile.Open(file_name);
+		const CloudWeatherTileFile::Header& header = m_weatherTileFile.GetHeader();
+		if (!opened || header.tilesX != desc.tilesX || header.tilesZ != desc.tilesZ || header.tileTexels != desc.tileTexels)
+		{
+			CloudWeatherTileFile::Write(file_name, desc, source);
+			opened = m_weatherTileFile.Open(file_name);
+		}
+		if (opened)
+			source = [this](uint32_t x, uint32_t z, uint32_t* texels) { m_weatherTileFile.ReadTile(x, z, texels); };
+	}
+	m_virtualWeather.Create(desc, source);
+
+	if (m_virtualWeatherAtlas->GetResource() != nullptr || m_weatherIndirection->GetResource() != nullptr)
+		g_CommandManager.IdleGPU();
+	uint32_t atlas_size = m_virtualWeather.GetAtlasSize();
+	m_virtualWeatherAtlas->Create(atlas_size, atlas_size, DXGI_FORMAT_R8G8B8A8_UNORM, m_virtualWeather.GetAtlas());
+	m_weatherIndirection->Create(desc.tilesX, desc.tilesZ, DXGI_FORMAT_R8G8B8A8_UINT, m_virtualWeather.GetIndirection());
+	m_virtualWeather.TakeDirtySlots();
+	m_virtualWeather.TakeIndirectionDirty();
+
+	m_cloudParameterCB.virtualWeatherOrigin[0] = desc.originX;
+	m_cloudParameterCB.virtualWeatherOrigin[1] = desc.originZ;
+	m_cloudParameterCB.virtualWeatherTiles[0] = desc.tilesX;
+	m_cloudParameterCB.virtualWeatherTiles[1] = desc.tilesZ;
+	m_cloudParameterCB.virtualWeatherTileSize = desc.tileSize;
+	m_cloudParameterCB.virtualWeatherTileTexels = (float)desc.tileTexels;
+	m_cloudParameterCB.virtualWeatherAtlasTexelSize = 1.0f / atlas_size;
+	m_lastWeatherPosition[0] = m_passCB.cameraPosition.x + m_passCB.time * m_cloudParameterCB.cloudSpeed;
+	m_lastWeatherPosition[1] = m_passCB.cameraPosition.z;
+}
+
+void VolumetricCloud::CreateHeightLut()
+{
+	m_heightLut.Create((uint32_t)m_heightLutTypes, (uint32_t)m_heightLutHeights);
+	m_heightLut.SetCurves(m_heightCurves);
+	if (m_heightLutTexture->GetResource() != nullptr)
+		g_CommandManager.IdleGPU();
+	m_heightLutTexture->Create(m_heightLutTypes, m_heightLutHeights, DXGI_FORMAT_R32_FLOAT, m_heightLut.GetTable().data());
+	m_heightLutDirty = false;
+
+	m_cloudParameterCB.heightLutScale[0] = (m_heightLutTypes - 1.0f) / m_heightLutTypes;
+	m_cloudParameterCB.heightLutScale[1] = (m_heightLutHeights - 1.0f) / m_heightLutHeights;
+	m_cloudParameterCB.heightLutBias[0] = 0.5f / m_heightLutTypes;
+	m_cloudParameterCB.heightLutBias[1] = 0.5f / m_heightLutHeights;
+}
+
+void VolumetricCloud::BakeMiePhase()
+{
+	m_miePhase.Bake(m_mieDesc);
+	g_CommandManager.IdleGPU();
+	m_mieLutTexture->Create(m_mieDesc.numAngles, 3, DXGI_FORMAT_R32G32B32A32_FLOAT, m_miePhase.GetShaderTable().data());
+	// texel j covers the angles [j, j + 1] * pi / numAngles
+	m_cloudParameterCB.mieLutScale = 1.0f / XM_PI;
+	m_cloudParameterCB.mieLutBias = 0.0f;
 }
 
 void VolumetricCloud::CreatePSO()
@@ -150,7 +558,7 @@ void VolumetricCloud::CreatePSO()
 
 	m_computeCloudOnQuadRS.Reset(5, 2);
 	m_computeCloudOnQuadRS[0].InitAsConstantBufferView(0);
-	m_computeCloudOnQuadRS[1].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 0, 10);
+	m_computeCloudOnQuadRS[1].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 0, 17);
 	m_computeCloudOnQuadRS[2].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 0, 10);
 	m_computeCloudOnQuadRS[3].InitAsConstantBufferView(1);
 	m_computeCloudOnQuadRS[4].InitAsConstantBufferView(2);
@@ -182,9 +590,55 @@ void VolumetricCloud::CreatePSO()
 	m_quarterCloudPSO.SetComputeShader(g_pComputeQuarterCloud_CS, sizeof(g_pComputeQuarterCloud_CS));
 	m_quarterCloudPSO.Finalize();
 
+	m_upsampleCloudPSO.SetRootSignature(m_computeCloudOnQuadRS);
+	m_upsampleCloudPSO.SetComputeShader(g_pUpsampleCloud_CS, sizeof(g_pUpsampleCloud_CS));
+	m_upsampleCloudPSO.Finalize();
+
 	m_combineSkyPSO.SetRootSignature(m_computeCloudOnQuadRS);
 	m_combineSkyPSO.SetComputeShader(g_pCombineSky_CS, sizeof(g_pCombineSky_CS));
 	m_combineSkyPSO.Finalize();
+
+	m_skyCubePSO.SetRootSignature(m_computeCloudOnQuadRS);
+	m_skyCubePSO.SetComputeShader(g_pComputeCloudCubemap_CS, sizeof(g_pComputeCloudCubemap_CS));
+	m_skyCubePSO.Finalize();
+
+	if (BindlessHeap::IsCreated())
+	{
+		// the same parameters, but the SRV table spans the BindlessHeap once per texture type
+		// and the slots of the textures come in root constants
+		m_bindlessCloudRS.Reset(6, 2);
+		m_bindlessCloudRS[0].InitAsConstantBufferView(0);
+		m_bindlessCloudRS[1].InitAsBindlessTable(7);
+		for (UINT i = 0; i < 7; ++i)
+			m_bindlessCloudRS[1].SetBindlessRange(i, i + 1);
+		m_bindlessCloudRS[2].InitAsDescriptorRange(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 0, 10);
+		m_bindlessCloudRS[3].InitAsConstantBufferView(1);
+		m_bindlessCloudRS[4].InitAsConstantBufferView(2);
+		m_bindlessCloudRS[5].InitAsConstants(_countof(m_bindlessSlots), 3);
+		m_bindlessCloudRS.InitStaticSampler(0, SamplerLinearClampDesc);
+		m_bindlessCloudRS.InitStaticSampler(1, SamplerLinearWrapDesc);
+		m_bindlessCloudRS.Finalize(L"BindlessCloudRS");
+
+		m_bindlessCloudPSO.SetRootSignature(m_bindlessCloudRS);
+		m_bindlessCloudPSO.SetComputeShader(g_pComputeCloudBindless_CS, sizeof(g_pComputeCloudBindless_CS));
+		m_bindlessCloudPSO.Finalize();
+
+		m_bindlessQuarterCloudPSO.SetRootSignature(m_bindlessCloudRS);
+		m_bindlessQuarterCloudPSO.SetComputeShader(g_pComputeQuarterCloudBindless_CS, sizeof(g_pComputeQuarterCloudBindless_CS));
+		m_bindlessQuarterCloudPSO.Finalize();
+
+		m_bindlessUpsampleCloudPSO.SetRootSignature(m_bindlessCloudRS);
+		m_bindlessUpsampleCloudPSO.SetComputeShader(g_pUpsampleCloudBindless_CS, sizeof(g_pUpsampleCloudBindless_CS));
+		m_bindlessUpsampleCloudPSO.Finalize();
+
+		m_bindlessTemporalCloudPSO.SetRootSignature(m_bindlessCloudRS);
+		m_bindlessTemporalCloudPSO.SetComputeShader(g_pTemporalCloudBindless_CS, sizeof(g_pTemporalCloudBindless_CS));
+		m_bindlessTemporalCloudPSO.Finalize();
+
+		m_bindlessSkyCubePSO.SetRootSignature(m_bindlessCloudRS);
+		m_bindlessSkyCubePSO.SetComputeShader(g_pComputeCloudCubemapBindless_CS, sizeof(g_pComputeCloudCubemapBindless_CS));
+		m_bindlessSkyCubePSO.Finalize();
+	}
 }
 
 void VolumetricCloud::CreateMeshes()
@@ -214,24 +668,11 @@ void VolumetricCloud::CreateNoise()
 	m_worley = std::make_shared<VolumeColorBuffer>();
 	m_worley->Create(L"Worley", 32, 32, 32, 0, DXGI_FORMAT_R16G16B16A16_FLOAT);
 
+	FrameGraphExecutor graph;
+	DeclareNoiseGraph(graph);
 	ComputeContext& context = ComputeContext::Begin();
-	context.SetRootSignature(m_generateNoiseRS);
-	context.SetPipelineState(m_generatePerlinWorleyPSO);
-	context.TransitionResource(*m_perlinWorley, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-	context.SetDynamicDescriptor(0, 0, m_perlinWorley->GetUAV());
-	context.Dispatch3D(m_perlinWorley->GetWidth(), m_perlinWorley->GetHeight(), m_perlinWorley->GetDepth(), 8, 8, 8);
-
-	context.SetPipelineState(m_generateWorleyPSO);
-	context.TransitionResource(*m_worley, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-	context.SetDynamicDescriptor(0, 0, m_worley->GetUAV());
-	context.Dispatch3D(m_worley->GetWidth(), m_worley->GetHeight(), m_worley->GetDepth(), 8, 8, 8);
+	graph.Execute(context);
 	context.Finish();
-
-	ComputeContext& mipContext = ComputeContext::Begin();
-	m_perlinWorley->GenerateMipMaps(context);
-	m_worley->GenerateMipMaps(mipContext);
-	m_perlinWorleyUE->GenerateMipMaps(context);
-	mipContext.Finish();
 }
 
 void VolumetricCloud::SwitchBasicCloudShape(int idx)
@@ -291,6 +732,48 @@ void VolumetricCloud::Update(const Timer& timer)
 
 	XMStoreFloat3(&m_passCB.whitePoint, Vector3(1.0f, 1.0f, 1.0f));
 	//Atmosphere::Update(dir, res);
+
+	if (m_useProceduralWeather)
+	{
+		if (m_weatherGenerator.GetDesc().size != (uint32_t)m_weatherSize)
+			CreateProceduralWeather();
+		else
+			m_weatherGenerator.Update(m_passCB.time, (uint32_t)std::max(1, m_weatherTilesPerFrame));
+	}
+	m_weatherTexture = m_useProceduralWeather ? m_proceduralWeather.get() : m_weatherFile;
+
+	if (m_useVirtualWeather)
+	{
+		const CloudVirtualWeather::Desc& desc = m_virtualWeather.GetDesc();
+		if (!m_virtualWeather.IsValid() || desc.atlasSlots != (uint32_t)m_virtualWeatherSlots || desc.residentRadius != m_virtualWeatherRadius ||
+			desc.prefetchSeconds != m_virtualWeatherPrefetch || desc.maxLoadsPerUpdate != (uint32_t)std::max(1, m_virtualWeatherLoads))
+			CreateVirtualWeather();
+
+		// SampleWeather reads the world at the camera moved along the wind
+		float x = m_passCB.cameraPosition.x + m_passCB.time * m_cloudParameterCB.cloudSpeed;
+		float z = m_passCB.cameraPosition.z;
+		float dt = std::max(timer.DeltaTime(), 1e-4f);
+		m_virtualWeather.Update(x, z, (x - m_lastWeatherPosition[0]) / dt, (z - m_lastWeatherPosition[1]) / dt, dt);
+		m_lastWeatherPosition[0] = x;
+		m_lastWeatherPosition[1] = z;
+		m_weatherTexture = m_virtualWeatherAtlas.get();
+	}
+	m_cloudParameterCB.virtualWeather = (int)m_useVirtualWeather;
+
+	if (m_heightLut.GetWidth() != (uint32_t)m_heightLutTypes || m_heightLut.GetHeight() != (uint32_t)m_heightLutHeights)
+		CreateHeightLut();
+
+	// the reference textures exist after the first reference render
+	if ((m_referenceShadowUpdate || m_shadowVolumeMode != 0) && m_referenceCloudShape.IsValid())
+		m_referenceRenderer.UpdateShadowVolume(m_passCB, m_cloudParameterCB, (uint32_t)std::max(1, m_referenceShadowSlices));
+	m_cloudParameterCB.shadowVolume = 0;
+	if (m_shadowVolumeMode != 0 && m_referenceCloudShape.IsValid())
+		UpdateShadowVolumeTexture();
+	if (m_cloudParameterCB.enableCloudShadow && m_referenceCloudShape.IsValid())
+		UpdateCloudShadowMap();
+	// a few paths per pixel every frame, for calibration runs left going
+	if (m_pathTraceContinuous && m_pathTracer.GetWidth() > 0)
+		m_pathTracer.Trace(m_pathTracerPass, m_pathTracerSettings, false);
 }
 
 void VolumetricCloud::Draw(const Timer& timer)
@@ -345,8 +828,8 @@ void VolumetricCloud::UpdateUI()
 
 			//ImGui::Text("Basic Cloud Shape Texture");
 			ImGui::SetNextItemWidth(150.0f);
-			const char* cloud_shape_textures[] = { "Perlin-Worley", "Perlin-Worley_UE", "Perlin-Worley-New" };
-			static VolumeColorBuffer* cloud_shape_texture_ptrs[] = { m_cloudShapeManager.GetBasicCloudShape(), m_perlinWorleyUE.get(), m_perlinWorley.get() };
+			const char* cloud_shape_textures[] = { "Perlin-Worley", "Perlin-Worley_UE", "Perlin-Worley-New", "Perlin-Worley (8-bit)" };
+			static VolumeColorBuffer* cloud_shape_texture_ptrs[] = { m_cloudShapeManager.GetBasicCloudShape(), m_perlinWorleyUE.get(), m_perlinWorley.get(), m_cloudShapeManager.GetPackedBasicCloudShape() };
 			static int cur_basic_shape = 0;
 			ImGui::Combo("Basic Cloud Shape", &cur_basic_shape, cloud_shape_textures, IM_ARRAYSIZE(cloud_shape_textures));
 			//SwitchBasicCloudShape(cur_basic_shape);
@@ -358,8 +841,8 @@ void VolumetricCloud::UpdateUI()
 			
 			//ImGui::Text("Erosion Texture");
 			ImGui::SetNextItemWidth(150.0f);
-			const char* erosion_textures[] = { "Worley", "Erosion"};
-			static VolumeColorBuffer* erosion_texture_ptrs[] = { m_worley.get(), m_cloudShapeManager.GetErosion() };
+			const char* erosion_textures[] = { "Worley", "Erosion", "Erosion (8-bit)" };
+			static VolumeColorBuffer* erosion_texture_ptrs[] = { m_worley.get(), m_cloudShapeManager.GetErosion(), m_cloudShapeManager.GetPackedErosion() };
 			static int cur_erosion = 0;
 			ImGui::Combo("Erosion Texture", &cur_erosion, erosion_textures, IM_ARRAYSIZE(erosion_textures));
 			m_erosionTexture = erosion_texture_ptrs[cur_erosion];
@@ -373,6 +856,72 @@ void VolumetricCloud::UpdateUI()
 			static bool weather_window_opening;
 			ImGui::SameLine(400.0f);
 			ImGui::PreviewImageButton(m_weatherTexture, ImVec2(128.0f, 128.0f), "Weather Texture", &weather_detail, &weather_window_opening);
+			ImGui::Checkbox("Procedural Weather", &m_useProceduralWeather);
+			if (m_useProceduralWeather)
+			{
+				static const char* weather_sizes[] = { "512", "1024", "2048", "4096" };
+				int weather_size_index = m_weatherSize == 512 ? 0 : (m_weatherSize == 1024 ? 1 : (m_weatherSize == 2048 ? 2 : 3));
+				ImGui::Combo("Weather Map Size", &weather_size_index, weather_sizes, IM_ARRAYSIZE(weather_sizes));
+				m_weatherSize = 512 << weather_size_index;
+				int weather_cells = (int)m_weatherParams.cells;
+				int weather_octaves = (int)m_weatherParams.octaves;
+				bool weather_changed = ImGui::SliderInt("Weather Cells", &weather_cells, 1, 32);
+				weather_changed |= ImGui::SliderInt("Weather Octaves", &weather_octaves, 1, 6);
+				weather_changed |= ImGui::SliderFloat("Mean Coverage", &m_weatherParams.coverage, 0.0f, 1.0f);
+				weather_changed |= ImGui::SliderFloat("Coverage Contrast", &m_weatherParams.contrast, 0.5f, 8.0f);
+				weather_changed |= ImGui::SliderFloat("Evolution", &m_weatherParams.evolution, 0.0f, 0.2f);
+				weather_changed |= ImGui::SliderFloat("Wind X", &m_weatherParams.windX, -0.01f, 0.01f, "%.4f");
+				weather_changed |= ImGui::SliderFloat("Wind Y", &m_weatherParams.windY, -0.01f, 0.01f, "%.4f");
+				weather_changed |= ImGui::SliderFloat("Turbulence", &m_weatherParams.turbulence, 0.0f, 0.01f, "%.4f");
+				weather_changed |= ImGui::SliderFloat("Flow Period", &m_weatherParams.flowPeriod, 1.0f, 120.0f);
+				weather_changed |= ImGui::SliderFloat("Rain Threshold", &m_weatherParams.rainThreshold, 0.0f, 1.0f);
+				weather_changed |= ImGui::SliderFloat("Drift Tolerance", &m_weatherParams.tolerance, 0.005f, 0.5f);
+				m_weatherParams.cells = (uint32_t)weather_cells;
+				m_weatherParams.octaves = (uint32_t)weather_octaves;
+				if (weather_changed && m_weatherGenerator.IsValid())
+					m_weatherGenerator.SetParams(m_weatherParams);
+				ImGui::SliderInt("Weather Tiles / Frame", &m_weatherTilesPerFrame, 1, 64);
+				const auto& weather_stats = m_weatherGenerator.GetStats();
+				ImGui::Text("%u dirty tiles, %u updated in %.2f ms", weather_stats.dirtyTiles, weather_stats.updatedTiles, weather_stats.lastUpdateMilliseconds);
+				if (ImGui::Button("Measure Weather Cost"))
+					m_weatherCost = CloudWeatherGenerator::MeasureCost(m_weatherParams, { 1024, 4096 }, 64);
+				for (const auto& cost : m_weatherCost)
+				{
+					ImGui::Text("%ux%u: %.1f us / tile, %.1f ms / map (%u tiles, %u threads)", cost.size, cost.size, cost.tileMicroseconds,
+						cost.mapMilliseconds, cost.numTiles, cost.numThreads);
+				}
+			}
+			ImGui::Checkbox("Virtual Weather", &m_useVirtualWeather);
+			if (m_useVirtualWeather)
+			{
+				ImGui::SliderInt("Atlas Slots", &m_virtualWeatherSlots, 4, 32);
+				ImGui::SliderFloat("Resident Radius", &m_virtualWeatherRadius, 1.0f, 16.0f);
+				ImGui::SliderFloat("Prefetch Seconds", &m_virtualWeatherPrefetch, 0.0f, 10.0f);
+				ImGui::SliderInt("Tile Loads / Frame", &m_virtualWeatherLoads, 1, 32);
+				// the first use bakes every tile of the world into the file, 285 MB
+				if (ImGui::Checkbox("Stream From Tile File", &m_useWeatherTileFile))
+					m_virtualWeather = CloudVirtualWeather();
+				const auto& streaming = m_virtualWeather.GetStats();
+				ImGui::Text("%u resident, %u missing (worst %u), hit rate %.2f%%, %.2f MB/s", streaming.residentTiles, streaming.missingTiles,
+					streaming.maxMissingTiles, streaming.HitRate() * 100.0, streaming.BytesPerSecond() / (1024.0 * 1024.0));
+				if (ImGui::Button("Reset Streaming Stats"))
+					m_virtualWeather.ResetStats();
+				ImGui::SameLine();
+				if (ImGui::Button("Simulate Streaming") && m_virtualWeather.IsValid())
+				{
+					// a minute of flight at 4000 units per second, the current source and settings
+					const float dt = 1.0f / 60.0f;
+					auto path = CloudVirtualWeather::MakeFlightPath(3600, 4000.0f, dt, m_lastWeatherPosition[0], m_lastWeatherPosition[1]);
+					m_weatherStreaming = CloudVirtualWeather::Simulate(m_virtualWeather.GetDesc(), m_virtualWeather.GetSource(), path, dt);
+				}
+				if (m_weatherStreaming.seconds > 0.0)
+				{
+					ImGui::Text("simulated: hit rate %.2f%%, %llu loads (%llu prefetched, %llu used), %llu evicted, worst %u missing, %.2f MB/s, %.1f ms loading",
+						m_weatherStreaming.HitRate() * 100.0, m_weatherStreaming.tilesLoaded, m_weatherStreaming.prefetchLoads, m_weatherStreaming.prefetchHits,
+						m_weatherStreaming.tilesEvicted, m_weatherStreaming.maxMissingTiles, m_weatherStreaming.BytesPerSecond() / (1024.0 * 1024.0),
+						m_weatherStreaming.loadMilliseconds);
+				}
+			}
 
 			ImGui::Text("Curl Noise");
 			static bool curl_noise_window = false;
@@ -388,6 +937,137 @@ void VolumetricCloud::UpdateUI()
 		{
 			ImGui::InputInt("Sample Count Min", &m_cloudParameterCB.sampleCountMin);
 			ImGui::InputInt("Sample Count Max", &m_cloudParameterCB.sampleCountMax);
+			bool adaptive_march = m_cloudParameterCB.adaptiveMarch != 0;
+			ImGui::Checkbox("Adaptive Raymarch", &adaptive_march);
+			m_cloudParameterCB.adaptiveMarch = (int)adaptive_march;
+			if (adaptive_march)
+			{
+				ImGui::SliderFloat("Coarse Step Scale", &m_cloudParameterCB.coarseStepScale, 1.0f, 16.0f);
+				ImGui::SliderInt("Empty Samples To Coarse", &m_cloudParameterCB.fineZeroSamples, 1, 16);
+				ImGui::DragFloat("LOD Near Distance", &m_cloudParameterCB.lodNearDistance, 100.0f, 0.0f, m_cloudParameterCB.lodFarDistance);
+				ImGui::DragFloat("LOD Far Distance", &m_cloudParameterCB.lodFarDistance, 100.0f, m_cloudParameterCB.lodNearDistance, 1.0e6f);
+				ImGui::SliderFloat("LOD Mip Bias", &m_cloudParameterCB.lodMipBias, 0.0f, 4.0f);
+			}
+			ImGui::SliderFloat("Min Transmittance", &m_cloudParameterCB.minTransmittance, 0.0f, 0.5f);
+			bool cloud_shadow = m_cloudParameterCB.enableCloudShadow != 0;
+			ImGui::Checkbox("Cloud Shadow Map", &cloud_shadow);
+			// the map is built from the textures the CPU reference reads back
+			if (cloud_shadow && !m_referenceCloudShape.IsValid())
+				cloud_shadow = ReadBackReferenceTextures();
+			m_cloudParameterCB.enableCloudShadow = (int)cloud_shadow;
+			if (cloud_shadow)
+			{
+				ImGui::SliderFloat("Ground Shadow", &m_cloudParameterCB.cloudShadowStrength, 0.0f, 1.0f);
+				ImGui::SliderFloat("Aerial Shadow", &m_cloudParameterCB.cloudShadowAerial, 0.0f, 1.0f);
+				static const char* shadow_sizes[] = { "256", "512", "1024" };
+				int shadow_size_index = m_cloudShadowSize == 256 ? 0 : (m_cloudShadowSize == 512 ? 1 : 2);
+				ImGui::Combo("Shadow Map Size", &shadow_size_index, shadow_sizes, IM_ARRAYSIZE(shadow_sizes));
+				m_cloudShadowSize = 256 << shadow_size_index;
+				ImGui::SliderInt("Shadow Rows / Frame", &m_cloudShadowRows, 1, 256);
+				const auto& shadow_stats = m_cloudShadowMap.GetStats();
+				ImGui::Text("%u builds, last %.1f ms, progress %.0f%%", shadow_stats.numBuilds, shadow_stats.lastBuildMilliseconds,
+					m_cloudShadowMap.GetBuildProgress() * 100.0f);
+				if (ImGui::Button("Measure Build Cost"))
+					RenderReference(kReferenceMeasureShadowMap);
+				for (size_t i = 0; i < m_cloudShadowCost.size(); ++i)
+				{
+					const auto& cost = m_cloudShadowCost[i];
+					ImGui::Text("%ux%u: %.1f ms, %.1f M samples / s", 512u << i, 512u << i, cost.lastBuildMilliseconds,
+						cost.densitySamples / std::max(cost.lastBuildMilliseconds * 1000.0, 1e-3));
+				}
+			}
+			// the volume the CPU reference builds from its textures, swept a few slices a frame
+			const char* light_modes[] = { "Cone March", "Shadow Volume", "Shadow Volume (To Sun)" };
+			ImGui::Combo("Sun Light##Compute", &m_shadowVolumeMode, light_modes, IM_ARRAYSIZE(light_modes));
+			if (m_shadowVolumeMode != 0 && !m_referenceCloudShape.IsValid() && !ReadBackReferenceTextures())
+				m_shadowVolumeMode = 0;
+			if (m_shadowVolumeMode != 0)
+			{
+				ImGui::SliderInt("Shadow Slices / Frame", &m_referenceShadowSlices, 1, 32);
+				const auto& volume = m_referenceRenderer.GetShadowVolume();
+				ImGui::Text("%u builds, last %.1f ms, progress %.0f%%", volume.GetStats().numBuilds, volume.GetStats().lastBuildMilliseconds,
+					volume.GetBuildProgress() * 100.0f);
+			}
+			bool height_lut = m_cloudParameterCB.heightLut != 0;
+			ImGui::Checkbox("Height Density LUT", &height_lut);
+			m_cloudParameterCB.heightLut = (int)height_lut;
+			bool type_from_weather = m_cloudParameterCB.cloudTypeFromWeather != 0;
+			ImGui::Checkbox("Cloud Type From Weather", &type_from_weather);
+			m_cloudParameterCB.cloudTypeFromWeather = (int)type_from_weather;
+			if (!type_from_weather)
+				ImGui::SliderFloat("Cloud Type", &m_cloudParameterCB.cloudType, 0.0f, 1.0f);
+			if (height_lut)
+			{
+				static const char* lut_types[] = { "16", "32", "64" };
+				static const char* lut_heights[] = { "64", "128", "256", "512" };
+				int types_index = m_heightLutTypes == 16 ? 0 : (m_heightLutTypes == 32 ? 1 : 2);
+				int heights_index = m_heightLutHeights == 64 ? 0 : (m_heightLutHeights == 128 ? 1 : (m_heightLutHeights == 256 ? 2 : 3));
+				ImGui::Combo("LUT Cloud Types", &types_index, lut_types, IM_ARRAYSIZE(lut_types));
+				ImGui::Combo("LUT Heights", &heights_index, lut_heights, IM_ARRAYSIZE(lut_heights));
+				m_heightLutTypes = 16 << types_index;
+				m_heightLutHeights = 64 << heights_index;
+
+				// the baked column at the current cloud type, density / height fraction
+				float column[128];
+				for (uint32_t j = 0; j < 128; ++j)
+					column[j] = m_heightLut.Sample((j + 0.5f) / 128.0f, m_cloudParameterCB.cloudType);
+				ImGui::PlotLines("Density / Height", column, 128, 0, nullptr, 0.0f, FLT_MAX, ImVec2(0.0f, 64.0f));
+
+				bool curves_changed = false;
+				for (size_t c = 0; c < m_heightCurves.size(); ++c)
+				{
+					auto& curve = m_heightCurves[c];
+					ImGui::PushID((int)c);
+					if (ImGui::TreeNode("Curve", "Curve at type %.2f", curve.cloudType))
+					{
+						curves_changed |= ImGui::SliderFloat("Cloud Type", &curve.cloudType, 0.0f, 1.0f);
+						for (size_t k = 0; k < curve.keys.size(); ++k)
+						{
+							ImGui::PushID((int)k);
+							curves_changed |= ImGui::SliderFloat2("Height, Density", &curve.keys[k].height, 0.0f, 1.0f);
+							ImGui::PopID();
+						}
+						if (curve.keys.size() < CloudHeightLut::kMaxKeys && ImGui::Button("Add Key"))
+						{
+							curve.keys.push_back(curve.keys.empty() ? CloudHeightLut::Key{ 0.0f, 0.0f } : curve.keys.back());
+							curves_changed = true;
+						}
+						ImGui::SameLine();
+						if (curve.keys.size() > 1 && ImGui::Button("Remove Key"))
+						{
+							curve.keys.pop_back();
+							curves_changed = true;
+						}
+						ImGui::TreePop();
+					}
+					ImGui::PopID();
+				}
+				if (ImGui::Button("Reset Curves"))
+				{
+					m_heightCurves = CloudHeightLut::DefaultCurves();
+					curves_changed = true;
+				}
+				ImGui::SameLine();
+				if (ImGui::Button("Measure LUT"))
+					m_heightLutReport = CloudHeightLut::Measure(m_heightCurves, (uint32_t)m_heightLutTypes, { 64, 128, 256, 512 });
+				for (const auto& report : m_heightLutReport)
+				{
+					ImGui::Text("%ux%u: max deviation %.4f (density %.4f, curves %.4f)", report.width, report.height, report.maxDeviation,
+						report.maxDensityDeviation, report.maxCurveDeviation);
+				}
+				if (!m_heightLutReport.empty())
+				{
+					const auto& report = m_heightLutReport.front();
+					ImGui::Text("ALU / sample: %u analytic (%u constant type), %u + 1 fetch with the LUT, CPU %.1f ns vs %.1f ns",
+						report.analyticAlu, report.analyticConstantTypeAlu, report.lutAlu, report.analyticNanoseconds, report.lutNanoseconds);
+				}
+				if (curves_changed)
+				{
+					// keys stay in order on the sliders, SetCurves sorts its own copy
+					m_heightLut.SetCurves(m_heightCurves);
+					m_heightLutDirty = true;
+				}
+			}
 			ImGui::Separator();
 			ImGui::Text("Cloud Rendering");
 			ImGui::SliderFloat("Cloud Coverage", &m_cloudParameterCB.cloudCoverage, 0.0f, 1.0f);
@@ -398,6 +1078,37 @@ void VolumetricCloud::UpdateUI()
 			ImGui::DragFloat("Light Absorption", &m_cloudParameterCB.absorption, 0.0001f, 0.0f, 1.5f, "%.4f");
 			ImGui::DragFloat("HG Coeff0", &m_cloudParameterCB.hg0, 0.0005f);
 			ImGui::DragFloat("HG Coeff1", &m_cloudParameterCB.hg1, 0.0005f);
+			bool mie_lut = m_cloudParameterCB.mieLut != 0;
+			ImGui::Checkbox("Mie Phase LUT", &mie_lut);
+			if (mie_lut && !m_miePhase.IsValid())
+				BakeMiePhase();
+			m_cloudParameterCB.mieLut = (int)mie_lut;
+			if (mie_lut)
+			{
+				ImGui::SliderFloat("Effective Radius (um)", &m_mieDesc.effectiveRadius, 1.0f, 30.0f);
+				ImGui::SliderFloat("Effective Variance", &m_mieDesc.effectiveVariance, 0.01f, 0.3f);
+				int mie_radii = (int)m_mieDesc.numRadii;
+				int mie_angles = (int)m_mieDesc.numAngles;
+				ImGui::SliderInt("Droplet Radii", &mie_radii, 16, 1024);
+				ImGui::SliderInt("Phase Angles", &mie_angles, 64, 1024);
+				m_mieDesc.numRadii = (uint32_t)mie_radii;
+				m_mieDesc.numAngles = (uint32_t)mie_angles;
+				if (ImGui::Button("Bake Mie Phase"))
+					BakeMiePhase();
+
+				const auto& mie = m_miePhase.GetReport();
+				ImGui::Text("%.0f ms on %u threads, %.0f sizes / s, %.1f M terms x angles / s, size parameter up to %.0f", mie.solveMilliseconds,
+					mie.numThreads, mie.sizesPerSecond, mie.termsPerSecond * 1e-6, mie.maxSizeParameter);
+				ImGui::Text("g %.4f %.4f %.4f, sampled %.4f %.4f %.4f", mie.g[0], mie.g[1], mie.g[2], mie.sampledG[0], mie.sampledG[1], mie.sampledG[2]);
+				ImGui::Text("integral %.4f %.4f %.4f, relative error max %.3f rms %.4f", mie.normalization[0], mie.normalization[1], mie.normalization[2],
+					mie.maxRelativeError, mie.rmsRelativeError);
+				ImGui::Text("forward / back %.1f, numericalMieFit %.1f", mie.forwardBackRatio, mie.fitForwardBackRatio);
+				// log10 of the mean phase from 0 to 180 degrees
+				float mie_plot[180];
+				for (uint32_t a = 0; a < 180; ++a)
+					mie_plot[a] = std::log10(std::max(m_miePhase.Evaluate(std::cos((a + 0.5f) * XM_PI / 180.0f), 3), 1e-6f));
+				ImGui::PlotLines("log10 Phase", mie_plot, 180, 0, nullptr, FLT_MAX, FLT_MAX, ImVec2(0.0f, 64.0f));
+			}
 			ImGui::ColorEdit3("Cloud Bottom Color", m_cloudParameterCB.cloudBottomColor);
 			ImGui::ColorEdit3("Light Color", m_cloudParameterCB.lightColor);
 			bool enable_powder = (bool)m_cloudParameterCB.enablePowder;
@@ -412,8 +1123,136 @@ void VolumetricCloud::UpdateUI()
 			ImGui::DragFloat("Sliver Spread", &m_cloudParameterCB.sliverSpread, 0.001f, -FLT_MAX, FLT_MAX);
 			ImGui::DragFloat("Brightness", &m_cloudParameterCB.brightness, 0.001f, -FLT_MAX, FLT_MAX);
 			ImGui::Checkbox("Enable Temporal", &m_useTemporal);
-			if (m_useTemporal)
-				ImGui::Checkbox("Render To Quarter Buffer", &m_computeToQuarter);
+			if (BindlessHeap::IsCreated())
+			{
+				ImGui::Checkbox("Bindless Textures", &m_useBindless);
+				BindlessHeap::Stats bindless = BindlessHeap::GetStats();
+				ImGui::Text("%u / %u bindless SRVs, %llu copied last frame, %u / %u pages in use, %u fallbacks", bindless.registered, bindless.capacity,
+					bindless.registrationCopiesLastFrame, bindless.pagesInUse, bindless.pages, bindless.fallbacksLastFrame);
+			}
+			ImGui::Text("Descriptors Copied / Frame: %llu", DynamicDescriptorHeap::GetCopiedLastFrame());
+			if (ImGui::TreeNode("Allocators"))
+			{
+				auto allocator_text = [](const char* name, const auto& stats)
+				{
+					ImGui::Text("%s: %llu pages, %llu hits, %llu refills of %llu requests, %llu in flight, %.1f KB last frame", name, stats.created,
+						stats.cacheHits, stats.refills, stats.requests, stats.pagesInFlight, stats.bytesLastFrame / 1024.0);
+				};
+				allocator_text("Linear GPU", LinearAllocator::GetStats(kGpuExclusive));
+				allocator_text("Linear Upload", LinearAllocator::GetStats(kCpuWritable));
+				allocator_text("Dynamic", DynamicAllocator::GetStats());
+				PageMemory::Stats memory = PageMemory::GetStats();
+				ImGui::Text("CPU pages: %llu large, %llu transparent, %llu default, %llu large page fallbacks, %.1f MB", memory.largePages,
+					memory.transparentPages, memory.defaultPages, memory.largePageFallbacks, memory.bytes / (1024.0 * 1024.0));
+				ImGui::TreePop();
+			}
+			static const char* table_cache_names[] = { "Off", "Per Command List", "Cross Frame" };
+			int table_cache_mode = (int)DynamicDescriptorHeap::GetTableCacheMode();
+			if (ImGui::Combo("Table Cache", &table_cache_mode, table_cache_names, IM_ARRAYSIZE(table_cache_names)))
+				DynamicDescriptorHeap::SetTableCacheMode((DynamicDescriptorHeap::TableCacheMode)table_cache_mode);
+			uint64_t table_lookups = DynamicDescriptorHeap::GetTableLookupsLastFrame();
+			uint64_t table_hits = DynamicDescriptorHeap::GetTableHitsLastFrame();
+			ImGui::Text("Table Cache Hits / Frame: %llu / %llu (%.1f%%)", table_hits, table_lookups,
+				table_lookups > 0 ? 100.0 * table_hits / table_lookups : 0.0);
+			ImGui::Checkbox("Render At Reduced Resolution", &m_computeToQuarter);
+			if (m_computeToQuarter)
+			{
+				static const char* downscale_names[] = { "1/2", "1/4" };
+				int downscale_index = m_cloudParameterCB.downscale == 2 ? 0 : 1;
+				if (ImGui::Combo("Resolution", &downscale_index, downscale_names, IM_ARRAYSIZE(downscale_names)))
+				{
+					m_cloudParameterCB.downscale = downscale_index == 0 ? 2 : 4;
+					CreateLowResBuffers();
+				}
+				ImGui::DragFloat("Upsample Depth Sigma", &m_cloudParameterCB.upsampleDepthSigma, 0.001f, 0.0f, 1.0f, "%.3f");
+				ImGui::SliderFloat("Upsample History Weight", &m_cloudParameterCB.upsampleHistoryWeight, 0.0f, 0.98f);
+				ImGui::Text("1 ray per %u pixels", m_cloudParameterCB.downscale * m_cloudParameterCB.downscale);
+			}
+			else if (m_useTemporal)
+			{
+				static const char* pattern_names[] = { "Bayer", "Halton", "Blue Noise" };
+				static const char* size_names[] = { "2x2", "4x4", "8x8", "16x16" };
+				int size_index = 0;
+				while ((2 << size_index) < m_updatePatternSize)
+					++size_index;
+				bool pattern_changed = ImGui::Combo("Update Pattern", &m_updatePattern, pattern_names, CloudUpdateScheduler::kNumPatterns);
+				if (ImGui::Combo("Pattern Size", &size_index, size_names, 4))
+				{
+					m_updatePatternSize = 2 << size_index;
+					pattern_changed = true;
+				}
+				if (pattern_changed)
+					CreateUpdateSchedule();
+				if (ImGui::SliderFloat("Ray Budget", &m_rayBudget, 1.0f / 256.0f, 1.0f, "%.4f", ImGuiSliderFlags_Logarithmic))
+					m_updateScheduler.SetRayBudget(m_rayBudget);
+				ImGui::DragFloat("Force Update Motion", &m_cloudParameterCB.forceUpdateMotion, 0.1f, 0.0f, 256.0f, "%.1f px");
+				if (ImGui::Button("Simulate Camera Path"))
+					SimulateUpdateSchedule();
+				if (!m_updateSimulation.frames.empty())
+				{
+					ImGui::Text("Rays / Frame: %.0f (max %.0f, forced %.0f)", m_updateSimulation.raysPerFrame, m_updateSimulation.maxRaysPerFrame, m_updateSimulation.forcedPerFrame);
+					ImGui::Text("Convergence Lag: %.2f frames (max %.1f)", m_updateSimulation.meanLag, m_updateSimulation.maxLag);
+					ImGui::Text("Reprojection RMSE: %.4f (max %.4f), %.2f s", m_updateSimulation.rmse, m_updateSimulation.maxRmse, m_updateSimulation.seconds);
+					std::vector<float> rays(m_updateSimulation.frames.size()), error(m_updateSimulation.frames.size());
+					for (size_t i = 0; i < rays.size(); ++i)
+					{
+						rays[i] = (float)(m_updateSimulation.frames[i].scheduledRays + m_updateSimulation.frames[i].forcedRays);
+						error[i] = m_updateSimulation.frames[i].rmse;
+					}
+					ImGui::PlotLines("Rays", rays.data(), (int)rays.size(), 0, nullptr, 0.0f, FLT_MAX, ImVec2(0.0f, 60.0f));
+					ImGui::PlotLines("RMSE", error.data(), (int)error.size(), 0, nullptr, 0.0f, FLT_MAX, ImVec2(0.0f, 60.0f));
+				}
+			}
+
+			ImGui::Separator();
+			bool sky_cube = m_useSkyCube;
+			ImGui::Checkbox("Sky Probe", &m_useSkyCube);
+			// the probe didn't follow the camera while it was off
+			if (m_useSkyCube && !sky_cube)
+				m_skyCubeScheduler.RefreshAll();
+			if (m_useSkyCube)
+			{
+				static const char* cube_size_names[] = { "32", "64", "128", "256" };
+				static const char* cube_tile_names[] = { "1x1", "2x2", "4x4" };
+				int cube_size_index = 0;
+				while ((32 << cube_size_index) < m_skyCubeSize)
+					++cube_size_index;
+				int cube_tile_index = m_skyCubeTiles == 1 ? 0 : (m_skyCubeTiles == 2 ? 1 : 2);
+				bool cube_changed = false;
+				if (ImGui::Combo("Probe Size", &cube_size_index, cube_size_names, IM_ARRAYSIZE(cube_size_names)))
+				{
+					m_skyCubeSize = 32 << cube_size_index;
+					cube_changed = true;
+				}
+				if (ImGui::Combo("Tiles Per Face", &cube_tile_index, cube_tile_names, IM_ARRAYSIZE(cube_tile_names)))
+				{
+					m_skyCubeTiles = 1 << cube_tile_index;
+					cube_changed = true;
+				}
+				if (cube_changed)
+					CreateSkyCube();
+				if (ImGui::SliderInt("Tiles Per Frame", &m_skyCubeBudget, 1, 6 * m_skyCubeTiles * m_skyCubeTiles))
+					m_skyCubeScheduler.SetBudget((uint32_t)m_skyCubeBudget);
+				ImGui::SliderFloat("Probe Sample Scale", &m_skyCubeSampleScale, 0.05f, 1.0f);
+				ImGui::Text("Refreshed every %u frames, %u x %u texels per tile", m_skyCubeScheduler.GetPeriod(), m_skyCubeScheduler.GetTileSize(), m_skyCubeScheduler.GetTileSize());
+				if (ImGui::Button("Refresh Probe"))
+					m_skyCubeScheduler.RefreshAll();
+				ImGui::DragFloat("Refresh Camera Jump", &m_skyCubeJumpDistance, 10.0f, 0.0f, 1.0e6f);
+				ImGui::SliderFloat("Refresh Sun Jump (deg)", &m_skyCubeJumpDegrees, 0.0f, 10.0f);
+				ImGui::Text("Refreshed %u times on a jump", m_skyCubeJumps);
+				ImGui::InputInt("Max Texel Age", &m_skyCubeMaxFrames);
+				m_skyCubeMaxFrames = std::max(m_skyCubeMaxFrames, 1);
+				ImGui::SameLine();
+				if (ImGui::Button("Verify Schedule"))
+					m_skyCubeReport = CloudCubemapScheduler::Verify(m_skyCubeScheduler.GetSize(), m_skyCubeScheduler.GetTilesPerFace(), m_skyCubeScheduler.GetBudget(),
+						(uint32_t)m_skyCubeMaxFrames, m_skyCubeScheduler.GetPeriod() * 4 + 1);
+				if (m_skyCubeReport.frames > 0)
+				{
+					ImGui::Text("%s: %u frames, max age %u (mean %.2f), %u stale, %u missed texels", m_skyCubeReport.passed ? "Passed" : "Failed",
+						m_skyCubeReport.frames, m_skyCubeReport.maxAge, m_skyCubeReport.meanAge, m_skyCubeReport.staleTexels, m_skyCubeReport.missedTexels);
+					ImGui::Text("Texels / Frame: %.0f (%.2f%% of the faces), BeginFrame %.0f ns", m_skyCubeReport.texelsPerFrame, m_skyCubeReport.rayFraction * 100.0f, m_skyCubeReport.beginFrameNanoseconds);
+				}
+			}
 
 			ImGui::Separator();
 			ImGui::Text("Cloud Distribution");
@@ -427,6 +1266,212 @@ void VolumetricCloud::UpdateUI()
 			ImGui::SliderFloat("HG Weight", &m_cloudParameterCB.HGWeight, 0.0f, 1.0f);
 			ImGui::SliderFloat("Cloud Exposure", &m_cloudParameterCB.Exposure, 0.0f, 1.0f);
 			ImGui::SliderFloat3("ABC", m_cloudParameterCB.ABC, 0.0f, 1.0f);
+			static const char* lighting_models[] = { "ABC", "Multiple Scattering Octaves" };
+			ImGui::Combo("Lighting Model", &m_cloudParameterCB.lightingModel, lighting_models, IM_ARRAYSIZE(lighting_models));
+			if (m_cloudParameterCB.lightingModel != 0)
+			{
+				ImGui::SliderInt("Octaves", &m_cloudParameterCB.msOctaves, 1, 8);
+				ImGui::SliderFloat("Octave Attenuation", &m_cloudParameterCB.msAttenuation, 0.0f, 1.0f);
+				ImGui::SliderFloat("Octave Contribution", &m_cloudParameterCB.msContribution, 0.0f, 1.0f);
+				ImGui::SliderFloat("Octave Eccentricity", &m_cloudParameterCB.msEccentricity, 0.0f, 1.0f);
+				ImGui::DragFloat("Octave Sun Scale", &m_cloudParameterCB.msSunScale, 0.05f, 0.0f, 100.0f);
+				ImGui::SliderFloat("Octave Ambient", &m_cloudParameterCB.msAmbient, 0.0f, 4.0f);
+			}
+			m_cloudParameterCB.msPhaseScale = CloudPathTracer::GetPhaseScale();
+
+			ImGui::Separator();
+			ImGui::Text("Raymarch Jitter");
+			bool use_blue_noise = (bool)m_cloudParameterCB.useBlueNoise;
+			ImGui::Checkbox("Blue Noise Jitter", &use_blue_noise);
+			m_cloudParameterCB.useBlueNoise = (int)use_blue_noise;
+			ImGui::InputInt("Blue Noise Seed", &m_blueNoiseSeed);
+			ImGui::SameLine();
+			if (ImGui::Button("Regenerate"))
+				CreateBlueNoise(true);
+			const auto& blue_noise_stats = m_blueNoiseGenerator.GetStats();
+			ImGui::Text("%ux%u, %u slices, %.2f s on %u threads", m_blueNoiseGenerator.GetSize(), m_blueNoiseGenerator.GetSize(),
+				m_blueNoiseGenerator.GetNumSlices(), blue_noise_stats.seconds, blue_noise_stats.numThreads);
+			ImGui::Text("Low Frequency Power Ratio: %.4f", blue_noise_stats.lowFrequencyRatio);
+			const auto& spectrum = m_blueNoiseGenerator.GetSpectrum();
+			ImGui::PlotLines("Spatial Spectrum", spectrum.data(), (int)spectrum.size(), 0, nullptr, 0.0f, FLT_MAX, ImVec2(0.0f, 60.0f));
+			const auto& temporal_spectrum = m_blueNoiseGenerator.GetTemporalSpectrum();
+			ImGui::PlotLines("Temporal Spectrum", temporal_spectrum.data(), (int)temporal_spectrum.size(), 0, nullptr, 0.0f, FLT_MAX, ImVec2(0.0f, 60.0f));
+			ImGui::EndTabItem();
+		}
+
+		if (ImGui::BeginTabItem("CPU Reference"))
+		{
+			ImGui::SliderInt("Downscale", &m_referenceDownscale, 1, 16);
+			bool empty_space_skipping = m_referenceRenderer.GetEmptySpaceSkipping();
+			ImGui::Checkbox("Empty Space Skipping", &empty_space_skipping);
+			m_referenceRenderer.SetEmptySpaceSkipping(empty_space_skipping);
+			const char* light_modes[] = { "Cone March", "Shadow Volume", "Shadow Volume (To Sun)" };
+			int light_mode = (int)m_referenceRenderer.GetLightMode();
+			ImGui::Combo("Sun Light", &light_mode, light_modes, IM_ARRAYSIZE(light_modes));
+			m_referenceRenderer.SetLightMode((CloudReferenceRenderer::LightMode)light_mode);
+			ImGui::Checkbox("Update Shadow Volume Every Frame", &m_referenceShadowUpdate);
+			ImGui::SameLine();
+			ImGui::SliderInt("Slices / Frame", &m_referenceShadowSlices, 1, 32);
+			if (ImGui::Button("Render Reference"))
+				RenderReference(kReferenceRender);
+			ImGui::SameLine();
+			if (ImGui::Button("Compare Skipping"))
+				RenderReference(kReferenceCompareSkipping);
+			ImGui::SameLine();
+			if (ImGui::Button("Compare Light"))
+				RenderReference(kReferenceCompareLighting);
+			ImGui::SameLine();
+			if (ImGui::Button("Compare Upsample"))
+				RenderReference(kReferenceCompareUpsampling);
+			ImGui::SameLine();
+			if (ImGui::Button("Compare Stepping"))
+				RenderReference(kReferenceCompareStepping);
+			ImGui::SliderInt("Max Dense Substeps", &m_referenceDenseFactor, 1, 32);
+			if (ImGui::Button("Benchmark Density Queries"))
+				RenderReference(kReferenceBenchmarkQueries);
+			static char golden_file[128] = "CloudGolden.bin";
+			ImGui::InputText("Golden File", golden_file, IM_ARRAYSIZE(golden_file));
+			std::string golden_name(golden_file);
+			static std::string compare_message;
+			if (ImGui::Button("Save Golden"))
+				compare_message = m_referenceRenderer.SaveGolden(std::wstring(golden_name.begin(), golden_name.end())) ? "Saved" : "Save failed";
+			ImGui::SameLine();
+			if (ImGui::Button("Compare Golden"))
+			{
+				CloudReferenceRenderer::CompareResult result = {};
+				bool match = m_referenceRenderer.CompareGolden(std::wstring(golden_name.begin(), golden_name.end()), 1e-3f, &result);
+				char buffer[128];
+				sprintf_s(buffer, "%s, RMSE %.6f, max %.6f, %u pixels differ", match ? "Match" : "Mismatch", result.rmse, result.maxError, result.numDifferent);
+				compare_message = buffer;
+			}
+			ImGui::Text("%s", compare_message.c_str());
+
+			const auto& totals = m_referenceRenderer.GetTotals();
+			ImGui::Separator();
+			ImGui::Text("%ux%u, %.2f s on %u threads", m_referenceRenderer.GetWidth(), m_referenceRenderer.GetHeight(), totals.seconds, totals.numThreads);
+			ImGui::Text("Rays: %llu, March Steps: %llu", totals.rays, totals.marchSteps);
+			ImGui::Text("Density Samples: %llu (expensive %llu, light %llu)", totals.densitySamples, totals.expensiveSamples, totals.lightSamples);
+			ImGui::Text("Slowest Tile: %.2f ms", totals.slowestTileMilliseconds);
+			ImGui::Text("Skipped Steps: %llu", totals.skippedSteps);
+
+			const auto& map_stats = m_referenceRenderer.GetEmptySpaceMap().GetStats();
+			ImGui::Separator();
+			ImGui::Text("Empty Space Map: %u levels, %.1f%% empty", map_stats.numLevels, map_stats.emptyFraction * 100.0f);
+			ImGui::Text("Build %.3f ms, last update %.3f ms (%u texels)", map_stats.buildMilliseconds, map_stats.updateMilliseconds, map_stats.updatedTexels);
+			ImGui::Text("Density Samples / Ray: %.1f -> %.1f", m_skippingReport.densitySamplesPerRay[0], m_skippingReport.densitySamplesPerRay[1]);
+			ImGui::Text("Light Samples / Ray: %.1f -> %.1f", m_skippingReport.lightSamplesPerRay[0], m_skippingReport.lightSamplesPerRay[1]);
+			ImGui::Text("Time: %.2f s -> %.2f s, max error %.6f", m_skippingReport.seconds[0], m_skippingReport.seconds[1], m_skippingReport.maxError);
+
+			const auto& shadow_volume = m_referenceRenderer.GetShadowVolume();
+			ImGui::Separator();
+			ImGui::Text("Shadow Volume: %u builds, last %.1f ms, progress %.0f%%", shadow_volume.GetStats().numBuilds,
+				shadow_volume.GetStats().lastBuildMilliseconds, shadow_volume.GetBuildProgress() * 100.0f);
+			ImGui::Text("Cone March %.2f s, %.1f light samples / ray", m_lightingReport.seconds[0], m_lightingReport.lightSamplesPerRay[0]);
+			ImGui::Text("Shadow Volume %.2f s + %.1f ms build, %.1f light samples / ray", m_lightingReport.seconds[1],
+				m_lightingReport.buildMilliseconds, m_lightingReport.lightSamplesPerRay[1]);
+			ImGui::Text("RMSE %.5f, max error %.5f", m_lightingReport.rmse, m_lightingReport.maxError);
+			ImGui::Separator();
+			ImGui::Text("Upsample 1/%u: %.2f s -> %.2f s at %ux%u", m_cloudParameterCB.downscale, m_upsampleReport.seconds[0], m_upsampleReport.seconds[1],
+				m_upsampleReport.width, m_upsampleReport.height);
+			ImGui::Text("RMSE %.5f, edges %.5f (%u pixels)", m_upsampleReport.rmse, m_upsampleReport.edgeRmse, m_upsampleReport.numEdgePixels);
+			ImGui::Text("Bilinear RMSE %.5f, edges %.5f", m_upsampleReport.bilinearRmse, m_upsampleReport.bilinearEdgeRmse);
+			ImGui::Separator();
+			static const char* stepping_names[] = { "Dense", "Uniform", "Adaptive" };
+			for (int i = 0; i < 3; ++i)
+			{
+				ImGui::Text("%s: %.2f s, %.1f density (%.1f expensive), %.1f light samples / ray", stepping_names[i], m_steppingReport.seconds[i],
+					m_steppingReport.densitySamplesPerRay[i], m_steppingReport.expensiveSamplesPerRay[i], m_steppingReport.lightSamplesPerRay[i]);
+			}
+			ImGui::Text("RMSE to dense: uniform %.5f (max %.5f), adaptive %.5f (max %.5f)", m_steppingReport.rmse[0], m_steppingReport.maxError[0],
+				m_steppingReport.rmse[1], m_steppingReport.maxError[1]);
+			ImGui::Text("Refinements / Ray: %.2f", m_steppingReport.refinementsPerRay);
+			ImGui::Text("Dense: %u substeps, RMSE %.5f to half of them", m_steppingReport.denseSubsteps, m_steppingReport.denseChange);
+			ImGui::Separator();
+			ImGui::Text("Density Queries on %u threads: %.2f M points / s, %.2f M batched, max diff %.6f", m_queryBenchmark.numThreads,
+				m_queryBenchmark.pointsPerSecond * 1e-6, m_queryBenchmark.batchPointsPerSecond * 1e-6, m_queryBenchmark.maxBatchError);
+			ImGui::Text("Optical Depth: %.2f M segments / s at %u steps", m_queryBenchmark.segmentsPerSecond * 1e-6, m_queryBenchmark.stepsPerSegment);
+
+			ImGui::Separator();
+			ImGui::Text("Multiple Scattering Path Tracer");
+			int trace_size[2] = { (int)m_pathTracerSettings.width, (int)m_pathTracerSettings.height };
+			int trace_samples = (int)m_pathTracerSettings.samplesPerPixel;
+			int trace_bounces = (int)m_pathTracerSettings.maxBounces;
+			ImGui::SliderInt2("Probe Size", trace_size, 8, 256);
+			ImGui::SliderInt("Paths / Pixel", &trace_samples, 1, 256);
+			ImGui::SliderInt("Max Bounces", &trace_bounces, 1, 4096);
+			ImGui::SliderFloat("Albedo", &m_pathTracerSettings.albedo, 0.5f, 1.0f);
+			m_pathTracerSettings.width = (uint32_t)trace_size[0];
+			m_pathTracerSettings.height = (uint32_t)trace_size[1];
+			m_pathTracerSettings.samplesPerPixel = (uint32_t)trace_samples;
+			m_pathTracerSettings.maxBounces = (uint32_t)trace_bounces;
+			if (ImGui::Button("Trace Paths"))
+				RenderReference(kReferenceTracePaths);
+			ImGui::SameLine();
+			if (ImGui::Button("Add Paths"))
+				RenderReference(kReferenceContinuePaths);
+			ImGui::SameLine();
+			ImGui::Checkbox("Every Frame", &m_pathTraceContinuous);
+			const auto& trace = m_pathTracer.GetReport();
+			ImGui::Text("%ux%u, %u paths / pixel, last %.2f s on %u threads", trace.width, trace.height, trace.samplesPerPixel, trace.seconds, trace.numThreads);
+			ImGui::Text("%.0f paths / s, %.2f M samples / s, %.1f scattering events / path, %llu cut", trace.pathsPerSecond,
+				trace.samplesPerSecond * 1e-6, trace.scatteringEventsPerPath, trace.truncatedPaths);
+			ImGui::Text("Majorant %.3f, %llu violations, phase integral %.3f", trace.majorant, trace.majorantViolations, trace.phaseIntegral);
+			ImGui::Text("Relative error on %u pixels: octaves %.4f, single %.4f, GetLightEnergy %.4f, noise %.4f", trace.cloudPixels,
+				trace.octaveError, trace.singleScatteringError, trace.legacyError, trace.noise);
+			int sweep_octaves[2] = { (int)m_sweepRange.minOctaves, (int)m_sweepRange.maxOctaves };
+			int sweep_steps = (int)m_sweepRange.steps;
+			ImGui::SliderInt2("Sweep Octaves", sweep_octaves, 1, 8);
+			ImGui::DragFloatRange2("Sweep Attenuation", &m_sweepRange.attenuation[0], &m_sweepRange.attenuation[1], 0.01f, 0.0f, 1.0f);
+			ImGui::DragFloatRange2("Sweep Contribution", &m_sweepRange.contribution[0], &m_sweepRange.contribution[1], 0.01f, 0.0f, 1.0f);
+			ImGui::DragFloatRange2("Sweep Eccentricity", &m_sweepRange.eccentricity[0], &m_sweepRange.eccentricity[1], 0.01f, 0.0f, 1.0f);
+			ImGui::SliderInt("Sweep Steps", &sweep_steps, 1, 64);
+			m_sweepRange.minOctaves = (uint32_t)sweep_octaves[0];
+			m_sweepRange.maxOctaves = (uint32_t)std::max(sweep_octaves[0], sweep_octaves[1]);
+			m_sweepRange.steps = (uint32_t)sweep_steps;
+			if (ImGui::Button("Sweep Octaves") && trace.samplesPerPixel > 0)
+				m_sweepResult = m_pathTracer.Sweep(m_sweepRange, m_pathTracerSettings.numThreads);
+			ImGui::SameLine();
+			if (ImGui::Button("Apply Best") && m_sweepResult.numCandidates > 0)
+			{
+				m_cloudParameterCB.lightingModel = 1;
+				m_cloudParameterCB.msOctaves = (int)m_sweepResult.best.count;
+				m_cloudParameterCB.msAttenuation = m_sweepResult.best.attenuation;
+				m_cloudParameterCB.msContribution = m_sweepResult.best.contribution;
+				m_cloudParameterCB.msEccentricity = m_sweepResult.best.eccentricity;
+			}
+			ImGui::Text("%u candidates in %.2f s (%.0f / s), best %u octaves a %.3f b %.3f c %.3f, error %.4f", m_sweepResult.numCandidates,
+				m_sweepResult.seconds, m_sweepResult.candidatesPerSecond, m_sweepResult.best.count, m_sweepResult.best.attenuation,
+				m_sweepResult.best.contribution, m_sweepResult.best.eccentricity, m_sweepResult.bestError);
+			if (m_referenceImage->GetResource() != nullptr)
+			{
+				static bool reference_detail = false;
+				static bool reference_window_opening = false;
+				ImGui::PreviewImageButton(m_referenceImage.get(), ImVec2(256.0f, 256.0f * m_referenceRenderer.GetHeight() / m_referenceRenderer.GetWidth()),
+					"Cloud Reference", &reference_detail, &reference_window_opening);
+			}
+			ImGui::EndTabItem();
+		}
+
+		if (ImGui::BeginTabItem("Self Tests"))
+		{
+			if (ImGui::Button("Run Self Tests"))
+				m_selfTestResults = SelfTest::RunAll();
+			if (!m_selfTestResults.empty())
+			{
+				ImGui::SameLine();
+				ImGui::Text("%u of %u failed", SelfTest::CountFailed(m_selfTestResults), (uint32_t)m_selfTestResults.size());
+			}
+			for (const SelfTest::Result& result : m_selfTestResults)
+			{
+				ImGui::Separator();
+				ImGui::TextColored(result.Passed() ? ImVec4(0.4f, 1.0f, 0.4f, 1.0f) : ImVec4(1.0f, 0.3f, 0.3f, 1.0f), "%s %s", result.Passed() ? "PASS" : "FAIL",
+					result.name.c_str());
+				ImGui::SameLine();
+				ImGui::Text("%.2f s", result.seconds);
+				ImGui::TextWrapped("%s", result.summary.c_str());
+				if (!result.Passed())
+					ImGui::TextWrapped("%s", result.violations.Dump().c_str());
+			}
 			ImGui::EndTabItem();
 		}
 
@@ -519,64 +1564,431 @@ void VolumetricCloud::DrawOnSkybox(const Timer& timer)
 
 void VolumetricCloud::DrawOnQuad(const Timer& timer)
 {
+	CloudGraphKey key = GetCloudGraphKey();
+	if (!(key == m_cloudGraphKey))
+	{
+		m_cloudGraph.Reset();
+		DeclareCloudGraph(m_cloudGraph, key);
+		m_cloudGraphKey = key;
+	}
+
 	ComputeContext& context = ComputeContext::Begin();
-	context.SetRootSignature(m_computeCloudOnQuadRS);
-	context.TransitionResource(*m_basicCloudShape, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-	context.TransitionResource(*m_worley, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-	context.TransitionResource(*const_cast<Texture2D*>(m_weatherTexture), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-	context.TransitionResource(*m_sceneColorBuffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-	if (m_useTemporal)
-	{
-		context.TransitionResource(*m_cloudTempBuffer, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-		context.SetPipelineState(m_temporalCloudPSO);
-		context.SetDynamicConstantBufferView(0, sizeof(m_passCB), &m_passCB);
-		context.SetDynamicDescriptor(1, 0, m_basicCloudShape->GetSRV());
-		context.SetDynamicDescriptor(1, 1, m_erosionTexture->GetSRV());
-		context.SetDynamicDescriptor(1, 2, m_weatherTexture->GetSRV());
-		context.SetDynamicDescriptor(1, 3, m_cloudTempBuffer->GetSRV());
-		context.SetDynamicDescriptor(1, 4, m_curlNoise2D->GetSRV());
-		context.SetDynamicDescriptor(1, 5, Atmosphere::GetTransmittance()->GetSRV());
-		context.SetDynamicDescriptor(1, 6, Atmosphere::GetScattering()->GetSRV());
-		context.SetDynamicDescriptor(1, 7, Atmosphere::GetIrradiance()->GetSRV());
-		if (!Atmosphere::UseCombinedScatteringTexture())
-			context.SetDynamicDescriptor(1, 8, Atmosphere::GetOptionalScattering()->GetSRV());
-		context.SetDynamicDescriptor(2, 0, m_sceneColorBuffer->GetUAV());
-		context.SetDynamicConstantBufferView(3, sizeof(Atmosphere::AtmosphereCB), Atmosphere::GetAtmosphereCB());
-		context.SetDynamicConstantBufferView(4, sizeof(m_cloudParameterCB), &m_cloudParameterCB);
-		context.Dispatch2D(m_sceneColorBuffer->GetWidth(), m_sceneColorBuffer->GetHeight());
-
-		context.TransitionResource(*m_cloudTempBuffer, D3D12_RESOURCE_STATE_COPY_DEST);
-		context.TransitionResource(*m_sceneColorBuffer, D3D12_RESOURCE_STATE_COPY_SOURCE);
-		context.CopySubresource(*m_cloudTempBuffer, 0, *m_sceneColorBuffer, 0);
+	// an upload leaves what it wrote in COPY_DEST, back to the state the cloud passes read it
+	// in, the one the graph was compiled with, or it would compile again every frame
+	const D3D12_RESOURCE_STATES srv = D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
+	if (m_useProceduralWeather)
+	{
+		const uint32_t size = m_weatherGenerator.GetDesc().size, tile_size = m_weatherGenerator.GetDesc().tileSize;
+		for (uint32_t tile : m_weatherGenerator.TakePendingTiles())
+		{
+			uint32_t x = (tile % m_weatherGenerator.GetTilesPerRow()) * tile_size, y = (tile / m_weatherGenerator.GetTilesPerRow()) * tile_size;
+			context.UploadTextureRegion(*m_proceduralWeather, x, y, tile_size, tile_size, m_weatherGenerator.GetPixels() + (size_t)y * size + x, size * sizeof(uint32_t));
+		}
+		context.TransitionResource(*m_proceduralWeather, srv);
+	}
+	if (m_useVirtualWeather)
+	{
+		// slots first, the indirection may already point at them
+		const CloudVirtualWeather::Desc& desc = m_virtualWeather.GetDesc();
+		const uint32_t atlas_size = m_virtualWeather.GetAtlasSize(), texels = desc.tileTexels;
+		for (uint32_t slot : m_virtualWeather.TakeDirtySlots())
+		{
+			uint32_t x = (slot % desc.atlasSlots) * texels, y = (slot / desc.atlasSlots) * texels;
+			context.UploadTextureRegion(*m_virtualWeatherAtlas, x, y, texels, texels, m_virtualWeather.GetAtlas() + (size_t)y * atlas_size + x, atlas_size * sizeof(uint32_t));
+		}
+		if (m_virtualWeather.TakeIndirectionDirty())
+			context.UploadTexture(*m_weatherIndirection, m_virtualWeather.GetIndirection(), desc.tilesX * sizeof(uint32_t));
+		context.TransitionResource(*m_virtualWeatherAtlas, srv);
+		context.TransitionResource(*m_weatherIndirection, srv);
+	}
+	if (m_heightLutDirty)
+	{
+		context.UploadTexture(*m_heightLutTexture, m_heightLut.GetTable().data(), m_heightLut.GetWidth() * sizeof(float));
+		context.TransitionResource(*m_heightLutTexture, srv);
+		m_heightLutDirty = false;
+	}
+	if (m_cloudShadowDirty)
+	{
+		const CloudShadowMap::Desc& shadow_desc = m_cloudShadowMap.GetDesc();
+		context.UploadTexture(*m_cloudShadowTexture, m_cloudShadowMap.GetOpticalDepth().data(), shadow_desc.size * sizeof(float));
+		context.TransitionResource(*m_cloudShadowTexture, srv);
+		m_cloudShadowDirty = false;
+	}
+	if (m_shadowVolumeDirty)
+	{
+		const CloudShadowVolume& volume = m_referenceRenderer.GetShadowVolume();
+		context.UploadTexture(*m_shadowVolumeTexture, volume.GetOpticalDepth().data(), volume.GetDesc().width * sizeof(float));
+		context.TransitionResource(*m_shadowVolumeTexture, srv);
+		m_shadowVolumeDirty = false;
+	}
+
+	if (m_computeToQuarter)
+	{
+		// a still ray position when there is no history to fill in the rest of the block
+		float downscale = (float)m_cloudParameterCB.downscale;
+		const float* jitter = kLowResJitter[m_frameIndex % 16];
+		bool use_history = m_cloudParameterCB.upsampleHistoryWeight > 0.0f;
+		m_cloudParameterCB.lowResJitter[0] = use_history ? jitter[0] * downscale : 0.5f * downscale;
+		m_cloudParameterCB.lowResJitter[1] = use_history ? jitter[1] * downscale : 0.5f * downscale;
+	}
+	else if (m_useTemporal)
+	{
+		// the slot this frame copies to holds the count of kForcedRaySlots frames ago
+		uint64_t& fence = m_forcedRayFences[m_forcedRaySlot];
+		if (fence != 0 && g_CommandManager.IsFenceComplete(fence))
+		{
+			const uint32_t* forced_rays = (const uint32_t*)m_forcedRayReadback.Map();
+			m_updateScheduler.EndFrame(forced_rays[m_forcedRaySlot]);
+			m_forcedRayReadback.Unmap();
+		}
+		fence = 0;
+
+		auto frame = m_updateScheduler.BeginFrame((uint32_t)(m_sceneColorBuffer->GetWidth() * m_sceneColorBuffer->GetHeight()));
+		m_cloudParameterCB.scheduleWindowStart = frame.windowStart;
+		m_cloudParameterCB.scheduleWindowCount = frame.windowCount;
+	}
+
+	SetCloudRootSignature(context);
+	m_cloudGraph.Execute(context);
+	uint64_t fence = context.Finish();
+	if (key.temporal && !key.quarter)
+	{
+		m_forcedRayFences[m_forcedRaySlot] = fence;
+		m_forcedRaySlot = (m_forcedRaySlot + 1) % kForcedRaySlots;
+	}
+}
+
+VolumetricCloud::CloudGraphKey VolumetricCloud::GetCloudGraphKey() const
+{
+	CloudGraphKey key;
+	key.quarter = m_computeToQuarter;
+	key.temporal = m_useTemporal;
+	key.skyCube = m_useSkyCube;
+	key.basicCloudShape = m_basicCloudShape;
+	key.weather = m_weatherTexture;
+	return key;
+}
+
+void VolumetricCloud::DeclareNoiseGraph(FrameGraphExecutor& graph)
+{
+	const D3D12_RESOURCE_STATES uav = D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+	const D3D12_RESOURCE_STATES srv = D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
+	FrameGraph::Handle perlin_worley = graph.Import(*m_perlinWorley, "Perlin Worley", srv);
+	FrameGraph::Handle worley = graph.Import(*m_worley, "Worley", srv);
+	FrameGraph::Handle perlin_worley_ue = graph.Import(*m_perlinWorleyUE, "Perlin Worley UE", srv);
+	FrameGraph::Handle pass;
+
+	pass = graph.AddPass("Perlin Worley", [this](CommandContext& commandContext)
+	{
+		ComputeContext& context = commandContext.GetComputeContext();
+		context.SetRootSignature(m_generateNoiseRS);
+		context.SetPipelineState(m_generatePerlinWorleyPSO);
+		context.SetDynamicDescriptor(0, 0, m_perlinWorley->GetUAV());
+		context.Dispatch3D(m_perlinWorley->GetWidth(), m_perlinWorley->GetHeight(), m_perlinWorley->GetDepth(), 8, 8, 8);
+	});
+	graph.Write(pass, perlin_worley, uav);
+
+	pass = graph.AddPass("Worley", [this](CommandContext& commandContext)
+	{
+		ComputeContext& context = commandContext.GetComputeContext();
+		context.SetRootSignature(m_generateNoiseRS);
+		context.SetPipelineState(m_generateWorleyPSO);
+		context.SetDynamicDescriptor(0, 0, m_worley->GetUAV());
+		context.Dispatch3D(m_worley->GetWidth(), m_worley->GetHeight(), m_worley->GetDepth(), 8, 8, 8);
+	});
+	graph.Write(pass, worley, uav);
+
+	// GenerateMipMaps reads the top mip through the SRV with the whole volume in UNORDERED_ACCESS
+	pass = graph.AddPass("Perlin Worley Mips", [this](CommandContext& context) { m_perlinWorley->GenerateMipMaps(context); });
+	graph.Write(pass, perlin_worley, uav);
+	pass = graph.AddPass("Worley Mips", [this](CommandContext& context) { m_worley->GenerateMipMaps(context); });
+	graph.Write(pass, worley, uav);
+	pass = graph.AddPass("Perlin Worley UE Mips", [this](CommandContext& context) { m_perlinWorleyUE->GenerateMipMaps(context); });
+	graph.Write(pass, perlin_worley_ue, uav);
+}
+
+void VolumetricCloud::DeclareCloudGraph(FrameGraphExecutor& graph, const CloudGraphKey& key)
+{
+	const D3D12_RESOURCE_STATES uav = D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+	const D3D12_RESOURCE_STATES srv = D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
+	// what every cloud pass reads, written only by the uploads before the graph
+	const FrameGraph::Handle textures[] =
+	{
+		graph.Import(*m_basicCloudShape, "Basic Cloud Shape"),
+		graph.Import(*m_worley, "Worley"),
+		graph.Import(*const_cast<Texture2D*>(m_weatherTexture), "Weather"),
+		graph.Import(*m_weatherIndirection, "Weather Indirection"),
+		graph.Import(*m_heightLutTexture, "Height Lut"),
+		graph.Import(*m_mieLutTexture, "Mie Lut"),
+		graph.Import(*m_cloudShadowTexture, "Cloud Shadow"),
+		graph.Import(*m_shadowVolumeTexture, "Shadow Volume"),
+	};
+	auto read_textures = [&graph, &textures, srv](FrameGraph::Handle pass)
+	{
+		for (FrameGraph::Handle texture : textures)
+			graph.Read(pass, texture, srv);
+	};
+	FrameGraph::Handle scene_color = graph.Import(*m_sceneColorBuffer, "Scene Color");
+	FrameGraph::Handle pass;
+
+	if (key.quarter || key.temporal)
+	{
+		FrameGraph::Handle cloud_temp = graph.Import(*m_cloudTempBuffer, "Cloud History");
+		if (key.quarter)
+		{
+			FrameGraph::Handle quarter = graph.Import(*m_quarterBuffer, "Quarter", FrameGraph::kKeepState, false);
+			FrameGraph::Handle quarter_depth = graph.Import(*m_quarterDepthBuffer, "Quarter Depth", FrameGraph::kKeepState, false);
+			pass = graph.AddPass("Quarter Cloud", [this](CommandContext& commandContext)
+			{
+				ComputeContext& context = commandContext.GetComputeContext();
+				context.SetPipelineState(m_bindlessGraph ? m_bindlessQuarterCloudPSO : m_quarterCloudPSO);
+				context.SetDynamicConstantBufferView(0, sizeof(m_passCB), &m_passCB);
+				SetCloudTextures(context);
+				context.SetDynamicDescriptor(2, 0, m_quarterBuffer->GetUAV());
+				context.SetDynamicDescriptor(2, 1, m_quarterDepthBuffer->GetUAV());
+				context.SetDynamicConstantBufferView(3, sizeof(Atmosphere::AtmosphereCB), Atmosphere::GetAtmosphereCB());
+				context.SetDynamicConstantBufferView(4, sizeof(m_cloudParameterCB), &m_cloudParameterCB);
+				CommitCloudSRVs(context);
+				context.Dispatch2D(m_quarterBuffer->GetWidth(), m_quarterBuffer->GetHeight());
+			});
+			read_textures(pass);
+			graph.Write(pass, quarter, uav);
+			graph.Write(pass, quarter_depth, uav);
+
+			pass = graph.AddPass("Upsample Cloud", [this](CommandContext& commandContext)
+			{
+				ComputeContext& context = commandContext.GetComputeContext();
+				context.SetPipelineState(m_bindlessGraph ? m_bindlessUpsampleCloudPSO : m_upsampleCloudPSO);
+				SetCloudSRV(context, 3, *m_cloudTempBuffer);
+				SetCloudSRV(context, 10, *m_quarterBuffer);
+				SetCloudSRV(context, 11, *m_quarterDepthBuffer);
+				context.SetDynamicDescriptor(2, 0, m_sceneColorBuffer->GetUAV());
+				CommitCloudSRVs(context);
+				context.Dispatch2D(m_sceneColorBuffer->GetWidth(), m_sceneColorBuffer->GetHeight());
+			});
+			read_textures(pass);
+			graph.Read(pass, cloud_temp, srv);
+			graph.Read(pass, quarter, srv);
+			graph.Read(pass, quarter_depth, srv);
+			graph.Write(pass, scene_color, uav);
+		}
+		else
+		{
+			FrameGraph::Handle forced_rays = graph.Import(m_forcedRayCounter, "Forced Rays");
+			FrameGraph::Handle update_schedule = graph.Import(*m_updateScheduleTexture, "Update Schedule");
+			pass = graph.AddPass("Clear Forced Rays", [this](CommandContext& context)
+			{
+				context.GetComputeContext().ClearUAV(m_forcedRayCounter);
+			});
+			graph.Write(pass, forced_rays, uav);
+
+			pass = graph.AddPass("Temporal Cloud", [this](CommandContext& commandContext)
+			{
+				ComputeContext& context = commandContext.GetComputeContext();
+				context.SetPipelineState(m_bindlessGraph ? m_bindlessTemporalCloudPSO : m_temporalCloudPSO);
+				context.SetDynamicConstantBufferView(0, sizeof(m_passCB), &m_passCB);
+				SetCloudTextures(context);
+				SetCloudSRV(context, 3, *m_cloudTempBuffer);
+				SetCloudSRV(context, 10, *m_updateScheduleTexture);
+				context.SetDynamicDescriptor(2, 0, m_sceneColorBuffer->GetUAV());
+				context.SetDynamicDescriptor(2, 1, m_forcedRayCounter.GetUAV());
+				context.SetDynamicConstantBufferView(3, sizeof(Atmosphere::AtmosphereCB), Atmosphere::GetAtmosphereCB());
+				context.SetDynamicConstantBufferView(4, sizeof(m_cloudParameterCB), &m_cloudParameterCB);
+				CommitCloudSRVs(context);
+				context.Dispatch2D(m_sceneColorBuffer->GetWidth(), m_sceneColorBuffer->GetHeight());
+			});
+			read_textures(pass);
+			graph.Read(pass, cloud_temp, srv);
+			graph.Read(pass, update_schedule, srv);
+			graph.Write(pass, scene_color, uav);
+			graph.Write(pass, forced_rays, uav);
+
+			// the readback stays in COPY_DEST, it isn't tracked by the graph
+			pass = graph.AddPass("Read Back Forced Rays", [this](CommandContext& context)
+			{
+				context.CopyBufferRegion(m_forcedRayReadback, m_forcedRaySlot * sizeof(uint32_t), m_forcedRayCounter, 0, sizeof(uint32_t));
+			});
+			graph.Read(pass, forced_rays, D3D12_RESOURCE_STATE_COPY_SOURCE);
+		}
+
+		// the history of the next frame
+		pass = graph.AddPass("Copy Cloud History", [this](CommandContext& context)
+		{
+			context.CopySubresource(*m_cloudTempBuffer, 0, *m_sceneColorBuffer, 0);
+		});
+		graph.Read(pass, scene_color, D3D12_RESOURCE_STATE_COPY_SOURCE);
+		graph.Write(pass, cloud_temp, D3D12_RESOURCE_STATE_COPY_DEST);
 	}
 	else
 	{
-		context.SetPipelineState(m_computeCloudOnQuadPSO);
-		context.SetDynamicConstantBufferView(0, sizeof(m_passCB), &m_passCB);
-		context.SetDynamicDescriptor(1, 0, m_basicCloudShape->GetSRV());
-		context.SetDynamicDescriptor(1, 1, m_erosionTexture->GetSRV());
-		context.SetDynamicDescriptor(1, 2, m_weatherTexture->GetSRV());
-		context.SetDynamicDescriptor(1, 4, m_curlNoise2D->GetSRV());
-		context.SetDynamicDescriptor(1, 5, Atmosphere::GetTransmittance()->GetSRV());
-		context.SetDynamicDescriptor(1, 6, Atmosphere::GetScattering()->GetSRV());
-		context.SetDynamicDescriptor(1, 7, Atmosphere::GetIrradiance()->GetSRV());
-		if (!Atmosphere::UseCombinedScatteringTexture())
-			context.SetDynamicDescriptor(1, 8, Atmosphere::GetOptionalScattering()->GetSRV());
-		context.SetDynamicDescriptor(2, 0, m_sceneColorBuffer->GetUAV());
-		context.SetDynamicConstantBufferView(3, sizeof(Atmosphere::AtmosphereCB), Atmosphere::GetAtmosphereCB());
-		context.SetDynamicConstantBufferView(4, sizeof(m_cloudParameterCB), &m_cloudParameterCB);
-		context.Dispatch2D(m_sceneColorBuffer->GetWidth(), m_sceneColorBuffer->GetHeight());
+		pass = graph.AddPass("Cloud", [this](CommandContext& commandContext)
+		{
+			ComputeContext& context = commandContext.GetComputeContext();
+			context.SetPipelineState(m_bindlessGraph ? m_bindlessCloudPSO : m_computeCloudOnQuadPSO);
+			context.SetDynamicConstantBufferView(0, sizeof(m_passCB), &m_passCB);
+			SetCloudTextures(context);
+			context.SetDynamicDescriptor(2, 0, m_sceneColorBuffer->GetUAV());
+			context.SetDynamicConstantBufferView(3, sizeof(Atmosphere::AtmosphereCB), Atmosphere::GetAtmosphereCB());
+			context.SetDynamicConstantBufferView(4, sizeof(m_cloudParameterCB), &m_cloudParameterCB);
+			CommitCloudSRVs(context);
+			context.Dispatch2D(m_sceneColorBuffer->GetWidth(), m_sceneColorBuffer->GetHeight());
+		});
+		read_textures(pass);
+		graph.Write(pass, scene_color, uav);
+	}
+
+	if (key.skyCube)
+	{
+		FrameGraph::Handle sky_cube = graph.Import(*m_skyCube, "Sky Cube", srv);
+		pass = graph.AddPass("Sky Cube", [this](CommandContext& context) { DrawSkyCube(context.GetComputeContext()); });
+		read_textures(pass);
+		graph.Write(pass, sky_cube, uav);
+	}
+}
+
+SelfTest::Result VolumetricCloud::CheckRenderGraphs(const char* name)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	SelfTest::Result result;
+	result.name = name;
+	uint32_t graphs = 0, passes = 0, barriers = 0;
+	// compiled for the states the resources are in now, nothing is recorded
+	auto check = [&](FrameGraphExecutor& graph)
+	{
+		result.violations.Add("not compiled", !graph.Compile());
+		FrameGraphBenchmark::AddViolations(graph.GetGraph().Verify(), result.violations);
+		FrameGraph::Stats stats = graph.GetGraph().GetStats();
+		graphs++;
+		passes += stats.passes;
+		barriers += stats.transitions + stats.splitTransitions * 2 + stats.uavBarriers;
+		graph.Reset();
+	};
+
+	FrameGraphExecutor graph;
+	DeclareNoiseGraph(graph);
+	check(graph);
+	for (uint32_t i = 0; i < 6; ++i)
+	{
+		CloudGraphKey key = GetCloudGraphKey();
+		key.quarter = i / 2 == 0;
+		key.temporal = i / 2 == 1;
+		key.skyCube = i % 2 != 0;
+		DeclareCloudGraph(graph, key);
+		check(graph);
+	}
+	for (uint32_t i = 0; i < 8; ++i)
+	{
+		PostProcess::DeclareGraph(graph, (i & 4) != 0, (i & 2) != 0, (i & 1) != 0);
+		check(graph);
+	}
+
+	result.seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	char summary[128];
+	snprintf(summary, sizeof(summary), "%u graphs, %u passes, %u barriers", graphs, passes, barriers);
+	result.summary = summary;
+	return result;
+}
+
+void VolumetricCloud::DrawSkyCube(ComputeContext& context)
+{
+	// the round robin would show the old and the new view side by side for a whole period
+	const XMFLOAT3& camera = m_passCB.cameraPosition;
+	const XMFLOAT3& light = m_passCB.lightDir;
+	float dx = camera.x - m_skyCubeCamera.x, dy = camera.y - m_skyCubeCamera.y, dz = camera.z - m_skyCubeCamera.z;
+	float cos_light = light.x * m_skyCubeLight.x + light.y * m_skyCubeLight.y + light.z * m_skyCubeLight.z;
+	if (dx * dx + dy * dy + dz * dz > m_skyCubeJumpDistance * m_skyCubeJumpDistance ||
+		cos_light < std::cos(XMConvertToRadians(m_skyCubeJumpDegrees)))
+	{
+		m_skyCubeScheduler.RefreshAll();
+		m_skyCubeJumps++;
+	}
+	m_skyCubeCamera = camera;
+	m_skyCubeLight = light;
+
+	const std::vector<CloudCubemapScheduler::Tile>& tiles = m_skyCubeScheduler.BeginFrame();
+	if (tiles.empty())
+		return;
+
+	// the probe is small and blurred by the reflections, fewer steps do
+	CloudParameterCB cube_cb = m_cloudParameterCB;
+	cube_cb.sampleCountMin = std::max(1, (int)(m_cloudParameterCB.sampleCountMin * m_skyCubeSampleScale));
+	cube_cb.sampleCountMax = std::max(cube_cb.sampleCountMin, (int)(m_cloudParameterCB.sampleCountMax * m_skyCubeSampleScale));
+
+	context.SetPipelineState(m_bindlessGraph ? m_bindlessSkyCubePSO : m_skyCubePSO);
+	context.SetDynamicConstantBufferView(0, sizeof(m_passCB), &m_passCB);
+	SetCloudTextures(context);
+	context.SetDynamicDescriptor(2, 1, m_skyCube->GetUAV());
+	context.SetDynamicConstantBufferView(3, sizeof(Atmosphere::AtmosphereCB), Atmosphere::GetAtmosphereCB());
+	CommitCloudSRVs(context);
+
+	// one dispatch per tile, the tiles of a frame write disjoint texels
+	const uint32_t tile_size = m_skyCubeScheduler.GetTileSize();
+	for (const CloudCubemapScheduler::Tile& tile : tiles)
+	{
+		cube_cb.cubeFace = (int)tile.face;
+		cube_cb.cubeTileOrigin[0] = tile.x;
+		cube_cb.cubeTileOrigin[1] = tile.y;
+		context.SetDynamicConstantBufferView(4, sizeof(cube_cb), &cube_cb);
+		context.Dispatch2D(tile_size, tile_size);
 	}
-	context.Finish();
 }
 
 void VolumetricCloud::OnResize()
 {
 	App::OnResize();
-	m_quarterBuffer->Destroy();
-	m_quarterBuffer->Create(L"Quarter Buffer", m_clientWidth / 4, m_clientHeight / 4, 1, m_sceneBufferFormat);
+	CreateLowResBuffers();
 	m_cloudTempBuffer->Destroy();
 	m_cloudTempBuffer->Create(L"Cloud Temp Buffer", m_clientWidth, m_clientHeight, 1, m_sceneBufferFormat);
 	m_mipmapTestBuffer->Destroy();
 	m_mipmapTestBuffer->Create(L"Generate Mips Buffer", m_clientWidth, m_clientHeight, 0, m_sceneBufferFormat);
+}
+
+void VolumetricCloud::SetCloudRootSignature(ComputeContext& context)
+{
+	// the UAV tables and the clears of the cloud graph, with room to spare
+	const uint32_t graph_descriptors = 64;
+	m_bindlessGraph = m_useBindless && context.ReserveBindless(graph_descriptors);
+	if (m_bindlessGraph)
+	{
+		context.SetRootSignature(m_bindlessCloudRS);
+		context.SetBindlessTable(1);
+	}
+	else
+	{
+		context.SetRootSignature(m_computeCloudOnQuadRS);
+	}
+}
+
+template <class Resource>
+void VolumetricCloud::SetCloudSRV(ComputeContext& context, uint32_t slot, const Resource& resource)
+{
+	if (m_bindlessGraph)
+		m_bindlessSlots[slot] = resource.GetBindlessSRV();
+	else
+		context.SetDynamicDescriptor(1, slot, resource.GetSRV());
+}
+
+void VolumetricCloud::SetCloudTextures(ComputeContext& context)
+{
+	SetCloudSRV(context, 0, *m_basicCloudShape);
+	SetCloudSRV(context, 1, *m_erosionTexture);
+	SetCloudSRV(context, 2, *m_weatherTexture);
+	SetCloudSRV(context, 4, *m_curlNoise2D);
+	SetCloudSRV(context, 5, *Atmosphere::GetTransmittance());
+	SetCloudSRV(context, 6, *Atmosphere::GetScattering());
+	SetCloudSRV(context, 7, *Atmosphere::GetIrradiance());
+	if (!Atmosphere::UseCombinedScatteringTexture())
+		SetCloudSRV(context, 8, *Atmosphere::GetOptionalScattering());
+	SetCloudSRV(context, 9, *m_blueNoiseTexture);
+	SetCloudSRV(context, 12, *m_cloudShadowTexture);
+	SetCloudSRV(context, 13, *m_weatherIndirection);
+	SetCloudSRV(context, 14, *m_heightLutTexture);
+	SetCloudSRV(context, 15, *m_mieLutTexture);
+	SetCloudSRV(context, 16, *m_shadowVolumeTexture);
+}
+
+void VolumetricCloud::CommitCloudSRVs(ComputeContext& context)
+{
+	if (m_bindlessGraph)
+		context.SetConstantArray(5, _countof(m_bindlessSlots), m_bindlessSlots);
 }
\ No newline at end of file
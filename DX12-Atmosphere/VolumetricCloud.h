@@ -1,8 +1,22 @@
 #pragma once
 #include "App/App.h"
 #include "Volumetric/CloudShapeManager.h"
+#include "Volumetric/CloudParameters.h"
+#include "Volumetric/CloudReferenceRenderer.h"
+#include "Volumetric/CloudShadowMap.h"
+#include "Volumetric/CloudWeatherGenerator.h"
+#include "Volumetric/CloudVirtualWeather.h"
+#include "Volumetric/CloudHeightLut.h"
+#include "Volumetric/CloudMiePhase.h"
+#include "Volumetric/CloudPathTracer.h"
+#include "Volumetric/CloudUpdateSimulation.h"
+#include "Volumetric/CloudCubemapScheduler.h"
+#include "Noise/BlueNoiseGenerator.h"
+#include "D3D12/FrameGraphExecutor.h"
+#include "Utils/SelfTest.h"
 
 class Camera;
+class ComputeContext;
 class Mesh;
 class Texture2D;
 class Texture3D;
@@ -26,10 +40,72 @@ private:
 	void CreateMeshes();
 	void CreateCamera();
 	void CreateNoise();
+	void CreateBlueNoise(bool regenerate);
+	void CreateUpdateSchedule();
+	void SimulateUpdateSchedule();
+	void CreateLowResBuffers();
+	void CreateSkyCube();
+	enum ReferenceAction
+	{
+		kReferenceRender,
+		kReferenceCompareSkipping,
+		kReferenceCompareLighting,
+		kReferenceCompareUpsampling,
+		kReferenceCompareStepping,
+		kReferenceBenchmarkQueries,
+		kReferenceMeasureShadowMap,
+		kReferenceTracePaths,
+		kReferenceContinuePaths
+	};
+	// false if one of them has a format the CPU side can't read
+	bool ReadBackReferenceTextures();
+	void RenderReference(ReferenceAction action);
+	void GetCloudShadowBuild(CloudShadowMap::Desc& desc, CloudShadowMap::BuildParams& params) const;
+	void UpdateCloudShadowMap();
+	void CreateCloudShadowTexture();
+	void UpdateShadowVolumeTexture();
+	void CreateShadowVolumeTexture();
+	void CreateProceduralWeather();
+	void CreateVirtualWeather();
+	void CreateHeightLut();
+	void BakeMiePhase();
 	void SwitchBasicCloudShape(int idx);
 
 	void DrawOnSkybox(const Timer& timer);
 	void DrawOnQuad(const Timer& timer);
+	void DrawSkyCube(ComputeContext& context);
+
+	// what the graph of DrawOnQuad is declared for, the textures are imported by pointer
+	struct CloudGraphKey
+	{
+		bool quarter;
+		bool temporal;
+		bool skyCube;
+		const void* basicCloudShape;
+		const void* weather;
+
+		bool operator==(const CloudGraphKey& other) const
+		{
+			return quarter == other.quarter && temporal == other.temporal && skyCube == other.skyCube &&
+				basicCloudShape == other.basicCloudShape && weather == other.weather;
+		}
+	};
+	CloudGraphKey GetCloudGraphKey() const;
+	// the passes and what they access, the barriers between them come from the FrameGraph
+	void DeclareNoiseGraph(FrameGraphExecutor& graph);
+	void DeclareCloudGraph(FrameGraphExecutor& graph, const CloudGraphKey& key);
+	// the noise graph, the cloud graph of every path and the post process graph of every
+	// setting compiled and verified, registered with SelfTest
+	SelfTest::Result CheckRenderGraphs(const char* name);
+
+	// SRV slot n of the cloud shaders, staged in the table or kept for the root constants
+	// of the bindless variants, CommitCloudSRVs sets those before a dispatch
+	void SetCloudRootSignature(ComputeContext& context);
+	template <class Resource>
+	void SetCloudSRV(ComputeContext& context, uint32_t slot, const Resource& resource);
+	// the textures every cloud pass reads
+	void SetCloudTextures(ComputeContext& context);
+	void CommitCloudSRVs(ComputeContext& context);
 
 	CloudShapeManager m_cloudShapeManager;
 
@@ -48,7 +124,27 @@ private:
 
 	ComputePSO m_temporalCloudPSO;
 	ComputePSO m_quarterCloudPSO;
+	ComputePSO m_upsampleCloudPSO;
 	ComputePSO m_combineSkyPSO;
+	ComputePSO m_skyCubePSO;
+
+	// the cloud passes with every texture read through the BindlessHeap, only the UAVs
+	// and the constant buffers are copied per dispatch
+	RootSignature m_bindlessCloudRS;
+	ComputePSO m_bindlessCloudPSO;
+	ComputePSO m_bindlessQuarterCloudPSO;
+	ComputePSO m_bindlessUpsampleCloudPSO;
+	ComputePSO m_bindlessTemporalCloudPSO;
+	ComputePSO m_bindlessSkyCubePSO;
+	bool m_useBindless = false;
+	// m_useBindless unless the context fell back to heaps of its own, for one graph
+	bool m_bindlessGraph = false;
+	uint32_t m_bindlessSlots[20] = {};
+
+	// declared again when the key changes, compiled again when the states the passes start
+	// from change, after a resize or an upload
+	FrameGraphExecutor m_cloudGraph;
+	CloudGraphKey m_cloudGraphKey = {};
 
 	//GraphicsPSO m_renderCloudOnQuadPSO;
 
@@ -58,20 +154,143 @@ private:
 	std::shared_ptr<Mesh> m_quadMesh;
 
 	const Texture2D* m_weatherTexture;
+	const Texture2D* m_weatherFile;
 	const Texture2D* m_curlNoise2D;
 	std::shared_ptr<VolumeColorBuffer> m_curlNoiseTexture;
 	std::shared_ptr<VolumeColorBuffer> m_perlinWorleyUE;
 	VolumeColorBuffer* m_basicCloudShape;
 	VolumeColorBuffer* m_erosionTexture;
 
+	BlueNoiseGenerator m_blueNoiseGenerator;
+	std::shared_ptr<Texture3D> m_blueNoiseTexture;
+	int m_blueNoiseSeed = 0;
+
+	CloudUpdateScheduler m_updateScheduler;
+	std::shared_ptr<Texture2D> m_updateScheduleTexture;
+	int m_updatePattern = CloudUpdateScheduler::kPatternBayer;
+	int m_updatePatternSize = 4;
+	float m_rayBudget = 1.0f / 16.0f;
+	CloudUpdateSimulation::Report m_updateSimulation = {};
+	// pixels the temporal pass raymarched off the schedule, a slot per frame in flight,
+	// handed to EndFrame once the GPU is done with the frame that counted them
+	static const uint32_t kForcedRaySlots = 3;
+	ByteAddressBuffer m_forcedRayCounter;
+	ReadbackBuffer m_forcedRayReadback;
+	uint64_t m_forcedRayFences[kForcedRaySlots] = {};
+	uint32_t m_forcedRaySlot = 0;
+
+	CloudReferenceRenderer m_referenceRenderer;
+	CloudReferenceTexture m_referenceCloudShape;
+	CloudReferenceTexture m_referenceErosion;
+	CloudReferenceTexture m_referenceWeather;
+	std::shared_ptr<Texture2D> m_referenceImage;
+	int m_referenceDownscale = 4;
+	CloudReferenceRenderer::SkippingReport m_skippingReport = {};
+	CloudReferenceRenderer::LightingReport m_lightingReport = {};
+	CloudReferenceRenderer::UpsampleReport m_upsampleReport = {};
+	CloudReferenceRenderer::SteppingReport m_steppingReport = {};
+	int m_referenceDenseFactor = 8;
+	CloudDensityQuery m_densityQuery;
+	CloudDensityQuery::BenchmarkResult m_queryBenchmark = {};
+	bool m_referenceShadowUpdate = false;
+	int m_referenceShadowSlices = 2;
+
+	// built on the CPU from the reference textures, uploaded when a build goes live
+	CloudShadowMap m_cloudShadowMap;
+	std::shared_ptr<Texture2D> m_cloudShadowTexture;
+	int m_cloudShadowSize = 512;
+	int m_cloudShadowRows = 16;
+	bool m_cloudShadowDirty = false;
+	// 512 and 1024 texels
+	std::vector<CloudShadowMap::Stats> m_cloudShadowCost;
+	// the CloudShadowVolume of m_referenceRenderer for RaymarchLight, uploaded when a build goes live
+	std::shared_ptr<Texture3D> m_shadowVolumeTexture;
+	uint32_t m_shadowVolumeBuilds = 0;
+	// CloudReferenceRenderer::LightMode, the cone march, or the volume over the cone or up to the sun
+	int m_shadowVolumeMode = 0;
+	bool m_shadowVolumeDirty = false;
+
+	// stands in for m_weatherFile, dirty tiles are uploaded before the cloud pass
+	CloudWeatherGenerator m_weatherGenerator;
+	CloudWeatherGenerator::Params m_weatherParams = CloudWeatherGenerator::DefaultParams();
+	std::shared_ptr<Texture2D> m_proceduralWeather;
+	bool m_useProceduralWeather = false;
+	int m_weatherSize = 1024;
+	int m_weatherTilesPerFrame = 8;
+	// 1024 and 4096 texels
+	std::vector<CloudWeatherGenerator::CostReport> m_weatherCost;
+
+	// continent of weather tiles around the camera, m_worldWeather or m_weatherTileFile fills them
+	CloudVirtualWeather m_virtualWeather;
+	CloudWeatherGenerator m_worldWeather;
+	CloudWeatherTileFile m_weatherTileFile;
+	std::shared_ptr<Texture2D> m_virtualWeatherAtlas;
+	std::shared_ptr<Texture2D> m_weatherIndirection;
+	bool m_useVirtualWeather = false;
+	bool m_useWeatherTileFile = false;
+	int m_virtualWeatherSlots = 16;
+	float m_virtualWeatherRadius = 6.0f;
+	float m_virtualWeatherPrefetch = 2.0f;
+	int m_virtualWeatherLoads = 4;
+	// where the weather was requested last, in the moving frame of the wind
+	float m_lastWeatherPosition[2] = { 0.0f, 0.0f };
+	CloudVirtualWeather::Stats m_weatherStreaming = {};
+
+	// density over height fraction and cloud type, baked from m_heightCurves
+	CloudHeightLut m_heightLut;
+	std::vector<CloudHeightLut::Curve> m_heightCurves = CloudHeightLut::DefaultCurves();
+	std::shared_ptr<Texture2D> m_heightLutTexture;
+	int m_heightLutTypes = 64;
+	int m_heightLutHeights = 256;
+	bool m_heightLutDirty = false;
+	// 64, 128, 256 and 512 heights
+	std::vector<CloudHeightLut::Report> m_heightLutReport;
+
+	// baked when first switched on, a placeholder until then
+	CloudMiePhase m_miePhase;
+	CloudMiePhase::Desc m_mieDesc = CloudMiePhase::DefaultDesc();
+	std::shared_ptr<Texture2D> m_mieLutTexture;
+
+	// ground truth for the octave lighting, its own query keeps the clouds of the first trace
+	CloudPathTracer m_pathTracer;
+	CloudDensityQuery m_pathTracerQuery;
+	CloudPassCB m_pathTracerPass;
+	CloudPathTracer::Settings m_pathTracerSettings = CloudPathTracer::DefaultSettings();
+	CloudPathTracer::SweepRange m_sweepRange = CloudPathTracer::DefaultSweepRange();
+	CloudPathTracer::SweepResult m_sweepResult = {};
+	bool m_pathTraceContinuous = false;
+
 	std::shared_ptr<VolumeColorBuffer> m_perlinWorley;
 	std::shared_ptr<VolumeColorBuffer> m_worley;
 	
+	// 1 / m_cloudParameterCB.downscale of the scene, cloud layer and depth
 	std::shared_ptr<ColorBuffer> m_quarterBuffer;
+	std::shared_ptr<ColorBuffer> m_quarterDepthBuffer;
 	std::shared_ptr<ColorBuffer> m_cloudTempBuffer;
 
 	std::shared_ptr<ColorBuffer> m_mipmapTestBuffer;
 
+	// sky and clouds around the camera for reflections, a few tiles raymarched per frame
+	CloudCubemapScheduler m_skyCubeScheduler;
+	std::shared_ptr<ColorBuffer> m_skyCube;
+	bool m_useSkyCube = false;
+	int m_skyCubeSize = 64;
+	int m_skyCubeTiles = 2;
+	int m_skyCubeBudget = 2;
+	// of SampleCountMin and SampleCountMax
+	float m_skyCubeSampleScale = 0.25f;
+	int m_skyCubeMaxFrames = 12;
+	CloudCubemapScheduler::Report m_skyCubeReport = {};
+	// a camera or a sun moving further than this in a frame refreshes the whole probe
+	float m_skyCubeJumpDistance = 1000.0f;
+	float m_skyCubeJumpDegrees = 1.0f;
+	XMFLOAT3 m_skyCubeCamera = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	XMFLOAT3 m_skyCubeLight = XMFLOAT3(0.0f, 1.0f, 0.0f);
+	uint32_t m_skyCubeJumps = 0;
+
+	// the last run of SelfTest::RunAll, from the Self Tests tab
+	std::vector<SelfTest::Result> m_selfTestResults;
+
 	Vector3 m_position;
 	Vector3 m_scale;
 	Vector3 m_rotation;
@@ -95,53 +314,9 @@ private:
 	// cloud shape setting
 	float m_farDistance;
 
-	struct
-	{
-		float lightColor[3] = { 1.0f, 0.99995f, 0.90193f };
-		int sampleCountMin = 64;
-		int sampleCountMax = 128;
-		float cloudCoverage = 1.0f;
-		float Exposure = 1.0;
-		float GroundAlbedo = 1.0;
-		float cloudBottomColor[3] = {0.38235f, 0.41176f, 0.47059f};
-		float crispiness = 43.238f;
-		float curliness = 0.1f;
-		float earthRadius = 6360.0f;
-		float cloudBottomRadius = 5000.0f;
-		float cloudTopRadius = 17000.0f;
-		float cloudSpeed = 0.0f;
-		float densityFactor = 0.003f;
-		float absorption = 0.0037f;
-		float hg0 = -0.08f;
-		float hg1 = 0.08f;
-		int enablePowder = 1;
-		int enableBeer = 1;
-		float rainAbsorption = 1.0f;
-		float eccentricity = 0.6f;
-		float sliverIntensity = 1.0f;
-		float sliverSpread = 0.3f;
-		float brightness = 1.0f;
-		float cloudScattering[3] = { 1.0f , 0.878f, 0.745f};
-		float cloudScatteringWeight = 2.193f;
-		float ABC[3] = { 0.5f, 0.5f, 0.5f };
-		float HGWeight = 0.5;
-	}m_cloudParameterCB;
-
-	struct
-	{
-		Matrix4 invView;
-		Matrix4 invProj;
-		Matrix4 prevViewProj;
-		XMFLOAT3 cameraPosition;
-		float time = 0.0f;
-		XMFLOAT3 lightDir;
-		uint32_t frameIndex = 0;
-		XMFLOAT4 resolution;
-		XMFLOAT3 groundAlbedo;
-		float exposure = 1.0f;
-		XMFLOAT3 whitePoint;
-		float sunSize = 0.999853f;
-	}m_passCB;
+	CloudParameterCB m_cloudParameterCB;
+
+	CloudPassCB m_passCB;
 
 	bool m_useTemporal;
 	bool m_computeToQuarter = false;
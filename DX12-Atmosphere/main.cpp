@@ -4,12 +4,30 @@
 //#include "Testes/CameraDemo.h"
 //#include "Testes/ComputeDemo.h"
 #include "VolumetricCloud.h"
+#include "Utils/SelfTest.h"
 #include <tchar.h>
+#include <cstring>
+#include <iostream>
 
 int main(int argc, char** argv)
 {
 	VolumetricCloud app;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "-bindless") == 0)
+			app.SetBindless(true);
+	}
 	app.Initialize();
+	// the checks instead of the app, the exit code is the number that failed
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "-selftest") == 0)
+		{
+			std::vector<SelfTest::Result> results = SelfTest::RunAll();
+			std::cout << SelfTest::Dump(results);
+			return (int)SelfTest::CountFailed(results);
+		}
+	}
 	return app.Run();
 
 }
\ No newline at end of file